@@ -49,6 +49,7 @@ LLJoint::LLJoint()
 	mDirtyFlags = MATRIX_DIRTY | ROTATION_DIRTY | POSITION_DIRTY;
 	mUpdateXform = TRUE;
 	mJointNum = -1;
+	mDetailJoint = FALSE;
 	touch();
 }
 
@@ -66,6 +67,7 @@ LLJoint::LLJoint(const std::string &name, LLJoint *parent)
 	mDirtyFlags = MATRIX_DIRTY | ROTATION_DIRTY | POSITION_DIRTY;
 	mUpdateXform = FALSE;
 	mJointNum = 0;
+	mDetailJoint = FALSE;
 
 	setName(name);
 	if (parent)
@@ -81,6 +81,9 @@ protected:
 	// explicit transformation members
 	LLXformMatrix		mXform;
 
+	// skipped by reduced animation level of detail
+	BOOL			mDetailJoint;
+
 public:
 	U32				mDirtyFlags;
 	BOOL			mUpdateXform;
@@ -172,6 +175,9 @@ public:
 
 	S32 getJointNum() const { return mJointNum; }
 	void setJointNum(S32 joint_num) { mJointNum = joint_num; }
+
+	BOOL isDetailJoint() const { return mDetailJoint; }
+	void setDetailJoint(BOOL detail) { mDetailJoint = detail; }
 };
 #endif // LL_LLJOINT_H
 
@@ -40,9 +40,12 @@
 #include "llkeyframemotion.h"
 #include "llquantize.h"
 #include "llvfile.h"
+#include "llv4math.h"
 #include "m3math.h"
 #include "message.h"
 
+#include <algorithm>
+
 //-----------------------------------------------------------------------------
 // Static Definitions
 //-----------------------------------------------------------------------------
@@ -127,6 +130,114 @@ U32 LLKeyframeMotion::JointMotionList::dumpDiagInfo()
 //-----------------------------------------------------------------------------
 
 
+//-----------------------------------------------------------------------------
+// Key lookup shared by the curves
+//-----------------------------------------------------------------------------
+
+// Past this many keys a forward scan gives way to a binary search.
+static const S32 MAX_KEY_SCAN = 4;
+
+// Returns the index of the first key at or after time, as std::lower_bound
+// would.  cursor holds the answer from the previous lookup; while time moves
+// forward that is at most a key or two behind, so sampling an animation in
+// order is amortized constant time.
+template <class KEY>
+static S32 find_key(const std::vector<KEY>& keys, F32 time, S32& cursor)
+{
+	const S32 count = (S32)keys.size();
+	S32 right = llclamp(cursor, 0, count);
+	if (right > 0 && keys[right - 1].mTime >= time)
+	{
+		// Time went backwards, e.g. the motion looped
+		right = 0;
+	}
+
+	// keys[right - 1] is before time here, if it exists
+	S32 steps = 0;
+	while (right < count && keys[right].mTime < time)
+	{
+		if (++steps > MAX_KEY_SCAN)
+		{
+			S32 first = right;
+			S32 len = count - first;
+			while (len > 0)
+			{
+				S32 half = len / 2;
+				if (keys[first + half].mTime < time)
+				{
+					first += half + 1;
+					len -= half + 1;
+				}
+				else
+				{
+					len = half;
+				}
+			}
+			right = first;
+			break;
+		}
+		++right;
+	}
+
+	cursor = right;
+	return right;
+}
+
+// Finds the keys around time.  Returns TRUE with the two keys and the weight
+// between them if time falls strictly between keys, otherwise FALSE with the
+// key to use as is in before.
+template <class KEY>
+static BOOL find_keys(const std::vector<KEY>& keys, F32 time, S32& cursor,
+					  const KEY*& before, const KEY*& after, F32& u)
+{
+	S32 right = find_key(keys, time, cursor);
+	if (right == (S32)keys.size())
+	{
+		// Past last key
+		before = &keys[right - 1];
+		return FALSE;
+	}
+	else if (right == 0 || keys[right].mTime == time)
+	{
+		// Before first key or exactly on a key
+		before = &keys[right];
+		return FALSE;
+	}
+
+	// Between two keys
+	before = &keys[right - 1];
+	after = &keys[right];
+	u = (time - before->mTime) / (after->mTime - before->mTime);
+	return TRUE;
+}
+
+// Sorts keys by time, keeping only the last of several keys read for the
+// same time.
+template <class KEY>
+static bool key_time_less(const KEY& a, const KEY& b)
+{
+	return a.mTime < b.mTime;
+}
+
+template <class KEY>
+static void sort_keys(std::vector<KEY>& keys)
+{
+	std::stable_sort(keys.begin(), keys.end(), key_time_less<KEY>);
+	U32 out = 0;
+	for (U32 in = 0; in < keys.size(); in++)
+	{
+		if (out > 0 && keys[out - 1].mTime == keys[in].mTime)
+		{
+			keys[out - 1] = keys[in];
+		}
+		else
+		{
+			keys[out++] = keys[in];
+		}
+	}
+	keys.resize(out);
+}
+
 //-----------------------------------------------------------------------------
 // ScaleCurve::ScaleCurve()
 //-----------------------------------------------------------------------------
@@ -149,6 +260,12 @@ LLKeyframeMotion::ScaleCurve::~ScaleCurve()
 // getValue()
 //-----------------------------------------------------------------------------
 LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration)
+{
+	S32 cursor = 0;
+	return getValue(time, duration, cursor);
+}
+
+LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration, S32& cursor)
 {
 	LLVector3 value;
 
@@ -158,34 +275,16 @@ LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration)
 		return value;
 	}
 	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
+	const ScaleKey* scale_before;
+	const ScaleKey* scale_after;
+	F32 u;
+	if (find_keys(mKeys, time, cursor, scale_before, scale_after, u))
 	{
-		// Past last key
-		--right;
-		value = right->second.mScale;
-	}
-	else if (right == mKeys.begin() || right->first == time)
-	{
-		// Before first key or exactly on a key
-		value = right->second.mScale;
+		value = interp(u, *scale_before, *scale_after);
 	}
 	else
 	{
-		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		ScaleKey& scale_before = left->second;
-		ScaleKey& scale_after = right->second;
-		if (right == mKeys.end())
-		{
-			scale_after = mLoopInKey;
-			index_after = duration;
-		}
-
-		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, scale_before, scale_after);
+		value = scale_before->mScale;
 	}
 	return value;
 }
@@ -193,7 +292,7 @@ LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration)
 //-----------------------------------------------------------------------------
 // interp()
 //-----------------------------------------------------------------------------
-LLVector3 LLKeyframeMotion::ScaleCurve::interp(F32 u, ScaleKey& before, ScaleKey& after)
+LLVector3 LLKeyframeMotion::ScaleCurve::interp(F32 u, const ScaleKey& before, const ScaleKey& after)
 {
 	switch (mInterpolationType)
 	{
@@ -229,6 +328,12 @@ LLKeyframeMotion::RotationCurve::~RotationCurve()
 // RotationCurve::getValue()
 //-----------------------------------------------------------------------------
 LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration)
+{
+	S32 cursor = 0;
+	return getValue(time, duration, cursor);
+}
+
+LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration, S32& cursor)
 {
 	LLQuaternion value;
 
@@ -238,34 +343,16 @@ LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration)
 		return value;
 	}
 	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
-	{
-		// Past last key
-		--right;
-		value = right->second.mRotation;
-	}
-	else if (right == mKeys.begin() || right->first == time)
+	const RotationKey* rot_before;
+	const RotationKey* rot_after;
+	F32 u;
+	if (find_keys(mKeys, time, cursor, rot_before, rot_after, u))
 	{
-		// Before first key or exactly on a key
-		value = right->second.mRotation;
+		value = interp(u, *rot_before, *rot_after);
 	}
 	else
 	{
-		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		RotationKey& rot_before = left->second;
-		RotationKey& rot_after = right->second;
-		if (right == mKeys.end())
-		{
-			rot_after = mLoopInKey;
-			index_after = duration;
-		}
-
-		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, rot_before, rot_after);
+		value = rot_before->mRotation;
 	}
 	return value;
 }
@@ -273,7 +360,7 @@ LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration)
 //-----------------------------------------------------------------------------
 // interp()
 //-----------------------------------------------------------------------------
-LLQuaternion LLKeyframeMotion::RotationCurve::interp(F32 u, RotationKey& before, RotationKey& after)
+LLQuaternion LLKeyframeMotion::RotationCurve::interp(F32 u, const RotationKey& before, const RotationKey& after)
 {
 	switch (mInterpolationType)
 	{
@@ -310,6 +397,12 @@ LLKeyframeMotion::PositionCurve::~PositionCurve()
 // PositionCurve::getValue()
 //-----------------------------------------------------------------------------
 LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration)
+{
+	S32 cursor = 0;
+	return getValue(time, duration, cursor);
+}
+
+LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration, S32& cursor)
 {
 	LLVector3 value;
 
@@ -319,34 +412,16 @@ LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration)
 		return value;
 	}
 	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
+	const PositionKey* pos_before;
+	const PositionKey* pos_after;
+	F32 u;
+	if (find_keys(mKeys, time, cursor, pos_before, pos_after, u))
 	{
-		// Past last key
-		--right;
-		value = right->second.mPosition;
-	}
-	else if (right == mKeys.begin() || right->first == time)
-	{
-		// Before first key or exactly on a key
-		value = right->second.mPosition;
+		value = interp(u, *pos_before, *pos_after);
 	}
 	else
 	{
-		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		PositionKey& pos_before = left->second;
-		PositionKey& pos_after = right->second;
-		if (right == mKeys.end())
-		{
-			pos_after = mLoopInKey;
-			index_after = duration;
-		}
-
-		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, pos_before, pos_after);
+		value = pos_before->mPosition;
 	}
 
 	llassert(value.isFinite());
@@ -357,7 +432,7 @@ LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration)
 //-----------------------------------------------------------------------------
 // interp()
 //-----------------------------------------------------------------------------
-LLVector3 LLKeyframeMotion::PositionCurve::interp(F32 u, PositionKey& before, PositionKey& after)
+LLVector3 LLKeyframeMotion::PositionCurve::interp(F32 u, const PositionKey& before, const PositionKey& after)
 {
 	switch (mInterpolationType)
 	{
@@ -371,6 +446,108 @@ LLVector3 LLKeyframeMotion::PositionCurve::interp(F32 u, PositionKey& before, Po
 }
 
 
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// RotationBatch class
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// RotationBatch::add()
+// Sets joint_state's rotation to nlerp(u, before, after), now or at the next
+// flush().
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::RotationBatch::add(LLJointState* joint_state, F32 u,
+										  const LLQuaternion& before, const LLQuaternion& after)
+{
+	if (dot(before, after) < 0.f)
+	{
+		// nlerp() takes the long way round with slerp()
+		joint_state->setRotation(slerp(u, before, after));
+		return;
+	}
+
+	mJointStates[mCount] = joint_state;
+	mU[mCount] = u;
+	mBefore[mCount] = &before;
+	mAfter[mCount] = &after;
+	if (++mCount == BATCH_SIZE)
+	{
+		flush();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// RotationBatch::flush()
+// lerp() and normalize() for the whole batch, done in the same order as the
+// scalar code so the results are identical.
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::RotationBatch::flush()
+{
+#if LL_VECTORIZE
+	if (mCount == BATCH_SIZE)
+	{
+		F32 p[4][BATCH_SIZE];
+		F32 q[4][BATCH_SIZE];
+		for (S32 i = 0; i < BATCH_SIZE; i++)
+		{
+			for (S32 c = 0; c < 4; c++)
+			{
+				p[c][i] = mBefore[i]->mQ[c];
+				q[c][i] = mAfter[i]->mQ[c];
+			}
+		}
+
+		const __m128 t = _mm_loadu_ps(mU);
+		const __m128 inv_t = _mm_sub_ps(_mm_set1_ps(1.f), t);
+		__m128 r[4];
+		for (S32 c = 0; c < 4; c++)
+		{
+			r[c] = _mm_add_ps(_mm_mul_ps(t, _mm_loadu_ps(q[c])), _mm_mul_ps(inv_t, _mm_loadu_ps(p[c])));
+		}
+
+		// LLQuaternion::normalize()
+		__m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r[VX], r[VX]),
+																   _mm_mul_ps(r[VY], r[VY])),
+														_mm_mul_ps(r[VZ], r[VZ])),
+											 _mm_mul_ps(r[VS], r[VS])));
+		const __m128 sign_mask = _mm_set1_ps(-0.f);
+		__m128 valid = _mm_cmpgt_ps(mag, _mm_set1_ps(FP_MAG_THRESHOLD));
+		__m128 drift = _mm_andnot_ps(sign_mask, _mm_sub_ps(_mm_set1_ps(1.f), mag));
+		__m128 rescale = _mm_and_ps(valid, _mm_cmpgt_ps(drift, _mm_set1_ps(ONE_PART_IN_A_MILLION)));
+		__m128 oomag = _mm_div_ps(_mm_set1_ps(1.f), mag);
+		const F32 identity[4] = { 0.f, 0.f, 0.f, 1.f };
+		F32 result[4][BATCH_SIZE];
+		for (S32 c = 0; c < 4; c++)
+		{
+			__m128 scaled = _mm_or_ps(_mm_and_ps(rescale, _mm_mul_ps(r[c], oomag)),
+									  _mm_andnot_ps(rescale, r[c]));
+			__m128 value = _mm_or_ps(_mm_and_ps(valid, scaled),
+									 _mm_andnot_ps(valid, _mm_set1_ps(identity[c])));
+			_mm_storeu_ps(result[c], value);
+		}
+
+		for (S32 i = 0; i < BATCH_SIZE; i++)
+		{
+			LLQuaternion rot;
+			rot.mQ[VX] = result[VX][i];
+			rot.mQ[VY] = result[VY][i];
+			rot.mQ[VZ] = result[VZ][i];
+			rot.mQ[VS] = result[VS][i];
+			mJointStates[i]->setRotation(rot);
+		}
+		mCount = 0;
+		return;
+	}
+#endif
+	for (S32 i = 0; i < mCount; i++)
+	{
+		mJointStates[i]->setRotation(lerp(mU[i], *mBefore[i], *mAfter[i]));
+	}
+	mCount = 0;
+}
+
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 // JointMotion class
@@ -381,6 +558,17 @@ LLVector3 LLKeyframeMotion::PositionCurve::interp(F32 u, PositionKey& before, Po
 // JointMotion::update()
 //-----------------------------------------------------------------------------
 void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time, F32 duration)
+{
+	KeyCursors cursors;
+	RotationBatch rotations;
+	update(joint_state, time, duration, cursors, rotations);
+	rotations.flush();
+}
+
+// Rotations that need interpolating may be left in rotations, to be set by
+// its next flush().
+void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time, F32 duration,
+										   KeyCursors& cursors, RotationBatch& rotations)
 {
 	// this value being 0 is the cause of https://jira.lindenlab.com/browse/SL-22678 but I haven't 
 	// managed to get a stack to see how it got here. Testing for 0 here will stop the crash.
@@ -396,7 +584,7 @@ void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time,
 	//-------------------------------------------------------------------------
 	if ((usage & LLJointState::SCALE) && mScaleCurve.mNumKeys)
 	{
-		joint_state->setScale( mScaleCurve.getValue( time, duration ) );
+		joint_state->setScale( mScaleCurve.getValue( time, duration, cursors.mScale ) );
 	}
 
 	//-------------------------------------------------------------------------
@@ -404,7 +592,25 @@ void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time,
 	//-------------------------------------------------------------------------
 	if ((usage & LLJointState::ROT) && mRotationCurve.mNumKeys)
 	{
-		joint_state->setRotation( mRotationCurve.getValue( time, duration ) );
+		const RotationKey* rot_before;
+		const RotationKey* rot_after;
+		F32 u;
+		if (mRotationCurve.mKeys.empty())
+		{
+			joint_state->setRotation(LLQuaternion::DEFAULT);
+		}
+		else if (!find_keys(mRotationCurve.mKeys, time, cursors.mRotation, rot_before, rot_after, u))
+		{
+			joint_state->setRotation(rot_before->mRotation);
+		}
+		else if (mRotationCurve.mInterpolationType == IT_STEP)
+		{
+			joint_state->setRotation(mRotationCurve.interp(u, *rot_before, *rot_after));
+		}
+		else
+		{
+			rotations.add(joint_state, u, rot_before->mRotation, rot_after->mRotation);
+		}
 	}
 
 	//-------------------------------------------------------------------------
@@ -412,7 +618,7 @@ void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time,
 	//-------------------------------------------------------------------------
 	if ((usage & LLJointState::POS) && mPositionCurve.mNumKeys)
 	{
-		joint_state->setPosition( mPositionCurve.getValue( time, duration ) );
+		joint_state->setPosition( mPositionCurve.getValue( time, duration, cursors.mPosition ) );
 	}
 }
 
@@ -721,12 +927,30 @@ BOOL LLKeyframeMotion::onUpdate(F32 time, U8* joint_mask)
 void LLKeyframeMotion::applyKeyframes(F32 time)
 {
 	llassert_always (mJointMotionList->getNumJointMotions() <= mJointStates.size());
+	if (mKeyCursors.size() != mJointStates.size())
+	{
+		mKeyCursors.resize(mJointStates.size());
+	}
+
+	BOOL skip_detail = mCharacter->getMotionController().getSkipDetailJoints();
+	RotationBatch rotations;
 	for (U32 i=0; i<mJointMotionList->getNumJointMotions(); i++)
 	{
+		if (skip_detail
+			&& mJointStates[i].notNull()
+			&& mJointStates[i]->getJoint()
+			&& mJointStates[i]->getJoint()->isDetailJoint())
+		{
+			// hold the pose from the last full update
+			continue;
+		}
 		mJointMotionList->getJointMotion(i)->update(mJointStates[i],
 													  time, 
-													  mJointMotionList->mDuration );
+													  mJointMotionList->mDuration,
+													  mKeyCursors[i],
+													  rotations );
 	}
+	rotations.flush();
 
 	LLJoint::JointPriority* pose_priority = (LLJoint::JointPriority* )mCharacter->getAnimationData("Hand Pose Priority");
 	if (pose_priority)
@@ -1497,8 +1721,9 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 				return FALSE;
 			}
 
-			rCurve->mKeys[time] = rot_key;
+			rCurve->mKeys.push_back(rot_key);
 		}
+		sort_keys(rCurve->mKeys);
 
 		//---------------------------------------------------------------------
 		// scan position curve header
@@ -1576,13 +1801,14 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 				return FALSE;
 			}
 			
-			pCurve->mKeys[pos_key.mTime] = pos_key;
+			pCurve->mKeys.push_back(pos_key);
 
 			if (is_pelvis)
 			{
 				mJointMotionList->mPelvisBBox.addPoint(pos_key.mPosition);
 			}
 		}
+		sort_keys(pCurve->mKeys);
 
 		joint_motion->mUsage = joint_state->getUsage();
 	}
@@ -1827,10 +2053,10 @@ BOOL LLKeyframeMotion::serialize(LLDataPacker& dp) const
 		success &= dp.packS32(joint_motionp->mPriority, "joint_priority");
 		success &= dp.packS32(joint_motionp->mRotationCurve.mNumKeys, "num_rot_keys");
 
-		for (RotationCurve::key_map_t::iterator iter = joint_motionp->mRotationCurve.mKeys.begin();
+		for (RotationCurve::key_array_t::iterator iter = joint_motionp->mRotationCurve.mKeys.begin();
 			 iter != joint_motionp->mRotationCurve.mKeys.end(); ++iter)
 		{
-			RotationKey& rot_key = iter->second;
+			RotationKey& rot_key = *iter;
 			U16 time_short = F32_to_U16(rot_key.mTime, 0.f, mJointMotionList->mDuration);
 			success &= dp.packU16(time_short, "time");
 
@@ -1847,10 +2073,10 @@ BOOL LLKeyframeMotion::serialize(LLDataPacker& dp) const
 		}
 
 		success &= dp.packS32(joint_motionp->mPositionCurve.mNumKeys, "num_pos_keys");
-		for (PositionCurve::key_map_t::iterator iter = joint_motionp->mPositionCurve.mKeys.begin();
+		for (PositionCurve::key_array_t::iterator iter = joint_motionp->mPositionCurve.mKeys.begin();
 			 iter != joint_motionp->mPositionCurve.mKeys.end(); ++iter)
 		{
-			PositionKey& pos_key = iter->second;
+			PositionKey& pos_key = *iter;
 			U16 time_short = F32_to_U16(pos_key.mTime, 0.f, mJointMotionList->mDuration);
 			success &= dp.packU16(time_short, "time");
 
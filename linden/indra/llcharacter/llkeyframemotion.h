@@ -32,6 +32,7 @@
 //-----------------------------------------------------------------------------
 
 #include <string>
+#include <vector>
 
 #include "llassetstorage.h"
 #include "llbboxlocal.h"
@@ -320,12 +321,14 @@ public:
 		ScaleCurve();
 		~ScaleCurve();
 		LLVector3 getValue(F32 time, F32 duration);
-		LLVector3 interp(F32 u, ScaleKey& before, ScaleKey& after);
+		LLVector3 getValue(F32 time, F32 duration, S32& cursor);
+		LLVector3 interp(F32 u, const ScaleKey& before, const ScaleKey& after);
 
 		InterpolationType	mInterpolationType;
 		S32					mNumKeys;
-		typedef std::map<F32, ScaleKey> key_map_t;
-		key_map_t 			mKeys;
+		// sorted by time, one key per time
+		typedef std::vector<ScaleKey> key_array_t;
+		key_array_t 			mKeys;
 		ScaleKey			mLoopInKey;
 		ScaleKey			mLoopOutKey;
 	};
@@ -339,12 +342,14 @@ public:
 		RotationCurve();
 		~RotationCurve();
 		LLQuaternion getValue(F32 time, F32 duration);
-		LLQuaternion interp(F32 u, RotationKey& before, RotationKey& after);
+		LLQuaternion getValue(F32 time, F32 duration, S32& cursor);
+		LLQuaternion interp(F32 u, const RotationKey& before, const RotationKey& after);
 
 		InterpolationType	mInterpolationType;
 		S32					mNumKeys;
-		typedef std::map<F32, RotationKey> key_map_t;
-		key_map_t		mKeys;
+		// sorted by time, one key per time
+		typedef std::vector<RotationKey> key_array_t;
+		key_array_t		mKeys;
 		RotationKey		mLoopInKey;
 		RotationKey		mLoopOutKey;
 	};
@@ -358,16 +363,55 @@ public:
 		PositionCurve();
 		~PositionCurve();
 		LLVector3 getValue(F32 time, F32 duration);
-		LLVector3 interp(F32 u, PositionKey& before, PositionKey& after);
+		LLVector3 getValue(F32 time, F32 duration, S32& cursor);
+		LLVector3 interp(F32 u, const PositionKey& before, const PositionKey& after);
 
 		InterpolationType	mInterpolationType;
 		S32					mNumKeys;
-		typedef std::map<F32, PositionKey> key_map_t;
-		key_map_t		mKeys;
+		// sorted by time, one key per time
+		typedef std::vector<PositionKey> key_array_t;
+		key_array_t		mKeys;
 		PositionKey		mLoopInKey;
 		PositionKey		mLoopOutKey;
 	};
 
+	//-------------------------------------------------------------------------
+	// KeyCursors
+	// Where the last lookup in each curve of a joint landed.  Curves are
+	// shared between instances through LLKeyframeDataCache, so each motion
+	// instance keeps its own.
+	//-------------------------------------------------------------------------
+	class KeyCursors
+	{
+	public:
+		KeyCursors() : mPosition(0), mRotation(0), mScale(0) {}
+
+		S32 mPosition;
+		S32 mRotation;
+		S32 mScale;
+	};
+
+	//-------------------------------------------------------------------------
+	// RotationBatch
+	// Joint rotations waiting on a normalized lerp, computed four at a time.
+	//-------------------------------------------------------------------------
+	class RotationBatch
+	{
+	public:
+		RotationBatch() : mCount(0) {}
+
+		void add(LLJointState* joint_state, F32 u, const LLQuaternion& before, const LLQuaternion& after);
+		void flush();
+
+	private:
+		enum { BATCH_SIZE = 4 };
+		S32					mCount;
+		LLJointState*		mJointStates[BATCH_SIZE];
+		F32					mU[BATCH_SIZE];
+		const LLQuaternion*	mBefore[BATCH_SIZE];
+		const LLQuaternion*	mAfter[BATCH_SIZE];
+	};
+
 	//-------------------------------------------------------------------------
 	// JointMotion
 	//-------------------------------------------------------------------------
@@ -382,6 +426,8 @@ public:
 		LLJoint::JointPriority	mPriority;
 
 		void update(LLJointState* joint_state, F32 time, F32 duration);
+		void update(LLJointState* joint_state, F32 time, F32 duration,
+					KeyCursors& cursors, RotationBatch& rotations);
 	};
 	
 	//-------------------------------------------------------------------------
@@ -424,6 +470,7 @@ protected:
 	//-------------------------------------------------------------------------
 	JointMotionList*				mJointMotionList;
 	std::vector<LLPointer<LLJointState> > mJointStates;
+	std::vector<KeyCursors>			mKeyCursors;	// parallel to mJointStates
 	LLJoint*						mPelvisp;
 	LLCharacter*					mCharacter;
 	typedef std::list<JointConstraint*>	constraint_list_t;
@@ -41,11 +41,21 @@
 const S32 NUM_JOINT_SIGNATURE_STRIDES = LL_CHARACTER_MAX_JOINTS / 4;
 const U32 MAX_MOTION_INSTANCES = 32;
 
+// Frames in a row an evaluation can be put off to keep within the budget
+const S32 MAX_DEFERRED_FRAMES = 4;
+
 //-----------------------------------------------------------------------------
 // Constants and statics
 //-----------------------------------------------------------------------------
 LLMotionRegistry LLMotionController::sRegistry;
 
+S32 LLMotionController::sNumEvaluations = 0;
+S32 LLMotionController::sNumInterpolations = 0;
+S32 LLMotionController::sNumDeferrals = 0;
+F32 LLMotionController::sEvaluationTime = 0.f;
+F32 LLMotionController::sFrameBudget = 0.f;
+F32 LLMotionController::sAverageEvaluationTime = 0.f;
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 // LLMotionRegistry class
@@ -138,6 +148,9 @@ LLMotionController::LLMotionController()
 	  mTimeStep(0.f),
 	  mTimeStepCount(0),
 	  mLastInterp(0.f),
+	  mPlaybackTime(0.f),
+	  mDeferredFrames(0),
+	  mSkipDetailJoints(FALSE),
 	  mIsSelf(FALSE)
 {
 }
@@ -814,29 +827,35 @@ void LLMotionController::updateMotions(bool force_update)
 	// Update timing info for this time step.
 	if (!mPaused)
 	{
-		F32 update_time = mAnimTime + delta_time * mTimeFactor;
+		mPlaybackTime += delta_time * mTimeFactor;
 		if (use_quantum)
 		{
-			F32 time_interval = fmodf(update_time, mTimeStep);
+			F32 time_interval = fmodf(mPlaybackTime, mTimeStep);
 
 			// always animate *ahead* of actual time
-			S32 quantum_count = llmax(0, llfloor((update_time - time_interval) / mTimeStep)) + 1;
+			S32 quantum_count = llmax(0, llfloor((mPlaybackTime - time_interval) / mTimeStep)) + 1;
 			if (quantum_count == mTimeStepCount)
 			{
 				// we're still in same time quantum as before, so just interpolate and exit
-				if (!mPaused)
-				{
-					F32 interp = time_interval / mTimeStep;
-					mPoseBlender.interpolate(interp - mLastInterp);
-					mLastInterp = interp;
-				}
+				interpolatePose(time_interval / mTimeStep);
+				sNumInterpolations++;
+
+				updateLoadingMotions();
+				return;
+			}
+
+			if (deferEvaluation(force_update))
+			{
+				// out of time this frame, hold the last pose we computed
+				interpolatePose(1.f);
+				sNumDeferrals++;
 
 				updateLoadingMotions();
 				return;
 			}
 			
 			// is calculating a new keyframe pose, make sure the last one gets applied
-			mPoseBlender.interpolate(1.f);
+			interpolatePose(1.f);
 			clearBlenders();
 
 			mTimeStepCount = quantum_count;
@@ -845,9 +864,14 @@ void LLMotionController::updateMotions(bool force_update)
 		}
 		else
 		{
-			mAnimTime = update_time;
+			// catch up with the last pose if we were running ahead on a time step
+			mPlaybackTime = llmax(mPlaybackTime, mAnimTime);
+			mAnimTime = mPlaybackTime;
 		}
 	}
+	mDeferredFrames = 0;
+
+	U64 start_time = totalTime();
 
 	updateLoadingMotions();
 
@@ -876,10 +900,80 @@ void LLMotionController::updateMotions(bool force_update)
 		}
 	}
 
+	sNumEvaluations++;
+	sEvaluationTime += (F32)(totalTime() - start_time) / (F32)SEC_TO_MICROSEC;
+
 	mHasRunOnce = TRUE;
 //	llinfos << "Motion controller time " << motionTimer.getElapsedTimeF32() << llendl;
 }
 
+//-----------------------------------------------------------------------------
+// deferEvaluation()
+// Returns TRUE if this frame's budget is spent and the new pose for this
+// time step can wait.  The character's own avatar is never put off, and
+// nobody is put off for more than a few frames in a row.
+//-----------------------------------------------------------------------------
+BOOL LLMotionController::deferEvaluation(bool force_update)
+{
+	if (force_update
+		|| mIsSelf
+		|| !mHasRunOnce
+		|| sFrameBudget <= 0.f
+		|| sEvaluationTime < sFrameBudget
+		|| mDeferredFrames >= MAX_DEFERRED_FRAMES)
+	{
+		return FALSE;
+	}
+	mDeferredFrames++;
+	return TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// interpolatePose()
+// Moves the skeleton to interp of the way from the pose it had at the last
+// evaluation to the pose cached by it.
+//-----------------------------------------------------------------------------
+void LLMotionController::interpolatePose(F32 interp)
+{
+	if (mLastInterp < 1.f && interp > mLastInterp)
+	{
+		// the joints are already mLastInterp of the way there
+		mPoseBlender.interpolate((interp - mLastInterp) / (1.f - mLastInterp));
+		mLastInterp = interp;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// startFrame()
+//-----------------------------------------------------------------------------
+// static
+void LLMotionController::startFrame(F32 budget_seconds)
+{
+	if (sNumEvaluations > 0)
+	{
+		F32 frame_average = sEvaluationTime / (F32)sNumEvaluations;
+		sAverageEvaluationTime = (sAverageEvaluationTime == 0.f)
+			? frame_average
+			: lerp(sAverageEvaluationTime, frame_average, 0.1f);
+	}
+
+	sNumEvaluations = 0;
+	sNumInterpolations = 0;
+	sNumDeferrals = 0;
+	sEvaluationTime = 0.f;
+	sFrameBudget = llmax(0.f, budget_seconds);
+}
+
+//-----------------------------------------------------------------------------
+// getSavedTime()
+//-----------------------------------------------------------------------------
+// static
+F32 LLMotionController::getSavedTime()
+{
+	F32 average = (sNumEvaluations > 0) ? sEvaluationTime / (F32)sNumEvaluations : sAverageEvaluationTime;
+	return (F32)(sNumInterpolations + sNumDeferrals) * average;
+}
+
 //-----------------------------------------------------------------------------
 // updateMotionsMinimal()
 // minimal update (e.g. while hidden)
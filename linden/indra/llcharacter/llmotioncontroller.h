@@ -152,6 +152,20 @@ public:
 
 	void setTimeStep(F32 step);
 
+	// leave joints flagged as detail joints in their last pose
+	// (animation level of detail for small or distant characters)
+	void setSkipDetailJoints(BOOL skip) { mSkipDetailJoints = skip; }
+	BOOL getSkipDetailJoints() const { return mSkipDetailJoints; }
+
+	// resets the per frame animation statistics and sets the time that
+	// controllers with a time step may spend evaluating motions this
+	// frame before their evaluations are put off (0 for no limit)
+	static void startFrame(F32 budget_seconds);
+
+	// estimated seconds of evaluation saved this frame by time steps and
+	// the frame budget
+	static F32 getSavedTime();
+
 	void setTimeFactor(F32 time_factor);
 	F32 getTimeFactor() const { return mTimeFactor; }
 
@@ -185,6 +199,15 @@ protected:
 	void updateIdleActiveMotions();
 	void purgeExcessMotions();
 	void deactivateStoppedMotions();
+	BOOL deferEvaluation(bool force_update);
+	void interpolatePose(F32 interp);
+
+public:
+	// animation statistics for the current frame
+	static S32			sNumEvaluations;	// poses evaluated from motions
+	static S32			sNumInterpolations;	// poses interpolated between evaluations
+	static S32			sNumDeferrals;		// evaluations put off by the frame budget
+	static F32			sEvaluationTime;	// seconds spent evaluating poses
 
 protected:
 	F32					mTimeFactor;
@@ -219,6 +242,12 @@ protected:
 	F32					mTimeStep;
 	S32					mTimeStepCount;
 	F32					mLastInterp;
+	F32					mPlaybackTime;		// mAnimTime runs up to a time step ahead of this
+	S32					mDeferredFrames;
+	BOOL				mSkipDetailJoints;
+
+	static F32			sFrameBudget;
+	static F32			sAverageEvaluationTime;
 
 	U8					mJointSignature[2][LL_CHARACTER_MAX_JOINTS];
 };
@@ -167,6 +167,10 @@ public:
 	void operator +=(Type x) { apr_atomic_add32(&mData, apr_uint32_t(x)); }
 	Type operator ++(int) { return apr_atomic_inc32(&mData); } // Type++
 	Type operator --(int) { return apr_atomic_dec32(&mData); } // Type--
+	// Sets the value to exchange if it was comparand.  Returns what it was.
+	Type compareAndSwap(Type comparand, Type exchange) { return Type(apr_atomic_cas32(&mData, apr_uint32_t(exchange), apr_uint32_t(comparand))); }
+	// Sets the value to x.  Returns what it was.
+	Type exchange(Type x) { return Type(apr_atomic_xchg32(&mData, apr_uint32_t(x))); }
 	
 private:
 	apr_uint32_t mData;
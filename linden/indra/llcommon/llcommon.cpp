@@ -27,6 +27,7 @@
 
 #include "llcommon.h"
 
+#include "llfasttimer.h"
 #include "llmemory.h"
 #include "llthread.h"
 
@@ -43,7 +44,7 @@ void LLCommon::initClass()
 		sAprInitialized = TRUE;
 	}
 	LLTimer::initClass();
-	LLThreadSafeRefCount::initThreadSafeRefCount();
+	LLFastTimer::initClass();
 // 	LLWorkerThread::initClass();
 // 	LLFrameCallbackManager::initClass();
 }
@@ -53,7 +54,7 @@ void LLCommon::cleanupClass()
 {
 // 	LLFrameCallbackManager::cleanupClass();
 // 	LLWorkerThread::cleanupClass();
-	LLThreadSafeRefCount::cleanupThreadSafeRefCount();
+	LLFastTimer::cleanupClass();
 	LLTimer::cleanupClass();
 	if (sAprInitialized)
 	{
@@ -48,6 +48,7 @@
 #include "llsd.h"
 #include "llsdserialize.h"
 #include "llstl.h"
+#include "llthread.h"
 #include "lltimer.h"
 
 namespace {
@@ -808,7 +809,8 @@ namespace LLError
 
 namespace
 {
-	void writeToRecorders(LLError::ELevel level, const std::string& message)
+	// time is when the message was logged, or NULL for now.
+	void writeToRecorders(LLError::ELevel level, const std::string& message, const std::string* time)
 	{
 		LLError::Settings& s = LLError::Settings::get();
 	
@@ -824,7 +826,7 @@ namespace
 			{
 				if (messageWithTime.empty())
 				{
-					messageWithTime = s.timeFunction() + " " + message;
+					messageWithTime = (time ? *time : s.timeFunction()) + " " + message;
 				}
 				
 				r->recordMessage(level, messageWithTime);
@@ -929,6 +931,238 @@ namespace {
 			apr_thread_mutex_unlock(gLogMutexp);
 		}
 	}
+
+	// Messages waiting to be recorded by the log writer.  Any thread may
+	// push; only the writer pops.  Each slot's sequence number says whose
+	// turn it is: it equals the push position that may fill it, then one
+	// more once filled, then a lap on once the writer has emptied it.
+	class LogQueue
+	{
+	public:
+		LogQueue();
+		~LogQueue();
+
+		// ANY THREAD.  Takes the message and stamps it with the time now;
+		// false if the queue was full.
+		bool push(const LLError::CallSite& site, std::string& message);
+
+		// WRITER THREAD, or any thread once the writer is stopped: pops are
+		// made under the log lock, so writers never pop at the same time.
+		bool pop(const LLError::CallSite*& site, std::string& message, std::string& time);
+		void writeAll();
+		// Writes the next message; false if the log lock couldn't be had.
+		bool writeOne();
+		bool waitForMessages(volatile bool& quitting);
+
+		// ANY THREAD
+		bool empty();		// only a hint, away from the writer
+		void wakeWriter();
+
+		U32 getDropped() { return mDropped; }
+
+	private:
+		enum { SIZE = 8192 };	// power of two
+
+		struct Slot
+		{
+			LLAtomicU32					mSequence;
+			const LLError::CallSite*	mSite;
+			std::string					mMessage;
+			std::string					mTime;
+		};
+
+		Slot			mSlots[SIZE];
+		LLAtomicU32		mPushPos;
+		U32				mPopPos;
+		LLAtomicU32		mDropped;
+		LLAtomicU32		mWriterIdle;
+		LLCondition*	mSignal;
+	};
+
+	LogQueue::LogQueue()
+		: mPushPos(0), mPopPos(0), mDropped(0), mWriterIdle(0)
+	{
+		for (U32 i = 0; i < SIZE; ++i)
+		{
+			mSlots[i].mSequence = i;
+			mSlots[i].mSite = NULL;
+		}
+		mSignal = new LLCondition(NULL);
+	}
+
+	LogQueue::~LogQueue()
+	{
+		delete mSignal;
+	}
+
+	bool LogQueue::push(const LLError::CallSite& site, std::string& message)
+	{
+		// Recorders stamp messages as they write them, which for a queued
+		// message would be whenever the writer gets to it.
+		std::string time;
+		LLError::TimeFunction time_function = LLError::Settings::get().timeFunction;
+		if (time_function)
+		{
+			time = time_function();
+		}
+
+		U32 pos = mPushPos;
+		Slot* slot;
+		while (true)
+		{
+			slot = &mSlots[pos & (SIZE - 1)];
+			S32 diff = (S32)((U32)slot->mSequence - pos);
+			if (diff == 0)
+			{
+				U32 prev = mPushPos.compareAndSwap(pos, pos + 1);
+				if (prev == pos)
+				{
+					break;
+				}
+				pos = prev;		// another thread took it
+			}
+			else if (diff < 0)
+			{
+				// the writer hasn't emptied it since the last lap
+				mDropped++;
+				return false;
+			}
+			else
+			{
+				pos = mPushPos;
+			}
+		}
+
+		slot->mSite = &site;
+		slot->mMessage.swap(message);
+		slot->mTime.swap(time);
+		// publish (a full barrier, so the writer's idle flag is read after)
+		slot->mSequence += 1;
+
+		if (mWriterIdle)
+		{
+			wakeWriter();
+		}
+		return true;
+	}
+
+	bool LogQueue::pop(const LLError::CallSite*& site, std::string& message, std::string& time)
+	{
+		Slot& slot = mSlots[mPopPos & (SIZE - 1)];
+		if ((U32)slot.mSequence != mPopPos + 1)
+		{
+			return false;
+		}
+		site = slot.mSite;
+		message.clear();
+		message.swap(slot.mMessage);
+		time.clear();
+		time.swap(slot.mTime);
+		// free for the push one lap on
+		slot.mSequence += SIZE - 1;
+		++mPopPos;
+		return true;
+	}
+
+	bool LogQueue::empty()
+	{
+		return (U32)mSlots[mPopPos & (SIZE - 1)].mSequence != mPopPos + 1;
+	}
+
+	void LogQueue::writeAll()
+	{
+		while (!empty())
+		{
+			writeOne();
+		}
+	}
+
+	bool LogQueue::writeOne()
+	{
+		// Locked per message, so a thread logging from a new call site
+		// doesn't wait out a whole batch, and around the pop, so an error
+		// seeing the queue empty also sees its messages written.
+		LogLock lock;
+		if (!lock.ok())
+		{
+			return false;
+		}
+		const LLError::CallSite* site;
+		std::string message;
+		std::string time;
+		if (pop(site, message, time))
+		{
+			LLError::Log::write(*site, message, &time);
+		}
+		return true;
+	}
+
+	bool LogQueue::waitForMessages(volatile bool& quitting)
+	{
+		mSignal->lock();
+		// a full barrier, so push() sees this or we see its message
+		mWriterIdle++;
+		while (empty() && !quitting)
+		{
+			mSignal->wait();
+		}
+		mWriterIdle = 0;
+		mSignal->unlock();
+		return !quitting;
+	}
+
+	void LogQueue::wakeWriter()
+	{
+		mSignal->lock();
+		mSignal->signal();
+		mSignal->unlock();
+	}
+
+	class LogWriterThread : public LLThread
+	{
+	public:
+		LogWriterThread(LogQueue& queue)
+			: LLThread("Log Writer"), mQueue(queue), mQuitting(false), mReportedDropped(queue.getDropped())
+		{ }
+
+		// finish what's queued and return; delete to wait for it
+		void stop()
+		{
+			mQuitting = true;
+			mQueue.wakeWriter();
+		}
+
+	protected:
+		/*virtual*/ void run()
+		{
+			do
+			{
+				mQueue.writeAll();
+
+				U32 dropped = mQueue.getDropped();
+				if (dropped != mReportedDropped)
+				{
+					llwarns << "Log queue full, dropped " << dropped - mReportedDropped
+							<< " messages" << llendl;
+					mReportedDropped = dropped;
+				}
+			}
+			while (mQueue.waitForMessages(mQuitting));
+
+			mQueue.writeAll();
+		}
+
+	private:
+		LogQueue& mQueue;
+		volatile bool mQuitting;
+		U32 mReportedDropped;
+	};
+
+	// The queue is never deleted: a thread may still be pushing to it as
+	// async logging is turned off.
+	LogQueue* sLogQueue = NULL;
+	LogWriterThread* sLogWriter = NULL;
+	volatile bool sAsyncLogging = false;
 }
 
 namespace LLError
@@ -978,6 +1212,12 @@ namespace LLError
 
 	std::ostringstream* Log::out()
 	{
+		if (sAsyncLogging)
+		{
+			// the shared stream would need the lock
+			return new std::ostringstream;
+		}
+
 		LogLock lock;
 		if (lock.ok())
 		{
@@ -1027,15 +1267,40 @@ namespace LLError
 
 	void Log::flush(std::ostringstream* out, const CallSite& site)
 	{
+		Globals& g = Globals::get();
+
+		if (sAsyncLogging && out != &g.messageStream)
+		{
+			std::string message = out->str();
+			delete out;
+
+			if (site.mLevel != LEVEL_ERROR)
+			{
+				sLogQueue->push(site, message);
+				return;
+			}
+
+			// Errors go out now, after what's already queued, so they're the
+			// last thing in the log before the crash
+			for (S32 i = 0; i < 1000 && !sLogQueue->empty(); ++i)
+			{
+				ms_sleep(1);
+			}
+
+			LogLock lock;
+			if (lock.ok())
+			{
+				write(site, message);
+			}
+			return;
+		}
+
 		LogLock lock;
 		if (!lock.ok())
 		{
 			return;
 		}
 		
-		Globals& g = Globals::get();
-		Settings& s = Settings::get();
-
 		std::string message = out->str();
 		if (out == &g.messageStream)
 		{
@@ -1048,13 +1313,20 @@ namespace LLError
 			delete out;
 		}
 
+		write(site, message);
+	}
+
+	void Log::write(const CallSite& site, std::string& message, const std::string* time)
+	{
+		Settings& s = Settings::get();
+
 		if (site.mLevel == LEVEL_ERROR)
 		{
 			std::ostringstream fatalMessage;
 			fatalMessage << abbreviateFile(site.mFile)
 						<< "(" << site.mLine << ") : error";
 			
-			writeToRecorders(site.mLevel, fatalMessage.str());
+			writeToRecorders(site.mLevel, fatalMessage.str(), time);
 		}
 		
 		
@@ -1116,7 +1388,7 @@ namespace LLError
 		prefix << message;
 		message = prefix.str();
 		
-		writeToRecorders(site.mLevel, message);
+		writeToRecorders(site.mLevel, message, time);
 		
 		if (site.mLevel == LEVEL_ERROR  &&  s.crashFunction)
 		{
@@ -1128,6 +1400,61 @@ namespace LLError
 
 
 
+namespace LLError
+{
+	void setAsyncLogging(bool async)
+	{
+		if (async == (sLogWriter != NULL))
+		{
+			return;
+		}
+
+		if (async)
+		{
+			if (!sLogQueue)
+			{
+				sLogQueue = new LogQueue;
+			}
+			sLogWriter = new LogWriterThread(*sLogQueue);
+			sLogWriter->start();
+			sAsyncLogging = true;
+		}
+		else
+		{
+			sAsyncLogging = false;
+			// the writer records what's queued on its way out
+			sLogWriter->stop();
+			delete sLogWriter;
+			sLogWriter = NULL;
+			// and anything pushed while it was stopping
+			sLogQueue->writeAll();
+		}
+	}
+
+	void writeQueuedLogsForCrash(U32 max_ms)
+	{
+		sAsyncLogging = false;
+		if (!sLogQueue)
+		{
+			return;
+		}
+
+		// Don't wait on the writer thread: it may have crashed, or be
+		// waiting on a lock the crashed thread holds.  Each failed try at
+		// the log lock costs a few milliseconds, so this gives up in time.
+		LLTimer timer;
+		while (!sLogQueue->empty() && timer.getElapsedTimeF32() * 1000.f < (F32)max_ms)
+		{
+			sLogQueue->writeOne();
+		}
+	}
+
+	U32 getDroppedLogMessages()
+	{
+		return sLogQueue ? sLogQueue->getDropped() : 0;
+	}
+}
+
 namespace LLError
 {
 	Settings* saveAndResetSettings()
@@ -1216,9 +1543,16 @@ namespace LLError
 		const size_t BUF_SIZE = 64;
 		char time_str[BUF_SIZE];	/* Flawfinder: ignore */
 		
+#if LL_WINDOWS
+		// the CRT keeps gmtime()'s result per thread
+		struct tm* utc = gmtime(&now);
+#else
+		struct tm utc_buf;
+		struct tm* utc = gmtime_r(&now, &utc_buf);
+#endif
 		int chars = strftime(time_str, BUF_SIZE, 
 								  "%Y-%m-%dT%H:%M:%SZ",
-								  gmtime(&now));
+								  utc);
 
 		return chars ? time_str : "time error";
 	}
@@ -132,6 +132,9 @@ namespace LLError
 		static std::ostringstream* out();
 		static void flush(std::ostringstream* out, char* message)  ;
 		static void flush(std::ostringstream*, const CallSite&);
+		static void write(const CallSite&, std::string& message, const std::string* time = NULL);
+			// formats and records a message, with the log lock held; time
+			// is when it was logged, if not now
 	};
 	
 	class LL_COMMON_API CallSite
@@ -157,6 +157,22 @@ namespace LLError
 	LL_COMMON_API std::string logFileName();
 		// returns name of current logging file, empty string if none
 
+	LL_COMMON_API void setAsyncLogging(bool async);
+		// When on, messages below LEVEL_ERROR are queued and formatted and
+		// recorded on a background thread, so the logging thread never
+		// waits on a recorder.  The queue holds a fixed number of messages;
+		// when it is full further messages are dropped and counted.
+		// Errors are still recorded on the spot, after whatever is queued.
+		// Turning it off records anything still queued first.  Messages
+		// keep the time they were logged, so the time function must be
+		// safe to call from any thread.
+	LL_COMMON_API void writeQueuedLogsForCrash(U32 max_ms);
+		// For crash handlers: turns async logging off and records what's
+		// queued on the calling thread, without waiting for the writer
+		// thread, giving up after max_ms if the log lock can't be had.
+	LL_COMMON_API U32 getDroppedLogMessages();
+		// messages dropped for a full queue since startup
+
 
 	/*
 		Utilities for use by the unit tests of LLError itself.
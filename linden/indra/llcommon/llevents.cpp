@@ -58,6 +58,7 @@
 #include "stringize.h"
 #include "llerror.h"
 #include "llsdutil.h"
+#include "lltimer.h"
 #if LL_MSVC
 #pragma warning (disable : 4702)
 #endif
@@ -76,6 +77,19 @@ const char* queue_names[] =
     "placeholder - replace with first real name string"
 };
 
+/*****************************************************************************
+*   batch_names: specify LLEventPump names that should be instantiated as
+*   LLEventBatchPump
+*****************************************************************************/
+/**
+ * Pumps posted often enough that LLEventStream's per-post overhead is worth
+ * avoiding. Like queue_names, this belongs in a configuration file someday.
+ */
+const char* batch_names[] =
+{
+    "mainloop"
+};
+
 /*****************************************************************************
 *   If there's a "mainloop" pump, listen on that to flush all LLEventQueues
 *****************************************************************************/
@@ -105,7 +119,8 @@ static RegisterFlush registerFlush;
 LLEventPumps::LLEventPumps():
     // Until we migrate this information to an external config file,
     // initialize mQueueNames from the static queue_names array.
-    mQueueNames(boost::begin(queue_names), boost::end(queue_names))
+    mQueueNames(boost::begin(queue_names), boost::end(queue_names)),
+    mBatchNames(boost::begin(batch_names), boost::end(batch_names))
 {
 }
 
@@ -120,10 +135,12 @@ LLEventPump& LLEventPumps::obtain(const std::string& name)
     }
     // Here we must instantiate an LLEventPump subclass. 
     LLEventPump* newInstance;
-    // Should this name be an LLEventQueue?
+    // Should this name be an LLEventQueue? An LLEventBatchPump?
     PumpNames::const_iterator nfound = mQueueNames.find(name);
     if (nfound != mQueueNames.end())
         newInstance = new LLEventQueue(name);
+    else if (mBatchNames.find(name) != mBatchNames.end())
+        newInstance = new LLEventBatchPump(name);
     else
         newInstance = new LLEventStream(name);
     // LLEventPump's constructor implicitly registers each new instance in
@@ -133,6 +150,25 @@ LLEventPump& LLEventPumps::obtain(const std::string& name)
     return *newInstance;
 }
 
+LLEventBatchPump& LLEventPumps::obtainBatch(const std::string& name)
+{
+    PumpMap::iterator found = mPumpMap.find(name);
+    if (found == mPumpMap.end())
+    {
+        // Same bookkeeping as obtain()
+        LLEventBatchPump* newInstance = new LLEventBatchPump(name);
+        mOurPumps.insert(newInstance);
+        return *newInstance;
+    }
+    LLEventBatchPump* pump = dynamic_cast<LLEventBatchPump*>(found->second);
+    if (! pump)
+    {
+        throw BadPumpType(std::string("LLEventPump '") + name + "' is a " +
+                          typeid(*found->second).name() + ", not an LLEventBatchPump");
+    }
+    return *pump;
+}
+
 void LLEventPumps::flush()
 {
     // Flush every known LLEventPump instance. Leave it up to each instance to
@@ -302,6 +338,13 @@ void LLEventPump::reset()
 LLBoundListener LLEventPump::listen_impl(const std::string& name, const LLEventListener& listener,
                                          const NameList& after,
                                          const NameList& before)
+{
+    LLBoundListener bound = mSignal->connect(placeListener(name, after, before), listener);
+    mConnections[name] = bound;
+    return bound;
+}
+
+float LLEventPump::placeListener(const std::string& name, const NameList& after, const NameList& before)
 {
     // Check for duplicate name before connecting listener to mSignal
     ConnectionMap::const_iterator found = mConnections.find(name);
@@ -438,11 +481,8 @@ LLBoundListener LLEventPump::listen_impl(const std::string& name, const LLEventL
         // 1.0 and use that.
         newNode = std::ceil(myprev) + 1.0;
     }
-    // Now that newNode has a value that places it appropriately in mSignal,
-    // connect it.
-    LLBoundListener bound = mSignal->connect(newNode, listener);
-    mConnections[name] = bound;
-    return bound;
+    // Now newNode has a value that places it appropriately in mSignal.
+    return newNode;
 }
 
 LLBoundListener LLEventPump::getListener(const std::string& name) const
@@ -536,6 +576,207 @@ void LLEventQueue::flush()
     }
 }
 
+/*****************************************************************************
+*   LLEventBatchPump
+*****************************************************************************/
+LLEventBatchPump::LLEventBatchPump(const std::string& name, bool tweak):
+    LLEventPump(name, tweak),
+    mEventSignal(new EventSignal())
+{}
+
+LLEventBatchPump::~LLEventBatchPump()
+{
+}
+
+bool LLEventBatchPump::post(const LLSD& event)
+{
+    if (! mEnabled)
+    {
+        return false;
+    }
+    // DEV-43463: a listener might destroy this pump. See LLEventStream::post().
+    boost::shared_ptr<EventSignal> signal(mEventSignal);
+    return (*signal)(event);
+}
+
+bool LLEventBatchPump::postBatch_impl(const std::type_info& type, const void* events, size_t count)
+{
+    if (! (mEnabled && count))
+    {
+        return false;
+    }
+    boost::shared_ptr<Batches> batches(findBatches(type));
+    if (! batches)
+    {
+        // nobody's listening
+        return false;
+    }
+    boost::shared_ptr<BatchSignal> signal(batches->mSignal);
+    return (*signal)(events, count);
+}
+
+void LLEventBatchPump::queue_impl(const std::type_info& type, const void* event, size_t size)
+{
+    if (! mEnabled)
+    {
+        return;
+    }
+    std::vector<char>& queued(findBatches(type, size)->mQueued);
+    const char* bytes = static_cast<const char*>(event);
+    queued.insert(queued.end(), bytes, bytes + size);
+}
+
+void LLEventBatchPump::flush()
+{
+    // Index rather than iterate: a listener might add a new type to
+    // mBatches.
+    for (size_t i = 0; i < mBatches.size(); ++i)
+    {
+        boost::shared_ptr<Batches> batches(mBatches[i]);
+        if (batches->mQueued.empty())
+        {
+            continue;
+        }
+        // As with LLEventQueue::flush(), anything listeners queue while we
+        // deliver waits for the next flush().
+        batches->mFlushing.swap(batches->mQueued);
+        boost::shared_ptr<BatchSignal> signal(batches->mSignal);
+        (*signal)(&batches->mFlushing[0], batches->mFlushing.size() / batches->mSize);
+        batches->mFlushing.clear();
+    }
+}
+
+void LLEventBatchPump::reset()
+{
+    // same as LLEventPump::reset(), for our signals too
+    mSignal.reset();
+    mEventSignal.reset();
+    mBatches.clear();
+    mConnections.clear();
+}
+
+LLBoundListener LLEventBatchPump::listen_impl(const std::string& name, const LLEventListener& listener,
+                                              const NameList& after,
+                                              const NameList& before)
+{
+    LLBoundListener bound = mEventSignal->connect(placeListener(name, after, before), listener);
+    mConnections[name] = bound;
+    return bound;
+}
+
+LLBoundListener LLEventBatchPump::listenBatch_impl(const std::string& name,
+                                                   const std::type_info& type, size_t size,
+                                                   const BatchSignal::slot_type& listener,
+                                                   const NameList& after, const NameList& before)
+{
+    // Placement values come from the same mDeps for every signal, so batch
+    // listeners keep the order they'd have on one LLStandardSignal.
+    float placement = placeListener(name, after, before);
+    LLBoundListener bound = findBatches(type, size)->mSignal->connect(placement, listener);
+    mConnections[name] = bound;
+    return bound;
+}
+
+boost::shared_ptr<LLEventBatchPump::Batches>
+LLEventBatchPump::findBatches(const std::type_info& type, size_t size)
+{
+    for (BatchesList::const_iterator bi(mBatches.begin()), bend(mBatches.end()); bi != bend; ++bi)
+    {
+        if (*(*bi)->mType == type)
+        {
+            return *bi;
+        }
+    }
+    if (! size)
+    {
+        return boost::shared_ptr<Batches>();
+    }
+    mBatches.push_back(boost::shared_ptr<Batches>(new Batches(type, size)));
+    return mBatches.back();
+}
+
+namespace
+{
+    // what benchmark() sends in batches
+    struct BenchmarkSample
+    {
+        F32 mValue;
+        U32 mFrame;
+    };
+
+    struct BenchmarkListener
+    {
+        BenchmarkListener(): mTotal(0) {}
+        bool onEvent(const LLSD& event)
+        {
+            mTotal += event.asInteger();
+            return false;
+        }
+        bool onBatch(const BenchmarkSample* samples, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                mTotal += samples[i].mFrame;
+            }
+            return false;
+        }
+        S64 mTotal;
+    };
+}
+
+// static
+void LLEventBatchPump::benchmark(S32 listeners, S32 batch_size)
+{
+    const S32 EVENTS = 200000;
+    batch_size = llmax(batch_size, 1);
+    std::vector<BenchmarkListener> counters(listeners);
+    LLEventStream stream("benchmarkStream", true);
+    LLEventBatchPump pump("benchmarkBatch", true);
+    for (S32 i = 0; i < listeners; ++i)
+    {
+        std::string name(LLEventPump::inventName("benchmark"));
+        stream.listen(name, boost::bind(&BenchmarkListener::onEvent, &counters[i], _1));
+        pump.listen(name, boost::bind(&BenchmarkListener::onEvent, &counters[i], _1));
+        pump.listenBatch<BenchmarkSample>(name + "Batch",
+                                          boost::bind(&BenchmarkListener::onBatch, &counters[i], _1, _2));
+    }
+
+    LLSD event(1);
+    LLTimer timer;
+    for (S32 i = 0; i < EVENTS; ++i)
+    {
+        stream.post(event);
+    }
+    F64 stream_ns = timer.getElapsedTimeF64() * 1.0e9 / EVENTS;
+
+    timer.reset();
+    for (S32 i = 0; i < EVENTS; ++i)
+    {
+        pump.post(event);
+    }
+    F64 pump_ns = timer.getElapsedTimeF64() * 1.0e9 / EVENTS;
+
+    std::vector<BenchmarkSample> samples(batch_size);
+    for (S32 i = 0; i < batch_size; ++i)
+    {
+        samples[i].mValue = 0.f;
+        samples[i].mFrame = 1;
+    }
+    S32 batches = llmax(EVENTS / batch_size, 1);
+    timer.reset();
+    for (S32 i = 0; i < batches; ++i)
+    {
+        pump.postBatch(&samples[0], batch_size);
+    }
+    F64 batch_ns = timer.getElapsedTimeF64() * 1.0e9 / (batches * batch_size);
+
+    LL_INFOS("LLEventBatchPump") << "Event pump benchmark: " << listeners
+                                 << " listeners, ns per event: LLEventStream " << stream_ns
+                                 << ", LLEventBatchPump " << pump_ns
+                                 << ", batches of " << batch_size << " structs " << batch_ns
+                                 << LL_ENDL;
+}
+
 /*****************************************************************************
 *   LLListenerOrPumpName
 *****************************************************************************/
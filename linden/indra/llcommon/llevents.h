@@ -38,6 +38,7 @@
 #include <vector>
 #include <deque>
 #include <stdexcept>
+#include <typeinfo>
 #if LL_WINDOWS
 	#pragma warning (push)
 	#pragma warning (disable : 4263) // boost::signals2::expired_slot::what() has const mismatch
@@ -202,6 +203,7 @@ private:
 *   LLEventPumps
 *****************************************************************************/
 class LLEventPump;
+class LLEventBatchPump;
 
 /**
  * LLEventPumps is a Singleton manager through which one typically accesses
@@ -217,6 +219,23 @@ public:
      * an instance without conferring @em ownership.
      */
     LLEventPump& obtain(const std::string& name);
+    /**
+     * Exception thrown by obtainBatch(): the named LLEventPump already exists
+     * but isn't an LLEventBatchPump.
+     */
+    struct BadPumpType: public std::runtime_error
+    {
+        BadPumpType(const std::string& what):
+            std::runtime_error(std::string("BadPumpType: ") + what) {}
+    };
+    /**
+     * Like obtain(), but for callers that want LLEventBatchPump's batch
+     * methods. Creates an LLEventBatchPump if there's no LLEventPump by that
+     * name yet. A name that everyone should see as an LLEventBatchPump, no
+     * matter who calls obtain() first, belongs in batch_names in
+     * llevents.cpp.
+     */
+    LLEventBatchPump& obtainBatch(const std::string& name);
     /**
      * Flush all known LLEventPump instances
      */
@@ -262,6 +281,8 @@ testable:
     // than as LLEventStream
     typedef std::set<std::string> PumpNames;
     PumpNames mQueueNames;
+    // LLEventPump names that should be instantiated as LLEventBatchPump
+    PumpNames mBatchNames;
 };
 
 /*****************************************************************************
@@ -548,6 +569,14 @@ private:
     std::string mName;
 
 protected:
+    /**
+     * Work out where listener @a name goes among the others, given its
+     * dependencies, and return the placement value for the connect() call.
+     * Throws DupListenerName, Cycle or OrderChange like listen(). A subclass
+     * with its own signals uses this to keep one order across all of them.
+     */
+    float placeListener(const std::string& name, const NameList& after, const NameList& before);
+
     /// implement the dispatching
     boost::shared_ptr<LLStandardSignal> mSignal;
 
@@ -610,6 +639,141 @@ private:
     EventQueue mEventQueue;
 };
 
+/*****************************************************************************
+*   LLEventBatchPump
+*****************************************************************************/
+/**
+ * LLEventBatchPump isa LLEventPump for traffic heavy enough that
+ * LLEventStream's overhead shows: "mainloop" fires every frame. Posting an
+ * event immediately calls all registered listeners, as with LLEventStream,
+ * but this pump's signals use boost::signals2::dummy_mutex, so connecting,
+ * disconnecting and calling listeners takes no lock. The price is that
+ * only the thread that owns the pump may use it -- which is how LLEventPumps
+ * get used in any case.
+ *
+ * It also carries arrays of small plain-old-data structs, which never get
+ * turned into LLSD. A batch listener is registered for one struct type and
+ * receives a pointer and a count:
+ * @code
+ * struct Tick { F32 dt; U32 frame; };
+ * pump.listenBatch<Tick>("ticker", boost::bind(&Ticker::onTicks, this, _1, _2));
+ * pump.postBatch(ticks, count);   // call listeners now, or
+ * pump.queue(tick);               // gather until LLEventPumps::flush()
+ * @endcode
+ * T must be safe to copy with memcpy(). Batches of type T go only to
+ * listenBatch<T>() listeners; post() goes only to listen() listeners. All
+ * of them share one set of listener names and one order.
+ */
+class LL_COMMON_API LLEventBatchPump: public LLEventPump
+{
+public:
+    LLEventBatchPump(const std::string& name, bool tweak=false);
+    virtual ~LLEventBatchPump();
+
+    /// Post an event to all (non-batch) listeners
+    virtual bool post(const LLSD& event);
+
+    /**
+     * Register a listener for batches of @a T, callable as
+     * <tt>bool(const T* events, size_t count)</tt>. Otherwise just like
+     * listen(), including which bound objects get tracked.
+     */
+    template <typename T, typename LISTENER>
+    LLBoundListener listenBatch(const std::string& name, const LISTENER& listener,
+                                const NameList& after=NameList(),
+                                const NameList& before=NameList());
+
+    /// Pass @a count events of type @a T to each listenBatch<T>() listener
+    /// in turn, stopping if one returns @c true.
+    template <typename T>
+    bool postBatch(const T* events, size_t count)
+    {
+        return postBatch_impl(typeid(T), events, count);
+    }
+
+    /// Copy @a event to be delivered, with any others of its type, on the
+    /// next flush()
+    template <typename T>
+    void queue(const T& event)
+    {
+        queue_impl(typeid(T), &event, sizeof(T));
+    }
+
+    /**
+     * Log ns/event for LLEventStream, for LLEventBatchPump posting LLSD and
+     * for LLEventBatchPump delivering batches of @a batch_size small structs,
+     * each with @a listeners listeners.
+     */
+    static void benchmark(S32 listeners, S32 batch_size);
+
+    typedef boost::signals2::signal<bool(const LLSD&), LLStopWhenHandled, float,
+                                    std::less<float>,
+                                    boost::function<bool(const LLSD&)>,
+                                    boost::function<bool(const boost::signals2::connection&,
+                                                         const LLSD&)>,
+                                    boost::signals2::dummy_mutex> EventSignal;
+    typedef boost::signals2::signal<bool(const void*, size_t), LLStopWhenHandled, float,
+                                    std::less<float>,
+                                    boost::function<bool(const void*, size_t)>,
+                                    boost::function<bool(const boost::signals2::connection&,
+                                                         const void*, size_t)>,
+                                    boost::signals2::dummy_mutex> BatchSignal;
+
+private:
+    /// Recover the type BatchSignal erases
+    template <typename T>
+    struct BatchCaller
+    {
+        typedef boost::function<bool(const T*, size_t)> Function;
+        BatchCaller(const Function& function): mFunction(function) {}
+        bool operator()(const void* events, size_t count) const
+        {
+            return mFunction(static_cast<const T*>(events), count);
+        }
+        Function mFunction;
+    };
+
+    /// everything about one batch type
+    struct Batches
+    {
+        Batches(const std::type_info& type, size_t size):
+            mType(&type),
+            mSize(size),
+            mSignal(new BatchSignal())
+        {}
+        const std::type_info* mType;
+        size_t mSize;
+        boost::shared_ptr<BatchSignal> mSignal;
+        /// queue() appends here; flush() swaps it with mFlushing. Both keep
+        /// their capacity from frame to frame.
+        std::vector<char> mQueued, mFlushing;
+    };
+    typedef std::vector< boost::shared_ptr<Batches> > BatchesList;
+
+    virtual void flush();
+    virtual void reset();
+    virtual LLBoundListener listen_impl(const std::string& name, const LLEventListener&,
+                                        const NameList& after,
+                                        const NameList& before);
+
+    LLBoundListener listenBatch_impl(const std::string& name,
+                                     const std::type_info& type, size_t size,
+                                     const BatchSignal::slot_type& listener,
+                                     const NameList& after, const NameList& before);
+    bool postBatch_impl(const std::type_info& type, const void* events, size_t count);
+    void queue_impl(const std::type_info& type, const void* event, size_t size);
+    /// NULL if nobody has used @a type yet, unless @a size is passed
+    boost::shared_ptr<Batches> findBatches(const std::type_info& type, size_t size=0);
+
+    /// stands in for a batch listener while listenBatch() collects what to track
+    static bool neverCalled(const LLSD&) { return false; }
+
+    boost::shared_ptr<EventSignal> mEventSignal;
+    /// one entry per type. Only a handful of types ever share a pump, so
+    /// findBatches() searches it linearly.
+    BatchesList mBatches;
+};
+
 /*****************************************************************************
 *   LLReqID
 *****************************************************************************/
@@ -1014,6 +1178,26 @@ namespace LLEventDetail
     }
 } // namespace LLEventDetail
 
+template <typename T, typename LISTENER>
+LLBoundListener LLEventBatchPump::listenBatch(const std::string& name, const LISTENER& listener,
+                                              const NameList& after,
+                                              const NameList& before)
+{
+    // Inspect listener before erasing its type, as visit_and_connect() does:
+    // constructing a slot from it finds bound LLEventTrackables, and Visitor
+    // finds bound weak_ptrs. Pass both on to the type-erased slot.
+    boost::signals2::slot<bool(const T*, size_t)> typed(listener);
+    LLEventListener tracker(&LLEventBatchPump::neverCalled);
+    LLEventDetail::Visitor visitor(tracker);
+    using boost::visit_each;
+    visit_each(visitor, LLEventDetail::unwrap(listener));
+    typename BatchCaller<T>::Function function(listener);
+    BatchSignal::slot_type erased((BatchCaller<T>(function)));
+    erased.track(typed);
+    erased.track(tracker);
+    return listenBatch_impl(name, typeid(T), sizeof(T), erased, after, before);
+}
+
 // Somewhat to my surprise, passing boost::bind(...boost::weak_ptr<T>...) to
 // listen() fails in Boost code trying to instantiate LLEventListener (i.e.
 // LLStandardSignal::slot_type) because the boost::get_pointer() utility function isn't
@@ -29,7 +29,9 @@
 
 #include "llmemory.h"
 #include "llprocessor.h"
+#include "llfile.h"
 #include "llsingleton.h"
+#include "llthread.h"
 #include "lltreeiterators.h"
 #include "llsdserialize.h"
 
@@ -59,6 +61,18 @@ BOOL LLFastTimer::sLog = FALSE;
 BOOL LLFastTimer::sMetricLog = FALSE;
 LLMutex* LLFastTimer::sLogLock = NULL;
 std::queue<LLSD> LLFastTimer::sLogQueue;
+LLMutex* LLFastTimer::sThreadMutex = NULL;
+std::vector<LLFastTimer::ThreadTimers*>* LLFastTimer::sThreadTimers = NULL;
+bool LLFastTimer::sCollectingThreads = false;
+bool LLFastTimer::sRecording = false;
+LLFastTimer::EventBuffer* LLFastTimer::sMainEvents = NULL;
+U32 LLFastTimer::sMainThreadID = 0;
+U32 LLFastTimer::sEventBufferSize = 0;
+F32 LLFastTimer::sSpikeThresholdMS = 0.f;
+F32 LLFastTimer::sSpikeSeconds = 0.f;
+std::string LLFastTimer::sSpikePrefix;
+U64 LLFastTimer::sLastSpikeTime = 0;
+U32 LLFastTimer::sSpikeCount = 0;
 
 #if LL_LINUX || LL_SOLARIS
 U64 LLFastTimer::sClockResolution = 1000000000; // Nanosecond resolution
@@ -70,6 +84,236 @@ std::vector<LLFastTimer::FrameState>* LLFastTimer::sTimerInfos = NULL;
 U64				LLFastTimer::sTimerCycles = 0;
 U32				LLFastTimer::sTimerCalls = 0;
 
+//////////////////////////////////////////////////////////////////////////////
+// timeline recording
+
+// The last mSize timer events on one thread.  Only that thread pushes; the
+// main thread copies the buffer out while it may still be pushing, and
+// drops whatever could have been overwritten during the copy.
+class LLFastTimer::EventBuffer
+{
+public:
+	struct Event
+	{
+		U64			mTime;
+		NamedTimer*	mTimer;		// NULL for frame markers
+		U32			mType;
+	};
+
+	EventBuffer(U32 size)
+	:	mSize(size),
+		mHead(0),
+		mFull(false)
+	{
+		// size is a power of two, so the index wraps with the counter
+		mEvents = new Event[size];
+	}
+
+	~EventBuffer()
+	{
+		delete[] mEvents;
+	}
+
+	// OWNING THREAD
+	void push(U32 type, NamedTimer* timer)
+	{
+		U32 head = mHead;
+		Event& event = mEvents[head & (mSize - 1)];
+		event.mTime = getCPUClockCount64();
+		event.mTimer = timer;
+		event.mType = type;
+		if (head + 1 == mSize)
+		{
+			mFull = true;
+		}
+		mHead++;
+	}
+
+	// ANY THREAD.  Oldest first.
+	void read(std::vector<Event>& events)
+	{
+		U32 end = mHead;
+		U32 count = mFull ? mSize : llmin(end, mSize);
+		events.resize(count);
+		for (U32 i = 0; i < count; i++)
+		{
+			events[i] = mEvents[(end - count + i) & (mSize - 1)];
+		}
+
+		// pushes since we started, and the one that may be in progress,
+		// overwrite the oldest entries once they wrap around to them
+		U32 pushed = (U32)mHead - end + 1;
+		if (count + pushed > mSize)
+		{
+			U32 overwritten = llmin(count + pushed - mSize, count);
+			events.erase(events.begin(), events.begin() + overwritten);
+		}
+	}
+
+private:
+	Event*		mEvents;
+	U32			mSize;
+	LLAtomicU32	mHead;
+	bool		mFull;
+};
+
+// A copy of the recorded events, and the file formats for it
+struct LLFastTimer::Timeline
+{
+	struct Event
+	{
+		U64	mTime;
+		U32	mName;		// index into mNames, FRAME_NAME for frame markers
+		U32	mType;
+	};
+
+	struct Thread
+	{
+		std::string			mName;
+		std::vector<Event>	mEvents;
+	};
+
+	enum { FRAME_NAME = 0xffffffff };
+
+	U64							mCountsPerSecond;
+	U64							mStartTime;
+	U64							mEndTime;
+	std::vector<std::string>	mNames;
+	std::vector<Thread>			mThreads;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// per thread timer state
+
+// A worker thread's timer stack, plus the call tree it has built so far.
+// Everything here except the merge bookkeeping is written by the owning
+// thread alone.  Nodes are only ever appended, and each one is filled in
+// before mNumNodes is bumped, so the main thread can read any node below
+// mNumNodes without locking.  It reads the counters while the worker may be
+// adding to them, which is fine for aligned U32s: anything it misses turns
+// up on the next frame.
+class LLFastTimer::ThreadTimers
+{
+public:
+	enum { MAX_NODES = 512 };
+
+	struct Node : public FrameState
+	{
+		Node()
+		:	FrameState(NULL),
+			mFirstChild(NULL),
+			mNextSibling(NULL),
+			mMergedTimer(NULL),
+			mMergedTime(0),
+			mMergedCalls(0)
+		{}
+
+		// owning thread only
+		Node*		mFirstChild;
+		Node*		mNextSibling;
+
+		// main thread only: the timer this node is shown as, and the counts
+		// already added to it
+		NamedTimer*	mMergedTimer;
+		U32			mMergedTime;
+		U32			mMergedCalls;
+	};
+
+	ThreadTimers(const std::string& name)
+	:	mName(name),
+		mNumNodes(1),
+		mNumMerged(0),
+		mFinished(false),
+		mDone(false),
+		mListed(false),
+		mWarnedFull(false),
+		mEvents(NULL)
+	{
+		mCurTimerData.mCurTimer = NULL;
+		mCurTimerData.mFrameState = &mNodes[0];
+		mCurTimerData.mChildTime = 0;
+	}
+
+	~ThreadTimers()
+	{
+		delete mEvents;
+	}
+
+	// OWNING THREAD.  Finds or adds the node for timer called from parent.
+	FrameState* getChild(FrameState* parent_state, NamedTimer* timer)
+	{
+		Node* parent = static_cast<Node*>(parent_state);
+		for (Node* child = parent->mFirstChild; child; child = child->mNextSibling)
+		{
+			if (child->mTimer == timer)
+			{
+				return child;
+			}
+		}
+
+		U32 count = mNumNodes;
+		if (count >= MAX_NODES)
+		{
+			// Out of room: charge the time to the caller instead
+			if (!mWarnedFull)
+			{
+				mWarnedFull = true;
+				llwarns << "Too many fast timers on thread " << mName << llendl;
+			}
+			return parent;
+		}
+
+		Node* node = &mNodes[count];
+		node->mTimer = timer;
+		node->mParent = parent;
+		node->mNextSibling = parent->mFirstChild;
+		parent->mFirstChild = node;
+		mNumNodes++;
+		return node;
+	}
+
+	std::string		mName;
+	CurTimerData	mCurTimerData;
+	Node			mNodes[MAX_NODES];	// mNodes[0] is the thread itself
+	LLAtomicU32		mNumNodes;
+	U32				mNumMerged;			// main thread only
+	bool			mFinished;			// under sThreadMutex
+	bool			mDone;				// all counted, main thread only
+	bool			mListed;
+	bool			mWarnedFull;
+	EventBuffer*	mEvents;			// set before recording starts
+};
+
+// Compilers can do thread local pointers directly everywhere but on the Mac.
+#if defined(LL_FAST_TIMER_THREAD_LOCAL)
+LL_FAST_TIMER_THREAD_LOCAL LLFastTimer::ThreadTimers* LLFastTimer::sCurThreadTimers = NULL;
+#elif LL_WINDOWS
+static __declspec(thread) LLFastTimer::ThreadTimers* sCurThreadTimers = NULL;
+
+static inline LLFastTimer::ThreadTimers* get_thread_timers() { return sCurThreadTimers; }
+static inline void set_thread_timers(LLFastTimer::ThreadTimers* timers) { sCurThreadTimers = timers; }
+#else
+static pthread_key_t sThreadTimersKey;
+static pthread_once_t sThreadTimersOnce = PTHREAD_ONCE_INIT;
+
+static void create_thread_timers_key()
+{
+	pthread_key_create(&sThreadTimersKey, NULL);
+}
+
+static inline LLFastTimer::ThreadTimers* get_thread_timers()
+{
+	pthread_once(&sThreadTimersOnce, create_thread_timers_key);
+	return (LLFastTimer::ThreadTimers*)pthread_getspecific(sThreadTimersKey);
+}
+
+static inline void set_thread_timers(LLFastTimer::ThreadTimers* timers)
+{
+	pthread_once(&sThreadTimersOnce, create_thread_timers_key);
+	pthread_setspecific(sThreadTimersKey, timers);
+}
+#endif
+
 
 // FIXME: move these declarations to the relevant modules
 
@@ -133,6 +377,7 @@ public:
 	~NamedTimerFactory()
 	{
 		std::for_each(mTimers.begin(), mTimers.end(), DeletePairedPointer());
+		std::for_each(mThreadTimers.begin(), mThreadTimers.end(), DeletePointer());
 
 		delete mAppTimer;
 		delete mActiveTimerRoot; 
@@ -165,6 +410,41 @@ public:
 		return NULL;
 	}
 
+	// Threads with the same name share a root, and so add up.
+	LLFastTimer::NamedTimer& getThreadRootTimer(const std::string& name)
+	{
+		for (std::vector<LLFastTimer::NamedTimer*>::iterator it = mThreadRoots.begin();
+			it != mThreadRoots.end();
+			++it)
+		{
+			if ((*it)->getName() == name)
+			{
+				return **it;
+			}
+		}
+
+		LLFastTimer::NamedTimer& root = createThreadTimer(name, mTimerRoot);
+		root.setCollapsed(false);
+		mThreadRoots.push_back(&root);
+		return root;
+	}
+
+	LLFastTimer::NamedTimer& getThreadTimer(const std::string& name, LLFastTimer::NamedTimer* parent)
+	{
+		for (LLFastTimer::NamedTimer::child_const_iter it = parent->beginChildren();
+			it != parent->endChildren();
+			++it)
+		{
+			if ((*it)->getName() == name)
+			{
+				return **it;
+			}
+		}
+		return createThreadTimer(name, parent);
+	}
+
+	const std::vector<LLFastTimer::NamedTimer*>& getThreadRoots() { return mThreadRoots; }
+
 	LLFastTimer::NamedTimer* getActiveRootTimer() { return mActiveTimerRoot; }
 	LLFastTimer::NamedTimer* getRootTimer() { return mTimerRoot; }
 	const LLFastTimer* getAppTimer() { return mAppTimer; }
@@ -176,7 +456,18 @@ public:
 	S32 timerCount() { return mTimers.size(); }
 
 private:
+	LLFastTimer::NamedTimer& createThreadTimer(const std::string& name, LLFastTimer::NamedTimer* parent)
+	{
+		LLFastTimer::NamedTimer* timer = new LLFastTimer::NamedTimer(name);
+		timer->mThreadTimer = true;
+		timer->setParent(parent);
+		mThreadTimers.push_back(timer);
+		return *timer;
+	}
+
 	timer_map_t mTimers;
+	std::vector<LLFastTimer::NamedTimer*> mThreadTimers;
+	std::vector<LLFastTimer::NamedTimer*> mThreadRoots;
 
 	LLFastTimer::NamedTimer*		mActiveTimerRoot;
 	LLFastTimer::NamedTimer*		mTimerRoot;
@@ -259,7 +550,8 @@ LLFastTimer::NamedTimer::NamedTimer(const std::string& name)
 	mTotalTimeCounter(0),
 	mCountAverage(0),
 	mCallAverage(0),
-	mNeedsSorting(false)
+	mNeedsSorting(false),
+	mThreadTimer(false)
 {
 	info_list_t& frame_state_list = getFrameStateList();
 	mFrameStateIndex = frame_state_list.size();
@@ -340,6 +632,7 @@ void LLFastTimer::NamedTimer::processTimes()
 {
 	if (sCurFrameIndex < 0) return;
 
+	mergeThreadTimes();
 	buildHierarchy();
 	accumulateTimings();
 }
@@ -376,6 +669,8 @@ void LLFastTimer::NamedTimer::buildHierarchy()
 		{
 			NamedTimer& timer = *it;
 			if (&timer == NamedTimerFactory::instance().getRootTimer()) continue;
+			// worker call trees are exact, they never move
+			if (timer.mThreadTimer) continue;
 			
 			// bootstrap tree construction by attaching to last timer to be on stack
 			// when this timer was called
@@ -450,8 +745,20 @@ void LLFastTimer::NamedTimer::accumulateTimings()
 		cur_timer = cur_timer->mLastTimerData.mCurTimer;
 	}
 
+	accumulateTree(*NamedTimerFactory::instance().getActiveRootTimer());
+
+	const std::vector<NamedTimer*>& thread_roots = NamedTimerFactory::instance().getThreadRoots();
+	for (std::vector<NamedTimer*>::const_iterator it = thread_roots.begin(); it != thread_roots.end(); ++it)
+	{
+		accumulateTree(**it);
+	}
+}
+
+//static
+void LLFastTimer::NamedTimer::accumulateTree(NamedTimer& root)
+{
 	// traverse tree in DFS post order, or bottom up
-	for(timer_tree_bottom_up_iterator_t it = begin_timer_tree_bottom_up(*NamedTimerFactory::instance().getActiveRootTimer());
+	for(timer_tree_bottom_up_iterator_t it = begin_timer_tree_bottom_up(root);
 		it != end_timer_tree_bottom_up();
 		++it)
 	{
@@ -493,6 +800,8 @@ void LLFastTimer::NamedTimer::resetFrame()
 			     ++it)
 			{
 				NamedTimer& timer = *it;
+				// worker threads run alongside the frame, leave them out of its total
+				if (timer.mThreadTimer) continue;
 				FrameState& info = timer.getFrameState();
 				sd[timer.getName()]["Time"] = (LLSD::Real) (info.mSelfTimeCounter*iclock_freq);	
 				sd[timer.getName()]["Calls"] = (LLSD::Integer) info.mCalls;
@@ -588,7 +897,7 @@ void LLFastTimer::NamedTimer::reset()
 		     ++it)
 		{
 			NamedTimer& timer = *it;
-			if (&timer != NamedTimerFactory::instance().getRootTimer()) 
+			if (&timer != NamedTimerFactory::instance().getRootTimer() && !timer.mThreadTimer)
 			{
 				timer.setParent(NamedTimerFactory::instance().getRootTimer());
 			}
@@ -602,6 +911,10 @@ void LLFastTimer::NamedTimer::reset()
 
 	sLastFrameIndex = 0;
 	sCurFrameIndex = 0;
+
+	// from here on someone reads the timers, so finished threads wait for
+	// their last counts to be merged
+	sCollectingThreads = true;
 }
 
 //static 
@@ -643,6 +956,79 @@ LLFastTimer::NamedTimer& LLFastTimer::NamedTimer::getRootNamedTimer()
 	return *NamedTimerFactory::instance().getActiveRootTimer(); 
 }
 
+// static
+const std::vector<LLFastTimer::NamedTimer*>& LLFastTimer::NamedTimer::getThreadRootTimers()
+{
+	return NamedTimerFactory::instance().getThreadRoots();
+}
+
+//static
+void LLFastTimer::NamedTimer::mergeThreadTimes()
+{
+	if (!sThreadMutex) return;
+
+	LLMutexLock lock(sThreadMutex);
+	for (std::vector<ThreadTimers*>::iterator it = sThreadTimers->begin(); it != sThreadTimers->end(); ++it)
+	{
+		ThreadTimers* thread = *it;
+		// a finished thread adds no more nodes; once they all have timers,
+		// this pass picks up the last of its time
+		bool finished = thread->mFinished && thread->mNumMerged == (U32)thread->mNumNodes;
+
+		for (U32 i = 0; i < thread->mNumMerged; i++)
+		{
+			ThreadTimers::Node& node = thread->mNodes[i];
+			U32 self_time = *(volatile U32*)&node.mSelfTimeCounter;
+			U32 calls = *(volatile U32*)&node.mCalls;
+
+			FrameState& info = node.mMergedTimer->getFrameState();
+			info.mSelfTimeCounter += self_time - node.mMergedTime;
+			info.mCalls += calls - node.mMergedCalls;
+			node.mMergedTime = self_time;
+			node.mMergedCalls = calls;
+		}
+
+		thread->mDone = finished;
+	}
+}
+
+//static
+void LLFastTimer::NamedTimer::updateThreadTimers()
+{
+	if (!sThreadMutex) return;
+
+	LLMutexLock lock(sThreadMutex);
+	std::vector<ThreadTimers*>::iterator it = sThreadTimers->begin();
+	while (it != sThreadTimers->end())
+	{
+		ThreadTimers* thread = *it;
+		if (thread->mDone)
+		{
+			it = sThreadTimers->erase(it);
+			delete thread;
+			continue;
+		}
+
+		if (thread->mNumMerged == 0)
+		{
+			thread->mNodes[0].mMergedTimer = &NamedTimerFactory::instance().getThreadRootTimer(thread->mName);
+			thread->mNumMerged = 1;
+		}
+
+		// Parents are always added before their children.  Counts from
+		// before a node got its timer are picked up on the next merge.
+		U32 num_nodes = thread->mNumNodes;
+		for (U32 i = thread->mNumMerged; i < num_nodes; i++)
+		{
+			ThreadTimers::Node& node = thread->mNodes[i];
+			NamedTimer* parent = static_cast<ThreadTimers::Node*>(node.mParent)->mMergedTimer;
+			node.mMergedTimer = &NamedTimerFactory::instance().getThreadTimer(node.mTimer->getName(), parent);
+		}
+		thread->mNumMerged = num_nodes;
+		++it;
+	}
+}
+
 std::vector<LLFastTimer::NamedTimer*>::const_iterator LLFastTimer::NamedTimer::beginChildren()
 { 
 	return mChildren.begin(); 
@@ -668,15 +1054,24 @@ void LLFastTimer::nextFrame()
 		llinfos << "Slow frame, fast timers inaccurate" << llendl;
 	}
 
+	if (sRecording)
+	{
+		sMainEvents->push(EVENT_FRAME, NULL);
+		checkSpike(frame_time);
+	}
+
 	if (sPauseHistory)
 	{
 		sResetHistory = true;
+		// drop worker time along with the main thread's
+		NamedTimer::mergeThreadTimes();
 	}
 	else if (sResetHistory)
 	{
 		sLastFrameIndex = 0;
 		sCurFrameIndex = 0;
 		sResetHistory = false;
+		NamedTimer::mergeThreadTimes();
 	}
 	else // not paused
 	{
@@ -684,6 +1079,9 @@ void LLFastTimer::nextFrame()
 		sLastFrameIndex = sCurFrameIndex++;
 	}
 	
+	// new timers go in before resetFrame() sorts and relinks the frame states
+	NamedTimer::updateThreadTimers();
+
 	// get ready for next frame
 	NamedTimer::resetFrame();
 	sLastFrameTime = frame_time;
@@ -749,7 +1147,8 @@ const LLFastTimer::NamedTimer* LLFastTimer::getTimerByName(const std::string& na
 }
 
 LLFastTimer::LLFastTimer(LLFastTimer::FrameState* state)
-:	mFrameState(state)
+:	mFrameState(state),
+	mThread(NULL)
 {
 	U32 start_time = getCPUClockCount32();
 	mStartTime = start_time;
@@ -761,4 +1160,507 @@ LLFastTimer::LLFastTimer(LLFastTimer::FrameState* state)
 }
 
 
+#ifdef LL_FAST_TIMER_THREAD_LOCAL
+//static
+void LLFastTimer::setCurThreadTimers(ThreadTimers* timers)
+{
+	sCurThreadTimers = timers;
+}
+#else
+//static
+LLFastTimer::ThreadTimers* LLFastTimer::getCurThreadTimers()
+{
+	return get_thread_timers();
+}
+
+//static
+void LLFastTimer::setCurThreadTimers(ThreadTimers* timers)
+{
+	set_thread_timers(timers);
+}
+#endif
+
+void LLFastTimer::startThreadTimer(NamedTimer& timer)
+{
+	CurTimerData* cur_timer_data = &mThread->mCurTimerData;
+	FrameState* frame_state = mThread->getChild(cur_timer_data->mFrameState, &timer);
+	mFrameState = frame_state;
+	mStartTime = getCPUClockCount32();
+
+	frame_state->mCalls++;
+
+	mLastTimerData = *cur_timer_data;
+	cur_timer_data->mCurTimer = this;
+	cur_timer_data->mFrameState = frame_state;
+	cur_timer_data->mChildTime = 0;
+}
+
+void LLFastTimer::stopThreadTimer()
+{
+	U32 total_time = getCPUClockCount32() - mStartTime;
+	CurTimerData* cur_timer_data = &mThread->mCurTimerData;
+
+	mFrameState->mSelfTimeCounter += total_time - cur_timer_data->mChildTime;
+	mLastTimerData.mChildTime += total_time;
+	*cur_timer_data = mLastTimerData;
+}
+
+//static
+void LLFastTimer::initClass()
+{
+	if (!sThreadMutex)
+	{
+		sThreadMutex = new LLMutex(NULL, "LLFastTimer::sThreadMutex");
+		sThreadTimers = new std::vector<ThreadTimers*>;
+	}
+}
+
+//static
+void LLFastTimer::cleanupClass()
+{
+	if (sThreadMutex)
+	{
+		std::for_each(sThreadTimers->begin(), sThreadTimers->end(), DeletePointer());
+		delete sThreadTimers;
+		sThreadTimers = NULL;
+		delete sThreadMutex;
+		sThreadMutex = NULL;
+	}
+	sRecording = false;
+	delete sMainEvents;
+	sMainEvents = NULL;
+	sEventBufferSize = 0;
+}
+
+//static
+void LLFastTimer::registerThread(const std::string& name)
+{
+	ThreadTimers* thread = new ThreadTimers(name);
+	setCurThreadTimers(thread);
+
+	// Without initClass() the thread still gets a stack of its own, it just
+	// isn't reported
+	if (sThreadMutex)
+	{
+		LLMutexLock lock(sThreadMutex);
+		if (sEventBufferSize)
+		{
+			thread->mEvents = new EventBuffer(sEventBufferSize);
+		}
+		thread->mListed = true;
+		sThreadTimers->push_back(thread);
+	}
+}
+
+//static
+void LLFastTimer::unregisterThread()
+{
+	ThreadTimers* thread = getCurThreadTimers();
+	if (!thread) return;
+	setCurThreadTimers(NULL);
+
+	if (thread->mListed)
+	{
+		LLMutexLock lock(sThreadMutex);
+		if (sCollectingThreads)
+		{
+			// the main thread deletes it once its last counts are in
+			thread->mFinished = true;
+			return;
+		}
+		// nobody reads the timers
+		sThreadTimers->erase(std::find(sThreadTimers->begin(), sThreadTimers->end(), thread));
+	}
+	delete thread;
+}
+
+//static
+void LLFastTimer::startRecording(U32 events_per_thread)
+{
+	if (sRecording) return;
+
+	if (!sEventBufferSize)
+	{
+		// buffers are sized once, the first time
+		U32 size = 1024;
+		while (size < events_per_thread && size < (1U << 24))
+		{
+			size <<= 1;
+		}
+
+		sMainEvents = new EventBuffer(size);
+		sMainThreadID = LLThread::currentID();
+
+		if (sThreadMutex)
+		{
+			LLMutexLock lock(sThreadMutex);
+			sEventBufferSize = size;
+			for (std::vector<ThreadTimers*>::iterator it = sThreadTimers->begin(); it != sThreadTimers->end(); ++it)
+			{
+				(*it)->mEvents = new EventBuffer(size);
+			}
+		}
+		else
+		{
+			sEventBufferSize = size;
+		}
+	}
+
+	// workers look at their buffer only once they see this
+	sRecording = true;
+	llinfos << "Recording fast timer events, " << sEventBufferSize << " per thread" << llendl;
+}
+
+//static
+void LLFastTimer::stopRecording()
+{
+	// the buffers stay, a worker may be pushing to one right now
+	sRecording = false;
+}
+
+void LLFastTimer::recordEvent(U32 type)
+{
+	EventBuffer* events = NULL;
+	if (mThread)
+	{
+		events = mThread->mEvents;
+	}
+	else if (LLThread::currentID() == sMainThreadID)
+	{
+		events = sMainEvents;
+	}
+	// threads LLThread didn't start have nowhere to record
+
+	if (events)
+	{
+		events->push(type, mFrameState->mTimer);
+	}
+}
+
+//static
+void LLFastTimer::setSpikeCapture(F32 threshold_ms, F32 seconds, const std::string& prefix)
+{
+	sSpikeThresholdMS = threshold_ms;
+	sSpikeSeconds = seconds;
+	sSpikePrefix = prefix;
+}
+
+//static
+void LLFastTimer::checkSpike(U64 frame_time)
+{
+	if (sSpikeThresholdMS <= 0.f || sSpikePrefix.empty()) return;
+
+	F64 counts_per_second = (F64)(countsPerSecond() << 8);
+	F64 frame_ms = (F64)(frame_time - sLastFrameTime) * 1000.0 / counts_per_second;
+	// one capture per window, so they don't overlap
+	F64 since_last = (F64)(frame_time - sLastSpikeTime) / counts_per_second;
+	if (frame_ms > sSpikeThresholdMS && (sLastSpikeTime == 0 || since_last > sSpikeSeconds))
+	{
+		sLastSpikeTime = frame_time;
+		std::string filename = llformat("%s_%d.lltl", sSpikePrefix.c_str(), ++sSpikeCount);
+		llinfos << llformat("%.1f ms frame, writing timeline to ", frame_ms) << filename << llendl;
+		writeTimeline(filename, sSpikeSeconds, TIMELINE_BINARY);
+	}
+}
+
+//static
+void LLFastTimer::captureTimeline(Timeline& timeline, F32 seconds)
+{
+	timeline.mCountsPerSecond = countsPerSecond() << 8;
+	timeline.mEndTime = getCPUClockCount64();
+	U64 window = (U64)((F64)seconds * (F64)timeline.mCountsPerSecond);
+	timeline.mStartTime = timeline.mEndTime > window ? timeline.mEndTime - window : 0;
+
+	std::vector<std::pair<std::string, EventBuffer*> > buffers;
+	if (sMainEvents)
+	{
+		buffers.push_back(std::make_pair(std::string("Main"), sMainEvents));
+	}
+
+	std::map<NamedTimer*, U32> name_index;
+	std::vector<EventBuffer::Event> events;
+
+	// hold the list so no thread is deleted while we copy it
+	if (sThreadMutex)
+	{
+		sThreadMutex->lock();
+		for (std::vector<ThreadTimers*>::iterator it = sThreadTimers->begin(); it != sThreadTimers->end(); ++it)
+		{
+			if ((*it)->mEvents)
+			{
+				buffers.push_back(std::make_pair((*it)->mName, (*it)->mEvents));
+			}
+		}
+	}
+
+	for (U32 i = 0; i < buffers.size(); i++)
+	{
+		buffers[i].second->read(events);
+
+		timeline.mThreads.push_back(Timeline::Thread());
+		Timeline::Thread& thread = timeline.mThreads.back();
+		thread.mName = buffers[i].first;
+		thread.mEvents.reserve(events.size());
+
+		for (std::vector<EventBuffer::Event>::iterator it = events.begin(); it != events.end(); ++it)
+		{
+			if (it->mTime < timeline.mStartTime || it->mTime > timeline.mEndTime) continue;
+
+			Timeline::Event event;
+			event.mTime = it->mTime;
+			event.mType = it->mType;
+			event.mName = Timeline::FRAME_NAME;
+			if (it->mTimer)
+			{
+				std::map<NamedTimer*, U32>::iterator found = name_index.find(it->mTimer);
+				if (found == name_index.end())
+				{
+					found = name_index.insert(std::make_pair(it->mTimer, (U32)timeline.mNames.size())).first;
+					timeline.mNames.push_back(it->mTimer->getName());
+				}
+				event.mName = found->second;
+			}
+			thread.mEvents.push_back(event);
+		}
+	}
+
+	if (sThreadMutex)
+	{
+		sThreadMutex->unlock();
+	}
+}
+
+//static
+bool LLFastTimer::writeTimeline(const std::string& filename, F32 seconds, ETimelineFormat format)
+{
+	if (!sMainEvents)
+	{
+		llwarns << "No fast timer events recorded" << llendl;
+		return false;
+	}
+
+	Timeline timeline;
+	captureTimeline(timeline, seconds);
+
+	llofstream os(filename, std::ios::out | std::ios::binary);
+	if (!os.is_open())
+	{
+		llwarns << "Can't write timeline to " << filename << llendl;
+		return false;
+	}
+
+	if (format == TIMELINE_BINARY)
+	{
+		writeTimelineBinary(timeline, os);
+	}
+	else
+	{
+		writeTimelineTrace(timeline, os);
+	}
+	return os.good();
+}
+
+//static
+bool LLFastTimer::convertTimeline(std::istream& binary, std::ostream& trace)
+{
+	Timeline timeline;
+	if (!readTimelineBinary(timeline, binary))
+	{
+		return false;
+	}
+	writeTimelineTrace(timeline, trace);
+	return trace.good();
+}
+
+static std::string json_string(const std::string& in)
+{
+	std::string out("\"");
+	for (std::string::const_iterator it = in.begin(); it != in.end(); ++it)
+	{
+		if (*it == '"' || *it == '\\')
+		{
+			out += '\\';
+			out += *it;
+		}
+		else if ((U8)*it < 0x20)
+		{
+			out += llformat("\\u%04x", (U32)(U8)*it);
+		}
+		else
+		{
+			out += *it;
+		}
+	}
+	out += '"';
+	return out;
+}
+
+//static
+void LLFastTimer::writeTimelineTrace(const Timeline& timeline, std::ostream& os)
+{
+	// Timestamps in microseconds from the start of the window.  A stop
+	// whose start was before the window is dropped; timers still running at
+	// the end are stopped there.
+	F64 us_per_count = 1000000.0 / (F64)llmax(timeline.mCountsPerSecond, (U64)1);
+	bool first = true;
+
+	os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (U32 tid = 0; tid < timeline.mThreads.size(); tid++)
+	{
+		const Timeline::Thread& thread = timeline.mThreads[tid];
+		os << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid + 1
+			<< ",\"args\":{\"name\":" << json_string(thread.mName) << "}}";
+		first = false;
+
+		S32 depth = 0;
+		for (std::vector<Timeline::Event>::const_iterator it = thread.mEvents.begin(); it != thread.mEvents.end(); ++it)
+		{
+			std::string ts = llformat("%.3f", (F64)(it->mTime - timeline.mStartTime) * us_per_count);
+			if (it->mType == EVENT_FRAME)
+			{
+				os << ",\n{\"name\":\"Frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":" << tid + 1
+					<< ",\"ts\":" << ts << "}";
+			}
+			else if (it->mType == EVENT_BEGIN && it->mName < timeline.mNames.size())
+			{
+				os << ",\n{\"name\":" << json_string(timeline.mNames[it->mName]) << ",\"ph\":\"B\",\"pid\":1,\"tid\":" << tid + 1
+					<< ",\"ts\":" << ts << "}";
+				depth++;
+			}
+			else if (it->mType == EVENT_END && depth > 0)
+			{
+				os << ",\n{\"ph\":\"E\",\"pid\":1,\"tid\":" << tid + 1 << ",\"ts\":" << ts << "}";
+				depth--;
+			}
+		}
+
+		std::string end_ts = llformat("%.3f", (F64)(timeline.mEndTime - timeline.mStartTime) * us_per_count);
+		for (; depth > 0; depth--)
+		{
+			os << ",\n{\"ph\":\"E\",\"pid\":1,\"tid\":" << tid + 1 << ",\"ts\":" << end_ts << "}";
+		}
+	}
+	os << "\n]}\n";
+}
+
+// Binary timeline layout, in the writer's byte order:
+//   "LLTL", U32 version
+//   U64 counts per second, U64 start time, U64 end time
+//   U32 name count, then per name U32 length and the characters
+//   U32 thread count, then per thread U32 length and the name,
+//   U32 event count and per event U64 time, U32 name index, U8 type
+static const char TIMELINE_MAGIC[4] = { 'L', 'L', 'T', 'L' };
+static const U32 TIMELINE_VERSION = 1;
+
+template<typename T>
+static void write_raw(std::ostream& os, T value)
+{
+	os.write((const char*)&value, sizeof(T));
+}
+
+template<typename T>
+static bool read_raw(std::istream& is, T& value)
+{
+	is.read((char*)&value, sizeof(T));
+	return is.good();
+}
+
+static void write_string(std::ostream& os, const std::string& str)
+{
+	write_raw(os, (U32)str.size());
+	os.write(str.data(), str.size());
+}
+
+static bool read_string(std::istream& is, std::string& str)
+{
+	U32 length;
+	if (!read_raw(is, length) || length > 4096) return false;
+	str.resize(length);
+	if (length)
+	{
+		is.read(&str[0], length);
+	}
+	return is.good();
+}
+
+//static
+void LLFastTimer::writeTimelineBinary(const Timeline& timeline, std::ostream& os)
+{
+	os.write(TIMELINE_MAGIC, sizeof(TIMELINE_MAGIC));
+	write_raw(os, TIMELINE_VERSION);
+	write_raw(os, timeline.mCountsPerSecond);
+	write_raw(os, timeline.mStartTime);
+	write_raw(os, timeline.mEndTime);
+
+	write_raw(os, (U32)timeline.mNames.size());
+	for (U32 i = 0; i < timeline.mNames.size(); i++)
+	{
+		write_string(os, timeline.mNames[i]);
+	}
+
+	write_raw(os, (U32)timeline.mThreads.size());
+	for (U32 i = 0; i < timeline.mThreads.size(); i++)
+	{
+		const Timeline::Thread& thread = timeline.mThreads[i];
+		write_string(os, thread.mName);
+		write_raw(os, (U32)thread.mEvents.size());
+		for (std::vector<Timeline::Event>::const_iterator it = thread.mEvents.begin(); it != thread.mEvents.end(); ++it)
+		{
+			write_raw(os, it->mTime);
+			write_raw(os, it->mName);
+			write_raw(os, (U8)it->mType);
+		}
+	}
+}
+
+//static
+bool LLFastTimer::readTimelineBinary(Timeline& timeline, std::istream& is)
+{
+	char magic[sizeof(TIMELINE_MAGIC)];
+	U32 version;
+	is.read(magic, sizeof(magic));
+	if (!is.good() || memcmp(magic, TIMELINE_MAGIC, sizeof(magic)) != 0
+		|| !read_raw(is, version) || version != TIMELINE_VERSION)
+	{
+		llwarns << "Not a timeline file" << llendl;
+		return false;
+	}
+
+	U32 num_names;
+	if (!read_raw(is, timeline.mCountsPerSecond)
+		|| !read_raw(is, timeline.mStartTime)
+		|| !read_raw(is, timeline.mEndTime)
+		|| !read_raw(is, num_names))
+	{
+		return false;
+	}
+	timeline.mNames.resize(num_names);
+	for (U32 i = 0; i < num_names; i++)
+	{
+		if (!read_string(is, timeline.mNames[i])) return false;
+	}
+
+	U32 num_threads;
+	if (!read_raw(is, num_threads)) return false;
+	timeline.mThreads.resize(num_threads);
+	for (U32 i = 0; i < num_threads; i++)
+	{
+		Timeline::Thread& thread = timeline.mThreads[i];
+		U32 num_events;
+		if (!read_string(is, thread.mName) || !read_raw(is, num_events)) return false;
+		for (U32 e = 0; e < num_events; e++)
+		{
+			Timeline::Event event;
+			U8 type;
+			if (!read_raw(is, event.mTime) || !read_raw(is, event.mName)) return false;
+			// the last byte of the file may leave eof set
+			is.read((char*)&type, 1);
+			if (is.fail()) return false;
+			event.mType = type;
+			thread.mEvents.push_back(event);
+		}
+	}
+	return true;
+}
+
 //////////////////////////////////////////////////////////////////////////////
@@ -32,15 +32,32 @@
 #define FAST_TIMER_ON 1
 #define TIME_FAST_TIMERS 0
 
+// Where another module can read llcommon's thread locals directly, every
+// LLFastTimer finds its thread's timers with an inline load rather than a
+// call.  Not across a Windows DLL, and the Mac has no thread locals.
+#if LL_LINUX || LL_SOLARIS
+#define LL_FAST_TIMER_THREAD_LOCAL __thread __attribute__((tls_model("initial-exec")))
+#elif LL_WINDOWS && !LL_COMMON_LINK_SHARED
+#define LL_FAST_TIMER_THREAD_LOCAL __declspec(thread)
+#endif
+
 class LLMutex;
 
 #include <queue>
 #include "llsd.h"
 
+// Timers are tracked per thread.  The main thread keeps the single global
+// stack in sCurTimerData; every LLThread gets a stack and call tree of its
+// own (ThreadTimers) that only it writes to, so timing on a worker never
+// takes a lock or touches shared state.  Once a frame nextFrame() reads the
+// worker counters and folds them into a NamedTimer tree per thread, rooted
+// beside "Frame" (see NamedTimer::getThreadRootTimers()).
+
 class LL_COMMON_API LLFastTimer
 {
 public:
 	class NamedTimer;
+	class ThreadTimers;
 
 	struct LL_COMMON_API FrameState
 	{
@@ -91,6 +108,12 @@ public:
 
 		FrameState& getFrameState() const;
 
+		// true for the timers that mirror a worker thread's call tree
+		bool isThreadTimer() const { return mThreadTimer; }
+
+		// one root per worker thread name, each a sibling of the "Frame" timer
+		static const std::vector<NamedTimer*>& getThreadRootTimers();
+
 	private:
 		friend class LLFastTimer;
 		friend class NamedTimerFactory;
@@ -101,6 +124,12 @@ public:
 		NamedTimer(const std::string& name);
 		// recursive call to gather total time from children
 		static void accumulateTimings();
+		static void accumulateTree(NamedTimer& root);
+
+		// adds what worker threads timed since the last call to their timers
+		static void mergeThreadTimes();
+		// creates timers for new worker call tree entries, drops finished threads
+		static void updateThreadTimers();
 
 		// updates cumulative times and hierarchy,
 		// can be called multiple times in a frame, at any point
@@ -130,6 +159,7 @@ public:
 		std::vector<NamedTimer*>	mChildren;
 		bool						mCollapsed;				// don't show children
 		bool						mNeedsSorting;			// sort children whenever child added
+		bool						mThreadTimer;
 	};
 
 	// used to statically declare a new named timer
@@ -158,19 +188,31 @@ public:
 		U64 timer_start = getCPUClockCount64();
 #endif
 #if FAST_TIMER_ON
-		LLFastTimer::FrameState* frame_state = mFrameState;
-		mStartTime = getCPUClockCount32();
-
-		frame_state->mActiveCount++;
-		frame_state->mCalls++;
-		// keep current parent as long as it is active when we are
-		frame_state->mMoveUpTree |= (frame_state->mParent->mActiveCount == 0);
-
-		LLFastTimer::CurTimerData* cur_timer_data = &LLFastTimer::sCurTimerData;
-		mLastTimerData = *cur_timer_data;
-		cur_timer_data->mCurTimer = this;
-		cur_timer_data->mFrameState = frame_state;
-		cur_timer_data->mChildTime = 0;
+		mThread = getCurThreadTimers();
+		if (LL_UNLIKELY(mThread))
+		{
+			startThreadTimer(timer.mTimer);
+		}
+		else
+		{
+			LLFastTimer::FrameState* frame_state = mFrameState;
+			mStartTime = getCPUClockCount32();
+
+			frame_state->mActiveCount++;
+			frame_state->mCalls++;
+			// keep current parent as long as it is active when we are
+			frame_state->mMoveUpTree |= (frame_state->mParent->mActiveCount == 0);
+
+			LLFastTimer::CurTimerData* cur_timer_data = &LLFastTimer::sCurTimerData;
+			mLastTimerData = *cur_timer_data;
+			cur_timer_data->mCurTimer = this;
+			cur_timer_data->mFrameState = frame_state;
+			cur_timer_data->mChildTime = 0;
+		}
+		if (LL_UNLIKELY(sRecording))
+		{
+			recordEvent(EVENT_BEGIN);
+		}
 #endif
 #if TIME_FAST_TIMERS
 		U64 timer_end = getCPUClockCount64();
@@ -184,20 +226,31 @@ public:
 		U64 timer_start = getCPUClockCount64();
 #endif
 #if FAST_TIMER_ON
-		LLFastTimer::FrameState* frame_state = mFrameState;
-		U32 total_time = getCPUClockCount32() - mStartTime;
-
-		frame_state->mSelfTimeCounter += total_time - LLFastTimer::sCurTimerData.mChildTime;
-		frame_state->mActiveCount--;
-
-		// store last caller to bootstrap tree creation
-		// do this in the destructor in case of recursion to get topmost caller
-		frame_state->mLastCaller = mLastTimerData.mFrameState;
-
-		// we are only tracking self time, so subtract our total time delta from parents
-		mLastTimerData.mChildTime += total_time;
-
-		LLFastTimer::sCurTimerData = mLastTimerData;
+		if (LL_UNLIKELY(sRecording))
+		{
+			recordEvent(EVENT_END);
+		}
+		if (LL_UNLIKELY(mThread))
+		{
+			stopThreadTimer();
+		}
+		else
+		{
+			LLFastTimer::FrameState* frame_state = mFrameState;
+			U32 total_time = getCPUClockCount32() - mStartTime;
+
+			frame_state->mSelfTimeCounter += total_time - LLFastTimer::sCurTimerData.mChildTime;
+			frame_state->mActiveCount--;
+
+			// store last caller to bootstrap tree creation
+			// do this in the destructor in case of recursion to get topmost caller
+			frame_state->mLastCaller = mLastTimerData.mFrameState;
+
+			// we are only tracking self time, so subtract our total time delta from parents
+			mLastTimerData.mChildTime += total_time;
+
+			LLFastTimer::sCurTimerData = mLastTimerData;
+		}
 #endif
 #if TIME_FAST_TIMERS
 		U64 timer_end = getCPUClockCount64();
@@ -215,6 +268,7 @@ public:
 	static bool 			sResetHistory;
 	static U64				sTimerCycles;
 	static U32				sTimerCalls;
+	static bool				sRecording;		// see startRecording()
 
 	typedef std::vector<FrameState> info_list_t;
 	static info_list_t& getFrameStateList();
@@ -230,6 +284,34 @@ public:
 	// call this to reset timer hierarchy, averages, etc.
 	static void reset();
 
+	// set up and tear down the list of worker thread timers; call after APR
+	static void initClass();
+	static void cleanupClass();
+
+	// called by LLThread on the new thread, before and after run()
+	static void registerThread(const std::string& name);
+	static void unregisterThread();
+
+	// Timeline recording.  While recording, every timer start and stop, and
+	// every nextFrame(), goes into a ring buffer per thread with its
+	// timestamp.  Call from the main thread.
+	static void startRecording(U32 events_per_thread);
+	static void stopRecording();
+
+	enum ETimelineFormat
+	{
+		TIMELINE_TRACE,		// Chrome trace event JSON, for chrome://tracing
+		TIMELINE_BINARY		// compact, turn into a trace with convertTimeline()
+	};
+
+	// Writes what was recorded over the last few seconds, on every thread.
+	static bool writeTimeline(const std::string& filename, F32 seconds, ETimelineFormat format);
+	static bool convertTimeline(std::istream& binary, std::ostream& trace);
+
+	// While recording, a frame longer than threshold_ms writes the last
+	// seconds of timeline to <prefix>_<n>.lltl.  0 turns it off.
+	static void setSpikeCapture(F32 threshold_ms, F32 seconds, const std::string& prefix);
+
 	static U64 countsPerSecond();
 	static S32 getLastFrameIndex() { return sLastFrameIndex; }
 	static S32 getCurFrameIndex() { return sCurFrameIndex; }
@@ -250,6 +332,40 @@ private:
 	static U64 getCPUClockCount64();
 	static U64 sClockResolution;
 
+	// NULL on the main thread (and any thread LLThread didn't start)
+#ifdef LL_FAST_TIMER_THREAD_LOCAL
+	static ThreadTimers* getCurThreadTimers() { return sCurThreadTimers; }
+	static LL_FAST_TIMER_THREAD_LOCAL ThreadTimers* sCurThreadTimers;
+#else
+	static ThreadTimers* getCurThreadTimers();
+#endif
+	static void setCurThreadTimers(ThreadTimers* timers);
+	void startThreadTimer(NamedTimer& timer);
+	void stopThreadTimer();
+
+	class EventBuffer;
+	struct Timeline;
+	enum { EVENT_BEGIN, EVENT_END, EVENT_FRAME };
+	void recordEvent(U32 type);
+	static void captureTimeline(Timeline& timeline, F32 seconds);
+	static void writeTimelineTrace(const Timeline& timeline, std::ostream& os);
+	static void writeTimelineBinary(const Timeline& timeline, std::ostream& os);
+	static bool readTimelineBinary(Timeline& timeline, std::istream& is);
+	static void checkSpike(U64 frame_time);
+
+	static EventBuffer*		sMainEvents;
+	static U32				sMainThreadID;
+	static U32				sEventBufferSize;
+	static F32				sSpikeThresholdMS;
+	static F32				sSpikeSeconds;
+	static std::string		sSpikePrefix;
+	static U64				sLastSpikeTime;
+	static U32				sSpikeCount;
+
+	static LLMutex*					sThreadMutex;	// guards sThreadTimers
+	static std::vector<ThreadTimers*>* sThreadTimers;
+	static bool						sCollectingThreads;
+
 	static S32				sCurFrameIndex;
 	static S32				sLastFrameIndex;
 	static U64				sLastFrameTime;
@@ -258,6 +374,7 @@ private:
 	U32							mStartTime;
 	LLFastTimer::FrameState*	mFrameState;
 	LLFastTimer::CurTimerData	mLastTimerData;
+	ThreadTimers*				mThread;
 
 };
 
@@ -0,0 +1,595 @@
+/**
+ * @file llmempool.cpp
+ * @brief Size-classed allocator with thread-local caches and per-LLMemType accounting
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmempool.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if LL_WINDOWS
+#include <intrin.h>
+#endif
+
+#include "llapr.h"
+#include "llthread.h"
+#include "lltimer.h"
+
+// Size classes are 16 bytes apart up to 128, then four to each power of two
+// up to MAX_SMALL_SIZE: 16, 32, ... 128, 160, 192, 224, 256, 320, ... 32768.
+// Class sizes include the block header.
+static const U32 NUM_CLASSES = 40;
+static const U16 LARGE_CLASS = 0xffff;
+
+// Small blocks are carved out of spans this big.
+static const size_t SPAN_SIZE = 65536;
+
+// Most bytes a thread keeps cached per class before handing half back.
+static const size_t CACHE_BYTES = 32768;
+
+// Precedes every block.  While a small block is free its first word links
+// it into a free list instead.
+struct BlockHeader
+{
+	U32	mSize;		// as requested
+	U16	mType;		// LLMemType id
+	U16	mClass;		// size class, or LARGE_CLASS for blocks from malloc()
+};
+
+struct ThreadCache
+{
+	void*			mFree[NUM_CLASSES];
+	U32				mFreeCount[NUM_CLASSES];
+
+	// Only the owning thread writes these.  Blocks freed on another thread
+	// drive that thread's counts negative; the sums come out right.
+	S64				mBytes[LLMemPool::MAX_TYPES];
+	S32				mCount[LLMemPool::MAX_TYPES];
+
+	ThreadCache*	mNext;		// in sThreadCaches, under the registry lock
+};
+
+// Blocks the thread caches have given back, and the span new blocks are
+// carved from.
+struct CentralList
+{
+	volatile apr_uint32_t	mLock;
+	void*					mFree;
+	char*					mSpanPos;
+	char*					mSpanEnd;
+};
+
+// Everything shared is plain data, zeroed before any constructor runs, so
+// static objects may allocate from the pool while the program is still
+// being initialized.
+static CentralList sCentral[NUM_CLASSES];
+
+static volatile apr_uint32_t sRegistryLock;
+static ThreadCache* sThreadCaches;
+// counts from threads that have released their caches
+static S64 sRetiredBytes[LLMemPool::MAX_TYPES];
+static S32 sRetiredCount[LLMemPool::MAX_TYPES];
+
+// Spin locks rather than LLMutex for the same reason, and because they are
+// only taken once per batch of blocks.
+static inline void spin_lock(volatile apr_uint32_t* lock)
+{
+	while (apr_atomic_cas32(lock, 1, 0) != 0)
+	{
+		LLThread::yield();
+	}
+}
+
+static inline void spin_unlock(volatile apr_uint32_t* lock)
+{
+	apr_atomic_set32(lock, 0);
+}
+
+static inline void*& next_free(void* block)
+{
+	return *(void**)block;
+}
+
+// block_size includes the header and is at most MAX_SMALL_SIZE.
+static inline U32 get_class(size_t block_size)
+{
+	if (block_size <= 128)
+	{
+		return (U32)(block_size - 1) >> 4;
+	}
+	U32 n = (U32)block_size - 1;
+#if LL_WINDOWS
+	unsigned long bits;
+	_BitScanReverse(&bits, n);
+#else
+	U32 bits = 31 - __builtin_clz(n);
+#endif
+	return 8 + ((U32)bits - 7) * 4 + ((n >> (bits - 2)) & 3);
+}
+
+static inline size_t get_class_size(U32 size_class)
+{
+	if (size_class < 8)
+	{
+		return (size_class + 1) << 4;
+	}
+	U32 bits = 7 + (size_class - 8) / 4;
+	return ((size_t)1 << bits) + (((size_class - 8) & 3) + 1) * ((size_t)1 << (bits - 2));
+}
+
+static inline U32 get_cache_limit(U32 size_class)
+{
+	return llclamp((U32)(CACHE_BYTES / get_class_size(size_class)), (U32)2, (U32)256);
+}
+
+static inline S32 clamp_type(S32 mem_type)
+{
+	if (mem_type < 0 || mem_type >= LLMemPool::MAX_TYPES)
+	{
+		return LLMemType::MTYPE_OTHER.mID;
+	}
+	return mem_type;
+}
+
+// Compilers can do thread local pointers directly everywhere but on the Mac.
+#if LL_WINDOWS
+static __declspec(thread) ThreadCache* sCurThreadCache = NULL;
+
+static inline ThreadCache* get_thread_cache() { return sCurThreadCache; }
+static inline void set_thread_cache(ThreadCache* cache) { sCurThreadCache = cache; }
+#elif LL_LINUX || LL_SOLARIS
+static __thread ThreadCache* sCurThreadCache = NULL;
+
+static inline ThreadCache* get_thread_cache() { return sCurThreadCache; }
+static inline void set_thread_cache(ThreadCache* cache) { sCurThreadCache = cache; }
+#else
+static pthread_key_t sThreadCacheKey;
+static pthread_once_t sThreadCacheOnce = PTHREAD_ONCE_INIT;
+
+static void create_thread_cache_key()
+{
+	pthread_key_create(&sThreadCacheKey, NULL);
+}
+
+static inline ThreadCache* get_thread_cache()
+{
+	pthread_once(&sThreadCacheOnce, create_thread_cache_key);
+	return (ThreadCache*)pthread_getspecific(sThreadCacheKey);
+}
+
+static inline void set_thread_cache(ThreadCache* cache)
+{
+	pthread_once(&sThreadCacheOnce, create_thread_cache_key);
+	pthread_setspecific(sThreadCacheKey, cache);
+}
+#endif
+
+static ThreadCache* obtain_thread_cache()
+{
+	ThreadCache* cache = get_thread_cache();
+	if (!cache)
+	{
+		cache = (ThreadCache*)calloc(1, sizeof(ThreadCache));
+		if (!cache)
+		{
+			llerrs << "Out of memory creating a memory pool thread cache" << llendl;
+		}
+		spin_lock(&sRegistryLock);
+		cache->mNext = sThreadCaches;
+		sThreadCaches = cache;
+		spin_unlock(&sRegistryLock);
+		set_thread_cache(cache);
+	}
+	return cache;
+}
+
+// Moves up to half a cache's worth of blocks from the central list, or from
+// a new span, into an empty thread cache.  Returns FALSE if there is no
+// memory left for a span.
+static BOOL refill(ThreadCache* cache, U32 size_class)
+{
+	CentralList& central = sCentral[size_class];
+	const size_t block_size = get_class_size(size_class);
+	const U32 want = llmax(get_cache_limit(size_class) / 2, (U32)1);
+	void* head = NULL;
+	U32 count = 0;
+
+	spin_lock(&central.mLock);
+	while (count < want && central.mFree)
+	{
+		void* block = central.mFree;
+		central.mFree = next_free(block);
+		next_free(block) = head;
+		head = block;
+		++count;
+	}
+	while (count < want)
+	{
+		if (central.mSpanPos + block_size > central.mSpanEnd)
+		{
+			// what is left of the old span is too small for a block
+			char* span = (char*)malloc(SPAN_SIZE);
+			if (!span)
+			{
+				break;
+			}
+			central.mSpanPos = span;
+			central.mSpanEnd = span + SPAN_SIZE;
+		}
+		void* block = central.mSpanPos;
+		central.mSpanPos += block_size;
+		next_free(block) = head;
+		head = block;
+		++count;
+	}
+	spin_unlock(&central.mLock);
+
+	cache->mFree[size_class] = head;
+	cache->mFreeCount[size_class] = count;
+	return count > 0;
+}
+
+// Gives count blocks from the front of a thread cache back to the central
+// list.
+static void drain(ThreadCache* cache, U32 size_class, U32 count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	void* first = cache->mFree[size_class];
+	void* last = first;
+	for (U32 i = 1; i < count; ++i)
+	{
+		last = next_free(last);
+	}
+	cache->mFree[size_class] = next_free(last);
+	cache->mFreeCount[size_class] -= count;
+
+	CentralList& central = sCentral[size_class];
+	spin_lock(&central.mLock);
+	next_free(last) = central.mFree;
+	central.mFree = first;
+	spin_unlock(&central.mLock);
+}
+
+//static
+void* LLMemPool::allocate(size_t size, S32 mem_type)
+{
+	if (size > U32_MAX - sizeof(BlockHeader))
+	{
+		return NULL;
+	}
+	mem_type = clamp_type(mem_type);
+	ThreadCache* cache = obtain_thread_cache();
+
+	const size_t block_size = size + sizeof(BlockHeader);
+	BlockHeader* header;
+	U16 size_class;
+	if (block_size > MAX_SMALL_SIZE)
+	{
+		header = (BlockHeader*)malloc(block_size);
+		if (!header)
+		{
+			return NULL;
+		}
+		size_class = LARGE_CLASS;
+	}
+	else
+	{
+		size_class = (U16)get_class(block_size);
+		if (!cache->mFree[size_class] && !refill(cache, size_class))
+		{
+			return NULL;
+		}
+		header = (BlockHeader*)cache->mFree[size_class];
+		cache->mFree[size_class] = next_free(header);
+		--cache->mFreeCount[size_class];
+	}
+
+	header->mSize = (U32)size;
+	header->mType = (U16)mem_type;
+	header->mClass = size_class;
+	cache->mBytes[mem_type] += size;
+	++cache->mCount[mem_type];
+	return header + 1;
+}
+
+//static
+void LLMemPool::deallocate(void* ptr)
+{
+	if (!ptr)
+	{
+		return;
+	}
+	BlockHeader* header = (BlockHeader*)ptr - 1;
+	ThreadCache* cache = obtain_thread_cache();
+	cache->mBytes[header->mType] -= header->mSize;
+	--cache->mCount[header->mType];
+
+	const U16 size_class = header->mClass;
+	if (size_class == LARGE_CLASS)
+	{
+		free(header);
+		return;
+	}
+	next_free(header) = cache->mFree[size_class];
+	cache->mFree[size_class] = header;
+	const U32 limit = get_cache_limit(size_class);
+	if (++cache->mFreeCount[size_class] > limit)
+	{
+		drain(cache, size_class, limit / 2);
+	}
+}
+
+//static
+void* LLMemPool::reallocate(void* ptr, size_t size)
+{
+	if (!ptr)
+	{
+		return allocate(size, LLMemType::MTYPE_OTHER.mID);
+	}
+	BlockHeader* header = (BlockHeader*)ptr - 1;
+	if (header->mClass != LARGE_CLASS
+		&& size + sizeof(BlockHeader) <= get_class_size(header->mClass)
+		&& size + sizeof(BlockHeader) > get_class_size(header->mClass) / 2)
+	{
+		// still fits without wasting most of the block
+		ThreadCache* cache = obtain_thread_cache();
+		cache->mBytes[header->mType] += (S64)size - (S64)header->mSize;
+		header->mSize = (U32)size;
+		return ptr;
+	}
+	void* new_ptr = allocate(size, header->mType);
+	if (new_ptr)
+	{
+		memcpy(new_ptr, ptr, llmin(size, (size_t)header->mSize));	/* Flawfinder: ignore */
+		deallocate(ptr);
+	}
+	return new_ptr;
+}
+
+//static
+size_t LLMemPool::getSize(const void* ptr)
+{
+	return ((const BlockHeader*)ptr - 1)->mSize;
+}
+
+//static
+S32 LLMemPool::getType(const void* ptr)
+{
+	return ((const BlockHeader*)ptr - 1)->mType;
+}
+
+//static
+LLMemPool::Usage LLMemPool::getUsage(S32 mem_type)
+{
+	Usage usage;
+	usage.mType = mem_type;
+	usage.mBytes = 0;
+	usage.mCount = 0;
+	if (mem_type < 0 || mem_type >= MAX_TYPES)
+	{
+		return usage;
+	}
+
+	spin_lock(&sRegistryLock);
+	usage.mBytes = sRetiredBytes[mem_type];
+	usage.mCount = sRetiredCount[mem_type];
+	for (ThreadCache* cache = sThreadCaches; cache; cache = cache->mNext)
+	{
+		usage.mBytes += cache->mBytes[mem_type];
+		usage.mCount += cache->mCount[mem_type];
+	}
+	spin_unlock(&sRegistryLock);
+	return usage;
+}
+
+static bool more_bytes(const LLMemPool::Usage& a, const LLMemPool::Usage& b)
+{
+	return a.mBytes > b.mBytes;
+}
+
+//static
+void LLMemPool::getUsage(std::vector<Usage>& usage)
+{
+	Usage totals[MAX_TYPES];
+	spin_lock(&sRegistryLock);
+	for (S32 i = 0; i < MAX_TYPES; ++i)
+	{
+		totals[i].mType = i;
+		totals[i].mBytes = sRetiredBytes[i];
+		totals[i].mCount = sRetiredCount[i];
+	}
+	for (ThreadCache* cache = sThreadCaches; cache; cache = cache->mNext)
+	{
+		for (S32 i = 0; i < MAX_TYPES; ++i)
+		{
+			totals[i].mBytes += cache->mBytes[i];
+			totals[i].mCount += cache->mCount[i];
+		}
+	}
+	spin_unlock(&sRegistryLock);
+
+	usage.clear();
+	for (S32 i = 0; i < MAX_TYPES; ++i)
+	{
+		if (totals[i].mCount != 0)
+		{
+			usage.push_back(totals[i]);
+		}
+	}
+	std::sort(usage.begin(), usage.end(), more_bytes);
+}
+
+//static
+void LLMemPool::releaseThreadCache()
+{
+	ThreadCache* cache = get_thread_cache();
+	if (!cache)
+	{
+		return;
+	}
+	for (U32 size_class = 0; size_class < NUM_CLASSES; ++size_class)
+	{
+		drain(cache, size_class, cache->mFreeCount[size_class]);
+	}
+
+	spin_lock(&sRegistryLock);
+	for (ThreadCache** link = &sThreadCaches; *link; link = &(*link)->mNext)
+	{
+		if (*link == cache)
+		{
+			*link = cache->mNext;
+			break;
+		}
+	}
+	for (S32 i = 0; i < MAX_TYPES; ++i)
+	{
+		sRetiredBytes[i] += cache->mBytes[i];
+		sRetiredCount[i] += cache->mCount[i];
+	}
+	spin_unlock(&sRegistryLock);
+
+	set_thread_cache(NULL);
+	free(cache);
+}
+
+//----------------------------------------------------------------------------
+// benchmark
+
+namespace
+{
+	struct PoolHeap
+	{
+		static void* allocate(size_t size)	{ return LLMemPool::allocate(size, LLMemType::MTYPE_TEMP1); }
+		static void deallocate(void* ptr)	{ LLMemPool::deallocate(ptr); }
+	};
+
+	struct SystemHeap
+	{
+		static void* allocate(size_t size)	{ return malloc(size); }
+		static void deallocate(void* ptr)	{ free(ptr); }
+	};
+
+	// Keeps a window of live blocks and replaces one at a time, with sizes
+	// mostly in LLSD and message territory and now and then a packet.
+	template <class HEAP>
+	class ChurnThread : public LLThread
+	{
+	public:
+		ChurnThread(S32 seed, S32 iterations, LLAtomicS32& go, LLAtomicS32& finished)
+			: LLThread("Memory pool benchmark"),
+			  mSeed(seed),
+			  mIterations(iterations),
+			  mGo(go),
+			  mFinished(finished)
+		{
+		}
+
+	protected:
+		/*virtual*/ void run()
+		{
+			const S32 WINDOW = 1024;
+			void* live[WINDOW];
+			memset(live, 0, sizeof(live));
+			U32 random = (U32)mSeed * 2654435761U + 1;
+
+			while (mGo == 0)
+			{
+				yield();
+			}
+			for (S32 i = 0; i < mIterations; ++i)
+			{
+				random = random * 1664525 + 1013904223;
+				S32 slot = (random >> 8) % WINDOW;
+				size_t size = (random >> 24) < 4 ? 8192 : 16 + ((random >> 16) & 0xff);
+				HEAP::deallocate(live[slot]);
+				live[slot] = HEAP::allocate(size);
+			}
+			for (S32 i = 0; i < WINDOW; ++i)
+			{
+				HEAP::deallocate(live[i]);
+			}
+			mFinished++;
+		}
+
+	private:
+		S32 mSeed;
+		S32 mIterations;
+		LLAtomicS32& mGo;
+		LLAtomicS32& mFinished;
+	};
+
+	// Returns nanoseconds per allocate/deallocate pair with num_threads
+	// threads going at once.
+	template <class HEAP>
+	F64 time_churn(S32 num_threads, S32 iterations)
+	{
+		LLAtomicS32 go(0);
+		LLAtomicS32 finished(0);
+		std::vector<LLThread*> threads;
+		for (S32 i = 0; i < num_threads; ++i)
+		{
+			threads.push_back(new ChurnThread<HEAP>(i, iterations, go, finished));
+			threads.back()->start();
+		}
+
+		LLTimer timer;
+		go = 1;
+		while (finished < num_threads)
+		{
+			ms_sleep(1);
+		}
+		F64 elapsed = timer.getElapsedTimeF64();
+
+		for (S32 i = 0; i < num_threads; ++i)
+		{
+			while (!threads[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+			delete threads[i];
+		}
+		return elapsed * 1000000000.0 / ((F64)num_threads * iterations);
+	}
+}
+
+//static
+void LLMemPool::benchmark(S32 max_threads)
+{
+	const S32 ITERATIONS = 1000000;
+
+	for (S32 num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+	{
+		F64 pool = time_churn<PoolHeap>(num_threads, ITERATIONS);
+		F64 system = time_churn<SystemHeap>(num_threads, ITERATIONS);
+		llinfos << "Memory pool benchmark: " << num_threads << " threads, ns per allocate and free pool/malloc: "
+				<< pool << "/" << system << llendl;
+	}
+}
@@ -0,0 +1,175 @@
+/**
+ * @file llmempool.h
+ * @brief Size-classed allocator with thread-local caches and per-LLMemType accounting
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMEMPOOL_H
+#define LL_LLMEMPOOL_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include "llmemtype.h"
+
+// LLMemPool hands out blocks from a fixed set of size classes.  Each thread
+// keeps a free list per class and only touches shared state when a list
+// runs dry or grows too long, and then moves blocks in batches, so threads
+// churning small objects (LLSD nodes, packets, volume faces) stop contending
+// on the general heap.  Requests larger than the biggest class go to
+// malloc() but are still tagged and counted.
+//
+// Every block records the LLMemType it was allocated under, and each thread
+// keeps its own live byte and allocation counts per type, so the accounting
+// costs two unshared adds and is on in every build.  getUsage() sums the
+// threads' counts; a block freed on another thread than the one that
+// allocated it is still counted correctly overall.
+//
+// Blocks are 8 byte aligned.  Memory from freed small blocks stays in the
+// pool for reuse rather than going back to the system.
+//
+// LLThread releases its thread's cache when run() returns.  Other threads
+// that allocate from the pool should call releaseThreadCache() before they
+// exit, or their cached blocks are stranded.
+
+class LL_COMMON_API LLMemPool
+{
+public:
+	enum
+	{
+		MAX_TYPES = 256,			// LLMemType ids at or past this count as MTYPE_OTHER
+		MAX_SMALL_SIZE = 32768		// largest block, header included, served from size classes
+	};
+
+	// Returns NULL if the system is out of memory.  A size of 0 is allowed.
+	static void* allocate(size_t size, S32 mem_type);
+	static void* allocate(size_t size, const LLMemType::DeclareMemType& mem_type)
+	{
+		return allocate(size, mem_type.mID);
+	}
+
+	// ptr must come from allocate() or reallocate(), on any thread.  NULL is
+	// ignored.
+	static void deallocate(void* ptr);
+
+	// Like realloc(), keeping ptr's type.  Returns NULL and leaves ptr alone
+	// if the system is out of memory.
+	static void* reallocate(void* ptr, size_t size);
+
+	// The size ptr was allocated with, and its type.
+	static size_t getSize(const void* ptr);
+	static S32 getType(const void* ptr);
+
+	struct Usage
+	{
+		S32	mType;		// LLMemType id
+		S64	mBytes;		// requested bytes currently allocated
+		S32	mCount;		// blocks currently allocated
+	};
+
+	// Live totals for one type, or for every type with blocks outstanding,
+	// most bytes first.  The counts are read without stopping other threads,
+	// so they can be a few allocations behind.
+	static Usage getUsage(S32 mem_type);
+	static void getUsage(std::vector<Usage>& usage);
+
+	// Hands the calling thread's cached blocks back to the shared lists.
+	// The thread may keep using the pool; it gets a new cache on demand.
+	static void releaseThreadCache();
+
+	// Logs allocate/deallocate throughput against malloc()/free() for each
+	// number of threads from 1 to max_threads.
+	static void benchmark(S32 max_threads);
+};
+
+// STL allocator for containers whose storage should come from LLMemPool
+// under a given LLMemType, e.g.
+//
+//	std::vector<U16, LLMemPoolAllocator<U16> > mIndices;
+//	...
+//	mIndices(LLMemPoolAllocator<U16>(LLMemType::MTYPE_VOLUME))
+//
+// Any two compare equal: a block can be freed whatever type it came from.
+template <class T>
+class LLMemPoolAllocator
+{
+public:
+	typedef T				value_type;
+	typedef T*				pointer;
+	typedef const T*		const_pointer;
+	typedef T&				reference;
+	typedef const T&		const_reference;
+	typedef size_t			size_type;
+	typedef ptrdiff_t		difference_type;
+
+	template <class U>
+	struct rebind
+	{
+		typedef LLMemPoolAllocator<U> other;
+	};
+
+	LLMemPoolAllocator() : mType(LLMemType::MTYPE_OTHER.mID) {}
+	explicit LLMemPoolAllocator(const LLMemType::DeclareMemType& mem_type) : mType(mem_type.mID) {}
+	template <class U>
+	LLMemPoolAllocator(const LLMemPoolAllocator<U>& other) : mType(other.getType()) {}
+
+	pointer address(reference x) const				{ return &x; }
+	const_pointer address(const_reference x) const	{ return &x; }
+
+	pointer allocate(size_type n, const void* = 0)
+	{
+		void* ptr = LLMemPool::allocate(n * sizeof(T), mType);
+		if (!ptr)
+		{
+			throw std::bad_alloc();
+		}
+		return (pointer)ptr;
+	}
+
+	void deallocate(pointer ptr, size_type)			{ LLMemPool::deallocate(ptr); }
+
+	size_type max_size() const						{ return size_t(-1) / sizeof(T); }
+
+	void construct(pointer ptr, const T& val)		{ new ((void*)ptr) T(val); }
+	void destroy(pointer ptr)						{ ptr->~T(); }
+
+	S32 getType() const								{ return mType; }
+
+private:
+	S32 mType;
+};
+
+template <class T, class U>
+inline bool operator==(const LLMemPoolAllocator<T>&, const LLMemPoolAllocator<U>&)
+{
+	return true;
+}
+
+template <class T, class U>
+inline bool operator!=(const LLMemPoolAllocator<T>&, const LLMemPoolAllocator<U>&)
+{
+	return false;
+}
+
+#endif
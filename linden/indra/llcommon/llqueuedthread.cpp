@@ -26,20 +26,50 @@
 #include "linden_common.h"
 #include "llqueuedthread.h"
 
+#include "llfasttimer.h"
 #include "llstl.h"
+#include "lltaskscheduler.h"
 #include "lltimer.h"	// ms_sleep()
 
+// How long a pump works through the queue before giving its worker back
+static const F64 PUMP_TIME_SLICE = .01;
+
+//============================================================================
+
+class LLQueuedThread::Pump : public LLTaskScheduler::Task
+{
+public:
+	Pump(LLQueuedThread* thread) : mThread(thread) {}
+
+	/*virtual*/ void run()
+	{
+		mThread->runPump();
+	}
+
+private:
+	LLQueuedThread* mThread;
+};
+
 //============================================================================
 
 // MAIN THREAD
-LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded) :
+LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded, LLTaskScheduler* scheduler) :
 	LLThread(name),
 	mThreaded(threaded),
 	mIdleThread(TRUE),
 	mNextHandle(0),
-	mStarted(FALSE)
+	mStarted(FALSE),
+	mScheduler(threaded ? scheduler : NULL),
+	mMaxPumps(1),
+	mActivePumps(0)
 {
-	if (mThreaded)
+	if (mScheduler)
+	{
+		// No thread of our own, but we are running as far as
+		// isPaused() and setQuitting() are concerned.
+		mStatus = RUNNING;
+	}
+	else if (mThreaded)
 	{
 		start();
 	}
@@ -61,7 +91,34 @@ void LLQueuedThread::shutdown()
 	setQuitting();
 
 	unpause(); // MAIN THREAD
-	if (mThreaded)
+	if (mScheduler)
+	{
+		// Pumps notice we are quitting after their current request.
+		S32 timeout = 10000;
+		for ( ; timeout>0; timeout--)
+		{
+			lockData();
+			S32 active = mActivePumps;
+			unlockData();
+			if (active == 0)
+			{
+				break;
+			}
+			ms_sleep(1);
+		}
+		if (timeout == 0)
+		{
+			llwarns << "~LLQueuedThread (" << mName << ") timed out!" << llendl;
+		}
+		if (mStarted)
+		{
+			// Nothing else runs for us now, so this is as good as the thread.
+			endThread();
+			mStarted = FALSE;
+		}
+		mStatus = STOPPED;
+	}
+	else if (mThreaded)
 	{
 		S32 timeout = 100;
 		for ( ; timeout>0; timeout--)
@@ -129,8 +186,12 @@ S32 LLQueuedThread::updateQueue(U32 max_time_ms)
 		pending = getPending();
 		if(pending > 0)
 		{
-		unpause();
-	}
+			unpause();
+			if (mScheduler)
+			{
+				schedulePump();
+			}
+		}
 	}
 	else
 	{
@@ -149,7 +210,11 @@ void LLQueuedThread::incQueue()
 	// Something has been added to the queue
 	if (!isPaused())
 	{
-		if (mThreaded)
+		if (mScheduler)
+		{
+			schedulePump();
+		}
+		else if (mThreaded)
 		{
 			wake(); // Wake the thread up if necessary.
 		}
@@ -393,7 +458,9 @@ bool LLQueuedThread::check()
 //============================================================================
 // Runs on its OWN thread
 
-S32 LLQueuedThread::processNextRequest()
+static LLFastTimer::DeclareTimer FTM_PROCESS_QUEUED_REQUEST("Queued Request");
+
+S32 LLQueuedThread::processNextRequest(bool* backed_off)
 {
 	QueuedRequest *req;
 	// Get next request from pool
@@ -436,7 +503,11 @@ S32 LLQueuedThread::processNextRequest()
 	if (req)
 	{
 		// process request		
-		bool complete = req->processRequest();
+		bool complete;
+		{
+			LLFastTimer t(FTM_PROCESS_QUEUED_REQUEST);
+			complete = req->processRequest();
+		}
 
 		if (complete)
 		{
@@ -459,7 +530,14 @@ S32 LLQueuedThread::processNextRequest()
 			unlockData();
 			if (mThreaded && start_priority < PRIORITY_NORMAL)
 			{
-				ms_sleep(1); // sleep the thread a little
+				if (backed_off)
+				{
+					*backed_off = true;
+				}
+				else
+				{
+					ms_sleep(1); // sleep the thread a little
+				}
 			}
 		}
 	}
@@ -513,6 +591,110 @@ void LLQueuedThread::run()
 	llinfos << "LLQueuedThread " << mName << " EXITING." << llendl;
 }
 
+//============================================================================
+// Scheduled mode
+
+// MAIN THREAD
+void LLQueuedThread::setMaxConcurrency(S32 count)
+{
+	lockData();
+	mMaxPumps = llmax(count, 1);
+	unlockData();
+}
+
+// ANY THREAD: incQueue() calls it, from the main thread or a worker
+void LLQueuedThread::schedulePump()
+{
+	llassert(mScheduler);
+	lockData();
+	// Checked under the lock so that shutdown(), once it has seen no active
+	// pumps, never sees another one posted.
+	if (!isPaused() && !isQuitting())
+	{
+		// One pump per queued request at most, each in the lane of the most
+		// urgent request.
+		while (mActivePumps < mMaxPumps && mActivePumps < (S32)mRequestQueue.size())
+		{
+			++mActivePumps;
+			U32 priority = (*mRequestQueue.begin())->getPriority();
+			mScheduler->schedule(new Pump(this), LLTaskScheduler::laneForPriority(priority));
+		}
+	}
+	unlockData();
+}
+
+// Runs on a SCHEDULER thread, in place of run()
+void LLQueuedThread::runPump()
+{
+	if (!mStarted)
+	{
+		lockData();
+		if (!mStarted && !isQuitting())
+		{
+			startThread();
+			mStarted = TRUE;
+		}
+		unlockData();
+	}
+
+	// Work through the queue for a time slice, then give the worker back so
+	// other subsystems get a turn.  Low priority requests that go back in
+	// the queue sleep the pump for a millisecond, as they did the thread, so
+	// a queue of nothing but waiting requests polls at about 1 kHz rather
+	// than spinning.  If the slice did nothing but back off, the pump comes
+	// back in the low lane behind everyone else's work.
+	bool progressed = false;
+	LLTimer timer;
+	while (!isQuitting() && !isPaused())
+	{
+		mIdleThread = FALSE;
+
+		threadedUpdate();
+
+		bool backed_off = false;
+		S32 pending = processNextRequest(&backed_off);
+		if (!backed_off)
+		{
+			progressed = true;
+		}
+		if (pending == 0 || timer.getElapsedTimeF64() > PUMP_TIME_SLICE)
+		{
+			break;
+		}
+		if (backed_off)
+		{
+			ms_sleep(1);
+		}
+	}
+
+	// Deciding to post again and giving up this pump's count happen under
+	// one lock: once shutdown() has seen no active pumps, no pump touches
+	// this object again.
+	lockData();
+	bool more = !mRequestQueue.empty();
+	if (more && !isQuitting() && !isPaused())
+	{
+		// This pump's count passes to the next one.
+		LLTaskScheduler::ELane lane = LLTaskScheduler::LANE_LOW;
+		if (progressed)
+		{
+			lane = LLTaskScheduler::laneForPriority((*mRequestQueue.begin())->getPriority());
+		}
+		mScheduler->schedule(new Pump(this), lane);
+	}
+	else
+	{
+		--mActivePumps;
+		if (!more && mActivePumps == 0)
+		{
+			mIdleThread = TRUE;
+		}
+	}
+	unlockData();
+}
+
+//============================================================================
+
 // virtual
 void LLQueuedThread::startThread()
 {
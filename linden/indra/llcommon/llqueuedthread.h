@@ -37,9 +37,20 @@
 #include "llthread.h"
 #include "llsimplehash.h"
 
+class LLTaskScheduler;
+
 //============================================================================
 // Note: ~LLQueuedThread is O(N) N=# of queued threads, assumed to be small
 //   It is assumed that LLQueuedThreads are rarely created/destroyed.
+//
+// Given an LLTaskScheduler, a threaded LLQueuedThread doesn't start a thread
+// of its own.  Instead it posts "pump" tasks to the scheduler while it has
+// requests, each of which works through the queue exactly like run() would.
+// Requests keep their priorities, flags and completion rules.  By default
+// only one pump runs at a time, so startThread(), threadedUpdate(),
+// endThread() and processRequest() never overlap, as before; subclasses
+// whose requests are independent can raise that with setMaxConcurrency(),
+// in which case threadedUpdate() must be safe to call concurrently.
 
 class LL_COMMON_API LLQueuedThread : public LLThread
 {
@@ -149,15 +160,21 @@ public:
 	static handle_t nullHandle() { return handle_t(0); }
 	
 public:
-	LLQueuedThread(const std::string& name, bool threaded = true);
+	LLQueuedThread(const std::string& name, bool threaded = true, LLTaskScheduler* scheduler = NULL);
 	virtual ~LLQueuedThread();	
 	virtual void shutdown();
 	
 private:
+	class Pump;
+	friend class Pump;
+
 	// No copy constructor or copy assignment
 	LLQueuedThread(const LLQueuedThread&);
 	LLQueuedThread& operator=(const LLQueuedThread&);
 
+	void schedulePump();
+	void runPump();
+
 	virtual bool runCondition(void);
 	virtual void run(void);
 	virtual void startThread(void);
@@ -167,7 +184,9 @@ private:
 protected:
 	handle_t generateHandle();
 	bool addRequest(QueuedRequest* req);
-	S32  processNextRequest(void);
+	// With backed_off, a low priority request that went back in the queue
+	// sets it instead of sleeping the thread.
+	S32  processNextRequest(bool* backed_off = NULL);
 	void incQueue();
 
 public:
@@ -181,6 +200,10 @@ public:
 
 	S32 getPending();
 	bool getThreaded() { return mThreaded ? true : false; }
+	bool isScheduled() const { return mScheduler != NULL; }
+
+	// Most pumps to run at once in scheduled mode (default 1).  MAIN THREAD
+	void setMaxConcurrency(S32 count);
 
 	// Request accessors
 	status_t getRequestStatus(handle_t handle);
@@ -208,6 +231,10 @@ protected:
 	request_hash_t mRequestHash;
 
 	handle_t mNextHandle;
+
+	LLTaskScheduler* mScheduler;	// NULL unless scheduled
+	S32 mMaxPumps;
+	S32 mActivePumps;		// queued or running; guarded by lockData()
 };
 
 #endif // LL_LLQUEUEDTHREAD_H
@@ -30,6 +30,7 @@
 #include "llerror.h"
 #include "../llmath/llmath.h"
 #include "llformat.h"
+#include "llmempool.h"
 #include "llsdserialize.h"
 
 #ifndef LL_RELEASE_FOR_DOWNLOAD
@@ -75,6 +76,11 @@ protected:
 	bool shared() const							{ return mUseCount > 1; }
 	
 public:
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr);
+		///< impls come from LLMemPool and are counted as MTYPE_LLSD, since
+		//	 they are made and thrown away by every thread that touches LLSD
+
 	static void reset(Impl*& var, Impl* impl);
 		///< safely set var to refer to the new impl (possibly shared)
 		
@@ -562,6 +568,23 @@ LLSD::Impl::~Impl()
 	--sOutstandingCount;
 }
 
+//static
+void* LLSD::Impl::operator new(size_t size)
+{
+	void* ptr = LLMemPool::allocate(size, LLMemType::MTYPE_LLSD);
+	if (!ptr)
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+//static
+void LLSD::Impl::operator delete(void* ptr)
+{
+	LLMemPool::deallocate(ptr);
+}
+
 void LLSD::Impl::reset(Impl*& var, Impl* impl)
 {
 	if (impl) ++impl->mUseCount;
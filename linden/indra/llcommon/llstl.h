@@ -275,8 +275,8 @@ inline bool vector_replace_with_last(std::vector<T>& invec, const T& val)
 }
 
 // Append N elements to the vector and return a pointer to the first new element.
-template <typename T>
-inline T* vector_append(std::vector<T>& invec, S32 N)
+template <typename T, typename A>
+inline T* vector_append(std::vector<T, A>& invec, S32 N)
 {
 	U32 sz = invec.size();
 	invec.resize(sz+N);
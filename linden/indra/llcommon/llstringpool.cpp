@@ -0,0 +1,487 @@
+/**
+ * @file llstringpool.cpp
+ * @brief Thread-safe interned string pool
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llstringpool.h"
+
+#include <algorithm>
+#include <set>
+
+#include "llapr.h"
+#include "llthread.h"
+#include "lltimer.h"
+
+namespace
+{
+	const U32 MIN_TABLE_SIZE = 16;
+	const size_t ARENA_BLOCK_SIZE = 16 * 1024;
+	// keeps every entry on a boundary good for any of its members
+	const size_t ENTRY_SIZE = (sizeof(LLStringPool::Entry) + 15) & ~(size_t)15;
+
+	bool entry_less(const LLStringPool::Entry* lhs, const LLStringPool::Entry* rhs)
+	{
+		return lhs->mStdString < rhs->mStdString;
+	}
+}
+
+LLStringPool::Entry::Entry(const char* str, size_t length, U32 hash)
+:	mStdString(str, length),
+	mString(const_cast<char*>(mStdString.c_str())),
+	mHash(hash)
+{
+}
+
+// An open addressing table of entry pointers, kept at most half full so a
+// probe always ends at an empty slot.  Slots go from NULL to an entry once
+// and never change again.
+struct LLStringPool::Table
+{
+	U32				mMask;
+	Entry* volatile	mSlots[1];	// [mMask + 1]
+
+	static Table* create(U32 size)
+	{
+		Table* table = (Table*)calloc(1, sizeof(Table) + (size - 1) * sizeof(Entry*));
+		table->mMask = size - 1;
+		return table;
+	}
+
+	// Only for a table no reader can see yet.
+	void add(Entry* entry)
+	{
+		U32 slot = entry->mHash & mMask;
+		while (mSlots[slot])
+		{
+			slot = (slot + 1) & mMask;
+		}
+		mSlots[slot] = entry;
+	}
+};
+
+struct LLStringPool::Shard
+{
+	Table* volatile		mTable;
+	LLAtomicU32			mLock;
+	U32					mCount;			// only changed with the lock held
+	std::vector<Table*>	mRetired;		// outgrown tables readers may still be walking
+	std::vector<char*>	mBlocks;		// arena the entries live in
+	char*				mBlockPos;
+	char*				mBlockEnd;
+
+	Shard()
+	:	mTable(NULL),
+		mLock(0),
+		mCount(0),
+		mBlockPos(NULL),
+		mBlockEnd(NULL)
+	{
+	}
+
+	// A spin lock rather than an LLMutex: the global pools are built during
+	// static initialization, before APR can hand out mutexes on Windows, and
+	// the lock is only taken to add a string nobody has seen yet.
+	void lock()
+	{
+		while (mLock.compareAndSwap(0, 1) != 0)
+		{
+			LLThread::yield();
+		}
+	}
+
+	void unlock()
+	{
+		mLock.compareAndSwap(1, 0);
+	}
+
+	Entry* add(const char* str, size_t length, U32 hash)
+	{
+		if (mBlockPos + ENTRY_SIZE > mBlockEnd)
+		{
+			mBlockPos = new char[ARENA_BLOCK_SIZE];
+			mBlockEnd = mBlockPos + ARENA_BLOCK_SIZE;
+			mBlocks.push_back(mBlockPos);
+		}
+		Entry* entry = new (mBlockPos) Entry(str, length, hash);
+		mBlockPos += ENTRY_SIZE;
+
+		Table* table = mTable;
+		if ((mCount + 1) * 2 > table->mMask + 1)
+		{
+			Table* bigger = Table::create((table->mMask + 1) * 2);
+			for (U32 i = 0; i <= table->mMask; ++i)
+			{
+				if (table->mSlots[i])
+				{
+					bigger->add(table->mSlots[i]);
+				}
+			}
+			apr_atomic_xchgptr((volatile void**)&mTable, bigger);
+			mRetired.push_back(table);
+			table = bigger;
+		}
+
+		U32 slot = hash & table->mMask;
+		while (table->mSlots[slot])
+		{
+			slot = (slot + 1) & table->mMask;
+		}
+		// the exchange is a full barrier, so a reader that sees the pointer
+		// sees a constructed entry
+		apr_atomic_casptr((volatile void**)&table->mSlots[slot], entry, NULL);
+		++mCount;
+		return entry;
+	}
+
+	void reset(U32 table_size)
+	{
+		if (mTable)
+		{
+			for (U32 i = 0; i <= mTable->mMask; ++i)
+			{
+				if (mTable->mSlots[i])
+				{
+					mTable->mSlots[i]->~Entry();
+				}
+			}
+			free(mTable);
+		}
+		for (size_t i = 0; i < mRetired.size(); ++i)
+		{
+			free(mRetired[i]);
+		}
+		mRetired.clear();
+		for (size_t i = 0; i < mBlocks.size(); ++i)
+		{
+			delete[] mBlocks[i];
+		}
+		mBlocks.clear();
+		mBlockPos = mBlockEnd = NULL;
+		mCount = 0;
+		mTable = table_size ? Table::create(table_size) : NULL;
+	}
+};
+
+LLStringPool::LLStringPool(U32 capacity)
+:	mShards(new Shard[SHARD_COUNT])
+{
+	U32 table_size = MIN_TABLE_SIZE;
+	while (table_size * SHARD_COUNT < capacity * 2)
+	{
+		table_size *= 2;
+	}
+	for (S32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		mShards[i].reset(table_size);
+	}
+}
+
+LLStringPool::~LLStringPool()
+{
+	for (S32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		mShards[i].reset(0);
+	}
+	delete[] mShards;
+}
+
+//static
+U32 LLStringPool::hash(const char* str, size_t length)
+{
+	// FNV-1a, then a finalizer so the top bits that pick the shard depend
+	// on every character too
+	U32 hash = 2166136261u;
+	for (size_t i = 0; i < length; ++i)
+	{
+		hash = (hash ^ (U8)str[i]) * 16777619u;
+	}
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+//static
+LLStringPool::Entry* LLStringPool::findIn(const Table* table, const char* str, size_t length, U32 hash)
+{
+	for (U32 slot = hash & table->mMask; ; slot = (slot + 1) & table->mMask)
+	{
+		Entry* entry = table->mSlots[slot];
+		if (!entry)
+		{
+			return NULL;
+		}
+		if (entry->mHash == hash
+			&& entry->mStdString.size() == length
+			&& !memcmp(entry->mStdString.data(), str, length))
+		{
+			return entry;
+		}
+	}
+}
+
+LLStringPool::Entry* LLStringPool::find(const char* str, size_t length) const
+{
+	U32 h = hash(str, length);
+	const Shard& shard = mShards[h >> (32 - SHARD_BITS)];
+	const Table* table = shard.mTable;
+	Entry* entry = findIn(table, str, length, h);
+	// A table that was outgrown while we walked it can miss the newest
+	// strings; they're in the one that replaced it.
+	while (!entry && table != shard.mTable)
+	{
+		table = shard.mTable;
+		entry = findIn(table, str, length, h);
+	}
+	return entry;
+}
+
+LLStringPool::Entry* LLStringPool::find(const char* str) const
+{
+	return str ? find(str, strlen(str)) : NULL;	/* Flawfinder: ignore */
+}
+
+LLStringPool::Entry* LLStringPool::intern(const char* str, size_t length)
+{
+	Entry* entry = find(str, length);
+	if (!entry)
+	{
+		U32 h = hash(str, length);
+		Shard& shard = mShards[h >> (32 - SHARD_BITS)];
+		shard.lock();
+		// someone may have beaten us to it
+		entry = findIn(shard.mTable, str, length, h);
+		if (!entry)
+		{
+			entry = shard.add(str, length, h);
+		}
+		shard.unlock();
+	}
+	return entry;
+}
+
+LLStringPool::Entry* LLStringPool::intern(const char* str)
+{
+	return str ? intern(str, strlen(str)) : NULL;	/* Flawfinder: ignore */
+}
+
+U32 LLStringPool::size() const
+{
+	U32 count = 0;
+	for (S32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		count += mShards[i].mCount;
+	}
+	return count;
+}
+
+void LLStringPool::getEntries(std::vector<Entry*>& entries) const
+{
+	entries.clear();
+	for (S32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		const Table* table = mShards[i].mTable;
+		for (U32 slot = 0; slot <= table->mMask; ++slot)
+		{
+			Entry* entry = table->mSlots[slot];
+			if (entry)
+			{
+				entries.push_back(entry);
+			}
+		}
+	}
+	std::sort(entries.begin(), entries.end(), entry_less);
+}
+
+void LLStringPool::clear()
+{
+	for (S32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		mShards[i].reset(MIN_TABLE_SIZE);
+	}
+}
+
+//============================================================================
+// Benchmark
+
+namespace
+{
+	// What the pool replaced in spirit: one big lock around a std::set.
+	class LockedStringSet
+	{
+	public:
+		LockedStringSet() : mMutex(NULL) {}
+
+		LLStdStringHandle intern(const std::string& str)
+		{
+			LLMutexLock lock(&mMutex);
+			return &*mStrings.insert(str).first;
+		}
+
+		LLStdStringHandle find(const std::string& str)
+		{
+			LLMutexLock lock(&mMutex);
+			std::set<std::string>::iterator it = mStrings.find(str);
+			return it != mStrings.end() ? &*it : NULL;
+		}
+
+	private:
+		LLMutex mMutex;
+		std::set<std::string> mStrings;
+	};
+
+	class PoolAdapter
+	{
+	public:
+		LLStdStringHandle intern(const std::string& str)	{ return &mPool.intern(str)->mStdString; }
+		LLStdStringHandle find(const std::string& str)
+		{
+			LLStringPool::Entry* entry = mPool.find(str);
+			return entry ? &entry->mStdString : NULL;
+		}
+
+	private:
+		LLStringPool mPool;
+	};
+
+	template <class T>
+	class NameThread : public LLThread
+	{
+	public:
+		NameThread(T* target, const std::vector<std::string>& names, S32 passes, bool lookup,
+				   LLAtomicS32& go, LLAtomicS32& finished)
+			: LLThread("String pool benchmark"),
+			  mTarget(target),
+			  mNames(names),
+			  mPasses(passes),
+			  mLookup(lookup),
+			  mGo(go),
+			  mFinished(finished)
+		{
+		}
+
+	protected:
+		/*virtual*/ void run()
+		{
+			while (mGo == 0)
+			{
+				yield();
+			}
+			for (S32 pass = 0; pass < mPasses; ++pass)
+			{
+				for (size_t i = 0; i < mNames.size(); ++i)
+				{
+					if (mLookup)
+					{
+						mTarget->find(mNames[i]);
+					}
+					else
+					{
+						mTarget->intern(mNames[i]);
+					}
+				}
+			}
+			mFinished++;
+		}
+
+	private:
+		T* mTarget;
+		const std::vector<std::string>& mNames;
+		S32 mPasses;
+		bool mLookup;
+		LLAtomicS32& mGo;
+		LLAtomicS32& mFinished;
+	};
+
+	// Returns nanoseconds per call with num_threads threads going at once.
+	// Interning starts from an empty target, so the first pass adds.
+	template <class T>
+	F64 time_names(const std::vector<std::string>& names, S32 num_threads, S32 passes, bool lookup)
+	{
+		T target;
+		if (lookup)
+		{
+			for (size_t i = 0; i < names.size(); ++i)
+			{
+				target.intern(names[i]);
+			}
+		}
+
+		LLAtomicS32 go(0);
+		LLAtomicS32 finished(0);
+		std::vector<LLThread*> threads;
+		for (S32 i = 0; i < num_threads; ++i)
+		{
+			threads.push_back(new NameThread<T>(&target, names, passes, lookup, go, finished));
+			threads.back()->start();
+		}
+
+		LLTimer timer;
+		go = 1;
+		while (finished < num_threads)
+		{
+			ms_sleep(1);
+		}
+		F64 elapsed = timer.getElapsedTimeF64();
+
+		for (S32 i = 0; i < num_threads; ++i)
+		{
+			while (!threads[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+			delete threads[i];
+		}
+		return elapsed * 1000000000.0 / ((F64)num_threads * passes * names.size());
+	}
+}
+
+//static
+void LLStringPool::benchmark(S32 max_threads)
+{
+	const S32 NAMES = 4096;
+	const S32 INTERN_PASSES = 4;
+	const S32 LOOKUP_PASSES = 64;
+
+	// shaped like message and XUI names
+	std::vector<std::string> names;
+	for (S32 i = 0; i < NAMES; ++i)
+	{
+		names.push_back(llformat("%sBlock%dData", (i & 1) ? "Agent" : "Object", i));
+	}
+
+	for (S32 num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+	{
+		F64 pool_intern = time_names<PoolAdapter>(names, num_threads, INTERN_PASSES, false);
+		F64 set_intern = time_names<LockedStringSet>(names, num_threads, INTERN_PASSES, false);
+		F64 pool_find = time_names<PoolAdapter>(names, num_threads, LOOKUP_PASSES, true);
+		F64 set_find = time_names<LockedStringSet>(names, num_threads, LOOKUP_PASSES, true);
+		llinfos << "String pool benchmark: " << num_threads << " threads, ns per call pool/locked set: intern "
+				<< pool_intern << "/" << set_intern << " lookup " << pool_find << "/" << set_find << llendl;
+	}
+}
@@ -0,0 +1,114 @@
+/**
+ * @file llstringpool.h
+ * @brief Thread-safe interned string pool
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSTRINGPOOL_H
+#define LL_LLSTRINGPOOL_H
+
+#include <string>
+#include <vector>
+
+#include "stdtypes.h"
+
+typedef const std::string* LLStdStringHandle;
+
+// LLStringPool keeps one copy of each string it is handed and gives back a
+// pointer to that copy.  The copies never move or change until the pool is
+// destroyed, so two handles are equal exactly when their strings are, and
+// comparing names becomes comparing pointers.
+//
+// Any thread may intern() and find() at once.  Lookups take no lock: the
+// pool is split into shards by hash, each an open addressing table of entry
+// pointers that only ever gains entries, and a table that has to grow is
+// copied and swapped in rather than rehashed in place.  Adding a string
+// takes its shard's spin lock.  Entries are carved out of per-shard arena
+// blocks, so interning a few thousand names costs a handful of allocations.
+//
+// There is no removal; pools hold names (message variables, XML tags and
+// attributes, visual params) that come from a fixed vocabulary.
+
+class LL_COMMON_API LLStringPool
+{
+public:
+	class LL_COMMON_API Entry
+	{
+	public:
+		const std::string	mStdString;
+		// mStdString's characters, for callers that still pass char*
+		// around.  Nothing may write through it.
+		char* const			mString;
+		const U32			mHash;
+
+	private:
+		friend class LLStringPool;
+		Entry(const char* str, size_t length, U32 hash);
+	};
+
+	// capacity is a hint of how many strings to expect; 0 picks a default.
+	LLStringPool(U32 capacity = 0);
+	~LLStringPool();
+
+	// Returns the pool's copy of the first length characters of str,
+	// adding it if needed.
+	Entry* intern(const char* str, size_t length);
+	Entry* intern(const char* str);
+	Entry* intern(const std::string& str)		{ return intern(str.data(), str.size()); }
+
+	// As intern(), but NULL if the string was never added.
+	Entry* find(const char* str, size_t length) const;
+	Entry* find(const char* str) const;
+	Entry* find(const std::string& str) const	{ return find(str.data(), str.size()); }
+
+	U32 size() const;
+
+	// Every entry, for dumps.  Sorted by string so the output is stable.
+	void getEntries(std::vector<Entry*>& entries) const;
+
+	// Destroys every entry.  Not thread-safe: nobody else may be using the
+	// pool or any handle from it.
+	void clear();
+
+	// Logs intern and find throughput for each number of threads from 1 to
+	// max_threads, against a mutex-guarded std::set.
+	static void benchmark(S32 max_threads);
+
+	static U32 hash(const char* str, size_t length);
+
+private:
+	struct Table;
+	struct Shard;
+
+	enum { SHARD_BITS = 4, SHARD_COUNT = 1 << SHARD_BITS };
+
+	static Entry* findIn(const Table* table, const char* str, size_t length, U32 hash);
+
+	Shard*	mShards;	// [SHARD_COUNT]
+
+	// not copyable
+	LLStringPool(const LLStringPool&);
+	LLStringPool& operator=(const LLStringPool&);
+};
+
+#endif
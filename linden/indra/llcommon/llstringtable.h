@@ -31,39 +31,16 @@
 #include "lldefs.h"
 #include "llformat.h"
 #include "llstl.h"
+#include "llstringpool.h"
 #include <list>
 #include <set>
 
-#if LL_WINDOWS
-# if (_MSC_VER >= 1300 && _MSC_VER < 1400)
-#  define STRING_TABLE_HASH_MAP 1
-# endif
-#else
-//# define STRING_TABLE_HASH_MAP 1
-#endif
-
-#if STRING_TABLE_HASH_MAP
-# if LL_WINDOWS
-#  include <hash_map>
-# else
-#  include <ext/hash_map>
-# endif
-#endif
+// Both tables are front ends on LLStringPool, so either can be shared
+// between threads.  Strings stay in the table until it is destroyed.
 
 const U32 MAX_STRINGS_LENGTH = 256;
 
-class LL_COMMON_API LLStringTableEntry
-{
-public:
-	LLStringTableEntry(const char *str);
-	~LLStringTableEntry();
-
-	void incCount()		{ mCount++; }
-	BOOL decCount()		{ return --mCount; }
-
-	char *mString;
-	S32  mCount;
-};
+typedef LLStringPool::Entry LLStringTableEntry;
 
 class LL_COMMON_API LLStringTable
 {
@@ -80,23 +57,9 @@ public:
 	char *addString(const std::string& str);
 	LLStringTableEntry *addStringEntry(const char *str);
 	LLStringTableEntry *addStringEntry(const std::string& str);
-	void  removeString(const char *str);
 
-	S32 mMaxEntries;
-	S32 mUniqueEntries;
-	
-#if STRING_TABLE_HASH_MAP
-#if LL_WINDOWS
-	typedef std::hash_multimap<U32, LLStringTableEntry *> string_hash_t;
-#else
-	typedef __gnu_cxx::hash_multimap<U32, LLStringTableEntry *> string_hash_t;
-#endif
-	string_hash_t mStringHash;
-#else
-	typedef std::list<LLStringTableEntry *> string_list_t;
-	typedef string_list_t * string_list_ptr_t;
-	string_list_ptr_t	*mStringList;
-#endif	
+private:
+	LLStringPool mPool;
 };
 
 extern LL_COMMON_API LLStringTable gStringTable;
@@ -107,73 +70,32 @@ extern LL_COMMON_API LLStringTable gStringTable;
 // e.g. as a member of an LLXmlTree
 // Strings can be inserted only, then quickly looked up
 
-typedef const std::string* LLStdStringHandle;
-
 class LL_COMMON_API LLStdStringTable
 {
 public:
 	LLStdStringTable(S32 tablesize = 0)
+		: mPool(tablesize)
 	{
-		if (tablesize == 0)
-		{
-			tablesize = 256; // default
-		}
-		// Make sure tablesize is power of 2
-		for (S32 i = 31; i>0; i--)
-		{
-			if (tablesize & (1<<i))
-			{
-				if (tablesize >= (3<<(i-1)))
-					tablesize = (1<<(i+1));
-				else
-					tablesize = (1<<i);
-				break;
-			}
-		}
-		mTableSize = tablesize;
-		mStringList = new string_set_t[tablesize];
-	}
-	~LLStdStringTable()
-	{
-		cleanup();
-		delete[] mStringList;
 	}
 	void cleanup()
 	{
-		// remove strings
-		for (S32 i = 0; i<mTableSize; i++)
-		{
-			string_set_t& stringset = mStringList[i];
-			for (string_set_t::iterator iter = stringset.begin(); iter != stringset.end(); iter++)
-			{
-				delete *iter;
-			}
-			stringset.clear();
-		}
+		mPool.clear();
 	}
 
 	LLStdStringHandle lookup(const std::string& s)
 	{
-		U32 hashval = makehash(s);
-		return lookup(hashval, s);
+		LLStringPool::Entry* entry = mPool.find(s);
+		return entry ? &entry->mStdString : NULL;
 	}
 	
 	LLStdStringHandle checkString(const std::string& s)
 	{
-		U32 hashval = makehash(s);
-		return lookup(hashval, s);
+		return lookup(s);
 	}
 
 	LLStdStringHandle insert(const std::string& s)
 	{
-		U32 hashval = makehash(s);
-		LLStdStringHandle result = lookup(hashval, s);
-		if (result == NULL)
-		{
-			result = new std::string(s);
-			mStringList[hashval].insert(result);
-		}
-		return result;
+		return &mPool.intern(s)->mStdString;
 	}
 	LLStdStringHandle addString(const std::string& s)
 	{
@@ -181,36 +103,7 @@ public:
 	}
 	
 private:
-	U32 makehash(const std::string& s)
-	{
-		S32 len = (S32)s.size();
-		const char* c = s.c_str();
-		U32 hashval = 0;
-		for (S32 i=0; i<len; i++)
-		{
-			hashval = ((hashval<<5) + hashval) + *c++;
-		}
-		return hashval & (mTableSize-1);
-	}
-	LLStdStringHandle lookup(U32 hashval, const std::string& s)
-	{
-		string_set_t& stringset = mStringList[hashval];
-		LLStdStringHandle handle = &s;
-		string_set_t::iterator iter = stringset.find(handle); // compares actual strings
-		if (iter != stringset.end())
-		{
-			return *iter;
-		}
-		else
-		{
-			return NULL;
-		}
-	}
-	
-private:
-	S32 mTableSize;
-	typedef std::set<LLStdStringHandle, compare_pointer_contents<std::string> > string_set_t;
-	string_set_t* mStringList; // [mTableSize]
+	LLStringPool mPool;
 };
 
 
@@ -0,0 +1,526 @@
+/**
+ * @file lltaskscheduler.cpp
+ * @brief A pool of threads shared by the background subsystems.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "lltaskscheduler.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "llqueuedthread.h"
+#include "llstl.h"
+#include "lltimer.h"
+#include "llworkpool.h"
+
+//============================================================================
+
+class LLTaskScheduler::Worker : public LLThread
+{
+public:
+	Worker(const std::string& name, LLTaskScheduler* scheduler, S32 index)
+		: LLThread(name),
+		  mScheduler(scheduler),
+		  mIndex(index),
+		  mThreadID(0)
+	{
+	}
+
+	U32 getThreadID() const { return mThreadID; }
+
+protected:
+	/*virtual*/ void run()
+	{
+		mScheduler->runWorker(mIndex);
+	}
+
+private:
+	friend class LLTaskScheduler;
+
+	LLTaskScheduler* mScheduler;
+	S32 mIndex;
+	U32 mThreadID;	// set under mCondition before the constructor returns
+};
+
+//============================================================================
+
+LLTaskScheduler::Task::Task()
+	: mHandle(nullHandle()),
+	  mNotifyMain(false)
+{
+}
+
+LLTaskScheduler::Task::~Task()
+{
+}
+
+//virtual
+void LLTaskScheduler::Task::completed(bool cancelled)
+{
+}
+
+LLTaskScheduler::Queue::Queue()
+{
+	mMutex = new LLMutex(NULL, "LLTaskScheduler::Queue::mMutex");
+}
+
+LLTaskScheduler::Queue::~Queue()
+{
+	delete mMutex;
+}
+
+//============================================================================
+// MAIN THREAD
+
+LLTaskScheduler::LLTaskScheduler(const std::string& name, S32 num_threads)
+	: mName(name),
+	  mStarted(0),
+	  mQuitting(0),
+	  mPending(0),
+	  mOutstanding(0),
+	  mNextHandle(1),
+	  mNextQueue(0)
+{
+	mCondition = new LLCondition(NULL, "LLTaskScheduler::mCondition");
+	mCompletedMutex = new LLMutex(NULL, "LLTaskScheduler::mCompletedMutex");
+
+	if (num_threads < 0)
+	{
+		num_threads = LLWorkPool::getDefaultThreadCount();
+	}
+
+	for (S32 i = 0; i < llmax(num_threads, 1); ++i)
+	{
+		mQueues.push_back(new Queue);
+	}
+
+	for (S32 i = 0; i < num_threads; ++i)
+	{
+		Worker* worker = new Worker(llformat("%s %d", name.c_str(), i), this, i);
+		mThreads.push_back(worker);
+		worker->start();
+	}
+
+	// Workers are found by thread id in schedule(), and LLThread::shutdown()
+	// treats a thread that hasn't reached run() yet as stopped, so wait for
+	// all of them.
+	mCondition->lock();
+	while (mStarted < num_threads)
+	{
+		mCondition->wait();
+	}
+	mCondition->unlock();
+
+	llinfos << "Task scheduler '" << mName << "' started with " << num_threads << " threads" << llendl;
+}
+
+LLTaskScheduler::~LLTaskScheduler()
+{
+	mCondition->lock();
+	mQuitting = 1;
+	mCondition->broadcast();
+	mCondition->unlock();
+
+	// Workers finish the task in hand and leave the rest queued.
+	for (std::vector<Worker*>::iterator iter = mThreads.begin();
+		 iter != mThreads.end(); ++iter)
+	{
+		while (!(*iter)->isStopped())
+		{
+			ms_sleep(1);
+		}
+	}
+	for_each(mThreads.begin(), mThreads.end(), DeletePointer());
+	mThreads.clear();
+
+	S32 cancelled = 0;
+	for (std::vector<Queue*>::iterator iter = mQueues.begin();
+		 iter != mQueues.end(); ++iter)
+	{
+		for (S32 lane = 0; lane < LANE_COUNT; ++lane)
+		{
+			std::deque<Task*>& tasks = (*iter)->mLanes[lane];
+			while (!tasks.empty())
+			{
+				Task* task = tasks.front();
+				tasks.pop_front();
+				mPending--;
+				finishTask(task, true);
+				++cancelled;
+			}
+		}
+	}
+	deliverCompleted();
+	if (cancelled)
+	{
+		llwarns << "~LLTaskScheduler (" << mName << ") cancelled " << cancelled << " queued tasks" << llendl;
+	}
+
+	for_each(mQueues.begin(), mQueues.end(), DeletePointer());
+	mQueues.clear();
+
+	delete mCompletedMutex;
+	mCompletedMutex = NULL;
+	delete mCondition;
+	mCondition = NULL;
+}
+
+S32 LLTaskScheduler::update(U32 max_time_ms)
+{
+	F64 max_time = (F64)max_time_ms * .001;
+	LLTimer timer;
+
+	if (mThreads.empty())
+	{
+		while (Task* task = takeTask(0))
+		{
+			runTask(task);
+			if (max_time && timer.getElapsedTimeF64() > max_time)
+			{
+				break;
+			}
+		}
+	}
+
+	deliverCompleted();
+
+	return (S32)mOutstanding;
+}
+
+void LLTaskScheduler::deliverCompleted()
+{
+	std::vector<std::pair<Task*, bool> > completed;
+	mCompletedMutex->lock();
+	completed.swap(mCompleted);
+	mCompletedMutex->unlock();
+
+	for (std::vector<std::pair<Task*, bool> >::iterator iter = completed.begin();
+		 iter != completed.end(); ++iter)
+	{
+		iter->first->completed(iter->second);
+		delete iter->first;
+		mOutstanding--;
+	}
+}
+
+//static
+LLTaskScheduler::ELane LLTaskScheduler::laneForPriority(U32 priority)
+{
+	if (priority >= LLQueuedThread::PRIORITY_HIGH)
+	{
+		return LANE_HIGH;
+	}
+	else if (priority >= LLQueuedThread::PRIORITY_NORMAL)
+	{
+		return LANE_NORMAL;
+	}
+	return LANE_LOW;
+}
+
+//============================================================================
+// ANY THREAD
+
+LLTaskScheduler::handle_t LLTaskScheduler::schedule(Task* task, ELane lane, bool notify_main)
+{
+	llassert_always(task && lane >= 0 && lane < LANE_COUNT);
+
+	handle_t handle = mNextHandle++;
+	while (handle == nullHandle())
+	{
+		handle = mNextHandle++;
+	}
+	task->mHandle = handle;
+	task->mNotifyMain = notify_main;
+	mOutstanding++;
+
+	// Keep work spawned by a task local to its worker; spread the rest.
+	S32 index = getCurrentQueue();
+	if (index < 0)
+	{
+		index = (S32)(mNextQueue++ % (U32)mQueues.size());
+	}
+
+	Queue* queue = mQueues[index];
+	queue->mMutex->lock();
+	queue->mLanes[lane].push_back(task);
+	mPending++;
+	queue->mMutex->unlock();
+
+	// Workers check mPending under the condition before sleeping, so taking
+	// the lock here is enough to make sure one of them sees this task.
+	mCondition->lock();
+	mCondition->signal();
+	mCondition->unlock();
+
+	return handle;
+}
+
+bool LLTaskScheduler::cancel(handle_t handle)
+{
+	if (handle == nullHandle())
+	{
+		return false;
+	}
+
+	// Tasks never move between queues, so if the task is still queued one of
+	// these will have it.  Cancelling is rare enough that a scan is fine.
+	for (std::vector<Queue*>::iterator iter = mQueues.begin();
+		 iter != mQueues.end(); ++iter)
+	{
+		Queue* queue = *iter;
+		queue->mMutex->lock();
+		for (S32 lane = 0; lane < LANE_COUNT; ++lane)
+		{
+			std::deque<Task*>& tasks = queue->mLanes[lane];
+			for (std::deque<Task*>::iterator task_iter = tasks.begin();
+				 task_iter != tasks.end(); ++task_iter)
+			{
+				if ((*task_iter)->mHandle == handle)
+				{
+					Task* task = *task_iter;
+					tasks.erase(task_iter);
+					mPending--;
+					queue->mMutex->unlock();
+					finishTask(task, true);
+					return true;
+				}
+			}
+		}
+		queue->mMutex->unlock();
+	}
+	return false;
+}
+
+S32 LLTaskScheduler::getCurrentQueue()
+{
+	if (mThreads.empty())
+	{
+		return -1;
+	}
+	U32 id = LLThread::currentID();
+	for (S32 i = 0; i < (S32)mThreads.size(); ++i)
+	{
+		if (mThreads[i]->getThreadID() == id)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+LLTaskScheduler::Task* LLTaskScheduler::takeTask(S32 index)
+{
+	if (mPending == 0)
+	{
+		return NULL;
+	}
+
+	S32 count = (S32)mQueues.size();
+	for (S32 lane = 0; lane < LANE_COUNT; ++lane)
+	{
+		for (S32 i = 0; i < count; ++i)
+		{
+			Queue* queue = mQueues[(index + i) % count];
+			queue->mMutex->lock();
+			std::deque<Task*>& tasks = queue->mLanes[lane];
+			if (!tasks.empty())
+			{
+				// Our own queue runs oldest first, so nothing waits behind
+				// a stream of newer work.  Thieves take from the other end,
+				// the work its owner would have got to last.
+				Task* task;
+				if (i == 0)
+				{
+					task = tasks.front();
+					tasks.pop_front();
+				}
+				else
+				{
+					task = tasks.back();
+					tasks.pop_back();
+				}
+				mPending--;
+				queue->mMutex->unlock();
+				return task;
+			}
+			queue->mMutex->unlock();
+		}
+	}
+	return NULL;
+}
+
+void LLTaskScheduler::runTask(Task* task)
+{
+	task->run();
+	finishTask(task, false);
+}
+
+void LLTaskScheduler::finishTask(Task* task, bool cancelled)
+{
+	if (task->mNotifyMain)
+	{
+		mCompletedMutex->lock();
+		mCompleted.push_back(std::make_pair(task, cancelled));
+		mCompletedMutex->unlock();
+	}
+	else
+	{
+		delete task;
+		mOutstanding--;
+	}
+}
+
+//============================================================================
+// WORKER THREADS
+
+void LLTaskScheduler::runWorker(S32 index)
+{
+	mCondition->lock();
+	mThreads[index]->mThreadID = LLThread::currentID();
+	++mStarted;
+	mCondition->broadcast();
+	mCondition->unlock();
+
+	// Stops between tasks once the scheduler is going away, however much
+	// is still queued; the destructor cancels the rest.
+	while (!mQuitting)
+	{
+		Task* task = takeTask(index);
+		if (task)
+		{
+			runTask(task);
+			continue;
+		}
+
+		mCondition->lock();
+		while (!mQuitting && mPending == 0)
+		{
+			mCondition->wait();
+		}
+		mCondition->unlock();
+	}
+}
+
+//============================================================================
+// BENCHMARK
+
+namespace
+{
+	// Records how long it sat in the queue, then burns a few microseconds.
+	class BenchmarkTask : public LLTaskScheduler::Task
+	{
+	public:
+		BenchmarkTask(U32 work, U64* latency)
+			: mQueued(totalTime()), mWork(work), mLatency(latency) {}
+
+		/*virtual*/ void run()
+		{
+			*mLatency = totalTime() - mQueued;
+			U32 x = mWork;
+			for (U32 i = 0; i < mWork; ++i)
+			{
+				x = x * 1664525 + 1013904223;
+			}
+			sResult += x;
+		}
+
+		static LLAtomicU32 sResult;	// keeps the loop from being optimized away
+
+	private:
+		U64 mQueued;
+		U32 mWork;
+		U64* mLatency;
+	};
+
+	LLAtomicU32 BenchmarkTask::sResult(0);
+
+	U64 percentile(std::vector<U64>& values, F32 fraction)
+	{
+		if (values.empty())
+		{
+			return 0;
+		}
+		size_t index = llmin((size_t)(fraction * values.size()), values.size() - 1);
+		return values[index];
+	}
+}
+
+//static
+void LLTaskScheduler::benchmark(S32 num_threads)
+{
+	// Roughly the shape of a burst of texture requests: mostly normal
+	// priority, with some urgent and some background work mixed in.
+	const S32 TASKS = 20000;
+	const S32 BURST = 256;
+	const U32 WORK = 2000;
+
+	LLTaskScheduler scheduler("Benchmark", num_threads);
+	std::vector<U64> latency(TASKS, 0);
+	std::vector<ELane> lanes(TASKS, LANE_NORMAL);
+	for (S32 i = 0; i < TASKS; ++i)
+	{
+		lanes[i] = (i % 8 == 0) ? LANE_HIGH : (i % 4 == 0) ? LANE_LOW : LANE_NORMAL;
+	}
+
+	LLTimer timer;
+	for (S32 i = 0; i < TASKS; ++i)
+	{
+		scheduler.schedule(new BenchmarkTask(WORK, &latency[i]), lanes[i]);
+		if (i % BURST == BURST - 1)
+		{
+			// Let the backlog drain to half a burst before the next one.
+			while (scheduler.getPending() > BURST / 2)
+			{
+				scheduler.update(1);
+				LLThread::yield();
+			}
+		}
+	}
+	while (scheduler.update(0) > 0)
+	{
+		LLThread::yield();
+	}
+	F64 elapsed = timer.getElapsedTimeF64();
+
+	std::vector<U64> by_lane[LANE_COUNT];
+	for (S32 i = 0; i < TASKS; ++i)
+	{
+		by_lane[lanes[i]].push_back(latency[i]);
+	}
+	const char* lane_names[LANE_COUNT] = { "high", "normal", "low" };
+	std::ostringstream stats;
+	for (S32 lane = 0; lane < LANE_COUNT; ++lane)
+	{
+		std::sort(by_lane[lane].begin(), by_lane[lane].end());
+		stats << " " << lane_names[lane]
+			  << " p50 " << percentile(by_lane[lane], 0.5f)
+			  << " p99 " << percentile(by_lane[lane], 0.99f)
+			  << " max " << percentile(by_lane[lane], 1.f) << " us;";
+	}
+
+	llinfos << "Task scheduler benchmark: " << scheduler.getNumThreads() << " threads, "
+			<< (elapsed > 0.0 ? TASKS / elapsed : 0.0) << " tasks/s;"
+			<< stats.str() << llendl;
+}
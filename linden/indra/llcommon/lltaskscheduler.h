@@ -0,0 +1,172 @@
+/**
+ * @file lltaskscheduler.h
+ * @brief A pool of threads shared by the background subsystems.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTASKSCHEDULER_H
+#define LL_LLTASKSCHEDULER_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "llapr.h"
+#include "llthread.h"
+
+//============================================================================
+// LLTaskScheduler
+//
+// Runs independent tasks on a fixed set of threads.  Where LLWorkPool splits
+// one loop and waits for it, the scheduler takes fire-and-forget tasks from
+// any thread, so several subsystems can share the same cores instead of
+// each parking a thread of their own (see LLQueuedThread's scheduled mode).
+//
+// Every worker keeps a queue per lane.  Tasks scheduled from the main
+// thread are dealt out round-robin; tasks scheduled from inside a task stay
+// on the worker that made them.  A worker looks at the lanes from high to
+// low: in each it takes the oldest task from its own queue, or else steals
+// the newest one from another worker.  It only moves down a lane once nobody
+// has work in the one above, so LANE_LOW work never starts while LANE_HIGH
+// work is waiting anywhere in the pool.
+//
+// Usage:
+//   class MyTask : public LLTaskScheduler::Task
+//   {
+//       /*virtual*/ void run() { ...on a worker... }
+//       /*virtual*/ void completed(bool cancelled) { ...on the main thread... }
+//   };
+//   handle = scheduler->schedule(new MyTask, LLTaskScheduler::LANE_NORMAL, true);
+//   ...
+//   scheduler->update(1); // MAIN THREAD, delivers completed()
+//
+// The scheduler owns every task it is given and deletes it once it has run
+// (after completed() when notify_main was set) or was cancelled.  A
+// scheduler with zero threads runs its tasks on the main thread from update().
+
+class LL_COMMON_API LLTaskScheduler
+{
+public:
+	enum ELane
+	{
+		LANE_HIGH = 0,
+		LANE_NORMAL,
+		LANE_LOW,
+		LANE_COUNT
+	};
+
+	typedef U32 handle_t;
+	static handle_t nullHandle() { return handle_t(0); }
+
+	class LL_COMMON_API Task
+	{
+		friend class LLTaskScheduler;
+	public:
+		Task();
+		virtual ~Task();
+
+		// WORKER THREAD
+		virtual void run() = 0;
+		// MAIN THREAD, only for tasks scheduled with notify_main.  cancelled
+		// is true if the task was cancelled (or the scheduler destroyed)
+		// before run() was called.
+		virtual void completed(bool cancelled);
+
+		handle_t getHandle() const { return mHandle; }
+
+	private:
+		handle_t mHandle;
+		bool mNotifyMain;
+	};
+
+	// num_threads < 0 picks one thread per core, less one for the main thread.
+	LLTaskScheduler(const std::string& name, S32 num_threads = -1);
+	~LLTaskScheduler();
+
+	// ANY THREAD.  Takes ownership of task.
+	handle_t schedule(Task* task, ELane lane = LANE_NORMAL, bool notify_main = false);
+
+	// ANY THREAD.  Removes a task that hasn't started yet.  Returns false if
+	// it is already running or done; it will then complete normally.
+	bool cancel(handle_t handle);
+
+	// MAIN THREAD.  Delivers completion callbacks, and with no threads runs
+	// queued tasks too.  Returns the number of tasks still outstanding.
+	S32 update(U32 max_time_ms);
+
+	S32 getNumThreads() const { return (S32)mThreads.size(); }
+	S32 getPending() { return (S32)mPending; }	// queued, not yet running
+
+	// Maps an LLQueuedThread priority onto a lane.
+	static ELane laneForPriority(U32 priority);
+
+	// Logs the throughput and queueing latency of a batch of small mixed-lane
+	// tasks on a scheduler with num_threads threads.
+	static void benchmark(S32 num_threads);
+
+private:
+	class Worker;
+	friend class Worker;
+
+	// Tasks by lane for one worker (or the main thread, without workers)
+	struct Queue
+	{
+		Queue();
+		~Queue();
+
+		LLMutex* mMutex;
+		std::deque<Task*> mLanes[LANE_COUNT];
+	};
+
+	// No copy constructor or copy assignment
+	LLTaskScheduler(const LLTaskScheduler&);
+	LLTaskScheduler& operator=(const LLTaskScheduler&);
+
+	void runWorker(S32 index);
+	S32 getCurrentQueue();
+	Task* takeTask(S32 index);
+	void runTask(Task* task);
+	void finishTask(Task* task, bool cancelled);
+	void deliverCompleted();
+
+private:
+	std::string mName;
+	std::vector<Worker*> mThreads;
+	std::vector<Queue*> mQueues;		// one per worker, at least one
+
+	// Guards mStarted, and mQuitting's changes; workers sleep on it.
+	LLCondition* mCondition;
+	S32 mStarted;
+	LLAtomicU32 mQuitting;		// also read between tasks without the lock
+
+	// Tasks waiting for completed() on the main thread
+	LLMutex* mCompletedMutex;
+	std::vector<std::pair<Task*, bool> > mCompleted;
+
+	LLAtomicU32 mPending;
+	LLAtomicU32 mOutstanding;		// queued, running or awaiting completed()
+	LLAtomicU32 mNextHandle;
+	LLAtomicU32 mNextQueue;
+};
+
+#endif // LL_LLTASKSCHEDULER_H
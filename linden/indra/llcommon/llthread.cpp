@@ -30,12 +30,27 @@
 
 #include "llthread.h"
 
+#include <algorithm>
+
+#include "llfasttimer.h"
+#include "llmempool.h"
+#include "llpointer.h"
 #include "lltimer.h"
+#include "llworkpool.h"
 
 #if LL_LINUX || LL_SOLARIS
 #include <sched.h>
 #endif
 
+// Tells the core we are spinning (and a hyperthreaded sibling can have it)
+#if LL_WINDOWS
+#define LL_CPU_RELAX() YieldProcessor()	// windows.h, via apr
+#elif LL_GNUC && (defined(__i386__) || defined(__amd64__) || defined(__x86_64__))
+#define LL_CPU_RELAX() __asm__ __volatile__ ("pause")
+#else
+#define LL_CPU_RELAX()
+#endif
+
 //----------------------------------------------------------------------------
 // Usage:
 // void run_func(LLThread* thread)
@@ -66,10 +81,18 @@ void *APR_THREAD_FUNC LLThread::staticRun(apr_thread_t *apr_threadp, void *datap
 	// Set thread state to running
 	threadp->mStatus = RUNNING;
 
+	// Fast timers on this thread get a stack of their own
+	LLFastTimer::registerThread(threadp->mName);
+
 	// Run the user supplied function
 	threadp->run();
 
+	LLFastTimer::unregisterThread();
+
 	llinfos << "LLThread::staticRun() Exiting: " << threadp->mName << llendl;
+
+	// Hand the blocks this thread cached back for the other threads to use
+	LLMemPool::releaseThreadCache();
 	
 	// We're done with the run function, this thread is done executing now.
 	threadp->mStatus = STOPPED;
@@ -95,7 +118,7 @@ LLThread::LLThread(const std::string& name, apr_pool_t *poolp) :
 		mIsLocalPool = TRUE;
 		apr_pool_create(&mAPRPoolp, NULL); // Create a subpool for this thread
 	}
-	mRunCondition = new LLCondition(mAPRPoolp);
+	mRunCondition = new LLCondition(mAPRPoolp, mName.c_str());
 
 	mLocalAPRFilePoolp = NULL ;
 }
@@ -266,9 +289,94 @@ void LLThread::wakeLocked()
 
 //============================================================================
 
-LLMutex::LLMutex(apr_pool_t *poolp) :
-	mAPRMutexp(NULL)
+// Spinning on a mutex held by a thread that can't run until we give up the
+// core only burns time, so this is zero on single core machines.
+static S32 get_max_mutex_spin()
+{
+	static const S32 MAX_MUTEX_SPIN = 200;
+	static S32 max_spin = LLWorkPool::getDefaultThreadCount() > 0 ? MAX_MUTEX_SPIN : 0;
+	return max_spin;
+}
+
+// Contention counters for all the mutexes sharing one name
+class LLMutexStats
+{
+public:
+	LLMutexStats(const std::string& name)
+		: mName(name), mAcquisitions(0), mContentions(0), mWaitMicroseconds(0) {}
+
+	static LLMutexStats* get(const char* name);
+	static void getAll(std::vector<LLMutexStats*>& stats);
+
+	std::string mName;
+	LLAtomicU32 mAcquisitions;
+	LLAtomicU32 mContentions;
+	LLAtomicU32 mWaitMicroseconds;	// wraps after 71 minutes of waiting
+
+private:
+	typedef std::map<std::string, LLMutexStats*> stats_map_t;
+
+	// Never freed, like LLFastTimer's timer declarations, so mutexes can
+	// keep pointers into it whenever they are destroyed.
+	static stats_map_t& getMap(LLMutex*& mutex)
+	{
+		static LLMutex* sMutex = new LLMutex(NULL);
+		static stats_map_t* sMap = new stats_map_t;
+		mutex = sMutex;
+		return *sMap;
+	}
+};
+
+//static
+LLMutexStats* LLMutexStats::get(const char* name)
+{
+	LLMutex* mutex;
+	stats_map_t& stats = getMap(mutex);
+	LLMutexLock lock(mutex);
+	stats_map_t::iterator iter = stats.find(name);
+	if (iter == stats.end())
+	{
+		iter = stats.insert(std::make_pair(std::string(name), new LLMutexStats(name))).first;
+	}
+	return iter->second;
+}
+
+//static
+void LLMutexStats::getAll(std::vector<LLMutexStats*>& all)
 {
+	LLMutex* mutex;
+	stats_map_t& stats = getMap(mutex);
+	LLMutexLock lock(mutex);
+	for (stats_map_t::iterator iter = stats.begin(); iter != stats.end(); ++iter)
+	{
+		all.push_back(iter->second);
+	}
+}
+
+struct mutex_contention_wait_greater
+{
+	bool operator()(const LLMutex::Contention& lhs, const LLMutex::Contention& rhs) const
+	{
+		return lhs.mWaitMicroseconds > rhs.mWaitMicroseconds;
+	}
+};
+
+//============================================================================
+
+//static
+bool LLMutex::sProfiling = false;
+
+LLMutex::LLMutex(apr_pool_t *poolp, const char* name) :
+#if LL_WINDOWS
+	mAPRMutexp(NULL),
+#endif
+	mSpinEstimate(0),
+	mStats(NULL)
+#if MUTEX_DEBUG
+	, mLockingThread(0)
+#endif
+{
+#if LL_WINDOWS
 	//if (poolp)
 	//{
 	//	mIsLocalPool = FALSE;
@@ -280,6 +388,13 @@ LLMutex::LLMutex(apr_pool_t *poolp) :
 		apr_pool_create(&mAPRPoolp, NULL); // Create a subpool for this thread
 	}
 	apr_thread_mutex_create(&mAPRMutexp, APR_THREAD_MUTEX_UNNESTED, mAPRPoolp);
+#else
+	pthread_mutex_init(&mMutex, NULL);
+#endif
+	if (name)
+	{
+		mStats = LLMutexStats::get(name);
+	}
 }
 
 
@@ -288,122 +403,390 @@ LLMutex::~LLMutex()
 #if MUTEX_DEBUG
 	llassert_always(!isLocked()); // better not be locked!
 #endif
+#if LL_WINDOWS
 	apr_thread_mutex_destroy(mAPRMutexp);
 	mAPRMutexp = NULL;
 	if (mIsLocalPool)
 	{
 		apr_pool_destroy(mAPRPoolp);
 	}
+#else
+	pthread_mutex_destroy(&mMutex);
+#endif
 }
 
 
 void LLMutex::lock()
 {
-	apr_thread_mutex_lock(mAPRMutexp);
 #if MUTEX_DEBUG
-	// Have to have the lock before we can access the debug info
+	// Only this thread could have set it to its own id
 	U32 id = LLThread::currentID();
-	if (mIsLocked[id] != FALSE)
+	if (mLockingThread == id)
 		llerrs << "Already locked in Thread: " << id << llendl;
-	mIsLocked[id] = TRUE;
 #endif
+	if (!trylockNative())
+	{
+		lockContended();
+	}
+	else if (sProfiling && mStats)
+	{
+		mStats->mAcquisitions++;
+	}
+#if MUTEX_DEBUG
+	mLockingThread = id;
+#endif
+}
+
+bool LLMutex::trylock()
+{
+	if (!trylockNative())
+	{
+		return false;
+	}
+	if (sProfiling && mStats)
+	{
+		mStats->mAcquisitions++;
+	}
+#if MUTEX_DEBUG
+	mLockingThread = LLThread::currentID();
+#endif
+	return true;
 }
 
 void LLMutex::unlock()
 {
 #if MUTEX_DEBUG
-	// Access the debug info while we have the lock
 	U32 id = LLThread::currentID();
-	if (mIsLocked[id] != TRUE)
+	if (mLockingThread != id)
 		llerrs << "Not locked in Thread: " << id << llendl;	
-	mIsLocked[id] = FALSE;
+	mLockingThread = 0;
 #endif
-	apr_thread_mutex_unlock(mAPRMutexp);
+	unlockNative();
 }
 
 bool LLMutex::isLocked()
 {
-	apr_status_t status = apr_thread_mutex_trylock(mAPRMutexp);
-	if (APR_STATUS_IS_EBUSY(status))
+	if (!trylockNative())
 	{
 		return true;
 	}
 	else
 	{
-		apr_thread_mutex_unlock(mAPRMutexp);
+		unlockNative();
 		return false;
 	}
 }
 
+void LLMutex::lockContended()
+{
+	U64 start = (sProfiling && mStats) ? totalTime() : 0;
+
+	// Give the owner a little longer than it recently took to let go
+	// before going to sleep in the kernel.
+	S32 limit = llmin(mSpinEstimate * 2 + 10, get_max_mutex_spin());
+	S32 spins = 0;
+	bool locked = false;
+	while (spins < limit)
+	{
+		++spins;
+		LL_CPU_RELAX();
+		if (trylockNative())
+		{
+			locked = true;
+			break;
+		}
+	}
+	if (!locked)
+	{
+		lockNative();
+	}
+
+	// Move an eighth of the way towards this time's spin, like glibc's
+	// adaptive mutexes.  We hold the lock, so nobody else is writing it.
+	mSpinEstimate += (spins - mSpinEstimate) / 8;
+
+	if (start)
+	{
+		mStats->mAcquisitions++;
+		mStats->mContentions++;
+		mStats->mWaitMicroseconds += (U32)(totalTime() - start);
+	}
+}
+
+#if LL_WINDOWS
+bool LLMutex::trylockNative()
+{
+	return APR_SUCCESS == apr_thread_mutex_trylock(mAPRMutexp);
+}
+
+void LLMutex::lockNative()
+{
+	apr_thread_mutex_lock(mAPRMutexp);
+}
+
+void LLMutex::unlockNative()
+{
+	apr_thread_mutex_unlock(mAPRMutexp);
+}
+#else
+bool LLMutex::trylockNative()
+{
+	return 0 == pthread_mutex_trylock(&mMutex);
+}
+
+void LLMutex::lockNative()
+{
+	pthread_mutex_lock(&mMutex);
+}
+
+void LLMutex::unlockNative()
+{
+	pthread_mutex_unlock(&mMutex);
+}
+#endif
+
+//static
+void LLMutex::getContention(std::vector<Contention>& records, bool reset)
+{
+	std::vector<LLMutexStats*> stats;
+	LLMutexStats::getAll(stats);
+
+	// Other threads keep counting while we look, so take each counter
+	// once, and sort the copies.
+	size_t first = records.size();
+	for (std::vector<LLMutexStats*>::iterator iter = stats.begin(); iter != stats.end(); ++iter)
+	{
+		LLMutexStats* record = *iter;
+		Contention contention;
+		if (reset)
+		{
+			contention.mAcquisitions = record->mAcquisitions.exchange(0);
+			contention.mContentions = record->mContentions.exchange(0);
+			contention.mWaitMicroseconds = record->mWaitMicroseconds.exchange(0);
+		}
+		else
+		{
+			contention.mAcquisitions = record->mAcquisitions;
+			contention.mContentions = record->mContentions;
+			contention.mWaitMicroseconds = record->mWaitMicroseconds;
+		}
+		if (contention.mAcquisitions == 0)
+		{
+			continue;
+		}
+		contention.mName = record->mName;
+		records.push_back(contention);
+	}
+	std::sort(records.begin() + first, records.end(), mutex_contention_wait_greater());
+}
+
+//static
+void LLMutex::logContention(bool reset)
+{
+	std::vector<Contention> records;
+	getContention(records, reset);
+
+	llinfos << "Mutex contention" << (sProfiling ? "" : " (profiling is off)") << ":" << llendl;
+	for (std::vector<Contention>::iterator iter = records.begin(); iter != records.end(); ++iter)
+	{
+		llinfos << llformat("  %-40s %10u locks %8u contended (%5.1f%%) %10.2f ms waiting",
+							iter->mName.c_str(), iter->mAcquisitions, iter->mContentions,
+							100.f * iter->mContentions / iter->mAcquisitions, iter->mWaitMicroseconds * 0.001f) << llendl;
+	}
+}
+
 //============================================================================
 
-LLCondition::LLCondition(apr_pool_t *poolp) :
-	LLMutex(poolp)
+LLCondition::LLCondition(apr_pool_t *poolp, const char* name) :
+	LLMutex(poolp, name)
 {
+#if LL_WINDOWS
 	// base class (LLMutex) has already ensured that mAPRPoolp is set up.
 
 	apr_thread_cond_create(&mAPRCondp, mAPRPoolp);
+#else
+	pthread_cond_init(&mCond, NULL);
+#endif
 }
 
 
 LLCondition::~LLCondition()
 {
+#if LL_WINDOWS
 	apr_thread_cond_destroy(mAPRCondp);
 	mAPRCondp = NULL;
+#else
+	pthread_cond_destroy(&mCond);
+#endif
 }
 
 
 void LLCondition::wait()
 {
+#if MUTEX_DEBUG
+	// Other threads will hold the mutex while we wait
+	mLockingThread = 0;
+#endif
+#if LL_WINDOWS
 	apr_thread_cond_wait(mAPRCondp, mAPRMutexp);
+#else
+	pthread_cond_wait(&mCond, &mMutex);
+#endif
+#if MUTEX_DEBUG
+	mLockingThread = LLThread::currentID();
+#endif
 }
 
 void LLCondition::signal()
 {
+#if LL_WINDOWS
 	apr_thread_cond_signal(mAPRCondp);
+#else
+	pthread_cond_signal(&mCond);
+#endif
 }
 
 void LLCondition::broadcast()
 {
+#if LL_WINDOWS
 	apr_thread_cond_broadcast(mAPRCondp);
+#else
+	pthread_cond_broadcast(&mCond);
+#endif
 }
 
 //============================================================================
 
 //----------------------------------------------------------------------------
 
-//static
-LLMutex* LLThreadSafeRefCount::sMutex = 0;
-
-//static
-void LLThreadSafeRefCount::initThreadSafeRefCount()
+LLThreadSafeRefCount::LLThreadSafeRefCount() :
+	mRef(0)
 {
-	if (!sMutex)
+}
+
+LLThreadSafeRefCount::~LLThreadSafeRefCount()
+{ 
+	if (mRef != 0)
 	{
-		sMutex = new LLMutex(0);
+		llerrs << "deleting non-zero reference" << llendl;
 	}
 }
 
-//static
-void LLThreadSafeRefCount::cleanupThreadSafeRefCount()
+namespace
 {
-	delete sMutex;
-	sMutex = NULL;
-}
-	
+	class SharedObject : public LLThreadSafeRefCount
+	{
+	};
 
-//----------------------------------------------------------------------------
+	// What LLThreadSafeRefCount used to do: one process-wide mutex around
+	// every change to any count.
+	class LockedRefCount
+	{
+	public:
+		LockedRefCount(LLMutex* mutex) : mMutex(mutex), mRef(0) {}
 
-LLThreadSafeRefCount::LLThreadSafeRefCount() :
-	mRef(0)
-{
+		void ref()
+		{
+			mMutex->lock();
+			mRef++;
+			mMutex->unlock();
+		}
+		void unref()
+		{
+			mMutex->lock();
+			--mRef;
+			mMutex->unlock();
+		}
+
+	private:
+		LLMutex* mMutex;
+		S32 mRef;
+	};
+
+	// Copies and drops an LLPointer to the shared object count times.
+	template <class T>
+	class CopyThread : public LLThread
+	{
+	public:
+		CopyThread(T* target, S32 count, LLAtomicS32& go, LLAtomicS32& finished)
+			: LLThread("Ref count benchmark"),
+			  mTarget(target),
+			  mCount(count),
+			  mGo(go),
+			  mFinished(finished)
+		{
+		}
+
+	protected:
+		/*virtual*/ void run()
+		{
+			while (mGo == 0)
+			{
+				yield();
+			}
+			for (S32 i = 0; i < mCount; ++i)
+			{
+				LLPointer<T> copy(mTarget);
+			}
+			mFinished++;
+		}
+
+	private:
+		T* mTarget;
+		S32 mCount;
+		LLAtomicS32& mGo;
+		LLAtomicS32& mFinished;
+	};
+
+	// Returns nanoseconds per copy with num_threads threads copying at once.
+	template <class T>
+	F64 time_copies(T* target, S32 num_threads, S32 count)
+	{
+		LLAtomicS32 go(0);
+		LLAtomicS32 finished(0);
+		std::vector<LLThread*> threads;
+		for (S32 i = 0; i < num_threads; ++i)
+		{
+			threads.push_back(new CopyThread<T>(target, count, go, finished));
+			threads.back()->start();
+		}
+
+		LLTimer timer;
+		go = 1;
+		while (finished < num_threads)
+		{
+			ms_sleep(1);
+		}
+		F64 elapsed = timer.getElapsedTimeF64();
+
+		for (S32 i = 0; i < num_threads; ++i)
+		{
+			while (!threads[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+			delete threads[i];
+		}
+		return elapsed * 1000000000.0 / ((F64)num_threads * count);
+	}
 }
 
-LLThreadSafeRefCount::~LLThreadSafeRefCount()
-{ 
-	if (mRef != 0)
+//static
+void LLThreadSafeRefCount::benchmark(S32 max_threads)
+{
+	const S32 COPIES = 1000000;
+
+	LLPointer<SharedObject> atomic_target = new SharedObject;
+	LLMutex mutex(NULL);
+	LockedRefCount locked_target(&mutex);
+	locked_target.ref();	// never let the copies drop it to zero
+
+	for (S32 num_threads = 1; num_threads <= max_threads; num_threads *= 2)
 	{
-		llerrs << "deleting non-zero reference" << llendl;
+		F64 atomic_ns = time_copies(atomic_target.get(), num_threads, COPIES);
+		F64 locked_ns = time_copies(&locked_target, num_threads, COPIES);
+		llinfos << "Ref count benchmark: " << num_threads << " threads, atomic "
+				<< atomic_ns << " ns per copy, global mutex " << locked_ns << " ns per copy" << llendl;
 	}
 }
 
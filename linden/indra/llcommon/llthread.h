@@ -31,9 +31,14 @@
 #include "llapr.h"
 #include "apr_thread_cond.h"
 
+#if !LL_WINDOWS
+#include <pthread.h>
+#endif
+
 class LLThread;
 class LLMutex;
 class LLCondition;
+class LLMutexStats;
 
 class LL_COMMON_API LLThread
 {
@@ -125,30 +130,73 @@ protected:
 
 #define MUTEX_DEBUG (LL_DEBUG || LL_RELEASE_WITH_DEBUG_INFO)
 
+// A pthread mutex (an APR one on Windows).  lock() spins briefly before
+// blocking when the mutex is held, for about as long as it recently took
+// to come free, since most of ours only guard a few instructions.
+//
+// Mutexes given a name can be profiled: with setProfiling(true), every
+// lock() of a named mutex is counted, and contended ones record how long
+// they waited.  Mutexes sharing a name (one per worker, say) share a
+// record.  logContention() writes the records out, worst first.
 class LL_COMMON_API LLMutex
 {
 public:
-	LLMutex(apr_pool_t *apr_poolp); // NULL pool constructs a new pool for the mutex
+	// The pool is only used on Windows, where NULL constructs a new pool
+	// for the mutex.
+	LLMutex(apr_pool_t *apr_poolp, const char* name = NULL);
 	virtual ~LLMutex();
 	
 	void lock();		// blocks
+	bool trylock();		// non-blocking, returns true if it took the lock
 	void unlock();
 	bool isLocked(); 	// non-blocking, but does do a lock/unlock so not free
+
+	// Contention profiling.  Off by default; the counters cost an atomic
+	// add per lock() while on.
+	static void setProfiling(bool enable) { sProfiling = enable; }
+	static bool getProfiling() { return sProfiling; }
+	static void logContention(bool reset = true);
+
+	struct Contention
+	{
+		std::string mName;
+		U32 mAcquisitions;
+		U32 mContentions;
+		U32 mWaitMicroseconds;
+	};
+	// Appends the records of every name locked since the last reset, worst
+	// first.  Resetting loses no counts, but a lock() finishing meanwhile
+	// may land partly in this result and partly in the next.
+	static void getContention(std::vector<Contention>& records, bool reset = true);
 	
 protected:
+	bool trylockNative();
+	void lockNative();
+	void unlockNative();
+	void lockContended();
+
+protected:
+#if LL_WINDOWS
 	apr_thread_mutex_t *mAPRMutexp;
 	apr_pool_t			*mAPRPoolp;
 	BOOL				mIsLocalPool;
+#else
+	pthread_mutex_t		mMutex;
+#endif
+	S32					mSpinEstimate;	// only touched with the lock held
+	LLMutexStats*		mStats;			// NULL if unnamed
 #if MUTEX_DEBUG
-	std::map<U32, BOOL> mIsLocked;
+	U32					mLockingThread;	// 0 when unlocked
 #endif
+
+	static bool sProfiling;
 };
 
 // Actually a condition/mutex pair (since each condition needs to be associated with a mutex).
 class LL_COMMON_API LLCondition : public LLMutex
 {
 public:
-	LLCondition(apr_pool_t *apr_poolp); // Defaults to global pool, could use the thread pool as well.
+	LLCondition(apr_pool_t *apr_poolp, const char* name = NULL); // Defaults to global pool, could use the thread pool as well.
 	~LLCondition();
 	
 	void wait();		// blocks
@@ -156,7 +204,11 @@ public:
 	void broadcast();
 	
 protected:
+#if LL_WINDOWS
 	apr_thread_cond_t *mAPRCondp;
+#else
+	pthread_cond_t mCond;
+#endif
 };
 
 class LLMutexLock
@@ -192,14 +244,17 @@ void LLThread::unlockData()
 
 // see llmemory.h for LLPointer<> definition
 
+// The count is an apr atomic.  apr_atomic_inc32() and apr_atomic_dec32() are
+// full barriers on every platform we build for, so every write made through
+// one reference is visible to whichever thread drops the last one and
+// deletes the object.
+
 class LL_COMMON_API LLThreadSafeRefCount
 {
 public:
-	static void initThreadSafeRefCount(); // creates sMutex
-	static void cleanupThreadSafeRefCount(); // destroys sMutex
-	
-private:
-	static LLMutex* sMutex;
+	// Logs the cost of copying one shared LLPointer from 1 to max_threads
+	// threads at once, next to a count guarded by a mutex.
+	static void benchmark(S32 max_threads);
 
 private:
 	LLThreadSafeRefCount(const LLThreadSafeRefCount&); // not implemented
@@ -213,23 +268,21 @@ public:
 	
 	void ref()
 	{
-		if (sMutex) sMutex->lock();
 		mRef++; 
-		if (sMutex) sMutex->unlock();
 	} 
 
 	S32 unref()
 	{
-		llassert(mRef >= 1);
-		if (sMutex) sMutex->lock();
-		S32 res = --mRef;
-		if (sMutex) sMutex->unlock();
-		if (0 == res) 
+		llassert(getNumRefs() >= 1);
+		// apr_atomic_dec32() returns zero only to the thread that took the
+		// count to zero.
+		if (0 == mRef--) 
 		{
 			delete this; 
 			return 0;
 		}
-		return res;
+		// Other threads may have moved it since; only a hint.
+		return getNumRefs();
 	}	
 	S32 getNumRefs() const
 	{
@@ -237,7 +290,7 @@ public:
 	}
 
 private: 
-	S32	mRef; 
+	mutable LLAtomicS32 mRef;	// mutable: LLAtomic32's read isn't const
 };
 
 //============================================================================
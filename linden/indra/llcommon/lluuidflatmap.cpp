@@ -0,0 +1,104 @@
+/**
+ * @file lluuidflatmap.cpp
+ * @brief Benchmark for the LLUUID hash map
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lluuidflatmap.h"
+
+#include <map>
+#include <vector>
+
+#include "lltimer.h"
+
+namespace
+{
+	// Inserts, finds (all of them, then as many missing), and erases the
+	// IDs.  Returns nanoseconds per operation in each.
+	template <typename Map>
+	void time_map(const std::vector<LLUUID>& ids, const std::vector<LLUUID>& missing,
+				  F64& insert_ns, F64& hit_ns, F64& miss_ns, F64& erase_ns)
+	{
+		const F64 NS_PER_OP = 1000000000.0 / (F64)ids.size();
+		Map map;
+		U32 found = 0;
+
+		LLTimer timer;
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			map[ids[i]] = i;
+		}
+		insert_ns = timer.getElapsedTimeF64() * NS_PER_OP;
+
+		timer.reset();
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			found += map.find(ids[i])->second == i;
+		}
+		hit_ns = timer.getElapsedTimeF64() * NS_PER_OP;
+
+		timer.reset();
+		for (U32 i = 0; i < missing.size(); ++i)
+		{
+			found += map.find(missing[i]) != map.end();
+		}
+		miss_ns = timer.getElapsedTimeF64() * NS_PER_OP;
+
+		timer.reset();
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			found -= (U32)map.erase(ids[i]);
+		}
+		erase_ns = timer.getElapsedTimeF64() * NS_PER_OP;
+
+		if (found != 0 || !map.empty())
+		{
+			llwarns << "UUID map benchmark lost track of " << found << " IDs" << llendl;
+		}
+	}
+}
+
+//static
+void LLUUIDFlatTableBase::benchmark(S32 count)
+{
+	std::vector<LLUUID> ids(count);
+	std::vector<LLUUID> missing(count);
+	for (S32 i = 0; i < count; ++i)
+	{
+		ids[i].generate();
+		missing[i].generate();
+	}
+
+	F64 flat[4];
+	F64 tree[4];
+	time_map<LLUUIDFlatMap<U32> >(ids, missing, flat[0], flat[1], flat[2], flat[3]);
+	time_map<std::map<LLUUID, U32> >(ids, missing, tree[0], tree[1], tree[2], tree[3]);
+
+	llinfos << "UUID map benchmark: " << count << " IDs, ns per op flat/std::map:"
+			<< " insert " << flat[0] << "/" << tree[0]
+			<< " hit " << flat[1] << "/" << tree[1]
+			<< " miss " << flat[2] << "/" << tree[2]
+			<< " erase " << flat[3] << "/" << tree[3] << llendl;
+}
@@ -0,0 +1,556 @@
+/**
+ * @file lluuidflatmap.h
+ * @brief Open addressing hash map and set keyed by LLUUID
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLUUIDFLATMAP_H
+#define LL_LLUUIDFLATMAP_H
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <utility>
+
+#include "lldefs.h"
+#include "lluuid.h"
+
+#if LL_GNUC && defined(__SSE2__)
+#define LL_UUID_TABLE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// LLUUIDFlatMap<T> and LLUUIDFlatSet are drop-in replacements for
+// std::map<LLUUID, T> and std::set<LLUUID> where only lookups matter, not
+// order.  Entries live in one flat array, with a byte per slot alongside
+// saying whether it's empty, erased, or holds a key with a given 7 bits of
+// hash.  A lookup compares a group of 16 of those bytes at once (with SSE2
+// where we have it) and only touches the keys whose bits matched, so a hit
+// is usually one cache miss for the group and one for the entry.
+//
+// Iteration runs in slot order.  Entries don't move when others are erased,
+// only when the table grows, so the usual map.erase(iter++) loops work and
+// a dump of the same table comes out in the same order every time.  For
+// round-robin walks that outlive inserts, slotOf() and fromSlot() give a
+// position that survives growth (it just resumes somewhere else).
+
+class LL_COMMON_API LLUUIDFlatTableBase
+{
+public:
+	// Logs insert, lookup and erase times for count random IDs, against
+	// std::map.
+	static void benchmark(S32 count);
+
+protected:
+	enum { GROUP_SIZE = 16 };
+	enum
+	{
+		CTRL_EMPTY = -128,
+		CTRL_DELETED = -2
+		// 0 to 127 holds a key, with those bits of its hash
+	};
+
+	static U64 hashOf(const LLUUID& id)
+	{
+		// Generated IDs are random already, so folding the halves together
+		// would do for them.  The multiply and shifts spread the made-up
+		// ones (sequential, or mostly zero) across the table as well.
+		U64 lo, hi;
+		memcpy(&lo, id.mData, sizeof(lo));
+		memcpy(&hi, id.mData + sizeof(lo), sizeof(hi));
+		U64 hash = lo ^ hi;
+		hash ^= hash >> 33;
+		hash *= 0xff51afd7ed558ccdULL;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	// Bit i set for each control byte i in the group equal to ctrl
+	static U32 matchGroup(const S8* group, S8 ctrl)
+	{
+#if LL_UUID_TABLE_SSE2
+		__m128i bytes = _mm_loadu_si128((const __m128i*)group);
+		return (U32)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(ctrl)));
+#else
+		U32 mask = 0;
+		for (U32 i = 0; i < GROUP_SIZE; ++i)
+		{
+			if (group[i] == ctrl)
+			{
+				mask |= 1 << i;
+			}
+		}
+		return mask;
+#endif
+	}
+
+	// Bit i set for each slot in the group that's empty or erased
+	static U32 matchFree(const S8* group)
+	{
+#if LL_UUID_TABLE_SSE2
+		return (U32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+		U32 mask = 0;
+		for (U32 i = 0; i < GROUP_SIZE; ++i)
+		{
+			if (group[i] < 0)
+			{
+				mask |= 1 << i;
+			}
+		}
+		return mask;
+#endif
+	}
+
+	static U32 lowestBit(U32 mask)
+	{
+#if LL_GNUC
+		return (U32)__builtin_ctz(mask);
+#else
+		U32 bit = 0;
+		while (!(mask & 1))
+		{
+			mask >>= 1;
+			++bit;
+		}
+		return bit;
+#endif
+	}
+};
+
+template <typename Value, typename KeyOf>
+class LLUUIDFlatTable : public LLUUIDFlatTableBase
+{
+public:
+	typedef Value value_type;
+	typedef size_t size_type;
+
+	template <typename V>
+	class Iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef V value_type;
+		typedef ptrdiff_t difference_type;
+		typedef V* pointer;
+		typedef V& reference;
+
+		Iterator() : mCtrl(NULL), mCtrlEnd(NULL), mSlot(NULL) {}
+
+		// iterator to const_iterator
+		template <typename U>
+		Iterator(const Iterator<U>& other) : mCtrl(other.mCtrl), mCtrlEnd(other.mCtrlEnd), mSlot(other.mSlot) {}
+
+		V& operator*() const { return *mSlot; }
+		V* operator->() const { return mSlot; }
+
+		Iterator& operator++()
+		{
+			++mCtrl;
+			++mSlot;
+			skipFree();
+			return *this;
+		}
+
+		Iterator operator++(int)
+		{
+			Iterator prev(*this);
+			++*this;
+			return prev;
+		}
+
+		bool operator==(const Iterator& rhs) const { return mCtrl == rhs.mCtrl; }
+		bool operator!=(const Iterator& rhs) const { return mCtrl != rhs.mCtrl; }
+
+	private:
+		Iterator(const S8* ctrl, const S8* ctrl_end, V* slot)
+			: mCtrl(ctrl), mCtrlEnd(ctrl_end), mSlot(slot)
+		{
+			skipFree();
+		}
+
+		void skipFree()
+		{
+			while (mCtrl != mCtrlEnd && *mCtrl < 0)
+			{
+				++mCtrl;
+				++mSlot;
+			}
+		}
+
+		const S8* mCtrl;
+		const S8* mCtrlEnd;
+		V* mSlot;
+
+		template <typename> friend class Iterator;
+		friend class LLUUIDFlatTable;
+	};
+
+	typedef Iterator<Value> iterator;
+	typedef Iterator<const Value> const_iterator;
+
+	LLUUIDFlatTable()
+		: mSlots(NULL), mCtrl(NULL), mCapacity(0), mSize(0), mGrowthLeft(0)
+	{
+	}
+
+	LLUUIDFlatTable(const LLUUIDFlatTable& other)
+		: mSlots(NULL), mCtrl(NULL), mCapacity(0), mSize(0), mGrowthLeft(0)
+	{
+		reserve(other.mSize);
+		for (const_iterator it = other.begin(); it != other.end(); ++it)
+		{
+			insertUnique(*it);
+		}
+	}
+
+	~LLUUIDFlatTable()
+	{
+		destroyAll();
+		deallocate(mCtrl, mSlots);
+	}
+
+	LLUUIDFlatTable& operator=(const LLUUIDFlatTable& other)
+	{
+		if (this != &other)
+		{
+			LLUUIDFlatTable copy(other);
+			swap(copy);
+		}
+		return *this;
+	}
+
+	void swap(LLUUIDFlatTable& other)
+	{
+		std::swap(mCtrl, other.mCtrl);
+		std::swap(mSlots, other.mSlots);
+		std::swap(mCapacity, other.mCapacity);
+		std::swap(mSize, other.mSize);
+		std::swap(mGrowthLeft, other.mGrowthLeft);
+	}
+
+	iterator begin()				{ return iterator(mCtrl, mCtrl + mCapacity, mSlots); }
+	iterator end()					{ return iterator(mCtrl + mCapacity, mCtrl + mCapacity, mSlots + mCapacity); }
+	const_iterator begin() const	{ return const_cast<LLUUIDFlatTable*>(this)->begin(); }
+	const_iterator end() const		{ return const_cast<LLUUIDFlatTable*>(this)->end(); }
+
+	size_type size() const			{ return mSize; }
+	bool empty() const				{ return mSize == 0; }
+
+	iterator find(const LLUUID& key)
+	{
+		if (!mCapacity)
+		{
+			return end();
+		}
+
+		U64 hash = hashOf(key);
+		S8 ctrl = (S8)(hash & 0x7f);
+		size_t mask = mCapacity / GROUP_SIZE - 1;
+		size_t group = (size_t)(hash >> 7) & mask;
+		for (size_t probe = 1; ; ++probe)
+		{
+			const S8* group_ctrl = mCtrl + group * GROUP_SIZE;
+			for (U32 match = matchGroup(group_ctrl, ctrl); match; match &= match - 1)
+			{
+				size_t slot = group * GROUP_SIZE + lowestBit(match);
+				if (KeyOf::get(mSlots[slot]) == key)
+				{
+					return slotIterator(slot);
+				}
+			}
+			if (matchGroup(group_ctrl, CTRL_EMPTY))
+			{
+				// an insert would have stopped here
+				return end();
+			}
+			// triangular steps visit every group of a power of two
+			group = (group + probe) & mask;
+		}
+	}
+
+	const_iterator find(const LLUUID& key) const
+	{
+		return const_cast<LLUUIDFlatTable*>(this)->find(key);
+	}
+
+	size_type count(const LLUUID& key) const
+	{
+		return find(key) != end() ? 1 : 0;
+	}
+
+	std::pair<iterator, bool> insert(const Value& value)
+	{
+		std::pair<size_t, bool> slot = findOrPrepareInsert(KeyOf::get(value));
+		if (!slot.second)
+		{
+			new ((void*)&mSlots[slot.first]) Value(value);
+		}
+		return std::make_pair(slotIterator(slot.first), !slot.second);
+	}
+
+	void erase(iterator it)
+	{
+		size_t slot = it.mSlot - mSlots;
+		mSlots[slot].~Value();
+		--mSize;
+
+		// If the group still has an empty slot, it has never been full, so
+		// no probe has gone past it and the slot can be empty again.
+		// Otherwise leave a marker so lookups carry on past.
+		const S8* group_ctrl = mCtrl + (slot & ~(size_t)(GROUP_SIZE - 1));
+		if (matchGroup(group_ctrl, CTRL_EMPTY))
+		{
+			mCtrl[slot] = CTRL_EMPTY;
+			++mGrowthLeft;
+		}
+		else
+		{
+			mCtrl[slot] = CTRL_DELETED;
+		}
+	}
+
+	size_type erase(const LLUUID& key)
+	{
+		iterator it = find(key);
+		if (it == end())
+		{
+			return 0;
+		}
+		erase(it);
+		return 1;
+	}
+
+	// Keeps the capacity
+	void clear()
+	{
+		destroyAll();
+		if (mCapacity)
+		{
+			memset(mCtrl, CTRL_EMPTY, mCapacity);
+		}
+		mSize = 0;
+		mGrowthLeft = maxLoad(mCapacity);
+	}
+
+	void reserve(size_type count)
+	{
+		size_t capacity = mCapacity ? mCapacity : GROUP_SIZE;
+		while (maxLoad(capacity) < count)
+		{
+			capacity *= 2;
+		}
+		if (capacity != mCapacity)
+		{
+			rehash(capacity);
+		}
+	}
+
+	// Positions for walks that go on across inserts, see above
+	size_t slotOf(const_iterator it) const		{ return it.mCtrl - mCtrl; }
+	iterator fromSlot(size_t slot)
+	{
+		slot = llmin(slot, mCapacity);
+		return iterator(mCtrl + slot, mCtrl + mCapacity, mSlots + slot);
+	}
+
+protected:
+	// Finds the key's slot, or claims one for it that the caller must
+	// construct a value in.  The bool is true if the key was there.
+	std::pair<size_t, bool> findOrPrepareInsert(const LLUUID& key)
+	{
+		iterator it = find(key);
+		if (it != end())
+		{
+			return std::make_pair((size_t)(it.mSlot - mSlots), true);
+		}
+
+		if (!mGrowthLeft)
+		{
+			// Erases leave markers that use up room; if they're what filled
+			// the table, clearing them out is enough.
+			size_t capacity = mCapacity ? mCapacity : GROUP_SIZE;
+			if (mSize >= maxLoad(capacity) / 2)
+			{
+				capacity *= 2;
+			}
+			rehash(capacity);
+		}
+
+		U64 hash = hashOf(key);
+		size_t slot = findFreeSlot(hash);
+		if (mCtrl[slot] == CTRL_EMPTY)
+		{
+			--mGrowthLeft;
+		}
+		mCtrl[slot] = (S8)(hash & 0x7f);
+		++mSize;
+		return std::make_pair(slot, false);
+	}
+
+	iterator slotIterator(size_t slot)
+	{
+		iterator it;
+		it.mCtrl = mCtrl + slot;
+		it.mCtrlEnd = mCtrl + mCapacity;
+		it.mSlot = mSlots + slot;
+		return it;
+	}
+
+	Value* mSlots;
+
+private:
+	// At most 7/8 full, so there is always an empty slot to stop lookups
+	static size_t maxLoad(size_t capacity)
+	{
+		return capacity - capacity / 8;
+	}
+
+	size_t findFreeSlot(U64 hash) const
+	{
+		size_t mask = mCapacity / GROUP_SIZE - 1;
+		size_t group = (size_t)(hash >> 7) & mask;
+		for (size_t probe = 1; ; ++probe)
+		{
+			U32 free = matchFree(mCtrl + group * GROUP_SIZE);
+			if (free)
+			{
+				return group * GROUP_SIZE + lowestBit(free);
+			}
+			group = (group + probe) & mask;
+		}
+	}
+
+	// Only for keys known not to be in the table
+	void insertUnique(const Value& value)
+	{
+		if (!mGrowthLeft)
+		{
+			rehash(mCapacity ? mCapacity * 2 : GROUP_SIZE);
+		}
+		U64 hash = hashOf(KeyOf::get(value));
+		size_t slot = findFreeSlot(hash);
+		if (mCtrl[slot] == CTRL_EMPTY)
+		{
+			--mGrowthLeft;
+		}
+		mCtrl[slot] = (S8)(hash & 0x7f);
+		new ((void*)&mSlots[slot]) Value(value);
+		++mSize;
+	}
+
+	void rehash(size_t capacity)
+	{
+		S8* old_ctrl = mCtrl;
+		Value* old_slots = mSlots;
+		size_t old_capacity = mCapacity;
+
+		mCtrl = new S8[capacity];
+		memset(mCtrl, CTRL_EMPTY, capacity);
+		mSlots = (Value*)::operator new(capacity * sizeof(Value));
+		mCapacity = capacity;
+		mSize = 0;
+		mGrowthLeft = maxLoad(capacity);
+
+		for (size_t i = 0; i < old_capacity; ++i)
+		{
+			if (old_ctrl[i] >= 0)
+			{
+				insertUnique(old_slots[i]);
+				old_slots[i].~Value();
+			}
+		}
+		deallocate(old_ctrl, old_slots);
+	}
+
+	void destroyAll()
+	{
+		for (size_t i = 0; i < mCapacity; ++i)
+		{
+			if (mCtrl[i] >= 0)
+			{
+				mSlots[i].~Value();
+			}
+		}
+	}
+
+	static void deallocate(S8* ctrl, Value* slots)
+	{
+		delete[] ctrl;
+		::operator delete((void*)slots);
+	}
+
+	S8* mCtrl;
+	size_t mCapacity;		// a power of two, at least a group
+	size_t mSize;
+	size_t mGrowthLeft;		// empty slots we may still fill before growing
+};
+
+struct LLUUIDFlatSetKey
+{
+	static const LLUUID& get(const LLUUID& key) { return key; }
+};
+
+template <typename T>
+struct LLUUIDFlatMapKey
+{
+	static const LLUUID& get(const std::pair<const LLUUID, T>& value) { return value.first; }
+};
+
+class LLUUIDFlatSet : public LLUUIDFlatTable<const LLUUID, LLUUIDFlatSetKey>
+{
+};
+
+template <typename T>
+class LLUUIDFlatMap : public LLUUIDFlatTable<std::pair<const LLUUID, T>, LLUUIDFlatMapKey<T> >
+{
+public:
+	typedef LLUUIDFlatTable<std::pair<const LLUUID, T>, LLUUIDFlatMapKey<T> > table_t;
+	typedef LLUUID key_type;
+	typedef T mapped_type;
+
+	T& operator[](const LLUUID& key)
+	{
+		std::pair<size_t, bool> slot = this->findOrPrepareInsert(key);
+		if (!slot.second)
+		{
+			new ((void*)&this->mSlots[slot.first]) typename table_t::value_type(key, T());
+		}
+		return this->mSlots[slot.first].second;
+	}
+};
+
+// As in llstl.h, for maps of pointers
+template <typename T>
+inline T* get_ptr_in_map(const LLUUIDFlatMap<T*>& inmap, const LLUUID& key)
+{
+	typename LLUUIDFlatMap<T*>::const_iterator iter = inmap.find(key);
+	if (iter == inmap.end())
+	{
+		return NULL;
+	}
+	return iter->second;
+}
+
+#endif // LL_LLUUIDFLATMAP_H
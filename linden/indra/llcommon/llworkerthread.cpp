@@ -34,10 +34,10 @@
 //============================================================================
 // Run on MAIN thread
 
-LLWorkerThread::LLWorkerThread(const std::string& name, bool threaded) :
-	LLQueuedThread(name, threaded)
+LLWorkerThread::LLWorkerThread(const std::string& name, bool threaded, LLTaskScheduler* scheduler) :
+	LLQueuedThread(name, threaded, scheduler)
 {
-	mDeleteMutex = new LLMutex(NULL);
+	mDeleteMutex = new LLMutex(NULL, "LLWorkerThread::mDeleteMutex");
 
 	if(!mLocalAPRFilePoolp)
 	{
@@ -204,7 +204,7 @@ LLWorkerClass::LLWorkerClass(LLWorkerThread* workerthread, const std::string& na
 	  mWorkerClassName(name),
 	  mRequestHandle(LLWorkerThread::nullHandle()),
 	  mRequestPriority(LLWorkerThread::PRIORITY_NORMAL),
-	  mMutex(NULL),
+	  mMutex(NULL, "LLWorkerClass::mMutex"),
 	  mWorkFlags(0)
 {
 	if (!mWorkerThread)
@@ -281,7 +281,12 @@ void LLWorkerClass::setWorking(bool working)
 bool LLWorkerClass::yield()
 {
 	LLThread::yield();
-	mWorkerThread->checkPause();
+	if (!mWorkerThread->isScheduled())
+	{
+		// Scheduled threads only pause between requests; blocking here
+		// would tie up a scheduler thread.
+		mWorkerThread->checkPause();
+	}
 	bool res;
 	mMutex.lock();
 	res = (getFlags() & WCF_ABORT_REQUESTED) ? true : false;
@@ -0,0 +1,260 @@
+/**
+ * @file llworkpool.cpp
+ * @brief Fork/join pool of worker threads for data-parallel loops.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llworkpool.h"
+#include "llstl.h"
+#include "lltimer.h"
+
+#if LL_WINDOWS
+#	define WIN32_LEAN_AND_MEAN
+#	include <winsock2.h>
+#	include <windows.h>
+#elif LL_DARWIN
+#	include <sys/types.h>
+#	include <sys/sysctl.h>
+#else
+#	include <unistd.h>
+#endif
+
+// Never spin up more than this many helpers, however wide the machine.
+static const S32 MAX_WORK_POOL_THREADS = 16;
+
+//============================================================================
+
+class LLWorkPool::Worker : public LLThread
+{
+public:
+	Worker(const std::string& name, LLWorkPool* pool)
+		: LLThread(name),
+		  mPool(pool)
+	{
+	}
+
+protected:
+	/*virtual*/ void run()
+	{
+		mPool->runWorker();
+	}
+
+private:
+	LLWorkPool* mPool;
+};
+
+//============================================================================
+
+LLWorkPool::Task::~Task()
+{
+}
+
+//============================================================================
+// MAIN THREAD
+
+LLWorkPool::LLWorkPool(const std::string& name, S32 num_threads)
+	: mName(name),
+	  mTask(NULL),
+	  mCount(0),
+	  mGeneration(0),
+	  mActive(0),
+	  mStarted(0),
+	  mQuitting(false),
+	  mNextIndex(0),
+	  mBusy(0)
+{
+	mCondition = new LLCondition(NULL, "LLWorkPool::mCondition");
+
+	if (num_threads < 0)
+	{
+		num_threads = getDefaultThreadCount();
+	}
+	num_threads = llmin(num_threads, MAX_WORK_POOL_THREADS);
+
+	for (S32 i = 0; i < num_threads; ++i)
+	{
+		Worker* worker = new Worker(llformat("%s %d", name.c_str(), i), this);
+		mThreads.push_back(worker);
+		worker->start();
+	}
+
+	// LLThread::shutdown() treats a thread that hasn't reached run() yet as
+	// stopped, so don't hand the pool out until every worker is inside it.
+	mCondition->lock();
+	while (mStarted < num_threads)
+	{
+		mCondition->wait();
+	}
+	mCondition->unlock();
+
+	llinfos << "Work pool '" << mName << "' started with " << num_threads << " threads" << llendl;
+}
+
+LLWorkPool::~LLWorkPool()
+{
+	mCondition->lock();
+	mQuitting = true;
+	mCondition->broadcast();
+	mCondition->unlock();
+
+	// Wait for each worker to leave run() rather than relying on the
+	// polling in ~LLThread().
+	for (std::vector<Worker*>::iterator iter = mThreads.begin();
+		 iter != mThreads.end(); ++iter)
+	{
+		while (!(*iter)->isStopped())
+		{
+			ms_sleep(1);
+		}
+	}
+	for_each(mThreads.begin(), mThreads.end(), DeletePointer());
+	mThreads.clear();
+
+	delete mCondition;
+	mCondition = NULL;
+}
+
+//static
+S32 LLWorkPool::getDefaultThreadCount()
+{
+	S32 cores = 1;
+#if LL_WINDOWS
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	cores = (S32)info.dwNumberOfProcessors;
+#elif LL_DARWIN
+	int ncpu = 1;
+	size_t len = sizeof(ncpu);
+	if (0 == sysctlbyname("hw.activecpu", &ncpu, &len, NULL, 0))
+	{
+		cores = ncpu;
+	}
+#else
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpu > 0)
+	{
+		cores = (S32)ncpu;
+	}
+#endif
+	return llclamp(cores - 1, 0, MAX_WORK_POOL_THREADS);
+}
+
+void LLWorkPool::parallelFor(Task& task, S32 count)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	// Fall back to a plain loop for tiny jobs, pools without threads, or
+	// when another loop already owns the pool (e.g. a nested call).
+	bool serial = mThreads.empty() || count == 1;
+	if (!serial && mBusy++ != 0)
+	{
+		mBusy--;
+		serial = true;
+	}
+	if (serial)
+	{
+		for (S32 i = 0; i < count; ++i)
+		{
+			task.run(i);
+		}
+		return;
+	}
+
+	mCondition->lock();
+	mNextIndex = 0;
+	mTask = &task;
+	mCount = count;
+	++mGeneration;
+	mCondition->broadcast();
+	mCondition->unlock();
+
+	runIndices(&task, count);
+
+	// Stop late risers from joining, then wait for the helpers that did.
+	mCondition->lock();
+	mTask = NULL;
+	while (mActive > 0)
+	{
+		mCondition->wait();
+	}
+	mCondition->unlock();
+
+	mBusy--;
+}
+
+//============================================================================
+// ANY THREAD
+
+void LLWorkPool::runIndices(Task* task, S32 count)
+{
+	while (true)
+	{
+		// apr_atomic_inc32() hands back the value before the increment.
+		S32 index = (S32)mNextIndex++;
+		if (index >= count)
+		{
+			break;
+		}
+		task->run(index);
+	}
+}
+
+//============================================================================
+// WORKER THREADS
+
+void LLWorkPool::runWorker()
+{
+	U32 seen_generation = 0;
+
+	mCondition->lock();
+	++mStarted;
+	mCondition->broadcast();
+	while (!mQuitting)
+	{
+		if (mTask && mGeneration != seen_generation)
+		{
+			seen_generation = mGeneration;
+			Task* task = mTask;
+			S32 count = mCount;
+			++mActive;
+			mCondition->unlock();
+
+			runIndices(task, count);
+
+			mCondition->lock();
+			if (--mActive == 0)
+			{
+				mCondition->broadcast();
+			}
+		}
+		else
+		{
+			mCondition->wait();
+		}
+	}
+	mCondition->unlock();
+}
@@ -0,0 +1,108 @@
+/**
+ * @file llworkpool.h
+ * @brief Fork/join pool of worker threads for data-parallel loops.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLWORKPOOL_H
+#define LL_LLWORKPOOL_H
+
+#include <string>
+#include <vector>
+
+#include "llapr.h"
+#include "llthread.h"
+
+//============================================================================
+// LLWorkPool
+//
+// Unlike LLQueuedThread, which owns one thread and a queue of long-lived
+// requests, LLWorkPool splits a single loop across several threads and
+// returns when every iteration has run.  The calling thread takes part in
+// the work, so a pool with zero threads simply runs the loop inline.
+//
+// Usage:
+//   class MyTask : public LLWorkPool::Task
+//   {
+//       /*virtual*/ void run(S32 index) { ...process element index... }
+//   };
+//   MyTask task;
+//   pool->parallelFor(task, count);
+//
+// Tasks may run concurrently for different indices and in any order; it is
+// up to the caller to make sure that distinct indices don't write to the
+// same memory.  Only one loop runs on a pool at a time: a parallelFor()
+// issued while another is in flight (including from inside a task) runs
+// serially on the calling thread.
+
+class LL_COMMON_API LLWorkPool
+{
+public:
+	class LL_COMMON_API Task
+	{
+	public:
+		virtual ~Task();
+		virtual void run(S32 index) = 0;
+	};
+
+	// num_threads < 0 picks one thread per core, less one for the caller.
+	LLWorkPool(const std::string& name, S32 num_threads = -1);
+	~LLWorkPool();
+
+	// Runs task.run(i) for every i in [0, count) and blocks until done.
+	void parallelFor(Task& task, S32 count);
+
+	S32 getNumThreads() const { return (S32)mThreads.size(); }
+
+	// Number of threads worth creating on this machine (cores - 1).
+	static S32 getDefaultThreadCount();
+
+private:
+	class Worker;
+	friend class Worker;
+
+	// No copy constructor or copy assignment
+	LLWorkPool(const LLWorkPool&);
+	LLWorkPool& operator=(const LLWorkPool&);
+
+	void runWorker();
+	void runIndices(Task* task, S32 count);
+
+private:
+	std::string mName;
+	std::vector<Worker*> mThreads;
+
+	// Guards everything below except mNextIndex and mBusy.
+	LLCondition* mCondition;
+	Task* mTask;			// NULL when no loop is accepting helpers
+	S32 mCount;
+	U32 mGeneration;		// bumped for every parallelFor()
+	S32 mActive;			// workers currently inside runIndices()
+	S32 mStarted;			// workers that have entered runWorker()
+	bool mQuitting;
+
+	LLAtomicU32 mNextIndex;
+	LLAtomicU32 mBusy;
+};
+
+#endif // LL_LLWORKPOOL_H
@@ -31,8 +31,10 @@
 
 #include "../llerror.h"
 
+#include "../llapr.h"
 #include "../llerrorcontrol.h"
 #include "../llsd.h"
+#include "../lltimer.h"
 
 #include "../test/lltut.h"
 
@@ -744,7 +746,108 @@ namespace tut
 		ensure_message_contains(8, "big easy");
 		ensure_message_count(9);
 	}
-}	
+
+	template<> template<>
+		// asynchronous logging keeps the filtering and the order, with
+		// errors after everything logged before them
+	void ErrorTestObject::test<17>()
+	{
+		LLError::setDefaultLevel(LLError::LEVEL_WARN);
+		LLError::setClassLevel("TestBeta", LLError::LEVEL_INFO);
+
+		LLError::setAsyncLogging(true);
+		TestAlpha::doAll();
+		TestBeta::doAll();
+		ensure_message_contains(0, "aim west");
+		ensure_message_contains(1, "error");
+		ensure_message_contains(2, "ate eels");
+		ensure_message_contains(5, "error");
+		ensure_message_contains(6, "big easy");
+
+		for (int i = 0; i < 100; ++i)
+		{
+			TestBeta::doInfo();
+		}
+		LLError::setAsyncLogging(false);
+
+		ensure_message_count(107);
+		ensure_message_contains(106, "buy iron");
+	}
+}
+
+namespace
+{
+	// Holds up the log writer until released.
+	class BlockingRecorder : public LLError::Recorder
+	{
+	public:
+		BlockingRecorder() : mEntered(0), mOpen(0) { }
+
+		void recordMessage(LLError::ELevel level, const std::string& message)
+		{
+			mEntered = 1;
+			while (mOpen == 0)
+			{
+				ms_sleep(1);
+			}
+		}
+
+		LLAtomicU32 mEntered;
+		LLAtomicU32 mOpen;
+	};
+
+	void logCount(int n)
+	{
+		llinfos << "count " << n << llendl;
+	}
+}
+
+namespace tut
+{
+	template<> template<>
+		// a full queue drops and counts messages rather than blocking
+	void ErrorTestObject::test<18>()
+	{
+		BlockingRecorder blocker;
+		LLError::addRecorder(&blocker);
+		LLError::setAsyncLogging(true);
+
+		logCount(0);
+		while (blocker.mEntered == 0)
+		{
+			ms_sleep(1);
+		}
+
+		U32 dropped_before = LLError::getDroppedLogMessages();
+		const int SENT = 10000;
+		for (int i = 1; i <= SENT; ++i)
+		{
+			logCount(i);
+		}
+		U32 dropped = LLError::getDroppedLogMessages() - dropped_before;
+
+		blocker.mOpen = 1;
+		LLError::setAsyncLogging(false);
+		LLError::removeRecorder(&blocker);
+
+		ensure("some dropped", dropped > 0);
+		int counted = 0;
+		bool reported = false;
+		for (int i = 0; i < mRecorder.countMessages(); ++i)
+		{
+			if (mRecorder.message(i).find("count ") != std::string::npos)
+			{
+				++counted;
+			}
+			else if (mRecorder.message(i).find("dropped") != std::string::npos)
+			{
+				reported = true;
+			}
+		}
+		ensure_equals("recorded or dropped", counted + (int)dropped, SENT + 1);
+		ensure("drops reported", reported);
+	}
+}
 
 /* Tests left:
 	handling of classes without LOG_CLASS
@@ -760,3 +863,100 @@ namespace tut
 	mutex use when logging (?)
 	strange careful about to crash handling (?)
 */
+
+namespace
+{
+	std::string sClockTime;
+
+	std::string clockTime()
+	{
+		return sClockTime;
+	}
+}
+
+namespace tut
+{
+	template<> template<>
+		// a queued message keeps the time it was logged at
+	void ErrorTestObject::test<19>()
+	{
+		// not the writer thread's own messages
+		LLError::setDefaultLevel(LLError::LEVEL_WARN);
+		LLError::setFunctionLevel("logCount", LLError::LEVEL_INFO);
+		LLError::setTimeFunction(clockTime);
+		mRecorder.setWantsTime(true);
+		BlockingRecorder blocker;
+		LLError::addRecorder(&blocker);
+		LLError::setAsyncLogging(true);
+
+		sClockTime = "first";
+		logCount(1);
+		while (blocker.mEntered == 0)
+		{
+			ms_sleep(1);
+		}
+		sClockTime = "logged";
+		logCount(2);
+		sClockTime = "written";
+
+		blocker.mOpen = 1;
+		LLError::setAsyncLogging(false);
+		LLError::removeRecorder(&blocker);
+
+		ensure_message_count(2);
+		ensure_message_contains(1, "count 2");
+		ensure_message_contains(1, "logged");
+		ensure_message_does_not_contain(1, "written");
+	}
+
+	template<> template<>
+		// the crash handler's flush gives up on a writer that holds the log
+		// lock instead of waiting for it
+	void ErrorTestObject::test<20>()
+	{
+		// the lock it gives up on; tests don't otherwise have one
+		apr_pool_t* pool = NULL;
+		bool own_mutex = (gLogMutexp == NULL);
+		if (own_mutex)
+		{
+			apr_pool_create(&pool, NULL);
+			apr_thread_mutex_create(&gLogMutexp, APR_THREAD_MUTEX_UNNESTED, pool);
+		}
+
+		LLError::setDefaultLevel(LLError::LEVEL_WARN);
+		LLError::setFunctionLevel("logCount", LLError::LEVEL_INFO);
+		BlockingRecorder blocker;
+		LLError::addRecorder(&blocker);
+		LLError::setAsyncLogging(true);
+
+		logCount(1);
+		while (blocker.mEntered == 0)
+		{
+			ms_sleep(1);
+		}
+		logCount(2);
+
+		LLTimer timer;
+		LLError::writeQueuedLogsForCrash(100);
+		F32 elapsed = timer.getElapsedTimeF32();
+		int written = mRecorder.countMessages();
+
+		// what it left is still written once the writer gets going
+		blocker.mOpen = 1;
+		LLError::setAsyncLogging(false);
+		LLError::removeRecorder(&blocker);
+
+		if (own_mutex)
+		{
+			apr_thread_mutex_destroy(gLogMutexp);
+			gLogMutexp = NULL;
+			apr_pool_destroy(pool);
+		}
+
+		ensure("gave up", elapsed < 5.f);
+		ensure_equals("written by then", written, 1);
+		ensure_message_count(2);
+		ensure_message_contains(0, "count 1");
+		ensure_message_contains(1, "count 2");
+	}
+}
@@ -0,0 +1,269 @@
+/**
+ * @file llfasttimer_test.cpp
+ * @brief Tests for fast timers on worker threads.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llfasttimer.h"
+#include "../llfile.h"
+#include "../llthread.h"
+#include "../lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	LLFastTimer::DeclareTimer FTM_TEST_OUTER("Test Outer");
+	LLFastTimer::DeclareTimer FTM_TEST_INNER("Test Inner");
+
+	// Runs nested timers a number of times
+	class TimerThread : public LLThread
+	{
+	public:
+		TimerThread(const std::string& name, S32 count, LLAtomicS32& finished)
+			: LLThread(name),
+			  mCount(count),
+			  mFinished(finished)
+		{
+		}
+
+	protected:
+		/*virtual*/ void run()
+		{
+			for (S32 i = 0; i < mCount; ++i)
+			{
+				LLFastTimer outer(FTM_TEST_OUTER);
+				LLFastTimer inner(FTM_TEST_INNER);
+			}
+			mFinished++;
+		}
+
+	private:
+		S32 mCount;
+		LLAtomicS32& mFinished;
+	};
+
+	void run_threads(std::vector<LLThread*>& threads, LLAtomicS32& finished)
+	{
+		for (size_t i = 0; i < threads.size(); ++i)
+		{
+			threads[i]->start();
+		}
+		// isStopped() is also true before a thread gets going.
+		while (finished < (S32)threads.size())
+		{
+			ms_sleep(1);
+		}
+		for (size_t i = 0; i < threads.size(); ++i)
+		{
+			while (!threads[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+			delete threads[i];
+		}
+		threads.clear();
+	}
+
+	LLFastTimer::NamedTimer* find_child(LLFastTimer::NamedTimer* parent, const std::string& name)
+	{
+		for (LLFastTimer::NamedTimer::child_const_iter it = parent->beginChildren();
+			it != parent->endChildren();
+			++it)
+		{
+			if ((*it)->getName() == name)
+			{
+				return *it;
+			}
+		}
+		return NULL;
+	}
+
+	LLFastTimer::NamedTimer* find_thread_root(const std::string& name)
+	{
+		const std::vector<LLFastTimer::NamedTimer*>& roots = LLFastTimer::NamedTimer::getThreadRootTimers();
+		for (size_t i = 0; i < roots.size(); ++i)
+		{
+			if (roots[i]->getName() == name)
+			{
+				return roots[i];
+			}
+		}
+		return NULL;
+	}
+}
+
+namespace tut
+{
+	struct fasttimer_data
+	{
+		fasttimer_data()
+		{
+			LLFastTimer::initClass();
+			LLFastTimer::reset();
+		}
+	};
+	typedef test_group<fasttimer_data> fasttimer_test;
+	typedef fasttimer_test::object fasttimer_object;
+	tut::fasttimer_test fasttimer("LLFastTimer");
+
+	template<> template<>
+	void fasttimer_object::test<1>()
+	{
+		// A worker's timers show up under a root of its own, with the
+		// nesting it actually ran, and stay out of the main thread's tree.
+		LLAtomicS32 finished(0);
+		std::vector<LLThread*> threads;
+		threads.push_back(new TimerThread("timer test", 100, finished));
+		run_threads(threads, finished);
+
+		// the first frame adds the worker's timers, the second counts them
+		LLFastTimer::nextFrame();
+		LLFastTimer::nextFrame();
+
+		LLFastTimer::NamedTimer* root = find_thread_root("timer test");
+		ensure("thread root", root != NULL);
+		ensure("thread timer", root->isThreadTimer());
+		LLFastTimer::NamedTimer* outer = find_child(root, "Test Outer");
+		ensure("outer timer", outer != NULL);
+		LLFastTimer::NamedTimer* inner = find_child(outer, "Test Inner");
+		ensure("inner timer under outer", inner != NULL);
+		ensure_equals("outer calls", outer->getHistoricalCalls(0), 100U);
+		ensure_equals("inner calls", inner->getHistoricalCalls(0), 100U);
+		ensure("outer includes inner", outer->getHistoricalCount(0) >= inner->getHistoricalCount(0));
+
+		const LLFastTimer::NamedTimer* main_outer = LLFastTimer::getTimerByName("Test Outer");
+		ensure("declared timer", main_outer != NULL);
+		ensure("not a thread timer", !main_outer->isThreadTimer());
+		ensure_equals("no main thread calls", main_outer->getHistoricalCalls(0), 0U);
+
+		// nothing new once the thread is gone
+		LLFastTimer::nextFrame();
+		ensure_equals("finished thread", outer->getHistoricalCalls(0), 0U);
+	}
+
+	template<> template<>
+	void fasttimer_object::test<2>()
+	{
+		// Threads sharing a name add up in one tree.
+		LLAtomicS32 finished(0);
+		std::vector<LLThread*> threads;
+		for (S32 i = 0; i < 3; ++i)
+		{
+			threads.push_back(new TimerThread("shared timer test", 50, finished));
+		}
+		run_threads(threads, finished);
+
+		LLFastTimer::nextFrame();
+		LLFastTimer::nextFrame();
+
+		LLFastTimer::NamedTimer* root = find_thread_root("shared timer test");
+		ensure("thread root", root != NULL);
+		LLFastTimer::NamedTimer* outer = find_child(root, "Test Outer");
+		ensure("outer timer", outer != NULL);
+		ensure_equals("outer calls", outer->getHistoricalCalls(0), 150U);
+		ensure_equals("one tree", root->getChildren().size(), (size_t)1);
+	}
+	template<> template<>
+	void fasttimer_object::test<3>()
+	{
+		// Recorded events come back out as a trace, by way of the binary
+		// file, with every thread and its begin/end pairs.
+		LLFastTimer::startRecording(4096);
+		{
+			LLFastTimer outer(FTM_TEST_OUTER);
+			LLFastTimer inner(FTM_TEST_INNER);
+		}
+		LLFastTimer::nextFrame();
+
+		LLAtomicS32 finished(0);
+		std::vector<LLThread*> threads;
+		threads.push_back(new TimerThread("trace test \"worker\"", 10, finished));
+		run_threads(threads, finished);
+		LLFastTimer::stopRecording();
+
+		std::string filename("llfasttimer_test.lltl");
+		ensure("write timeline", LLFastTimer::writeTimeline(filename, 60.f, LLFastTimer::TIMELINE_BINARY));
+
+		std::ostringstream trace;
+		{
+			llifstream is(filename, std::ios::in | std::ios::binary);
+			ensure("convert", LLFastTimer::convertTimeline(is, trace));
+		}
+		LLFile::remove(filename);
+
+		std::string json = trace.str();
+		ensure("main thread", json.find("\"name\":\"Main\"") != std::string::npos);
+		ensure("escaped thread name", json.find("trace test \\\"worker\\\"") != std::string::npos);
+		ensure("outer begins", json.find("\"name\":\"Test Outer\",\"ph\":\"B\"") != std::string::npos);
+		ensure("frame marker", json.find("\"ph\":\"i\"") != std::string::npos);
+
+		size_t begins = 0, ends = 0;
+		for (size_t pos = 0; (pos = json.find("\"ph\":\"B\"", pos)) != std::string::npos; ++pos) ++begins;
+		for (size_t pos = 0; (pos = json.find("\"ph\":\"E\"", pos)) != std::string::npos; ++pos) ++ends;
+		ensure_equals("main and worker begins", begins, (size_t)22);
+		ensure_equals("balanced", ends, begins);
+
+		std::istringstream garbage("not a timeline");
+		std::ostringstream unused;
+		ensure("reject other files", !LLFastTimer::convertTimeline(garbage, unused));
+	}
+
+	template<> template<>
+	void fasttimer_object::test<4>()
+	{
+		// The trace can be written straight out, as Save Timer Trace does,
+		// and only covers the last few seconds asked for.
+		LLFastTimer::startRecording(4096);
+		{
+			LLFastTimer outer(FTM_TEST_OUTER);
+		}
+		ms_sleep(200);
+		{
+			LLFastTimer outer(FTM_TEST_OUTER);
+			LLFastTimer inner(FTM_TEST_INNER);
+		}
+		LLFastTimer::stopRecording();
+
+		std::string filename("llfasttimer_test.json");
+		ensure("write trace", LLFastTimer::writeTimeline(filename, 0.1f, LLFastTimer::TIMELINE_TRACE));
+		std::string json;
+		{
+			llifstream is(filename, std::ios::in | std::ios::binary);
+			std::ostringstream contents;
+			contents << is.rdbuf();
+			json = contents.str();
+		}
+		LLFile::remove(filename);
+
+		ensure("main thread", json.find("\"name\":\"Main\"") != std::string::npos);
+		ensure("inner begins", json.find("\"name\":\"Test Inner\",\"ph\":\"B\"") != std::string::npos);
+		size_t begins = 0, ends = 0;
+		for (size_t pos = 0; (pos = json.find("\"ph\":\"B\"", pos)) != std::string::npos; ++pos) ++begins;
+		for (size_t pos = 0; (pos = json.find("\"ph\":\"E\"", pos)) != std::string::npos; ++pos) ++ends;
+		ensure_equals("only the last pair", begins, (size_t)2);
+		ensure_equals("balanced", ends, begins);
+	}
+}
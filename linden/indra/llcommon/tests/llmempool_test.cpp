@@ -0,0 +1,260 @@
+/**
+ * @file llmempool_test.cpp
+ * @brief Tests for LLMemPool and LLMemPoolAllocator.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llmempool.h"
+#include "../llthread.h"
+#include "../lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Allocates blocks and leaves them for the main thread to check and
+	// free, then hands its cache back on the way out like every LLThread.
+	class AllocThread : public LLThread
+	{
+	public:
+		AllocThread(S32 seed, S32 count, LLAtomicS32& finished)
+			: LLThread("memory pool test"),
+			  mSeed(seed),
+			  mCount(count),
+			  mFinished(finished)
+		{
+		}
+
+		std::vector<U8*> mBlocks;
+
+	protected:
+		/*virtual*/ void run()
+		{
+			for (S32 i = 0; i < mCount; ++i)
+			{
+				size_t size = 1 + (i * 37 + mSeed) % 700;
+				U8* block = (U8*)LLMemPool::allocate(size, LLMemType::MTYPE_TEMP4);
+				memset(block, (U8)mSeed, size);
+				// and some churn that stays on this thread
+				LLMemPool::deallocate(LLMemPool::allocate(size, LLMemType::MTYPE_TEMP4));
+				mBlocks.push_back(block);
+			}
+			mFinished++;
+		}
+
+	private:
+		S32 mSeed;
+		S32 mCount;
+		LLAtomicS32& mFinished;
+	};
+}
+
+namespace tut
+{
+	struct mempool_data
+	{
+	};
+	typedef test_group<mempool_data> mempool_test;
+	typedef mempool_test::object mempool_object;
+	tut::mempool_test mempool("LLMemPool");
+
+	template<> template<>
+	void mempool_object::test<1>()
+	{
+		// Every size class and a few large blocks: usable, aligned, tagged
+		// and counted until they go back.
+		const S32 type = LLMemType::MTYPE_TEMP2.mID;
+		ensure_equals("nothing live yet", LLMemPool::getUsage(type).mCount, 0);
+
+		std::vector<U8*> blocks;
+		S64 bytes = 0;
+		for (size_t size = 0; size <= 70000; size += (size < 512 ? 1 : 509))
+		{
+			U8* block = (U8*)LLMemPool::allocate(size, LLMemType::MTYPE_TEMP2);
+			ensure("allocated", block != NULL);
+			ensure_equals("aligned", (size_t)block % 8, (size_t)0);
+			ensure_equals("size", LLMemPool::getSize(block), size);
+			ensure_equals("type", LLMemPool::getType(block), type);
+			memset(block, (U8)size, size);
+			blocks.push_back(block);
+			bytes += size;
+		}
+
+		LLMemPool::Usage usage = LLMemPool::getUsage(type);
+		ensure_equals("live count", usage.mCount, (S32)blocks.size());
+		ensure_equals("live bytes", usage.mBytes, bytes);
+
+		std::vector<LLMemPool::Usage> all;
+		LLMemPool::getUsage(all);
+		bool listed = false;
+		for (size_t i = 0; i < all.size(); ++i)
+		{
+			if (all[i].mType == type)
+			{
+				listed = (all[i].mBytes == bytes);
+			}
+			if (i > 0)
+			{
+				ensure("most bytes first", all[i - 1].mBytes >= all[i].mBytes);
+			}
+		}
+		ensure("listed", listed);
+
+		for (size_t i = 0; i < blocks.size(); ++i)
+		{
+			size_t size = LLMemPool::getSize(blocks[i]);
+			for (size_t k = 0; k < size; ++k)
+			{
+				if (blocks[i][k] != (U8)size)
+				{
+					fail(llformat("block of %d bytes overwritten", (S32)size));
+				}
+			}
+			LLMemPool::deallocate(blocks[i]);
+		}
+		usage = LLMemPool::getUsage(type);
+		ensure_equals("none live", usage.mCount, 0);
+		ensure_equals("no bytes", usage.mBytes, (S64)0);
+
+		LLMemPool::deallocate(NULL);
+
+		// the last block of a class freed on this thread is the next one out
+		void* reused = LLMemPool::allocate(40, type);
+		ensure("reused", reused == blocks[40]);
+		LLMemPool::deallocate(reused);
+	}
+
+	template<> template<>
+	void mempool_object::test<2>()
+	{
+		// reallocate() keeps the contents and the type, and moves the counts.
+		const S32 type = LLMemType::MTYPE_TEMP3.mID;
+		char* block = (char*)LLMemPool::allocate(10, type);
+		strcpy(block, "LLMemPool");
+		block = (char*)LLMemPool::reallocate(block, 12);
+		ensure_equals("grown in place", std::string(block), std::string("LLMemPool"));
+		block = (char*)LLMemPool::reallocate(block, 50000);
+		ensure_equals("grown large", std::string(block), std::string("LLMemPool"));
+		ensure_equals("type kept", LLMemPool::getType(block), type);
+		ensure_equals("large bytes", LLMemPool::getUsage(type).mBytes, (S64)50000);
+		block = (char*)LLMemPool::reallocate(block, 4);
+		ensure("shrunk", memcmp(block, "LLMe", 4) == 0);
+		ensure_equals("shrunk bytes", LLMemPool::getUsage(type).mBytes, (S64)4);
+		ensure_equals("one block", LLMemPool::getUsage(type).mCount, 1);
+		LLMemPool::deallocate(block);
+		ensure_equals("freed", LLMemPool::getUsage(type).mCount, 0);
+
+		// types the pool has no slot for are counted as MTYPE_OTHER
+		void* stray = LLMemPool::allocate(8, LLMemPool::MAX_TYPES + 5);
+		ensure_equals("other", LLMemPool::getType(stray), LLMemType::MTYPE_OTHER.mID);
+		LLMemPool::deallocate(stray);
+	}
+
+	template<> template<>
+	void mempool_object::test<3>()
+	{
+		// Containers using the allocator are counted under its type.
+		const S32 type = LLMemType::MTYPE_TEMP5.mID;
+		{
+			std::vector<S32, LLMemPoolAllocator<S32> > values((LLMemPoolAllocator<S32>(LLMemType::MTYPE_TEMP5)));
+			for (S32 i = 0; i < 10000; ++i)
+			{
+				values.push_back(i);
+			}
+			ensure_equals("one live buffer", LLMemPool::getUsage(type).mCount, 1);
+			ensure("holds the values", LLMemPool::getUsage(type).mBytes >= (S64)(10000 * sizeof(S32)));
+
+			std::vector<S32, LLMemPoolAllocator<S32> > copy(values);
+			ensure_equals("copy has the type", copy.get_allocator().getType(), type);
+			ensure_equals("copied", copy[9999], 9999);
+			ensure_equals("two live buffers", LLMemPool::getUsage(type).mCount, 2);
+		}
+		ensure_equals("all gone", LLMemPool::getUsage(type).mCount, 0);
+	}
+
+	template<> template<>
+	void mempool_object::test<4>()
+	{
+		// Blocks allocated on one thread and freed on another come out even,
+		// after the allocating threads have released their caches.
+		const S32 type = LLMemType::MTYPE_TEMP4.mID;
+		const S32 COUNT = 5000;
+		LLAtomicS32 finished(0);
+		std::vector<AllocThread*> threads;
+		for (S32 i = 0; i < 4; ++i)
+		{
+			threads.push_back(new AllocThread(i + 1, COUNT, finished));
+			threads.back()->start();
+		}
+		// isStopped() is also true before a thread gets going.
+		while (finished < (S32)threads.size())
+		{
+			ms_sleep(1);
+		}
+		for (size_t i = 0; i < threads.size(); ++i)
+		{
+			while (!threads[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+		}
+		ensure_equals("live across threads", LLMemPool::getUsage(type).mCount, (S32)threads.size() * COUNT);
+
+		for (size_t t = 0; t < threads.size(); ++t)
+		{
+			for (size_t i = 0; i < threads[t]->mBlocks.size(); ++i)
+			{
+				U8* block = threads[t]->mBlocks[i];
+				size_t size = LLMemPool::getSize(block);
+				ensure("not shared", block[0] == (U8)(t + 1) && block[size - 1] == (U8)(t + 1));
+				LLMemPool::deallocate(block);
+			}
+			delete threads[t];
+		}
+		LLMemPool::Usage usage = LLMemPool::getUsage(type);
+		ensure_equals("none live", usage.mCount, 0);
+		ensure_equals("no bytes", usage.mBytes, (S64)0);
+
+		// this thread's cache can go and come back
+		LLMemPool::releaseThreadCache();
+		void* block = LLMemPool::allocate(100, type);
+		ensure_equals("new cache counts", LLMemPool::getUsage(type).mCount, 1);
+		LLMemPool::deallocate(block);
+		ensure_equals("even again", LLMemPool::getUsage(type).mCount, 0);
+	}
+
+	template<> template<>
+	void mempool_object::test<5>()
+	{
+		// The benchmark behind Advanced > Benchmark Memory Pool runs without
+		// a viewer, and gives back every block it churned on every thread.
+		const S32 type = LLMemType::MTYPE_TEMP1.mID;
+		LLMemPool::Usage before = LLMemPool::getUsage(type);
+		LLMemPool::benchmark(2);
+		LLMemPool::Usage after = LLMemPool::getUsage(type);
+		ensure_equals("blocks", after.mCount, before.mCount);
+		ensure_equals("bytes", after.mBytes, before.mBytes);
+	}
+}
@@ -0,0 +1,189 @@
+/**
+ * @file llmutex_test.cpp
+ * @brief Tests for LLMutex and its contention profiling.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llthread.h"
+#include "../lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Waits for the mutex the main thread is holding, so that lock()
+	// finds it taken.
+	class WaitThread : public LLThread
+	{
+	public:
+		WaitThread(LLMutex& mutex, LLAtomicS32& waiting, LLAtomicS32& finished)
+			: LLThread("mutex test"),
+			  mMutex(mutex),
+			  mWaiting(waiting),
+			  mFinished(finished)
+		{
+		}
+
+	protected:
+		/*virtual*/ void run()
+		{
+			mWaiting++;
+			mMutex.lock();
+			mMutex.unlock();
+			mFinished++;
+		}
+
+	private:
+		LLMutex& mMutex;
+		LLAtomicS32& mWaiting;
+		LLAtomicS32& mFinished;
+	};
+
+	// The record for name, or NULL
+	const LLMutex::Contention* find_record(const std::vector<LLMutex::Contention>& records, const std::string& name)
+	{
+		for (size_t i = 0; i < records.size(); ++i)
+		{
+			if (records[i].mName == name)
+			{
+				return &records[i];
+			}
+		}
+		return NULL;
+	}
+}
+
+namespace tut
+{
+	struct mutex_data
+	{
+		mutex_data()
+		{
+			// start from clean records
+			std::vector<LLMutex::Contention> records;
+			LLMutex::getContention(records, true);
+		}
+
+		~mutex_data()
+		{
+			LLMutex::setProfiling(false);
+		}
+	};
+	typedef test_group<mutex_data> mutex_test;
+	typedef mutex_test::object mutex_object;
+	tut::mutex_test mutex("LLMutex");
+
+	template<> template<>
+	void mutex_object::test<1>()
+	{
+		// Nothing is counted with profiling off, nor for unnamed mutexes.
+		LLMutex named(NULL, "mutex test quiet");
+		LLMutex unnamed(NULL);
+		for (S32 i = 0; i < 10; ++i)
+		{
+			named.lock();
+			named.unlock();
+		}
+		LLMutex::setProfiling(true);
+		unnamed.lock();
+		unnamed.unlock();
+
+		std::vector<LLMutex::Contention> records;
+		LLMutex::getContention(records);
+		ensure("quiet mutex has no record", find_record(records, "mutex test quiet") == NULL);
+	}
+
+	template<> template<>
+	void mutex_object::test<2>()
+	{
+		// Mutexes sharing a name share a record, which counts every lock()
+		// and successful trylock(), and reset clears it.
+		LLMutex::setProfiling(true);
+		LLMutex first(NULL, "mutex test shared");
+		LLMutex second(NULL, "mutex test shared");
+		for (S32 i = 0; i < 3; ++i)
+		{
+			first.lock();
+			ensure("held", first.isLocked());
+			ensure("trylock fails while held", !first.trylock());
+			first.unlock();
+		}
+		ensure("trylock", second.trylock());
+		second.unlock();
+
+		std::vector<LLMutex::Contention> records;
+		LLMutex::getContention(records, false);
+		const LLMutex::Contention* record = find_record(records, "mutex test shared");
+		ensure("shared record", record != NULL);
+		ensure_equals("locks", record->mAcquisitions, (U32)4);
+		ensure_equals("uncontended", record->mContentions, (U32)0);
+
+		records.clear();
+		LLMutex::getContention(records, true);
+		ensure("still there without reset", find_record(records, "mutex test shared") != NULL);
+		records.clear();
+		LLMutex::getContention(records, true);
+		ensure("gone after reset", find_record(records, "mutex test shared") == NULL);
+	}
+
+	template<> template<>
+	void mutex_object::test<3>()
+	{
+		// A lock() that has to wait is counted as contended, with its wait.
+		LLMutex::setProfiling(true);
+		LLMutex mutex(NULL, "mutex test contended");
+		LLAtomicS32 waiting(0);
+		LLAtomicS32 finished(0);
+
+		mutex.lock();
+		WaitThread* thread = new WaitThread(mutex, waiting, finished);
+		thread->start();
+		while (waiting == 0)
+		{
+			ms_sleep(1);
+		}
+		// long enough for the spinning to give up
+		ms_sleep(20);
+		mutex.unlock();
+		while (finished == 0)
+		{
+			ms_sleep(1);
+		}
+		while (!thread->isStopped())
+		{
+			ms_sleep(1);
+		}
+		delete thread;
+
+		std::vector<LLMutex::Contention> records;
+		LLMutex::getContention(records);
+		const LLMutex::Contention* record = find_record(records, "mutex test contended");
+		ensure("contended record", record != NULL);
+		ensure_equals("locks", record->mAcquisitions, (U32)2);
+		ensure_equals("contended", record->mContentions, (U32)1);
+		ensure("waited", record->mWaitMicroseconds > 1000);
+		ensure("worst first", records.front().mWaitMicroseconds >= record->mWaitMicroseconds);
+	}
+}
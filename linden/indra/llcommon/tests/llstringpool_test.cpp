@@ -0,0 +1,224 @@
+/**
+ * @file llstringpool_test.cpp
+ * @brief Tests for LLStringPool and the string tables built on it.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llstringpool.h"
+#include "../llstringtable.h"
+#include "../llthread.h"
+#include "../lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Interns every name, starting at a different place in the list from
+	// the other threads, and remembers what it got back.
+	class InternThread : public LLThread
+	{
+	public:
+		InternThread(LLStringPool& pool, const std::vector<std::string>& names, size_t start,
+					 LLAtomicS32& go, LLAtomicS32& finished)
+			: LLThread("string pool test"),
+			  mPool(pool),
+			  mNames(names),
+			  mStart(start),
+			  mGo(go),
+			  mFinished(finished),
+			  mHandles(names.size(), (LLStringPool::Entry*)NULL),
+			  mMisses(0)
+		{
+		}
+
+		std::vector<LLStringPool::Entry*> mHandles;
+		S32 mMisses;
+
+	protected:
+		/*virtual*/ void run()
+		{
+			while (mGo == 0)
+			{
+				yield();
+			}
+			for (size_t n = 0; n < mNames.size(); ++n)
+			{
+				size_t i = (mStart + n) % mNames.size();
+				mHandles[i] = mPool.intern(mNames[i]);
+				// and it must stay findable however the table grows
+				if (mPool.find(mNames[i]) != mHandles[i])
+				{
+					++mMisses;
+				}
+			}
+			mFinished++;
+		}
+
+	private:
+		LLStringPool& mPool;
+		const std::vector<std::string>& mNames;
+		size_t mStart;
+		LLAtomicS32& mGo;
+		LLAtomicS32& mFinished;
+	};
+}
+
+namespace tut
+{
+	struct stringpool_data
+	{
+	};
+	typedef test_group<stringpool_data> stringpool_test;
+	typedef stringpool_test::object stringpool_object;
+	tut::stringpool_test stringpool("LLStringPool");
+
+	template<> template<>
+	void stringpool_object::test<1>()
+	{
+		// One copy per string, however it's spelled on the way in, and the
+		// copies don't move when the tables grow.
+		LLStringPool pool;
+		ensure("empty pool finds nothing", pool.find("AgentData") == NULL);
+
+		LLStringPool::Entry* agent = pool.intern("AgentData");
+		ensure_equals("string", agent->mStdString, std::string("AgentData"));
+		ensure_equals("C string", std::string(agent->mString), std::string("AgentData"));
+		ensure("same for std::string", pool.intern(std::string("AgentData")) == agent);
+		ensure("same for a prefix", pool.intern("AgentDataBlock", 9) == agent);
+		ensure("found", pool.find("AgentData") == agent);
+		ensure("prefix isn't the string", pool.find("Agent") == NULL);
+
+		std::string with_nul("a\0b", 3);
+		LLStringPool::Entry* nul = pool.intern(with_nul);
+		ensure("embedded nul", nul != pool.intern("a"));
+		ensure_equals("embedded nul kept", nul->mStdString.size(), (size_t)3);
+
+		std::vector<LLStringPool::Entry*> handles;
+		for (S32 i = 0; i < 10000; ++i)
+		{
+			handles.push_back(pool.intern(llformat("name%d", i)));
+		}
+		ensure_equals("size", pool.size(), (U32)10003);
+		for (S32 i = 0; i < 10000; ++i)
+		{
+			std::string name = llformat("name%d", i);
+			ensure("stable", pool.find(name) == handles[i]);
+			ensure_equals("contents", handles[i]->mStdString, name);
+		}
+		ensure("first still there", pool.find("AgentData") == agent);
+
+		std::vector<LLStringPool::Entry*> entries;
+		pool.getEntries(entries);
+		ensure_equals("all entries", entries.size(), (size_t)10003);
+		for (size_t i = 1; i < entries.size(); ++i)
+		{
+			ensure("sorted", entries[i - 1]->mStdString < entries[i]->mStdString);
+		}
+
+		pool.clear();
+		ensure_equals("cleared", pool.size(), (U32)0);
+		ensure("gone", pool.find("AgentData") == NULL);
+		ensure("usable again", pool.intern("AgentData") == pool.find("AgentData"));
+	}
+
+	template<> template<>
+	void stringpool_object::test<2>()
+	{
+		// The old table interfaces keep their behavior.
+		LLStringTable table(64);
+		ensure("not added yet", table.checkString("Position") == NULL);
+		char* position = table.addString("Position");
+		ensure_equals("contents", std::string(position), std::string("Position"));
+		ensure("same copy", table.addString(std::string("Position")) == position);
+		ensure("found", table.checkString("Position") == position);
+		ensure("entry", table.checkStringEntry("Position")->mString == position);
+		ensure("NULL in, NULL out", table.addString((const char*)NULL) == NULL);
+
+		// matched on their first MAX_STRINGS_LENGTH - 1 characters
+		std::string long_a(MAX_STRINGS_LENGTH + 10, 'x');
+		std::string long_b = long_a + "y";
+		ensure("long strings alias", table.addString(long_a) == table.addString(long_b));
+		ensure_equals("truncated", strlen(table.addString(long_a)), (size_t)MAX_STRINGS_LENGTH - 1);
+
+		LLStdStringTable std_table;
+		ensure("std not added yet", std_table.checkString("rot") == NULL);
+		LLStdStringHandle rot = std_table.addString("rot");
+		ensure_equals("std contents", *rot, std::string("rot"));
+		ensure("std same copy", std_table.insert("rot") == rot);
+		ensure("std found", std_table.lookup("rot") == rot);
+		std_table.cleanup();
+		ensure("std cleaned up", std_table.lookup("rot") == NULL);
+	}
+
+	template<> template<>
+	void stringpool_object::test<3>()
+	{
+		// Threads racing to add the same names all get the same copies.
+		std::vector<std::string> names;
+		for (S32 i = 0; i < 20000; ++i)
+		{
+			names.push_back(llformat("Block%dVariable", i));
+		}
+
+		LLStringPool pool;
+		LLAtomicS32 go(0);
+		LLAtomicS32 finished(0);
+		std::vector<InternThread*> threads;
+		for (S32 i = 0; i < 4; ++i)
+		{
+			threads.push_back(new InternThread(pool, names, i * names.size() / 4, go, finished));
+			threads.back()->start();
+		}
+		go = 1;
+		// isStopped() is also true before a thread gets going.
+		while (finished < (S32)threads.size())
+		{
+			ms_sleep(1);
+		}
+		for (size_t i = 0; i < threads.size(); ++i)
+		{
+			while (!threads[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+		}
+
+		ensure_equals("one copy each", pool.size(), (U32)names.size());
+		for (size_t i = 0; i < names.size(); ++i)
+		{
+			LLStringPool::Entry* entry = pool.find(names[i]);
+			ensure_equals("contents", entry->mStdString, names[i]);
+			for (size_t t = 0; t < threads.size(); ++t)
+			{
+				ensure("every thread got the same copy", threads[t]->mHandles[i] == entry);
+			}
+		}
+		for (size_t t = 0; t < threads.size(); ++t)
+		{
+			ensure_equals("never lost", threads[t]->mMisses, 0);
+			delete threads[t];
+		}
+	}
+}
@@ -0,0 +1,420 @@
+/**
+ * @file lltaskscheduler_test.cpp
+ * @brief Tests for the shared task scheduler.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llqueuedthread.h"
+#include "../lltaskscheduler.h"
+#include "../lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Counts runs and completions, and remembers the order it ran in.
+	struct Counters
+	{
+		Counters() : mRuns(0), mCompleted(0), mCancelled(0), mNext(0) {}
+
+		LLAtomicU32 mRuns;
+		S32 mCompleted;		// main thread only
+		S32 mCancelled;
+		LLAtomicU32 mNext;
+	};
+
+	class CountTask : public LLTaskScheduler::Task
+	{
+	public:
+		CountTask(Counters& counters, S32* order = NULL)
+			: mCounters(counters), mOrder(order) {}
+
+		/*virtual*/ void run()
+		{
+			U32 position = mCounters.mNext++;
+			if (mOrder)
+			{
+				*mOrder = (S32)position;
+			}
+			mCounters.mRuns++;
+		}
+
+		/*virtual*/ void completed(bool cancelled)
+		{
+			++mCounters.mCompleted;
+			if (cancelled)
+			{
+				++mCounters.mCancelled;
+			}
+		}
+
+	private:
+		Counters& mCounters;
+		S32* mOrder;
+	};
+
+	// Schedules more work from inside a worker.
+	class SpawnTask : public LLTaskScheduler::Task
+	{
+	public:
+		SpawnTask(LLTaskScheduler& scheduler, Counters& counters, S32 children)
+			: mScheduler(scheduler), mCounters(counters), mChildren(children) {}
+
+		/*virtual*/ void run()
+		{
+			for (S32 i = 0; i < mChildren; ++i)
+			{
+				mScheduler.schedule(new CountTask(mCounters), LLTaskScheduler::LANE_NORMAL, true);
+			}
+		}
+
+	private:
+		LLTaskScheduler& mScheduler;
+		Counters& mCounters;
+		S32 mChildren;
+	};
+
+	// Holds its worker until released.
+	class GateTask : public LLTaskScheduler::Task
+	{
+	public:
+		GateTask(LLAtomicU32& started, LLAtomicU32& open)
+			: mStarted(started), mOpen(open) {}
+
+		/*virtual*/ void run()
+		{
+			mStarted = 1;
+			while (mOpen == 0)
+			{
+				ms_sleep(1);
+			}
+		}
+
+	private:
+		LLAtomicU32& mStarted;
+		LLAtomicU32& mOpen;
+	};
+
+	// Needs several goes before it completes, the way a texture fetch keeps
+	// going back in the queue while it waits on the network.
+	class RetryRequest : public LLQueuedThread::QueuedRequest
+	{
+	public:
+		RetryRequest(LLQueuedThread::handle_t handle, U32 priority, S32 tries, LLAtomicU32& done)
+			: LLQueuedThread::QueuedRequest(handle, priority, LLQueuedThread::FLAG_AUTO_COMPLETE),
+			  mTries(tries),
+			  mDone(done)
+		{
+		}
+
+	protected:
+		/*virtual*/ bool processRequest()
+		{
+			if (--mTries > 0)
+			{
+				return false;
+			}
+			mDone++;
+			return true;
+		}
+
+	private:
+		S32 mTries;
+		LLAtomicU32& mDone;
+	};
+
+	// Never done, like a fetch whose server never answers; counts its goes.
+	class WaitingRequest : public LLQueuedThread::QueuedRequest
+	{
+	public:
+		WaitingRequest(LLQueuedThread::handle_t handle, LLAtomicU32& runs)
+			: LLQueuedThread::QueuedRequest(handle, LLQueuedThread::PRIORITY_LOW, LLQueuedThread::FLAG_AUTO_COMPLETE),
+			  mRuns(runs)
+		{
+		}
+
+	protected:
+		/*virtual*/ bool processRequest()
+		{
+			mRuns++;
+			return false;
+		}
+
+	private:
+		LLAtomicU32& mRuns;
+	};
+
+	class RetryThread : public LLQueuedThread
+	{
+	public:
+		RetryThread(LLTaskScheduler* scheduler)
+			: LLQueuedThread("retry thread", true, scheduler),
+			  mStarts(0),
+			  mEnds(0)
+		{
+		}
+
+		void add(U32 priority, S32 tries, LLAtomicU32& done)
+		{
+			addRequest(new RetryRequest(generateHandle(), priority, tries, done));
+		}
+
+		void addWaiting(LLAtomicU32& runs)
+		{
+			addRequest(new WaitingRequest(generateHandle(), runs));
+		}
+
+		LLAtomicU32 mStarts;
+		LLAtomicU32 mEnds;
+
+	private:
+		/*virtual*/ void startThread()	{ mStarts++; }
+		/*virtual*/ void endThread()	{ mEnds++; }
+	};
+
+	void wait_for(LLTaskScheduler& scheduler)
+	{
+		while (scheduler.update(0) > 0)
+		{
+			ms_sleep(1);
+		}
+	}
+}
+
+namespace tut
+{
+	struct taskscheduler_data
+	{
+	};
+	typedef test_group<taskscheduler_data> taskscheduler_test;
+	typedef taskscheduler_test::object taskscheduler_object;
+	tut::taskscheduler_test taskscheduler("LLTaskScheduler");
+
+	template<> template<>
+	void taskscheduler_object::test<1>()
+	{
+		// Without threads, update() runs the tasks, highest lane first.
+		LLTaskScheduler scheduler("test scheduler", 0);
+		ensure_equals("no threads", scheduler.getNumThreads(), 0);
+
+		Counters counters;
+		S32 low = -1, normal = -1, high = -1;
+		scheduler.schedule(new CountTask(counters, &low), LLTaskScheduler::LANE_LOW, true);
+		scheduler.schedule(new CountTask(counters, &normal), LLTaskScheduler::LANE_NORMAL, true);
+		scheduler.schedule(new CountTask(counters, &high), LLTaskScheduler::LANE_HIGH, true);
+		ensure_equals("nothing runs before update", (U32)counters.mRuns, 0U);
+		ensure_equals("pending", scheduler.getPending(), 3);
+
+		ensure_equals("all done", scheduler.update(0), 0);
+		ensure_equals("runs", (U32)counters.mRuns, 3U);
+		ensure_equals("completions", counters.mCompleted, 3);
+		ensure_equals("high first", high, 0);
+		ensure_equals("normal second", normal, 1);
+		ensure_equals("low last", low, 2);
+	}
+
+	template<> template<>
+	void taskscheduler_object::test<2>()
+	{
+		// Every task runs once across several workers, including tasks
+		// scheduled from inside other tasks.
+		LLTaskScheduler scheduler("test scheduler", 4);
+		Counters counters;
+		for (S32 i = 0; i < 50; ++i)
+		{
+			scheduler.schedule(new SpawnTask(scheduler, counters, 20));
+			scheduler.schedule(new CountTask(counters), LLTaskScheduler::LANE_LOW, true);
+		}
+		wait_for(scheduler);
+		ensure_equals("runs", (U32)counters.mRuns, 50U * 21U);
+		ensure_equals("completions", counters.mCompleted, 50 * 21);
+		ensure_equals("nothing cancelled", counters.mCancelled, 0);
+		ensure_equals("nothing pending", scheduler.getPending(), 0);
+	}
+
+	template<> template<>
+	void taskscheduler_object::test<3>()
+	{
+		// Cancelled tasks never run but still report back.
+		LLTaskScheduler scheduler("test scheduler", 0);
+		Counters counters;
+		scheduler.schedule(new CountTask(counters), LLTaskScheduler::LANE_NORMAL, true);
+		LLTaskScheduler::handle_t handle = scheduler.schedule(new CountTask(counters), LLTaskScheduler::LANE_NORMAL, true);
+		scheduler.schedule(new CountTask(counters), LLTaskScheduler::LANE_NORMAL, true);
+
+		ensure("cancel queued task", scheduler.cancel(handle));
+		ensure("cancel twice", !scheduler.cancel(handle));
+		ensure("cancel null handle", !scheduler.cancel(LLTaskScheduler::nullHandle()));
+
+		scheduler.update(0);
+		ensure_equals("runs", (U32)counters.mRuns, 2U);
+		ensure_equals("completions", counters.mCompleted, 3);
+		ensure_equals("cancelled", counters.mCancelled, 1);
+	}
+
+	template<> template<>
+	void taskscheduler_object::test<4>()
+	{
+		// With the only worker busy, queued work is taken by lane once it
+		// frees up, whatever order it arrived in.
+		LLTaskScheduler scheduler("test scheduler", 1);
+		LLAtomicU32 started(0);
+		LLAtomicU32 open(0);
+		scheduler.schedule(new GateTask(started, open));
+		while (started == 0)
+		{
+			ms_sleep(1);
+		}
+
+		Counters counters;
+		S32 low = -1, normal = -1, high = -1;
+		scheduler.schedule(new CountTask(counters, &low), LLTaskScheduler::LANE_LOW);
+		scheduler.schedule(new CountTask(counters, &normal), LLTaskScheduler::LANE_NORMAL);
+		scheduler.schedule(new CountTask(counters, &high), LLTaskScheduler::LANE_HIGH);
+		open = 1;
+		wait_for(scheduler);
+
+		ensure_equals("high first", high, 0);
+		ensure_equals("normal second", normal, 1);
+		ensure_equals("low last", low, 2);
+	}
+
+	template<> template<>
+	void taskscheduler_object::test<5>()
+	{
+		// Work left in the queues is cancelled when the scheduler goes away.
+		Counters counters;
+		LLAtomicU32 started(0);
+		LLAtomicU32 open(0);
+		{
+			LLTaskScheduler scheduler("test scheduler", 1);
+			scheduler.schedule(new GateTask(started, open));
+			while (started == 0)
+			{
+				ms_sleep(1);
+			}
+			for (S32 i = 0; i < 10; ++i)
+			{
+				scheduler.schedule(new CountTask(counters), LLTaskScheduler::LANE_NORMAL, true);
+			}
+			open = 1;
+		}
+		ensure_equals("completions", counters.mCompleted, 10);
+		ensure_equals("runs plus cancellations", (S32)(U32)counters.mRuns + counters.mCancelled, 10);
+	}
+
+	template<> template<>
+	void taskscheduler_object::test<6>()
+	{
+		// A queued thread in pump mode gets through requests that keep going
+		// back in the queue at low priority without the main thread posting
+		// it again.
+		LLTaskScheduler scheduler("test scheduler", 2);
+		LLAtomicU32 done(0);
+		{
+			RetryThread thread(&scheduler);
+			ensure("scheduled", thread.isScheduled());
+			for (S32 i = 0; i < 50; ++i)
+			{
+				thread.add(LLQueuedThread::PRIORITY_LOW + i, 5, done);
+			}
+			for (S32 i = 0; i < 10; ++i)
+			{
+				thread.add(LLQueuedThread::PRIORITY_NORMAL + i, 3, done);
+			}
+
+			LLTimer timer;
+			while (done < 60 && timer.getElapsedTimeF32() < 10.f)
+			{
+				ms_sleep(1);
+			}
+			ensure_equals("all completed", (U32)done, 60U);
+			ensure_equals("nothing pending", thread.getPending(), 0);
+			ensure_equals("started once", (U32)thread.mStarts, 1U);
+		}
+		wait_for(scheduler);
+	}
+
+	template<> template<>
+	void taskscheduler_object::test<7>()
+	{
+		// Shutting down while pumps are still busy waits for them, and no pump
+		// runs or posts another once the thread is gone.
+		LLTaskScheduler scheduler("test scheduler", 2);
+		LLAtomicU32 done(0);
+		U32 ends = 0;
+		{
+			RetryThread thread(&scheduler);
+			thread.setMaxConcurrency(2);
+			for (S32 i = 0; i < 20; ++i)
+			{
+				thread.add(LLQueuedThread::PRIORITY_LOW, 1000000, done);
+			}
+			while (thread.mStarts == 0)
+			{
+				ms_sleep(1);
+			}
+			ms_sleep(20);
+			thread.shutdown();
+			ends = thread.mEnds;
+		}
+		ensure_equals("ended once", ends, 1U);
+		ensure_equals("never finished", (U32)done, 0U);
+		// Anything the pumps left behind must not touch the dead thread.
+		ms_sleep(20);
+		wait_for(scheduler);
+		ensure_equals("nothing pending", scheduler.getPending(), 0);
+	}
+
+	template<> template<>
+	void taskscheduler_object::test<8>()
+	{
+		// Requests that only ever back off are polled about once a
+		// millisecond between them, not spun on, and the pump keeps coming
+		// back for them without the main thread.
+		LLTaskScheduler scheduler("test scheduler", 2);
+		LLAtomicU32 runs(0);
+		{
+			RetryThread thread(&scheduler);
+			for (S32 i = 0; i < 5; ++i)
+			{
+				thread.addWaiting(runs);
+			}
+			while (thread.mStarts == 0)
+			{
+				ms_sleep(1);
+			}
+			U32 start_runs = runs;
+			LLTimer timer;
+			ms_sleep(500);
+			F32 elapsed = timer.getElapsedTimeF32();
+			F32 per_second = ((U32)runs - start_runs) / elapsed;
+			thread.shutdown();
+			ensure("still polled", per_second > 50.f);
+			ensure("not spinning", per_second < 1500.f);
+		}
+		wait_for(scheduler);
+	}
+}
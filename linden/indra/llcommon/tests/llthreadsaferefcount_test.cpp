@@ -0,0 +1,161 @@
+/**
+ * @file llthreadsaferefcount_test.cpp
+ * @brief Tests for the atomic LLThreadSafeRefCount.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llthread.h"
+#include "../llpointer.h"
+#include "../lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Counts destructions so the tests can see exactly one delete.
+	class Shared : public LLThreadSafeRefCount
+	{
+	public:
+		Shared(LLAtomicS32& deletes) : mDeletes(deletes) {}
+
+	protected:
+		~Shared()
+		{
+			mDeletes++;
+		}
+
+	private:
+		LLAtomicS32& mDeletes;
+	};
+
+	// Copies and drops references to a shared object, and optionally lets go
+	// of one it was handed, racing the other threads to the last unref().
+	class CopyThread : public LLThread
+	{
+	public:
+		CopyThread(Shared* target, S32 count, bool release, LLAtomicS32& finished)
+			: LLThread("refcount test"),
+			  mTarget(target),
+			  mCount(count),
+			  mRelease(release),
+			  mFinished(finished)
+		{
+		}
+
+	protected:
+		/*virtual*/ void run()
+		{
+			for (S32 i = 0; i < mCount; ++i)
+			{
+				LLPointer<Shared> copy(mTarget);
+				LLPointer<Shared> other = copy;
+			}
+			if (mRelease)
+			{
+				mTarget->unref();
+			}
+			mFinished++;
+		}
+
+	private:
+		Shared* mTarget;
+		S32 mCount;
+		bool mRelease;
+		LLAtomicS32& mFinished;
+	};
+
+	void run_threads(std::vector<LLThread*>& threads, LLAtomicS32& finished)
+	{
+		for (size_t i = 0; i < threads.size(); ++i)
+		{
+			threads[i]->start();
+		}
+		// isStopped() is also true before a thread gets going.
+		while (finished < (S32)threads.size())
+		{
+			ms_sleep(1);
+		}
+		for (size_t i = 0; i < threads.size(); ++i)
+		{
+			while (!threads[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+			delete threads[i];
+		}
+		threads.clear();
+	}
+}
+
+namespace tut
+{
+	struct refcount_data
+	{
+	};
+	typedef test_group<refcount_data> refcount_test;
+	typedef refcount_test::object refcount_object;
+	tut::refcount_test refcount("LLThreadSafeRefCount");
+
+	template<> template<>
+	void refcount_object::test<1>()
+	{
+		// Counts balance out after many concurrent copies.
+		LLAtomicS32 deletes(0);
+		LLAtomicS32 finished(0);
+		LLPointer<Shared> shared = new Shared(deletes);
+		std::vector<LLThread*> threads;
+		for (S32 i = 0; i < 4; ++i)
+		{
+			threads.push_back(new CopyThread(shared.get(), 100000, false, finished));
+		}
+		run_threads(threads, finished);
+
+		ensure_equals("one reference left", shared->getNumRefs(), 1);
+		ensure_equals("not deleted", (S32)deletes, 0);
+		shared = NULL;
+		ensure_equals("deleted once", (S32)deletes, 1);
+	}
+
+	template<> template<>
+	void refcount_object::test<2>()
+	{
+		// Whichever thread drops the last reference deletes the object,
+		// exactly once.
+		for (S32 round = 0; round < 20; ++round)
+		{
+			LLAtomicS32 deletes(0);
+			LLAtomicS32 finished(0);
+			Shared* shared = new Shared(deletes);
+			std::vector<LLThread*> threads;
+			for (S32 i = 0; i < 4; ++i)
+			{
+				shared->ref();
+				threads.push_back(new CopyThread(shared, 1000, true, finished));
+			}
+			run_threads(threads, finished);
+			ensure_equals("deleted once", (S32)deletes, 1);
+		}
+	}
+}
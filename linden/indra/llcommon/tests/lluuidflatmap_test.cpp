@@ -0,0 +1,207 @@
+/**
+ * @file lluuidflatmap_test.cpp
+ * @brief Tests for the LLUUID hash map and set.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include <map>
+#include <vector>
+
+#include "linden_common.h"
+
+#include "../lluuidflatmap.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Sequential IDs, the worst case for a hash of the raw bytes
+	LLUUID made_up_id(U32 n)
+	{
+		LLUUID id;
+		id.mData[12] = (U8)(n >> 24);
+		id.mData[13] = (U8)(n >> 16);
+		id.mData[14] = (U8)(n >> 8);
+		id.mData[15] = (U8)n;
+		return id;
+	}
+
+	// Counts live copies, to catch leaked or doubly destroyed values
+	struct Counted
+	{
+		static S32 sLive;
+		S32 mValue;
+
+		Counted(S32 value = 0) : mValue(value) { ++sLive; }
+		Counted(const Counted& other) : mValue(other.mValue) { ++sLive; }
+		~Counted() { --sLive; }
+	};
+	S32 Counted::sLive = 0;
+}
+
+namespace tut
+{
+	struct uuidflatmap_data
+	{
+	};
+	typedef test_group<uuidflatmap_data> uuidflatmap_test;
+	typedef uuidflatmap_test::object uuidflatmap_object;
+	tut::uuidflatmap_test uuidflatmap("LLUUIDFlatMap");
+
+	template<> template<>
+	void uuidflatmap_object::test<1>()
+	{
+		// Keeps the same contents as std::map through inserts, overwrites
+		// and erases, random and sequential keys alike, across growth and
+		// reuse of erased slots.
+		LLUUIDFlatMap<S32> flat;
+		std::map<LLUUID, S32> tree;
+		std::vector<LLUUID> ids;
+		for (U32 i = 0; i < 3000; ++i)
+		{
+			LLUUID id;
+			if (i % 2)
+			{
+				id.generate();
+			}
+			else
+			{
+				id = made_up_id(i);
+			}
+			ids.push_back(id);
+		}
+
+		for (U32 round = 0; round < 5; ++round)
+		{
+			for (U32 i = 0; i < ids.size(); ++i)
+			{
+				if ((i + round) % 3 == 0)
+				{
+					ensure_equals("erase", flat.erase(ids[i]), tree.erase(ids[i]));
+				}
+				else
+				{
+					flat[ids[i]] = i + round;
+					tree[ids[i]] = i + round;
+				}
+			}
+			ensure_equals("size", flat.size(), tree.size());
+			for (U32 i = 0; i < ids.size(); ++i)
+			{
+				std::map<LLUUID, S32>::iterator expected = tree.find(ids[i]);
+				LLUUIDFlatMap<S32>::iterator found = flat.find(ids[i]);
+				ensure_equals("found", found != flat.end(), expected != tree.end());
+				if (expected != tree.end())
+				{
+					ensure_equals("key", found->first, ids[i]);
+					ensure_equals("value", found->second, expected->second);
+				}
+			}
+		}
+
+		LLUUID missing;
+		missing.generate();
+		ensure("missing", flat.find(missing) == flat.end());
+		ensure_equals("count", flat.count(missing), (size_t)0);
+		ensure("insert existing", !flat.insert(std::make_pair(ids[1], 7)).second);
+	}
+
+	template<> template<>
+	void uuidflatmap_object::test<2>()
+	{
+		// Iteration visits everything once, and erasing behind the iterator
+		// doesn't disturb it.  Values are destroyed exactly once.
+		{
+			LLUUIDFlatMap<Counted> flat;
+			for (U32 i = 0; i < 500; ++i)
+			{
+				flat[made_up_id(i)] = Counted(i);
+			}
+			ensure_equals("live values", Counted::sLive, 500);
+
+			LLUUIDFlatMap<Counted> copy(flat);
+			ensure_equals("copied", Counted::sLive, 1000);
+
+			S32 seen = 0;
+			for (LLUUIDFlatMap<Counted>::iterator it = flat.begin(); it != flat.end(); )
+			{
+				++seen;
+				if (it->second.mValue % 2)
+				{
+					flat.erase(it++);
+				}
+				else
+				{
+					++it;
+				}
+			}
+			ensure_equals("visited", seen, 500);
+			ensure_equals("kept", flat.size(), (size_t)250);
+			ensure_equals("live after erase", Counted::sLive, 750);
+
+			S32 total = 0;
+			for (LLUUIDFlatMap<Counted>::const_iterator it = copy.begin(); it != copy.end(); ++it)
+			{
+				total += it->second.mValue;
+			}
+			ensure_equals("copy intact", total, 499 * 500 / 2);
+
+			copy = flat;
+			ensure_equals("assigned", copy.size(), (size_t)250);
+			copy.clear();
+			ensure("cleared", copy.empty() && copy.begin() == copy.end());
+		}
+		ensure_equals("all destroyed", Counted::sLive, 0);
+	}
+
+	template<> template<>
+	void uuidflatmap_object::test<3>()
+	{
+		// Sets, and round-robin walks by slot
+		LLUUIDFlatSet set;
+		for (U32 i = 0; i < 100; ++i)
+		{
+			ensure("new", set.insert(made_up_id(i)).second);
+		}
+		ensure("duplicate", !set.insert(made_up_id(5)).second);
+		ensure_equals("set size", set.size(), (size_t)100);
+
+		size_t slot = 0;
+		std::map<LLUUID, S32> visits;
+		for (U32 i = 0; i < 250; ++i)
+		{
+			LLUUIDFlatSet::iterator it = set.fromSlot(slot);
+			if (it == set.end())
+			{
+				it = set.begin();
+			}
+			++visits[*it];
+			slot = set.slotOf(it) + 1;
+		}
+		ensure_equals("walked all", visits.size(), (size_t)100);
+		for (std::map<LLUUID, S32>::iterator it = visits.begin(); it != visits.end(); ++it)
+		{
+			ensure("evenly", it->second == 2 || it->second == 3);
+		}
+	}
+}
@@ -0,0 +1,127 @@
+/**
+ * @file llworkpool_test.cpp
+ * @brief Tests for the fork/join work pool.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llworkpool.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Counts how many times each index was visited.
+	class CountTask : public LLWorkPool::Task
+	{
+	public:
+		CountTask(S32 count) : mHits(count, 0) {}
+
+		/*virtual*/ void run(S32 index)
+		{
+			mHits[index]++;
+		}
+
+		std::vector<S32> mHits;
+	};
+
+	// Issues a nested parallelFor() from inside every iteration.
+	class NestedTask : public LLWorkPool::Task
+	{
+	public:
+		NestedTask(LLWorkPool& pool, S32 count, S32 inner)
+			: mPool(pool), mInner(inner), mTotals(count, 0) {}
+
+		/*virtual*/ void run(S32 index)
+		{
+			CountTask inner(mInner);
+			mPool.parallelFor(inner, mInner);
+			S32 total = 0;
+			for (S32 i = 0; i < mInner; ++i)
+			{
+				total += inner.mHits[i];
+			}
+			mTotals[index] = total;
+		}
+
+		LLWorkPool& mPool;
+		S32 mInner;
+		std::vector<S32> mTotals;
+	};
+}
+
+namespace tut
+{
+	struct workpool_data
+	{
+	};
+	typedef test_group<workpool_data> workpool_test;
+	typedef workpool_test::object workpool_object;
+	tut::workpool_test workpool("LLWorkPool");
+
+	template<> template<>
+	void workpool_object::test<1>()
+	{
+		// A pool without threads still runs every index, inline.
+		LLWorkPool pool("test pool", 0);
+		ensure_equals("no threads", pool.getNumThreads(), 0);
+
+		CountTask task(100);
+		pool.parallelFor(task, 100);
+		for (S32 i = 0; i < 100; ++i)
+		{
+			ensure_equals("index visited once", task.mHits[i], 1);
+		}
+	}
+
+	template<> template<>
+	void workpool_object::test<2>()
+	{
+		// Every index is visited exactly once, over several rounds.
+		LLWorkPool pool("test pool", 4);
+		for (S32 round = 0; round < 50; ++round)
+		{
+			const S32 count = 1 + round * 37;
+			CountTask task(count);
+			pool.parallelFor(task, count);
+			for (S32 i = 0; i < count; ++i)
+			{
+				ensure_equals("index visited once", task.mHits[i], 1);
+			}
+		}
+	}
+
+	template<> template<>
+	void workpool_object::test<3>()
+	{
+		// Nested loops fall back to running on the calling thread.
+		LLWorkPool pool("test pool", 3);
+		NestedTask task(pool, 64, 16);
+		pool.parallelFor(task, 64);
+		for (S32 i = 0; i < 64; ++i)
+		{
+			ensure_equals("inner loop complete", task.mTotals[i], 16);
+		}
+	}
+}
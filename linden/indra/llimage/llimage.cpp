@@ -51,7 +51,7 @@ LLMutex* LLImage::sMutex = NULL;
 //static
 void LLImage::initClass()
 {
-	sMutex = new LLMutex(NULL);
+	sMutex = new LLMutex(NULL, "LLImage::sMutex");
 	LLImageJ2C::openDSO();
 }
 
@@ -89,7 +89,7 @@ LLImageBase::LLImageBase()
 	  mComponents(0),
 	  mBadBufferAllocation(false),
 	  mAllowOverSize(false),
-	  mMemType(LLMemType::MTYPE_IMAGEBASE)
+	  mMemType(&LLMemType::MTYPE_IMAGEBASE)
 {
 }
 
@@ -132,7 +132,7 @@ void LLImageBase::sanityCheck()
 // virtual
 void LLImageBase::deleteData()
 {
-	delete[] mData;
+	deleteMemory(mData);
 	mData = NULL;
 	mDataSize = 0;
 }
@@ -140,7 +140,7 @@ void LLImageBase::deleteData()
 // virtual
 U8* LLImageBase::allocateData(S32 size)
 {
-	LLMemType mt1(mMemType);
+	LLMemType mt1(*mMemType);
 	
 	if (size < 0)
 	{
@@ -169,7 +169,7 @@ U8* LLImageBase::allocateData(S32 size)
 	{
 		deleteData(); // virtual
 		mBadBufferAllocation = false ;
-		mData = new U8[size];
+		mData = allocateMemory(size, *mMemType);
 		if (!mData)
 		{
 			llwarns << "allocate image data: " << size << llendl;
@@ -186,8 +186,8 @@ U8* LLImageBase::allocateData(S32 size)
 // virtual
 U8* LLImageBase::reallocateData(S32 size)
 {
-	LLMemType mt1(mMemType);
-	U8 *new_datap = new U8[size];
+	LLMemType mt1(*mMemType);
+	U8 *new_datap = allocateMemory(size, *mMemType);
 	if (!new_datap)
 	{
 		llwarns << "Out of memory in LLImageBase::reallocateData" << llendl;
@@ -197,7 +197,7 @@ U8* LLImageBase::reallocateData(S32 size)
 	{
 		S32 bytes = llmin(mDataSize, size);
 		memcpy(new_datap, mData, bytes);	/* Flawfinder: ignore */
-		delete[] mData;
+		deleteMemory(mData);
 	}
 	mData = new_datap;
 	mDataSize = size;
@@ -252,14 +252,14 @@ S32 LLImageRaw::sRawImageCount = 0;
 LLImageRaw::LLImageRaw()
 	: LLImageBase()
 {
-	mMemType = LLMemType::MTYPE_IMAGERAW;
+	mMemType = &LLMemType::MTYPE_IMAGERAW;
 	++sRawImageCount;
 }
 
 LLImageRaw::LLImageRaw(U16 width, U16 height, S8 components)
 	: LLImageBase()
 {
-	mMemType = LLMemType::MTYPE_IMAGERAW;
+	mMemType = &LLMemType::MTYPE_IMAGERAW;
 	//llassert( S32(width) * S32(height) * S32(components) <= MAX_IMAGE_DATA_SIZE );
 	allocateDataSize(width, height, components);
 	++sRawImageCount;
@@ -268,7 +268,7 @@ LLImageRaw::LLImageRaw(U16 width, U16 height, S8 components)
 LLImageRaw::LLImageRaw(U8 *data, U16 width, U16 height, S8 components)
 	: LLImageBase()
 {
-	mMemType = LLMemType::MTYPE_IMAGERAW;
+	mMemType = &LLMemType::MTYPE_IMAGERAW;
 	if(allocateDataSize(width, height, components))
 	{
 		memcpy(getData(), data, width*height*components);
@@ -345,7 +345,7 @@ BOOL LLImageRaw::resize(U16 width, U16 height, S8 components)
 
 U8 * LLImageRaw::getSubImage(U32 x_pos, U32 y_pos, U32 width, U32 height) const
 {
-	LLMemType mt1(mMemType);
+	LLMemType mt1(*mMemType);
 	U8 *data = new U8[width*height*getComponents()];
 
 	// Should do some simple bounds checking
@@ -428,7 +428,7 @@ void LLImageRaw::clear(U8 r, U8 g, U8 b, U8 a)
 // Reverses the order of the rows in the image
 void LLImageRaw::verticalFlip()
 {
-	LLMemType mt1(mMemType);
+	LLMemType mt1(*mMemType);
 	S32 row_bytes = getWidth() * getComponents();
 	llassert(row_bytes > 0);
 	std::vector<U8> line_buffer(row_bytes);
@@ -561,7 +561,7 @@ void LLImageRaw::composite( LLImageRaw* src )
 // Src and dst can be any size.  Src has 4 components.  Dst has 3 components.
 void LLImageRaw::compositeScaled4onto3(LLImageRaw* src)
 {
-	LLMemType mt1(mMemType);
+	LLMemType mt1(*mMemType);
 	llinfos << "compositeScaled4onto3" << llendl;
 
 	LLImageRaw* dst = this;  // Just for clarity.
@@ -803,7 +803,7 @@ void LLImageRaw::copyUnscaled3onto4( LLImageRaw* src )
 // Src and dst can be any size.  Src and dst have same number of components.
 void LLImageRaw::copyScaled( LLImageRaw* src )
 {
-	LLMemType mt1(mMemType);
+	LLMemType mt1(*mMemType);
 	LLImageRaw* dst = this;  // Just for clarity.
 
 	llassert_always( (1 == src->getComponents()) || (3 == src->getComponents()) || (4 == src->getComponents()) );
@@ -835,7 +835,7 @@ void LLImageRaw::copyScaled( LLImageRaw* src )
 //scale down image by not blending a pixel with its neighbors.
 BOOL LLImageRaw::scaleDownWithoutBlending( S32 new_width, S32 new_height)
 {
-	LLMemType mt1(mMemType);
+	LLMemType mt1(*mMemType);
 
 	S8 c = getComponents() ;
 	llassert((1 == c) || (3 == c) || (4 == c) );
@@ -855,7 +855,7 @@ BOOL LLImageRaw::scaleDownWithoutBlending( S32 new_width, S32 new_height)
 	ratio_x -= 1.0f ;
 	ratio_y -= 1.0f ;
 
-	U8* new_data = new U8[new_data_size] ;
+	U8* new_data = allocateMemory(new_data_size, *mMemType) ;
 	llassert_always(new_data != NULL) ;
 
 	U8* old_data = getData() ;
@@ -880,7 +880,7 @@ BOOL LLImageRaw::scaleDownWithoutBlending( S32 new_width, S32 new_height)
 
 BOOL LLImageRaw::scale( S32 new_width, S32 new_height, BOOL scale_image_data )
 {
-	LLMemType mt1(mMemType);
+	LLMemType mt1(*mMemType);
 	llassert((1 == getComponents()) || (3 == getComponents()) || (4 == getComponents()) );
 
 	S32 old_width = getWidth();
@@ -1330,7 +1330,7 @@ LLImageFormatted::LLImageFormatted(S8 codec)
 	  mDecoded(0),
 	  mDiscardLevel(-1)
 {
-	mMemType = LLMemType::MTYPE_IMAGEFORMATTED;
+	mMemType = &LLMemType::MTYPE_IMAGEFORMATTED;
 }
 
 // virtual
@@ -1547,7 +1547,7 @@ void LLImageFormatted::appendData(U8 *data, S32 size)
 			S32 newsize = cursize + size;
 			reallocateData(newsize);
 			memcpy(getData() + cursize, data, size);
-			delete[] data;
+			deleteMemory(data);
 		}
 	}
 }
@@ -32,6 +32,7 @@
 //#include "llmemory.h"
 #include "llthread.h"
 #include "llmemtype.h"
+#include "llmempool.h"
 
 const S32 MIN_IMAGE_MIP =  2; // 4x4, only used for expand/contract power of 2
 const S32 MAX_IMAGE_MIP = 11; // 2048x2048
@@ -137,6 +138,15 @@ public:
 	static F32 calc_download_priority(F32 virtual_size, F32 visible_area, S32 bytes_sent);
 
 	static EImageCodec getCodecFromExtension(const std::string& exten);
+
+	// Image data comes from LLMemPool.  Buffers an image is handed to own
+	// (LLImageFormatted::setData() and appendData(), LLImageRaw::setDataAndSize())
+	// must be allocated here, and are freed with deleteMemory().
+	static U8* allocateMemory(S32 size, const LLMemType::DeclareMemType& mem_type = LLMemType::MTYPE_IMAGEBASE)
+	{
+		return (U8*)LLMemPool::allocate(size, mem_type);
+	}
+	static void deleteMemory(U8* data)	{ LLMemPool::deallocate(data); }
 	
 private:
 	U8 *mData;
@@ -150,7 +160,7 @@ private:
 	bool mBadBufferAllocation ;
 	bool mAllowOverSize ;
 public:
-	LLMemType::DeclareMemType& mMemType; // debug
+	LLMemType::DeclareMemType* mMemType; // debug
 };
 
 // Raw representation of an image (used for textures, and other uncompressed formats
@@ -27,6 +27,10 @@
 
 #include "llimagedxt.h"
 
+#include "llv4math.h"
+
+#include <algorithm>
+
 //static
 void LLImageDXT::checkMinWidthHeight(EFileFormat format, S32& width, S32& height)
 {
@@ -262,6 +266,23 @@ BOOL LLImageDXT::decode(LLImageRaw* raw_image, F32 time)
 	//  but we don't use it any more!
 	llassert_always(raw_image);
 	
+	if (mFileFormat == FORMAT_DXR1 || mFileFormat == FORMAT_DXR5)
+	{
+		// what encodeCompressed() writes
+		S32 discard = llmax((S32)mDiscardLevel, 0);
+		S32 width = llmax(getWidth() >> discard, 1);
+		S32 height = llmax(getHeight() >> discard, 1);
+		U8* data = getData() + getMipOffset(discard);
+		if ((!getData()) || (data + formatBytes(mFileFormat, width, height) > getData() + getDataSize()))
+		{
+			setLastError("LLImageDXT trying to decode an image with not enough data!");
+			return FALSE;
+		}
+		S32 ncomponents = formatComponents(mFileFormat);
+		raw_image->resize(width, height, ncomponents);
+		decompressLevel(data, raw_image->getData(), width, height, ncomponents, mFileFormat);
+		return TRUE;
+	}
 	if (mFileFormat >= FORMAT_DXT1 && mFileFormat <= FORMAT_DXR5)
 	{
 		llwarns << "Attempt to decode compressed LLImageDXT to Raw (unsupported)" << llendl;
@@ -403,6 +424,73 @@ BOOL LLImageDXT::encode(const LLImageRaw* raw_image, F32 time)
 	return encodeDXT(raw_image, time, false);
 }
 
+BOOL LLImageDXT::encodeCompressed(const LLImageRaw* raw_image, S32 full_width, S32 full_height, S32 discard_level)
+{
+	llassert_always(raw_image);
+
+	S32 ncomponents = raw_image->getComponents();
+	EFileFormat format;
+	switch (ncomponents)
+	{
+	  case 3:
+		format = FORMAT_DXR1;
+		break;
+	  case 4:
+		format = FORMAT_DXR5;
+		break;
+	  default:
+		return FALSE;
+	}
+
+	// whole blocks at the top level, and halving all the way down
+	S32 width = raw_image->getWidth();
+	S32 height = raw_image->getHeight();
+	if (discard_level < 0 || discard_level > MAX_IMAGE_MIP ||
+		width < 4 || height < 4 || (width & (width - 1)) || (height & (height - 1)) ||
+		(width << discard_level) != full_width || (height << discard_level) != full_height)
+	{
+		return FALSE;
+	}
+
+	setSize(full_width, full_height, ncomponents);
+	mHeaderSize = sizeof(dxtfile_header_t);
+	mFileFormat = format;
+
+	S32 nmips = calcNumMips(full_width, full_height);
+	allocateData(getMipOffset(discard_level) + formatBytes(format, width, height));
+
+	U8* data = getData();
+	dxtfile_header_t* header = (dxtfile_header_t*)data;
+	memset(header, 0, mHeaderSize);
+	header->fourcc = 0x20534444;
+	header->pixel_fmt.fourcc = getFourCC(format);
+	header->num_mips = nmips;
+	header->maxwidth = full_width;
+	header->maxheight = full_height;
+
+	// each mip is made from the one above it, alternating between two buffers
+	std::vector<U8> mips[2];
+	const U8* mipdata = raw_image->getData();
+	S32 w = width;
+	S32 h = height;
+	for (S32 mip = discard_level; mip < nmips; mip++)
+	{
+		compressLevel(mipdata, data + getMipOffset(mip), w, h, ncomponents, format);
+		if (mip + 1 < nmips)
+		{
+			w >>= 1;
+			h >>= 1;
+			std::vector<U8>& next = mips[mip & 1];
+			next.resize(w * h * ncomponents);
+			generateMip(mipdata, &next[0], w, h, ncomponents);
+			mipdata = &next[0];
+		}
+	}
+
+	setDiscardLevel(discard_level);
+	return TRUE;
+}
+
 // virtual
 bool LLImageDXT::convertToDXR()
 {
@@ -429,7 +517,7 @@ bool LLImageDXT::convertToDXR()
 	S32 nmips = calcNumMips(width,height);
 	S32 total_bytes = getDataSize();
 	U8* olddata = getData();
-	U8* newdata = new U8[total_bytes];
+	U8* newdata = allocateMemory(total_bytes, *mMemType);
 	if (!newdata)
 	{
 		llerrs << "Out of memory in LLImageDXT::convertToDXR()" << llendl;
@@ -503,3 +591,375 @@ void LLImageDXT::extractMip(const U8 *indata, U8* mipdata, int width, int height
 }
 
 //============================================================================
+// Block compression
+//
+// Endpoints are opposite corners of the block's bounding box, pulled in by
+// a sixteenth of its size, and every pixel takes the nearest palette entry.
+// That is a long way short of an offline compressor, but cheap enough to
+// run on everything the decoder finishes.
+
+static inline U16 pack_565(const S32* color)
+{
+	S32 r = (color[0] * 31 + 127) / 255;
+	S32 g = (color[1] * 63 + 127) / 255;
+	S32 b = (color[2] * 31 + 127) / 255;
+	return (U16)((r << 11) | (g << 5) | b);
+}
+
+static inline void unpack_565(U16 packed, S32* color)
+{
+	S32 r = (packed >> 11) & 0x1f;
+	S32 g = (packed >> 5) & 0x3f;
+	S32 b = packed & 0x1f;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+// Copies the 4x4 block at x, y out as RGBA
+static void get_block(const U8* data, S32 width, S32 height, S32 ncomponents, S32 x, S32 y, U8* block)
+{
+	for (S32 j = 0; j < 4; j++)
+	{
+		const U8* row = data + llmin(y + j, height - 1) * width * ncomponents;
+		for (S32 i = 0; i < 4; i++)
+		{
+			const U8* pixel = row + llmin(x + i, width - 1) * ncomponents;
+			U8* out = block + (j * 4 + i) * 4;
+			out[0] = pixel[0];
+			out[1] = pixel[1];
+			out[2] = pixel[2];
+			out[3] = ncomponents == 4 ? pixel[3] : 255;
+		}
+	}
+}
+
+// Copies the part of the block that's inside the image back out
+static void put_block(const U8* block, S32 width, S32 height, S32 ncomponents, S32 x, S32 y, U8* data)
+{
+	S32 rows = llmin(4, height - y);
+	S32 cols = llmin(4, width - x);
+	for (S32 j = 0; j < rows; j++)
+	{
+		U8* row = data + ((y + j) * width + x) * ncomponents;
+		for (S32 i = 0; i < cols; i++)
+		{
+			memcpy(row + i * ncomponents, block + (j * 4 + i) * 4, ncomponents);	/* Flawfinder: ignore */
+		}
+	}
+}
+
+// Index of the nearest of the four palette colors, per pixel
+static void nearest_color(const U8* block, const F32 palette[4][3], F32* nearest)
+{
+	F32 red[16], green[16], blue[16];
+	for (S32 i = 0; i < 16; i++)
+	{
+		red[i] = block[i * 4];
+		green[i] = block[i * 4 + 1];
+		blue[i] = block[i * 4 + 2];
+	}
+
+#if LL_VECTORIZE
+	for (S32 i = 0; i < 16; i += 4)
+	{
+		__m128 r = _mm_loadu_ps(red + i);
+		__m128 g = _mm_loadu_ps(green + i);
+		__m128 b = _mm_loadu_ps(blue + i);
+		__m128 best = _mm_set1_ps(F32_MAX);
+		__m128 index = _mm_setzero_ps();
+		for (S32 k = 0; k < 4; k++)
+		{
+			__m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k][0]));
+			__m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[k][1]));
+			__m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k][2]));
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+			__m128 closer = _mm_cmplt_ps(dist, best);
+			best = _mm_min_ps(dist, best);
+			index = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps((F32)k)), _mm_andnot_ps(closer, index));
+		}
+		_mm_storeu_ps(nearest + i, index);
+	}
+#else
+	for (S32 i = 0; i < 16; i++)
+	{
+		F32 best = F32_MAX;
+		nearest[i] = 0.f;
+		for (S32 k = 0; k < 4; k++)
+		{
+			F32 dr = red[i] - palette[k][0];
+			F32 dg = green[i] - palette[k][1];
+			F32 db = blue[i] - palette[k][2];
+			F32 dist = dr * dr + dg * dg + db * db;
+			if (dist < best)
+			{
+				best = dist;
+				nearest[i] = (F32)k;
+			}
+		}
+	}
+#endif
+}
+
+static void compress_color_block(const U8* block, U8* out)
+{
+	S32 lo[3] = { 255, 255, 255 };
+	S32 hi[3] = { 0, 0, 0 };
+	for (S32 i = 0; i < 16; i++)
+	{
+		for (S32 c = 0; c < 3; c++)
+		{
+			lo[c] = llmin(lo[c], (S32)block[i * 4 + c]);
+			hi[c] = llmax(hi[c], (S32)block[i * 4 + c]);
+		}
+	}
+
+	// The box has four diagonals.  Take the one the colors actually run
+	// along: a channel falling as the widest one rises runs the other way,
+	// e.g. red next to blue is not black to magenta.
+	S32 major = 0;
+	for (S32 c = 1; c < 3; c++)
+	{
+		if (hi[c] - lo[c] > hi[major] - lo[major])
+		{
+			major = c;
+		}
+	}
+	S32 mean[3] = { 0, 0, 0 };
+	for (S32 i = 0; i < 16; i++)
+	{
+		for (S32 c = 0; c < 3; c++)
+		{
+			mean[c] += block[i * 4 + c];
+		}
+	}
+	for (S32 c = 0; c < 3; c++)
+	{
+		if (c == major)
+		{
+			continue;
+		}
+		S32 covariance = 0;
+		for (S32 i = 0; i < 16; i++)
+		{
+			covariance += (block[i * 4 + major] * 16 - mean[major]) * (block[i * 4 + c] * 16 - mean[c]);
+		}
+		if (covariance < 0)
+		{
+			std::swap(lo[c], hi[c]);
+		}
+	}
+
+	for (S32 c = 0; c < 3; c++)
+	{
+		S32 inset = (hi[c] - lo[c]) / 16;
+		lo[c] += inset;
+		hi[c] -= inset;
+	}
+
+	// c0 > c1 keeps the block out of the three color mode
+	U16 c0 = pack_565(hi);
+	U16 c1 = pack_565(lo);
+	if (c0 < c1)
+	{
+		std::swap(c0, c1);
+	}
+	U32 indices = 0;
+	if (c0 != c1)
+	{
+		S32 end0[3], end1[3];
+		unpack_565(c0, end0);
+		unpack_565(c1, end1);
+		F32 palette[4][3];
+		for (S32 c = 0; c < 3; c++)
+		{
+			palette[0][c] = (F32)end0[c];
+			palette[1][c] = (F32)end1[c];
+			palette[2][c] = (2.f * end0[c] + end1[c]) / 3.f;
+			palette[3][c] = (end0[c] + 2.f * end1[c]) / 3.f;
+		}
+		F32 nearest[16];
+		nearest_color(block, palette, nearest);
+		for (S32 i = 0; i < 16; i++)
+		{
+			indices |= (U32)nearest[i] << (2 * i);
+		}
+	}
+
+	out[0] = (U8)(c0 & 0xff);
+	out[1] = (U8)(c0 >> 8);
+	out[2] = (U8)(c1 & 0xff);
+	out[3] = (U8)(c1 >> 8);
+	for (S32 i = 0; i < 4; i++)
+	{
+		out[4 + i] = (U8)(indices >> (8 * i));
+	}
+}
+
+static void compress_alpha_block(const U8* block, U8* out)
+{
+	S32 lo = 255;
+	S32 hi = 0;
+	for (S32 i = 0; i < 16; i++)
+	{
+		lo = llmin(lo, (S32)block[i * 4 + 3]);
+		hi = llmax(hi, (S32)block[i * 4 + 3]);
+	}
+
+	U64 indices = 0;
+	if (hi != lo)
+	{
+		// a0 > a1 picks the eight step ramp: index 0 is a0, 1 is a1 and
+		// 2-7 step from a0 down towards a1
+		static const U8 step_to_index[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+		const F32 scale = 7.f / (F32)(hi - lo);
+		F32 steps[16];
+#if LL_VECTORIZE
+		F32 alpha[16];
+		for (S32 i = 0; i < 16; i++)
+		{
+			alpha[i] = block[i * 4 + 3];
+		}
+		const __m128 vlo = _mm_set1_ps((F32)lo);
+		const __m128 vscale = _mm_set1_ps(scale);
+		const __m128 half = _mm_set1_ps(0.5f);
+		for (S32 i = 0; i < 16; i += 4)
+		{
+			__m128 a = _mm_loadu_ps(alpha + i);
+			_mm_storeu_ps(steps + i, _mm_add_ps(_mm_mul_ps(_mm_sub_ps(a, vlo), vscale), half));
+		}
+#else
+		for (S32 i = 0; i < 16; i++)
+		{
+			steps[i] = (block[i * 4 + 3] - lo) * scale + 0.5f;
+		}
+#endif
+		for (S32 i = 0; i < 16; i++)
+		{
+			indices |= (U64)step_to_index[llclamp((S32)steps[i], 0, 7)] << (3 * i);
+		}
+	}
+
+	out[0] = (U8)hi;
+	out[1] = (U8)lo;
+	for (S32 i = 0; i < 6; i++)
+	{
+		out[2 + i] = (U8)(indices >> (8 * i));
+	}
+}
+
+static void decompress_color_block(const U8* in, BOOL four_color, U8* block)
+{
+	U16 c0 = in[0] | (in[1] << 8);
+	U16 c1 = in[2] | (in[3] << 8);
+	S32 palette[4][4];
+	unpack_565(c0, palette[0]);
+	unpack_565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+	for (S32 c = 0; c < 3; c++)
+	{
+		if (four_color || c0 > c1)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+			palette[3][3] = 0;
+		}
+	}
+
+	U32 indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((U32)in[7] << 24);
+	for (S32 i = 0; i < 16; i++)
+	{
+		const S32* color = palette[(indices >> (2 * i)) & 3];
+		for (S32 c = 0; c < 4; c++)
+		{
+			block[i * 4 + c] = (U8)color[c];
+		}
+	}
+}
+
+static void decompress_alpha_block(const U8* in, U8* block)
+{
+	S32 a0 = in[0];
+	S32 a1 = in[1];
+	S32 palette[8];
+	palette[0] = a0;
+	palette[1] = a1;
+	if (a0 > a1)
+	{
+		for (S32 i = 2; i < 8; i++)
+		{
+			palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+		}
+	}
+	else
+	{
+		for (S32 i = 2; i < 6; i++)
+		{
+			palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	U64 indices = 0;
+	for (S32 i = 0; i < 6; i++)
+	{
+		indices |= (U64)in[2 + i] << (8 * i);
+	}
+	for (S32 i = 0; i < 16; i++)
+	{
+		block[i * 4 + 3] = (U8)palette[(indices >> (3 * i)) & 7];
+	}
+}
+
+//static
+void LLImageDXT::compressLevel(const U8* indata, U8* outdata, S32 width, S32 height, S32 ncomponents, EFileFormat format)
+{
+	U8 block[64];
+	for (S32 y = 0; y < height; y += 4)
+	{
+		for (S32 x = 0; x < width; x += 4)
+		{
+			get_block(indata, width, height, ncomponents, x, y, block);
+			if (format == FORMAT_DXR5)
+			{
+				compress_alpha_block(block, outdata);
+				outdata += 8;
+			}
+			compress_color_block(block, outdata);
+			outdata += 8;
+		}
+	}
+}
+
+//static
+void LLImageDXT::decompressLevel(const U8* indata, U8* outdata, S32 width, S32 height, S32 ncomponents, EFileFormat format)
+{
+	U8 block[64];
+	for (S32 y = 0; y < height; y += 4)
+	{
+		for (S32 x = 0; x < width; x += 4)
+		{
+			if (format == FORMAT_DXR5)
+			{
+				// color is always four entries when there's an alpha block
+				decompress_color_block(indata + 8, TRUE, block);
+				decompress_alpha_block(indata, block);
+				indata += 16;
+			}
+			else
+			{
+				decompress_color_block(indata, FALSE, block);
+				indata += 8;
+			}
+			put_block(block, width, height, ncomponents, x, y, outdata);
+		}
+	}
+}
+
+//============================================================================
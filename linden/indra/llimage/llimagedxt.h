@@ -104,6 +104,11 @@ public:
 	/*virtual*/ BOOL decode(LLImageRaw* raw_image, F32 decode_time);
 	/*virtual*/ BOOL encode(const LLImageRaw* raw_image, F32 encode_time);
 
+	// Block compresses raw_image, which is the full_width x full_height image
+	// at discard_level, to DXR1 (RGB) or DXR5 (RGBA).  Only that level and the
+	// smaller ones are stored, so the result reads back at discard_level.
+	BOOL encodeCompressed(const LLImageRaw* raw_image, S32 full_width, S32 full_height, S32 discard_level);
+
 	/*virtual*/ S32 calcHeaderSize();
 	/*virtual*/ S32 calcDataSize(S32 discard_level = 0);
 
@@ -132,6 +137,10 @@ public:
 private:
 	static void extractMip(const U8 *indata, U8* mipdata, int width, int height,
 						   int mip_width, int mip_height, EFileFormat format);
+
+	// One level, in 4x4 blocks; edge blocks repeat the last row and column
+	static void compressLevel(const U8* indata, U8* outdata, S32 width, S32 height, S32 ncomponents, EFileFormat format);
+	static void decompressLevel(const U8* indata, U8* outdata, S32 width, S32 height, S32 ncomponents, EFileFormat format);
 	
 private:
 	EFileFormat mFileFormat;
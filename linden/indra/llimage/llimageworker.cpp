@@ -27,15 +27,17 @@
 #include "linden_common.h"
 
 #include "llimageworker.h"
+#include "llfasttimer.h"
 #include "llimagedxt.h"
+#include "llimagej2c.h"
 
 //----------------------------------------------------------------------------
 
 // MAIN THREAD
-LLImageDecodeThread::LLImageDecodeThread(bool threaded)
-	: LLQueuedThread("imagedecode", threaded)
+LLImageDecodeThread::LLImageDecodeThread(bool threaded, LLTaskScheduler* scheduler)
+	: LLQueuedThread("imagedecode", threaded, scheduler)
 {
-	mCreationMutex = new LLMutex(getAPRPool());
+	mCreationMutex = new LLMutex(getAPRPool(), "LLImageDecodeThread::mCreationMutex");
 }
 
 // MAIN THREAD
@@ -71,6 +73,19 @@ LLImageDecodeThread::handle_t LLImageDecodeThread::decodeImage(LLImageFormatted*
 	return handle;
 }
 
+LLImageDecodeThread::handle_t LLImageDecodeThread::encodeImage(LLImageRaw* raw, LLImageJ2C* image,
+	const std::string& comment, U32 priority, EncodeResponder* responder)
+{
+	// Only ever called from the main thread, so no need to go through mCreationList
+	handle_t handle = generateHandle();
+	EncodeRequest* req = new EncodeRequest(handle, raw, image, comment, priority, responder);
+	if (!addRequest(req))
+	{
+		llerrs << "request added after LLLFSThread::cleanupClass()" << llendl;
+	}
+	return handle;
+}
+
 // Used by unit test only
 // Returns the size of the mutex guarded list as an indication of sanity
 S32 LLImageDecodeThread::tut_size()
@@ -109,9 +124,12 @@ LLImageDecodeThread::ImageRequest::~ImageRequest()
 //----------------------------------------------------------------------------
 
 
+static LLFastTimer::DeclareTimer FTM_IMAGE_DECODE("Image Decode");
+
 // Returns true when done, whether or not decode was successful.
 bool LLImageDecodeThread::ImageRequest::processRequest()
 {
+	LLFastTimer t(FTM_IMAGE_DECODE);
 	const F32 decode_time_slice = .1f;
 	bool done = true;
 	if (!mDecodedRaw && mFormattedImage.notNull())
@@ -171,3 +189,46 @@ bool LLImageDecodeThread::ImageRequest::tut_isOK()
 {
 	return mResponder.notNull();
 }
+
+//----------------------------------------------------------------------------
+
+LLImageDecodeThread::EncodeResponder::~EncodeResponder()
+{
+}
+
+LLImageDecodeThread::EncodeRequest::EncodeRequest(handle_t handle, LLImageRaw* raw, LLImageJ2C* image,
+												  const std::string& comment, U32 priority,
+												  LLImageDecodeThread::EncodeResponder* responder)
+	: LLQueuedThread::QueuedRequest(handle, priority, FLAG_AUTO_COMPLETE),
+	  mRawImage(raw),
+	  mComment(comment),
+	  mFormattedImage(image),
+	  mEncoded(FALSE),
+	  mResponder(responder)
+{
+}
+
+LLImageDecodeThread::EncodeRequest::~EncodeRequest()
+{
+	mRawImage = NULL;
+	mFormattedImage = NULL;
+}
+
+// Returns true when done, whether or not encode was successful.
+bool LLImageDecodeThread::EncodeRequest::processRequest()
+{
+	if (mRawImage.notNull() && mFormattedImage.notNull())
+	{
+		mEncoded = mFormattedImage->encode(mRawImage, mComment.empty() ? NULL : mComment.c_str());
+	}
+	return true;
+}
+
+void LLImageDecodeThread::EncodeRequest::finishRequest(bool completed)
+{
+	if (mResponder.notNull())
+	{
+		mResponder->completed(completed && mEncoded, mFormattedImage);
+	}
+	// Will automatically be deleted
+}
@@ -31,6 +31,8 @@
 #include "llpointer.h"
 #include "llworkerthread.h"
 
+class LLImageJ2C;
+
 class LLImageDecodeThread : public LLQueuedThread
 {
 public:
@@ -70,12 +72,47 @@ public:
 		BOOL mDecodedAux;
 		LLPointer<LLImageDecodeThread::Responder> mResponder;
 	};
+
+	class EncodeResponder : public LLThreadSafeRefCount
+	{
+	protected:
+		virtual ~EncodeResponder();
+	public:
+		// Called from the decode thread
+		virtual void completed(bool success, LLImageJ2C* image) = 0;
+	};
+
+	class EncodeRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~EncodeRequest(); // use deleteRequest()
+
+	public:
+		EncodeRequest(handle_t handle, LLImageRaw* raw, LLImageJ2C* image,
+					  const std::string& comment, U32 priority,
+					  LLImageDecodeThread::EncodeResponder* responder);
+
+		/*virtual*/ bool processRequest();
+		/*virtual*/ void finishRequest(bool completed);
+
+	private:
+		// input
+		LLPointer<LLImageRaw> mRawImage;
+		std::string mComment;
+		// output
+		LLPointer<LLImageJ2C> mFormattedImage;
+		BOOL mEncoded;
+		LLPointer<LLImageDecodeThread::EncodeResponder> mResponder;
+	};
 	
 public:
-	LLImageDecodeThread(bool threaded = true);
+	LLImageDecodeThread(bool threaded = true, LLTaskScheduler* scheduler = NULL);
 	handle_t decodeImage(LLImageFormatted* image,
 						 U32 priority, S32 discard, BOOL needs_aux,
 						 Responder* responder);
+	// MAIN THREAD. Compresses raw into image on this thread instead of the caller's.
+	handle_t encodeImage(LLImageRaw* raw, LLImageJ2C* image, const std::string& comment,
+						 U32 priority, EncodeResponder* responder);
 	S32 update(U32 max_time_ms);
 
 	// Used by unit tests to check the consistency of the thread instance
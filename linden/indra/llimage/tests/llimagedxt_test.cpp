@@ -0,0 +1,248 @@
+/**
+ * @file llimagedxt_test.cpp
+ * @brief Tests for the block compressed LLImageDXT cache format.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+// Class to test
+#include "../llimagedxt.h"
+// Tut header
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// TUT
+// -------------------------------------------------------------------------------------------
+
+namespace tut
+{
+	// Test wrapper declarations
+	struct imagedxt_test
+	{
+		imagedxt_test()
+		{
+			// for the last error mutex, once
+			static bool initialized = false;
+			if (!initialized)
+			{
+				LLImage::initClass();
+				initialized = true;
+			}
+		}
+
+		// Opaque red and see-through blue.  The alpha block keeps both
+		// exactly; the color endpoints are pulled in a sixteenth and then
+		// rounded to 565, so a block of just the two comes back within
+		// COLOR_ERROR of them.  Anything on the wrong diagonal of the
+		// color box comes back as a purple well outside that.
+		enum { COLOR_ERROR = 20 };
+		static const U8* halfColor(bool first)
+		{
+			static const U8 red[4] = { 255, 0, 0, 255 };
+			static const U8 blue[4] = { 0, 0, 255, 0 };
+			return first ? red : blue;
+		}
+
+		// The image split in two along its longer side, so every level
+		// generateMip() makes from it is still two halves until it's 1x1.
+		static bool inFirstHalf(S32 x, S32 y, S32 width, S32 height)
+		{
+			return width >= height ? x < width / 2 : y < height / 2;
+		}
+
+		static LLPointer<LLImageRaw> makeHalves(S32 width, S32 height, S32 ncomponents)
+		{
+			LLPointer<LLImageRaw> raw = new LLImageRaw(width, height, ncomponents);
+			U8* data = raw->getData();
+			for (S32 y = 0; y < height; y++)
+			{
+				for (S32 x = 0; x < width; x++)
+				{
+					memcpy(data + (y * width + x) * ncomponents, halfColor(inFirstHalf(x, y, width, height)), ncomponents);	/* Flawfinder: ignore */
+				}
+			}
+			return raw;
+		}
+
+		static S32 levelBytes(LLImageDXT* image, S32 discard)
+		{
+			return LLImageDXT::formatBytes(image->getFileFormat(),
+										   llmax(image->getWidth() >> discard, 1),
+										   llmax(image->getHeight() >> discard, 1));
+		}
+
+		// Decodes every stored level and checks it against the halves.  The
+		// 1x1 level averages them.
+		void ensure_levels(const std::string& msg, LLImageDXT* image, S32 first_discard)
+		{
+			S32 ncomponents = image->getComponents();
+			S32 nmips = LLImageDXT::calcNumMips(image->getWidth(), image->getHeight());
+			for (S32 discard = first_discard; discard < nmips; discard++)
+			{
+				std::string level = msg + llformat(" discard %d", discard);
+				S32 width = llmax(image->getWidth() >> discard, 1);
+				S32 height = llmax(image->getHeight() >> discard, 1);
+				image->setDiscardLevel(discard);
+				LLPointer<LLImageRaw> raw = new LLImageRaw;
+				ensure(level + " decoded", image->decode(raw, 0.f));
+				ensure_equals(level + " width", (S32)raw->getWidth(), width);
+				ensure_equals(level + " height", (S32)raw->getHeight(), height);
+				ensure_equals(level + " components", (S32)raw->getComponents(), ncomponents);
+
+				const U8* data = raw->getData();
+				for (S32 y = 0; y < height; y++)
+				{
+					for (S32 x = 0; x < width; x++)
+					{
+						for (S32 c = 0; c < ncomponents; c++)
+						{
+							std::string texel = level + llformat(" texel %d,%d component %d", x, y, c);
+							S32 got = data[(y * width + x) * ncomponents + c];
+							S32 expected = halfColor(inFirstHalf(x, y, width, height))[c];
+							if (width == 1 && height == 1)
+							{
+								// a single color, only rounded to 565
+								expected = ((S32)halfColor(true)[c] + halfColor(false)[c]) / 2;
+								ensure(texel + llformat(" %d close to %d", got, expected), llabs(got - expected) <= 8);
+							}
+							else if (c == 3)
+							{
+								ensure_equals(texel, got, expected);
+							}
+							else
+							{
+								ensure(texel + llformat(" %d close to %d", got, expected), llabs(got - expected) <= COLOR_ERROR);
+							}
+						}
+					}
+				}
+			}
+		}
+	};
+
+	// Tut templating thingamagic: test group, object and test instance
+	typedef test_group<imagedxt_test> imagedxt_t;
+	typedef imagedxt_t::object imagedxt_object_t;
+	tut::imagedxt_t tut_imagedxt("LLImageDXT");
+
+	// The levels are laid out smallest first after the header, each
+	// formatBytes() long, with 4x4 the least a level takes up.
+	template<> template<>
+	void imagedxt_object_t::test<1>()
+	{
+		static const S32 sizes[][2] = { { 8, 8 }, { 16, 4 }, { 4, 16 }, { 32, 8 } };
+		for (S32 s = 0; s < (S32)LL_ARRAY_SIZE(sizes); s++)
+		{
+			for (S32 ncomponents = 3; ncomponents <= 4; ncomponents++)
+			{
+				S32 full_width = sizes[s][0];
+				S32 full_height = sizes[s][1];
+				S32 nmips = LLImageDXT::calcNumMips(full_width, full_height);
+				for (S32 first = 0; first < nmips && (full_width >> first) >= 4 && (full_height >> first) >= 4; first++)
+				{
+					std::string msg = llformat("%dx%dx%d from %d", full_width, full_height, ncomponents, first);
+					LLPointer<LLImageRaw> raw = makeHalves(full_width >> first, full_height >> first, ncomponents);
+					LLPointer<LLImageDXT> image = new LLImageDXT;
+					ensure(msg + " encoded", image->encodeCompressed(raw, full_width, full_height, first));
+					ensure_equals(msg + " format", image->getFileFormat(),
+								  ncomponents == 3 ? LLImageDXT::FORMAT_DXR1 : LLImageDXT::FORMAT_DXR5);
+					ensure_equals(msg + " discard", (S32)image->getDiscardLevel(), first);
+
+					S32 offset = image->calcHeaderSize();
+					ensure_equals(msg + " smallest first", image->getMipOffset(nmips - 1), offset);
+					for (S32 discard = nmips - 1; discard > first; discard--)
+					{
+						offset += levelBytes(image, discard);
+						ensure_equals(msg + llformat(" offset %d", discard - 1), image->getMipOffset(discard - 1), offset);
+					}
+					offset += levelBytes(image, first);
+					ensure_equals(msg + " data size", image->getDataSize(), offset);
+					ensure_equals(msg + " calculated size", image->calcDataSize(first), offset);
+				}
+			}
+		}
+		// 16 bytes a block with the alpha, 8 without, and at least a block
+		ensure_equals("DXR5 4x4", LLImageDXT::formatBytes(LLImageDXT::FORMAT_DXR5, 4, 4), 16);
+		ensure_equals("DXR1 8x4", LLImageDXT::formatBytes(LLImageDXT::FORMAT_DXR1, 8, 4), 16);
+		ensure_equals("DXR1 2x1", LLImageDXT::formatBytes(LLImageDXT::FORMAT_DXR1, 2, 1), 8);
+		ensure_equals("DXR5 1x1", LLImageDXT::formatBytes(LLImageDXT::FORMAT_DXR5, 1, 1), 16);
+	}
+
+	// Every stored level decodes back, including the 2x2, 2x1 and 1x1 levels
+	// that only fill part of a block.
+	template<> template<>
+	void imagedxt_object_t::test<2>()
+	{
+		static const S32 sizes[][2] = { { 8, 8 }, { 16, 4 }, { 4, 16 } };
+		for (S32 s = 0; s < (S32)LL_ARRAY_SIZE(sizes); s++)
+		{
+			for (S32 ncomponents = 3; ncomponents <= 4; ncomponents++)
+			{
+				for (S32 first = 0; first <= 1; first++)
+				{
+					S32 full_width = sizes[s][0] << first;
+					S32 full_height = sizes[s][1] << first;
+					std::string msg = llformat("%dx%dx%d from %d", full_width, full_height, ncomponents, first);
+					LLPointer<LLImageRaw> raw = makeHalves(sizes[s][0], sizes[s][1], ncomponents);
+					LLPointer<LLImageDXT> image = new LLImageDXT;
+					ensure(msg + " encoded", image->encodeCompressed(raw, full_width, full_height, first));
+					ensure_levels(msg, image, first);
+				}
+			}
+		}
+	}
+
+	// What was written reads back through updateData() as the same image.
+	template<> template<>
+	void imagedxt_object_t::test<3>()
+	{
+		LLPointer<LLImageRaw> raw = makeHalves(16, 8, 4);
+		LLPointer<LLImageDXT> image = new LLImageDXT;
+		ensure("encoded", image->encodeCompressed(raw, 32, 16, 1));
+
+		// as the texture cache hands it over
+		U8* data = LLImageBase::allocateMemory(image->getDataSize());
+		memcpy(data, image->getData(), image->getDataSize());	/* Flawfinder: ignore */
+		LLPointer<LLImageDXT> copy = new LLImageDXT;
+		copy->setData(data, image->getDataSize());
+		ensure("read back", copy->updateData());
+		ensure_equals("format", copy->getFileFormat(), LLImageDXT::FORMAT_DXR5);
+		ensure_equals("width", (S32)copy->getWidth(), 32);
+		ensure_equals("height", (S32)copy->getHeight(), 16);
+		ensure_equals("components", (S32)copy->getComponents(), 4);
+		ensure_equals("discard", (S32)copy->getDiscardLevel(), 1);
+		ensure_levels("read back", copy, 1);
+	}
+
+	// Only whole power of two blocks at the top level are taken.
+	template<> template<>
+	void imagedxt_object_t::test<4>()
+	{
+		LLPointer<LLImageDXT> image = new LLImageDXT;
+		ensure("12x12", !image->encodeCompressed(makeHalves(12, 12, 3), 12, 12, 0));
+		ensure("2x2", !image->encodeCompressed(makeHalves(2, 2, 3), 2, 2, 0));
+		ensure("8x2", !image->encodeCompressed(makeHalves(8, 2, 4), 8, 2, 0));
+		ensure("wrong full size", !image->encodeCompressed(makeHalves(8, 8, 3), 32, 32, 1));
+		ensure("one component", !image->encodeCompressed(makeHalves(8, 8, 1), 8, 8, 0));
+	}
+}
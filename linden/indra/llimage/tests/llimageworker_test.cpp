@@ -31,6 +31,7 @@
 #include <algorithm>
 // Class to test
 #include "../llimageworker.h"
+#include "../llimagej2c.h"
 // For timer class
 #include "../llcommon/lltimer.h"
 // Tut header
@@ -58,6 +59,8 @@ void LLImageRaw::deleteData() { }
 U8* LLImageRaw::allocateData(S32 size) { return NULL; }
 U8* LLImageRaw::reallocateData(S32 size) { return NULL; }
 
+BOOL LLImageJ2C::encode(const LLImageRaw *raw_imagep, const char* comment_text, F32 encode_time) { return TRUE; }
+
 // End Stubbing
 // -------------------------------------------------------------------------------------------
 
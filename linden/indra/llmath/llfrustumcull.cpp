@@ -0,0 +1,144 @@
+/**
+ * @file llfrustumcull.cpp
+ * @brief Box against frustum tests, four planes at a time.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llfrustumcull.h"
+
+#include "llcamera.h"
+#include "llv4math.h"
+
+LLFrustumCull::LLFrustumCull()
+:	mPlaneCount(0)
+{
+}
+
+void LLFrustumCull::set(const LLCamera& camera, BOOL no_far_clip)
+{
+	mPlaneCount = 0;
+	for (U32 i = 0; i < camera.getPlaneCount(); i++)
+	{
+		if (no_far_clip && i == LLCamera::AGENT_PLANE_FAR)
+		{
+			continue;
+		}
+
+		U8 mask = camera.getAgentPlaneMask(i);
+		if (mask == 0xff)
+		{ //ignored plane
+			continue;
+		}
+
+		LLPlane p = camera.getAgentPlane(i);
+		mNormalX[mPlaneCount] = p.mV[0];
+		mNormalY[mPlaneCount] = p.mV[1];
+		mNormalZ[mPlaneCount] = p.mV[2];
+		mNegDist[mPlaneCount] = -p.mV[3];
+		mSignX[mPlaneCount] = (mask & 1) ? 1.f : -1.f;
+		mSignY[mPlaneCount] = (mask & 2) ? 1.f : -1.f;
+		mSignZ[mPlaneCount] = (mask & 4) ? 1.f : -1.f;
+		mPlaneCount++;
+	}
+
+	// pad to a whole vector with planes that pass everything
+	while (mPlaneCount & 3)
+	{
+		mNormalX[mPlaneCount] = 0.f;
+		mNormalY[mPlaneCount] = 0.f;
+		mNormalZ[mPlaneCount] = 0.f;
+		mNegDist[mPlaneCount] = F32_MAX;
+		mSignX[mPlaneCount] = 0.f;
+		mSignY[mPlaneCount] = 0.f;
+		mSignZ[mPlaneCount] = 0.f;
+		mPlaneCount++;
+	}
+}
+
+// Same arithmetic, in the same order, as LLCamera::AABBInFrustum(), so the
+// results match exactly.
+S32 LLFrustumCull::AABBInFrustum(const LLVector3& center, const LLVector3& radius) const
+{
+#if LL_VECTORIZE
+	const __m128 cx = _mm_set1_ps(center.mV[0]);
+	const __m128 cy = _mm_set1_ps(center.mV[1]);
+	const __m128 cz = _mm_set1_ps(center.mV[2]);
+	const __m128 rx = _mm_set1_ps(radius.mV[0]);
+	const __m128 ry = _mm_set1_ps(radius.mV[1]);
+	const __m128 rz = _mm_set1_ps(radius.mV[2]);
+
+	S32 partial = 0;
+	for (U32 i = 0; i < mPlaneCount; i += 4)
+	{
+		__m128 tx = _mm_mul_ps(rx, _mm_loadu_ps(mSignX + i));
+		__m128 ty = _mm_mul_ps(ry, _mm_loadu_ps(mSignY + i));
+		__m128 tz = _mm_mul_ps(rz, _mm_loadu_ps(mSignZ + i));
+		__m128 nx = _mm_loadu_ps(mNormalX + i);
+		__m128 ny = _mm_loadu_ps(mNormalY + i);
+		__m128 nz = _mm_loadu_ps(mNormalZ + i);
+		__m128 neg_d = _mm_loadu_ps(mNegDist + i);
+
+		__m128 min_dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_sub_ps(cx, tx)),
+												_mm_mul_ps(ny, _mm_sub_ps(cy, ty))),
+									 _mm_mul_ps(nz, _mm_sub_ps(cz, tz)));
+		if (_mm_movemask_ps(_mm_cmpgt_ps(min_dist, neg_d)))
+		{ //entirely outside at least one plane
+			return 0;
+		}
+
+		__m128 max_dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_add_ps(cx, tx)),
+												_mm_mul_ps(ny, _mm_add_ps(cy, ty))),
+									 _mm_mul_ps(nz, _mm_add_ps(cz, tz)));
+		partial |= _mm_movemask_ps(_mm_cmpgt_ps(max_dist, neg_d));
+	}
+
+	return partial ? 1 : 2;
+#else
+	S32 result = 2;
+	for (U32 i = 0; i < mPlaneCount; i++)
+	{
+		F32 tx = radius.mV[0] * mSignX[i];
+		F32 ty = radius.mV[1] * mSignY[i];
+		F32 tz = radius.mV[2] * mSignZ[i];
+
+		F32 min_dist = mNormalX[i] * (center.mV[0] - tx) +
+					   mNormalY[i] * (center.mV[1] - ty) +
+					   mNormalZ[i] * (center.mV[2] - tz);
+		if (min_dist > mNegDist[i])
+		{
+			return 0;
+		}
+
+		F32 max_dist = mNormalX[i] * (center.mV[0] + tx) +
+					   mNormalY[i] * (center.mV[1] + ty) +
+					   mNormalZ[i] * (center.mV[2] + tz);
+		if (max_dist > mNegDist[i])
+		{
+			result = 1;
+		}
+	}
+	return result;
+#endif
+}
@@ -0,0 +1,70 @@
+/**
+ * @file llfrustumcull.h
+ * @brief Box against frustum tests, four planes at a time.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLFRUSTUMCULL_H
+#define LL_LLFRUSTUMCULL_H
+
+#include "v3math.h"
+
+class LLCamera;
+
+// A snapshot of an LLCamera's agent space planes, packed so that a box
+// can be tested against four planes at once.  The results are the same,
+// bit for bit, as LLCamera::AABBInFrustum() and AABBInFrustumNoFarClip().
+// Unlike LLCamera the tests are const, so one LLFrustumCull can be shared
+// by several threads.
+class LLFrustumCull
+{
+public:
+	LLFrustumCull();
+
+	// Takes the planes the camera has now, including any user clip plane.
+	// no_far_clip leaves out the far plane, like AABBInFrustumNoFarClip().
+	void set(const LLCamera& camera, BOOL no_far_clip);
+
+	// 0 if outside, 1 if partly in, 2 if fully in.
+	S32 AABBInFrustum(const LLVector3& center, const LLVector3& radius) const;
+
+private:
+	enum { MAX_PLANES = 8 };
+
+	// Structure of arrays, one lane per plane.  Unused lanes have a zero
+	// normal and a huge distance, so they never reject anything.
+	F32 mNormalX[MAX_PLANES];
+	F32 mNormalY[MAX_PLANES];
+	F32 mNormalZ[MAX_PLANES];
+	F32 mNegDist[MAX_PLANES];	// -d, which is what the tests compare against
+
+	// Per plane, +1 or -1 per axis: the side of the box that lies furthest
+	// back along the plane normal
+	F32 mSignX[MAX_PLANES];
+	F32 mSignY[MAX_PLANES];
+	F32 mSignZ[MAX_PLANES];
+
+	U32 mPlaneCount;			// rounded up to a multiple of four
+};
+
+#endif // LL_LLFRUSTUMCULL_H
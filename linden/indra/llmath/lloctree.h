@@ -30,7 +30,6 @@
 #include "lltreenode.h"
 #include "v3math.h"
 #include <vector>
-#include <set>
 
 #if LL_RELEASE_WITH_DEBUG_INFO || LL_DEBUG
 #define OCT_ERRS LL_ERRS("OctreeErrors")
@@ -47,6 +46,54 @@
 
 template <class T> class LLOctreeNode;
 
+// Hands out blocks of SIZE bytes from chunks, and keeps freed blocks for
+// reuse, so branches that come and go as objects move don't go through the
+// heap every time.  Chunks are kept until exit.  Octrees are only changed on
+// the main thread, so there is no locking.
+template <size_t SIZE>
+class LLOctreeNodePool
+{
+public:
+	static void* allocate()
+	{
+		if (!sFreeList)
+		{
+			grow();
+		}
+		FreeBlock* block = sFreeList;
+		sFreeList = block->mNext;
+		return block;
+	}
+
+	static void release(void* ptr)
+	{
+		FreeBlock* block = (FreeBlock*) ptr;
+		block->mNext = sFreeList;
+		sFreeList = block;
+	}
+
+private:
+	struct FreeBlock
+	{
+		FreeBlock* mNext;
+	};
+
+	static void grow()
+	{
+		const U32 BLOCKS_PER_CHUNK = 256;
+		char* chunk = new char[SIZE * BLOCKS_PER_CHUNK];
+		for (U32 i = 0; i < BLOCKS_PER_CHUNK; i++)
+		{
+			release(chunk + i * SIZE);
+		}
+	}
+
+	static FreeBlock* sFreeList;
+};
+
+template <size_t SIZE>
+typename LLOctreeNodePool<SIZE>::FreeBlock* LLOctreeNodePool<SIZE>::sFreeList = NULL;
+
 template <class T>
 class LLOctreeListener: public LLTreeListener<T>
 {
@@ -72,11 +119,13 @@ class LLOctreeNode : public LLTreeNode<T>
 public:
 	typedef LLOctreeTraveler<T>									oct_traveler;
 	typedef LLTreeTraveler<T>									tree_traveler;
-	typedef typename std::set<LLPointer<T> >					element_list;
-	typedef typename std::set<LLPointer<T> >::iterator			element_iter;
-	typedef typename std::set<LLPointer<T> >::const_iterator	const_element_iter;
+	// Elements are kept in no particular order.  Each one remembers its
+	// index here through T::getBinIndex() and T::setBinIndex(), so removal
+	// is a swap with the last element.
+	typedef typename std::vector<LLPointer<T> >					element_list;
+	typedef typename std::vector<LLPointer<T> >::iterator		element_iter;
+	typedef typename std::vector<LLPointer<T> >::const_iterator	const_element_iter;
 	typedef typename std::vector<LLTreeListener<T>*>::iterator	tree_listener_iter;
-	typedef typename std::vector<LLOctreeNode<T>* >				child_list;
 	typedef LLTreeNode<T>		BaseType;
 	typedef LLOctreeNode<T>		oct_node;
 	typedef LLOctreeListener<T>	oct_listener;
@@ -113,6 +162,28 @@ public:
 		} 
 	}
 
+	// LLOctreeNode and LLOctreeRoot come from the node pool
+	void* operator new(size_t size)
+	{
+		if (size == sizeof(oct_node))
+		{
+			return LLOctreeNodePool<sizeof(oct_node)>::allocate();
+		}
+		return ::operator new(size);
+	}
+
+	void operator delete(void* ptr, size_t size)
+	{
+		if (size == sizeof(oct_node))
+		{
+			LLOctreeNodePool<sizeof(oct_node)>::release(ptr);
+		}
+		else
+		{
+			::operator delete(ptr);
+		}
+	}
+
 	inline const BaseType* getParent()	const			{ return mParent; }
 	inline void setParent(BaseType* parent)			{ mParent = (oct_node*) parent; }
 	inline const LLVector3d& getCenter() const			{ return mCenter; }
@@ -221,17 +292,21 @@ public:
 	}
 
 	void accept(oct_traveler* visitor)				{ visitor->visit(this); }
-	virtual bool isLeaf() const						{ return mChild.empty(); }
+	virtual bool isLeaf() const						{ return mChildCount == 0; }
 	
 	U32 getElementCount() const						{ return mData.size(); }
 	element_list& getData()							{ return mData; }
 	const element_list& getData() const				{ return mData; }
+	bool hasData(T* data) const
+	{
+		S32 index = data->getBinIndex();
+		return index >= 0 && index < (S32) mData.size() && mData[index] == data;
+	}
 	
-	U32 getChildCount()	const						{ return mChild.size(); }
+	U32 getChildCount()	const						{ return mChildCount; }
 	oct_node* getChild(U32 index)					{ return mChild[index]; }
 	const oct_node* getChild(U32 index) const		{ return mChild[index]; }
-	child_list& getChildren()						{ return mChild; }
-	const child_list& getChildren() const			{ return mChild; }
+	oct_node* getChildAt(U8 octant)					{ return mChildMap[octant] == NO_CHILD ? NULL : mChild[mChildMap[octant]]; }
 	
 	void accept(tree_traveler* visitor) const		{ visitor->visit(this); }
 	void accept(oct_traveler* visitor) const		{ visitor->visit(this); }
@@ -253,14 +328,12 @@ public:
 			while (keep_going && node->getSize().mdV[0] >= rad)
 			{	
 				keep_going = FALSE;
-				for (U32 i = 0; i < node->getChildCount() && !keep_going; i++)
+				oct_node* child = node->getChildAt(octant);
+				if (child)
 				{
-					if (node->getChild(i)->getOctant() == octant)
-					{
-						node = node->getChild(i);
-						octant = node->getOctant(pos.mdV);
-						keep_going = TRUE;
-					}
+					node = child;
+					octant = node->getOctant(pos.mdV);
+					keep_going = TRUE;
 				}
 			}
 		}
@@ -291,29 +364,25 @@ public:
 			{ //it belongs here
 #if LL_OCTREE_PARANOIA_CHECK
 				//if this is a redundant insertion, error out (should never happen)
-				if (mData.find(data) != mData.end())
+				if (hasData(data))
 				{
 					llwarns << "Redundant octree insertion detected. " << data << llendl;
 					return false;
 				}
 #endif
 
-				mData.insert(data);
+				addData(data);
 				BaseType::insert(data);
 				return true;
 			}
 			else
 			{ 	
 				//find a child to give it to
-				oct_node* child = NULL;
-				for (U32 i = 0; i < getChildCount(); i++)
+				oct_node* child = getChildAt(getOctant(data->getPositionGroup().mdV));
+				if (child && child->isInside(data->getPositionGroup()))
 				{
-					child = getChild(i);
-					if (child->isInside(data->getPositionGroup()))
-					{
-						child->insert(data);
-						return false;
-					}
+					child->insert(data);
+					return false;
 				}
 				
 				//it's here, but no kids are in the right place, make a new kid
@@ -328,7 +397,7 @@ public:
 					llabs(center.mdV[1] - getCenter().mdV[1]) < F_APPROXIMATELY_ZERO &&
 					llabs(center.mdV[2] - getCenter().mdV[2]) < F_APPROXIMATELY_ZERO)
 				{
-					mData.insert(data);
+					addData(data);
 					BaseType::insert(data);
 					return true;
 				}
@@ -380,9 +449,9 @@ public:
 
 	bool remove(T* data)
 	{
-		if (mData.find(data) != mData.end())
+		if (hasData(data))
 		{	//we have data
-			mData.erase(data);
+			removeData(data);
 			notifyRemoval(data);
 			checkAlive();
 			return true;
@@ -417,9 +486,9 @@ public:
 
 	void removeByAddress(T* data)
 	{
-        if (mData.find(data) != mData.end())
+		if (hasData(data))
 		{
-			mData.erase(data);
+			removeData(data);
 			notifyRemoval(data);
 			llwarns << "FOUND!" << llendl;
 			checkAlive();
@@ -435,7 +504,12 @@ public:
 
 	void clearChildren()
 	{
-		mChild.clear();
+		mChildCount = 0;
+		for (U32 i = 0; i < 8; i++)
+		{
+			mChild[i] = NULL;
+			mChildMap[i] = NO_CHILD;
+		}
 	}
 
 	void validate()
@@ -481,13 +555,19 @@ public:
 			}
 		}
 
-		if (mChild.size() >= 8)
+#endif
+
+		if (mChildCount >= 8)
 		{
 			OCT_ERRS <<"Octree node has too many children... why?" << llendl;
+			return;
 		}
-#endif
 
-		mChild.push_back(child);
+		if (child->getOctant() < 8)
+		{
+			mChildMap[child->getOctant()] = mChildCount;
+		}
+		mChild[mChildCount++] = child;
 		child->setParent(this);
 
 		if (!silent)
@@ -513,7 +593,24 @@ public:
 			mChild[index]->destroy();
 			delete mChild[index];
 		}
-		mChild.erase(mChild.begin() + index);
+
+		//keep the remaining children in order
+		for (U32 i = index; i + 1 < mChildCount; i++)
+		{
+			mChild[i] = mChild[i + 1];
+		}
+		mChild[--mChildCount] = NULL;
+		for (U32 i = 0; i < 8; i++)
+		{
+			mChildMap[i] = NO_CHILD;
+		}
+		for (U32 i = 0; i < mChildCount; i++)
+		{
+			if (mChild[i]->getOctant() < 8)
+			{
+				mChildMap[mChild[i]->getOctant()] = i;
+			}
+		}
 
 		checkAlive();
 	}
@@ -544,8 +641,31 @@ public:
 		//OCT_ERRS << "Octree failed to delete requested child." << llendl;
 	}
 
-protected:	
-	child_list mChild;
+protected:
+	void addData(T* data)
+	{
+		data->setBinIndex(mData.size());
+		mData.push_back(data);
+	}
+
+	void removeData(T* data)
+	{
+		S32 index = data->getBinIndex();
+		S32 last = mData.size() - 1;
+		data->setBinIndex(-1);
+		if (index != last)
+		{
+			mData[index] = mData[last];
+			mData[index]->setBinIndex(index);
+		}
+		mData.pop_back();
+	}
+
+	static const U8 NO_CHILD = 255;
+
+	oct_node* mChild[8];
+	U8 mChildMap[8];	//index into mChild by octant, or NO_CHILD
+	U32 mChildCount;
 	element_list mData;
 	oct_node* mParent;
 	LLVector3d mCenter;
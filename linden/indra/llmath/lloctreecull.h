@@ -0,0 +1,297 @@
+/**
+ * @file lloctreecull.h
+ * @brief Frustum classification of octrees, split across a work pool.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOCTREECULL_H
+#define LL_LLOCTREECULL_H
+
+#include <vector>
+
+#include "lloctree.h"
+#include "llworkpool.h"
+
+//============================================================================
+// LLOctreeCullPass
+//
+// Culling usually has two halves: deciding which nodes are in the frustum,
+// which only reads the tree, and acting on them (occlusion queries, render
+// lists), which has to happen on the main thread.  LLOctreeCullPass does
+// the first half for any number of trees, splitting big trees into
+// subtrees that run on an LLWorkPool, each into its own buffer.  The
+// buffers are then stitched together so every tree comes out as one list
+// in the order an LLOctreeTraveler would have visited it, whatever the
+// number of threads.
+//
+// Subclasses supply the test through frustumCheck(), which is called from
+// several threads at once and must not change anything.
+
+template <class T>
+class LLOctreeCullPass : public LLWorkPool::Task
+{
+public:
+	typedef LLOctreeNode<T> oct_node;
+
+	struct Entry
+	{
+		const oct_node* mNode;
+		S32 mResult;		// 0 outside, 1 partly in, 2 fully in
+		U32 mDepth;			// 0 for the root of a tree
+		U32 mData;			// whatever frustumCheck() left in it
+	};
+	typedef std::vector<Entry> entry_list_t;
+
+	LLOctreeCullPass() {}
+	virtual ~LLOctreeCullPass() {}
+
+	// Queues a tree for the next cull() and returns its index.
+	U32 addTree(const oct_node* root)
+	{
+		mRoots.push_back(root);
+		return (U32)mRoots.size() - 1;
+	}
+
+	// Forgets the trees, but keeps the buffers for next time.
+	void clear()
+	{
+		mRoots.clear();
+		mEntries.clear();
+		mTreeBegin.clear();
+	}
+
+	// Classifies every queued tree.  pool may be NULL.
+	void cull(LLWorkPool* pool);
+
+	U32 getTreeCount() const				{ return (U32)mRoots.size(); }
+
+	// Nodes of a tree, parents before children.  Nodes below one that
+	// came out as 0 aren't listed.
+	const Entry* beginTree(U32 tree) const	{ return mEntries.empty() ? NULL : &mEntries[0] + mTreeBegin[tree]; }
+	const Entry* endTree(U32 tree) const	{ return mEntries.empty() ? NULL : &mEntries[0] + mTreeBegin[tree + 1]; }
+
+	// Returns the entry after entry's subtree.
+	static const Entry* skipChildren(const Entry* entry, const Entry* end)
+	{
+		const Entry* next = entry + 1;
+		while (next != end && next->mDepth > entry->mDepth)
+		{
+			++next;
+		}
+		return next;
+	}
+
+	/*virtual*/ void run(S32 index)
+	{
+		Subtree& subtree = mSubtrees[index];
+		entry_list_t& entries = mSubtreeEntries[index];
+		entries.clear();
+		classify(subtree.mTree, subtree.mNode, subtree.mParentResult, subtree.mDepth, entries);
+	}
+
+protected:
+	// Returns 0, 1 or 2 for node, given its parent's result (0 for a
+	// root).  data is stored with the entry.
+	virtual S32 frustumCheck(U32 tree, const oct_node* node, S32 parent_result, U32& data) const = 0;
+
+private:
+	struct Subtree
+	{
+		U32 mTree;
+		const oct_node* mNode;
+		S32 mParentResult;
+		U32 mDepth;
+	};
+
+	// Enough subtrees to keep every thread busy when some are much
+	// bigger than others, but not so deep that the serial top gets costly.
+	enum
+	{
+		SUBTREES_PER_THREAD = 4,
+		MAX_SPLIT_DEPTH = 4,
+		SUBTREE_MARKER = -1		// mResult of a placeholder for a subtree
+	};
+
+	void classify(U32 tree, const oct_node* node, S32 parent_result, U32 depth, entry_list_t& entries) const;
+	void split(U32 tree, const oct_node* node, S32 parent_result, U32 depth, U32 split_depth);
+	U32 getSplitDepth(const oct_node* root, U32 target) const;
+	static void countLevels(const oct_node* node, U32 depth, U32* counts);
+
+private:
+	std::vector<const oct_node*> mRoots;
+	entry_list_t mEntries;
+	std::vector<U32> mTreeBegin;		// one per tree, plus the end
+
+	entry_list_t mTop;					// serial part, with placeholders
+	std::vector<U32> mTopBegin;
+	std::vector<Subtree> mSubtrees;
+	std::vector<entry_list_t> mSubtreeEntries;
+};
+
+template <class T>
+void LLOctreeCullPass<T>::cull(LLWorkPool* pool)
+{
+	mEntries.clear();
+	mTreeBegin.clear();
+
+	S32 threads = pool ? pool->getNumThreads() : 0;
+	if (threads == 0)
+	{ //no one to share with, go straight down each tree
+		for (U32 i = 0; i < mRoots.size(); i++)
+		{
+			mTreeBegin.push_back((U32)mEntries.size());
+			classify(i, mRoots[i], 0, 0, mEntries);
+		}
+		mTreeBegin.push_back((U32)mEntries.size());
+		return;
+	}
+
+	// classify the top of each tree here, leaving a marker for each subtree
+	U32 target = (U32)(threads + 1) * SUBTREES_PER_THREAD;
+	mTop.clear();
+	mTopBegin.clear();
+	mSubtrees.clear();
+	for (U32 i = 0; i < mRoots.size(); i++)
+	{
+		mTopBegin.push_back((U32)mTop.size());
+		split(i, mRoots[i], 0, 0, getSplitDepth(mRoots[i], target));
+	}
+	mTopBegin.push_back((U32)mTop.size());
+
+	if (mSubtreeEntries.size() < mSubtrees.size())
+	{
+		mSubtreeEntries.resize(mSubtrees.size());
+	}
+	pool->parallelFor(*this, (S32)mSubtrees.size());
+
+	// stitch the subtrees back in where their markers are
+	for (U32 i = 0; i < mRoots.size(); i++)
+	{
+		mTreeBegin.push_back((U32)mEntries.size());
+		for (U32 j = mTopBegin[i]; j < mTopBegin[i + 1]; j++)
+		{
+			const Entry& entry = mTop[j];
+			if (entry.mResult == SUBTREE_MARKER)
+			{
+				const entry_list_t& entries = mSubtreeEntries[entry.mData];
+				mEntries.insert(mEntries.end(), entries.begin(), entries.end());
+			}
+			else
+			{
+				mEntries.push_back(entry);
+			}
+		}
+	}
+	mTreeBegin.push_back((U32)mEntries.size());
+}
+
+template <class T>
+void LLOctreeCullPass<T>::classify(U32 tree, const oct_node* node, S32 parent_result, U32 depth, entry_list_t& entries) const
+{
+	Entry entry;
+	entry.mNode = node;
+	entry.mDepth = depth;
+	entry.mData = 0;
+	entry.mResult = frustumCheck(tree, node, parent_result, entry.mData);
+	entries.push_back(entry);
+
+	if (entry.mResult)
+	{
+		for (U32 i = 0; i < node->getChildCount(); i++)
+		{
+			classify(tree, node->getChild(i), entry.mResult, depth + 1, entries);
+		}
+	}
+}
+
+template <class T>
+void LLOctreeCullPass<T>::split(U32 tree, const oct_node* node, S32 parent_result, U32 depth, U32 split_depth)
+{
+	Entry entry;
+	entry.mNode = node;
+	entry.mDepth = depth;
+	entry.mData = 0;
+
+	if (depth == split_depth)
+	{
+		Subtree subtree;
+		subtree.mTree = tree;
+		subtree.mNode = node;
+		subtree.mParentResult = parent_result;
+		subtree.mDepth = depth;
+
+		entry.mResult = SUBTREE_MARKER;
+		entry.mData = (U32)mSubtrees.size();
+		mSubtrees.push_back(subtree);
+		mTop.push_back(entry);
+		return;
+	}
+
+	entry.mResult = frustumCheck(tree, node, parent_result, entry.mData);
+	mTop.push_back(entry);
+
+	if (entry.mResult)
+	{
+		for (U32 i = 0; i < node->getChildCount(); i++)
+		{
+			split(tree, node->getChild(i), entry.mResult, depth + 1, split_depth);
+		}
+	}
+}
+
+// The shallowest depth with at least target nodes, or MAX_SPLIT_DEPTH.  A
+// tree too small to ever get there isn't split at all.
+template <class T>
+U32 LLOctreeCullPass<T>::getSplitDepth(const oct_node* root, U32 target) const
+{
+	U32 counts[MAX_SPLIT_DEPTH + 1] = { 0 };
+	countLevels(root, 0, counts);
+
+	for (U32 depth = 1; depth <= MAX_SPLIT_DEPTH; depth++)
+	{
+		if (counts[depth] >= target)
+		{
+			return depth;
+		}
+		if (counts[depth] == 0)
+		{ //the whole tree is shallower than that, do it here
+			return MAX_SPLIT_DEPTH + 1;
+		}
+	}
+	return MAX_SPLIT_DEPTH;
+}
+
+template <class T>
+void LLOctreeCullPass<T>::countLevels(const oct_node* node, U32 depth, U32* counts)
+{
+	counts[depth]++;
+	if (depth < MAX_SPLIT_DEPTH)
+	{
+		for (U32 i = 0; i < node->getChildCount(); i++)
+		{
+			countLevels(node->getChild(i), depth + 1, counts);
+		}
+	}
+}
+
+#endif // LL_LLOCTREECULL_H
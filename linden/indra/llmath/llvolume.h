@@ -48,6 +48,7 @@ class LLVolume;
 #include "v4coloru.h"
 #include "llrefcount.h"
 #include "llfile.h"
+#include "llmempool.h"
 
 //============================================================================
 
@@ -786,7 +787,11 @@ public:
 		mBeginS(0),
 		mBeginT(0),
 		mNumS(0),
-		mNumT(0)
+		mNumT(0),
+		mVertices(LLMemPoolAllocator<VertexData>(LLMemType::MTYPE_VOLUME)),
+		mIndices(LLMemPoolAllocator<U16>(LLMemType::MTYPE_VOLUME)),
+		mTriStrip(LLMemPoolAllocator<U16>(LLMemType::MTYPE_VOLUME)),
+		mEdge(LLMemPoolAllocator<S32>(LLMemType::MTYPE_VOLUME))
 	{
 	}
 
@@ -832,10 +837,12 @@ public:
 
 	LLVector3 mExtents[2]; //minimum and maximum point of face
 
-	std::vector<VertexData> mVertices;
-	std::vector<U16>	mIndices;
-	std::vector<U16>	mTriStrip;
-	std::vector<S32>	mEdge;
+	// Faces are rebuilt whenever a prim changes, on whichever thread builds
+	// the volume, so their arrays come from LLMemPool.
+	std::vector<VertexData, LLMemPoolAllocator<VertexData> > mVertices;
+	std::vector<U16, LLMemPoolAllocator<U16> >	mIndices;
+	std::vector<U16, LLMemPoolAllocator<U16> >	mTriStrip;
+	std::vector<S32, LLMemPoolAllocator<S32> >	mEdge;
 
 private:
 	BOOL createUnCutCubeCap(LLVolume* volume, BOOL partial_build = FALSE);
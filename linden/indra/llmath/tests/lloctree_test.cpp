@@ -0,0 +1,265 @@
+/**
+ * @file lloctree_test.cpp
+ * @brief Tests for LLOctreeNode.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llpointer.h"
+#include "llrefcount.h"
+#include "v3dmath.h"
+#include "../lloctree.h"
+
+#include "../test/lltut.h"
+
+#include <set>
+
+namespace
+{
+	// Stands in for LLDrawable.
+	class TestElement : public LLRefCount
+	{
+	public:
+		TestElement(const LLVector3d& pos, F64 radius)
+			: mPosition(pos), mRadius(radius), mBinIndex(-1) {}
+
+		const LLVector3d& getPositionGroup() const	{ return mPosition; }
+		F64 getBinRadius() const					{ return mRadius; }
+		S32 getBinIndex() const						{ return mBinIndex; }
+		void setBinIndex(S32 index)					{ mBinIndex = index; }
+
+		LLVector3d mPosition;
+		F64 mRadius;
+		S32 mBinIndex;
+	};
+
+	typedef LLOctreeNode<TestElement> TestNode;
+	typedef LLOctreeRoot<TestElement> TestRoot;
+
+	// Deterministic, so a failure can be reproduced.
+	U32 sSeed = 1;
+	F64 next_random(F64 range)
+	{
+		sSeed = sSeed * 1103515245 + 12345;
+		return range * (F64)((sSeed >> 8) & 0xffff) / 65536.0;
+	}
+
+	// Scattered over a region, mostly small things, like a busy sim.
+	LLVector3d random_position()
+	{
+		return LLVector3d(next_random(256.0), next_random(256.0), 20.0 + next_random(100.0));
+	}
+
+	F64 random_radius()
+	{
+		return next_random(4.0) < 3.0 ? 0.5 + next_random(2.0) : 4.0 + next_random(28.0);
+	}
+
+	// Counts elements and checks every back-index.
+	class CheckTraveler : public LLOctreeTraveler<TestElement>
+	{
+	public:
+		CheckTraveler() : mElements(0), mNodes(0), mBadIndices(0) {}
+
+		/*virtual*/ void visit(const TestNode* node)
+		{
+			mNodes++;
+			for (U32 i = 0; i < node->getElementCount(); i++)
+			{
+				if (node->getData()[i]->getBinIndex() != (S32) i)
+				{
+					mBadIndices++;
+				}
+			}
+			mElements += node->getElementCount();
+		}
+
+		S32 mElements;
+		S32 mNodes;
+		S32 mBadIndices;
+	};
+
+	// Collects the elements of every node that overlaps a box, the way
+	// the spatial partition culls against the camera.
+	class BoxCullTraveler : public LLOctreeTraveler<TestElement>
+	{
+	public:
+		BoxCullTraveler(const LLVector3d& min, const LLVector3d& max)
+			: mMin(min), mMax(max) {}
+
+		/*virtual*/ void traverse(const TestNode* node)
+		{
+			const LLVector3d& center = node->getCenter();
+			const LLVector3d& size = node->getSize();
+			for (U32 i = 0; i < 3; i++)
+			{
+				if (center.mdV[i] + size.mdV[i] < mMin.mdV[i] ||
+					center.mdV[i] - size.mdV[i] > mMax.mdV[i])
+				{
+					return;
+				}
+			}
+			LLOctreeTraveler<TestElement>::traverse(node);
+		}
+
+		/*virtual*/ void visit(const TestNode* node)
+		{
+			for (U32 i = 0; i < node->getElementCount(); i++)
+			{
+				mElements.insert(node->getData()[i]);
+			}
+		}
+
+		bool inBox(const TestElement* element) const
+		{
+			const LLVector3d& pos = element->getPositionGroup();
+			for (U32 i = 0; i < 3; i++)
+			{
+				if (pos.mdV[i] < mMin.mdV[i] || pos.mdV[i] > mMax.mdV[i])
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		LLVector3d mMin;
+		LLVector3d mMax;
+		std::set<const TestElement*> mElements;
+	};
+}
+
+namespace tut
+{
+	struct octree_data
+	{
+		octree_data()
+			: mRoot(LLVector3d(128.0, 128.0, 128.0), LLVector3d(1.0, 1.0, 1.0), NULL)
+		{
+		}
+
+		void fill(S32 count)
+		{
+			for (S32 i = 0; i < count; i++)
+			{
+				mElements.push_back(new TestElement(random_position(), random_radius()));
+				mRoot.insert(mElements.back());
+			}
+		}
+
+		void move(TestElement* element)
+		{
+			TestNode* node = mRoot.getNodeAt(element);
+			node->remove(element);
+			element->mPosition += LLVector3d(next_random(2.0) - 1.0, next_random(2.0) - 1.0, next_random(0.5));
+			mRoot.insert(element);
+		}
+
+		TestRoot mRoot;
+		std::vector<LLPointer<TestElement> > mElements;
+	};
+	typedef test_group<octree_data> octree_test;
+	typedef octree_test::object octree_object;
+	tut::octree_test octree("LLOctreeNode");
+
+	template<> template<>
+	void octree_object::test<1>()
+	{
+		// Everything inserted can be found, and every back-index is right.
+		fill(5000);
+
+		CheckTraveler check;
+		check.traverse(&mRoot);
+		ensure_equals("all elements present", check.mElements, 5000);
+		ensure_equals("back-indices", check.mBadIndices, 0);
+
+		for (U32 i = 0; i < mElements.size(); i++)
+		{
+			TestNode* node = mRoot.getNodeAt(mElements[i]);
+			ensure("element in its node", node->hasData(mElements[i]));
+		}
+	}
+
+	template<> template<>
+	void octree_object::test<2>()
+	{
+		// Moving elements keeps the tree whole; removing them all empties it.
+		fill(5000);
+		for (S32 iter = 0; iter < 4; iter++)
+		{
+			for (U32 i = 0; i < mElements.size(); i += 3)
+			{
+				move(mElements[i]);
+			}
+		}
+
+		CheckTraveler check;
+		check.traverse(&mRoot);
+		ensure_equals("all elements present", check.mElements, 5000);
+		ensure_equals("back-indices", check.mBadIndices, 0);
+
+		for (U32 i = 0; i < mElements.size(); i++)
+		{
+			TestNode* node = mRoot.getNodeAt(mElements[i]);
+			ensure("removed", node->remove(mElements[i]));
+			ensure_equals("index cleared", mElements[i]->getBinIndex(), -1);
+		}
+
+		CheckTraveler empty;
+		empty.traverse(&mRoot);
+		ensure_equals("no elements left", empty.mElements, 0);
+		ensure_equals("no branches left", mRoot.getChildCount(), 0U);
+	}
+
+	template<> template<>
+	void octree_object::test<3>()
+	{
+		// A box cull after moves finds everything inside the box, and skips
+		// most of what is outside it.
+		fill(2000);
+		for (U32 i = 0; i < mElements.size(); i++)
+		{
+			move(mElements[i]);
+		}
+
+		for (S32 c = 0; c < 10; c++)
+		{
+			LLVector3d min = random_position();
+			BoxCullTraveler cull(min, min + LLVector3d(64.0, 64.0, 64.0));
+			cull.traverse(&mRoot);
+
+			S32 inside = 0;
+			for (U32 i = 0; i < mElements.size(); i++)
+			{
+				if (cull.inBox(mElements[i]))
+				{
+					inside++;
+					ensure("element in box culled in", cull.mElements.count(mElements[i]) > 0);
+				}
+			}
+			ensure("cull visits fewer than all", (S32) cull.mElements.size() < (S32) mElements.size());
+			ensure("cull finds at least the box", (S32) cull.mElements.size() >= inside);
+		}
+	}
+}
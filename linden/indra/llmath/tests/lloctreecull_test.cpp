@@ -0,0 +1,353 @@
+/**
+ * @file lloctreecull_test.cpp
+ * @brief Tests and timings for LLFrustumCull and LLOctreeCullPass.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llpointer.h"
+#include "llrefcount.h"
+#include "lltimer.h"
+#include "llworkpool.h"
+#include "v3dmath.h"
+#include "../llcamera.h"
+#include "../llfrustumcull.h"
+#include "../lloctreecull.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	class TestElement : public LLRefCount
+	{
+	public:
+		TestElement(const LLVector3d& pos, F64 radius)
+			: mPosition(pos), mRadius(radius), mBinIndex(-1) {}
+
+		const LLVector3d& getPositionGroup() const	{ return mPosition; }
+		F64 getBinRadius() const					{ return mRadius; }
+		S32 getBinIndex() const						{ return mBinIndex; }
+		void setBinIndex(S32 index)					{ mBinIndex = index; }
+
+		LLVector3d mPosition;
+		F64 mRadius;
+		S32 mBinIndex;
+	};
+
+	typedef LLOctreeNode<TestElement> TestNode;
+	typedef LLOctreeRoot<TestElement> TestRoot;
+	typedef LLOctreeCullPass<TestElement> TestPassBase;
+
+	// Deterministic, so a failure can be reproduced.
+	U32 sSeed = 1;
+	F32 next_random(F32 range)
+	{
+		sSeed = sSeed * 1103515245 + 12345;
+		return range * (F32)((sSeed >> 8) & 0xffff) / 65536.f;
+	}
+
+	// A camera at origin looking along yaw, set up the way LLViewerCamera
+	// does it: eight corners first, then the agent planes from them.
+	void set_camera(LLCamera& camera, const LLVector3& origin, F32 yaw, F32 far_dist)
+	{
+		LLVector3 at(cosf(yaw), sinf(yaw), 0.f);
+		LLVector3 left(-sinf(yaw), cosf(yaw), 0.f);
+		LLVector3 up(0.f, 0.f, 1.f);
+		camera.setOrigin(origin);
+		camera.setAxes(at, left, up);
+
+		const F32 near_dist = 0.5f;
+		const F32 half_height = near_dist * tanf(30.f * DEG_TO_RAD);
+		const F32 half_width = half_height * 1.5f;
+
+		LLVector3 frust[8];
+		LLVector3 center = origin + at * near_dist;
+		frust[0] = center + left * half_width - up * half_height;
+		frust[1] = center - left * half_width - up * half_height;
+		frust[2] = center - left * half_width + up * half_height;
+		frust[3] = center + left * half_width + up * half_height;
+		for (U32 i = 0; i < 4; i++)
+		{
+			frust[i + 4] = origin + (frust[i] - origin) * (far_dist / near_dist);
+		}
+		camera.calcAgentFrustumPlanes(frust);
+	}
+
+	// Stands in for the spatial partition: node bounds against one camera
+	// per tree, with fully visible parents passing their children.
+	class TestCullPass : public TestPassBase
+	{
+	public:
+		void addCamera(const TestNode* root, const LLCamera& camera, BOOL no_far_clip)
+		{
+			addTree(root);
+			mFrustums.push_back(LLFrustumCull());
+			mFrustums.back().set(camera, no_far_clip);
+		}
+
+	protected:
+		/*virtual*/ S32 frustumCheck(U32 tree, const TestNode* node, S32 parent_result, U32& data) const
+		{
+			if (parent_result == 2)
+			{
+				return 2;
+			}
+			return mFrustums[tree].AABBInFrustum(LLVector3(node->getCenter()), LLVector3(node->getSize()));
+		}
+
+	public:
+		std::vector<LLFrustumCull> mFrustums;
+	};
+
+	// The same thing, done the old way: one traveler, LLCamera's tests.
+	class ReferenceCull : public LLOctreeTraveler<TestElement>
+	{
+	public:
+		ReferenceCull(LLCamera& camera, BOOL no_far_clip)
+			: mCamera(camera), mNoFarClip(no_far_clip), mRes(0), mDepth(0) {}
+
+		/*virtual*/ void traverse(const TestNode* node)
+		{
+			S32 parent_res = mRes;
+			if (mRes != 2)
+			{
+				LLVector3 center(node->getCenter());
+				LLVector3 size(node->getSize());
+				mRes = mNoFarClip ? mCamera.AABBInFrustumNoFarClip(center, size) : mCamera.AABBInFrustum(center, size);
+			}
+
+			TestPassBase::Entry entry;
+			entry.mNode = node;
+			entry.mResult = mRes;
+			entry.mDepth = mDepth;
+			entry.mData = 0;
+			mEntries.push_back(entry);
+
+			if (mRes)
+			{
+				mDepth++;
+				LLOctreeTraveler<TestElement>::traverse(node);
+				mDepth--;
+			}
+			mRes = parent_res;
+		}
+
+		/*virtual*/ void visit(const TestNode* node) {}
+
+		LLCamera& mCamera;
+		BOOL mNoFarClip;
+		S32 mRes;
+		U32 mDepth;
+		TestPassBase::entry_list_t mEntries;
+	};
+
+	class CountTraveler : public LLOctreeTraveler<TestElement>
+	{
+	public:
+		CountTraveler() : mNodes(0) {}
+		/*virtual*/ void visit(const TestNode* node) { mNodes++; }
+		S32 mNodes;
+	};
+
+	bool same_entries(const TestPassBase::Entry* begin, const TestPassBase::Entry* end,
+					  const TestPassBase::entry_list_t& expected)
+	{
+		if ((size_t)(end - begin) != expected.size())
+		{
+			return false;
+		}
+		for (U32 i = 0; i < expected.size(); i++)
+		{
+			if (begin[i].mNode != expected[i].mNode ||
+				begin[i].mResult != expected[i].mResult ||
+				begin[i].mDepth != expected[i].mDepth)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+namespace tut
+{
+	struct octree_cull_data
+	{
+		octree_cull_data()
+			: mRoot(LLVector3d(128.0, 128.0, 128.0), LLVector3d(1.0, 1.0, 1.0), NULL)
+		{
+		}
+
+		// Grows a synthetic partition until it has at least groups nodes:
+		// a sim full of small prims with a few large ones.
+		S32 build(S32 groups)
+		{
+			CountTraveler count;
+			while (count.mNodes < groups)
+			{
+				for (S32 i = 0; i < 1000; i++)
+				{
+					LLVector3d pos(next_random(256.f), next_random(256.f), 20.f + next_random(100.f));
+					F64 radius = next_random(4.f) < 3.f ? 0.5f + next_random(2.f) : 4.f + next_random(28.f);
+					mElements.push_back(new TestElement(pos, radius));
+					mRoot.insert(mElements.back());
+				}
+				count.mNodes = 0;
+				count.traverse(&mRoot);
+			}
+			return count.mNodes;
+		}
+
+		TestRoot mRoot;
+		std::vector<LLPointer<TestElement> > mElements;
+	};
+	typedef test_group<octree_cull_data> octree_cull_test;
+	typedef octree_cull_test::object octree_cull_object;
+	tut::octree_cull_test octree_cull("LLOctreeCullPass");
+
+	template<> template<>
+	void octree_cull_object::test<1>()
+	{
+		// LLFrustumCull gives exactly what LLCamera gives, with and without
+		// the far plane and a user clip plane.
+		S32 counts[3] = { 0, 0, 0 };
+		for (S32 c = 0; c < 8; c++)
+		{
+			LLCamera camera;
+			set_camera(camera, LLVector3(next_random(256.f), next_random(256.f), 20.f + next_random(60.f)),
+					   next_random(F_TWO_PI), 32.f + next_random(200.f));
+			if (c & 1)
+			{
+				camera.setUserClipPlane(LLPlane(LLVector3(0.f, 0.f, -1.f), 20.f + next_random(40.f)));
+			}
+
+			for (S32 far_clip = 0; far_clip < 2; far_clip++)
+			{
+				LLFrustumCull frustum;
+				frustum.set(camera, far_clip == 0);
+				for (S32 i = 0; i < 20000; i++)
+				{
+					LLVector3 center(next_random(300.f) - 20.f, next_random(300.f) - 20.f, next_random(150.f));
+					F32 size = next_random(4.f) < 3.f ? next_random(4.f) : next_random(64.f);
+					LLVector3 radius(size * (0.2f + next_random(1.f)), size * (0.2f + next_random(1.f)), size);
+
+					S32 expected = far_clip ? camera.AABBInFrustum(center, radius) : camera.AABBInFrustumNoFarClip(center, radius);
+					S32 actual = frustum.AABBInFrustum(center, radius);
+					ensure_equals("same as LLCamera", actual, expected);
+					counts[actual]++;
+				}
+			}
+		}
+		// otherwise the test above proves nothing
+		ensure("some outside", counts[0] > 0);
+		ensure("some partly in", counts[1] > 0);
+		ensure("some fully in", counts[2] > 0);
+	}
+
+	template<> template<>
+	void octree_cull_object::test<2>()
+	{
+		// Split across a pool or not, the pass lists the same nodes in the
+		// same order as a serial traveler, for every tree in the pass.
+		build(20000);
+		LLWorkPool pool("cull test", 4);
+
+		for (S32 c = 0; c < 6; c++)
+		{
+			LLCamera cameras[2];
+			set_camera(cameras[0], LLVector3(next_random(256.f), next_random(256.f), 60.f),
+					   next_random(F_TWO_PI), 64.f + next_random(128.f));
+			set_camera(cameras[1], LLVector3(next_random(256.f), next_random(256.f), 60.f),
+					   next_random(F_TWO_PI), 64.f + next_random(128.f));
+			cameras[1].setUserClipPlane(LLPlane(LLVector3(0.f, 0.f, 1.f), -40.f));
+
+			ReferenceCull reference[2] = { ReferenceCull(cameras[0], TRUE), ReferenceCull(cameras[1], FALSE) };
+			reference[0].traverse(&mRoot);
+			reference[1].traverse(&mRoot);
+
+			TestCullPass serial;
+			TestCullPass parallel;
+			for (U32 t = 0; t < 2; t++)
+			{
+				serial.addCamera(&mRoot, cameras[t], t == 0);
+				parallel.addCamera(&mRoot, cameras[t], t == 0);
+			}
+			serial.cull(NULL);
+			parallel.cull(&pool);
+
+			for (U32 t = 0; t < 2; t++)
+			{
+				ensure("serial matches traveler", same_entries(serial.beginTree(t), serial.endTree(t), reference[t].mEntries));
+				ensure("pooled matches traveler", same_entries(parallel.beginTree(t), parallel.endTree(t), reference[t].mEntries));
+			}
+		}
+	}
+
+	template<> template<>
+	void octree_cull_object::test<3>()
+	{
+		// Cull timings on a 50k group partition, for comparing builds.
+		S32 groups = build(50000);
+		LLWorkPool pool("cull test", LLWorkPool::getDefaultThreadCount());
+
+		const S32 CULLS = 50;
+		LLCamera cameras[CULLS];
+		for (S32 c = 0; c < CULLS; c++)
+		{
+			set_camera(cameras[c], LLVector3(next_random(256.f), next_random(256.f), 40.f + next_random(40.f)),
+					   next_random(F_TWO_PI), 512.f);
+		}
+
+		LLTimer timer;
+		S32 visible = 0;
+		for (S32 c = 0; c < CULLS; c++)
+		{
+			ReferenceCull reference(cameras[c], TRUE);
+			reference.traverse(&mRoot);
+			visible += (S32)reference.mEntries.size();
+		}
+		F64 reference_time = timer.getElapsedTimeF64();
+
+		TestCullPass pass;
+		F64 pass_time[2] = { 0.0, 0.0 };
+		for (S32 p = 0; p < 2; p++)
+		{
+			timer.reset();
+			for (S32 c = 0; c < CULLS; c++)
+			{
+				pass.clear();
+				pass.mFrustums.clear();
+				pass.addCamera(&mRoot, cameras[c], TRUE);
+				pass.cull(p ? &pool : NULL);
+			}
+			pass_time[p] = timer.getElapsedTimeF64();
+		}
+
+		ensure("camera sees something", visible > 0);
+		llinfos << groups << " groups, " << visible / CULLS << " classified per cull: traveler "
+				<< reference_time * 1000.0 / CULLS << " ms, pass "
+				<< pass_time[0] * 1000.0 / CULLS << " ms, pass with " << pool.getNumThreads() << " workers "
+				<< pass_time[1] * 1000.0 / CULLS << " ms" << llendl;
+	}
+}
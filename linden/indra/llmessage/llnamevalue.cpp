@@ -534,7 +534,7 @@ LLNameValue::LLNameValue(const char *data)
 
 LLNameValue::~LLNameValue()
 {
-	mNVNameTable->removeString(mName);
+	// names stay pooled in mNVNameTable
 	mName = NULL;
 	
 	switch(mType)
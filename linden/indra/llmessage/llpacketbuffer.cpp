@@ -31,6 +31,7 @@
 #include "net.h"
 #include "timing.h"
 #include "llhost.h"
+#include "llmempool.h"
 
 ///////////////////////////////////////////////////////////
 
@@ -65,6 +66,23 @@ LLPacketBuffer::~LLPacketBuffer ()
 {
 }
 
+//static
+void* LLPacketBuffer::operator new(size_t size)
+{
+	void* ptr = LLMemPool::allocate(size, LLMemType::MTYPE_NETWORK);
+	if (!ptr)
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+//static
+void LLPacketBuffer::operator delete(void* ptr)
+{
+	LLMemPool::deallocate(ptr);
+}
+
 ///////////////////////////////////////////////////////////
 
 void LLPacketBuffer::init (S32 hSocket)
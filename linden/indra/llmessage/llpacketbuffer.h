@@ -38,6 +38,11 @@ public:
 	LLPacketBuffer(S32 hSocket);           // receive a packet
 	~LLPacketBuffer();
 
+	// Packet buffers are made and freed for every packet queued, so they
+	// come from LLMemPool and are counted as MTYPE_NETWORK.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr);
+
 	S32			getSize() const					{ return mSize; }
 	const char	*getData() const				{ return mData; }
 	LLHost		getHost() const					{ return mHost; }
@@ -62,7 +62,6 @@
 #include "llstoredmessage.h"
 
 const U32 MESSAGE_MAX_STRINGS_LENGTH = 64;
-const U32 MESSAGE_NUMBER_OF_HASH_BUCKETS = 8192;
 
 const S32 MESSAGE_MAX_PER_FRAME = 400;
 
@@ -72,11 +71,15 @@ public:
 	LLMessageStringTable();
 	~LLMessageStringTable();
 
+	// Safe from any thread.  Names match on their first
+	// MESSAGE_MAX_STRINGS_LENGTH - 1 characters.
 	char *getString(const char *str);
 
-	U32	 mUsed;
-	BOOL mEmpty[MESSAGE_NUMBER_OF_HASH_BUCKETS];
-	char mString[MESSAGE_NUMBER_OF_HASH_BUCKETS][MESSAGE_MAX_STRINGS_LENGTH];	/* Flawfinder: ignore */
+	// Every name seen so far, sorted.
+	void getStrings(std::vector<const char*>& strings) const;
+
+private:
+	LLStringPool mPool;
 };
 
 
@@ -29,27 +29,9 @@
 #include "llerror.h"
 #include "message.h"
 
-inline U32	message_hash_my_string(const char *str)
-{
-	U32 retval = 0;
-	while (*str++)
-	{
-		retval += *str;
-		retval <<= 1;
-	}
-	return (retval % MESSAGE_NUMBER_OF_HASH_BUCKETS);
-}
-
-
-
 LLMessageStringTable::LLMessageStringTable()
-:	mUsed(0)
+:	mPool(4096)		// comfortably more names than the template has
 {
-	for (U32 i = 0; i < MESSAGE_NUMBER_OF_HASH_BUCKETS; i++)
-	{
-		mEmpty[i] = TRUE;
-		mString[i][0] = 0;
-	}
 }
 
 
@@ -59,33 +41,22 @@ LLMessageStringTable::~LLMessageStringTable()
 
 char* LLMessageStringTable::getString(const char *str)
 {
-	U32 hash_value = message_hash_my_string(str);
-	while (!mEmpty[hash_value])
+	size_t length = 0;
+	while (length < MESSAGE_MAX_STRINGS_LENGTH - 1 && str[length])
 	{
-		if (!strncmp(str, mString[hash_value], MESSAGE_MAX_STRINGS_LENGTH))
-		{
-			return mString[hash_value];
-		}
-		else
-		{
-			hash_value++;
-			hash_value %= MESSAGE_NUMBER_OF_HASH_BUCKETS;
-		}
+		++length;
 	}
-	// not found, so add!
-	strncpy(mString[hash_value], str, MESSAGE_MAX_STRINGS_LENGTH);	/* Flawfinder: ignore */
-	mString[hash_value][MESSAGE_MAX_STRINGS_LENGTH - 1] = 0;
-	mEmpty[hash_value] = FALSE;
-	mUsed++;
-	if (mUsed >= MESSAGE_NUMBER_OF_HASH_BUCKETS - 1)
+	return mPool.intern(str, length)->mString;
+}
+
+
+void LLMessageStringTable::getStrings(std::vector<const char*>& strings) const
+{
+	std::vector<LLStringPool::Entry*> entries;
+	mPool.getEntries(entries);
+	strings.clear();
+	for (size_t i = 0; i < entries.size(); ++i)
 	{
-		U32 i;
-		llinfos << "Dumping string table before crashing on HashTable full!" << llendl;
-		for (i = 0; i < MESSAGE_NUMBER_OF_HASH_BUCKETS; i++)
-		{
-			llinfos << "Entry #" << i << ": " << mString[i] << llendl;
-		}
+		strings.push_back(entries[i]->mString);
 	}
-	return mString[hash_value];
 }
-
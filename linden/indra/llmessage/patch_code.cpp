@@ -199,6 +199,102 @@ void	end_patch_coding(LLBitPack &bitpack)
 	bitpack.flushBitPack();
 }
 
+#ifndef LL_BIG_ENDIAN
+// Number of leading zero bits in a byte, 8 for zero.
+static U8 sLeadingZeros[256];
+
+static struct LLLeadingZerosInit
+{
+	LLLeadingZerosInit()
+	{
+		for (S32 code = 0; code < 256; code++)
+		{
+			S32 zeros = 0;
+			while (zeros < 8 && !(code & (0x80 >> zeros)))
+			{
+				zeros++;
+			}
+			sLeadingZeros[code] = (U8)zeros;
+		}
+	}
+} sLeadingZerosInit;
+
+// Pulls bits out of an LLBitPack a word at a time instead of one by one.
+// sync() puts the LLBitPack in exactly the state that the same reads
+// through bitUnpack() would have left it in.
+class LLPatchBitReader
+{
+public:
+	LLPatchBitReader(LLBitPack &bitpack)
+	:	mBitPack(bitpack),
+		mStartLoad(bitpack.mLoad),
+		mStartLoadSize(bitpack.mLoadSize),
+		mStartBufferSize(bitpack.mBufferSize),
+		mNextByte(bitpack.mBufferSize),
+		mBits(0),
+		mCount(0),
+		mConsumed(0)
+	{
+		// Whatever is left of the current byte comes first.
+		if (mStartLoadSize)
+		{
+			mBits = (U64)bitpack.mLoad << 56;
+			mCount = mStartLoadSize;
+		}
+	}
+
+	// Tops up the window to at least 57 bits.
+	void refill()
+	{
+		while (mCount <= 56)
+		{
+			mBits |= (U64)getByte(mNextByte++) << (56 - mCount);
+			mCount += 8;
+		}
+	}
+
+	// n must be between 1 and 32, and no more than the bits refilled.
+	U32 peek(U32 n) const	{ return (U32)(mBits >> (64 - n)); }
+	void skip(U32 n)		{ mBits <<= n; mCount -= n; mConsumed += n; }
+	U32 read(U32 n)			{ U32 value = peek(n); skip(n); return value; }
+
+	void sync()
+	{
+		if (mConsumed <= mStartLoadSize)
+		{
+			mBitPack.mLoadSize = mStartLoadSize - mConsumed;
+			mBitPack.mLoad = (U8)(mStartLoad << mConsumed);
+		}
+		else
+		{
+			U32 bits = mConsumed - mStartLoadSize;
+			U32 bytes = (bits + 7) / 8;
+			U32 used = bits - (bytes - 1) * 8;
+			mBitPack.mBufferSize = mStartBufferSize + bytes;
+			mBitPack.mLoadSize = MAX_DATA_BITS - used;
+			mBitPack.mLoad = (U8)(getByte(mBitPack.mBufferSize - 1) << used);
+		}
+	}
+
+private:
+	// Reads past the end of the packet see zeros instead of whatever
+	// follows the buffer.
+	U8 getByte(U32 index) const
+	{
+		return index < mBitPack.mMaxSize ? mBitPack.mBuffer[index] : 0;
+	}
+
+	LLBitPack &mBitPack;
+	U32 mStartLoad;
+	U32 mStartLoadSize;
+	U32 mStartBufferSize;
+	U32 mNextByte;
+	U64 mBits;			// unread bits, left aligned
+	U32 mCount;			// number of valid bits in mBits
+	U32 mConsumed;		// bits read since construction
+};
+#endif
+
 void	init_patch_decoding(LLBitPack &bitpack)
 {
 	bitpack.resetBitPacking();
@@ -357,52 +453,51 @@ void	decode_patch(LLBitPack &bitpack, S32 *patches)
 		}
 	}
 #else
-	S32		i, j, patch_size = gPatchSize, wbits = gWordBits;
-	U32		temp;
-	for (i = 0; i < patch_size*patch_size; i++)
+	S32		i, j, count = gPatchSize*gPatchSize, wbits = gWordBits;
+	U32		code, value;
+	S32		run, shift, bits;
+	LLPatchBitReader reader(bitpack);
+
+	i = 0;
+	while (i < count)
 	{
-		temp = 0;
-		bitpack.bitUnpack((U8 *)&temp, 1);
-		if (temp)
+		// Every code below needs at most 3 + 17 bits.
+		reader.refill();
+		code = reader.peek(8);
+		if (!(code & 0x80))
 		{
-			// either 0 EOB or Value
-			temp = 0;
-			bitpack.bitUnpack((U8 *)&temp, 1);
-			if (temp)
+			// One or more zero coefficients, a single 0 bit each
+			run = llmin((S32)sLeadingZeros[code], count - i);
+			for (j = 0; j < run; j++)
 			{
-				// value
-				temp = 0;
-				bitpack.bitUnpack((U8 *)&temp, 1);
-				if (temp)
-				{
-					// negative
-					temp = 0;
-					bitpack.bitUnpack((U8 *)&temp, wbits);
-					patches[i] = temp;
-					patches[i] *= -1;
-				}
-				else
-				{
-					// positive
-					temp = 0;
-					bitpack.bitUnpack((U8 *)&temp, wbits);
-					patches[i] = temp;
-				}
+				patches[i++] = 0;
 			}
-			else
+			reader.skip(run);
+		}
+		else if (!(code & 0x40))
+		{
+			// 10: zero to the end of the patch
+			reader.skip(2);
+			for (j = i; j < count; j++)
 			{
-				for (j = i; j < patch_size*patch_size; j++)
-				{
-					patches[j] = 0;
-				}
-				return;
+				patches[j] = 0;
 			}
+			break;
 		}
 		else
 		{
-			patches[i] = 0;
+			// 110 positive, 111 negative, followed by wbits of magnitude
+			// that bitUnpack() would have filled in a byte at a time.
+			reader.skip(3);
+			value = 0;
+			for (shift = 0, bits = wbits; bits > 0; shift += 8, bits -= 8)
+			{
+				value |= reader.read(llmin(bits, 8)) << shift;
+			}
+			patches[i++] = (code & 0x20) ? -(S32)value : (S32)value;
 		}
 	}
+	reader.sync();
 #endif
 }
 
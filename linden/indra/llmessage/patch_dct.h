@@ -86,6 +86,7 @@ void get_patch_group_header(LLGroupHeader *gopp);
 void set_group_of_patch_header(LLGroupHeader *gopp);
 void init_patch_decompressor(S32 size);
 void decompress_patch(F32 *patch, S32 *cpatch, LLPatchHeader *ph);
+void decompress_patch(F32 *patch, S32 *cpatch, const LLPatchHeader *ph, S32 size, S32 stride);
 void decompress_patchv(LLVector3 *v, S32 *cpatch, LLPatchHeader *ph);
 
 #endif
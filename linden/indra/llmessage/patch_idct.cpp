@@ -29,6 +29,7 @@
 #include "llmath.h"
 //#include "vmath.h"
 #include "v3math.h"
+#include "llv4math.h"
 #include "patch_dct.h"
 
 LLGroupHeader	*gGOPP;
@@ -586,22 +587,91 @@ inline void idct_patch_large(F32 *block)
 	idct_line_large_slow(temp, block, 31);	
 }
 
+#if LL_VECTORIZE
+// Same sums as idct_column()/idct_line() and their _large_slow versions,
+// added up in the same order, but for four outputs at once.  The results
+// are bit for bit identical to the scalar code.
+void idct_patch_vectorized(F32 *block, S32 size)
+{
+	F32 temp[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+	const __m128 oo_sqrt2 = _mm_set1_ps(OO_SQRT2);
+	const __m128 oosob = _mm_set1_ps(2.f/size);
+	S32 n, u, column, line;
+
+	// Columns: temp[n][c] = sum over u of block[u][c] * cos[u][n]
+	for (n = 0; n < size; n++)
+	{
+		const F32 *pcp = gPatchICosines + n;
+		F32 *out = temp + n*size;
+		for (column = 0; column < size; column += 4)
+		{
+			const F32 *in = block + column;
+			__m128 total = _mm_mul_ps(oo_sqrt2, _mm_loadu_ps(in));
+			for (u = 1; u < size; u++)
+			{
+				total = _mm_add_ps(total, _mm_mul_ps(_mm_loadu_ps(in + u*size),
+													 _mm_set1_ps(pcp[u*size])));
+			}
+			_mm_storeu_ps(out + column, total);
+		}
+	}
+
+	// Lines: block[l][n] = sum over u of temp[l][u] * cos[u][n], scaled
+	for (line = 0; line < size; line++)
+	{
+		const F32 *in = temp + line*size;
+		F32 *out = block + line*size;
+		for (n = 0; n < size; n += 4)
+		{
+			const F32 *pcp = gPatchICosines + n;
+			__m128 total = _mm_mul_ps(oo_sqrt2, _mm_set1_ps(in[0]));
+			for (u = 1; u < size; u++)
+			{
+				total = _mm_add_ps(total, _mm_mul_ps(_mm_set1_ps(in[u]),
+													 _mm_loadu_ps(pcp + u*size)));
+			}
+			_mm_storeu_ps(out + n, _mm_mul_ps(total, oosob));
+		}
+	}
+}
+#endif
+
+inline void idct_patch_any(F32 *block, S32 size)
+{
+#if LL_VECTORIZE
+	idct_patch_vectorized(block, size);
+#else
+	if (size == 16)
+	{
+		idct_patch(block);
+	}
+	else
+	{
+		idct_patch_large(block);
+	}
+#endif
+}
+
 S32	gDitherNoise = 128;
 
 void decompress_patch(F32 *patch, S32 *cpatch, LLPatchHeader *ph)
+{
+	decompress_patch(patch, cpatch, ph, gGOPP->patch_size, gGOPP->stride);
+}
+
+// Only reads the tables built by init_patch_decompressor(size), so several
+// threads may decode patches of the same size at once.
+void decompress_patch(F32 *patch, S32 *cpatch, const LLPatchHeader *ph, S32 size, S32 stride)
 {
 	S32		i, j;
 
 	F32		block[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE], *tblock = block;
 	F32		*tpatch;
 
-	LLGroupHeader	*gopp = gGOPP;
-	S32		size = gopp->patch_size;
 	F32		range = ph->range;
 	S32		prequant = (ph->quant_wbits >> 4) + 2;
 	S32		quantize = 1<<prequant;
 	F32		hmin = ph->dc_offset;
-	S32		stride = gopp->stride;
 
 	F32		ooq = 1.f/(F32)quantize;
 	F32     *dq = gPatchDequantizeTable;
@@ -615,14 +685,7 @@ void decompress_patch(F32 *patch, S32 *cpatch, LLPatchHeader *ph)
 		*(tblock++) = *(cpatch + *(decopy_matrix++))*(*dq++);
 	}
 
-	if (size == 16)
-	{
-		idct_patch(block);
-	}
-	else
-	{
-		idct_patch_large(block);
-	}
+	idct_patch_any(block, size);
 
 	for (j = 0; j < size; j++)
 	{
@@ -666,10 +729,7 @@ void decompress_patchv(LLVector3 *v, S32 *cpatch, LLPatchHeader *ph)
 		*(tblock++) = *(cpatch + *(decopy_matrix++))*(*dq++);
 	}
 
-	if (size == 16)
-		idct_patch(block);
-	else
-		idct_patch_large(block);
+	idct_patch_any(block, size);
 
 	for (j = 0; j < size; j++)
 	{
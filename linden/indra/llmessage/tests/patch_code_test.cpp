@@ -0,0 +1,320 @@
+/**
+ * @file patch_code_test.cpp
+ * @brief Golden tests for the terrain patch decoder and inverse DCT.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmath.h"
+#include "lltimer.h"
+#include "bitpack.h"
+
+#include "../patch_dct.h"
+#include "../patch_code.h"
+
+#include "../test/lltut.h"
+
+// Tables built by init_patch_decompressor()
+extern F32 gPatchICosines[];
+extern F32 gPatchDequantizeTable[];
+extern S32 gDeCopyMatrix[];
+
+namespace
+{
+	const S32 BUFFER_SIZE = 64 * 1024;
+
+	// Deterministic, so a failure can be reproduced.
+	U32 sSeed = 1;
+	S32 next_random(S32 range)
+	{
+		sSeed = sSeed * 1103515245 + 12345;
+		return (S32)((sSeed >> 8) % (U32)range);
+	}
+
+	// A patch that looks like real data: large low frequency terms, a few
+	// sparse high frequency ones, and a tail of zeros for the EOB code.
+	void make_patch(S32 *patch, S32 size)
+	{
+		S32 count = size * size;
+		S32 tail = next_random(count);
+		for (S32 i = 0; i < count; i++)
+		{
+			S32 value = 0;
+			if (i < tail && next_random(4) != 0)
+			{
+				S32 range = (i < 8) ? 8000 : 64;
+				value = next_random(2 * range + 1) - range;
+			}
+			patch[i] = value;
+		}
+	}
+
+	// Writes a group of patches the way the simulator does.
+	S32 encode_patches(U8 *buffer, S32 size, S32 num_patches, S32 *coefficients)
+	{
+		LLBitPack bitpack(buffer, BUFFER_SIZE);
+		init_patch_coding(bitpack);
+
+		LLGroupHeader gh;
+		gh.stride = 256;
+		gh.patch_size = size;
+		gh.layer_type = 'L';
+		code_patch_group_header(bitpack, &gh);
+
+		for (S32 p = 0; p < num_patches; p++)
+		{
+			S32 *patch = coefficients + p * size * size;
+			make_patch(patch, size);
+
+			LLPatchHeader ph;
+			ph.dc_offset = 20.f + p;
+			ph.range = 1 + next_random(200);
+			ph.quant_wbits = 0x8d;	// room for the 8000s above
+			ph.patchids = p;
+			code_patch_header(bitpack, &ph, patch);
+			code_patch(bitpack, patch, 0);
+		}
+		code_end_of_data(bitpack);
+		end_patch_coding(bitpack);
+		return bitpack.mBufferSize;
+	}
+
+	// The decoder as it was, one bitUnpack() per bit.
+	void reference_decode_patch(LLBitPack &bitpack, S32 *patches, S32 size, S32 wbits)
+	{
+		U32 temp;
+		for (S32 i = 0; i < size * size; i++)
+		{
+			temp = 0;
+			bitpack.bitUnpack((U8 *)&temp, 1);
+			if (!temp)
+			{
+				patches[i] = 0;
+				continue;
+			}
+			temp = 0;
+			bitpack.bitUnpack((U8 *)&temp, 1);
+			if (!temp)
+			{
+				for (S32 j = i; j < size * size; j++)
+				{
+					patches[j] = 0;
+				}
+				return;
+			}
+			temp = 0;
+			bitpack.bitUnpack((U8 *)&temp, 1);
+			BOOL negative = temp;
+			temp = 0;
+			bitpack.bitUnpack((U8 *)&temp, wbits);
+			patches[i] = negative ? -(S32)temp : (S32)temp;
+		}
+	}
+
+	// The inverse DCT as it was, summed in the same order.
+	void reference_decompress_patch(F32 *patch, const S32 *cpatch, const LLPatchHeader *ph,
+									S32 size, S32 stride)
+	{
+		F32 block[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+		F32 temp[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+		S32 i, n, u;
+
+		for (i = 0; i < size * size; i++)
+		{
+			block[i] = cpatch[gDeCopyMatrix[i]] * gPatchDequantizeTable[i];
+		}
+
+		for (S32 column = 0; column < size; column++)
+		{
+			for (n = 0; n < size; n++)
+			{
+				F32 total = OO_SQRT2 * block[column];
+				for (u = 1; u < size; u++)
+				{
+					total += block[u*size + column] * gPatchICosines[u*size + n];
+				}
+				temp[n*size + column] = total;
+			}
+		}
+
+		F32 oosob = 2.f / size;
+		for (S32 line = 0; line < size; line++)
+		{
+			for (n = 0; n < size; n++)
+			{
+				F32 total = OO_SQRT2 * temp[line*size];
+				for (u = 1; u < size; u++)
+				{
+					total += temp[line*size + u] * gPatchICosines[u*size + n];
+				}
+				block[line*size + n] = total * oosob;
+			}
+		}
+
+		S32 prequant = (ph->quant_wbits >> 4) + 2;
+		F32 mult = (1.f / (F32)(1 << prequant)) * ph->range;
+		F32 addval = mult * (F32)(1 << (prequant - 1)) + ph->dc_offset;
+		for (S32 j = 0; j < size; j++)
+		{
+			for (i = 0; i < size; i++)
+			{
+				patch[j*stride + i] = block[j*size + i] * mult + addval;
+			}
+		}
+	}
+}
+
+namespace tut
+{
+	struct patch_code_data
+	{
+		U8 mBuffer[BUFFER_SIZE];
+		S32 mCoefficients[64*LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+	};
+	typedef test_group<patch_code_data> patch_code_test;
+	typedef patch_code_test::object patch_code_object;
+	tut::patch_code_test patch_code("patch_code");
+
+	template<> template<>
+	void patch_code_object::test<1>()
+	{
+		// The decoder reproduces the bitUnpack() decoder, including where
+		// it leaves the bit stream after every patch.
+		const S32 sizes[2] = { NORMAL_PATCH_SIZE, LARGE_PATCH_SIZE };
+		for (S32 s = 0; s < 2; s++)
+		{
+			S32 size = sizes[s];
+			S32 num_patches = 32;
+			S32 bytes = encode_patches(mBuffer, size, num_patches, mCoefficients);
+
+			LLBitPack fast(mBuffer, bytes);
+			LLBitPack reference(mBuffer, bytes);
+			LLGroupHeader gh;
+			decode_patch_group_header(fast, &gh);
+			decode_patch_group_header(reference, &gh);
+			ensure_equals("patch size", (S32)gh.patch_size, size);
+
+			for (S32 p = 0; p < num_patches; p++)
+			{
+				LLPatchHeader ph, ref_ph;
+				decode_patch_header(reference, &ref_ph);
+				decode_patch_header(fast, &ph);
+				ensure_equals("patch id", (S32)ph.patchids, p);
+
+				S32 expected[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+				S32 actual[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+				reference_decode_patch(reference, expected, size, (ph.quant_wbits & 0xf) + 2);
+				decode_patch(fast, actual);
+
+				for (S32 i = 0; i < size * size; i++)
+				{
+					ensure_equals("matches encoder", actual[i], mCoefficients[p*size*size + i]);
+					ensure_equals("matches reference", actual[i], expected[i]);
+				}
+				ensure_equals("buffer position", fast.mBufferSize, reference.mBufferSize);
+				ensure_equals("bits left", fast.mLoadSize, reference.mLoadSize);
+				ensure_equals("load", (S32)fast.mLoad, (S32)reference.mLoad);
+			}
+
+			LLPatchHeader end;
+			decode_patch_header(fast, &end);
+			ensure_equals("end of patches", (S32)end.quant_wbits, (S32)END_OF_PATCHES);
+		}
+	}
+
+	template<> template<>
+	void patch_code_object::test<2>()
+	{
+		// The inverse DCT is bit for bit identical to the scalar version.
+		const S32 sizes[2] = { NORMAL_PATCH_SIZE, LARGE_PATCH_SIZE };
+		for (S32 s = 0; s < 2; s++)
+		{
+			S32 size = sizes[s];
+			S32 stride = size + 1;
+			init_patch_decompressor(size);
+
+			for (S32 p = 0; p < 16; p++)
+			{
+				S32 cpatch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+				make_patch(cpatch, size);
+
+				LLPatchHeader ph;
+				ph.dc_offset = 21.5f;
+				ph.range = 1 + next_random(300);
+				ph.quant_wbits = (U8)((next_random(4) << 4) | 0x0a);
+				ph.patchids = 0;
+
+				F32 expected[LARGE_PATCH_SIZE*(LARGE_PATCH_SIZE + 1)];
+				F32 actual[LARGE_PATCH_SIZE*(LARGE_PATCH_SIZE + 1)];
+				reference_decompress_patch(expected, cpatch, &ph, size, stride);
+				decompress_patch(actual, cpatch, &ph, size, stride);
+
+				for (S32 j = 0; j < size; j++)
+				{
+					for (S32 i = 0; i < size; i++)
+					{
+						ensure("height matches", actual[j*stride + i] == expected[j*stride + i]);
+					}
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void patch_code_object::test<3>()
+	{
+		// Throughput of unpack + inverse DCT, for comparing builds.
+		const S32 num_patches = 64;
+		const S32 iterations = 50;
+		S32 bytes = encode_patches(mBuffer, NORMAL_PATCH_SIZE, num_patches, mCoefficients);
+		init_patch_decompressor(NORMAL_PATCH_SIZE);
+
+		F32 heights[NORMAL_PATCH_SIZE*NORMAL_PATCH_SIZE];
+		S32 cpatch[NORMAL_PATCH_SIZE*NORMAL_PATCH_SIZE];
+		S32 decoded = 0;
+		LLTimer timer;
+		for (S32 iter = 0; iter < iterations; iter++)
+		{
+			LLBitPack bitpack(mBuffer, bytes);
+			LLGroupHeader gh;
+			decode_patch_group_header(bitpack, &gh);
+			while (true)
+			{
+				LLPatchHeader ph;
+				decode_patch_header(bitpack, &ph);
+				if (ph.quant_wbits == END_OF_PATCHES)
+				{
+					break;
+				}
+				decode_patch(bitpack, cpatch);
+				decompress_patch(heights, cpatch, &ph, NORMAL_PATCH_SIZE, NORMAL_PATCH_SIZE);
+				decoded++;
+			}
+		}
+		F32 elapsed = timer.getElapsedTimeF32();
+		ensure_equals("decoded every patch", decoded, num_patches * iterations);
+		llinfos << "Decoded " << decoded << " patches in " << elapsed << " s, "
+				<< (elapsed > 0.f ? decoded / elapsed : 0.f) << " patches/s" << llendl;
+	}
+}
@@ -33,6 +33,7 @@
 
 #include "llerror.h"
 #include "llimage.h"
+#include "llimagedxt.h"
 
 #include "llmath.h"
 #include "llgl.h"
@@ -1122,7 +1123,7 @@ BOOL LLImageGL::createGLTexture()
 	return TRUE ;
 }
 
-BOOL LLImageGL::createGLTexture(S32 discard_level, const LLImageRaw* imageraw, S32 usename/*=0*/, BOOL to_create, S32 category)
+BOOL LLImageGL::createGLTexture(S32 discard_level, const LLImageRaw* imageraw, S32 usename/*=0*/, BOOL to_create, S32 category, const LLImageGLPrepared* prepared)
 {
 	if (gGLManager.mIsDisabled)
 	{
@@ -1192,10 +1193,62 @@ BOOL LLImageGL::createGLTexture(S32 discard_level, const LLImageRaw* imageraw, S
 	}
 
 	setCategory(category) ;
+
+	if (prepared && prepared->isFor(imageraw) && mUseMipMaps && !mHasExplicitFormat &&
+		prepared->getNumLevels() > mMaxDiscardLevel - discard_level)
+	{
+		return createGLTexture(discard_level, prepared, usename);
+	}
+
  	const U8* rawdata = imageraw->getData();
 	return createGLTexture(discard_level, rawdata, FALSE, usename);
 }
 
+BOOL LLImageGL::createGLTexture(S32 discard_level, const LLImageGLPrepared* prepared, S32 usename)
+{
+	// the alpha and pick mask scans were done along with the mips
+	BOOL needs_alpha = mNeedsAlphaAndPickMask;
+	mNeedsAlphaAndPickMask = FALSE;
+	BOOL res;
+	if (prepared->getCompressedData() && gGLManager.mHasCompressedTextures)
+	{
+		// Only for this upload; read backs and later uploads from raw
+		// data still want the uncompressed format.
+		LLGLint format_internal = mFormatInternal;
+		LLGLenum format_primary = mFormatPrimary;
+		mFormatInternal = mFormatPrimary = prepared->getCompressedFormat();
+		res = createGLTexture(discard_level, prepared->getCompressedData(), TRUE, usename);
+		mFormatInternal = format_internal;
+		mFormatPrimary = format_primary;
+	}
+	else
+	{
+		res = createGLTexture(discard_level, prepared->getData(), TRUE, usename);
+	}
+	mNeedsAlphaAndPickMask = needs_alpha;
+
+	if (mNeedsAlphaAndPickMask)
+	{
+		S32 w = prepared->getWidth();
+		S32 h = prepared->getHeight();
+		if (prepared->getAlphaOffset() == mAlphaOffset && prepared->getAlphaStride() == mAlphaStride)
+		{
+			mIsMask = prepared->getIsMask();
+		}
+		else
+		{
+			analyzeAlpha(prepared->getData(), w, h);
+		}
+
+		delete [] mPickMask;
+		mPickMask = prepared->copyPickMask();
+		mPickMaskWidth = mPickMask ? w/2 : 0;
+		mPickMaskHeight = mPickMask ? h/2 : 0;
+	}
+
+	return res;
+}
+
 BOOL LLImageGL::createGLTexture(S32 discard_level, const U8* data_in, BOOL data_hasmips, S32 usename)
 {
 	llassert(data_in);
@@ -1211,6 +1264,8 @@ BOOL LLImageGL::createGLTexture(S32 discard_level, const U8* data_in, BOOL data_
 	{
 		// This will only be true if the size has not changed
 		setImage(data_in, data_hasmips);
+		// but the format may have, to or from block compressed
+		setTextureMemory(getMipBytes(discard_level));
 		return TRUE;
 	}
 	
@@ -1263,29 +1318,42 @@ BOOL LLImageGL::createGLTexture(S32 discard_level, const U8* data_in, BOOL data_
 
 	if (old_name != 0)
 	{
-		sGlobalTextureMemoryInBytes -= mTextureMemory;
+		LLImageGL::deleteTextures(1, &old_name);
 
+		stop_glerror();
+	}
+
+	// in the format just uploaded, block compressed or not
+	setTextureMemory(getMipBytes(discard_level));
+	mTexelsInGLTexture = getWidth() * getHeight() ;
+
+	// mark this as bound at this point, so we don't throw it out immediately
+	mLastBindTime = sLastFrameTime;
+	return TRUE;
+}
+
+void LLImageGL::setTextureMemory(S32 bytes)
+{
+	if (bytes == mTextureMemory)
+	{
+		return;
+	}
+
+	if (mTextureMemory)
+	{
+		sGlobalTextureMemoryInBytes -= mTextureMemory;
 		if(gAuditTexture)
 		{
 			decTextureCounter(mTextureMemory, mComponents, mCategory) ;
 		}
-
-		LLImageGL::deleteTextures(1, &old_name);
-
-		stop_glerror();
 	}
 
-	mTextureMemory = getMipBytes(discard_level);
+	mTextureMemory = bytes;
 	sGlobalTextureMemoryInBytes += mTextureMemory;
-	mTexelsInGLTexture = getWidth() * getHeight() ;
-
 	if(gAuditTexture)
 	{
 		incTextureCounter(mTextureMemory, mComponents, mCategory) ;
 	}
-	// mark this as bound at this point, so we don't throw it out immediately
-	mLastBindTime = sLastFrameTime;
-	return TRUE;
 }
 
 BOOL LLImageGL::readBackRaw(S32 discard_level, LLImageRaw* imageraw, bool compressed_ok) const
@@ -1660,6 +1728,12 @@ void LLImageGL::analyzeAlpha(const void* data_in, U32 w, U32 h)
 		return ;
 	}
 
+	mIsMask = calcIsMask(data_in, w, h, mAlphaOffset, mAlphaStride);
+}
+
+//static
+BOOL LLImageGL::calcIsMask(const void* data_in, U32 w, U32 h, S32 alpha_offset, S32 alpha_stride)
+{
 	U32 length = w * h;
 	U32 alphatotal = 0;
 	
@@ -1675,7 +1749,7 @@ void LLImageGL::analyzeAlpha(const void* data_in, U32 w, U32 h)
 	{
 		llassert(w%2 == 0);
 		llassert(h%2 == 0);
-		const GLubyte* rowstart = ((const GLubyte*) data_in) + mAlphaOffset;
+		const GLubyte* rowstart = ((const GLubyte*) data_in) + alpha_offset;
 		for (U32 y = 0; y < h; y+=2)
 		{
 			const GLubyte* current = rowstart;
@@ -1683,14 +1757,14 @@ void LLImageGL::analyzeAlpha(const void* data_in, U32 w, U32 h)
 			{
 				const U32 s1 = current[0];
 				alphatotal += s1;
-				const U32 s2 = current[w * mAlphaStride];
+				const U32 s2 = current[w * alpha_stride];
 				alphatotal += s2;
-				current += mAlphaStride;
+				current += alpha_stride;
 				const U32 s3 = current[0];
 				alphatotal += s3;
-				const U32 s4 = current[w * mAlphaStride];
+				const U32 s4 = current[w * alpha_stride];
 				alphatotal += s4;
-				current += mAlphaStride;
+				current += alpha_stride;
 
 				++sample[s1/16];
 				++sample[s2/16];
@@ -1702,19 +1776,19 @@ void LLImageGL::analyzeAlpha(const void* data_in, U32 w, U32 h)
 				sample[asum/(16*4)] += 4;
 			}
 			
-			rowstart += 2 * w * mAlphaStride;
+			rowstart += 2 * w * alpha_stride;
 		}
 		length *= 2; // we sampled everything twice, essentially
 	}
 	else
 	{
-		const GLubyte* current = ((const GLubyte*) data_in) + mAlphaOffset;
+		const GLubyte* current = ((const GLubyte*) data_in) + alpha_offset;
 		for (U32 i = 0; i < length; i++)
 		{
 			const U32 s1 = *current;
 			alphatotal += s1;
 			++sample[s1/16];
-			current += mAlphaStride;
+			current += alpha_stride;
 		}
 	}
 	
@@ -1745,12 +1819,9 @@ void LLImageGL::analyzeAlpha(const void* data_in, U32 w, U32 h)
 	    (lowerhalftotal == length && alphatotal != 0) || // all close to transparent but not all totally transparent, or
 	    (upperhalftotal == length && alphatotal != 255*length)) // all close to opaque but not all totally opaque
 	{
-		mIsMask = FALSE; // not suitable for masking
-	}
-	else
-	{
-		mIsMask = TRUE;
+		return FALSE; // not suitable for masking
 	}
+	return TRUE;
 }
 
 //----------------------------------------------------------------------------
@@ -1772,16 +1843,22 @@ void LLImageGL::updatePickMask(S32 width, S32 height, const U8* data_in)
 		return;
 	}
 
+	mPickMask = createPickMask(width, height, data_in);
+	mPickMaskWidth = width/2;
+	mPickMaskHeight = height/2;
+}
+
+//static
+U8* LLImageGL::createPickMask(S32 width, S32 height, const U8* data_in)
+{
 	U32 pick_width = width/2 + 1;
 	U32 pick_height = height/2 + 1;
 
 	U32 size = pick_width * pick_height;
 	size = (size + 7) / 8; // pixelcount-to-bits
-	mPickMask = new U8[size];
-	mPickMaskWidth = pick_width - 1;
-	mPickMaskHeight = pick_height - 1;
+	U8* pick_mask = new U8[size];
 
-	memset(mPickMask, 0, sizeof(U8) * size);
+	memset(pick_mask, 0, sizeof(U8) * size);
 
 	U32 pick_bit = 0;
 	
@@ -1797,12 +1874,14 @@ void LLImageGL::updatePickMask(S32 width, S32 height, const U8* data_in)
 				U32 pick_offset = pick_bit%8;
 				llassert(pick_idx < size);
 
-				mPickMask[pick_idx] |= 1 << pick_offset;
+				pick_mask[pick_idx] |= 1 << pick_offset;
 			}
 			
 			++pick_bit;
 		}
 	}
+
+	return pick_mask;
 }
 
 BOOL LLImageGL::getMask(const LLVector2 &tc)
@@ -1991,3 +2070,130 @@ void LLImageGL::resetCurTexSizebar()
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,  nummips);
 */  
+
+//============================================================================
+
+LLImageGLPrepared::LLImageGLPrepared(const LLImageRaw* raw, LLImageDXT* compressed)
+:	mRaw(raw),
+	mWidth(raw->getWidth()),
+	mHeight(raw->getHeight()),
+	mComponents(raw->getComponents()),
+	mNumLevels(0),
+	mAlphaOffset(-1),
+	mAlphaStride(0),
+	mIsMask(FALSE),
+	mPickMask(NULL),
+	mPickMaskSize(0),
+	mCompressedData(NULL),
+	mCompressedFormat(0)
+{
+	const U8* top = raw->getData();
+	if (!top || mWidth < 1 || mHeight < 1 || mComponents < 1 || mComponents > 4)
+	{
+		return;
+	}
+
+	// DXR files keep the smaller levels before the larger, as we do
+	if (compressed && compressed->getDiscardLevel() >= 0 &&
+		(compressed->getWidth() >> compressed->getDiscardLevel()) == mWidth &&
+		(compressed->getHeight() >> compressed->getDiscardLevel()) == mHeight)
+	{
+		switch (compressed->getFileFormat())
+		{
+		  case LLImageDXT::FORMAT_DXR1:
+			mCompressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+			break;
+		  case LLImageDXT::FORMAT_DXR5:
+			mCompressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+			break;
+		  default:
+			break;
+		}
+		if (mCompressedFormat)
+		{
+			mCompressed = compressed;
+			mCompressedData = compressed->getData() + compressed->getMipOffset(compressed->getDiscardLevel());
+		}
+	}
+
+	// as many levels as LLImageGL::setSize() allows at any discard level
+	mNumLevels = 1;
+	for (S32 w = mWidth, h = mHeight; w > 1 && h > 1 && mNumLevels <= MAX_DISCARD_LEVEL; w >>= 1, h >>= 1)
+	{
+		mNumLevels++;
+	}
+
+	S32 total = 0;
+	for (S32 i = 0; i < mNumLevels; i++)
+	{
+		total += getLevelBytes(i);
+	}
+	mData.resize(total);
+
+	U8* level = &mData[0] + total - getLevelBytes(0);
+	memcpy(level, top, mWidth * mHeight * mComponents);
+	for (S32 i = 1; i < mNumLevels; i++)
+	{
+		U8* next = level - getLevelBytes(i);
+		LLImageBase::generateMip(level, next, mWidth >> i, mHeight >> i, mComponents);
+		level = next;
+	}
+
+	// the offsets LLImageGL::calcAlphaChannelOffsetAndStride() comes up
+	// with for the default formats; RGB has no alpha
+	if (mComponents != 3)
+	{
+		mAlphaStride = mComponents;
+		mAlphaOffset = mComponents - 1;
+		mIsMask = LLImageGL::calcIsMask(top, mWidth, mHeight, mAlphaOffset, mAlphaStride);
+	}
+
+	// only RGBA textures get pick masks
+	if (mComponents == 4)
+	{
+		mPickMask = LLImageGL::createPickMask(mWidth, mHeight, top);
+		mPickMaskSize = ((mWidth/2 + 1) * (mHeight/2 + 1) + 7) / 8;
+	}
+}
+
+LLImageGLPrepared::~LLImageGLPrepared()
+{
+	delete [] mPickMask;
+}
+
+BOOL LLImageGLPrepared::isFor(const LLImageRaw* raw) const
+{
+	return mNumLevels > 0 && raw == mRaw && raw->getWidth() == mWidth &&
+		raw->getHeight() == mHeight && raw->getComponents() == mComponents;
+}
+
+S32 LLImageGLPrepared::getLevelBytes(S32 level) const
+{
+	// rounded up as LLImageGL::dataFormatBytes() does
+	return ((mWidth >> level) * (mHeight >> level) * mComponents + 3) & ~3;
+}
+
+S32 LLImageGLPrepared::getUploadBytes() const
+{
+	if (!mCompressedData || !gGLManager.mHasCompressedTextures)
+	{
+		return getDataSize();
+	}
+	S32 bytes = 0;
+	for (S32 i = 0; i < mNumLevels; i++)
+	{
+		bytes += LLImageGL::dataFormatBytes(mCompressedFormat, mWidth >> i, mHeight >> i);
+	}
+	return bytes;
+}
+
+U8* LLImageGLPrepared::copyPickMask() const
+{
+	if (!mPickMask)
+	{
+		return NULL;
+	}
+	U8* pick_mask = new U8[mPickMaskSize];
+	memcpy(pick_mask, mPickMask, mPickMaskSize);
+	return pick_mask;
+}
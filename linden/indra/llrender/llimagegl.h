@@ -37,6 +37,8 @@
 
 #include "llrender.h"
 class LLTextureAtlas ;
+class LLImageGLPrepared;
+class LLImageDXT;
 #define BYTES_TO_MEGA_BYTES(x) ((x) >> 20)
 #define MEGA_BYTES_TO_BYTES(x) ((x) << 20)
 
@@ -76,6 +78,10 @@ public:
 	static BOOL create(LLPointer<LLImageGL>& dest, BOOL usemipmaps = TRUE);
 	static BOOL create(LLPointer<LLImageGL>& dest, U32 width, U32 height, U8 components, BOOL usemipmaps = TRUE);
 	static BOOL create(LLPointer<LLImageGL>& dest, const LLImageRaw* imageraw, BOOL usemipmaps = TRUE);
+
+	// The scans behind analyzeAlpha() and updatePickMask(), safe on any thread
+	static BOOL calcIsMask(const void* data_in, U32 w, U32 h, S32 alpha_offset, S32 alpha_stride);
+	static U8* createPickMask(S32 width, S32 height, const U8* data_in);
 		
 public:
 	LLImageGL(BOOL usemipmaps = TRUE);
@@ -101,8 +107,10 @@ public:
 	static void setManualImage(U32 target, S32 miplevel, S32 intformat, S32 width, S32 height, U32 pixformat, U32 pixtype, const void *pixels);
 
 	BOOL createGLTexture() ;
+	// If prepared was made from imageraw, its mips and alpha analysis are
+	// used rather than being worked out here
 	BOOL createGLTexture(S32 discard_level, const LLImageRaw* imageraw, S32 usename = 0, BOOL to_create = TRUE, 
-		S32 category = sMaxCatagories - 1);
+		S32 category = sMaxCatagories - 1, const LLImageGLPrepared* prepared = NULL);
 	BOOL createGLTexture(S32 discard_level, const U8* data, BOOL data_hasmips = FALSE, S32 usename = 0);
 	void setImage(const LLImageRaw* imageraw);
 	void setImage(const U8* data_in, BOOL data_hasmips = FALSE);
@@ -179,6 +187,11 @@ public:
 	BOOL preAddToAtlas(S32 discard_level, const LLImageRaw* raw_image);
 	void postAddToAtlas() ;	
 
+private:
+	BOOL createGLTexture(S32 discard_level, const LLImageGLPrepared* prepared, S32 usename);
+	// Moves the global and audit counts from mTextureMemory to bytes
+	void setTextureMemory(S32 bytes);
+
 public:
 	// Various GL/Rendering options
 	S32 mTextureMemory;
@@ -303,4 +316,67 @@ public:
 };
 
 extern BOOL gAuditTexture;
+//============================================================================
+// LLImageGLPrepared
+//
+// The part of LLImageGL::setImage() that doesn't need GL, done ahead of time
+// for a raw image in the default format for its number of components: the
+// mip chain, laid out the way createGLTexture() takes data_hasmips input,
+// and the alpha mask and pick mask scans of the top level.  Built on the
+// thread that decoded the image, so the main thread only has the uploads.
+
+class LLImageGLPrepared : public LLThreadSafeRefCount
+{
+public:
+	// compressed, if given, is raw block compressed by LLImageDXT::encodeCompressed()
+	LLImageGLPrepared(const LLImageRaw* raw, LLImageDXT* compressed = NULL);
+
+	// TRUE if this was made from raw, as raw is now
+	BOOL isFor(const LLImageRaw* raw) const;
+
+	S32 getWidth() const				{ return mWidth; }
+	S32 getHeight() const				{ return mHeight; }
+	S32 getComponents() const			{ return mComponents; }
+	S32 getNumLevels() const			{ return mNumLevels; }
+	S32 getDataSize() const				{ return (S32) mData.size(); }
+
+	// The top level; each smaller level is stored right before the one above it
+	const U8* getData() const			{ return &mData[0] + mData.size() - getLevelBytes(0); }
+	S32 getLevelBytes(S32 level) const;
+
+	S32 getAlphaOffset() const			{ return mAlphaOffset; }
+	S32 getAlphaStride() const			{ return mAlphaStride; }
+	BOOL getIsMask() const				{ return mIsMask; }
+
+	// A copy of the pick mask, for the LLImageGL to own, or NULL
+	U8* copyPickMask() const;
+
+	// The top level block compressed, laid out like getData(), or NULL
+	const U8* getCompressedData() const	{ return mCompressedData; }
+	S32 getCompressedFormat() const		{ return mCompressedFormat; }
+
+	// What LLImageGL::createGLTexture() hands GL: the compressed levels
+	// if there are any and GL takes them, else getDataSize()
+	S32 getUploadBytes() const;
+
+protected:
+	~LLImageGLPrepared();
+
+private:
+	const LLImageRaw* mRaw;		// only compared against, never dereferenced
+	S32 mWidth;
+	S32 mHeight;
+	S32 mComponents;
+	S32 mNumLevels;
+	std::vector<U8> mData;
+	S32 mAlphaOffset;			// -1 if there's no alpha to scan
+	S32 mAlphaStride;
+	BOOL mIsMask;
+	U8* mPickMask;
+	U32 mPickMaskSize;
+	LLPointer<LLImageDXT> mCompressed;
+	const U8* mCompressedData;
+	S32 mCompressedFormat;
+};
+
 #endif // LL_LLIMAGEGL_H
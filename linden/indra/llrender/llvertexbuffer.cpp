@@ -56,9 +56,161 @@ BOOL LLVertexBuffer::sIBOActive = FALSE;
 U32 LLVertexBuffer::sAllocatedBytes = 0;
 BOOL LLVertexBuffer::sMapped = FALSE;
 BOOL LLVertexBuffer::sUseStreamDraw = TRUE;
+BOOL LLVertexBuffer::sUseStreamRing = TRUE;
+BOOL LLVertexBuffer::sRingBound = FALSE;
+U32 LLVertexBuffer::sFrameBindCount = 0;
+U32 LLVertexBuffer::sFrameUploadBytes = 0;
 
 std::vector<U32> LLVertexBuffer::sDeleteList;
 
+//============================================================================
+// LLStreamRing
+//
+// One large vertex buffer and one large index buffer that stream draw
+// buffers are copied into, back to back, just before they're drawn.  When
+// either fills up the ring wraps: both GL buffers are orphaned so the driver
+// can hand back fresh storage without waiting on draws still reading the old,
+// and the epoch moves on so every buffer knows its copy is gone.
+
+class LLStreamRing
+{
+public:
+	LLStreamRing()
+	:	mEpoch(1),
+		mOrphan(TRUE)
+	{
+		mVertices.init(GL_ARRAY_BUFFER_ARB, 4 * 1024 * 1024);
+		mIndices.init(GL_ELEMENT_ARRAY_BUFFER_ARB, 1024 * 1024);
+	}
+
+	U32 getEpoch() const					{ return mEpoch; }
+
+	// Buffers bigger than this get drawn from client memory instead, so one
+	// of them can't wrap the ring every time it's drawn.
+	BOOL fits(U32 vbytes, U32 ibytes) const
+	{
+		return vbytes <= mVertices.mSize / 4 && ibytes <= mIndices.mSize / 4;
+	}
+
+	// Copies a buffer into the ring, wrapping first if either half is full.
+	// Leaves the ring bound.
+	void upload(const U8* vertices, U32 vbytes, const U8* indices, U32 ibytes,
+				U32& vertex_offset, U32& index_offset)
+	{
+		if (!mVertices.hasRoom(vbytes) || !mIndices.hasRoom(ibytes))
+		{
+			mVertices.mHead = 0;
+			mIndices.mHead = 0;
+			mOrphan = TRUE;
+			if (++mEpoch == 0)
+			{
+				mEpoch = 1;
+			}
+		}
+
+		bind();
+		vertex_offset = mVertices.append(vertices, vbytes);
+		index_offset = mIndices.append(indices, ibytes);
+	}
+
+	void bind()
+	{
+		if (!LLVertexBuffer::sRingBound)
+		{
+			mVertices.bind();
+			mIndices.bind();
+			LLVertexBuffer::sBindCount += 2;
+			LLVertexBuffer::sFrameBindCount += 2;
+			LLVertexBuffer::sVBOActive = TRUE;
+			LLVertexBuffer::sIBOActive = TRUE;
+			LLVertexBuffer::sRingBound = TRUE;
+		}
+
+		if (mOrphan)
+		{
+			mVertices.orphan();
+			mIndices.orphan();
+			mOrphan = FALSE;
+		}
+	}
+
+	void cleanup()
+	{
+		mVertices.cleanup();
+		mIndices.cleanup();
+		mOrphan = TRUE;
+		if (++mEpoch == 0)
+		{
+			mEpoch = 1;
+		}
+	}
+
+private:
+	struct Region
+	{
+		U32 mName;
+		U32 mTarget;
+		U32 mSize;
+		U32 mHead;
+
+		void init(U32 target, U32 size)
+		{
+			mName = 0;
+			mTarget = target;
+			mSize = size;
+			mHead = 0;
+		}
+
+		BOOL hasRoom(U32 bytes) const	{ return bytes <= mSize - mHead; }
+
+		void bind()
+		{
+			if (!mName)
+			{
+				glGenBuffersARB(1, (GLuint*) &mName);
+			}
+			glBindBufferARB(mTarget, mName);
+		}
+
+		void orphan()
+		{
+			glBufferDataARB(mTarget, mSize, NULL, GL_STREAM_DRAW_ARB);
+		}
+
+		U32 append(const U8* data, U32 bytes)
+		{
+			U32 offset = mHead;
+			if (bytes)
+			{
+				stop_glerror();
+				glBufferSubDataARB(mTarget, offset, bytes, data);
+				stop_glerror();
+				LLVertexBuffer::sFrameUploadBytes += bytes;
+				// keep every copy 16 byte aligned
+				mHead = (mHead + bytes + 15) & ~15;
+			}
+			return offset;
+		}
+
+		void cleanup()
+		{
+			if (mName)
+			{
+				glDeleteBuffersARB(1, (GLuint*) &mName);
+				mName = 0;
+			}
+			mHead = 0;
+		}
+	};
+
+	Region mVertices;
+	Region mIndices;
+	U32 mEpoch;			// bumped every time the ring wraps
+	BOOL mOrphan;		// if TRUE, GL storage must be replaced before the next upload
+};
+
+static LLStreamRing sStreamRing;
+
 S32 LLVertexBuffer::sTypeOffsets[LLVertexBuffer::TYPE_MAX] =
 {
 	sizeof(LLVector3), // TYPE_VERTEX,
@@ -288,7 +440,7 @@ void LLVertexBuffer::drawArrays(U32 mode, U32 first, U32 count) const
 		llerrs << "Bad vertex buffer draw range: [" << first << ", " << first+count << "]" << llendl;
 	}
 
-	if (mGLBuffer != sGLRenderBuffer || useVBOs() != sVBOActive)
+	if (mGLBuffer != sGLRenderBuffer || (useVBOs() || mRingBound) != sVBOActive)
 	{
 		llerrs << "Wrong vertex buffer bound." << llendl;
 	}
@@ -330,16 +482,28 @@ void LLVertexBuffer::unbind()
 
 	sGLRenderBuffer = 0;
 	sGLRenderIndices = 0;
+	sRingBound = FALSE;
 
 	setupClientArrays(0);
 }
 
+//static
+void LLVertexBuffer::unbindStreamRing()
+{
+	// leave the ring's GL buffers bound; whoever is set up next rebinds
+	// or unbinds as they would after any other buffer
+	sGLRenderBuffer = 0;
+	sGLRenderIndices = 0;
+	sRingBound = FALSE;
+}
+
 //static
 void LLVertexBuffer::cleanupClass()
 {
 	LLMemType mt2(LLMemType::MTYPE_VERTEX_CLEANUP_CLASS);
 	unbind();
 	clientCopy(); // deletes GL buffers
+	sStreamRing.cleanup();
 }
 
 void LLVertexBuffer::clientCopy(F64 max_time)
@@ -369,7 +533,13 @@ LLVertexBuffer::LLVertexBuffer(U32 typemask, S32 usage) :
 	mFilthy(FALSE),
 	mEmpty(TRUE),
 	mResized(FALSE),
-	mDynamicSize(FALSE)
+	mDynamicSize(FALSE),
+	mUseRing(FALSE),
+	mRingDirty(TRUE),
+	mRingBound(FALSE),
+	mRingEpoch(0),
+	mRingOffset(0),
+	mRingIndexOffset(0)
 {
 	LLMemType mt2(LLMemType::MTYPE_VERTEX_CONSTRUCTOR);
 	if (!sEnableVBOs)
@@ -382,9 +552,9 @@ LLVertexBuffer::LLVertexBuffer(U32 typemask, S32 usage) :
 		mUsage = 0;
 	}
 	
-	if (mUsage == GL_STREAM_DRAW_ARB && !sUseStreamDraw)
+	if (mUsage == GL_STREAM_DRAW_ARB && sUseStreamRing)
 	{
-		mUsage = 0;
+		mUseRing = TRUE;
 	}
 
 	S32 stride = calcStride(typemask, mOffsets);
@@ -686,6 +856,7 @@ void LLVertexBuffer::allocateBuffer(S32 nverts, S32 nindices, bool create)
 		createGLIndices();
 	}
 	
+	mRingDirty = TRUE;
 	sAllocatedBytes += getSize() + getIndicesSize();
 }
 
@@ -699,6 +870,7 @@ void LLVertexBuffer::resizeBuffer(S32 newnverts, S32 newnindices)
 
 	LLMemType mt2(LLMemType::MTYPE_VERTEX_RESIZE_BUFFER);
 	mDynamicSize = TRUE;
+	mRingDirty = TRUE;
 	if (mUsage == GL_STATIC_DRAW_ARB)
 	{ //always delete/allocate static buffers on resize
 		destroyGLBuffer();
@@ -805,6 +977,11 @@ void LLVertexBuffer::resizeBuffer(S32 newnverts, S32 newnindices)
 
 BOOL LLVertexBuffer::useVBOs() const
 {
+	if (mUseRing)
+	{ //stream ring buffers are client memory until they're drawn
+		return FALSE;
+	}
+
 	//it's generally ineffective to use VBO for things that are streaming on apple
 		
 #if LL_DARWIN
@@ -835,6 +1012,9 @@ U8* LLVertexBuffer::mapBuffer(S32 access)
 	{
 		llerrs << "LLVertexBuffer::mapBuffer() called on unallocated buffer." << llendl;
 	}
+
+	// anything handed out from here on may be written to
+	mRingDirty = TRUE;
 		
 	if (!mLocked && useVBOs())
 	{
@@ -910,6 +1090,7 @@ void LLVertexBuffer::unmapBuffer()
 			}
 			sMapped = FALSE;*/
 			sMappedCount--;
+			sFrameUploadBytes += getSize() + getIndicesSize();
 
 			if (mUsage == GL_STATIC_DRAW_ARB)
 			{ //static draw buffers can only be mapped a single time
@@ -1041,7 +1222,46 @@ void LLVertexBuffer::setBuffer(U32 data_mask)
 	//set up pointers if the data mask is different ...
 	BOOL setup = (sLastMask != data_mask);
 
-	if (useVBOs())
+	mRingBound = FALSE;
+	if (mUseRing && data_mask != 0)
+	{
+		// only copy the part that can be drawn
+		U32 vbytes = (U32) llmax(llmin(mRequestedNumVerts, mNumVerts), 0) * mStride;
+		U32 ibytes = (U32) llmax(llmin(mRequestedNumIndices, mNumIndices), 0) * sizeof(U16);
+		if ((vbytes || ibytes) && sStreamRing.fits(vbytes, ibytes))
+		{
+			if (mRingDirty || mRingEpoch != sStreamRing.getEpoch())
+			{
+				sStreamRing.upload(mMappedData, vbytes, mMappedIndexData, ibytes, mRingOffset, mRingIndexOffset);
+				mRingEpoch = sStreamRing.getEpoch();
+				mRingDirty = FALSE;
+				setup = TRUE; // ... or the copy moved
+			}
+			else
+			{
+				if (!sRingBound)
+				{
+					setup = TRUE; // ... or the ring was bound over
+				}
+				sStreamRing.bind();
+			}
+			mRingBound = TRUE;
+		}
+	}
+
+	if (!mRingBound && sRingBound)
+	{
+		unbindStreamRing();
+	}
+
+	if (mRingBound)
+	{
+		if (sGLRenderBuffer != mGLBuffer)
+		{
+			setup = TRUE; // ... or another copy in the ring was drawn
+		}
+	}
+	else if (useVBOs())
 	{
 		if (mGLBuffer && (mGLBuffer != sGLRenderBuffer || !sVBOActive))
 		{
@@ -1053,6 +1273,7 @@ void LLVertexBuffer::setBuffer(U32 data_mask)
 			glBindBufferARB(GL_ARRAY_BUFFER_ARB, mGLBuffer);
 			stop_glerror();
 			sBindCount++;
+			sFrameBindCount++;
 			sVBOActive = TRUE;
 			setup = TRUE; // ... or the bound buffer changed
 		}
@@ -1066,6 +1287,7 @@ void LLVertexBuffer::setBuffer(U32 data_mask)
 			glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, mGLIndices);
 			stop_glerror();
 			sBindCount++;
+			sFrameBindCount++;
 			sIBOActive = TRUE;
 		}
 		
@@ -1186,6 +1408,7 @@ void LLVertexBuffer::setBuffer(U32 data_mask)
 			{
 				glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
 				sBindCount++;
+				sFrameBindCount++;
 				sVBOActive = FALSE;
 				setup = TRUE; // ... or a VBO is deactivated
 			}
@@ -1202,6 +1425,7 @@ void LLVertexBuffer::setBuffer(U32 data_mask)
 			}*/
 			glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
 			sBindCount++;
+			sFrameBindCount++;
 			sIBOActive = FALSE;
 		}
 	}
@@ -1228,7 +1452,7 @@ void LLVertexBuffer::setupVertexBuffer(U32 data_mask) const
 {
 	LLMemType mt2(LLMemType::MTYPE_VERTEX_SETUP_VERTEX_BUFFER);
 	stop_glerror();
-	U8* base = useVBOs() ? NULL : mMappedData;
+	U8* base = getRenderBase();
 	S32 stride = mStride;
 
 	if ((data_mask & mTypeMask) != data_mask)
@@ -79,6 +79,7 @@ public:
 	static LLVBOPool sDynamicIBOPool;
 
 	static BOOL	sUseStreamDraw;
+	static BOOL	sUseStreamRing;
 
 	static void initClass(bool use_vbo);
 	static void cleanupClass();
@@ -140,6 +141,10 @@ protected:
 	void	updateNumIndices(S32 nindices); 
 	virtual BOOL	useVBOs() const;
 	void	unmapBuffer();
+	static void unbindStreamRing();
+
+	// what the offsets passed to gl*Pointer() are relative to
+	U8*		getRenderBase() const				{ return useVBOs() ? NULL : (mRingBound ? (U8*) NULL + mRingOffset : mMappedData); }
 		
 public:
 	LLVertexBuffer(U32 typemask, S32 usage);
@@ -176,8 +181,9 @@ public:
 	S32 getRequestedVerts() const			{ return mRequestedNumVerts; }
 	S32 getRequestedIndices() const			{ return mRequestedNumIndices; }
 
-	U8* getIndicesPointer() const			{ return useVBOs() ? NULL : mMappedIndexData; }
-	U8* getVerticesPointer() const			{ return useVBOs() ? NULL : mMappedData; }
+	U8* getIndicesPointer() const			{ return useVBOs() ? NULL : (mRingBound ? (U8*) NULL + mRingIndexOffset : mMappedIndexData); }
+	U8* getVerticesPointer() const			{ return getRenderBase(); }
+	U8* getClientIndices() const			{ return useVBOs() ? NULL : mMappedIndexData; } // NULL if indices only live in GL
 	S32 getStride() const					{ return mStride; }
 	S32 getTypeMask() const					{ return mTypeMask; }
 	BOOL hasDataType(S32 type) const		{ return ((1 << type) & getTypeMask()) ? TRUE : FALSE; }
@@ -216,6 +222,12 @@ protected:
 	S32		mOffsets[TYPE_MAX];
 	BOOL	mResized;		// if TRUE, client buffer has been resized and GL buffer has not
 	BOOL	mDynamicSize;	// if TRUE, buffer has been resized at least once (and should be padded)
+	BOOL	mUseRing;		// if TRUE, buffer lives in client memory and is drawn from the stream ring
+	BOOL	mRingDirty;		// if TRUE, client buffer has changed since it was last copied into the ring
+	BOOL	mRingBound;		// if TRUE, last setBuffer() pointed GL at this buffer's copy in the ring
+	U32		mRingEpoch;		// trip around the ring the copy was made on
+	U32		mRingOffset;	// offset of the copy in the ring's vertex buffer
+	U32		mRingIndexOffset;	// offset of the copy in the ring's index buffer
 
 	class DirtyRegion
 	{
@@ -251,6 +263,9 @@ public:
 	static U32 sAllocatedBytes;
 	static U32 sBindCount;
 	static U32 sSetCount;
+	static BOOL sRingBound;			// if TRUE, the stream ring is bound
+	static U32 sFrameBindCount;		// buffer binds since the viewer last reset it
+	static U32 sFrameUploadBytes;	// bytes sent to GL since the viewer last reset it
 };
 
 
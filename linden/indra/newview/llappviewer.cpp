@@ -117,6 +117,8 @@
 #include "lltexturecache.h"
 #include "lltexturefetch.h"
 #include "llimageworker.h"
+#include "llworkpool.h"
+#include "lltaskscheduler.h"
 #include "llevents.h"
 
 // The files below handle dependencies from cleanup.
@@ -564,6 +566,8 @@ const std::string LLAppViewer::sGlobalSettingsName = "Global";
 
 LLTextureCache* LLAppViewer::sTextureCache = NULL; 
 LLImageDecodeThread* LLAppViewer::sImageDecodeThread = NULL; 
+LLWorkPool* LLAppViewer::sWorkPool = NULL;
+LLTaskScheduler* LLAppViewer::sTaskScheduler = NULL;
 LLTextureFetch* LLAppViewer::sTextureFetch = NULL; 
 
 LLAppViewer::LLAppViewer() : 
@@ -1180,6 +1184,11 @@ bool LLAppViewer::mainLoop()
 	 					work_pending += LLAppViewer::getTextureFetch()->update(1); // unpauses the texture fetch thread
 					}
 
+					if (sTaskScheduler)
+					{
+						sTaskScheduler->update(1); // completion callbacks
+					}
+
 					{
 						LLFastTimer ftm(FTM_VFS);
 	 					io_pending += LLVFSThread::updateClass(1);
@@ -1611,8 +1620,15 @@ bool LLAppViewer::cleanup()
     sTextureFetch = NULL;
 	delete sImageDecodeThread;
     sImageDecodeThread = NULL;
+	// After the threads above, which may still have pumps queued on it
+	delete sTaskScheduler;
+	sTaskScheduler = NULL;
+	delete sWorkPool;
+	sWorkPool = NULL;
 	delete mFastTimerLogThread;
 	mFastTimerLogThread = NULL;
+	// write out anything still queued, and log the rest of shutdown directly
+	LLError::setAsyncLogging(false);
 	
 	if (LLFastTimerView::sAnalyzePerformance)
 	{
@@ -1729,14 +1745,41 @@ bool LLAppViewer::initThreads()
 #endif
 
 	LLVFSThread::initClass(enable_threads && false);
+
+	LLError::setAsyncLogging(enable_threads && gSavedSettings.getBOOL("AsyncLogging"));
 	LLLFSThread::initClass(enable_threads && false);
 
+	LLMutex::setProfiling(gSavedSettings.getBOOL("MutexProfiling"));
+
+	// Fetching, caching and decoding share one set of threads rather than
+	// owning one each.  0 keeps the old thread per subsystem.
+	S32 scheduler_threads = gSavedSettings.getS32("TaskSchedulerThreads");
+	if (scheduler_threads < 0)
+	{
+		scheduler_threads = LLWorkPool::getDefaultThreadCount();
+	}
+	if (enable_threads && scheduler_threads > 0)
+	{
+		LLAppViewer::sTaskScheduler = new LLTaskScheduler("Task Scheduler", scheduler_threads);
+	}
+
 	// Image decoding
-	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true);
-	LLAppViewer::sTextureCache = new LLTextureCache(enable_threads && true);
-	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(), sImageDecodeThread, enable_threads && true);
+	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true, sTaskScheduler);
+	LLAppViewer::sTextureCache = new LLTextureCache(enable_threads && true, sTaskScheduler);
+	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(), sImageDecodeThread, enable_threads && true, sTaskScheduler);
+	if (sTaskScheduler)
+	{
+		// Decode requests don't share state, so let them use every thread.
+		// The cache and fetcher keep to one request at a time.
+		sImageDecodeThread->setMaxConcurrency(sTaskScheduler->getNumThreads());
+	}
 	LLImage::initClass();
 
+	// Helpers for data-parallel loops (terrain decode, patch normals).
+	// -1 sizes the pool to the machine, 0 keeps everything on the main thread.
+	S32 pool_threads = enable_threads ? gSavedSettings.getS32("WorkPoolThreads") : 0;
+	LLAppViewer::sWorkPool = new LLWorkPool("Work Pool", pool_threads);
+
 	if (LLFastTimer::sLog || LLFastTimer::sMetricLog)
 	{
 		LLFastTimer::sLogLock = new LLMutex(NULL);
@@ -1744,6 +1787,14 @@ bool LLAppViewer::initThreads()
 		mFastTimerLogThread->start();
 	}
 
+	LLFastTimer::setSpikeCapture(gSavedSettings.getF32("FastTimerTraceSpikeMs"),
+								 gSavedSettings.getF32("FastTimerTraceSeconds"),
+								 gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "timer_spike"));
+	if (gSavedSettings.getBOOL("FastTimerTraceRecording"))
+	{
+		LLFastTimer::startRecording(gSavedSettings.getU32("FastTimerTraceBufferEvents"));
+	}
+
 	// *FIX: no error handling here!
 	return true;
 }
@@ -2602,6 +2653,10 @@ void LLAppViewer::writeSystemInfo()
 
 void LLAppViewer::handleViewerCrash()
 {
+	// get queued messages into the log before it's sent with the report,
+	// without joining a log writer that may be stuck or gone
+	LLError::writeQueuedLogsForCrash(500);
+
 	llinfos << "Handle viewer crash entry." << llendl;
 
 	llinfos << "Last render pool type: " << LLPipeline::sCurRenderPoolType << llendl ;
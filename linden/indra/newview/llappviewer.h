@@ -38,6 +38,8 @@ class LLPumpIO;
 class LLTextureCache;
 class LLImageDecodeThread;
 class LLTextureFetch;
+class LLWorkPool;
+class LLTaskScheduler;
 class LLWatchdogTimeout;
 class LLCommandLineParser;
 
@@ -93,6 +95,8 @@ public:
 	static LLTextureCache* getTextureCache() { return sTextureCache; }
 	static LLImageDecodeThread* getImageDecodeThread() { return sImageDecodeThread; }
 	static LLTextureFetch* getTextureFetch() { return sTextureFetch; }
+	static LLWorkPool* getWorkPool() { return sWorkPool; }
+	static LLTaskScheduler* getTaskScheduler() { return sTaskScheduler; }
 
 	static U32 getTextureCacheVersion() ;
 	static U32 getObjectCacheVersion() ;
@@ -231,6 +235,8 @@ private:
 	static LLTextureCache* sTextureCache; 
 	static LLImageDecodeThread* sImageDecodeThread; 
 	static LLTextureFetch* sTextureFetch;
+	static LLWorkPool* sWorkPool;
+	static LLTaskScheduler* sTaskScheduler;
 
 	S32 mNumSessions;
 
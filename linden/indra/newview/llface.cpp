@@ -55,80 +55,6 @@ BOOL LLFace::sSafeRenderSelect = TRUE; // FALSE
 #define DOTVEC(a,b) (a.mV[0]*b.mV[0] + a.mV[1]*b.mV[1] + a.mV[2]*b.mV[2])
 
 
-/*
-For each vertex, given:
-	B - binormal
-	T - tangent
-	N - normal
-	P - position
-
-The resulting texture coordinate <u,v> is:
-
-	u = 2(B dot P)
-	v = 2(T dot P)
-*/
-void planarProjection(LLVector2 &tc, const LLVector3& normal,
-					  const LLVector3 &mCenter, const LLVector3& vec)
-{	//DONE!
-	LLVector3 binormal;
-	float d = normal * LLVector3(1,0,0);
-	if (d >= 0.5f || d <= -0.5f)
-	{
-		binormal = LLVector3(0,1,0);
-		if (normal.mV[0] < 0)
-		{
-			binormal = -binormal;
-		}
-	}
-	else
-	{
-        binormal = LLVector3(1,0,0);
-		if (normal.mV[1] > 0)
-		{
-			binormal = -binormal;
-		}
-	}
-	LLVector3 tangent = binormal % normal;
-
-	tc.mV[1] = -((tangent*vec)*2 - 0.5f);
-	tc.mV[0] = 1.0f+((binormal*vec)*2 - 0.5f);
-}
-
-void sphericalProjection(LLVector2 &tc, const LLVector3& normal,
-						 const LLVector3 &mCenter, const LLVector3& vec)
-{	//BROKEN
-	/*tc.mV[0] = acosf(vd.mNormal * LLVector3(1,0,0))/3.14159f;
-	
-	tc.mV[1] = acosf(vd.mNormal * LLVector3(0,0,1))/6.284f;
-	if (vd.mNormal.mV[1] > 0)
-	{
-		tc.mV[1] = 1.0f-tc.mV[1];
-	}*/
-}
-
-void cylindricalProjection(LLVector2 &tc, const LLVector3& normal, const LLVector3 &mCenter, const LLVector3& vec)
-{	//BROKEN
-	/*LLVector3 binormal;
-	float d = vd.mNormal * LLVector3(1,0,0);
-	if (d >= 0.5f || d <= -0.5f)
-	{
-		binormal = LLVector3(0,1,0);
-	}
-	else{
-		binormal = LLVector3(1,0,0);
-	}
-	LLVector3 tangent = binormal % vd.mNormal;
-
-	tc.mV[1] = -((tangent*vec)*2 - 0.5f);
-
-	tc.mV[0] = acosf(vd.mNormal * LLVector3(1,0,0))/6.284f;
-
-	if (vd.mNormal.mV[1] < 0)
-	{
-		tc.mV[0] = 1.0f-tc.mV[0];
-	}*/
-}
-
 ////////////////////
 //
 // LLFace implementation
@@ -636,34 +562,6 @@ void LLFace::printDebugInfo() const
 #endif
 }
 
-// Transform the texture coordinates for this face.
-static void xform(LLVector2 &tex_coord, F32 cosAng, F32 sinAng, F32 offS, F32 offT, F32 magS, F32 magT)
-{
-	// New, good way
-	F32 s = tex_coord.mV[0];
-	F32 t = tex_coord.mV[1];
-
-	// Texture transforms are done about the center of the face.
-	s -= 0.5; 
-	t -= 0.5;
-
-	// Handle rotation
-	F32 temp = s;
-	s  = s     * cosAng + t * sinAng;
-	t  = -temp * sinAng + t * cosAng;
-
-	// Then scale
-	s *= magS;
-	t *= magT;
-
-	// Then offset
-	s += offS + 0.5f; 
-	t += offT + 0.5f;
-
-	tex_coord.mV[0] = s;
-	tex_coord.mV[1] = t;
-}
-
 
 BOOL LLFace::genVolumeBBoxes(const LLVolume &volume, S32 f,
 								const LLMatrix4& mat_vert, const LLMatrix3& mat_normal, BOOL global_volume)
@@ -819,7 +717,7 @@ LLVector2 LLFace::surfaceToTexture(LLVector2 surface_coord, LLVector3 position,
 	
 	else // otherwise use the texture entry parameters
 	{
-		xform(tc, cos(tep->getRotation()), sin(tep->getRotation()),
+		xformTexCoord(tc, cos(tep->getRotation()), sin(tep->getRotation()),
 			  tep->mOffsetS, tep->mOffsetT, tep->mScaleS, tep->mScaleT);
 	}
 
@@ -837,7 +735,7 @@ void LLFace::getPlanarProjectedParams(LLQuaternion* face_rot, LLVector3* face_po
 	LLVector3 binormal = vf.mVertices[0].mBinormal;
 	LLVector2 projected_binormal;
 	planarProjection(projected_binormal, normal, vf.mCenter, binormal);
-	projected_binormal -= LLVector2(0.5f, 0.5f); // this normally happens in xform()
+	projected_binormal -= LLVector2(0.5f, 0.5f); // this normally happens in xformTexCoord()
 	*scale = projected_binormal.length();
 	// rotate binormal to match what planarProjection() thinks it is,
 	// then find rotation from that:
@@ -951,6 +849,25 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 								const U16 &index_offset)
 {
 	LLFastTimer t(FTM_FACE_GET_GEOM);
+
+	LLFaceGeomJob job;
+	if (!prepareGeometryVolume(volume, f, mat_vert, mat_normal, index_offset, job))
+	{
+		return FALSE;
+	}
+
+	job.useVertexBuffer();
+	job.fill();
+	return TRUE;
+}
+
+BOOL LLFace::prepareGeometryVolume(const LLVolume& volume,
+							   const S32 &f,
+								const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
+								const U16 &index_offset,
+								LLFaceGeomJob& job,
+								BOOL force_full)
+{
 	const LLVolumeFace &vf = volume.getVolumeFace(f);
 	S32 num_vertices = (S32)vf.mVertices.size();
 	S32 num_indices = LLPipeline::sUseTriStrips ? (S32)vf.mTriStrip.size() : (S32) vf.mIndices.size();
@@ -978,87 +895,61 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 		}
 	}
 
-	LLStrider<LLVector3> vertices;
-	LLStrider<LLVector2> tex_coords;
-	LLStrider<LLVector2> tex_coords2;
-	LLStrider<LLVector3> normals;
-	LLStrider<LLColor4U> colors;
-	LLStrider<LLVector3> binormals;
-	LLStrider<U16> indicesp;
+	job.mVolumeFace = &vf;
+	job.mVertexBuffer = mVertexBuffer;
+	job.mGeomIndex = mGeomIndex;
+	job.mIndicesIndex = mIndicesIndex;
+	job.mNumVertices = num_vertices;
+	job.mNumIndices = num_indices;
+	job.mIndexOffset = index_offset;
+	job.mUseTriStrips = LLPipeline::sUseTriStrips;
+	job.mMatVert = mat_vert;
+	job.mMatNormal = mat_normal;
 
-	BOOL full_rebuild = mDrawablep->isState(LLDrawable::REBUILD_VOLUME);
+	BOOL full_rebuild = force_full || mDrawablep->isState(LLDrawable::REBUILD_VOLUME);
 	
 	BOOL global_volume = mDrawablep->getVOVolume()->isVolumeGlobal();
-	LLVector3 scale;
 	if (global_volume)
 	{
-		scale.setVec(1,1,1);
+		job.mScale.setVec(1,1,1);
 	}
 	else
 	{
-		scale = mVObjp->getScale();
+		job.mScale = mVObjp->getScale();
 	}
 	
 	BOOL rebuild_pos = full_rebuild || mDrawablep->isState(LLDrawable::REBUILD_POSITION);
 	BOOL rebuild_color = full_rebuild || mDrawablep->isState(LLDrawable::REBUILD_COLOR);
 	BOOL rebuild_tcoord = full_rebuild || mDrawablep->isState(LLDrawable::REBUILD_TCOORD);
-	BOOL rebuild_normal = rebuild_pos && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_NORMAL);
-	BOOL rebuild_binormal = rebuild_pos && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_BINORMAL);
 
 	const LLTextureEntry *tep = mVObjp->getTE(f);
 	U8  bump_code = tep ? tep->getBumpmap() : 0;
 
-	if (rebuild_pos)
-	{
-		mVertexBuffer->getVertexStrider(vertices, mGeomIndex);
-	}
-	if (rebuild_normal)
-	{
-		mVertexBuffer->getNormalStrider(normals, mGeomIndex);
-	}
-	if (rebuild_binormal)
-	{
-		mVertexBuffer->getBinormalStrider(binormals, mGeomIndex);
-	}
-
-	F32 tcoord_xoffset = 0.f ;
-	F32 tcoord_yoffset = 0.f ;
-	F32 tcoord_xscale = 1.f ;
-	F32 tcoord_yscale = 1.f ;
-	BOOL in_atlas = FALSE ;
+	job.mRebuildPos = rebuild_pos;
+	job.mRebuildNormal = rebuild_pos && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_NORMAL);
+	job.mRebuildBinormal = rebuild_pos && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_BINORMAL);
+	job.mRebuildTCoord = rebuild_tcoord;
+	job.mRebuildTCoord1 = rebuild_tcoord && bump_code && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_TEXCOORD1);
+	job.mRebuildColor = rebuild_color;
+	job.mRebuildIndices = full_rebuild;
 
+	job.mInAtlas = FALSE;
 	if (rebuild_tcoord)
 	{
-		mVertexBuffer->getTexCoord0Strider(tex_coords, mGeomIndex);
-		if (bump_code && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_TEXCOORD1))
+		job.mInAtlas = isAtlasInUse() ;
+		if (job.mInAtlas)
 		{
-			mVertexBuffer->getTexCoord1Strider(tex_coords2, mGeomIndex);
-		}
-
-		in_atlas = isAtlasInUse() ;
-		if(in_atlas)
-		{
-			const LLVector2* tmp = getTexCoordOffset() ;
-			tcoord_xoffset = tmp->mV[0] ; 
-			tcoord_yoffset = tmp->mV[1] ;
-
-			tmp = getTexCoordScale() ;
-			tcoord_xscale = tmp->mV[0] ; 
-			tcoord_yscale = tmp->mV[1] ;	
+			job.mAtlasOffset = *getTexCoordOffset() ;
+			job.mAtlasScale = *getTexCoordScale() ;
+			job.mAddressMode = mTexture->getAddressMode();
 		}
 	}
-	if (rebuild_color)
-	{	
-		mVertexBuffer->getColorStrider(colors, mGeomIndex);
-	}
 
 	F32 r = 0, os = 0, ot = 0, ms = 0, mt = 0, cos_ang = 0, sin_ang = 0;
 	
 	BOOL is_static = mDrawablep->isStatic();
 	BOOL is_global = is_static;
 
-	LLVector3 center_sum(0.f, 0.f, 0.f);
-	
 	if (is_global)
 	{
 		setState(GLOBAL);
@@ -1068,10 +959,6 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 		clearState(GLOBAL);
 	}
 
-	LLVector2 tmin, tmax;
-	
-	
-
 	if (rebuild_tcoord)
 	{
 		if (tep)
@@ -1121,6 +1008,18 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 		}
 	}
 
+	job.mUseTexMatrix = tex_mode && mTextureMatrix;
+	if (job.mUseTexMatrix)
+	{
+		job.mTexMatrix = *mTextureMatrix;
+	}
+	job.mCosAng = cos_ang;
+	job.mSinAng = sin_ang;
+	job.mOffsetS = os;
+	job.mOffsetT = ot;
+	job.mScaleS = ms;
+	job.mScaleT = mt;
+
 	LLColor4U color = tep->getColor();
 
 	if (rebuild_color)
@@ -1141,37 +1040,15 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 			}
 		}
 	}
-
-    // INDICES
-	if (full_rebuild)
-	{
-		mVertexBuffer->getIndexStrider(indicesp, mIndicesIndex);
-		if (LLPipeline::sUseTriStrips)
-		{
-			for (U32 i = 0; i < (U32) num_indices; i++)
-			{
-				*indicesp++ = vf.mTriStrip[i] + index_offset;
-			}
-		}
-		else
-		{
-			for (U32 i = 0; i < (U32) num_indices; i++)
-			{
-				*indicesp++ = vf.mIndices[i] + index_offset;
-			}
-		}
-	}
-	
+	job.mColor = color;
 	
 	//bump setup
-	LLVector3 binormal_dir( -sin_ang, cos_ang, 0 );
-	LLVector3 bump_s_primary_light_ray;
-	LLVector3 bump_t_primary_light_ray;
+	job.mBinormalDir.setVec( -sin_ang, cos_ang, 0 );
 
-	LLQuaternion bump_quat;
-	if (mDrawablep->isActive())
+	job.mRotateBump = mDrawablep->isActive();
+	if (job.mRotateBump)
 	{
-		bump_quat = LLQuaternion(mDrawablep->getRenderMatrix());
+		job.mBumpQuat = LLQuaternion(mDrawablep->getRenderMatrix());
 	}
 	
 	if (bump_code)
@@ -1218,198 +1095,27 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 		LLVector3   moon_ray = gSky.getMoonDirection();
 		LLVector3& primary_light_ray = (sun_ray.mV[VZ] > 0) ? sun_ray : moon_ray;
 
-		bump_s_primary_light_ray = offset_multiple * s_scale * primary_light_ray;
-		bump_t_primary_light_ray = offset_multiple * t_scale * primary_light_ray;
+		job.mBumpSLightRay = offset_multiple * s_scale * primary_light_ray;
+		job.mBumpTLightRay = offset_multiple * t_scale * primary_light_ray;
 	}
 		
-	U8 texgen = getTextureEntry()->getTexGen();
-	if (rebuild_tcoord && texgen != LLTextureEntry::TEX_GEN_DEFAULT)
+	job.mTexGen = getTextureEntry()->getTexGen();
+	if (rebuild_tcoord && job.mTexGen != LLTextureEntry::TEX_GEN_DEFAULT)
 	{ //planar texgen needs binormals
 		mVObjp->getVolume()->genBinormals(f);
 	}
 
-	for (S32 i = 0; i < num_vertices; i++)
+	if (force_full)
 	{
-		if (rebuild_tcoord)
-		{
-			LLVector2 tc = vf.mVertices[i].mTexCoord;
-		
-			if (texgen != LLTextureEntry::TEX_GEN_DEFAULT)
-			{
-				LLVector3 vec = vf.mVertices[i].mPosition; 
-			
-				vec.scaleVec(scale);
-
-				switch (texgen)
-				{
-					case LLTextureEntry::TEX_GEN_PLANAR:
-						planarProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
-						break;
-					case LLTextureEntry::TEX_GEN_SPHERICAL:
-						sphericalProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
-						break;
-					case LLTextureEntry::TEX_GEN_CYLINDRICAL:
-						cylindricalProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
-						break;
-					default:
-						break;
-				}		
-			}
-
-			if (tex_mode && mTextureMatrix)
-			{
-				LLVector3 tmp(tc.mV[0], tc.mV[1], 0.f);
-				tmp = tmp * *mTextureMatrix;
-				tc.mV[0] = tmp.mV[0];
-				tc.mV[1] = tmp.mV[1];
-			}
-			else
-			{
-				xform(tc, cos_ang, sin_ang, os, ot, ms, mt);
-			}
-
-			if(in_atlas)
-			{
-				//
-				//manually calculate tex-coord per vertex for varying address modes.
-				//should be removed if shader can handle this.
-				//
-
-				S32 int_part = 0 ;
-				switch(mTexture->getAddressMode())
-				{
-				case LLTexUnit::TAM_CLAMP:
-					if(tc.mV[0] < 0.f)
-					{
-						tc.mV[0] = 0.f ;
-					}
-					else if(tc.mV[0] > 1.f)
-					{
-						tc.mV[0] = 1.f;
-					}
-
-					if(tc.mV[1] < 0.f)
-					{
-						tc.mV[1] = 0.f ;
-					}
-					else if(tc.mV[1] > 1.f)
-					{
-						tc.mV[1] = 1.f;
-					}
-					break;
-				case LLTexUnit::TAM_MIRROR:
-					if(tc.mV[0] < 0.f)
-					{
-						tc.mV[0] = -tc.mV[0] ;
-					}
-					int_part = (S32)tc.mV[0] ;
-					if(int_part & 1) //odd number
-					{
-						tc.mV[0] = int_part + 1 - tc.mV[0] ;
-					}
-					else //even number
-					{
-						tc.mV[0] -= int_part ;
-					}
-
-					if(tc.mV[1] < 0.f)
-					{
-						tc.mV[1] = -tc.mV[1] ;
-					}
-					int_part = (S32)tc.mV[1] ;
-					if(int_part & 1) //odd number
-					{
-						tc.mV[1] = int_part + 1 - tc.mV[1] ;
-					}
-					else //even number
-					{
-						tc.mV[1] -= int_part ;
-					}
-					break;
-				case LLTexUnit::TAM_WRAP:
-					if(tc.mV[0] > 1.f)
-						tc.mV[0] -= (S32)(tc.mV[0] - 0.00001f) ;
-					else if(tc.mV[0] < -1.f)
-						tc.mV[0] -= (S32)(tc.mV[0] + 0.00001f) ;
-
-					if(tc.mV[1] > 1.f)
-						tc.mV[1] -= (S32)(tc.mV[1] - 0.00001f) ;
-					else if(tc.mV[1] < -1.f)
-						tc.mV[1] -= (S32)(tc.mV[1] + 0.00001f) ;
-
-					if(tc.mV[0] < 0.f)
-					{
-						tc.mV[0] = 1.0f + tc.mV[0] ;
-					}
-					if(tc.mV[1] < 0.f)
-					{
-						tc.mV[1] = 1.0f + tc.mV[1] ;
-					}
-					break;
-				default:
-					break;
-				}
-			
-				tc.mV[0] = tcoord_xoffset + tcoord_xscale * tc.mV[0] ;
-				tc.mV[1] = tcoord_yoffset + tcoord_yscale * tc.mV[1] ;
-			}
-			
-
-			*tex_coords++ = tc;
-		
-			if (bump_code && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_TEXCOORD1))
-			{
-				LLVector3 tangent = vf.mVertices[i].mBinormal % vf.mVertices[i].mNormal;
-
-				LLMatrix3 tangent_to_object;
-				tangent_to_object.setRows(tangent, vf.mVertices[i].mBinormal, vf.mVertices[i].mNormal);
-				LLVector3 binormal = binormal_dir * tangent_to_object;
-				binormal = binormal * mat_normal;
-				
-				if (mDrawablep->isActive())
-				{
-					binormal *= bump_quat;
-				}
-
-				binormal.normVec();
-				tc += LLVector2( bump_s_primary_light_ray * tangent, bump_t_primary_light_ray * binormal );
-				
-				*tex_coords2++ = tc;
-			}	
-		}
-			
-		if (rebuild_pos)
-		{
-			*vertices++ = vf.mVertices[i].mPosition * mat_vert;
-		}
-		
-		if (rebuild_normal)
-		{
-			LLVector3 normal = vf.mVertices[i].mNormal * mat_normal;
-			normal.normVec();
-			
-			*normals++ = normal;
-		}
-		
-		if (rebuild_binormal)
-		{
-			LLVector3 binormal = vf.mVertices[i].mBinormal * mat_normal;
-			binormal.normVec();
-			*binormals++ = binormal;
-		}
-		
-		if (rebuild_color)
-		{
-			*colors++ = color;		
-		}
+		return TRUE;
 	}
 
 	if (rebuild_tcoord)
 	{
 		mTexExtents[0].setVec(0,0);
 		mTexExtents[1].setVec(1,1);
-		xform(mTexExtents[0], cos_ang, sin_ang, os, ot, ms, mt);
-		xform(mTexExtents[1], cos_ang, sin_ang, os, ot, ms, mt);		
+		xformTexCoord(mTexExtents[0], cos_ang, sin_ang, os, ot, ms, mt);
+		xformTexCoord(mTexExtents[1], cos_ang, sin_ang, os, ot, ms, mt);		
 	}
 
 	mLastVertexBuffer = mVertexBuffer;
@@ -42,9 +42,11 @@
 #include "llviewertexture.h"
 #include "lldrawable.h"
 #include "lltextureatlasmanager.h"
+#include "llfacegeomjob.h"
 
 class LLFacePool;
 class LLVolume;
+class LLVolumeFace;
 class LLViewerTexture;
 class LLTextureEntry;
 class LLVertexProgram;
@@ -144,6 +146,18 @@ public:
 						const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
 						const U16 &index_offset);
 
+	// The main thread half of getGeometryVolume(): checks the face fits in
+	// its buffer, updates the face's state and sets up job, without touching
+	// the buffer.  force_full builds everything whatever the drawable's
+	// rebuild flags say and leaves the face's record of its last build
+	// alone, for timing.
+	BOOL prepareGeometryVolume(const LLVolume& volume,
+						const S32 &f,
+						const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
+						const U16 &index_offset,
+						LLFaceGeomJob& job,
+						BOOL force_full = FALSE);
+
 	// For avatar
 	U16			 getGeometryAvatar(
 									LLStrider<LLVector3> &vertices,
@@ -0,0 +1,258 @@
+/**
+ * @file llfacegeombatch.cpp
+ * @brief Fills volume face geometry into staging memory across a work pool.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llfacegeombatch.h"
+
+#include "llfasttimer.h"
+#include "llvolume.h"
+
+static LLFastTimer::DeclareTimer FTM_FACE_GEOM_FILL("Face Geom Fill");
+static LLFastTimer::DeclareTimer FTM_FACE_GEOM_UPLOAD("Face Geom Upload");
+
+// Staging arrays start on 16 byte boundaries, so neighbouring faces never
+// share a cache line more than they have to.
+static const U32 STAGING_ALIGNMENT = 16;
+
+template <class T>
+static void copy_to_buffer(LLStrider<T> dst, const T* src, S32 count)
+{
+	for (S32 i = 0; i < count; i++)
+	{
+		*dst++ = src[i];
+	}
+}
+
+LLFaceGeomBatch::LLFaceGeomBatch()
+:	mStagingSize(0),
+	mVertexCount(0)
+{
+}
+
+LLFaceGeomBatch::~LLFaceGeomBatch()
+{
+}
+
+U32 LLFaceGeomBatch::reserve(BOOL used, U32 count, U32 size)
+{
+	if (!used)
+	{
+		return 0;
+	}
+	U32 offset = mStagingSize;
+	mStagingSize += (count * size + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+	return offset;
+}
+
+BOOL LLFaceGeomBatch::add(LLFace* face, LLVolume* volume, S32 f,
+						  const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
+						  U16 index_offset, BOOL force_full)
+{
+	LLFaceGeomJob job;
+	if (!face->prepareGeometryVolume(*volume, f, mat_vert, mat_normal, index_offset, job, force_full))
+	{
+		return FALSE;
+	}
+	addJob(job, volume);
+	return TRUE;
+}
+
+void LLFaceGeomBatch::addJob(const LLFaceGeomJob& job, LLVolume* volume)
+{
+	mJobs.push_back(job);
+
+	U32 verts = (U32)job.mNumVertices;
+	Offsets offsets;
+	offsets.mVertices = reserve(job.mRebuildPos, verts, sizeof(LLVector3));
+	offsets.mNormals = reserve(job.mRebuildNormal, verts, sizeof(LLVector3));
+	offsets.mBinormals = reserve(job.mRebuildBinormal, verts, sizeof(LLVector3));
+	offsets.mTexCoords = reserve(job.mRebuildTCoord, verts, sizeof(LLVector2));
+	offsets.mTexCoords2 = reserve(job.mRebuildTCoord1, verts, sizeof(LLVector2));
+	offsets.mColors = reserve(job.mRebuildColor, verts, sizeof(LLColor4U));
+	offsets.mIndices = reserve(job.mRebuildIndices, (U32)job.mNumIndices, sizeof(U16));
+	mOffsets.push_back(offsets);
+
+	mVolumes.push_back(volume);
+	mVertexCount += verts;
+}
+
+void LLFaceGeomBatch::fill(LLWorkPool* pool)
+{
+	LLFastTimer t(FTM_FACE_GEOM_FILL);
+
+	if (mJobs.empty())
+	{
+		return;
+	}
+
+	// the staging memory only moves here, now that every face is in
+	if (mStaging.size() < mStagingSize + STAGING_ALIGNMENT)
+	{
+		mStaging.resize(mStagingSize + STAGING_ALIGNMENT);
+	}
+	U8* base = &mStaging[0];
+	base += (STAGING_ALIGNMENT - ((size_t)base & (STAGING_ALIGNMENT - 1))) & (STAGING_ALIGNMENT - 1);
+
+	for (U32 i = 0; i < mJobs.size(); i++)
+	{
+		LLFaceGeomJob& job = mJobs[i];
+		const Offsets& offsets = mOffsets[i];
+		job.mVertices = (LLVector3*)(base + offsets.mVertices);
+		job.mNormals = (LLVector3*)(base + offsets.mNormals);
+		job.mBinormals = (LLVector3*)(base + offsets.mBinormals);
+		job.mTexCoords = (LLVector2*)(base + offsets.mTexCoords);
+		job.mTexCoords2 = (LLVector2*)(base + offsets.mTexCoords2);
+		job.mColors = (LLColor4U*)(base + offsets.mColors);
+		job.mIndices = (U16*)(base + offsets.mIndices);
+	}
+
+	if (pool)
+	{
+		pool->parallelFor(*this, (S32)mJobs.size());
+	}
+	else
+	{
+		for (S32 i = 0; i < (S32)mJobs.size(); i++)
+		{
+			run(i);
+		}
+	}
+}
+
+void LLFaceGeomBatch::run(S32 index)
+{
+	mJobs[index].fill();
+}
+
+void LLFaceGeomBatch::upload()
+{
+	LLFastTimer t(FTM_FACE_GEOM_UPLOAD);
+
+	for (U32 i = 0; i < mJobs.size(); i++)
+	{
+		LLFaceGeomJob& job = mJobs[i];
+		LLVertexBuffer* buffer = job.mVertexBuffer;
+		S32 verts = job.mNumVertices;
+
+		if (job.mRebuildPos)
+		{
+			LLStrider<LLVector3> dst;
+			buffer->getVertexStrider(dst, job.mGeomIndex);
+			copy_to_buffer(dst, job.mVertices.get(), verts);
+		}
+		if (job.mRebuildNormal)
+		{
+			LLStrider<LLVector3> dst;
+			buffer->getNormalStrider(dst, job.mGeomIndex);
+			copy_to_buffer(dst, job.mNormals.get(), verts);
+		}
+		if (job.mRebuildBinormal)
+		{
+			LLStrider<LLVector3> dst;
+			buffer->getBinormalStrider(dst, job.mGeomIndex);
+			copy_to_buffer(dst, job.mBinormals.get(), verts);
+		}
+		if (job.mRebuildTCoord)
+		{
+			LLStrider<LLVector2> dst;
+			buffer->getTexCoord0Strider(dst, job.mGeomIndex);
+			copy_to_buffer(dst, job.mTexCoords.get(), verts);
+		}
+		if (job.mRebuildTCoord1)
+		{
+			LLStrider<LLVector2> dst;
+			buffer->getTexCoord1Strider(dst, job.mGeomIndex);
+			copy_to_buffer(dst, job.mTexCoords2.get(), verts);
+		}
+		if (job.mRebuildColor)
+		{
+			LLStrider<LLColor4U> dst;
+			buffer->getColorStrider(dst, job.mGeomIndex);
+			copy_to_buffer(dst, job.mColors.get(), verts);
+		}
+		if (job.mRebuildIndices)
+		{
+			LLStrider<U16> dst;
+			buffer->getIndexStrider(dst, job.mIndicesIndex);
+			copy_to_buffer(dst, job.mIndices.get(), job.mNumIndices);
+		}
+
+		buffer->markDirty(job.mGeomIndex, verts, job.mIndicesIndex, job.mNumIndices);
+	}
+
+	for (U32 i = 0; i < mJobs.size(); i++)
+	{
+		LLVertexBuffer* buffer = mJobs[i].mVertexBuffer;
+		if (buffer->isLocked())
+		{
+			buffer->setBuffer(0);
+		}
+	}
+}
+
+void LLFaceGeomBatch::clear()
+{
+	mJobs.clear();
+	mOffsets.clear();
+	mVolumes.clear();
+	mStagingSize = 0;
+	mVertexCount = 0;
+}
+
+void LLFaceGeomBatch::benchmark(LLWorkPool* pool, S32 iterations)
+{
+	if (isEmpty() || iterations <= 0)
+	{
+		return;
+	}
+
+	// Straight through is what getGeometryVolume() costs without the
+	// mapping.  Staged adds a copy of the results, standing in for upload().
+	LLTimer timer;
+	for (S32 iter = 0; iter < iterations; iter++)
+	{
+		fill(NULL);
+	}
+	F64 serial_time = timer.getElapsedTimeF64() / iterations;
+
+	std::vector<U8> target(mStagingSize);
+	timer.reset();
+	for (S32 iter = 0; iter < iterations; iter++)
+	{
+		fill(pool);
+		if (!target.empty())
+		{
+			memcpy(&target[0], &mStaging[0], target.size());	/* Flawfinder: ignore */
+		}
+	}
+	F64 staged_time = timer.getElapsedTimeF64() / iterations;
+
+	llinfos << "Face geometry benchmark: " << getFaceCount() << " faces, "
+			<< getVertexCount() << " vertices, " << serial_time * 1000.0 << " ms serial, "
+			<< staged_time * 1000.0 << " ms staged on " << (pool ? pool->getNumThreads() : 0)
+			<< " threads" << llendl;
+}
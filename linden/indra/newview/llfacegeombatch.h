@@ -0,0 +1,114 @@
+/**
+ * @file llfacegeombatch.h
+ * @brief Fills volume face geometry into staging memory across a work pool.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLFACEGEOMBATCH_H
+#define LL_LLFACEGEOMBATCH_H
+
+#include <vector>
+
+#include "llface.h"
+#include "llworkpool.h"
+
+class LLVolume;
+
+//============================================================================
+// LLFaceGeomBatch
+//
+// LLFace::getGeometryVolume() maps the face's vertex buffer and writes into
+// it as it goes, so it has to run on the main thread, one face at a time.
+// LLFaceGeomBatch splits that up: add() does the main thread part of each
+// face up front, fill() generates every face's vertices into plain staging
+// memory across a work pool, and upload() copies the results into the
+// vertex buffers, which is all the GL side has to wait for.
+//
+// Buffers and volumes are held until the batch is cleared, but the faces'
+// places in their buffers must not change between add() and upload().
+
+class LLFaceGeomBatch : public LLWorkPool::Task
+{
+public:
+	LLFaceGeomBatch();
+	~LLFaceGeomBatch();
+
+	// Takes the same arguments as LLFace::getGeometryVolume(), and likewise
+	// returns FALSE, queueing nothing, if the face doesn't fit its buffer.
+	BOOL add(LLFace* face, LLVolume* volume, S32 f,
+			 const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
+			 U16 index_offset, BOOL force_full = FALSE);
+
+	// Queues a job that's already been prepared, holding its volume.
+	void addJob(const LLFaceGeomJob& job, LLVolume* volume);
+
+	// Generates the vertices of every queued face.  pool may be NULL.
+	void fill(LLWorkPool* pool);
+
+	// Copies what fill() made into the vertex buffers and unmaps them.
+	void upload();
+
+	void flush(LLWorkPool* pool)		{ fill(pool); upload(); clear(); }
+
+	// Forgets the faces, but keeps the staging memory for next time.
+	void clear();
+
+	BOOL isEmpty() const				{ return mJobs.empty(); }
+	U32 getFaceCount() const			{ return (U32)mJobs.size(); }
+	U32 getVertexCount() const			{ return mVertexCount; }
+	U32 getStagingSize() const			{ return mStagingSize; }
+
+	// After fill(), the job's striders point at its results in the staging memory.
+	const LLFaceGeomJob& getJob(U32 index) const	{ return mJobs[index]; }
+
+	/*virtual*/ void run(S32 index);
+
+	// Times fill() of the queued faces, straight through on this thread and
+	// staged across pool, without touching GL, and logs the results.
+	void benchmark(LLWorkPool* pool, S32 iterations = 10);
+
+private:
+	// Where each of a job's arrays starts in mStaging
+	struct Offsets
+	{
+		U32 mVertices;
+		U32 mNormals;
+		U32 mBinormals;
+		U32 mTexCoords;
+		U32 mTexCoords2;
+		U32 mColors;
+		U32 mIndices;
+	};
+
+	U32 reserve(BOOL used, U32 count, U32 size);
+
+private:
+	std::vector<LLFaceGeomJob> mJobs;
+	std::vector<Offsets> mOffsets;
+	std::vector<LLPointer<LLVolume> > mVolumes;
+	std::vector<U8> mStaging;
+	U32 mStagingSize;
+	U32 mVertexCount;
+};
+
+#endif // LL_LLFACEGEOMBATCH_H
@@ -0,0 +1,407 @@
+/**
+ * @file llfacegeomjob.cpp
+ * @brief Generates one volume face's vertices, independent of the main thread.
+ *
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llfacegeomjob.h"
+
+#include "lltextureentry.h"
+#include "llvolume.h"
+
+/*
+For each vertex, given:
+	B - binormal
+	T - tangent
+	N - normal
+	P - position
+
+The resulting texture coordinate <u,v> is:
+
+	u = 2(B dot P)
+	v = 2(T dot P)
+*/
+void planarProjection(LLVector2 &tc, const LLVector3& normal,
+					  const LLVector3 &mCenter, const LLVector3& vec)
+{	//DONE!
+	LLVector3 binormal;
+	float d = normal * LLVector3(1,0,0);
+	if (d >= 0.5f || d <= -0.5f)
+	{
+		binormal = LLVector3(0,1,0);
+		if (normal.mV[0] < 0)
+		{
+			binormal = -binormal;
+		}
+	}
+	else
+	{
+        binormal = LLVector3(1,0,0);
+		if (normal.mV[1] > 0)
+		{
+			binormal = -binormal;
+		}
+	}
+	LLVector3 tangent = binormal % normal;
+
+	tc.mV[1] = -((tangent*vec)*2 - 0.5f);
+	tc.mV[0] = 1.0f+((binormal*vec)*2 - 0.5f);
+}
+
+void sphericalProjection(LLVector2 &tc, const LLVector3& normal,
+						 const LLVector3 &mCenter, const LLVector3& vec)
+{	//BROKEN
+	/*tc.mV[0] = acosf(vd.mNormal * LLVector3(1,0,0))/3.14159f;
+	
+	tc.mV[1] = acosf(vd.mNormal * LLVector3(0,0,1))/6.284f;
+	if (vd.mNormal.mV[1] > 0)
+	{
+		tc.mV[1] = 1.0f-tc.mV[1];
+	}*/
+}
+
+void cylindricalProjection(LLVector2 &tc, const LLVector3& normal, const LLVector3 &mCenter, const LLVector3& vec)
+{	//BROKEN
+	/*LLVector3 binormal;
+	float d = vd.mNormal * LLVector3(1,0,0);
+	if (d >= 0.5f || d <= -0.5f)
+	{
+		binormal = LLVector3(0,1,0);
+	}
+	else{
+		binormal = LLVector3(1,0,0);
+	}
+	LLVector3 tangent = binormal % vd.mNormal;
+
+	tc.mV[1] = -((tangent*vec)*2 - 0.5f);
+
+	tc.mV[0] = acosf(vd.mNormal * LLVector3(1,0,0))/6.284f;
+
+	if (vd.mNormal.mV[1] < 0)
+	{
+		tc.mV[0] = 1.0f-tc.mV[0];
+	}*/
+}
+
+void xformTexCoord(LLVector2 &tex_coord, F32 cosAng, F32 sinAng, F32 offS, F32 offT, F32 magS, F32 magT)
+{
+	// New, good way
+	F32 s = tex_coord.mV[0];
+	F32 t = tex_coord.mV[1];
+
+	// Texture transforms are done about the center of the face.
+	s -= 0.5; 
+	t -= 0.5;
+
+	// Handle rotation
+	F32 temp = s;
+	s  = s     * cosAng + t * sinAng;
+	t  = -temp * sinAng + t * cosAng;
+
+	// Then scale
+	s *= magS;
+	t *= magT;
+
+	// Then offset
+	s += offS + 0.5f; 
+	t += offT + 0.5f;
+
+	tex_coord.mV[0] = s;
+	tex_coord.mV[1] = t;
+}
+
+LLFaceGeomJob::LLFaceGeomJob()
+:	mVolumeFace(NULL),
+	mGeomIndex(0),
+	mIndicesIndex(0),
+	mNumVertices(0),
+	mNumIndices(0),
+	mIndexOffset(0),
+	mRebuildPos(FALSE),
+	mRebuildNormal(FALSE),
+	mRebuildBinormal(FALSE),
+	mRebuildTCoord(FALSE),
+	mRebuildTCoord1(FALSE),
+	mRebuildColor(FALSE),
+	mRebuildIndices(FALSE),
+	mUseTriStrips(FALSE),
+	mTexGen(0),
+	mUseTexMatrix(FALSE),
+	mCosAng(1.f),
+	mSinAng(0.f),
+	mOffsetS(0.f),
+	mOffsetT(0.f),
+	mScaleS(1.f),
+	mScaleT(1.f),
+	mInAtlas(FALSE),
+	mAddressMode(LLTexUnit::TAM_WRAP),
+	mRotateBump(FALSE)
+{
+}
+
+void LLFaceGeomJob::useVertexBuffer()
+{
+	if (mRebuildPos)
+	{
+		mVertexBuffer->getVertexStrider(mVertices, mGeomIndex);
+	}
+	if (mRebuildNormal)
+	{
+		mVertexBuffer->getNormalStrider(mNormals, mGeomIndex);
+	}
+	if (mRebuildBinormal)
+	{
+		mVertexBuffer->getBinormalStrider(mBinormals, mGeomIndex);
+	}
+	if (mRebuildTCoord)
+	{
+		mVertexBuffer->getTexCoord0Strider(mTexCoords, mGeomIndex);
+	}
+	if (mRebuildTCoord1)
+	{
+		mVertexBuffer->getTexCoord1Strider(mTexCoords2, mGeomIndex);
+	}
+	if (mRebuildColor)
+	{	
+		mVertexBuffer->getColorStrider(mColors, mGeomIndex);
+	}
+	if (mRebuildIndices)
+	{
+		mVertexBuffer->getIndexStrider(mIndices, mIndicesIndex);
+	}
+}
+
+void LLFaceGeomJob::fill()
+{
+	const LLVolumeFace& vf = *mVolumeFace;
+
+	LLStrider<LLVector3> vertices = mVertices;
+	LLStrider<LLVector3> normals = mNormals;
+	LLStrider<LLVector3> binormals = mBinormals;
+	LLStrider<LLVector2> tex_coords = mTexCoords;
+	LLStrider<LLVector2> tex_coords2 = mTexCoords2;
+	LLStrider<LLColor4U> colors = mColors;
+	LLStrider<U16> indicesp = mIndices;
+
+	const LLMatrix4& mat_vert = mMatVert;
+	const LLMatrix3& mat_normal = mMatNormal;
+	const U8 texgen = mTexGen;
+
+    // INDICES
+	if (mRebuildIndices)
+	{
+		if (mUseTriStrips)
+		{
+			for (U32 i = 0; i < (U32) mNumIndices; i++)
+			{
+				*indicesp++ = vf.mTriStrip[i] + mIndexOffset;
+			}
+		}
+		else
+		{
+			for (U32 i = 0; i < (U32) mNumIndices; i++)
+			{
+				*indicesp++ = vf.mIndices[i] + mIndexOffset;
+			}
+		}
+	}
+
+	for (S32 i = 0; i < mNumVertices; i++)
+	{
+		if (mRebuildTCoord)
+		{
+			LLVector2 tc = vf.mVertices[i].mTexCoord;
+		
+			if (texgen != LLTextureEntry::TEX_GEN_DEFAULT)
+			{
+				LLVector3 vec = vf.mVertices[i].mPosition; 
+			
+				vec.scaleVec(mScale);
+
+				switch (texgen)
+				{
+					case LLTextureEntry::TEX_GEN_PLANAR:
+						planarProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
+						break;
+					case LLTextureEntry::TEX_GEN_SPHERICAL:
+						sphericalProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
+						break;
+					case LLTextureEntry::TEX_GEN_CYLINDRICAL:
+						cylindricalProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
+						break;
+					default:
+						break;
+				}		
+			}
+
+			if (mUseTexMatrix)
+			{
+				LLVector3 tmp(tc.mV[0], tc.mV[1], 0.f);
+				tmp = tmp * mTexMatrix;
+				tc.mV[0] = tmp.mV[0];
+				tc.mV[1] = tmp.mV[1];
+			}
+			else
+			{
+				xformTexCoord(tc, mCosAng, mSinAng, mOffsetS, mOffsetT, mScaleS, mScaleT);
+			}
+
+			if(mInAtlas)
+			{
+				//
+				//manually calculate tex-coord per vertex for varying address modes.
+				//should be removed if shader can handle this.
+				//
+
+				S32 int_part = 0 ;
+				switch(mAddressMode)
+				{
+				case LLTexUnit::TAM_CLAMP:
+					if(tc.mV[0] < 0.f)
+					{
+						tc.mV[0] = 0.f ;
+					}
+					else if(tc.mV[0] > 1.f)
+					{
+						tc.mV[0] = 1.f;
+					}
+
+					if(tc.mV[1] < 0.f)
+					{
+						tc.mV[1] = 0.f ;
+					}
+					else if(tc.mV[1] > 1.f)
+					{
+						tc.mV[1] = 1.f;
+					}
+					break;
+				case LLTexUnit::TAM_MIRROR:
+					if(tc.mV[0] < 0.f)
+					{
+						tc.mV[0] = -tc.mV[0] ;
+					}
+					int_part = (S32)tc.mV[0] ;
+					if(int_part & 1) //odd number
+					{
+						tc.mV[0] = int_part + 1 - tc.mV[0] ;
+					}
+					else //even number
+					{
+						tc.mV[0] -= int_part ;
+					}
+
+					if(tc.mV[1] < 0.f)
+					{
+						tc.mV[1] = -tc.mV[1] ;
+					}
+					int_part = (S32)tc.mV[1] ;
+					if(int_part & 1) //odd number
+					{
+						tc.mV[1] = int_part + 1 - tc.mV[1] ;
+					}
+					else //even number
+					{
+						tc.mV[1] -= int_part ;
+					}
+					break;
+				case LLTexUnit::TAM_WRAP:
+					if(tc.mV[0] > 1.f)
+						tc.mV[0] -= (S32)(tc.mV[0] - 0.00001f) ;
+					else if(tc.mV[0] < -1.f)
+						tc.mV[0] -= (S32)(tc.mV[0] + 0.00001f) ;
+
+					if(tc.mV[1] > 1.f)
+						tc.mV[1] -= (S32)(tc.mV[1] - 0.00001f) ;
+					else if(tc.mV[1] < -1.f)
+						tc.mV[1] -= (S32)(tc.mV[1] + 0.00001f) ;
+
+					if(tc.mV[0] < 0.f)
+					{
+						tc.mV[0] = 1.0f + tc.mV[0] ;
+					}
+					if(tc.mV[1] < 0.f)
+					{
+						tc.mV[1] = 1.0f + tc.mV[1] ;
+					}
+					break;
+				default:
+					break;
+				}
+			
+				tc.mV[0] = mAtlasOffset.mV[0] + mAtlasScale.mV[0] * tc.mV[0] ;
+				tc.mV[1] = mAtlasOffset.mV[1] + mAtlasScale.mV[1] * tc.mV[1] ;
+			}
+			
+
+			*tex_coords++ = tc;
+		
+			if (mRebuildTCoord1)
+			{
+				LLVector3 tangent = vf.mVertices[i].mBinormal % vf.mVertices[i].mNormal;
+
+				LLMatrix3 tangent_to_object;
+				tangent_to_object.setRows(tangent, vf.mVertices[i].mBinormal, vf.mVertices[i].mNormal);
+				LLVector3 binormal = mBinormalDir * tangent_to_object;
+				binormal = binormal * mat_normal;
+				
+				if (mRotateBump)
+				{
+					binormal *= mBumpQuat;
+				}
+
+				binormal.normVec();
+				tc += LLVector2( mBumpSLightRay * tangent, mBumpTLightRay * binormal );
+				
+				*tex_coords2++ = tc;
+			}	
+		}
+			
+		if (mRebuildPos)
+		{
+			*vertices++ = vf.mVertices[i].mPosition * mat_vert;
+		}
+		
+		if (mRebuildNormal)
+		{
+			LLVector3 normal = vf.mVertices[i].mNormal * mat_normal;
+			normal.normVec();
+			
+			*normals++ = normal;
+		}
+		
+		if (mRebuildBinormal)
+		{
+			LLVector3 binormal = vf.mVertices[i].mBinormal * mat_normal;
+			binormal.normVec();
+			*binormals++ = binormal;
+		}
+		
+		if (mRebuildColor)
+		{
+			*colors++ = mColor;		
+		}
+	}
+}
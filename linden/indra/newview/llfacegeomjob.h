@@ -0,0 +1,120 @@
+/**
+ * @file llfacegeomjob.h
+ * @brief Generates one volume face's vertices, independent of the main thread.
+ *
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLFACEGEOMJOB_H
+#define LL_LLFACEGEOMJOB_H
+
+#include "llstrider.h"
+
+#include "llrender.h"
+#include "v2math.h"
+#include "v3math.h"
+#include "m3math.h"
+#include "m4math.h"
+#include "v4coloru.h"
+#include "llquaternion.h"
+#include "llvertexbuffer.h"
+
+class LLVolumeFace;
+
+// Everything needed to fill in one face's part of a vertex buffer, gathered
+// up front on the main thread by LLFace::prepareGeometryVolume().  fill()
+// reads nothing but the job and its volume face, so jobs for different faces
+// can run on different threads as long as their striders don't overlap.
+class LLFaceGeomJob
+{
+public:
+	LLFaceGeomJob();
+
+	// Points the striders at the job's place in mVertexBuffer, mapping it.
+	void useVertexBuffer();
+
+	void fill();
+
+public:
+	const LLVolumeFace*	mVolumeFace;
+	LLPointer<LLVertexBuffer> mVertexBuffer;	// where the data ends up
+	S32			mGeomIndex;
+	S32			mIndicesIndex;
+	S32			mNumVertices;
+	S32			mNumIndices;
+	U16			mIndexOffset;
+
+	BOOL		mRebuildPos;
+	BOOL		mRebuildNormal;
+	BOOL		mRebuildBinormal;
+	BOOL		mRebuildTCoord;
+	BOOL		mRebuildTCoord1;	// bump offsets
+	BOOL		mRebuildColor;
+	BOOL		mRebuildIndices;
+	BOOL		mUseTriStrips;
+
+	LLMatrix4	mMatVert;
+	LLMatrix3	mMatNormal;
+	LLColor4U	mColor;
+
+	// texture coordinates
+	LLVector3	mScale;
+	U8			mTexGen;
+	BOOL		mUseTexMatrix;		// texture animation
+	LLMatrix4	mTexMatrix;
+	F32			mCosAng, mSinAng;
+	F32			mOffsetS, mOffsetT;
+	F32			mScaleS, mScaleT;
+	BOOL		mInAtlas;
+	LLTexUnit::eTextureAddressMode mAddressMode;
+	LLVector2	mAtlasOffset;
+	LLVector2	mAtlasScale;
+
+	// bump offsets
+	LLVector3	mBinormalDir;
+	LLVector3	mBumpSLightRay;
+	LLVector3	mBumpTLightRay;
+	BOOL		mRotateBump;		// active drawables turn with their render matrix
+	LLQuaternion mBumpQuat;
+
+	LLStrider<LLVector3> mVertices;
+	LLStrider<LLVector3> mNormals;
+	LLStrider<LLVector3> mBinormals;
+	LLStrider<LLVector2> mTexCoords;
+	LLStrider<LLVector2> mTexCoords2;
+	LLStrider<LLColor4U> mColors;
+	LLStrider<U16>		mIndices;
+};
+
+// Texture coordinate generation, shared with LLFace
+void planarProjection(LLVector2 &tc, const LLVector3& normal,
+					  const LLVector3 &mCenter, const LLVector3& vec);
+void sphericalProjection(LLVector2 &tc, const LLVector3& normal,
+						 const LLVector3 &mCenter, const LLVector3& vec);
+void cylindricalProjection(LLVector2 &tc, const LLVector3& normal,
+						   const LLVector3 &mCenter, const LLVector3& vec);
+
+// Transform the texture coordinates for a face.
+void xformTexCoord(LLVector2 &tex_coord, F32 cosAng, F32 sinAng, F32 offS, F32 offT, F32 magS, F32 magT);
+
+#endif // LL_LLFACEGEOMJOB_H
@@ -76,6 +76,16 @@ static timer_tree_iterator_t end_timer_tree()
 	return timer_tree_iterator_t(); 
 }
 
+// The main thread's "Frame" tree first, then one tree per worker thread
+static std::vector<LLFastTimer::NamedTimer*> get_timer_roots()
+{
+	std::vector<LLFastTimer::NamedTimer*> roots;
+	roots.push_back(&LLFastTimer::NamedTimer::getRootNamedTimer());
+	const std::vector<LLFastTimer::NamedTimer*>& thread_roots = LLFastTimer::NamedTimer::getThreadRootTimers();
+	roots.insert(roots.end(), thread_roots.begin(), thread_roots.end());
+	return roots;
+}
+
 LLFastTimerView::LLFastTimerView(const LLRect& rect)
 :	LLFloater(LLSD()),
 	mHoverTimer(NULL)
@@ -136,11 +146,15 @@ LLFastTimer::NamedTimer* LLFastTimerView::getLegendID(S32 y)
 
 BOOL LLFastTimerView::handleDoubleClick(S32 x, S32 y, MASK mask)
 {
-	for(timer_tree_iterator_t it = begin_timer_tree(LLFastTimer::NamedTimer::getRootNamedTimer());
-		it != end_timer_tree();
-		++it)
+	std::vector<LLFastTimer::NamedTimer*> roots = get_timer_roots();
+	for (U32 r = 0; r < roots.size(); r++)
 	{
-		(*it)->setCollapsed(false);
+		for(timer_tree_iterator_t it = begin_timer_tree(*roots[r]);
+			it != end_timer_tree();
+			++it)
+		{
+			(*it)->setCollapsed(false);
+		}
 	}
 	return TRUE;
 }
@@ -238,26 +252,38 @@ BOOL LLFastTimerView::handleHover(S32 x, S32 y, MASK mask)
 			mHoverBarIndex = 0;
 		}
 
+		std::vector<LLFastTimer::NamedTimer*> roots = get_timer_roots();
 		S32 i = 0;
-		for(timer_tree_iterator_t it = begin_timer_tree(LLFastTimer::NamedTimer::getRootNamedTimer());
-			it != end_timer_tree();
-			++it, ++i)
+		for (U32 r = 0; r < roots.size(); r++)
 		{
-			// is mouse over bar for this timer?
-			if (x > mBarStart[mHoverBarIndex][i] &&
-				x < mBarEnd[mHoverBarIndex][i])
+			for(timer_tree_iterator_t it = begin_timer_tree(*roots[r]);
+				it != end_timer_tree();
+				++it, ++i)
 			{
-				mHoverID = (*it);
-				mHoverTimer = (*it);	
-				mToolTipRect.set(mBarStart[mHoverBarIndex][i], 
-					mBarRect.mBottom + llround(((F32)(MAX_VISIBLE_HISTORY - mHoverBarIndex + 1)) * ((F32)mBarRect.getHeight() / ((F32)MAX_VISIBLE_HISTORY + 2.f))),
-					mBarEnd[mHoverBarIndex][i],
-					mBarRect.mBottom + llround((F32)(MAX_VISIBLE_HISTORY - mHoverBarIndex) * ((F32)mBarRect.getHeight() / ((F32)MAX_VISIBLE_HISTORY + 2.f))));
-			}
+				// worker threads can add timers after the bars were drawn
+				if (mHoverBarIndex >= (S32)mBarStart.size() || i >= (S32)mBarStart[mHoverBarIndex].size())
+				{
+					break;
+				}
 
-			if ((*it)->getCollapsed())
-			{
-				it.skipDescendants();
+				// is mouse over bar for this timer?  Each thread has its own strip.
+				if (x > mBarStart[mHoverBarIndex][i] &&
+					x < mBarEnd[mHoverBarIndex][i] &&
+					y <= mBarTop[mHoverBarIndex][i] &&
+					y > mBarBottom[mHoverBarIndex][i])
+				{
+					mHoverID = (*it);
+					mHoverTimer = (*it);	
+					mToolTipRect.set(mBarStart[mHoverBarIndex][i], 
+						mBarTop[mHoverBarIndex][i],
+						mBarEnd[mHoverBarIndex][i],
+						mBarBottom[mHoverBarIndex][i]);
+				}
+
+				if ((*it)->getCollapsed())
+				{
+					it.skipDescendants();
+				}
 			}
 		}
 	}
@@ -408,23 +434,29 @@ void LLFastTimerView::draw()
 
 	F32 hue = 0.f;
 
-	for (timer_tree_iterator_t it = begin_timer_tree(LLFastTimer::NamedTimer::getRootNamedTimer());
-		it != timer_tree_iterator_t();
-		++it)
+	// worker threads follow the main thread in the legend and each history bar
+	std::vector<LLFastTimer::NamedTimer*> roots = get_timer_roots();
+
+	for (U32 r = 0; r < roots.size(); r++)
 	{
-		LLFastTimer::NamedTimer* idp = (*it);
+		for (timer_tree_iterator_t it = begin_timer_tree(*roots[r]);
+			it != timer_tree_iterator_t();
+			++it)
+		{
+			LLFastTimer::NamedTimer* idp = (*it);
 
-		const F32 HUE_INCREMENT = 0.23f;
-		hue = fmodf(hue + HUE_INCREMENT, 1.f);
-		// saturation increases with depth
-		F32 saturation = clamp_rescale((F32)idp->getDepth(), 0.f, 3.f, 0.f, 1.f);
-		// lightness alternates with depth
-		F32 lightness = idp->getDepth() % 2 ? 0.5f : 0.6f;
+			const F32 HUE_INCREMENT = 0.23f;
+			hue = fmodf(hue + HUE_INCREMENT, 1.f);
+			// saturation increases with depth
+			F32 saturation = clamp_rescale((F32)idp->getDepth(), 0.f, 3.f, 0.f, 1.f);
+			// lightness alternates with depth
+			F32 lightness = idp->getDepth() % 2 ? 0.5f : 0.6f;
 
-		LLColor4 child_color;
-		child_color.setHSL(hue, saturation, lightness);
+			LLColor4 child_color;
+			child_color.setHSL(hue, saturation, lightness);
 
-		sTimerColors[idp] = child_color;
+			sTimerColors[idp] = child_color;
+		}
 	}
 
 	const S32 LEGEND_WIDTH = 220;
@@ -433,88 +465,91 @@ void LLFastTimerView::draw()
 		S32 cur_line = 0;
 		ft_display_idx.clear();
 		std::map<LLFastTimer::NamedTimer*, S32> display_line;
-		for (timer_tree_iterator_t it = begin_timer_tree(LLFastTimer::NamedTimer::getRootNamedTimer());
-			it != timer_tree_iterator_t();
-			++it)
+		for (U32 r = 0; r < roots.size(); r++)
 		{
-			LLFastTimer::NamedTimer* idp = (*it);
-			display_line[idp] = cur_line;
-			ft_display_idx.push_back(idp);
-			cur_line++;
+			for (timer_tree_iterator_t it = begin_timer_tree(*roots[r]);
+				it != timer_tree_iterator_t();
+				++it)
+			{
+				LLFastTimer::NamedTimer* idp = (*it);
+				display_line[idp] = cur_line;
+				ft_display_idx.push_back(idp);
+				cur_line++;
 
-			x = xleft;
+				x = xleft;
 
-			left = x; right = x + texth;
-			top = y; bottom = y - texth;
-			S32 scale_offset = 0;
-			if (idp == mHoverID)
-			{
-				scale_offset = llfloor(sinf(mHighlightTimer.getElapsedTimeF32() * 6.f) * 2.f);
-			}
-			gl_rect_2d(left - scale_offset, top + scale_offset, right + scale_offset, bottom - scale_offset, sTimerColors[idp]);
+				left = x; right = x + texth;
+				top = y; bottom = y - texth;
+				S32 scale_offset = 0;
+				if (idp == mHoverID)
+				{
+					scale_offset = llfloor(sinf(mHighlightTimer.getElapsedTimeF32() * 6.f) * 2.f);
+				}
+				gl_rect_2d(left - scale_offset, top + scale_offset, right + scale_offset, bottom - scale_offset, sTimerColors[idp]);
 
-			F32 ms = 0;
-			S32 calls = 0;
-			if (mHoverBarIndex > 0 && mHoverID)
-			{
-				S32 hidx = LLFastTimer::NamedTimer::HISTORY_NUM - mScrollIndex - mHoverBarIndex;
-				U64 ticks = idp->getHistoricalCount(hidx);
-				ms = (F32)((F64)ticks * iclock_freq);
-				calls = (S32)idp->getHistoricalCalls(hidx);
-			}
-			else
-			{
-				U64 ticks = idp->getCountAverage();
-				ms = (F32)((F64)ticks * iclock_freq);
-				calls = (S32)idp->getCallAverage();
-			}
+				F32 ms = 0;
+				S32 calls = 0;
+				if (mHoverBarIndex > 0 && mHoverID)
+				{
+					S32 hidx = LLFastTimer::NamedTimer::HISTORY_NUM - mScrollIndex - mHoverBarIndex;
+					U64 ticks = idp->getHistoricalCount(hidx);
+					ms = (F32)((F64)ticks * iclock_freq);
+					calls = (S32)idp->getHistoricalCalls(hidx);
+				}
+				else
+				{
+					U64 ticks = idp->getCountAverage();
+					ms = (F32)((F64)ticks * iclock_freq);
+					calls = (S32)idp->getCallAverage();
+				}
 
-			if (mDisplayCalls)
-			{
-				tdesc = llformat("%s (%d)",idp->getName().c_str(),calls);
-			}
-			else
-			{
-				tdesc = llformat("%s [%.1f]",idp->getName().c_str(),ms);
-			}
-			dx = (texth+4) + idp->getDepth()*8;
+				if (mDisplayCalls)
+				{
+					tdesc = llformat("%s (%d)",idp->getName().c_str(),calls);
+				}
+				else
+				{
+					tdesc = llformat("%s [%.1f]",idp->getName().c_str(),ms);
+				}
+				dx = (texth+4) + idp->getDepth()*8;
 
-			LLColor4 color = LLColor4::white;
-			if (idp->getDepth() > 0)
-			{
-				S32 line_start_y = (top + bottom) / 2;
-				S32 line_end_y = line_start_y + ((texth + 2) * (cur_line - display_line[idp->getParent()])) - texth;
-				gl_line_2d(x + dx - 8, line_start_y, x + dx, line_start_y, color);
-				S32 line_x = x + (texth + 4) + ((idp->getDepth() - 1) * 8);
-				gl_line_2d(line_x, line_start_y, line_x, line_end_y, color);
-				if (idp->getCollapsed() && !idp->getChildren().empty())
+				LLColor4 color = LLColor4::white;
+				if (idp->getDepth() > 0)
 				{
-					gl_line_2d(line_x+4, line_start_y-3, line_x+4, line_start_y+4, color);
+					S32 line_start_y = (top + bottom) / 2;
+					S32 line_end_y = line_start_y + ((texth + 2) * (cur_line - display_line[idp->getParent()])) - texth;
+					gl_line_2d(x + dx - 8, line_start_y, x + dx, line_start_y, color);
+					S32 line_x = x + (texth + 4) + ((idp->getDepth() - 1) * 8);
+					gl_line_2d(line_x, line_start_y, line_x, line_end_y, color);
+					if (idp->getCollapsed() && !idp->getChildren().empty())
+					{
+						gl_line_2d(line_x+4, line_start_y-3, line_x+4, line_start_y+4, color);
+					}
 				}
-			}
 
-			x += dx;
-			BOOL is_child_of_hover_item = (idp == mHoverID);
-			LLFastTimer::NamedTimer* next_parent = idp->getParent();
-			while(!is_child_of_hover_item && next_parent)
-			{
-				is_child_of_hover_item = (mHoverID == next_parent);
-				next_parent = next_parent->getParent();
-			}
+				x += dx;
+				BOOL is_child_of_hover_item = (idp == mHoverID);
+				LLFastTimer::NamedTimer* next_parent = idp->getParent();
+				while(!is_child_of_hover_item && next_parent)
+				{
+					is_child_of_hover_item = (mHoverID == next_parent);
+					next_parent = next_parent->getParent();
+				}
 
-			LLFontGL::getFontMonospace()->renderUTF8(tdesc, 0, 
-											x, y, 
-											color, 
-											LLFontGL::LEFT, LLFontGL::TOP, 
-											is_child_of_hover_item ? LLFontGL::BOLD : LLFontGL::NORMAL);
+				LLFontGL::getFontMonospace()->renderUTF8(tdesc, 0, 
+												x, y, 
+												color, 
+												LLFontGL::LEFT, LLFontGL::TOP, 
+												is_child_of_hover_item ? LLFontGL::BOLD : LLFontGL::NORMAL);
 
-			y -= (texth + 2);
+				y -= (texth + 2);
 
-			textw = dx + LLFontGL::getFontMonospace()->getWidth(idp->getName()) + 40;
+				textw = dx + LLFontGL::getFontMonospace()->getWidth(idp->getName()) + 40;
 
-			if (idp->getCollapsed()) 
-			{
-				it.skipDescendants();
+				if (idp->getCollapsed()) 
+				{
+					it.skipDescendants();
+				}
 			}
 		}
 	}
@@ -658,6 +693,18 @@ void LLFastTimerView::draw()
 		
 		mBarStart.clear();
 		mBarEnd.clear();
+		mBarTop.clear();
+		mBarBottom.clear();
+
+		// The main thread gets the top half of each bar, and worker threads
+		// share the rest, one strip each, on the same time scale
+		S32 main_barh = barh;
+		S32 thread_barh = 0;
+		if (roots.size() > 1)
+		{
+			main_barh = barh - barh / 2;
+			thread_barh = llmax(2, (barh / 2) / (S32)(roots.size() - 1));
+		}
 
 		// Draw bars for each history entry
 		// Special: -1 = show running average
@@ -666,6 +713,8 @@ void LLFastTimerView::draw()
 		{
 			mBarStart.push_back(std::vector<S32>());
 			mBarEnd.push_back(std::vector<S32>());
+			mBarTop.push_back(std::vector<S32>());
+			mBarBottom.push_back(std::vector<S32>());
 			int sublevel_dx[FTV_MAX_DEPTH];
 			int sublevel_left[FTV_MAX_DEPTH];
 			int sublevel_right[FTV_MAX_DEPTH];
@@ -689,109 +738,123 @@ void LLFastTimerView::draw()
 			LLFastTimer::NamedTimer* prev_id = NULL;
 
 			S32 i = 0;
-			for(timer_tree_iterator_t it = begin_timer_tree(LLFastTimer::NamedTimer::getRootNamedTimer());
-				it != end_timer_tree();
-				++it, ++i)
+			S32 strip_top = y;
+			for (U32 r = 0; r < roots.size(); r++)
 			{
-				LLFastTimer::NamedTimer* idp = (*it);
-				F32 frac = tidx == -1
-					? (F32)idp->getCountAverage() / (F32)totalticks 
-					: (F32)idp->getHistoricalCount(tidx) / (F32)totalticks;
+				S32 strip_height = (r == 0) ? main_barh : thread_barh;
+				xpos.clear();
+				xpos.push_back(xleft);
+				deltax.clear();
+				prev_id = NULL;
+
+				for(timer_tree_iterator_t it = begin_timer_tree(*roots[r]);
+					it != end_timer_tree();
+					++it, ++i)
+				{
+					LLFastTimer::NamedTimer* idp = (*it);
+					F32 frac = tidx == -1
+						? (F32)idp->getCountAverage() / (F32)totalticks 
+						: (F32)idp->getHistoricalCount(tidx) / (F32)totalticks;
 		
-				dx = llround(frac * (F32)barw);
-				S32 prev_delta_x = deltax.empty() ? 0 : deltax.back();
-				deltax.push_back(dx);
+					dx = llround(frac * (F32)barw);
+					S32 prev_delta_x = deltax.empty() ? 0 : deltax.back();
+					deltax.push_back(dx);
 				
-				int level = idp->getDepth() - 1;
+					int level = idp->getDepth() - 1;
 				
-				while ((S32)xpos.size() > level + 1)
-				{
-					xpos.pop_back();
-				}
-				left = xpos.back();
-				
-				if (level == 0)
-				{
-					sublevel_left[level] = xleft;
-					sublevel_dx[level] = dx;
-					sublevel_right[level] = sublevel_left[level] + sublevel_dx[level];
-				}
-				else if (prev_id && prev_id->getDepth() < idp->getDepth())
-				{
-					U64 sublevelticks = 0;
-
-					for (LLFastTimer::NamedTimer::child_const_iter it = prev_id->beginChildren();
-						it != prev_id->endChildren();
-						++it)
+					while ((S32)xpos.size() > level + 1)
 					{
-						sublevelticks += (tidx == -1)
-							? (*it)->getCountAverage() 
-							: (*it)->getHistoricalCount(tidx);
+						xpos.pop_back();
 					}
-
-					F32 subfrac = (F32)sublevelticks / (F32)totalticks;
-					sublevel_dx[level] = (int)(subfrac * (F32)barw + .5f);
-
-					if (mDisplayCenter == ALIGN_CENTER)
+					left = xpos.back();
+				
+					if (level == 0)
 					{
-						left += (prev_delta_x - sublevel_dx[level])/2;
+						sublevel_left[level] = xleft;
+						sublevel_dx[level] = dx;
+						sublevel_right[level] = sublevel_left[level] + sublevel_dx[level];
 					}
-					else if (mDisplayCenter == ALIGN_RIGHT)
+					else if (prev_id && prev_id->getDepth() < idp->getDepth())
 					{
-						left += (prev_delta_x - sublevel_dx[level]);
-					}
-
-					sublevel_left[level] = left;
-					sublevel_right[level] = sublevel_left[level] + sublevel_dx[level];
-				}				
-
-				right = left + dx;
-				xpos.back() = right;
-				xpos.push_back(left);
+						U64 sublevelticks = 0;
+
+						for (LLFastTimer::NamedTimer::child_const_iter it = prev_id->beginChildren();
+							it != prev_id->endChildren();
+							++it)
+						{
+							sublevelticks += (tidx == -1)
+								? (*it)->getCountAverage() 
+								: (*it)->getHistoricalCount(tidx);
+						}
+
+						F32 subfrac = (F32)sublevelticks / (F32)totalticks;
+						sublevel_dx[level] = (int)(subfrac * (F32)barw + .5f);
+
+						if (mDisplayCenter == ALIGN_CENTER)
+						{
+							left += (prev_delta_x - sublevel_dx[level])/2;
+						}
+						else if (mDisplayCenter == ALIGN_RIGHT)
+						{
+							left += (prev_delta_x - sublevel_dx[level]);
+						}
+
+						sublevel_left[level] = left;
+						sublevel_right[level] = sublevel_left[level] + sublevel_dx[level];
+					}				
+
+					right = left + dx;
+					xpos.back() = right;
+					xpos.push_back(left);
 				
-				mBarStart.back().push_back(left);
-				mBarEnd.back().push_back(right);
-
-				top = y;
-				bottom = y - barh;
+					mBarStart.back().push_back(left);
+					mBarEnd.back().push_back(right);
 
-				if (right > left)
-				{
-					//U32 rounded_edges = 0;
-					LLColor4 color = sTimerColors[idp];//*ft_display_table[i].color;
-					S32 scale_offset = 0;
+					top = strip_top;
+					bottom = strip_top - strip_height;
+					mBarTop.back().push_back(top);
+					mBarBottom.back().push_back(bottom);
+					S32 inset = llmin(level, strip_height / 4);
 
-					BOOL is_child_of_hover_item = (idp == mHoverID);
-					LLFastTimer::NamedTimer* next_parent = idp->getParent();
-					while(!is_child_of_hover_item && next_parent)
+					if (right > left)
 					{
-						is_child_of_hover_item = (mHoverID == next_parent);
-						next_parent = next_parent->getParent();
-					}
+						//U32 rounded_edges = 0;
+						LLColor4 color = sTimerColors[idp];//*ft_display_table[i].color;
+						S32 scale_offset = 0;
+
+						BOOL is_child_of_hover_item = (idp == mHoverID);
+						LLFastTimer::NamedTimer* next_parent = idp->getParent();
+						while(!is_child_of_hover_item && next_parent)
+						{
+							is_child_of_hover_item = (mHoverID == next_parent);
+							next_parent = next_parent->getParent();
+						}
+
+						if (idp == mHoverID)
+						{
+							scale_offset = llfloor(sinf(mHighlightTimer.getElapsedTimeF32() * 6.f) * 3.f);
+							//color = lerp(color, LLColor4::black, -0.4f);
+						}
+						else if (mHoverID != NULL && !is_child_of_hover_item)
+						{
+							color = lerp(color, LLColor4::grey, 0.8f);
+						}
+
+						gGL.color4fv(color.mV);
+						F32 start_fragment = llclamp((F32)(left - sublevel_left[level]) / (F32)sublevel_dx[level], 0.f, 1.f);
+						F32 end_fragment = llclamp((F32)(right - sublevel_left[level]) / (F32)sublevel_dx[level], 0.f, 1.f);
+						gl_segmented_rect_2d_fragment_tex(sublevel_left[level], top - inset + scale_offset, sublevel_right[level], bottom + inset - scale_offset, box_imagep->getTextureWidth(), box_imagep->getTextureHeight(), 16, start_fragment, end_fragment);
 
-					if (idp == mHoverID)
-					{
-						scale_offset = llfloor(sinf(mHighlightTimer.getElapsedTimeF32() * 6.f) * 3.f);
-						//color = lerp(color, LLColor4::black, -0.4f);
 					}
-					else if (mHoverID != NULL && !is_child_of_hover_item)
+
+					if ((*it)->getCollapsed())
 					{
-						color = lerp(color, LLColor4::grey, 0.8f);
+						it.skipDescendants();
 					}
-
-					gGL.color4fv(color.mV);
-					F32 start_fragment = llclamp((F32)(left - sublevel_left[level]) / (F32)sublevel_dx[level], 0.f, 1.f);
-					F32 end_fragment = llclamp((F32)(right - sublevel_left[level]) / (F32)sublevel_dx[level], 0.f, 1.f);
-					gl_segmented_rect_2d_fragment_tex(sublevel_left[level], top - level + scale_offset, sublevel_right[level], bottom + level - scale_offset, box_imagep->getTextureWidth(), box_imagep->getTextureHeight(), 16, start_fragment, end_fragment);
-
-				}
-
-				if ((*it)->getCollapsed())
-				{
-					it.skipDescendants();
-				}
 		
-				prev_id = idp;
+					prev_id = idp;
+				}
+				strip_top -= strip_height;
 			}
 			y -= (barh + dy);
 			if (j < 0)
@@ -852,70 +915,73 @@ void LLFastTimerView::draw()
 			}
 			
 			U64 cur_max = 0;
-			for(timer_tree_iterator_t it = begin_timer_tree(LLFastTimer::NamedTimer::getRootNamedTimer());
-				it != end_timer_tree();
-				++it)
+			for (U32 r = 0; r < roots.size(); r++)
 			{
-				LLFastTimer::NamedTimer* idp = (*it);
-				
-				//fatten highlighted timer
-				if (mHoverID == idp)
+				for(timer_tree_iterator_t it = begin_timer_tree(*roots[r]);
+					it != end_timer_tree();
+					++it)
 				{
-					gGL.flush();
-					glLineWidth(3);
-				}
+					LLFastTimer::NamedTimer* idp = (*it);
+				
+					//fatten highlighted timer
+					if (mHoverID == idp)
+					{
+						gGL.flush();
+						glLineWidth(3);
+					}
 			
-				const F32 * col = sTimerColors[idp].mV;// ft_display_table[idx].color->mV;
+					const F32 * col = sTimerColors[idp].mV;// ft_display_table[idx].color->mV;
 				
-				F32 alpha = 1.f;
+					F32 alpha = 1.f;
 				
-				if (mHoverID != NULL &&
-					idp != mHoverID)
-				{	//fade out non-hihglighted timers
-					if (idp->getParent() != mHoverID)
-					{
-						alpha = alpha_interp;
+					if (mHoverID != NULL &&
+						idp != mHoverID)
+					{	//fade out non-hihglighted timers
+						if (idp->getParent() != mHoverID)
+						{
+							alpha = alpha_interp;
+						}
 					}
-				}
-
-				gGL.color4f(col[0], col[1], col[2], alpha);				
-				gGL.begin(LLRender::LINE_STRIP);
-				for (U32 j = 0; j < LLFastTimer::NamedTimer::HISTORY_NUM; j++)
-				{
-					U64 ticks = idp->getHistoricalCount(j);
 
-					if (mDisplayHz)
-					{
-						F64 tc = (F64) (ticks+1) * iclock_freq;
-						tc = 1000.f/tc;
-						ticks = llmin((U64) tc, (U64) 1024);
-					}
-					else if (mDisplayCalls)
+					gGL.color4f(col[0], col[1], col[2], alpha);				
+					gGL.begin(LLRender::LINE_STRIP);
+					for (U32 j = 0; j < LLFastTimer::NamedTimer::HISTORY_NUM; j++)
 					{
-						ticks = (S32)idp->getHistoricalCalls(j);
-					}
+						U64 ticks = idp->getHistoricalCount(j);
+
+						if (mDisplayHz)
+						{
+							F64 tc = (F64) (ticks+1) * iclock_freq;
+							tc = 1000.f/tc;
+							ticks = llmin((U64) tc, (U64) 1024);
+						}
+						else if (mDisplayCalls)
+						{
+							ticks = (S32)idp->getHistoricalCalls(j);
+						}
 										
-					if (alpha == 1.f)
-					{ 
-						//normalize to highlighted timer
-						cur_max = llmax(cur_max, ticks);
+						if (alpha == 1.f)
+						{ 
+							//normalize to highlighted timer
+							cur_max = llmax(cur_max, ticks);
+						}
+						F32 x = graph_rect.mLeft + ((F32) (graph_rect.getWidth()))/(LLFastTimer::NamedTimer::HISTORY_NUM-1)*j;
+						F32 y = graph_rect.mBottom + (F32) graph_rect.getHeight()/max_ticks*ticks;
+						gGL.vertex2f(x,y);
 					}
-					F32 x = graph_rect.mLeft + ((F32) (graph_rect.getWidth()))/(LLFastTimer::NamedTimer::HISTORY_NUM-1)*j;
-					F32 y = graph_rect.mBottom + (F32) graph_rect.getHeight()/max_ticks*ticks;
-					gGL.vertex2f(x,y);
-				}
-				gGL.end();
+					gGL.end();
 				
-				if (mHoverID == idp)
-				{
-					gGL.flush();
-					glLineWidth(1);
-				}
+					if (mHoverID == idp)
+					{
+						gGL.flush();
+						glLineWidth(1);
+					}
 
-				if (idp->getCollapsed())
-				{	
-					//skip hidden timers
-					it.skipDescendants();
+					if (idp->getCollapsed())
+					{	
+						//skip hidden timers
+						it.skipDescendants();
+					}
 				}
 			}
 			
@@ -948,56 +1014,62 @@ void LLFastTimerView::draw()
 	{
 		std::string legend_stat;
 		bool first = true;
-		for(timer_tree_iterator_t it = begin_timer_tree(LLFastTimer::NamedTimer::getRootNamedTimer());
-			it != end_timer_tree();
-			++it)
+		for (U32 r = 0; r < roots.size(); r++)
 		{
-			LLFastTimer::NamedTimer* idp = (*it);
-
-			if (!first)
+			for(timer_tree_iterator_t it = begin_timer_tree(*roots[r]);
+				it != end_timer_tree();
+				++it)
 			{
-				legend_stat += ", ";
-			}
-			first = false;
-			legend_stat += idp->getName();
+				LLFastTimer::NamedTimer* idp = (*it);
 
-			if (idp->getCollapsed())
-			{
-				it.skipDescendants();
+				if (!first)
+				{
+					legend_stat += ", ";
+				}
+				first = false;
+				legend_stat += idp->getName();
+
+				if (idp->getCollapsed())
+				{
+					it.skipDescendants();
+				}
 			}
 		}
 		llinfos << legend_stat << llendl;
 
 		std::string timer_stat;
 		first = true;
-		for(timer_tree_iterator_t it = begin_timer_tree(LLFastTimer::NamedTimer::getRootNamedTimer());
-			it != end_timer_tree();
-			++it)
+		for (U32 r = 0; r < roots.size(); r++)
 		{
-			LLFastTimer::NamedTimer* idp = (*it);
-
-			if (!first)
+			for(timer_tree_iterator_t it = begin_timer_tree(*roots[r]);
+				it != end_timer_tree();
+				++it)
 			{
-				timer_stat += ", ";
-			}
-			first = false;
+				LLFastTimer::NamedTimer* idp = (*it);
 
-			U64 ticks;
-			if (mPrintStats > 0)
-			{
-				ticks = idp->getHistoricalCount(mPrintStats);
-			}
-			else
-			{
-				ticks = idp->getCountAverage();
-			}
-			F32 ms = (F32)((F64)ticks * iclock_freq);
+				if (!first)
+				{
+					timer_stat += ", ";
+				}
+				first = false;
 
-			timer_stat += llformat("%.1f",ms);
+				U64 ticks;
+				if (mPrintStats > 0)
+				{
+					ticks = idp->getHistoricalCount(mPrintStats);
+				}
+				else
+				{
+					ticks = idp->getCountAverage();
+				}
+				F32 ms = (F32)((F64)ticks * iclock_freq);
 
-			if (idp->getCollapsed())
-			{
-				it.skipDescendants();
+				timer_stat += llformat("%.1f",ms);
+
+				if (idp->getCollapsed())
+				{
+					it.skipDescendants();
+				}
 			}
 		}
 		llinfos << timer_stat << llendl;
@@ -65,6 +65,8 @@ private:
 	typedef std::vector<std::vector<S32> > bar_positions_t;
 	bar_positions_t mBarStart;
 	bar_positions_t mBarEnd;
+	bar_positions_t mBarTop;
+	bar_positions_t mBarBottom;
 	S32 mDisplayMode;
 
 	typedef enum child_alignment
@@ -31,6 +31,7 @@
 #include "llappviewer.h"
 #include "llallocator_heap_profile.h"
 #include "llgl.h"						// LLGLSUIDefault
+#include "llmempool.h"
 #include "llviewerwindow.h"
 #include "llviewercontrol.h"
 
@@ -92,6 +93,17 @@ void LLMemoryView::refreshProfile()
 
 	mLines.clear();
 
+	// live totals from the pool are always there, profiling or not
+	std::vector<LLMemPool::Usage> usage;
+	LLMemPool::getUsage(usage);
+	for (size_t i = 0; i < usage.size(); ++i)
+	{
+		std::stringstream ss;
+		ss << "Pooled Mem: " << (usage[i].mBytes >> 10) << " K in " << usage[i].mCount << " blocks     Type: "
+		   << LLMemType::getNameFromID(usage[i].mType);
+		mLines.push_back(utf8string_to_wstring(ss.str()));
+	}
+
  	if(mAlloc->isProfiling()) 
 	{
 		const LLAllocatorHeapProfile &prof = mAlloc->getProfile();
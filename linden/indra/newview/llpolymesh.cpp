@@ -40,6 +40,7 @@
 #include "llendianswizzle.h"
 
 #include "llfasttimer.h"
+#include "llv4math.h"
 
 #define HEADER_ASCII "Linden Mesh 1.0"
 #define HEADER_BINARY "Linden Binary Mesh 1.0"
@@ -913,6 +914,136 @@ LLVector3 *LLPolyMesh::getScaledBinormals()
 }
 
 
+//-----------------------------------------------------------------------------
+// dirtyNormals()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::dirtyNormals(const U32* vert_indices, U32 count)
+{
+	if (mNormalDirty.empty())
+	{
+		mNormalDirty.resize(mSharedData->mNumVertices, 0);
+	}
+	for (U32 i = 0; i < count; i++)
+	{
+		U32 vert_index = vert_indices[i];
+		if (!mNormalDirty[vert_index])
+		{
+			mNormalDirty[vert_index] = 1;
+			mDirtyNormals.push_back(vert_index);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// updateNormals()
+// Normalizes the morphed normals, and rebuilds the binormals from them, for
+// every dirty vertex.  The results only depend on the final scaled normals
+// and binormals, so they are the same as normalizing after every morph.
+//-----------------------------------------------------------------------------
+void LLPolyMesh::updateNormals()
+{
+	if (mSharedData && mSharedData->isLOD() && mReferenceMesh)
+	{
+		// LODs share their vertex data with the reference mesh
+		mReferenceMesh->updateNormals();
+		return;
+	}
+	if (mDirtyNormals.empty())
+	{
+		return;
+	}
+
+	const U32 count = mDirtyNormals.size();
+	const U32* vert_indices = &mDirtyNormals[0];
+	U32 i = 0;
+
+#if LL_VECTORIZE
+	// Four vertices at a time, one per lane, with the same operations in the
+	// same order as LLVector3::normVec() and operator%.
+	const __m128 threshold = _mm_set1_ps(FP_MAG_THRESHOLD);
+	const __m128 one = _mm_set1_ps(1.f);
+	for (; i + 4 <= count; i += 4)
+	{
+		F32 sn[3][4];
+		F32 sb[3][4];
+		for (U32 lane = 0; lane < 4; lane++)
+		{
+			const U32 vert_index = vert_indices[i + lane];
+			for (U32 c = 0; c < 3; c++)
+			{
+				sn[c][lane] = mScaledNormals[vert_index].mV[c];
+				sb[c][lane] = mScaledBinormals[vert_index].mV[c];
+			}
+		}
+		__m128 nx = _mm_loadu_ps(sn[VX]);
+		__m128 ny = _mm_loadu_ps(sn[VY]);
+		__m128 nz = _mm_loadu_ps(sn[VZ]);
+		__m128 bx = _mm_loadu_ps(sb[VX]);
+		__m128 by = _mm_loadu_ps(sb[VY]);
+		__m128 bz = _mm_loadu_ps(sb[VZ]);
+
+		// normalized_normal = scaled_normal.normVec()
+		__m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+		__m128 valid = _mm_cmpgt_ps(mag, threshold);
+		__m128 oomag = _mm_div_ps(one, mag);
+		nx = _mm_and_ps(valid, _mm_mul_ps(nx, oomag));
+		ny = _mm_and_ps(valid, _mm_mul_ps(ny, oomag));
+		nz = _mm_and_ps(valid, _mm_mul_ps(nz, oomag));
+
+		// tangent = scaled_binormal % normalized_normal
+		__m128 tx = _mm_sub_ps(_mm_mul_ps(by, nz), _mm_mul_ps(ny, bz));
+		__m128 ty = _mm_sub_ps(_mm_mul_ps(bz, nx), _mm_mul_ps(nz, bx));
+		__m128 tz = _mm_sub_ps(_mm_mul_ps(bx, ny), _mm_mul_ps(nx, by));
+
+		// binormal = (normalized_normal % tangent).normVec()
+		bx = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(ty, nz));
+		by = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(tz, nx));
+		bz = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(tx, ny));
+		mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(bx, bx), _mm_mul_ps(by, by)), _mm_mul_ps(bz, bz)));
+		valid = _mm_cmpgt_ps(mag, threshold);
+		oomag = _mm_div_ps(one, mag);
+		bx = _mm_and_ps(valid, _mm_mul_ps(bx, oomag));
+		by = _mm_and_ps(valid, _mm_mul_ps(by, oomag));
+		bz = _mm_and_ps(valid, _mm_mul_ps(bz, oomag));
+
+		_mm_storeu_ps(sn[VX], nx);
+		_mm_storeu_ps(sn[VY], ny);
+		_mm_storeu_ps(sn[VZ], nz);
+		_mm_storeu_ps(sb[VX], bx);
+		_mm_storeu_ps(sb[VY], by);
+		_mm_storeu_ps(sb[VZ], bz);
+		for (U32 lane = 0; lane < 4; lane++)
+		{
+			const U32 vert_index = vert_indices[i + lane];
+			for (U32 c = 0; c < 3; c++)
+			{
+				mNormals[vert_index].mV[c] = sn[c][lane];
+				mBinormals[vert_index].mV[c] = sb[c][lane];
+			}
+			mNormalDirty[vert_index] = 0;
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		const U32 vert_index = vert_indices[i];
+
+		LLVector3 normalized_normal = mScaledNormals[vert_index];
+		normalized_normal.normVec();
+		mNormals[vert_index] = normalized_normal;
+
+		LLVector3 tangent = mScaledBinormals[vert_index] % normalized_normal;
+		LLVector3 normalized_binormal = normalized_normal % tangent; 
+		normalized_binormal.normVec();
+		mBinormals[vert_index] = normalized_binormal;
+
+		mNormalDirty[vert_index] = 0;
+	}
+
+	mDirtyNormals.clear();
+}
+
 //-----------------------------------------------------------------------------
 // initializeForMorph()
 //-----------------------------------------------------------------------------
@@ -928,6 +1059,9 @@ void LLPolyMesh::initializeForMorph()
 	memcpy(mScaledBinormals, mSharedData->mBaseBinormals, sizeof(LLVector3) * mSharedData->mNumVertices);		/*Flawfinder: ignore*/
 	memcpy(mTexCoords, mSharedData->mTexCoords, sizeof(LLVector2) * mSharedData->mNumVertices);		/*Flawfinder: ignore*/
 	memset(mClothingWeights, 0, sizeof(LLVector4) * mSharedData->mNumVertices);
+
+	mDirtyNormals.clear();
+	mNormalDirty.clear();
 }
 
 //-----------------------------------------------------------------------------
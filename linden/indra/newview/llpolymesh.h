@@ -253,6 +253,13 @@ public:
 	LLVector3 *getWritableBinormals();
 	LLVector3 *getScaledBinormals();
 
+	// Morphs only move the scaled normals and binormals, and list the
+	// vertices they touched here.  updateNormals() renormalizes those once,
+	// however many morphs moved them, and must be called before the output
+	// normals are read.
+	void dirtyNormals(const U32* vert_indices, U32 count);
+	void updateNormals();
+
 	// Get texCoords
 	const LLVector2	*getTexCoords() const { 
 		return mTexCoords; 
@@ -354,6 +361,9 @@ protected:
 	LLVector4				*mClothingWeights;
 	// output texture coordinates
 	LLVector2				*mTexCoords;
+	// vertices whose output normals are out of date, and a flag per vertex
+	std::vector<U32>		mDirtyNormals;
+	std::vector<U8>			mNormalDirty;
 	
 	LLPolyMesh				*mReferenceMesh;
 
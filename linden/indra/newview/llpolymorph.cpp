@@ -34,6 +34,7 @@
 #include "llwearable.h"
 #include "llxmltree.h"
 #include "llendianswizzle.h"
+#include "llv4math.h"
 
 //#include "../tools/imdebug/imdebug.h"
 
@@ -55,6 +56,7 @@ LLPolyMorphData::LLPolyMorphData(const std::string& morph_name)
 	mNormals = NULL;
 	mBinormals = NULL;
 	mTexCoords = NULL;
+	mPackedDeltas = NULL;
 
 	mMesh = NULL;
 }
@@ -69,6 +71,7 @@ LLPolyMorphData::~LLPolyMorphData()
 	delete [] mNormals;
 	delete [] mBinormals;
 	delete [] mTexCoords;
+	delete [] mPackedDeltas;
 }
 
 //-----------------------------------------------------------------------------
@@ -172,6 +175,24 @@ BOOL LLPolyMorphData::loadBinary(LLFILE *fp, LLPolyMeshSharedData *mesh)
 	mAvgDistortion = mAvgDistortion * (1.f/(F32)mNumIndices);
 	mAvgDistortion.normVec();
 
+#if LL_VECTORIZE
+	// The fourth float of each delta is -0, which leaves whatever it is
+	// added to untouched.
+	mPackedDeltas = new F32[mNumIndices * 12];
+	for (U32 v = 0; v < mNumIndices; v++)
+	{
+		F32* packed = mPackedDeltas + v * 12;
+		const LLVector3* deltas[3] = { &mCoords[v], &mNormals[v], &mBinormals[v] };
+		for (S32 d = 0; d < 3; d++)
+		{
+			packed[d * 4 + VX] = deltas[d]->mV[VX];
+			packed[d * 4 + VY] = deltas[d]->mV[VY];
+			packed[d * 4 + VZ] = deltas[d]->mV[VZ];
+			packed[d * 4 + 3] = -0.f;
+		}
+	}
+#endif
+
 	return TRUE;
 }
 
@@ -458,17 +479,63 @@ void LLPolyMorphTarget::apply( ESex avatar_sex )
 		LLVector3 *coords = mMesh->getWritableCoords();
 
 		LLVector3 *scaled_normals = mMesh->getScaledNormals();
-		LLVector3 *normals = mMesh->getWritableNormals();
-
 		LLVector3 *scaled_binormals = mMesh->getScaledBinormals();
-		LLVector3 *binormals = mMesh->getWritableBinormals();
 
-		LLVector4 *clothing_weights = mMesh->getWritableClothingWeights();
+		LLVector4 *clothing_weights = getInfo()->mIsClothingMorph ? mMesh->getWritableClothingWeights() : NULL;
 		LLVector2 *tex_coords = mMesh->getWritableTexCoords();
 
 		F32 *maskWeightArray = (mVertMask) ? mVertMask->getMorphMaskWeights() : NULL;
 
-		for(U32 vert_index_morph = 0; vert_index_morph < mMorphData->mNumIndices; vert_index_morph++)
+		U32 vert_index_morph = 0;
+#if LL_VECTORIZE
+		if (mMorphData->mPackedDeltas)
+		{
+			// Each delta is added to a whole xyz+1 float vector.  That is safe
+			// because the mesh keeps all its vertex arrays in one block, so
+			// there is always a float after the last vertex, and adding the
+			// delta's -0 leaves that float as it was.
+			const __m128 weight = _mm_set1_ps(delta_weight);
+			const __m128 soften = _mm_set1_ps(NORMAL_SOFTEN_FACTOR);
+			const __m128 neg_zero_w = _mm_set_ps(-0.f, 0.f, 0.f, 0.f);
+			const F32* packed = mMorphData->mPackedDeltas;
+			for(; vert_index_morph < mMorphData->mNumIndices; vert_index_morph++, packed += 12)
+			{
+				S32 vert_index_mesh = mMorphData->mVertexIndices[vert_index_morph];
+
+				F32 maskWeight = 1.f;
+				if (maskWeightArray)
+				{
+					maskWeight = maskWeightArray[vert_index_morph];
+				}
+				const __m128 mask = _mm_set1_ps(maskWeight);
+
+				// products of -0 can come out as +0, so put the sign back
+				__m128 coord_delta = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(packed), weight), mask);
+				coord_delta = _mm_or_ps(coord_delta, neg_zero_w);
+				__m128 normal_delta = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(packed + 4), weight), mask), soften);
+				normal_delta = _mm_or_ps(normal_delta, neg_zero_w);
+				__m128 binormal_delta = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(packed + 8), weight), mask), soften);
+				binormal_delta = _mm_or_ps(binormal_delta, neg_zero_w);
+
+				F32* coord = coords[vert_index_mesh].mV;
+				_mm_storeu_ps(coord, _mm_add_ps(_mm_loadu_ps(coord), coord_delta));
+				if (clothing_weights)
+				{
+					LLVector4* clothing_weight = &clothing_weights[vert_index_mesh];
+					_mm_storeu_ps(clothing_weight->mV, _mm_add_ps(_mm_loadu_ps(clothing_weight->mV), coord_delta));
+					clothing_weight->mV[VW] = maskWeight;
+				}
+
+				F32* scaled_normal = scaled_normals[vert_index_mesh].mV;
+				_mm_storeu_ps(scaled_normal, _mm_add_ps(_mm_loadu_ps(scaled_normal), normal_delta));
+				F32* scaled_binormal = scaled_binormals[vert_index_mesh].mV;
+				_mm_storeu_ps(scaled_binormal, _mm_add_ps(_mm_loadu_ps(scaled_binormal), binormal_delta));
+
+				tex_coords[vert_index_mesh] += mMorphData->mTexCoords[vert_index_morph] * delta_weight * maskWeight;
+			}
+		}
+#endif
+		for(; vert_index_morph < mMorphData->mNumIndices; vert_index_morph++)
 		{
 			S32 vert_index_mesh = mMorphData->mVertexIndices[vert_index_morph];
 
@@ -479,7 +546,7 @@ void LLPolyMorphTarget::apply( ESex avatar_sex )
 			}
 
 			coords[vert_index_mesh] += mMorphData->mCoords[vert_index_morph] * delta_weight * maskWeight;
-			if (getInfo()->mIsClothingMorph && clothing_weights)
+			if (clothing_weights)
 			{
 				LLVector3 clothing_offset = mMorphData->mCoords[vert_index_morph] * delta_weight * maskWeight;
 				LLVector4* clothing_weight = &clothing_weights[vert_index_mesh];
@@ -489,21 +556,14 @@ void LLPolyMorphTarget::apply( ESex avatar_sex )
 				clothing_weight->mV[VW] = maskWeight;
 			}
 
-			// calculate new normals based on half angles
+			// new normals and binormals are worked out from these, based on
+			// half angles, by LLPolyMesh::updateNormals()
 			scaled_normals[vert_index_mesh] += mMorphData->mNormals[vert_index_morph] * delta_weight * maskWeight * NORMAL_SOFTEN_FACTOR;
-			LLVector3 normalized_normal = scaled_normals[vert_index_mesh];
-			normalized_normal.normVec();
-			normals[vert_index_mesh] = normalized_normal;
-
-			// calculate new binormals
 			scaled_binormals[vert_index_mesh] += mMorphData->mBinormals[vert_index_morph] * delta_weight * maskWeight * NORMAL_SOFTEN_FACTOR;
-			LLVector3 tangent = scaled_binormals[vert_index_mesh] % normalized_normal;
-			LLVector3 normalized_binormal = normalized_normal % tangent; 
-			normalized_binormal.normVec();
-			binormals[vert_index_mesh] = normalized_binormal;
 
 			tex_coords[vert_index_mesh] += mMorphData->mTexCoords[vert_index_morph] * delta_weight * maskWeight;
 		}
+		mMesh->dirtyNormals(mMorphData->mVertexIndices, mMorphData->mNumIndices);
 
 		// now apply volume changes
 		for( volume_list_t::iterator iter = mVolumeMorphs.begin(); iter != mVolumeMorphs.end(); iter++ )
@@ -567,6 +627,7 @@ void	LLPolyMorphTarget::applyMask(U8 *maskTextureData, S32 width, S32 height, S3
 					clothing_weight->mV[VZ] -= clothing_offset.mV[VZ];
 				}
 			}
+			mMesh->dirtyNormals(mMorphData->mVertexIndices, mMorphData->mNumIndices);
 		}
 	}
 
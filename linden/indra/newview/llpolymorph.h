@@ -62,6 +62,10 @@ public:
 	LLVector3*			mBinormals;
 	LLVector2*			mTexCoords;
 
+	// mCoords, mNormals and mBinormals interleaved as four floats each, for
+	// vectorized apply().  NULL when not vectorized.
+	F32*				mPackedDeltas;
+
 	F32					mTotalDistortion;	// vertex distortion summed over entire morph
 	F32					mMaxDistortion;		// maximum single vertex distortion in a given morph
 	LLVector3			mAvgDistortion;		// average vertex distortion, to infer directionality of the morph
@@ -532,7 +532,7 @@ void validate_draw_info(LLDrawInfo& params)
 	}
 	
 	//bad indices
-	U16* indicesp = (U16*) params.mVertexBuffer->getIndicesPointer();
+	U16* indicesp = (U16*) params.mVertexBuffer->getClientIndices();
 	if (indicesp)
 	{
 		for (U32 i = params.mOffset; i < params.mOffset+params.mCount; i++)
@@ -1857,24 +1857,6 @@ public:
 	S32 mRes;
 };
 
-class LLOctreeCullNoFarClip : public LLOctreeCull
-{
-public: 
-	LLOctreeCullNoFarClip(LLCamera* camera) 
-		: LLOctreeCull(camera) { }
-
-	virtual S32 frustumCheck(const LLSpatialGroup* group)
-	{
-		return mCamera->AABBInFrustumNoFarClip(group->mBounds[0], group->mBounds[1]);
-	}
-
-	virtual S32 frustumCheckObjects(const LLSpatialGroup* group)
-	{
-		S32 res = mCamera->AABBInFrustumNoFarClip(group->mObjectBounds[0], group->mObjectBounds[1]);
-		return res;
-	}
-};
-
 class LLOctreeCullShadow : public LLOctreeCull
 {
 public:
@@ -2177,6 +2159,15 @@ BOOL LLSpatialPartition::visibleObjectsInFrustum(LLCamera& camera)
 S32 LLSpatialPartition::cull(LLCamera &camera, std::vector<LLDrawable *>* results, BOOL for_select)
 {
 	LLMemType mt(LLMemType::MTYPE_SPACE_PARTITION);
+
+	if (!for_select)
+	{
+		LLSpatialCullPass pass;
+		pass.addPartition(this, camera);
+		pass.cullPartitions(NULL);
+		return 0;
+	}
+
 #if LL_OCTREE_PARANOIA_CHECK
 	((LLSpatialGroup*)mOctree->getListener(0))->checkStates();
 #endif
@@ -2190,32 +2181,150 @@ S32 LLSpatialPartition::cull(LLCamera &camera, std::vector<LLDrawable *>* result
 	((LLSpatialGroup*)mOctree->getListener(0))->validate();
 #endif
 
+	LLOctreeSelect selecter(&camera, results);
+	selecter.traverse(mOctree);
 	
-	if (for_select)
+	return 0;
+}
+
+void LLSpatialCullPass::addPartition(LLSpatialPartition* part, LLCamera& camera)
+{
+#if LL_OCTREE_PARANOIA_CHECK
+	((LLSpatialGroup*)part->mOctree->getListener(0))->checkStates();
+#endif
 	{
-		LLOctreeSelect selecter(&camera, results);
-		selecter.traverse(mOctree);
+		LLFastTimer ftm(FTM_CULL_REBOUND);		
+		LLSpatialGroup* group = (LLSpatialGroup*) part->mOctree->getListener(0);
+		group->rebound();
 	}
-	else if (LLPipeline::sShadowRender)
+
+#if LL_OCTREE_PARANOIA_CHECK
+	((LLSpatialGroup*)part->mOctree->getListener(0))->validate();
+#endif
+
+	Partition entry;
+	entry.mCamera = &camera;
+	entry.mOrigin = camera.getOrigin();
+	entry.mFrustumCornerDist = camera.mFrustumCornerDist;
+	//the user clip plane, if any, comes after the far plane
+	entry.mUserClip = camera.getPlaneCount() > LLCamera::AGENT_PLANE_FAR + 1;
+	entry.mUserClipPlane = camera.getAgentPlane(LLCamera::AGENT_PLANE_FAR + 1);
+
+	if (LLPipeline::sShadowRender)
 	{
-		LLFastTimer ftm(FTM_FRUSTUM_CULL);
-		LLOctreeCullShadow culler(&camera);
-		culler.traverse(mOctree);
+		entry.mMode = CULL_SHADOW;
 	}
-	else if (mInfiniteFarClip || !LLPipeline::sUseFarClip)
+	else if (part->mInfiniteFarClip || !LLPipeline::sUseFarClip)
 	{
-		LLFastTimer ftm(FTM_FRUSTUM_CULL);		
-		LLOctreeCullNoFarClip culler(&camera);
-		culler.traverse(mOctree);
+		entry.mMode = CULL_NO_FAR_CLIP;
 	}
 	else
 	{
-		LLFastTimer ftm(FTM_FRUSTUM_CULL);		
-		LLOctreeCull culler(&camera);
-		culler.traverse(mOctree);
+		entry.mMode = CULL_DEFAULT;
+	}
+	entry.mFrustum.set(camera, entry.mMode != CULL_SHADOW);
+
+	mPartitions.push_back(entry);
+	addTree(part->mOctree);
+}
+
+void LLSpatialCullPass::cullPartitions(LLWorkPool* pool)
+{
+	LLFastTimer ftm(FTM_FRUSTUM_CULL);
+
+	cull(pool);
+	for (U32 i = 0; i < mPartitions.size(); i++)
+	{
+		processPartition(i);
+	}
+
+	mPartitions.clear();
+	clear();
+}
+
+S32 LLSpatialCullPass::checkBounds(const Partition& part, const LLVector3* bounds, const LLVector3* extents) const
+{
+	S32 res = part.mFrustum.AABBInFrustum(bounds[0], bounds[1]);
+	if (res != 0 && part.mMode == CULL_DEFAULT)
+	{
+		res = llmin(res, AABBSphereIntersect(extents[0], extents[1], part.mOrigin, part.mFrustumCornerDist));
+	}
+	return res;
+}
+
+// Runs on the work pool: reads bounds and state, changes nothing.  Does
+// what LLOctreeCull::traverse() and checkObjects() did, leaving data set
+// if the group's own objects should be processed.
+S32 LLSpatialCullPass::frustumCheck(U32 tree, const oct_node* node, S32 parent_result, U32& data) const
+{
+	const LLSpatialGroup* group = (const LLSpatialGroup*) node->getListener(0);
+	const Partition& part = mPartitions[tree];
+
+	S32 res = parent_result;
+	if (res != 2 &&
+		!(res && group->isState(LLSpatialGroup::SKIP_FRUSTUM_CHECK)))
+	{
+		res = checkBounds(part, group->mBounds, group->mExtents);
+	}
+
+	if (res == 0 || node->getElementCount() == 0)
+	{ //no elements
+		data = FALSE;
+	}
+	else if (node->getChildCount() == 0)
+	{ //leaf state, already checked tightest bounding box
+		data = TRUE;
+	}
+	else
+	{ //partly in means the objects themselves need a look
+		data = res == 2 || checkBounds(part, group->mObjectBounds, group->mObjectExtents) != 0;
+	}
+
+	return res;
+}
+
+// The half of LLOctreeCull that touches GL and the pipeline, in the
+// order the traversal would have done it.
+void LLSpatialCullPass::processPartition(U32 tree)
+{
+	Partition& part = mPartitions[tree];
+	LLCamera& camera = *part.mCamera;
+	if (part.mUserClip)
+	{
+		camera.setUserClipPlane(part.mUserClipPlane);
+	}
+	else
+	{
+		camera.disableUserClipPlane();
+	}
+
+	const Entry* end = endTree(tree);
+	const Entry* entry = beginTree(tree);
+	while (entry != end)
+	{
+		LLSpatialGroup* group = (LLSpatialGroup*) entry->mNode->getListener(0);
+
+		group->checkOcclusion();
+		if (entry->mDepth > 0 &&				//never occlusion cull the root node
+			LLPipeline::sUseOcclusion &&		//ignore occlusion if disabled
+			group->isOcclusionState(LLSpatialGroup::OCCLUDED))
+		{
+			gPipeline.markOccluder(group);
+			entry = skipChildren(entry, end);
+			continue;
+		}
+
+		if (entry->mData)
+		{
+			if (group->needsUpdate() ||
+				group->mVisible[LLViewerCamera::sCurCameraID] < LLDrawable::getCurrentFrame() - 1)
+			{
+				group->doOcclusion(&camera);
+			}
+			gPipeline.markNotCulled(group, camera);
+		}
+		++entry;
 	}
-	
-	return 0;
 }
 
 BOOL earlyFail(LLCamera* camera, LLSpatialGroup* group)
@@ -31,6 +31,8 @@
 
 #include "lldrawable.h"
 #include "lloctree.h"
+#include "lloctreecull.h"
+#include "llfrustumcull.h"
 #include "llpointer.h"
 #include "llrefcount.h"
 #include "llvertexbuffer.h"
@@ -541,6 +543,48 @@ private:
 	drawinfo_list_t::iterator mRenderMapEnd[LLRenderPass::NUM_RENDER_TYPES];
 };
 
+// Culls a set of partitions against a camera.  The frustum tests run
+// first, over the work pool if there is one; occlusion queries and
+// gPipeline.markNotCulled() follow on this thread, partition by partition
+// in the order they were added.
+class LLSpatialCullPass : public LLOctreeCullPass<LLDrawable>
+{
+public:
+	// Rebounds part and queues it, remembering the camera's user clip plane
+	// as it is now.
+	void addPartition(LLSpatialPartition* part, LLCamera& camera);
+
+	// Culls everything queued, then forgets it.  pool may be NULL.
+	void cullPartitions(LLWorkPool* pool);
+
+protected:
+	/*virtual*/ S32 frustumCheck(U32 tree, const oct_node* node, S32 parent_result, U32& data) const;
+
+private:
+	typedef enum
+	{
+		CULL_DEFAULT = 0,	// no far clip, but nothing beyond the frustum corners
+		CULL_NO_FAR_CLIP,
+		CULL_SHADOW,		// all planes
+	} eCullMode;
+
+	struct Partition
+	{
+		LLCamera* mCamera;
+		LLFrustumCull mFrustum;
+		LLVector3 mOrigin;
+		F32 mFrustumCornerDist;
+		U32 mMode;
+		BOOL mUserClip;
+		LLPlane mUserClipPlane;
+	};
+
+	S32 checkBounds(const Partition& part, const LLVector3* bounds, const LLVector3* extents) const;
+	void processPartition(U32 tree);
+
+	std::vector<Partition> mPartitions;
+};
+
 
 //spatial partition for water (implemented in LLVOWater.cpp)
 class LLWaterPartition : public LLSpatialPartition
@@ -612,6 +656,16 @@ class LLVolumeGeometryManager: public LLGeometryManager
 	virtual void getGeometry(LLSpatialGroup* group);
 	void genDrawInfo(LLSpatialGroup* group, U32 mask, std::vector<LLFace*>& faces, BOOL distance_sort = FALSE);
 	void registerFace(LLSpatialGroup* group, LLFace* facep, U32 type);
+
+	// Between beginGeomBatch() and endGeomBatch(), faces rebuilt by any
+	// volume partition have their vertices generated together across the
+	// work pool at the end, instead of one at a time.  Calls nest, and
+	// nothing may draw the rebuilt groups until the last end.
+	static void beginGeomBatch();
+	static void endGeomBatch();
+
+private:
+	static void rebuildFace(LLFace* facep, LLVOVolume* vobj);
 };
 
 //spatial partition that uses volume geometry manager (implemented in LLVOVolume.cpp)
@@ -49,6 +49,9 @@
 #include "pipeline.h"
 #include "llviewerregion.h"
 #include "llvlcomposition.h"
+#include "llvlmanager.h"
+#include "llworkpool.h"
+#include "v2math.h"
 #include "noise.h"
 #include "llviewercamera.h"
 #include "llglheaders.h"
@@ -60,6 +63,71 @@ extern LLPipeline gPipeline;
 LLColor4U MAX_WATER_COLOR(0, 48, 96, 240);
 
 
+// Below this many dirty patches the pool isn't worth waking up.
+static const S32 MIN_PARALLEL_DIRTY_PATCHES = 8;
+
+// Updates normals and height/composition stats for a set of patches no two of
+// which are adjacent, so they never write the same normals or corner heights.
+class LLSurfacePatchUpdateTask : public LLWorkPool::Task
+{
+public:
+	LLSurfacePatchUpdateTask(const std::vector<LLSurfacePatch *> &patches)
+		: mPatches(patches),
+		  mStatsChanged(patches.size(), FALSE)
+	{
+	}
+
+	/*virtual*/ void run(S32 index)
+	{
+		LLSurfacePatch *patchp = mPatches[index];
+		patchp->calcNormals();
+		mStatsChanged[index] = patchp->calcVerticalStats();
+	}
+
+	const std::vector<LLSurfacePatch *> &mPatches;
+	std::vector<BOOL> mStatsChanged;
+};
+
+// Generates composition values for a set of patches no two of which are
+// adjacent, since each also writes its neighbours' edge samples.
+class LLSurfacePatchHeightsTask : public LLWorkPool::Task
+{
+public:
+	LLSurfacePatchHeightsTask(const std::vector<LLSurfacePatch *> &patches)
+		: mPatches(patches)
+	{
+	}
+
+	/*virtual*/ void run(S32 index)
+	{
+		mPatches[index]->generateHeights();
+	}
+
+	const std::vector<LLSurfacePatch *> &mPatches;
+};
+
+// Composition stats only read the composition values, so any set of patches
+// can run at once once their heights are all generated.
+class LLSurfacePatchCompositionStatsTask : public LLWorkPool::Task
+{
+public:
+	LLSurfacePatchCompositionStatsTask(const std::vector<LLSurfacePatch *> &patches)
+		: mPatches(patches)
+	{
+	}
+
+	/*virtual*/ void run(S32 index)
+	{
+		LLSurfacePatch *patchp = mPatches[index];
+		if (patchp->getHeightsGenerated() && !patchp->getCompositionStatsValid())
+		{
+			patchp->updateCompositionStats();
+		}
+	}
+
+	const std::vector<LLSurfacePatch *> &mPatches;
+};
+
 S32 LLSurface::sTextureSize = 256;
 S32 LLSurface::sTexelsUpdated = 0;
 F32 LLSurface::sTextureUpdateTime = 0.f;
@@ -642,37 +710,151 @@ BOOL LLSurface::idleUpdate(F32 max_update_time)
 
 	// Always call updateNormals() / updateVerticalStats()
 	//  every frame to avoid artifacts
+	LLWorkPool *pool = LLAppViewer::getWorkPool();
+	BOOL parallel = pool && pool->getNumThreads() > 0
+					&& (S32)mDirtyPatchList.size() >= MIN_PARALLEL_DIRTY_PATCHES;
+	if (parallel)
+	{
+		updateDirtyPatches(pool);
+		generatePatchHeights(pool);
+	}
+
+	// Patches that will want their texture generated, for composing ahead
+	std::vector<LLVector2> texture_origins;
+
 	for(std::set<LLSurfacePatch *>::iterator iter = mDirtyPatchList.begin();
 		iter != mDirtyPatchList.end(); )
 	{
 		std::set<LLSurfacePatch *>::iterator curiter = iter++;
 		LLSurfacePatch *patchp = *curiter;
-		patchp->updateNormals();
-		patchp->updateVerticalStats();
+		if (!parallel)
+		{
+			patchp->updateNormals();
+			patchp->updateVerticalStats();
+		}
 		if (max_update_time == 0.f || update_timer.getElapsedTimeF32() < max_update_time)
 		{
 			if (patchp->updateTexture())
 			{
+				if (parallel && patchp->mSTexUpdate)
+				{
+					LLVector3d origin_region = patchp->getOriginGlobal() - getOriginGlobal();
+					texture_origins.push_back(LLVector2((F32)origin_region.mdV[VX], (F32)origin_region.mdV[VY]));
+				}
 				did_update = TRUE;
 				patchp->clearDirty();
 				mDirtyPatchList.erase(curiter);
 			}
 		}
 	}
+
+	// Blend the detail textures for the whole batch now, so that each
+	// patch's generateTexture() in the GL update only uploads.
+	if ((S32)texture_origins.size() >= MIN_PARALLEL_DIRTY_PATCHES)
+	{
+		getRegion()->getComposition()->precomposeTextures(texture_origins,
+			mMetersPerGrid*mGridsPerPatchEdge, pool);
+	}
 	return did_update;
 }
 
-void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL b_large_patch) 
+void LLSurface::updateDirtyPatches(LLWorkPool *pool)
+{
+	// Split the patches into four sets by the parity of their position.
+	// Patches in the same set are at least one patch apart, so each set can
+	// be processed in parallel; the sets themselves run one after another.
+	std::vector<LLSurfacePatch *> waves[4];
+	for (std::set<LLSurfacePatch *>::iterator iter = mDirtyPatchList.begin();
+		 iter != mDirtyPatchList.end(); ++iter)
+	{
+		S32 index = (S32)(*iter - mPatchList);
+		S32 i = index % mPatchesPerEdge;
+		S32 j = index / mPatchesPerEdge;
+		waves[(i & 1) + 2*(j & 1)].push_back(*iter);
+	}
+
+	BOOL stats_changed = FALSE;
+	for (S32 wave = 0; wave < 4; wave++)
+	{
+		std::vector<LLSurfacePatch *> &patches = waves[wave];
+		LLSurfacePatchUpdateTask task(patches);
+		pool->parallelFor(task, (S32)patches.size());
+
+		// Surface and region bookkeeping stays on the main thread.
+		for (U32 k = 0; k < patches.size(); k++)
+		{
+			if (task.mStatsChanged[k])
+			{
+				patches[k]->applyVerticalStats(FALSE);
+				stats_changed = TRUE;
+			}
+		}
+	}
+
+	if (stats_changed)
+	{
+		getRegion()->calculateCenterGlobal();
+	}
+}
+
+void LLSurface::generatePatchHeights(LLWorkPool *pool)
+{
+	LLVLComposition *comp = getRegion()->getComposition();
+	if (!comp || !comp->getParamsReady())
+	{
+		return;
+	}
+
+	// Same parity split as updateDirtyPatches().
+	std::vector<LLSurfacePatch *> waves[4];
+	std::vector<LLSurfacePatch *> patches;
+	for (std::set<LLSurfacePatch *>::iterator iter = mDirtyPatchList.begin();
+		 iter != mDirtyPatchList.end(); ++iter)
+	{
+		LLSurfacePatch *patchp = *iter;
+		if (patchp->mSTexUpdate && !patchp->getHeightsGenerated() && patchp->getNeighborsHaveData())
+		{
+			S32 index = (S32)(patchp - mPatchList);
+			S32 i = index % mPatchesPerEdge;
+			S32 j = index / mPatchesPerEdge;
+			waves[(i & 1) + 2*(j & 1)].push_back(patchp);
+			patches.push_back(patchp);
+		}
+	}
+	if (patches.empty())
+	{
+		return;
+	}
+
+	// The noise tables are built on first use.
+	init_noise();
+
+	for (S32 wave = 0; wave < 4; wave++)
+	{
+		LLSurfacePatchHeightsTask task(waves[wave]);
+		pool->parallelFor(task, (S32)waves[wave].size());
+	}
+
+	LLSurfacePatchCompositionStatsTask stats_task(patches);
+	pool->parallelFor(stats_task, (S32)patches.size());
+}
+
+S32 LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL b_large_patch,
+								  LLVLManager *managerp) 
 {
 
 	LLPatchHeader  ph;
 	S32 j, i;
 	S32 patch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
 	LLSurfacePatch *patchp;
+	S32 num_patches = 0;
 
-	init_patch_decompressor(gopp->patch_size);
-	gopp->stride = mGridsPerEdge;
-	set_group_of_patch_header(gopp);
+	if (!managerp)
+	{
+		init_patch_decompressor(gopp->patch_size);
+		gopp->stride = mGridsPerEdge;
+		set_group_of_patch_header(gopp);
+	}
 
 	while (1)
 	{
@@ -697,36 +879,51 @@ void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL
 				<< " patchids " << (S32)ph.patchids
 				<< llendl;
             LLAppViewer::instance()->badNetworkHandler();
-			return;
+			return num_patches;
 		}
 
 		patchp = &mPatchList[j*mPatchesPerEdge + i];
+		num_patches++;
 
+		if (managerp)
+		{
+			// The bit stream can only be read in order, but the inverse DCT
+			// of each patch is independent and can wait for the batch.
+			LLVLPatchDecode *decodep = managerp->queuePatchDecode(patchp, gopp->patch_size, mGridsPerEdge);
+			decodep->mHeader = ph;
+			decode_patch(bitpack, decodep->mCoefficients);
+			continue;
+		}
 
 		decode_patch(bitpack, patch);
 		decompress_patch(patchp->getDataZ(), patch, &ph);
+		finishDCTPatch(patchp);
+	}
+	return num_patches;
+}
 
-		// Update edges for neighbors.  Need to guarantee that this gets done before we generate vertical stats.
-		patchp->updateNorthEdge();
-		patchp->updateEastEdge();
-		if (patchp->getNeighborPatch(WEST))
-		{
-			patchp->getNeighborPatch(WEST)->updateEastEdge();
-		}
-		if (patchp->getNeighborPatch(SOUTHWEST))
-		{
-			patchp->getNeighborPatch(SOUTHWEST)->updateEastEdge();
-			patchp->getNeighborPatch(SOUTHWEST)->updateNorthEdge();
-		}
-		if (patchp->getNeighborPatch(SOUTH))
-		{
-			patchp->getNeighborPatch(SOUTH)->updateNorthEdge();
-		}
-
-		// Dirty patch statistics, and flag that the patch has data.
-		patchp->dirtyZ();
-		patchp->setHasReceivedData();
+void LLSurface::finishDCTPatch(LLSurfacePatch *patchp)
+{
+	// Update edges for neighbors.  Need to guarantee that this gets done before we generate vertical stats.
+	patchp->updateNorthEdge();
+	patchp->updateEastEdge();
+	if (patchp->getNeighborPatch(WEST))
+	{
+		patchp->getNeighborPatch(WEST)->updateEastEdge();
 	}
+	if (patchp->getNeighborPatch(SOUTHWEST))
+	{
+		patchp->getNeighborPatch(SOUTHWEST)->updateEastEdge();
+		patchp->getNeighborPatch(SOUTHWEST)->updateNorthEdge();
+	}
+	if (patchp->getNeighborPatch(SOUTH))
+	{
+		patchp->getNeighborPatch(SOUTH)->updateNorthEdge();
+	}
+
+	// Dirty patch statistics, and flag that the patch has data.
+	patchp->dirtyZ();
+	patchp->setHasReceivedData();
 }
 
 
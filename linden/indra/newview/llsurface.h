@@ -63,6 +63,8 @@ class LLViewerRegion;
 class LLSurfacePatch;
 class LLBitPack;
 class LLGroupHeader;
+class LLVLManager;
+class LLWorkPool;
 
 class LLSurface 
 {
@@ -85,7 +87,11 @@ public:
 	void disconnectNeighbor(LLSurface *neighborp);
 	void disconnectAllNeighbors();
 
-	virtual void decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL b_large_patch);
+	// Returns the number of patches read.  With a manager, patches are only
+	// unpacked and queued there for a batched inverse DCT.
+	virtual S32 decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL b_large_patch,
+								   LLVLManager *managerp = NULL);
+	void finishDCTPatch(LLSurfacePatch *patchp);
 	virtual void updatePatchVisibilities(LLAgent &agent);
 
 	inline F32 getZ(const U32 k) const				{ return mSurfaceZ[k]; }
@@ -114,6 +120,10 @@ public:
 
 	// Update methods (called during idle, normally)
 	BOOL idleUpdate(F32 max_update_time);
+	// Normals and stats of every dirty patch, spread over the pool
+	void updateDirtyPatches(LLWorkPool *pool);
+	// Composition values of every dirty patch waiting on them, likewise
+	void generatePatchHeights(LLWorkPool *pool);
 
 	BOOL containsPosition(const LLVector3 &position);
 
@@ -65,6 +65,7 @@ LLSurfacePatch::LLSurfacePatch() :
 	mMinComposition(0.f),
 	mMaxComposition(0.f),
 	mMeanComposition(0.f),
+	mCompositionStatsValid(FALSE),
 	// This flag is used to communicate between adjacent surfaces and is
 	// set to non-zero values by higher classes.  
 	mConnectedEdge(NO_EDGE),
@@ -104,6 +105,7 @@ void LLSurfacePatch::dirty()
 
 	mDirtyZStats = TRUE;
 	mHeightsGenerated = FALSE;
+	mCompositionStatsValid = FALSE;
 	
 	if (!mDirty)
 	{
@@ -386,10 +388,21 @@ F32 LLSurfacePatch::getDistance() const
 // Called when a patch has changed its height field
 // data.
 void LLSurfacePatch::updateVerticalStats() 
+{
+	if (calcVerticalStats())
+	{
+		applyVerticalStats();
+	}
+}
+
+// Recomputes this patch's height stats.  Only touches the patch itself, so
+// it may run on a worker thread; applyVerticalStats() has to follow on the
+// main thread whenever this returns TRUE.
+BOOL LLSurfacePatch::calcVerticalStats()
 {
 	if (!mDirtyZStats)
 	{
-		return;
+		return FALSE;
 	}
 
 	U32 grids_per_patch_edge = mSurfacep->getGridsPerPatchEdge();
@@ -434,25 +447,44 @@ void LLSurfacePatch::updateVerticalStats()
 						meters_per_grid*grids_per_patch_edge,
 						mMaxZ - mMinZ);
 	mRadius = diam_vec.magVec() * 0.5f;
+	mDirtyZStats = FALSE;
+	return TRUE;
+}
 
+// Pushes freshly computed stats out to the surface and region.
+void LLSurfacePatch::applyVerticalStats(BOOL update_center)
+{
 	mSurfacep->mMaxZ = llmax(mMaxZ, mSurfacep->mMaxZ);
 	mSurfacep->mMinZ = llmin(mMinZ, mSurfacep->mMinZ);
 	mSurfacep->mHasZData = TRUE;
-	mSurfacep->getRegion()->calculateCenterGlobal();
+	if (update_center)
+	{
+		mSurfacep->getRegion()->calculateCenterGlobal();
+	}
 
 	if (mVObjp)
 	{
 		mVObjp->dirtyPatch();
 	}
-	mDirtyZStats = FALSE;
 }
 
 
 void LLSurfacePatch::updateNormals() 
+{
+	if (calcNormals())
+	{
+		mSurfacep->dirtySurfacePatch(this);
+	}
+}
+
+// Recomputes the invalid normals of this patch and returns TRUE if any
+// changed.  Writes normals along the shared edges and the z value of the
+// northeast corner, so no two adjacent patches may run this at the same time.
+BOOL LLSurfacePatch::calcNormals()
 {
 	if (mSurfacep->mType == 'w')
 	{
-		return;
+		return FALSE;
 	}
 	U32 grids_per_patch_edge = mSurfacep->getGridsPerPatchEdge();
 	U32 grids_per_edge = mSurfacep->getGridsPerEdge();
@@ -599,15 +631,12 @@ void LLSurfacePatch::updateNormals()
 		dirty_patch = TRUE;
 	}
 
-	if (dirty_patch)
-	{
-		mSurfacep->dirtySurfacePatch(this);
-	}
-
 	for (i = 0; i < 9; i++)
 	{
 		mNormalsInvalid[i] = FALSE;
 	}
+
+	return dirty_patch;
 }
 
 void LLSurfacePatch::updateEastEdge()
@@ -674,6 +703,37 @@ void LLSurfacePatch::updateNorthEdge()
 }
 
 
+BOOL LLSurfacePatch::getNeighborsHaveData() const
+{
+	return (!getNeighborPatch(EAST) || getNeighborPatch(EAST)->getHasReceivedData())
+		&& (!getNeighborPatch(WEST) || getNeighborPatch(WEST)->getHasReceivedData())
+		&& (!getNeighborPatch(SOUTH) || getNeighborPatch(SOUTH)->getHasReceivedData())
+		&& (!getNeighborPatch(NORTH) || getNeighborPatch(NORTH)->getHasReceivedData());
+}
+
+// Generates this patch's composition values unless that has been done since
+// it was last dirtied.  Also writes the samples along the east and north
+// neighbours' edges, so no two adjacent patches may run this at the same time.
+BOOL LLSurfacePatch::generateHeights()
+{
+	if (!mHeightsGenerated)
+	{
+		F32 meters_per_grid = getSurface()->getMetersPerGrid();
+		F32 grids_per_patch_edge = (F32)getSurface()->getGridsPerPatchEdge();
+		LLVector3d origin_region = getOriginGlobal() - getSurface()->getOriginGlobal();
+
+		// Have to figure out a better way to deal with these edge conditions...
+		LLVLComposition* comp = getSurface()->getRegion()->getComposition();
+		F32 patch_size = meters_per_grid*(grids_per_patch_edge+1);
+		if (comp->generateHeights((F32)origin_region[VX], (F32)origin_region[VY],
+								  patch_size, patch_size))
+		{
+			mHeightsGenerated = TRUE;
+		}
+	}
+	return mHeightsGenerated;
+}
+
 BOOL LLSurfacePatch::updateTexture()
 {
 	if (mSTexUpdate)		//  Update texture as needed
@@ -681,31 +741,23 @@ BOOL LLSurfacePatch::updateTexture()
 		F32 meters_per_grid = getSurface()->getMetersPerGrid();
 		F32 grids_per_patch_edge = (F32)getSurface()->getGridsPerPatchEdge();
 
-		if ((!getNeighborPatch(EAST) || getNeighborPatch(EAST)->getHasReceivedData())
-			&& (!getNeighborPatch(WEST) || getNeighborPatch(WEST)->getHasReceivedData())
-			&& (!getNeighborPatch(SOUTH) || getNeighborPatch(SOUTH)->getHasReceivedData())
-			&& (!getNeighborPatch(NORTH) || getNeighborPatch(NORTH)->getHasReceivedData()))
+		if (getNeighborsHaveData())
 		{
 			LLViewerRegion *regionp = getSurface()->getRegion();
 			LLVector3d origin_region = getOriginGlobal() - getSurface()->getOriginGlobal();
 
-			// Have to figure out a better way to deal with these edge conditions...
 			LLVLComposition* comp = regionp->getComposition();
-			if (!mHeightsGenerated)
+			if (!generateHeights())
 			{
-				F32 patch_size = meters_per_grid*(grids_per_patch_edge+1);
-				if (comp->generateHeights((F32)origin_region[VX], (F32)origin_region[VY],
-										  patch_size, patch_size))
-				{
-					mHeightsGenerated = TRUE;
-				}
-				else
-				{
-					return FALSE;
-				}
+				return FALSE;
 			}
 			
-			if (comp->generateComposition())
+			// A texture composed on an earlier visit doesn't need the
+			// detail textures at all.
+			F32 tex_patch_size = meters_per_grid*grids_per_patch_edge;
+			if (comp->hasCachedTexture((F32)origin_region[VX], (F32)origin_region[VY],
+									   tex_patch_size, tex_patch_size)
+				|| comp->generateComposition())
 			{
 				if (mVObjp)
 				{
@@ -733,7 +785,10 @@ void LLSurfacePatch::updateGL()
 
 	LLVLComposition* comp = regionp->getComposition();
 	
-	updateCompositionStats();
+	if (!mCompositionStatsValid)
+	{
+		updateCompositionStats();
+	}
 	F32 tex_patch_size = meters_per_grid*grids_per_patch_edge;
 	if (comp->generateTexture((F32)origin_region[VX], (F32)origin_region[VY],
 							  tex_patch_size, tex_patch_size))
@@ -744,6 +799,12 @@ void LLSurfacePatch::updateGL()
 		mSurfacep->generateWaterTexture((F32)origin_region.mdV[VX], (F32)origin_region.mdV[VY],
 										tex_patch_size, tex_patch_size);
 	}
+	else
+	{
+		// Not ready yet, or the cached composition went away before we got
+		// here; go through updateTexture() again.
+		mSurfacep->dirtySurfacePatch(this);
+	}
 }
 
 void LLSurfacePatch::dirtyZ()
@@ -987,6 +1048,7 @@ void LLSurfacePatch::updateCompositionStats()
 	mMinComposition = min;
 	mMeanComposition = mean;
 	mMaxComposition = max;
+	mCompositionStatsValid = TRUE;
 }
 
 F32 LLSurfacePatch::getMeanComposition() const
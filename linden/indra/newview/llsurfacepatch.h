@@ -79,6 +79,15 @@ public:
 	void updateCompositionStats();
 	void updateNormals();
 
+	// Split versions of the above for the parallel update in LLSurface.
+	BOOL calcVerticalStats();
+	void applyVerticalStats(BOOL update_center = TRUE);
+	BOOL calcNormals();
+	BOOL getCompositionStatsValid() const		{ return mCompositionStatsValid; }
+	BOOL getNeighborsHaveData() const;
+	BOOL generateHeights();
+	BOOL getHeightsGenerated() const			{ return mHeightsGenerated; }
+
 	void updateEastEdge();
 	void updateNorthEdge();
 
@@ -173,6 +182,7 @@ protected:
 	F32 mMinComposition;
 	F32 mMaxComposition;
 	F32 mMeanComposition;
+	BOOL mCompositionStatsValid;	// cleared whenever the patch is dirtied
 
 	U8 mConnectedEdge;		// This flag is non-zero iff patch is on at least one edge 
 							// of LLSurface that is "connected" to another LLSurface
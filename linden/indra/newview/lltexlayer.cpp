@@ -29,6 +29,7 @@
 #include "lltexlayer.h"
 
 #include "llagent.h"
+#include "llappviewer.h"
 #include "llimagej2c.h"
 #include "llimagetga.h"
 #include "llnotificationsutil.h"
@@ -171,6 +172,9 @@ void LLTexLayerSetBuffer::requestUpdate()
 
 void LLTexLayerSetBuffer::requestUpload()
 {
+	// A bake still being encoded is out of date now.
+	mEncodeResponder = NULL;
+	mEncodeImage = NULL;
 	conditionalRestartUploadTimer();
 	mNeedsUpload = TRUE;
 	mNumLowresUploads = 0;
@@ -201,6 +205,8 @@ void LLTexLayerSetBuffer::restartUpdateTimer()
 
 void LLTexLayerSetBuffer::cancelUpload()
 {
+	mEncodeResponder = NULL;
+	mEncodeImage = NULL;
 	mNeedsUpload = FALSE;
 	mUploadPending = FALSE;
 	mNeedsUploadTimer.pause();
@@ -232,6 +238,9 @@ BOOL LLTexLayerSetBuffer::needsRender()
 	llassert(mTexLayerSet->getAvatar() == gAgentAvatarp);
 	if (!isAgentAvatarValid()) return FALSE;
 
+	// Send off the last bake if it has finished encoding.
+	finishEncode();
+
 	const BOOL upload_now = mNeedsUpload && isReadyToUpload();
 	const BOOL update_now = mNeedsUpdate && isReadyToUpdate();
 
@@ -354,6 +363,7 @@ BOOL LLTexLayerSetBuffer::uploadInProgress() const
 BOOL LLTexLayerSetBuffer::isReadyToUpload() const
 {
 	if (!gAgentQueryManager.hasNoPendingQueries()) return FALSE; // Can't upload if there are pending queries.
+	if (mEncodeResponder.notNull()) return FALSE; // Still encoding the last bake.
 	if (isAgentAvatarValid() && !gAgentAvatarp->isUsingBakedTextures()) return FALSE; // Don't upload if avatar is using composites.
 
 	// If we requested an upload and have the final LOD ready, then upload.
@@ -421,10 +431,99 @@ void LLTexLayerSetBuffer::doUpload()
 	llinfos << "Uploading baked " << mTexLayerSet->getBodyRegionName() << llendl;
 	LLViewerStats::getInstance()->incStat(LLViewerStats::ST_TEX_BAKES);
 
+	// Create the baked image from our color and mask information
+	const S32 baked_image_components = 5; // red green blue [bump] clothing
+	LLPointer<LLImageRaw> baked_image = new LLImageRaw( mFullWidth, mFullHeight, baked_image_components );
+
+	// Composite on the CPU while the layers still have their caches.
+	static LLCachedControl<bool> bake_on_cpu(gSavedSettings, "AvatarBakeOnCPU");
+	const BOOL baked = bake_on_cpu && compositeForUpload(baked_image);
+
+	static LLCachedControl<bool> debug_compare(gSavedSettings, "DebugAvatarBakeCompare");
+	if (baked && debug_compare)
+	{
+		LLPointer<LLImageRaw> gl_image = new LLImageRaw( mFullWidth, mFullHeight, baked_image_components );
+		readBackForUpload(gl_image);
+		S32 max_diff[baked_image_components];
+		F32 mean_diff[baked_image_components];
+		LLTexLayerCompositor::compare(baked_image->getData(), gl_image->getData(), mFullWidth * mFullHeight,
+									  baked_image_components, max_diff, mean_diff);
+		llinfos << "Baked " << mTexLayerSet->getBodyRegionName() << " CPU vs GL max/mean difference: "
+				<< "R " << max_diff[0] << "/" << mean_diff[0]
+				<< " G " << max_diff[1] << "/" << mean_diff[1]
+				<< " B " << max_diff[2] << "/" << mean_diff[2]
+				<< " A " << max_diff[3] << "/" << mean_diff[3]
+				<< " mask " << max_diff[4] << "/" << mean_diff[4] << llendl;
+	}
+
 	// Don't need caches since we're baked now.  (note: we won't *really* be baked 
 	// until this image is sent to the server and the Avatar Appearance message is received.)
 	mTexLayerSet->deleteCaches();
 
+	if (!baked)
+	{
+		readBackForUpload(baked_image);
+	}
+
+	LLPointer<LLImageJ2C> compressedImage = new LLImageJ2C;
+	compressedImage->setRate(0.f);
+	const char* comment_text = LINDEN_J2C_COMMENT_PREFIX "RGBHM"; // 5 channels (rgb, heightfield/alpha, mask)
+	LLImageDecodeThread* decode_thread = LLAppViewer::getImageDecodeThread();
+	if (bake_on_cpu && decode_thread)
+	{
+		// Encode on the decode thread; needsRender() picks the result up.
+		mEncodeImage = compressedImage;
+		mEncodeResponder = new EncodeResponder(mTexLayerSet->isLocalTextureDataFinal());
+		decode_thread->encodeImage(baked_image, compressedImage, comment_text, LLQueuedThread::PRIORITY_HIGH, mEncodeResponder);
+	}
+	else if (compressedImage->encode(baked_image, comment_text))
+	{
+		uploadEncodedImage(compressedImage, mTexLayerSet->isLocalTextureDataFinal());
+	}
+	else
+	{
+		mUploadPending = FALSE;
+		llinfos << "Unable to create baked upload file (reason: failed to encode)" << llendl;
+	}
+}
+
+// Composites the bake into baked_image on the work pool.  Returns FALSE
+// if some layer can only be drawn with GL.
+BOOL LLTexLayerSetBuffer::compositeForUpload(LLImageRaw* baked_image)
+{
+	LLTexLayerCompositor compositor(mFullWidth, mFullHeight);
+	S32 image_capture = -1;
+	std::vector<S32> mask_captures;
+	if (!mTexLayerSet->composite(compositor, image_capture, mask_captures))
+	{
+		llinfos << "Reading back baked " << mTexLayerSet->getBodyRegionName() << ", not every layer has image data" << llendl;
+		return FALSE;
+	}
+	compositor.execute(LLAppViewer::getWorkPool());
+
+	const U8* baked_color_data = compositor.getCapture(image_capture);
+	U8* baked_image_data = baked_image->getData();
+	const S32 count = mFullWidth * mFullHeight;
+	for (S32 i = 0; i < count; i++)
+	{
+		// Same as LLTexLayer::addAlphaMask()
+		U16 mask = 255;
+		for (std::vector<S32>::const_iterator iter = mask_captures.begin(); iter != mask_captures.end(); ++iter)
+		{
+			mask = (mask * (compositor.getCapture(*iter)[i] + 1)) >> 8;
+		}
+		baked_image_data[5*i + 0] = baked_color_data[4*i + 0];
+		baked_image_data[5*i + 1] = baked_color_data[4*i + 1];
+		baked_image_data[5*i + 2] = baked_color_data[4*i + 2];
+		baked_image_data[5*i + 3] = baked_color_data[4*i + 3]; // alpha should be correct for eyelashes.
+		baked_image_data[5*i + 4] = (U8)mask;
+	}
+	return TRUE;
+}
+
+// Reads the bake back from the frame buffer into baked_image.
+void LLTexLayerSetBuffer::readBackForUpload(LLImageRaw* baked_image)
+{
 	// Get the COLOR information from our texture
 	U8* baked_color_data = new U8[ mFullWidth * mFullHeight * 4 ];
 	glReadPixels(mOrigin.mX, mOrigin.mY, mFullWidth, mFullHeight, GL_RGBA, GL_UNSIGNED_BYTE, baked_color_data );
@@ -436,10 +535,6 @@ void LLTexLayerSetBuffer::doUpload()
 	U8* baked_mask_data = baked_mask_image->getData(); 
 	mTexLayerSet->gatherMorphMaskAlpha(baked_mask_data, mFullWidth, mFullHeight);
 
-
-	// Create the baked image from our color and mask information
-	const S32 baked_image_components = 5; // red green blue [bump] clothing
-	LLPointer<LLImageRaw> baked_image = new LLImageRaw( mFullWidth, mFullHeight, baked_image_components );
 	U8* baked_image_data = baked_image->getData();
 	S32 i = 0;
 	for (S32 u=0; u < mFullWidth; u++)
@@ -454,100 +549,126 @@ void LLTexLayerSetBuffer::doUpload()
 			i++;
 		}
 	}
-	
-	LLPointer<LLImageJ2C> compressedImage = new LLImageJ2C;
-	compressedImage->setRate(0.f);
-	const char* comment_text = LINDEN_J2C_COMMENT_PREFIX "RGBHM"; // writes into baked_color_data. 5 channels (rgb, heightfield/alpha, mask)
-	if (compressedImage->encode(baked_image, comment_text))
-	{
-		LLTransactionID tid;
-		tid.generate();
-		const LLAssetID asset_id = tid.makeAssetID(gAgent.getSecureSessionID());
-		if (LLVFile::writeFile(compressedImage->getData(), compressedImage->getDataSize(),
-							   gVFS, asset_id, LLAssetType::AT_TEXTURE))
-		{
-			// Read back the file and validate.
-			BOOL valid = FALSE;
-			LLPointer<LLImageJ2C> integrity_test = new LLImageJ2C;
-			S32 file_size = 0;
-			U8* data = LLVFile::readFile(gVFS, asset_id, LLAssetType::AT_TEXTURE, &file_size);
-			if (data)
+
+	delete [] baked_color_data;
+}
+
+void LLTexLayerSetBuffer::finishEncode()
+{
+	if (mEncodeResponder.isNull() || mEncodeResponder->mState == EncodeResponder::ENCODE_PENDING)
+	{
+		return;
+	}
+	if (!gAgent.getRegion())
+	{
+		// Wait until we have somewhere to upload to.
+		return;
+	}
+
+	LLPointer<LLImageJ2C> compressed_image = mEncodeImage;
+	const BOOL success = (mEncodeResponder->mState == EncodeResponder::ENCODE_DONE);
+	const BOOL highest_lod = mEncodeResponder->mHighestLOD;
+	mEncodeResponder = NULL;
+	mEncodeImage = NULL;
+	if (success)
+	{
+		uploadEncodedImage(compressed_image, highest_lod);
+	}
+	else
+	{
+		mUploadPending = FALSE;
+		llinfos << "Unable to create baked upload file (reason: failed to encode)" << llendl;
+	}
+}
+
+void LLTexLayerSetBuffer::uploadEncodedImage(LLImageJ2C* compressedImage, BOOL highest_lod)
+{
+	LLTransactionID tid;
+	tid.generate();
+	const LLAssetID asset_id = tid.makeAssetID(gAgent.getSecureSessionID());
+	if (LLVFile::writeFile(compressedImage->getData(), compressedImage->getDataSize(),
+						   gVFS, asset_id, LLAssetType::AT_TEXTURE))
+	{
+		// Read back the file and validate.
+		BOOL valid = FALSE;
+		LLPointer<LLImageJ2C> integrity_test = new LLImageJ2C;
+		S32 file_size = 0;
+		U8* data = LLVFile::readFile(gVFS, asset_id, LLAssetType::AT_TEXTURE, &file_size);
+		if (data)
+		{
+			valid = integrity_test->validate(data, file_size); // integrity_test will delete 'data'
+		}
+		else
+		{
+			integrity_test->setLastError("Unable to read entire file");
+		}
+		
+		if (valid)
+		{
+			// Baked_upload_data is owned by the responder and deleted after the request completes.
+			LLBakedUploadData* baked_upload_data = new LLBakedUploadData(gAgentAvatarp, 
+																		 this->mTexLayerSet, 
+																		 asset_id);
+			// upload ID is used to avoid overlaps, e.g. when the user rapidly makes two changes outside of Face Edit.
+			mUploadID = asset_id;
+
+			// Upload the image
+			const std::string url = gAgent.getRegion()->getCapability("UploadBakedTexture");
+			if(!url.empty()
+				&& !LLPipeline::sForceOldBakedUpload) // toggle debug setting UploadBakedTexOld to change between the new caps method and old method
 			{
-				valid = integrity_test->validate(data, file_size); // integrity_test will delete 'data'
-			}
+				LLSD body = LLSD::emptyMap();
+				// The responder will call LLTexLayerSetBuffer::onTextureUploadComplete()
+				LLHTTPClient::post(url, body, new LLSendTexLayerResponder(body, mUploadID, LLAssetType::AT_TEXTURE, baked_upload_data));
+				llinfos << "Baked texture upload via capability of " << mUploadID << " to " << url << llendl;
+			} 
 			else
 			{
-				integrity_test->setLastError("Unable to read entire file");
+				gAssetStorage->storeAssetData(tid,
+											  LLAssetType::AT_TEXTURE,
+											  LLTexLayerSetBuffer::onTextureUploadComplete,
+											  baked_upload_data,
+											  TRUE,		// temp_file
+											  TRUE,		// is_priority
+											  TRUE);	// store_local
+				llinfos << "Baked texture upload via Asset Store." <<  llendl;
 			}
-			
-			if (valid)
-			{
-				// Baked_upload_data is owned by the responder and deleted after the request completes.
-				LLBakedUploadData* baked_upload_data = new LLBakedUploadData(gAgentAvatarp, 
-																			 this->mTexLayerSet, 
-																			 asset_id);
-				// upload ID is used to avoid overlaps, e.g. when the user rapidly makes two changes outside of Face Edit.
-				mUploadID = asset_id;
-
-				// Upload the image
-				const std::string url = gAgent.getRegion()->getCapability("UploadBakedTexture");
-				if(!url.empty()
-					&& !LLPipeline::sForceOldBakedUpload) // toggle debug setting UploadBakedTexOld to change between the new caps method and old method
-				{
-					LLSD body = LLSD::emptyMap();
-					// The responder will call LLTexLayerSetBuffer::onTextureUploadComplete()
-					LLHTTPClient::post(url, body, new LLSendTexLayerResponder(body, mUploadID, LLAssetType::AT_TEXTURE, baked_upload_data));
-					llinfos << "Baked texture upload via capability of " << mUploadID << " to " << url << llendl;
-				} 
-				else
-				{
-					gAssetStorage->storeAssetData(tid,
-												  LLAssetType::AT_TEXTURE,
-												  LLTexLayerSetBuffer::onTextureUploadComplete,
-												  baked_upload_data,
-												  TRUE,		// temp_file
-												  TRUE,		// is_priority
-												  TRUE);	// store_local
-					llinfos << "Baked texture upload via Asset Store." <<  llendl;
-				}
-
-				const BOOL highest_lod = mTexLayerSet->isLocalTextureDataFinal();	
-				if (highest_lod)
-				{
-					// Sending the final LOD for the baked texture.  All done, pause 
-					// the upload timer so we know how long it took.
-					mNeedsUpload = FALSE;
-					mNeedsUploadTimer.pause();
-				}
-				else
-				{
-					// Sending a lower level LOD for the baked texture.  Restart the upload timer.
-					mNumLowresUploads++;
-					mNeedsUploadTimer.unpause();
-					mNeedsUploadTimer.reset();
-				}
 
-				// Print out notification that we uploaded this texture.
-				if (gSavedSettings.getBOOL("DebugAvatarRezTime"))
-				{
-					const std::string lod_str = highest_lod ? "HighRes" : "LowRes";
-					LLSD args;
-					args["EXISTENCE"] = llformat("%d",(U32)mTexLayerSet->getAvatar()->debugGetExistenceTimeElapsedF32());
-					args["TIME"] = llformat("%d",(U32)mNeedsUploadTimer.getElapsedTimeF32());
-					args["BODYREGION"] = mTexLayerSet->getBodyRegionName();
-					args["RESOLUTION"] = lod_str;
-					LLNotificationsUtil::add("AvatarRezSelfBakedTextureUploadNotification",args);
-					llinfos << "Uploading [ name: " << mTexLayerSet->getBodyRegionName() << " res:" << lod_str << " time:" << (U32)mNeedsUploadTimer.getElapsedTimeF32() << " ]" << llendl;
-				}
+			if (highest_lod)
+			{
+				// Sending the final LOD for the baked texture.  All done, pause 
+				// the upload timer so we know how long it took.
+				mNeedsUpload = FALSE;
+				mNeedsUploadTimer.pause();
 			}
 			else
 			{
-				// The read back and validate operation failed.  Remove the uploaded file.
-				mUploadPending = FALSE;
-				LLVFile file(gVFS, asset_id, LLAssetType::AT_TEXTURE, LLVFile::WRITE);
-				file.remove();
-				llinfos << "Unable to create baked upload file (reason: corrupted)." << llendl;
+				// Sending a lower level LOD for the baked texture.  Restart the upload timer.
+				mNumLowresUploads++;
+				mNeedsUploadTimer.unpause();
+				mNeedsUploadTimer.reset();
 			}
+
+			// Print out notification that we uploaded this texture.
+			if (gSavedSettings.getBOOL("DebugAvatarRezTime"))
+			{
+				const std::string lod_str = highest_lod ? "HighRes" : "LowRes";
+				LLSD args;
+				args["EXISTENCE"] = llformat("%d",(U32)mTexLayerSet->getAvatar()->debugGetExistenceTimeElapsedF32());
+				args["TIME"] = llformat("%d",(U32)mNeedsUploadTimer.getElapsedTimeF32());
+				args["BODYREGION"] = mTexLayerSet->getBodyRegionName();
+				args["RESOLUTION"] = lod_str;
+				LLNotificationsUtil::add("AvatarRezSelfBakedTextureUploadNotification",args);
+				llinfos << "Uploading [ name: " << mTexLayerSet->getBodyRegionName() << " res:" << lod_str << " time:" << (U32)mNeedsUploadTimer.getElapsedTimeF32() << " ]" << llendl;
+			}
+		}
+		else
+		{
+			// The read back and validate operation failed.  Remove the uploaded file.
+			mUploadPending = FALSE;
+			LLVFile file(gVFS, asset_id, LLAssetType::AT_TEXTURE, LLVFile::WRITE);
+			file.remove();
+			llinfos << "Unable to create baked upload file (reason: corrupted)." << llendl;
 		}
 	}
 	else
@@ -556,8 +677,6 @@ void LLTexLayerSetBuffer::doUpload()
 		mUploadPending = FALSE;
 		llinfos << "Unable to create baked upload file (reason: failed to write file)" << llendl;
 	}
-
-	delete [] baked_color_data;
 }
 
 // Mostly bookkeeping; don't need to actually "do" anything since
@@ -940,6 +1059,54 @@ BOOL LLTexLayerSet::render( S32 x, S32 y, S32 width, S32 height )
 }
 
 
+BOOL LLTexLayerSet::composite(LLTexLayerCompositor& compositor, S32& image_capture, std::vector<S32>& mask_captures)
+{
+	BOOL success = TRUE;
+	BOOL is_visible = TRUE;
+
+	for (layer_list_t::iterator iter = mMaskLayerList.begin(); iter != mMaskLayerList.end(); iter++)
+	{
+		LLTexLayerInterface* layer = *iter;
+		if (layer->isInvisibleAlphaMask())
+		{
+			is_visible = FALSE;
+		}
+	}
+
+	compositor.fill(LLColor4(0.f, 0.f, 0.f, 1.f), LLTexLayerCompositor::BLEND_REPLACE, FALSE);
+
+	if (is_visible)
+	{
+		// composite color layers
+		for (layer_list_t::iterator iter = mLayerList.begin(); iter != mLayerList.end(); iter++)
+		{
+			LLTexLayerInterface* layer = *iter;
+			if (layer->getRenderPass() == LLTexLayer::RP_COLOR)
+			{
+				success &= layer->composite(compositor);
+			}
+		}
+
+		success &= compositeAlphaMaskTextures(compositor);
+	}
+	else
+	{
+		compositor.fill(LLColor4(0.f, 0.f, 0.f, 0.f), LLTexLayerCompositor::BLEND_REPLACE, FALSE);
+	}
+
+	image_capture = compositor.captureImage();
+
+	// The morph masks, drawn over what is left in the buffer like gatherMorphMaskAlpha() does
+	for (layer_list_t::iterator iter = mLayerList.begin(); iter != mLayerList.end(); iter++)
+	{
+		LLTexLayerInterface* layer = *iter;
+		success &= layer->compositeAlphaMasks(compositor, mask_captures);
+	}
+
+	return success;
+}
+
+
 BOOL LLTexLayerSet::isBodyRegion(const std::string& region) const 
 { 
 	return mInfo->mBodyRegion == region; 
@@ -1096,6 +1263,35 @@ void LLTexLayerSet::renderAlphaMaskTextures(S32 x, S32 y, S32 width, S32 height,
 	gGL.setSceneBlendType(LLRender::BT_ALPHA);
 }
 
+BOOL LLTexLayerSet::compositeAlphaMaskTextures(LLTexLayerCompositor& compositor)
+{
+	BOOL success = TRUE;
+	const LLTexLayerSetInfo *info = getInfo();
+	const LLColor4 white(1.f, 1.f, 1.f, 1.f);
+
+	if (!info->mStaticAlphaFileName.empty())
+	{
+		LLImageRaw* image_raw = LLTexLayerStaticImageList::getInstance()->getImageRaw(info->mStaticAlphaFileName);
+		if (image_raw)
+		{
+			compositor.draw(image_raw->getData(), image_raw->getWidth(), image_raw->getHeight(), image_raw->getComponents(),
+							TRUE, white, LLTexLayerCompositor::BLEND_REPLACE, TRUE, FALSE);
+		}
+	}
+	else if (info->mClearAlpha || (mMaskLayerList.size() > 0))
+	{
+		compositor.fill(LLColor4(0.f, 0.f, 0.f, 1.f), LLTexLayerCompositor::BLEND_REPLACE, TRUE);
+	}
+
+	for (layer_list_t::iterator iter = mMaskLayerList.begin(); iter != mMaskLayerList.end(); iter++)
+	{
+		LLTexLayerInterface* layer = *iter;
+		success &= layer->compositeAlphaTexture(compositor);
+	}
+
+	return success;
+}
+
 void LLTexLayerSet::applyMorphMask(U8* tex_data, S32 width, S32 height, S32 num_components)
 {
 	mAvatar->applyMorphMask(tex_data, width, height, num_components, mBakedTexIndex);
@@ -1960,6 +2156,210 @@ void LLTexLayer::addAlphaMask(U8 *data, S32 originX, S32 originY, S32 width, S32
 	}
 }
 
+/*virtual*/ BOOL LLTexLayer::composite(LLTexLayerCompositor& compositor)
+{
+	LLColor4 net_color;
+	BOOL color_specified = findNetColor(&net_color);
+	
+	if (mTexLayerSet->getAvatar()->mIsDummy)
+	{
+		color_specified = true;
+		net_color = LLVOAvatar::getDummyColor();
+	}
+
+	BOOL success = TRUE;
+	
+	// If you can't see the layer, don't render it.
+	if( is_approx_zero( net_color.mV[VW] ) )
+	{
+		return success;
+	}
+
+	LLTexLayerCompositor::EBlend blend = LLTexLayerCompositor::BLEND_ALPHA;
+	if (!mParamAlphaList.empty())
+	{
+		success &= compositeMorphMasks(compositor, net_color);
+		blend = LLTexLayerCompositor::BLEND_DEST_ALPHA;
+	}
+	if (getInfo()->mWriteAllChannels)
+	{
+		blend = LLTexLayerCompositor::BLEND_REPLACE;
+	}
+
+	if ((getInfo()->mLocalTexture != -1) && !getInfo()->mUseLocalTextureAlphaOnly)
+	{
+		if (mLocalTextureObject && mLocalTextureObject->getImage() &&
+			(mLocalTextureObject->getID() != IMG_DEFAULT_AVATAR))
+		{
+			const LLImageRaw* image_raw = getLocalTextureRaw();
+			if (!image_raw)
+			{
+				return FALSE;
+			}
+			compositor.draw(image_raw->getData(), image_raw->getWidth(), image_raw->getHeight(), image_raw->getComponents(),
+							FALSE, net_color, blend, FALSE, !getInfo()->mWriteAllChannels);
+		}
+	}
+
+	if (!getInfo()->mStaticImageFileName.empty())
+	{
+		LLImageRaw* image_raw = LLTexLayerStaticImageList::getInstance()->getImageRaw(getInfo()->mStaticImageFileName);
+		if (image_raw)
+		{
+			compositor.draw(image_raw->getData(), image_raw->getWidth(), image_raw->getHeight(), image_raw->getComponents(),
+							getInfo()->mStaticImageIsMask, net_color, blend, FALSE, TRUE);
+		}
+		else
+		{
+			success = FALSE;
+		}
+	}
+
+	if (((-1 == getInfo()->mLocalTexture) ||
+		 getInfo()->mUseLocalTextureAlphaOnly) &&
+		getInfo()->mStaticImageFileName.empty() &&
+		color_specified)
+	{
+		compositor.fill(net_color, blend, FALSE);
+	}
+
+	return success;
+}
+
+/*virtual*/ BOOL LLTexLayer::compositeAlphaMasks(LLTexLayerCompositor& compositor, std::vector<S32>& mask_captures)
+{
+	if (!hasAlphaParams())
+	{
+		return TRUE;
+	}
+
+	LLColor4 net_color;
+	findNetColor(&net_color);
+	BOOL success = compositeMorphMasks(compositor, net_color);
+	mask_captures.push_back(compositor.captureAlpha());
+	return success;
+}
+
+/*virtual*/ BOOL LLTexLayer::compositeAlphaTexture(LLTexLayerCompositor& compositor)
+{
+	// Drawn with TB_REPLACE, so the texture's own alpha whatever the color
+	const LLColor4 white(1.f, 1.f, 1.f, 1.f);
+
+	if (!getInfo()->mStaticImageFileName.empty())
+	{
+		LLImageRaw* image_raw = LLTexLayerStaticImageList::getInstance()->getImageRaw(getInfo()->mStaticImageFileName);
+		if (!image_raw)
+		{
+			return FALSE;
+		}
+		compositor.draw(image_raw->getData(), image_raw->getWidth(), image_raw->getHeight(), image_raw->getComponents(),
+						getInfo()->mStaticImageIsMask, white, LLTexLayerCompositor::BLEND_MULT_ALPHA, TRUE, FALSE);
+	}
+	else if (getInfo()->mLocalTexture >=0 && getInfo()->mLocalTexture < TEX_NUM_INDICES)
+	{
+		if (mLocalTextureObject->getImage())
+		{
+			const LLImageRaw* image_raw = getLocalTextureRaw();
+			if (!image_raw)
+			{
+				return FALSE;
+			}
+			compositor.draw(image_raw->getData(), image_raw->getWidth(), image_raw->getHeight(), image_raw->getComponents(),
+							FALSE, white, LLTexLayerCompositor::BLEND_MULT_ALPHA, TRUE, FALSE);
+		}
+	}
+
+	return TRUE;
+}
+
+BOOL LLTexLayer::compositeMorphMasks(LLTexLayerCompositor& compositor, const LLColor4 &layer_color)
+{
+	BOOL success = TRUE;
+
+	llassert( !mParamAlphaList.empty() );
+
+	LLTexLayerParamAlpha* first_param = *mParamAlphaList.begin();
+	// Note: if the first param is a mulitply, multiply against the current buffer's alpha
+	if( !first_param || !first_param->getMultiplyBlend() )
+	{
+		compositor.fill(LLColor4(0.f, 0.f, 0.f, 0.f), LLTexLayerCompositor::BLEND_REPLACE, TRUE);
+	}
+
+	// Accumulate alphas.  A param without a texture leaves its color set for the draws after it.
+	LLColor4 color(1.f, 1.f, 1.f, 1.f);
+	for (param_alpha_list_t::iterator iter = mParamAlphaList.begin(); iter != mParamAlphaList.end(); iter++)
+	{
+		LLTexLayerParamAlpha* param = *iter;
+		success &= param->composite(compositor, color);
+	}
+
+	// Accumulate the alpha component of the texture
+	if( getInfo()->mLocalTexture != -1 )
+	{
+		LLViewerTexture* tex = mLocalTextureObject->getImage();
+		if( tex && (tex->getComponents() == 4) )
+		{
+			const LLImageRaw* image_raw = getLocalTextureRaw();
+			if (!image_raw)
+			{
+				return FALSE;
+			}
+			compositor.draw(image_raw->getData(), image_raw->getWidth(), image_raw->getHeight(), image_raw->getComponents(),
+							FALSE, color, LLTexLayerCompositor::BLEND_MULT_ALPHA, TRUE, FALSE);
+		}
+	}
+
+	if( !getInfo()->mStaticImageFileName.empty() )
+	{
+		LLImageRaw* image_raw = LLTexLayerStaticImageList::getInstance()->getImageRaw(getInfo()->mStaticImageFileName);
+		if( image_raw )
+		{
+			if(	(image_raw->getComponents() == 4) ||
+				( (image_raw->getComponents() == 1) && getInfo()->mStaticImageIsMask ) )
+			{
+				compositor.draw(image_raw->getData(), image_raw->getWidth(), image_raw->getHeight(), image_raw->getComponents(),
+								getInfo()->mStaticImageIsMask, color, LLTexLayerCompositor::BLEND_MULT_ALPHA, TRUE, FALSE);
+			}
+		}
+	}
+
+	// Multiply the alpha by the layer color's alpha.
+	if (layer_color.mV[VW] != 1.f)
+	{
+		compositor.fill(layer_color, LLTexLayerCompositor::BLEND_MULT_ALPHA, TRUE);
+	}
+
+	return success;
+}
+
+// The image data of the local texture, if it is kept on the CPU at the
+// same resolution GL has.  The cached raw image is capped well below full
+// size, so a raw at a coarser discard level than the GL texture would bake
+// a blurry layer; NULL sends the caller to the GL readback instead.
+const LLImageRaw* LLTexLayer::getLocalTextureRaw() const
+{
+	LLViewerFetchedTexture* tex = mLocalTextureObject ? mLocalTextureObject->getImage() : NULL;
+	if (!tex)
+	{
+		return NULL;
+	}
+	S32 gl_discard = tex->getDiscardLevel();
+	if (gl_discard < 0)
+	{
+		return NULL;
+	}
+	const LLImageRaw* image_raw = NULL;
+	if (tex->hasSavedRawImage() && tex->getSavedRawImageLevel() == gl_discard)
+	{
+		image_raw = tex->getSavedRawImage();
+	}
+	else if (tex->getCachedRawImageLevel() == gl_discard)
+	{
+		image_raw = tex->getCachedRawImage();
+	}
+	return (image_raw && image_raw->getData()) ? image_raw : NULL;
+}
+
 /*virtual*/ BOOL LLTexLayer::isInvisibleAlphaMask() const
 {
 	if (mLocalTextureObject)
@@ -2185,6 +2585,69 @@ LLTexLayer* LLTexLayerTemplate::getLayer(U32 i) const
 }
 
 
+/*virtual*/ BOOL LLTexLayerTemplate::composite(LLTexLayerCompositor& compositor)
+{
+	if(!mInfo)
+	{
+		return FALSE ;
+	}
+
+	BOOL success = TRUE;
+	updateWearableCache();
+	for (wearable_cache_t::const_iterator iter = mWearableCache.begin(); iter!= mWearableCache.end(); iter++)
+	{
+		LLWearable* wearable = *iter;
+		LLLocalTextureObject *lto = NULL;
+		LLTexLayer *layer = NULL;
+		if (wearable)
+		{
+			lto = wearable->getLocalTextureObject(mInfo->mLocalTexture);
+		}
+		if (lto)
+		{
+			layer = lto->getTexLayer(getName());
+		}
+		if (layer)
+		{
+			wearable->writeToAvatar();
+			layer->setLTO(lto);
+			success &= layer->composite(compositor);
+		}
+	}
+
+	return success;
+}
+
+/*virtual*/ BOOL LLTexLayerTemplate::compositeAlphaMasks(LLTexLayerCompositor& compositor, std::vector<S32>& mask_captures)
+{
+	BOOL success = TRUE;
+	U32 num_wearables = updateWearableCache();
+	for (U32 i = 0; i < num_wearables; i++)
+	{
+		LLTexLayer *layer = getLayer(i);
+		if (layer)
+		{
+			success &= layer->compositeAlphaMasks(compositor, mask_captures);
+		}
+	}
+	return success;
+}
+
+/*virtual*/ BOOL LLTexLayerTemplate::compositeAlphaTexture(LLTexLayerCompositor& compositor)
+{
+	BOOL success = TRUE;
+	U32 num_wearables = updateWearableCache();
+	for (U32 i = 0; i < num_wearables; i++)
+	{
+		LLTexLayer *layer = getLayer(i);
+		if (layer)
+		{
+			success &= layer->compositeAlphaTexture(compositor);
+		}
+	}
+	return success;
+}
+
 //-----------------------------------------------------------------------------
 // finds a specific layer based on a passed in name
 //-----------------------------------------------------------------------------
@@ -2236,6 +2699,7 @@ void LLTexLayerSet::cloneTemplates(LLLocalTextureObject *lto, LLVOAvatarDefines:
 LLTexLayerStaticImageList::LLTexLayerStaticImageList() :
 	mGLBytes(0),
 	mTGABytes(0),
+	mRawBytes(0),
 	mImageNames(16384)
 {
 }
@@ -2249,24 +2713,28 @@ void LLTexLayerStaticImageList::dumpByteCount() const
 {
 	llinfos << "Avatar Static Textures " <<
 		"KB GL:" << (mGLBytes / 1024) <<
-		"KB TGA:" << (mTGABytes / 1024) << "KB" << llendl;
+		"KB TGA:" << (mTGABytes / 1024) <<
+		"KB Raw:" << (mRawBytes / 1024) << "KB" << llendl;
 }
 
 void LLTexLayerStaticImageList::deleteCachedImages()
 {
-	if( mGLBytes || mTGABytes )
+	if( mGLBytes || mTGABytes || mRawBytes )
 	{
 		llinfos << "Clearing Static Textures " <<
 			"KB GL:" << (mGLBytes / 1024) <<
-			"KB TGA:" << (mTGABytes / 1024) << "KB" << llendl;
+			"KB TGA:" << (mTGABytes / 1024) <<
+			"KB Raw:" << (mRawBytes / 1024) << "KB" << llendl;
 
 		//mStaticImageLists uses LLPointers, clear() will cause deletion
 		
 		mStaticImageListTGA.clear();
+		mStaticImageListRaw.clear();
 		mStaticImageList.clear();
 		
 		mGLBytes = 0;
 		mTGABytes = 0;
+		mRawBytes = 0;
 	}
 }
 
@@ -2302,6 +2770,32 @@ LLImageTGA* LLTexLayerStaticImageList::getImageTGA(const std::string& file_name)
 	}
 }
 
+// Returns an LLImageRaw with the decoded data from a tga file named file_name,
+// for compositing on the CPU.  Caches the result to speed identical subsequent requests.
+LLImageRaw* LLTexLayerStaticImageList::getImageRaw(const std::string& file_name)
+{
+	const char *namekey = mImageNames.addString(file_name);
+	image_raw_map_t::const_iterator iter = mStaticImageListRaw.find(namekey);
+	if( iter != mStaticImageListRaw.end() )
+	{
+		return iter->second;
+	}
+	else
+	{
+		LLPointer<LLImageRaw> image_raw = new LLImageRaw;
+		if( loadImageRaw( file_name, image_raw ) )
+		{
+			mStaticImageListRaw[ namekey ] = image_raw;
+			mRawBytes += image_raw->getDataSize();
+			return image_raw;
+		}
+		else
+		{
+			return NULL;
+		}
+	}
+}
+
 // Returns a GL Image (without a backing ImageRaw) that contains the decoded data from a tga file named file_name.
 // Caches the result to speed identical subsequent requests.
 LLViewerTexture* LLTexLayerStaticImageList::getTexture(const std::string& file_name, BOOL is_mask)
@@ -31,11 +31,14 @@
 #include "lldynamictexture.h"
 #include "llvoavatardefines.h"
 #include "lltexlayerparams.h"
+#include "lltexlayercompositor.h"
+#include "llimageworker.h"
 
 class LLVOAvatar;
 class LLVOAvatarSelf;
 class LLImageTGA;
 class LLImageRaw;
+class LLImageJ2C;
 class LLXmlTreeNode;
 class LLTexLayerSet;
 class LLTexLayerSetInfo;
@@ -69,6 +72,12 @@ public:
 	virtual BOOL			blendAlphaTexture(S32 x, S32 y, S32 width, S32 height) = 0;
 	virtual BOOL			isInvisibleAlphaMask() const = 0;
 
+	// CPU counterparts of render(), gatherAlphaMasks() and blendAlphaTexture(),
+	// see LLTexLayerSet::composite().
+	virtual BOOL			composite(LLTexLayerCompositor& compositor) = 0;
+	virtual BOOL			compositeAlphaMasks(LLTexLayerCompositor& compositor, std::vector<S32>& mask_captures) = 0;
+	virtual BOOL			compositeAlphaTexture(LLTexLayerCompositor& compositor) = 0;
+
 	const LLTexLayerInfo* 	getInfo() const 			{ return mInfo; }
 	virtual BOOL			setInfo(const LLTexLayerInfo *info, LLWearable* wearable); // sets mInfo, calls initialization functions
 
@@ -123,6 +132,9 @@ public:
 	/*virtual*/ void		setHasMorph(BOOL newval);
 	/*virtual*/ void		deleteCaches();
 	/*virtual*/ BOOL		isInvisibleAlphaMask() const;
+	/*virtual*/ BOOL		composite(LLTexLayerCompositor& compositor);
+	/*virtual*/ BOOL		compositeAlphaMasks(LLTexLayerCompositor& compositor, std::vector<S32>& mask_captures);
+	/*virtual*/ BOOL		compositeAlphaTexture(LLTexLayerCompositor& compositor);
 protected:
 	U32 					updateWearableCache() const;
 	LLTexLayer* 			getLayer(U32 i) const;
@@ -157,12 +169,18 @@ public:
 	void					addAlphaMask(U8 *data, S32 originX, S32 originY, S32 width, S32 height);
 	/*virtual*/ BOOL		isInvisibleAlphaMask() const;
 
+	/*virtual*/ BOOL		composite(LLTexLayerCompositor& compositor);
+	/*virtual*/ BOOL		compositeAlphaMasks(LLTexLayerCompositor& compositor, std::vector<S32>& mask_captures);
+	/*virtual*/ BOOL		compositeAlphaTexture(LLTexLayerCompositor& compositor);
+	BOOL					compositeMorphMasks(LLTexLayerCompositor& compositor, const LLColor4 &layer_color);
+
 	void					setLTO(LLLocalTextureObject *lto) 	{ mLocalTextureObject = lto; }
 	LLLocalTextureObject* 	getLTO() 							{ return mLocalTextureObject; }
 
 	static void 			calculateTexLayerColor(const param_color_list_t &param_list, LLColor4 &net_color);
 protected:
 	LLUUID					getUUID() const;
+	const LLImageRaw*		getLocalTextureRaw() const;
 private:
 	typedef std::map<U32, U8*> alpha_cache_t;
 	alpha_cache_t			mAlphaCache;
@@ -188,6 +206,13 @@ public:
 	BOOL						render(S32 x, S32 y, S32 width, S32 height);
 	void						renderAlphaMaskTextures(S32 x, S32 y, S32 width, S32 height, bool forceClear = false);
 
+	// Records what render() and then gatherMorphMaskAlpha() draw into compositor,
+	// capturing the color image and the alpha of each morph mask.  Returns FALSE
+	// if a texture has no image data on the CPU, in which case the bake has to
+	// be read back from GL.
+	BOOL						composite(LLTexLayerCompositor& compositor, S32& image_capture, std::vector<S32>& mask_captures);
+	BOOL						compositeAlphaMaskTextures(LLTexLayerCompositor& compositor);
+
 	BOOL						isBodyRegion(const std::string& region) const;
 	LLTexLayerSetBuffer*		getComposite();
 	const LLTexLayerSetBuffer* 	getComposite() const; // Do not create one if it doesn't exist.
@@ -305,6 +330,10 @@ public:
 protected:
 	BOOL					isReadyToUpload() const;
 	void					doUpload(); 					// Does a read back and upload.
+	BOOL					compositeForUpload(LLImageRaw* baked_image);	// Bakes on the CPU instead of reading back.
+	void					readBackForUpload(LLImageRaw* baked_image);
+	void					finishEncode();					// Uploads once the encode has completed.
+	void					uploadEncodedImage(LLImageJ2C* compressed_image, BOOL highest_lod);
 	void					conditionalRestartUploadTimer();
 private:
 	BOOL					mNeedsUpload; 					// Whether we need to send our baked textures to the server
@@ -313,6 +342,18 @@ private:
 	LLUUID					mUploadID; 						// The current upload process (null if none).
 	LLFrameTimer    		mNeedsUploadTimer; 				// Tracks time since upload was requested and performed.
 
+	class EncodeResponder : public LLImageDecodeThread::EncodeResponder
+	{
+	public:
+		EncodeResponder(BOOL highest_lod) : mState(ENCODE_PENDING), mHighestLOD(highest_lod) {}
+		/*virtual*/ void completed(bool success, LLImageJ2C* image) { mState = success ? ENCODE_DONE : ENCODE_FAILED; }
+		enum { ENCODE_PENDING, ENCODE_DONE, ENCODE_FAILED };
+		LLAtomicS32 mState;
+		const BOOL mHighestLOD;				// Whether the bake was made from the final LOD of every texture
+	};
+	LLPointer<EncodeResponder>	mEncodeResponder;			// Set while the bake is being encoded on the decode thread
+	LLPointer<LLImageJ2C>	mEncodeImage;
+
 	//--------------------------------------------------------------------
 	// Updates
 	//--------------------------------------------------------------------
@@ -340,6 +381,7 @@ public:
 	~LLTexLayerStaticImageList();
 	LLViewerTexture*	getTexture(const std::string& file_name, BOOL is_mask);
 	LLImageTGA*			getImageTGA(const std::string& file_name);
+	LLImageRaw*			getImageRaw(const std::string& file_name);
 	void				deleteCachedImages();
 	void				dumpByteCount() const;
 protected:
@@ -350,8 +392,11 @@ private:
 	texture_map_t 		mStaticImageList;
 	typedef std::map<const char*, LLPointer<LLImageTGA> > image_tga_map_t;
 	image_tga_map_t 	mStaticImageListTGA;
+	typedef std::map<const char*, LLPointer<LLImageRaw> > image_raw_map_t;
+	image_raw_map_t 	mStaticImageListRaw;
 	S32 				mGLBytes;
 	S32 				mTGABytes;
+	S32 				mRawBytes;
 };
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
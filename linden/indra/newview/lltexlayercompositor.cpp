@@ -0,0 +1,396 @@
+/**
+ * @file lltexlayercompositor.cpp
+ * @brief Composites avatar bake layers on the CPU across a work pool.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltexlayercompositor.h"
+
+#include "llstl.h"
+#include "llv4math.h"
+
+// Rows per work pool task
+static const S32 BAND_ROWS = 16;
+
+// glAlphaFunc(GL_GREATER, 0.01f), the default alpha reject
+static const F32 ALPHA_REJECT = 0.01f;
+
+static const F32 INV_255 = 1.f / 255.f;
+
+LLTexLayerCompositor::LLTexLayerCompositor(S32 width, S32 height)
+:	mWidth(width),
+	mHeight(height)
+{
+	mPixels.resize(width * height * 4, 0);
+}
+
+LLTexLayerCompositor::~LLTexLayerCompositor()
+{
+	for_each(mSources.begin(), mSources.end(), DeletePointer());
+	mSources.clear();
+}
+
+//static
+void LLTexLayerCompositor::setupSampling(S32 size, S32 source_size, std::vector<S32>* index, std::vector<F32>& frac)
+{
+	// GL samples texel centers, so a texture the size of the buffer
+	// lands exactly on the pixels.
+	index[0].resize(size);
+	index[1].resize(size);
+	frac.resize(size);
+	F32 scale = (F32)source_size / (F32)size;
+	for (S32 i = 0; i < size; i++)
+	{
+		F32 u = ((F32)i + 0.5f) * scale - 0.5f;
+		S32 i0 = llfloor(u);
+		frac[i] = u - (F32)i0;
+		index[0][i] = llclamp(i0, 0, source_size - 1);
+		index[1][i] = llclamp(i0 + 1, 0, source_size - 1);
+	}
+}
+
+void LLTexLayerCompositor::draw(const U8* data, S32 width, S32 height, S32 components, BOOL is_mask,
+								const LLColor4& color, EBlend blend, BOOL alpha_only, BOOL alpha_test)
+{
+	llassert(data && width > 0 && height > 0);
+
+	// Expand to RGBA the way GL would hand the texels to a modulate
+	// texture environment.
+	Source* source = new Source;
+	source->mWidth = width;
+	source->mHeight = height;
+	source->mTexels.resize(width * height * 4);
+	U8* texel = &source->mTexels[0];
+	S32 count = width * height;
+	for (S32 i = 0; i < count; i++, texel += 4, data += components)
+	{
+		switch (components)
+		{
+		  case 1:
+			if (is_mask)
+			{
+				texel[0] = texel[1] = texel[2] = 255;
+				texel[3] = data[0];
+			}
+			else
+			{
+				texel[0] = texel[1] = texel[2] = data[0];
+				texel[3] = 255;
+			}
+			break;
+		  case 2:
+			texel[0] = texel[1] = texel[2] = data[0];
+			texel[3] = data[1];
+			break;
+		  case 3:
+			texel[0] = data[0];
+			texel[1] = data[1];
+			texel[2] = data[2];
+			texel[3] = 255;
+			break;
+		  default:
+			texel[0] = data[0];
+			texel[1] = data[1];
+			texel[2] = data[2];
+			texel[3] = data[3];
+			break;
+		}
+	}
+	setupSampling(mWidth, width, source->mColumn, source->mColumnFrac);
+	setupSampling(mHeight, height, source->mRow, source->mRowFrac);
+	mSources.push_back(source);
+
+	Op op;
+	op.mType = OP_DRAW;
+	op.mSource = (S32)mSources.size() - 1;
+	op.mCapture = -1;
+	op.mColor = color;
+	op.mBlend = blend;
+	op.mAlphaOnly = alpha_only;
+	op.mAlphaTest = alpha_test;
+	mOps.push_back(op);
+}
+
+void LLTexLayerCompositor::fill(const LLColor4& color, EBlend blend, BOOL alpha_only)
+{
+	Op op;
+	op.mType = OP_DRAW;
+	op.mSource = -1;
+	op.mCapture = -1;
+	op.mColor = color;
+	op.mBlend = blend;
+	op.mAlphaOnly = alpha_only;
+	op.mAlphaTest = FALSE;
+	mOps.push_back(op);
+}
+
+S32 LLTexLayerCompositor::captureImage()
+{
+	Op op;
+	op.mType = OP_CAPTURE_IMAGE;
+	op.mSource = -1;
+	op.mCapture = (S32)mCaptures.size();
+	mCaptures.push_back(std::vector<U8>(mWidth * mHeight * 4));
+	mOps.push_back(op);
+	return op.mCapture;
+}
+
+S32 LLTexLayerCompositor::captureAlpha()
+{
+	Op op;
+	op.mType = OP_CAPTURE_ALPHA;
+	op.mSource = -1;
+	op.mCapture = (S32)mCaptures.size();
+	mCaptures.push_back(std::vector<U8>(mWidth * mHeight));
+	mOps.push_back(op);
+	return op.mCapture;
+}
+
+void LLTexLayerCompositor::execute(LLWorkPool* pool)
+{
+	S32 bands = (mHeight + BAND_ROWS - 1) / BAND_ROWS;
+	if (pool)
+	{
+		pool->parallelFor(*this, bands);
+	}
+	else
+	{
+		for (S32 i = 0; i < bands; i++)
+		{
+			run(i);
+		}
+	}
+}
+
+void LLTexLayerCompositor::run(S32 band)
+{
+	S32 row_begin = band * BAND_ROWS;
+	S32 row_end = llmin(row_begin + BAND_ROWS, mHeight);
+	for (std::vector<Op>::const_iterator iter = mOps.begin(); iter != mOps.end(); ++iter)
+	{
+		const Op& op = *iter;
+		switch (op.mType)
+		{
+		  case OP_DRAW:
+			drawRows(op, row_begin, row_end);
+			break;
+		  case OP_CAPTURE_IMAGE:
+			{
+				S32 offset = row_begin * mWidth * 4;
+				memcpy(&mCaptures[op.mCapture][offset], &mPixels[offset], (row_end - row_begin) * mWidth * 4);		/* Flawfinder: ignore */
+			}
+			break;
+		  case OP_CAPTURE_ALPHA:
+			for (S32 i = row_begin * mWidth; i < row_end * mWidth; i++)
+			{
+				mCaptures[op.mCapture][i] = mPixels[i * 4 + 3];
+			}
+			break;
+		}
+	}
+}
+
+void LLTexLayerCompositor::drawRows(const Op& op, S32 row_begin, S32 row_end)
+{
+	const Source* source = op.mSource >= 0 ? mSources[op.mSource] : NULL;
+
+	// Texels stay 0-255 through the filtering, the color takes them to 0-1
+	LLColor4 color = op.mColor;
+	if (source)
+	{
+		color *= INV_255;
+		color.mV[VW] *= INV_255;
+	}
+
+#if LL_VECTORIZE
+	const __m128 v_color = _mm_set_ps(color.mV[VW], color.mV[VZ], color.mV[VY], color.mV[VX]);
+	const __m128 v_inv_255 = _mm_set1_ps(INV_255);
+	const __m128 v_zero = _mm_setzero_ps();
+	const __m128 v_one = _mm_set1_ps(1.f);
+	const __m128 v_255 = _mm_set1_ps(255.f);
+	const __m128 v_half = _mm_set1_ps(0.5f);
+	const __m128 v_reject = _mm_set_ss(ALPHA_REJECT);
+	// all ones in the alpha lane only
+	const __m128 v_alpha_mask = _mm_cmplt_ps(_mm_set_ps(0.f, 1.f, 1.f, 1.f), v_one);
+	F32 result[4];
+
+	for (S32 y = row_begin; y < row_end; y++)
+	{
+		const U8* row0 = NULL;
+		const U8* row1 = NULL;
+		__m128 v_fy = v_zero;
+		if (source)
+		{
+			row0 = &source->mTexels[source->mRow[0][y] * source->mWidth * 4];
+			row1 = &source->mTexels[source->mRow[1][y] * source->mWidth * 4];
+			v_fy = _mm_set1_ps(source->mRowFrac[y]);
+		}
+		U8* dst = &mPixels[y * mWidth * 4];
+		for (S32 x = 0; x < mWidth; x++, dst += 4)
+		{
+			__m128 s = v_color;
+			if (source)
+			{
+				const U8* t00 = row0 + source->mColumn[0][x] * 4;
+				const U8* t10 = row0 + source->mColumn[1][x] * 4;
+				const U8* t01 = row1 + source->mColumn[0][x] * 4;
+				const U8* t11 = row1 + source->mColumn[1][x] * 4;
+				__m128 v_fx = _mm_set1_ps(source->mColumnFrac[x]);
+				__m128 v00 = _mm_set_ps(t00[3], t00[2], t00[1], t00[0]);
+				__m128 v10 = _mm_set_ps(t10[3], t10[2], t10[1], t10[0]);
+				__m128 v01 = _mm_set_ps(t01[3], t01[2], t01[1], t01[0]);
+				__m128 v11 = _mm_set_ps(t11[3], t11[2], t11[1], t11[0]);
+				__m128 top = _mm_add_ps(v00, _mm_mul_ps(_mm_sub_ps(v10, v00), v_fx));
+				__m128 bottom = _mm_add_ps(v01, _mm_mul_ps(_mm_sub_ps(v11, v01), v_fx));
+				s = _mm_mul_ps(_mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), v_fy)), v_color);
+			}
+			__m128 sa = _mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 3, 3, 3));
+			if (op.mAlphaTest && _mm_comile_ss(sa, v_reject))
+			{
+				continue;
+			}
+
+			__m128 d = _mm_mul_ps(_mm_set_ps(dst[3], dst[2], dst[1], dst[0]), v_inv_255);
+			__m128 da = _mm_shuffle_ps(d, d, _MM_SHUFFLE(3, 3, 3, 3));
+			__m128 r;
+			switch (op.mBlend)
+			{
+			  case BLEND_ALPHA:
+				r = _mm_add_ps(_mm_mul_ps(s, sa), _mm_mul_ps(d, _mm_sub_ps(v_one, sa)));
+				break;
+			  case BLEND_DEST_ALPHA:
+				r = _mm_add_ps(_mm_mul_ps(s, da), _mm_mul_ps(d, _mm_sub_ps(v_one, da)));
+				break;
+			  case BLEND_ADD:
+				r = _mm_add_ps(s, d);
+				break;
+			  case BLEND_MULT_ALPHA:
+				r = _mm_mul_ps(s, da);
+				break;
+			  default:
+				r = s;
+				break;
+			}
+			if (op.mAlphaOnly)
+			{
+				r = _mm_or_ps(_mm_and_ps(v_alpha_mask, r), _mm_andnot_ps(v_alpha_mask, d));
+			}
+			r = _mm_min_ps(_mm_max_ps(r, v_zero), v_one);
+			_mm_storeu_ps(result, _mm_add_ps(_mm_mul_ps(r, v_255), v_half));
+			dst[0] = (U8)(S32)result[0];
+			dst[1] = (U8)(S32)result[1];
+			dst[2] = (U8)(S32)result[2];
+			dst[3] = (U8)(S32)result[3];
+		}
+	}
+#else
+	for (S32 y = row_begin; y < row_end; y++)
+	{
+		const U8* row0 = NULL;
+		const U8* row1 = NULL;
+		F32 fy = 0.f;
+		if (source)
+		{
+			row0 = &source->mTexels[source->mRow[0][y] * source->mWidth * 4];
+			row1 = &source->mTexels[source->mRow[1][y] * source->mWidth * 4];
+			fy = source->mRowFrac[y];
+		}
+		U8* dst = &mPixels[y * mWidth * 4];
+		for (S32 x = 0; x < mWidth; x++, dst += 4)
+		{
+			F32 s[4] = { color.mV[0], color.mV[1], color.mV[2], color.mV[3] };
+			if (source)
+			{
+				const U8* t00 = row0 + source->mColumn[0][x] * 4;
+				const U8* t10 = row0 + source->mColumn[1][x] * 4;
+				const U8* t01 = row1 + source->mColumn[0][x] * 4;
+				const U8* t11 = row1 + source->mColumn[1][x] * 4;
+				F32 fx = source->mColumnFrac[x];
+				for (S32 c = 0; c < 4; c++)
+				{
+					F32 top = (F32)t00[c] + ((F32)t10[c] - (F32)t00[c]) * fx;
+					F32 bottom = (F32)t01[c] + ((F32)t11[c] - (F32)t01[c]) * fx;
+					s[c] = (top + (bottom - top) * fy) * color.mV[c];
+				}
+			}
+			if (op.mAlphaTest && s[3] <= ALPHA_REJECT)
+			{
+				continue;
+			}
+
+			F32 d[4];
+			for (S32 c = 0; c < 4; c++)
+			{
+				d[c] = (F32)dst[c] * INV_255;
+			}
+			for (S32 c = op.mAlphaOnly ? 3 : 0; c < 4; c++)
+			{
+				F32 r;
+				switch (op.mBlend)
+				{
+				  case BLEND_ALPHA:
+					r = s[c] * s[3] + d[c] * (1.f - s[3]);
+					break;
+				  case BLEND_DEST_ALPHA:
+					r = s[c] * d[3] + d[c] * (1.f - d[3]);
+					break;
+				  case BLEND_ADD:
+					r = s[c] + d[c];
+					break;
+				  case BLEND_MULT_ALPHA:
+					r = s[c] * d[3];
+					break;
+				  default:
+					r = s[c];
+					break;
+				}
+				dst[c] = (U8)(S32)(llclamp(r, 0.f, 1.f) * 255.f + 0.5f);
+			}
+		}
+	}
+#endif
+}
+
+//static
+void LLTexLayerCompositor::compare(const U8* a, const U8* b, S32 count, S32 components,
+								   S32* max_diff, F32* mean_diff)
+{
+	std::vector<U32> total(components, 0);
+	for (S32 c = 0; c < components; c++)
+	{
+		max_diff[c] = 0;
+	}
+	for (S32 i = 0; i < count * components; i++)
+	{
+		S32 c = i % components;
+		S32 diff = llabs((S32)a[i] - (S32)b[i]);
+		max_diff[c] = llmax(max_diff[c], diff);
+		total[c] += diff;
+	}
+	for (S32 c = 0; c < components; c++)
+	{
+		mean_diff[c] = count > 0 ? (F32)total[c] / (F32)count : 0.f;
+	}
+}
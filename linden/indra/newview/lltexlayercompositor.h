@@ -0,0 +1,143 @@
+/**
+ * @file lltexlayercompositor.h
+ * @brief Composites avatar bake layers on the CPU across a work pool.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXLAYERCOMPOSITOR_H
+#define LL_LLTEXLAYERCOMPOSITOR_H
+
+#include <vector>
+
+#include "v4color.h"
+#include "llworkpool.h"
+
+//============================================================================
+// LLTexLayerCompositor
+//
+// Replays what LLTexLayerSet draws into its bake buffer, without GL.  Each
+// draw is recorded on the main thread the way it would be issued to GL: a
+// textured or flat rectangle over the whole buffer, modulated by a color,
+// with one of the blend functions the layers use.  execute() then runs the
+// recorded draws over bands of rows across a work pool; every draw only
+// reads and writes its own pixel, so bands never wait on each other.
+//
+// The buffer is RGBA8 and rounded after every draw, like a framebuffer.
+// Textures are stretched over the buffer with bilinear filtering and
+// clamped edges.  Minification averages at most 2x2 texels, where GL would
+// use a mip, so sources more than twice the buffer size differ slightly.
+
+class LLTexLayerCompositor : public LLWorkPool::Task
+{
+public:
+	enum EBlend
+	{
+		BLEND_REPLACE,		// src					(BT_REPLACE)
+		BLEND_ALPHA,		// src*sa + dst*(1-sa)	(BT_ALPHA)
+		BLEND_DEST_ALPHA,	// src*da + dst*(1-da)	(BF_DEST_ALPHA, BF_ONE_MINUS_DEST_ALPHA)
+		BLEND_ADD,			// src + dst			(BT_ADD)
+		BLEND_MULT_ALPHA	// src*da				(BT_MULT_ALPHA)
+	};
+
+	LLTexLayerCompositor(S32 width, S32 height);
+	~LLTexLayerCompositor();
+
+	// Draws data, a width x height image with the given number of
+	// components, over the whole buffer.  Single component images are
+	// alpha textures if is_mask is set, luminance otherwise.  With
+	// alpha_only, only the alpha channel is written (a false color mask).
+	// alpha_test drops fragments whose alpha is not above 0.01, like the
+	// default alpha reject.  The data is copied, so need not outlive the call.
+	void draw(const U8* data, S32 width, S32 height, S32 components, BOOL is_mask,
+			  const LLColor4& color, EBlend blend, BOOL alpha_only, BOOL alpha_test);
+
+	// A rectangle of color without a texture.
+	void fill(const LLColor4& color, EBlend blend, BOOL alpha_only);
+
+	// Copies the buffer, or just its alpha, out at this point in the draws.
+	// Returns the index to fetch it back with getCapture() after execute().
+	S32 captureImage();
+	S32 captureAlpha();
+
+	// Runs every draw.  pool may be NULL.
+	void execute(LLWorkPool* pool);
+
+	S32 getWidth() const					{ return mWidth; }
+	S32 getHeight() const					{ return mHeight; }
+	S32 getNumDraws() const					{ return (S32)mOps.size(); }
+	const U8* getImage() const				{ return mPixels.empty() ? NULL : &mPixels[0]; }
+	const U8* getCapture(S32 index) const	{ return &mCaptures[index][0]; }
+
+	/*virtual*/ void run(S32 band);
+
+	// Per channel difference between two images of count pixels, for checking
+	// the result against a GL bake.  max_diff and mean_diff hold components
+	// entries each.
+	static void compare(const U8* a, const U8* b, S32 count, S32 components,
+						S32* max_diff, F32* mean_diff);
+
+private:
+	enum EOp
+	{
+		OP_DRAW,
+		OP_CAPTURE_IMAGE,
+		OP_CAPTURE_ALPHA
+	};
+
+	struct Op
+	{
+		EOp mType;
+		S32 mSource;		// into mSources, -1 for a flat color
+		S32 mCapture;		// into mCaptures
+		LLColor4 mColor;
+		EBlend mBlend;
+		BOOL mAlphaOnly;
+		BOOL mAlphaTest;
+	};
+
+	// A texture expanded to RGBA, with where each buffer pixel samples it
+	struct Source
+	{
+		S32 mWidth;
+		S32 mHeight;
+		std::vector<U8> mTexels;
+		std::vector<S32> mColumn[2];	// per buffer column, the two texel columns
+		std::vector<F32> mColumnFrac;
+		std::vector<S32> mRow[2];
+		std::vector<F32> mRowFrac;
+	};
+
+	static void setupSampling(S32 size, S32 source_size, std::vector<S32>* index, std::vector<F32>& frac);
+
+	void drawRows(const Op& op, S32 row_begin, S32 row_end);
+
+private:
+	S32 mWidth;
+	S32 mHeight;
+	std::vector<U8> mPixels;
+	std::vector<Op> mOps;
+	std::vector<Source*> mSources;
+	std::vector<std::vector<U8> > mCaptures;
+};
+
+#endif // LL_LLTEXLAYERCOMPOSITOR_H
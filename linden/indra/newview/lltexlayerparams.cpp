@@ -31,6 +31,7 @@
 #include "llagentcamera.h"
 #include "llimagetga.h"
 #include "lltexlayer.h"
+#include "lltexlayercompositor.h"
 #include "llvoavatarself.h"
 #include "llwearable.h"
 #include "llui.h"
@@ -348,6 +349,65 @@ BOOL LLTexLayerParamAlpha::render(S32 x, S32 y, S32 width, S32 height)
 	return success;
 }
 
+BOOL LLTexLayerParamAlpha::composite(LLTexLayerCompositor& compositor, LLColor4& color)
+{
+	if (!mTexLayer)
+	{
+		return TRUE;
+	}
+
+	F32 effective_weight = (mTexLayer->getTexLayerSet()->getAvatar()->getSex() & getSex()) ? mCurWeight : getDefaultWeight();
+	BOOL weight_changed = effective_weight != mCachedEffectiveWeight;
+	if (getSkip())
+	{
+		return TRUE;
+	}
+
+	LLTexLayerParamAlphaInfo *info = (LLTexLayerParamAlphaInfo *)getInfo();
+	LLTexLayerCompositor::EBlend blend = info->mMultiplyBlend ? LLTexLayerCompositor::BLEND_MULT_ALPHA : LLTexLayerCompositor::BLEND_ADD;
+
+	if (!info->mStaticImageFileName.empty() && !mStaticImageInvalid)
+	{
+		if (mStaticImageTGA.isNull())
+		{
+			mStaticImageTGA = LLTexLayerStaticImageList::getInstance()->getImageTGA(info->mStaticImageFileName);  
+			LLTexLayerSet::sHasCaches |= mStaticImageTGA.notNull() ? TRUE : FALSE;
+
+			if (mStaticImageTGA.isNull())
+			{
+				llwarns << "Unable to load static file: " << info->mStaticImageFileName << llendl;
+				mStaticImageInvalid = TRUE; // don't try again.
+				return FALSE;
+			}
+		}
+
+		if (mStaticImageRaw.isNull() || weight_changed)
+		{
+			// render() picks the new data up through mNeedsCreateTexture
+			mCachedEffectiveWeight = effective_weight;
+			mStaticImageRaw = new LLImageRaw;
+			mStaticImageTGA->decodeAndProcess(mStaticImageRaw, info->mDomain, effective_weight);
+			mNeedsCreateTexture = TRUE;
+		}
+
+		if (!mStaticImageRaw->getData())
+		{
+			return FALSE;
+		}
+
+		// The processed image is an alpha texture
+		compositor.draw(mStaticImageRaw->getData(), mStaticImageRaw->getWidth(), mStaticImageRaw->getHeight(),
+						mStaticImageRaw->getComponents(), TRUE, color, blend, TRUE, FALSE);
+	}
+	else
+	{
+		color.setVec(0.f, 0.f, 0.f, effective_weight);
+		compositor.fill(color, blend, TRUE);
+	}
+
+	return TRUE;
+}
+
 //-----------------------------------------------------------------------------
 // LLTexLayerParamAlphaInfo
 //-----------------------------------------------------------------------------
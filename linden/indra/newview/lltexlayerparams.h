@@ -32,6 +32,7 @@
 class LLImageRaw;
 class LLImageTGA;
 class LLTexLayer;
+class LLTexLayerCompositor;
 class LLTexLayerInterface;
 class LLViewerTexture;
 class LLVOAvatar;
@@ -84,6 +85,7 @@ public:
 
 	// New functions
 	BOOL					render( S32 x, S32 y, S32 width, S32 height );
+	BOOL					composite(LLTexLayerCompositor& compositor, LLColor4& color); // Same as render(), color is the current GL color
 	BOOL					getSkip() const;
 	void					deleteCaches();
 	BOOL					getMultiplyBlend() const;
@@ -44,6 +44,8 @@
 //  First TEXTURE_CACHE_ENTRY_SIZE bytes of each texture in texture.entries in same order
 // cache/textures/[0-F]/UUID.texture
 //  Actual texture body files
+// cache/textures/[0-F]/UUID.dxt
+//  Block compressed mips of the texture, written after decoding
 
 //note: there is no good to define 1024 for TEXTURE_CACHE_ENTRY_SIZE while FIRST_PACKET_SIZE is 600 on sim side.
 const S32 TEXTURE_CACHE_ENTRY_SIZE = FIRST_PACKET_SIZE;//1024;
@@ -113,7 +115,7 @@ public:
 	~LLTextureCacheWorker()
 	{
 		llassert_always(!haveWork());
-		delete[] mReadData;
+		LLImageBase::deleteMemory(mReadData);
 	}
 
 	// override this interface
@@ -215,7 +217,7 @@ bool LLTextureCacheLocalFileWorker::doRead()
 			mDataSize = 0;
 			return true;
 		}
-		mReadData = new U8[mDataSize];
+		mReadData = LLImageBase::allocateMemory(mDataSize, LLMemType::MTYPE_IMAGEFORMATTED);
 		mBytesRead = -1;
 		mBytesToRead = mDataSize;
 		setPriority(LLWorkerThread::PRIORITY_LOW | mPriority);
@@ -233,7 +235,7 @@ bool LLTextureCacheLocalFileWorker::doRead()
 // 						<< " Bytes: " << mDataSize << " Offset: " << mOffset
 // 						<< " / " << mDataSize << llendl;
 				mDataSize = 0; // failed
-				delete[] mReadData;
+				LLImageBase::deleteMemory(mReadData);
 				mReadData = NULL;
 			}
 			return true;
@@ -248,7 +250,7 @@ bool LLTextureCacheLocalFileWorker::doRead()
 	{
 		mDataSize = local_size;
 	}
-	mReadData = new U8[mDataSize];
+	mReadData = LLImageBase::allocateMemory(mDataSize, LLMemType::MTYPE_IMAGEFORMATTED);
 	
 	S32 bytes_read = LLAPRFile::readEx(mFileName, mReadData, mOffset, mDataSize, mCache->getLocalAPRFilePool());	
 
@@ -258,7 +260,7 @@ bool LLTextureCacheLocalFileWorker::doRead()
 // 				<< " Bytes: " << mDataSize << " Offset: " << mOffset
 // 				<< " / " << mDataSize << llendl;
 		mDataSize = 0;
-		delete[] mReadData;
+		LLImageBase::deleteMemory(mReadData);
 		mReadData = NULL;
 	}
 	else
@@ -272,8 +274,20 @@ bool LLTextureCacheLocalFileWorker::doRead()
 
 bool LLTextureCacheLocalFileWorker::doWrite()
 {
-	// no writes for local files
-	return false;
+	// Only the compressed copies in our own cache get written, whole
+	LLVolatileAPRPool* pool = mCache->getLocalAPRFilePool();
+	if (LLAPRFile::isExist(mFileName, pool))
+	{
+		LLAPRFile::remove(mFileName, pool);
+	}
+	S32 bytes_written = LLAPRFile::writeEx(mFileName, mWriteData, 0, mDataSize, pool);
+	if (bytes_written != mDataSize)
+	{
+		// a short file would read back as a smaller mip, not as an error
+		LLAPRFile::remove(mFileName, pool);
+		mDataSize = 0;
+	}
+	return true;
 }
 
 class LLTextureCacheRemoteWorker : public LLTextureCacheWorker
@@ -371,7 +385,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 			mDataSize = local_size;
 		}
 		// Allocate read buffer
-		mReadData = new U8[mDataSize];
+		mReadData = LLImageBase::allocateMemory(mDataSize, LLMemType::MTYPE_IMAGEFORMATTED);
 		S32 bytes_read = LLAPRFile::readEx(local_filename, 
 											 mReadData, mOffset, mDataSize, mCache->getLocalAPRFilePool());
 		if (bytes_read != mDataSize)
@@ -380,7 +394,7 @@ bool LLTextureCacheRemoteWorker::doRead()
  					<< " Bytes: " << mDataSize << " Offset: " << mOffset
  					<< " / " << mDataSize << llendl;
 			mDataSize = 0;
-			delete[] mReadData;
+			LLImageBase::deleteMemory(mReadData);
 			mReadData = NULL;
 		}
 		else
@@ -423,7 +437,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 		S32 size = TEXTURE_CACHE_ENTRY_SIZE - mOffset;
 		size = llmin(size, mDataSize);
 		// Allocate the read buffer
-		mReadData = new U8[size];
+		mReadData = LLImageBase::allocateMemory(size, LLMemType::MTYPE_IMAGEFORMATTED);
 		S32 bytes_read = LLAPRFile::readEx(mCache->mHeaderDataFileName, 
 											 mReadData, offset, size, mCache->getLocalAPRFilePool());
 		if (bytes_read != size)
@@ -431,7 +445,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 			llwarns << "LLTextureCacheWorker: "  << mID
 					<< " incorrect number of bytes read from header: " << bytes_read
 					<< " / " << size << llendl;
-			delete[] mReadData;
+			LLImageBase::deleteMemory(mReadData);
 			mReadData = NULL;
 			mDataSize = -1; // failed
 			done = true;
@@ -461,7 +475,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 			S32 data_offset, file_size, file_offset;
 			
 			// Reserve the whole data buffer first
-			U8* data = new U8[mDataSize];
+			U8* data = LLImageBase::allocateMemory(mDataSize, LLMemType::MTYPE_IMAGEFORMATTED);
 
 			// Set the data file pointers taking the read offset into account. 2 cases:
 			if (mOffset < TEXTURE_CACHE_ENTRY_SIZE)
@@ -474,7 +488,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 				// Copy the raw data we've been holding from the header cache into the new sized buffer
 				llassert_always(mReadData);
 				memcpy(data, mReadData, data_offset);
-				delete[] mReadData;
+				LLImageBase::deleteMemory(mReadData);
 				mReadData = NULL;
 			}
 			else
@@ -500,7 +514,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 				llwarns << "LLTextureCacheWorker: "  << mID
 						<< " incorrect number of bytes read from body: " << bytes_read
 						<< " / " << file_size << llendl;
-				delete[] mReadData;
+				LLImageBase::deleteMemory(mReadData);
 				mReadData = NULL;
 				mDataSize = -1; // failed
 				done = true;
@@ -692,7 +706,7 @@ void LLTextureCacheWorker::finishWork(S32 param, bool completed)
 			}
 			else
 			{
-				delete[] mReadData;
+				LLImageBase::deleteMemory(mReadData);
 				mReadData = NULL;
 			}
 		}
@@ -732,11 +746,11 @@ void LLTextureCacheWorker::endWork(S32 param, bool aborted)
 
 //////////////////////////////////////////////////////////////////////////////
 
-LLTextureCache::LLTextureCache(bool threaded)
-	: LLWorkerThread("TextureCache", threaded),
-	  mWorkersMutex(NULL),
-	  mHeaderMutex(NULL),
-	  mListMutex(NULL),
+LLTextureCache::LLTextureCache(bool threaded, LLTaskScheduler* scheduler)
+	: LLWorkerThread("TextureCache", threaded, scheduler),
+	  mWorkersMutex(NULL, "LLTextureCache::mWorkersMutex"),
+	  mHeaderMutex(NULL, "LLTextureCache::mHeaderMutex"),
+	  mListMutex(NULL, "LLTextureCache::mListMutex"),
 	  mHeaderAPRFile(NULL),
 	  mReadOnly(TRUE), //do not allow to change the texture cache until setReadOnly() is called.
 	  mTexturesSizeTotal(0),
@@ -821,6 +835,14 @@ std::string LLTextureCache::getTextureFileName(const LLUUID& id)
 	return filename;
 }
 
+std::string LLTextureCache::getCompressedFileName(const LLUUID& id)
+{
+	std::string idstr = id.asString();
+	std::string delem = gDirUtilp->getDirDelimiter();
+	std::string filename = mTexturesDirName + delem + idstr[0] + delem + idstr + ".dxt";
+	return filename;
+}
+
 //debug
 BOOL LLTextureCache::isInCache(const LLUUID& id) 
 {
@@ -1752,6 +1774,12 @@ LLTextureCache::handle_t LLTextureCache::readFromCache(const LLUUID& id, U32 pri
 }
 
 
+LLTextureCache::handle_t LLTextureCache::readCompressedFromCache(const LLUUID& id, U32 priority,
+																 ReadResponder* responder)
+{
+	return readFromCache(getCompressedFileName(id), id, priority, 0, 0, responder);
+}
+
 bool LLTextureCache::readComplete(handle_t handle, bool abort)
 {
 	lockWorkers();
@@ -1807,6 +1835,23 @@ LLTextureCache::handle_t LLTextureCache::writeToCache(const LLUUID& id, U32 prio
 	return handle;
 }
 
+LLTextureCache::handle_t LLTextureCache::writeCompressedToCache(const LLUUID& id, U32 priority,
+																U8* data, S32 datasize,
+																WriteResponder* responder)
+{
+	if (mReadOnly)
+	{
+		delete responder;
+		return LLWorkerThread::nullHandle();
+	}
+	LLMutexLock lock(&mWorkersMutex);
+	LLTextureCacheWorker* worker = new LLTextureCacheLocalFileWorker(this, priority, getCompressedFileName(id), id,
+																	 data, datasize, 0, 0, responder);
+	handle_t handle = worker->write();
+	mWriters[handle] = worker;
+	return handle;
+}
+
 bool LLTextureCache::writeComplete(handle_t handle, bool abort)
 {
 	lockWorkers();
@@ -1853,6 +1898,16 @@ void LLTextureCache::removeCachedTexture(const LLUUID& id)
 	}
 	mHeaderIDMap.erase(id);
 	LLAPRFile::remove(getTextureFileName(id), getLocalAPRFilePool());		
+	removeCompressedTexture(id);
+}
+
+void LLTextureCache::removeCompressedTexture(const LLUUID& id)
+{
+	std::string filename = getCompressedFileName(id);
+	if (LLAPRFile::isExist(filename, getLocalAPRFilePool()))
+	{
+		LLAPRFile::remove(filename, getLocalAPRFilePool());
+	}
 }
 
 //called after mHeaderMutex is locked.
@@ -1867,6 +1922,7 @@ void LLTextureCache::removeEntry(S32 idx, Entry& entry, std::string& filename)
 
 		mTexturesSizeTotal -= entry.mBodySize;
 		mFreeList.insert(idx);	
+		removeCompressedTexture(entry.mID);
 	}
 
 	LLAPRFile::remove(filename, getLocalAPRFilePool());		
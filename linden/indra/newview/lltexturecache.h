@@ -98,7 +98,7 @@ public:
 		}
 	};
 	
-	LLTextureCache(bool threaded);
+	LLTextureCache(bool threaded, LLTaskScheduler* scheduler = NULL);
 	~LLTextureCache();
 
 	/*virtual*/ S32 update(U32 max_time_ms);	
@@ -118,6 +118,12 @@ public:
 	bool writeComplete(handle_t handle, bool abort = false);
 	void prioritizeWrite(handle_t handle);
 
+	// Block compressed copies of textures, kept beside their bodies and
+	// removed along with them.  Complete with readComplete()/writeComplete().
+	handle_t readCompressedFromCache(const LLUUID& id, U32 priority, ReadResponder* responder);
+	handle_t writeCompressedToCache(const LLUUID& id, U32 priority, U8* data, S32 datasize,
+									WriteResponder* responder);
+
 	bool removeFromCache(const LLUUID& id);
 
 	// For LLTextureCacheWorker::Responder
@@ -140,6 +146,7 @@ protected:
 	// Accessed by LLTextureCacheWorker
 	std::string getLocalFileName(const LLUUID& id);
 	std::string getTextureFileName(const LLUUID& id);
+	std::string getCompressedFileName(const LLUUID& id);
 	void addCompleted(Responder* responder, bool success);
 	
 protected:
@@ -164,6 +171,7 @@ private:
 	void writeEntryToHeaderImmediately(S32& idx, Entry& entry, bool write_header = false) ;
 	void removeEntry(S32 idx, Entry& entry, std::string& filename);
 	void removeCachedTexture(const LLUUID& id) ;
+	void removeCompressedTexture(const LLUUID& id);
 	S32 getHeaderCacheEntry(const LLUUID& id, Entry& entry);
 	S32 setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imagesize, S32 datasize);
 	void writeUpdatedEntries() ;
@@ -37,7 +37,9 @@
 #include "llhttpclient.h"
 #include "llhttpstatuscodes.h"
 #include "llimage.h"
+#include "llimagedxt.h"
 #include "llimagej2c.h"
+#include "llimagegl.h"
 #include "llimageworker.h"
 #include "llworkerthread.h"
 #include "message.h"
@@ -183,6 +185,8 @@ private:
 	void removeFromCache();
 	bool processSimulatorPackets();
 	bool writeToCacheComplete();
+	bool useCompressedFromCache();
+	bool writeCompressedToCache();
 	
 	void lockWorkMutex() { mWorkMutex.lock(); }
 	void unlockWorkMutex() { mWorkMutex.unlock(); }
@@ -224,6 +228,7 @@ private:
 	LLPointer<LLImageFormatted> mFormattedImage;
 	LLPointer<LLImageRaw> mRawImage;
 	LLPointer<LLImageRaw> mAuxImage;
+	LLPointer<LLImageGLPrepared> mPreparedImage;
 	LLUUID mID;
 	LLHost mHost;
 	std::string mUrl;
@@ -256,6 +261,11 @@ private:
 	BOOL mInLocalCache;
 	bool mCanUseHTTP ;
 	bool mCanUseNET ; //can get from asset server.
+	BOOL mCanCompress; // may be kept block compressed, see callbackDecoded()
+	BOOL mTriedCompressed;
+	BOOL mReadingCompressed;
+	BOOL mCompressedWriteIssued;
+	LLPointer<LLImageDXT> mCompressedImage; // waiting to be written to the cache
 	S32 mHTTPFailCount;
 	S32 mRetryAttempt;
 	S32 mActiveCount;
@@ -415,11 +425,15 @@ LLTextureFetchWorker::LLTextureFetchWorker(LLTextureFetch* fetcher,
 	  mHaveAllData(FALSE),
 	  mInLocalCache(FALSE),
 	  mCanUseHTTP(true),
+	  mCanCompress(FALSE),
+	  mTriedCompressed(FALSE),
+	  mReadingCompressed(FALSE),
+	  mCompressedWriteIssued(FALSE),
 	  mHTTPFailCount(0),
 	  mRetryAttempt(0),
 	  mActiveCount(0),
 	  mGetStatus(0),
-	  mWorkMutex(NULL),
+	  mWorkMutex(NULL, "LLTextureFetchWorker::mWorkMutex"),
 	  mFirstPacket(0),
 	  mLastPacket(-1),
 	  mTotalPackets(0),
@@ -579,9 +593,12 @@ void LLTextureFetchWorker::startWork(S32 param)
 
 #include "llviewertexturelist.h" // debug
 
+static LLFastTimer::DeclareTimer FTM_TEXTURE_FETCH_WORK("Texture Fetch Work");
+
 // Called from LLWorkerThread::processRequest()
 bool LLTextureFetchWorker::doWork(S32 param)
 {
+	LLFastTimer t(FTM_TEXTURE_FETCH_WORK);
 	LLMutexLock lock(&mWorkMutex);
 
 	if ((mFetcher->isQuitting() || getFlags(LLWorkerClass::WCF_DELETE_REQUESTED)))
@@ -621,6 +638,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 	if (mState == INIT)
 	{		
 		mRawImage = NULL ;
+		mPreparedImage = NULL;
 		mRequestedDiscard = -1;
 		mLoadedDiscard = -1;
 		mDecodedDiscard = -1;
@@ -638,6 +656,20 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		clearPackets(); // TODO: Shouldn't be necessary
 		mCacheReadHandle = LLTextureCache::nullHandle();
 		mCacheWriteHandle = LLTextureCache::nullHandle();
+		mCompressedImage = NULL;
+		mCompressedWriteIssued = FALSE;
+		if (mFormattedImage.notNull() && mFormattedImage->getCodec() == IMG_CODEC_DXT)
+		{
+			// the compressed copy only ever gets us started, more data comes from the j2c
+			mFormattedImage = NULL;
+		}
+		mReadingCompressed = FALSE;
+		if (mCanCompress && !mTriedCompressed && mFormattedImage.isNull() &&
+			mUrl.compare(0, 7, "file://") != 0)
+		{
+			mReadingCompressed = TRUE;
+			mTriedCompressed = TRUE;
+		}
 		mState = LOAD_FROM_TEXTURE_CACHE;
 		mDesiredSize = llmax(mDesiredSize, TEXTURE_CACHE_ENTRY_SIZE); // min desired size is TEXTURE_CACHE_ENTRY_SIZE
 		LL_DEBUGS("Texture") << mID << ": Priority: " << llformat("%8.0f",mImagePriority)
@@ -647,7 +679,15 @@ bool LLTextureFetchWorker::doWork(S32 param)
 
 	if (mState == LOAD_FROM_TEXTURE_CACHE)
 	{
-		if (mCacheReadHandle == LLTextureCache::nullHandle())
+		if (mReadingCompressed && mCacheReadHandle == LLTextureCache::nullHandle())
+		{
+			mFileSize = 0;
+			mLoaded = FALSE;
+			setPriority(LLWorkerThread::PRIORITY_LOW | mWorkPriority); // Set priority first since Responder may change it
+			CacheReadResponder* responder = new CacheReadResponder(mFetcher, mID, NULL);
+			mCacheReadHandle = mFetcher->mTextureCache->readCompressedFromCache(mID, mWorkPriority, responder);
+		}
+		else if (mCacheReadHandle == LLTextureCache::nullHandle())
 		{
 			U32 cache_priority = mWorkPriority;
 			S32 offset = mFormattedImage.notNull() ? mFormattedImage->getDataSize() : 0;
@@ -701,6 +741,22 @@ bool LLTextureFetchWorker::doWork(S32 param)
 			if (mFetcher->mTextureCache->readComplete(mCacheReadHandle, false))
 			{
 				mCacheReadHandle = LLTextureCache::nullHandle();
+				if (mReadingCompressed)
+				{
+					mReadingCompressed = FALSE;
+					if (useCompressedFromCache())
+					{
+						mState = DECODE_IMAGE;
+						return false;
+					}
+					// not there or not enough of it, go on to the j2c
+					mFormattedImage = NULL;
+					mFileSize = 0;
+					mHaveAllData = FALSE;
+					mInLocalCache = FALSE;
+					mLoaded = FALSE;
+					return false;
+				}
 				mState = CACHE_POST;
 				// fall through
 			}
@@ -1014,7 +1070,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 				mFileSize = mBufferSize + 1 ; //flag the file is not fully loaded.
 			}
 			
-			U8* buffer = new U8[mBufferSize];
+			U8* buffer = LLImageBase::allocateMemory(mBufferSize, LLMemType::MTYPE_IMAGEFORMATTED);
 			if (cur_size > 0)
 			{
 				memcpy(buffer, mFormattedImage->getData(), cur_size);
@@ -1082,6 +1138,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		setPriority(LLWorkerThread::PRIORITY_LOW | mWorkPriority); // Set priority first since Responder may change it
 		mRawImage = NULL;
 		mAuxImage = NULL;
+		mPreparedImage = NULL;
 		llassert_always(mFormattedImage.notNull());
 		S32 discard = mHaveAllData ? 0 : mLoadedDiscard;
 		U32 image_priority = LLWorkerThread::PRIORITY_NORMAL | mWorkPriority;
@@ -1101,7 +1158,16 @@ bool LLTextureFetchWorker::doWork(S32 param)
 			if (mDecodedDiscard < 0)
 			{
 				LL_DEBUGS("Texture") << mID << ": Failed to Decode." << LL_ENDL;
-				if (mCachedSize > 0 && !mInLocalCache && mRetryAttempt == 0)
+				if (mFormattedImage->getCodec() == IMG_CODEC_DXT)
+				{
+					// bad compressed copy, fetch the j2c instead
+					llassert_always(mDecodeHandle == 0);
+					mFormattedImage = NULL;
+					setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
+					mState = INIT;
+					return false;
+				}
+				else if (mCachedSize > 0 && !mInLocalCache && mRetryAttempt == 0)
 				{
 					// Cache file should be deleted, try again
 // 					llwarns << mID << ": Decode of cached file failed (removed), retrying" << llendl;
@@ -1140,7 +1206,10 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		{
 			// If we're in a local cache or we didn't actually receive any new data,
 			// or we failed to load anything, skip
-			mState = DONE;
+			if (!writeCompressedToCache())
+			{
+				mState = DONE;
+			}
 			return false;
 		}
 		S32 datasize = mFormattedImage->getDataSize();
@@ -1171,6 +1240,11 @@ bool LLTextureFetchWorker::doWork(S32 param)
 	{
 		if (writeToCacheComplete())
 		{
+			if (writeCompressedToCache())
+			{
+				return false;
+			}
+			mCompressedImage = NULL;
 			mState = DONE;
 			// fall through
 		}
@@ -1320,7 +1394,7 @@ bool LLTextureFetchWorker::processSimulatorPackets()
 			if (buffer_size > cur_size)
 			{
 				/// We have new data
-				U8* buffer = new U8[buffer_size];
+				U8* buffer = LLImageBase::allocateMemory(buffer_size, LLMemType::MTYPE_IMAGEFORMATTED);
 				S32 offset = 0;
 				if (cur_size > 0 && mFirstPacket > 0)
 				{
@@ -1450,6 +1524,34 @@ void LLTextureFetchWorker::callbackCacheWrite(bool success)
 
 void LLTextureFetchWorker::callbackDecoded(bool success, LLImageRaw* raw, LLImageRaw* aux)
 {
+	// Still on the decode thread, so do the CPU side of the GL upload here
+	// too, before taking the lock the main thread polls us with.
+	// Textures that can stay block compressed are squeezed here as well, the
+	// GL copy and the one the cache keeps are both made from it.
+	LLPointer<LLImageGLPrepared> prepared;
+	LLPointer<LLImageDXT> compressed;
+	if (success && raw)
+	{
+		LLImageFormatted* formatted = mFormattedImage.get();
+		if (formatted && formatted->getCodec() == IMG_CODEC_DXT)
+		{
+			prepared = new LLImageGLPrepared(raw, (LLImageDXT*)formatted);
+		}
+		else
+		{
+			if (mCanCompress && formatted && formatted->getCodec() == IMG_CODEC_J2C)
+			{
+				compressed = new LLImageDXT();
+				if (!compressed->encodeCompressed(raw, formatted->getWidth(), formatted->getHeight(),
+												  formatted->getDiscardLevel()))
+				{
+					compressed = NULL;
+				}
+			}
+			prepared = new LLImageGLPrepared(raw, compressed);
+		}
+	}
+
 	LLMutexLock lock(&mWorkMutex);
 	if (mDecodeHandle == 0)
 	{
@@ -1469,6 +1571,8 @@ void LLTextureFetchWorker::callbackDecoded(bool success, LLImageRaw* raw, LLImag
 		llassert_always(raw);
 		mRawImage = raw;
 		mAuxImage = aux;
+		mPreparedImage = prepared;
+		mCompressedImage = compressed;
 		mDecodedDiscard = mFormattedImage->getDiscardLevel();
  		LL_DEBUGS("Texture") << mID << ": Decode Finished. Discard: " << mDecodedDiscard
 							 << " Raw Image: " << llformat("%dx%d",mRawImage->getWidth(),mRawImage->getHeight()) << LL_ENDL;
@@ -1476,7 +1580,10 @@ void LLTextureFetchWorker::callbackDecoded(bool success, LLImageRaw* raw, LLImag
 	else
 	{
 		llwarns << "DECODE FAILED: " << mID << " Discard: " << (S32)mFormattedImage->getDiscardLevel() << llendl;
-		removeFromCache();
+		if (mFormattedImage->getCodec() != IMG_CODEC_DXT)
+		{
+			removeFromCache();
+		}
 		mDecodedDiscard = -1; // Redundant, here for clarity and paranoia
 	}
 	mDecoded = TRUE;
@@ -1507,19 +1614,77 @@ bool LLTextureFetchWorker::writeToCacheComplete()
 	return true;
 }
 
+// Takes the block compressed copy the cache just read if it holds the discard
+// we want, so it can be decoded without touching the j2c.
+bool LLTextureFetchWorker::useCompressedFromCache()
+{
+	if (mFormattedImage.isNull() || mFormattedImage->getCodec() != IMG_CODEC_DXT ||
+		!mFormattedImage->updateData())
+	{
+		return false;
+	}
+	S32 discard = mFormattedImage->getDiscardLevel();
+	S32 width = mFormattedImage->getWidth() >> discard;
+	S32 height = mFormattedImage->getHeight() >> discard;
+	if (mDesiredDiscard < 0 || discard > mDesiredDiscard || width < 4 || height < 4)
+	{
+		return false;
+	}
+	// the finest level it has might be more than was asked for
+	while (discard < mDesiredDiscard && width >= 8 && height >= 8)
+	{
+		discard++;
+		width >>= 1;
+		height >>= 1;
+	}
+	LL_DEBUGS("Texture") << mID << ": Compressed copy cached. Bytes: " << mFormattedImage->getDataSize()
+						 << " Discard: " << discard << LL_ENDL;
+	mLoadedDiscard = discard;
+	mHaveAllData = FALSE;
+	mInLocalCache = FALSE;
+	mWriteToCacheState = NOT_WRITE;
+	return true;
+}
+
+// Starts writing the compressed copy made in callbackDecoded(), if there is
+// one.  Returns false when there is nothing (more) to write.
+bool LLTextureFetchWorker::writeCompressedToCache()
+{
+	if (mCompressedImage.isNull() || mCompressedWriteIssued)
+	{
+		return false;
+	}
+	mCompressedWriteIssued = TRUE;
+	setPriority(LLWorkerThread::PRIORITY_LOW | mWorkPriority); // Set priority first since Responder may change it
+	mWritten = FALSE;
+	mState = WAIT_ON_WRITE;
+	CacheWriteResponder* responder = new CacheWriteResponder(mFetcher, mID);
+	mCacheWriteHandle = mFetcher->mTextureCache->writeCompressedToCache(mID, mWorkPriority,
+																		 mCompressedImage->getData(),
+																		 mCompressedImage->getDataSize(),
+																		 responder);
+	if (mCacheWriteHandle == LLTextureCache::nullHandle())
+	{
+		// read only cache
+		mCompressedImage = NULL;
+		mState = DONE;
+	}
+	return true;
+}
+
 
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 // public
 
-LLTextureFetch::LLTextureFetch(LLTextureCache* cache, LLImageDecodeThread* imagedecodethread, bool threaded)
-	: LLWorkerThread("TextureFetch", threaded),
+LLTextureFetch::LLTextureFetch(LLTextureCache* cache, LLImageDecodeThread* imagedecodethread, bool threaded, LLTaskScheduler* scheduler)
+	: LLWorkerThread("TextureFetch", threaded, scheduler),
 	  mDebugCount(0),
 	  mDebugPause(FALSE),
 	  mPacketCount(0),
 	  mBadPacketCount(0),
-	  mQueueMutex(getAPRPool()),
-	  mNetworkQueueMutex(getAPRPool()),
+	  mQueueMutex(getAPRPool(), "LLTextureFetch::mQueueMutex"),
+	  mNetworkQueueMutex(getAPRPool(), "LLTextureFetch::mNetworkQueueMutex"),
 	  mTextureCache(cache),
 	  mImageDecodeThread(imagedecodethread),
 	  mTextureBandwidth(0),
@@ -1538,7 +1703,8 @@ LLTextureFetch::~LLTextureFetch()
 }
 
 bool LLTextureFetch::createRequest(const std::string& url, const LLUUID& id, const LLHost& host, F32 priority,
-								   S32 w, S32 h, S32 c, S32 desired_discard, bool needs_aux, bool can_use_http)
+								   S32 w, S32 h, S32 c, S32 desired_discard, bool needs_aux, bool can_use_http,
+								   bool can_compress)
 {
 	if (mDebugPause)
 	{
@@ -1601,6 +1767,7 @@ bool LLTextureFetch::createRequest(const std::string& url, const LLUUID& id, con
 		worker->setImagePriority(priority);
 		worker->setDesiredDiscard(desired_discard, desired_size);
 		worker->setCanUseHTTP(can_use_http) ;
+		worker->mCanCompress = can_compress;
 		if (!worker->haveWork())
 		{
 			worker->mState = LLTextureFetchWorker::INIT;
@@ -1624,6 +1791,7 @@ bool LLTextureFetch::createRequest(const std::string& url, const LLUUID& id, con
 		worker->mActiveCount++;
 		worker->mNeedsAux = needs_aux;
 		worker->setCanUseHTTP(can_use_http) ;
+		worker->mCanCompress = can_compress;
 		worker->unlockWorkMutex();
 	}
 	
@@ -1750,7 +1918,8 @@ LLTextureFetchWorker* LLTextureFetch::getWorker(const LLUUID& id)
 
 
 bool LLTextureFetch::getRequestFinished(const LLUUID& id, S32& discard_level,
-										LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux)
+										LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux,
+										LLPointer<LLImageGLPrepared>& prepared)
 {
 	bool res = false;
 	LLTextureFetchWorker* worker = getWorker(id);
@@ -1775,6 +1944,7 @@ bool LLTextureFetch::getRequestFinished(const LLUUID& id, S32& discard_level,
 			discard_level = worker->mDecodedDiscard;
 			raw = worker->mRawImage;
 			aux = worker->mAuxImage;
+			prepared = worker->mPreparedImage;
 			res = true;
 			LL_DEBUGS("Texture") << id << ": Request Finished. State: " << worker->mState << " Discard: " << discard_level << LL_ENDL;
 			worker->unlockWorkMutex();
@@ -1790,6 +1960,7 @@ bool LLTextureFetch::getRequestFinished(const LLUUID& id, S32& discard_level,
 				discard_level = worker->mDecodedDiscard;
 				raw = worker->mRawImage;
 				aux = worker->mAuxImage;
+				prepared = worker->mPreparedImage;
 			}
 			worker->unlockWorkMutex();
 		}
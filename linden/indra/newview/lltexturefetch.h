@@ -30,6 +30,7 @@
 #include "lldir.h"
 #include "llimage.h"
 #include "lluuid.h"
+#include "lluuidflatmap.h"
 #include "llworkerthread.h"
 #include "llcurl.h"
 #include "lltextureinfo.h"
@@ -39,6 +40,7 @@ class LLTextureFetchWorker;
 class HTTPGetResponder;
 class LLTextureCache;
 class LLImageDecodeThread;
+class LLImageGLPrepared;
 class LLHost;
 
 // Interface class
@@ -48,7 +50,7 @@ class LLTextureFetch : public LLWorkerThread
 	friend class HTTPGetResponder;
 	
 public:
-	LLTextureFetch(LLTextureCache* cache, LLImageDecodeThread* imagedecodethread, bool threaded);
+	LLTextureFetch(LLTextureCache* cache, LLImageDecodeThread* imagedecodethread, bool threaded, LLTaskScheduler* scheduler = NULL);
 	~LLTextureFetch();
 
 	/*virtual*/ S32 update(U32 max_time_ms);	
@@ -56,10 +58,13 @@ public:
 	void shutDownImageDecodeThread() ;  //called in the main thread after the ImageDecodeThread shuts down.
 
 	bool createRequest(const std::string& url, const LLUUID& id, const LLHost& host, F32 priority,
-					   S32 w, S32 h, S32 c, S32 discard, bool needs_aux, bool can_use_http);
+					   S32 w, S32 h, S32 c, S32 discard, bool needs_aux, bool can_use_http,
+					   bool can_compress = false);
 	void deleteRequest(const LLUUID& id, bool cancel);
+	// prepared is set along with raw when the decoder got it ready for upload
 	bool getRequestFinished(const LLUUID& id, S32& discard_level,
-							LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux);
+							LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux,
+							LLPointer<LLImageGLPrepared>& prepared);
 	bool updateRequestPriority(const LLUUID& id, F32 priority);
 
 	bool receiveImageHeader(const LLHost& host, const LLUUID& id, U8 codec, U16 packets, U32 totalbytes, U16 data_size, U8* data);
@@ -115,7 +120,7 @@ private:
 	LLCurlRequest* mCurlGetRequest;
 	
 	// Map of all requests by UUID
-	typedef std::map<LLUUID,LLTextureFetchWorker*> map_t;
+	typedef LLUUIDFlatMap<LLTextureFetchWorker*> map_t;
 	map_t mRequestMap;
 
 	// Set of requests that require network data
@@ -365,6 +365,39 @@ static bool handleDebugViewsChanged(const LLSD& newvalue)
 	return true;
 }
 
+static bool handleMutexProfilingChanged(const LLSD& newvalue)
+{
+	LLMutex::setProfiling(newvalue.asBoolean());
+	return true;
+}
+
+static bool handleFastTimerTraceRecordingChanged(const LLSD& newvalue)
+{
+	if (newvalue.asBoolean())
+	{
+		LLFastTimer::startRecording(gSavedSettings.getU32("FastTimerTraceBufferEvents"));
+	}
+	else
+	{
+		LLFastTimer::stopRecording();
+	}
+	return true;
+}
+
+static bool handleFastTimerTraceSpikeChanged(const LLSD&)
+{
+	LLFastTimer::setSpikeCapture(gSavedSettings.getF32("FastTimerTraceSpikeMs"),
+								 gSavedSettings.getF32("FastTimerTraceSeconds"),
+								 gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "timer_spike"));
+	return true;
+}
+
+static bool handleAsyncLoggingChanged(const LLSD& newvalue)
+{
+	LLError::setAsyncLogging(newvalue.asBoolean());
+	return true;
+}
+
 static bool handleLogFileChanged(const LLSD& newvalue)
 {
 	std::string log_filename = newvalue.asString();
@@ -556,6 +589,7 @@ void settings_setup_listeners()
 	gSavedSettings.getControl("MuteUI")->getSignal()->connect(boost::bind(&handleAudioVolumeChanged, _2));
 	gSavedSettings.getControl("RenderVBOEnable")->getSignal()->connect(boost::bind(&handleRenderUseVBOChanged, _2));
 	gSavedSettings.getControl("RenderUseStreamVBO")->getSignal()->connect(boost::bind(&handleResetVertexBuffersChanged, _2));
+	gSavedSettings.getControl("RenderStreamRing")->getSignal()->connect(boost::bind(&handleResetVertexBuffersChanged, _2));
 	gSavedSettings.getControl("WLSkyDetail")->getSignal()->connect(boost::bind(&handleWLSkyDetailChanged, _2));
 	gSavedSettings.getControl("NumpadControl")->getSignal()->connect(boost::bind(&handleNumpadControlChanged, _2));
 	gSavedSettings.getControl("JoystickAxis0")->getSignal()->connect(boost::bind(&handleJoystickChanged, _2));
@@ -605,6 +639,11 @@ void settings_setup_listeners()
 	gSavedSettings.getControl("BuildAxisDeadZone5")->getSignal()->connect(boost::bind(&handleJoystickChanged, _2));
 	gSavedSettings.getControl("DebugViews")->getSignal()->connect(boost::bind(&handleDebugViewsChanged, _2));
 	gSavedSettings.getControl("UserLogFile")->getSignal()->connect(boost::bind(&handleLogFileChanged, _2));
+	gSavedSettings.getControl("MutexProfiling")->getSignal()->connect(boost::bind(&handleMutexProfilingChanged, _2));
+	gSavedSettings.getControl("AsyncLogging")->getSignal()->connect(boost::bind(&handleAsyncLoggingChanged, _2));
+	gSavedSettings.getControl("FastTimerTraceRecording")->getSignal()->connect(boost::bind(&handleFastTimerTraceRecordingChanged, _2));
+	gSavedSettings.getControl("FastTimerTraceSpikeMs")->getSignal()->connect(boost::bind(&handleFastTimerTraceSpikeChanged, _2));
+	gSavedSettings.getControl("FastTimerTraceSeconds")->getSignal()->connect(boost::bind(&handleFastTimerTraceSpikeChanged, _2));
 	gSavedSettings.getControl("RenderHideGroupTitle")->getSignal()->connect(boost::bind(handleHideGroupTitleChanged, _2));
 	gSavedSettings.getControl("HighResSnapshot")->getSignal()->connect(boost::bind(handleHighResSnapshotChanged, _2));
 	gSavedSettings.getControl("VectorizePerfTest")->getSignal()->connect(boost::bind(&handleVectorizeChanged, _2));
@@ -388,6 +388,7 @@ void display(BOOL rebuild, F32 zoom_factor, int subfield, BOOL for_snapshot)
 			gAgent.setTeleportMessage(
 				LLAgent::sTeleportProgressMessages["arriving"]);
 			gTextureList.mForceResetTextureStats = TRUE;
+			gTextureList.startPriorityConvergenceTimer();
 			gAgentCamera.resetView(TRUE, TRUE);
 			break;
 
@@ -123,6 +123,8 @@ public:
 	virtual void updateFaceData(LLFace *face, F32 pixel_area, BOOL damp_wind = FALSE, bool terse_update = false);
 	virtual BOOL updateLOD(F32 pixel_area, BOOL activate);
 	virtual void updateJointGeometry();
+	// adds the meshes updateJointGeometry() would skin on the CPU
+	virtual void getSkinnedMeshes(std::vector<LLViewerJointMesh*>& meshes);
 	virtual void dump();
 
 	void setVisible( BOOL visible, BOOL recursive );
@@ -51,6 +51,7 @@
 #include "llsky.h"
 #include "pipeline.h"
 #include "llviewershadermgr.h"
+#include "llworkpool.h"
 #include "llmath.h"
 #include "v4math.h"
 #include "m3math.h"
@@ -377,31 +378,33 @@ const S32 NUM_AXES = 3;
 
 static LLMatrix4	gJointMatUnaligned[32];
 static LLMatrix3	gJointRotUnaligned[32];
-static LLVector4	gJointPivot[32];
 
 //-----------------------------------------------------------------------------
-// uploadJointMatrices()
+// get_joint_matrices()
+// Skinning matrices for mesh, with the joint pivots folded in.  Only reads
+// the joints, so it is safe to call from any thread once the skeleton has
+// been updated.
 //-----------------------------------------------------------------------------
-void LLViewerJointMesh::uploadJointMatrices()
+static void get_joint_matrices(LLPolyMesh* mesh, LLMatrix4* joint_mats, LLMatrix3* joint_rots,
+							   const LLMatrix4* model_view)
 {
 	S32 joint_num;
-	LLPolyMesh *reference_mesh = mMesh->getReferenceMesh();
-	LLDrawPool *poolp = mFace ? mFace->getPool() : NULL;
-	BOOL hardware_skinning = (poolp && poolp->getVertexShaderLevel() > 0) ? TRUE : FALSE;
+	LLPolyMesh *reference_mesh = mesh->getReferenceMesh();
 
 	//calculate joint matrices
 	for (joint_num = 0; joint_num < reference_mesh->mJointRenderData.count(); joint_num++)
 	{
 		LLMatrix4 joint_mat = *reference_mesh->mJointRenderData[joint_num]->mWorldMatrix;
 
-		if (hardware_skinning)
+		if (model_view)
 		{
-			joint_mat *= LLDrawPoolAvatar::getModelView();
+			joint_mat *= *model_view;
 		}
-		gJointMatUnaligned[joint_num] = joint_mat;
-		gJointRotUnaligned[joint_num] = joint_mat.getMat3();
+		joint_mats[joint_num] = joint_mat;
+		joint_rots[joint_num] = joint_mat.getMat3();
 	}
 
+	LLVector4 joint_pivots[32];
 	BOOL last_pivot_uploaded = FALSE;
 	S32 j = 0;
 
@@ -415,13 +418,13 @@ void LLViewerJointMesh::uploadJointMatrices()
 			{
 				LLVector4 parent_pivot(sj->mRootToParentJointSkinOffset);
 				parent_pivot.mV[VW] = 0.f;
-				gJointPivot[j++] = parent_pivot;
+				joint_pivots[j++] = parent_pivot;
 			}
 
 			LLVector4 child_pivot(sj->mRootToJointSkinOffset);
 			child_pivot.mV[VW] = 0.f;
 
-			gJointPivot[j++] = child_pivot;
+			joint_pivots[j++] = child_pivot;
 
 			last_pivot_uploaded = TRUE;
 		}
@@ -435,10 +438,24 @@ void LLViewerJointMesh::uploadJointMatrices()
 	for (S32 i = 0; i < j; i++)
 	{
 		LLVector3 pivot;
-		pivot = LLVector3(gJointPivot[i]);
-		pivot = pivot * gJointRotUnaligned[i];
-		gJointMatUnaligned[i].translate(pivot);
+		pivot = LLVector3(joint_pivots[i]);
+		pivot = pivot * joint_rots[i];
+		joint_mats[i].translate(pivot);
 	}
+}
+
+//-----------------------------------------------------------------------------
+// uploadJointMatrices()
+//-----------------------------------------------------------------------------
+void LLViewerJointMesh::uploadJointMatrices()
+{
+	S32 joint_num;
+	LLPolyMesh *reference_mesh = mMesh->getReferenceMesh();
+	LLDrawPool *poolp = mFace ? mFace->getPool() : NULL;
+	BOOL hardware_skinning = (poolp && poolp->getVertexShaderLevel() > 0) ? TRUE : FALSE;
+
+	get_joint_matrices(mMesh, gJointMatUnaligned, gJointRotUnaligned,
+					   hardware_skinning ? &LLDrawPoolAvatar::getModelView() : NULL);
 
 	// upload matrices
 	if (hardware_skinning)
@@ -686,6 +703,8 @@ void LLViewerJointMesh::updateFaceData(LLFace *face, F32 pixel_area, BOOL damp_w
 	{
 		if (mMesh->getNumVertices())
 		{
+			mMesh->updateNormals();
+
 			stop_glerror();
 			face->getGeometryAvatar(verticesp, normalsp, tex_coordsp, vertex_weightsp, clothing_weightsp);
 			stop_glerror();
@@ -800,27 +819,25 @@ BOOL LLViewerJointMesh::updateLOD(F32 pixel_area, BOOL activate)
 }
 
 // static
-void LLViewerJointMesh::updateGeometryOriginal(LLFace *mFace, LLPolyMesh *mMesh)
+void LLViewerJointMesh::updateGeometryOriginal(SkinJob& job)
 {
-	LLStrider<LLVector3> o_vertices;
-	LLStrider<LLVector3> o_normals;
+	LLPolyMesh* mesh = job.mMesh;
+	LLStrider<LLVector3>& o_vertices = job.mVertices;
+	LLStrider<LLVector3>& o_normals = job.mNormals;
 
-	//get vertex and normal striders
-	LLVertexBuffer *buffer = mFace->mVertexBuffer;
-	buffer->getVertexStrider(o_vertices,  0);
-	buffer->getNormalStrider(o_normals,   0);
+	LLMatrix4 joint_mats[32];
+	LLMatrix3 joint_rots[32];
+	get_joint_matrices(mesh, joint_mats, joint_rots, NULL);
 
 	F32 last_weight = F32_MAX;
 	LLMatrix4 gBlendMat;
 	LLMatrix3 gBlendRotMat;
 
-	const F32* weights = mMesh->getWeights();
-	const LLVector3* coords = mMesh->getCoords();
-	const LLVector3* normals = mMesh->getNormals();
-	for (U32 index = 0; index < mMesh->getNumVertices(); index++)
+	const F32* weights = mesh->getWeights();
+	const LLVector3* coords = mesh->getCoords();
+	const LLVector3* normals = mesh->getNormals();
+	for (U32 index = 0; index < mesh->getNumVertices(); index++)
 	{
-		U32 bidx = index + mMesh->mFaceVertexOffset;
-		
 		// blend by first matrix
 		F32 w = weights[index]; 
 		
@@ -829,8 +846,8 @@ void LLViewerJointMesh::updateGeometryOriginal(LLFace *mFace, LLPolyMesh *mMesh)
 		// common case.  JC
 		if (w == last_weight)
 		{
-			o_vertices[bidx] = coords[index] * gBlendMat;
-			o_normals[bidx] = normals[index] * gBlendRotMat;
+			o_vertices[index] = coords[index] * gBlendMat;
+			o_normals[index] = normals[index] * gBlendRotMat;
 			continue;
 		}
 		
@@ -842,18 +859,18 @@ void LLViewerJointMesh::updateGeometryOriginal(LLFace *mFace, LLPolyMesh *mMesh)
 		// No lerp required in this case.
 		if (w == 1.0f)
 		{
-			gBlendMat = gJointMatUnaligned[joint+1];
-			o_vertices[bidx] = coords[index] * gBlendMat;
-			gBlendRotMat = gJointRotUnaligned[joint+1];
-			o_normals[bidx] = normals[index] * gBlendRotMat;
+			gBlendMat = joint_mats[joint+1];
+			o_vertices[index] = coords[index] * gBlendMat;
+			gBlendRotMat = joint_rots[joint+1];
+			o_normals[index] = normals[index] * gBlendRotMat;
 			continue;
 		}
 		
 		// Try to keep all the accesses to the matrix data as close
 		// together as possible.  This function is a hot spot on the
 		// Mac. JC
-		LLMatrix4 &m0 = gJointMatUnaligned[joint+1];
-		LLMatrix4 &m1 = gJointMatUnaligned[joint+0];
+		LLMatrix4 &m0 = joint_mats[joint+1];
+		LLMatrix4 &m1 = joint_mats[joint+0];
 		
 		gBlendMat.mMatrix[VX][VX] = lerp(m1.mMatrix[VX][VX], m0.mMatrix[VX][VX], w);
 		gBlendMat.mMatrix[VX][VY] = lerp(m1.mMatrix[VX][VY], m0.mMatrix[VX][VY], w);
@@ -871,10 +888,10 @@ void LLViewerJointMesh::updateGeometryOriginal(LLFace *mFace, LLPolyMesh *mMesh)
 		gBlendMat.mMatrix[VW][VY] = lerp(m1.mMatrix[VW][VY], m0.mMatrix[VW][VY], w);
 		gBlendMat.mMatrix[VW][VZ] = lerp(m1.mMatrix[VW][VZ], m0.mMatrix[VW][VZ], w);
 
-		o_vertices[bidx] = coords[index] * gBlendMat;
+		o_vertices[index] = coords[index] * gBlendMat;
 		
-		LLMatrix3 &n0 = gJointRotUnaligned[joint+1];
-		LLMatrix3 &n1 = gJointRotUnaligned[joint+0];
+		LLMatrix3 &n0 = joint_rots[joint+1];
+		LLMatrix3 &n1 = joint_rots[joint+0];
 		
 		gBlendRotMat.mMatrix[VX][VX] = lerp(n1.mMatrix[VX][VX], n0.mMatrix[VX][VX], w);
 		gBlendRotMat.mMatrix[VX][VY] = lerp(n1.mMatrix[VX][VY], n0.mMatrix[VX][VY], w);
@@ -888,10 +905,8 @@ void LLViewerJointMesh::updateGeometryOriginal(LLFace *mFace, LLPolyMesh *mMesh)
 		gBlendRotMat.mMatrix[VZ][VY] = lerp(n1.mMatrix[VZ][VY], n0.mMatrix[VZ][VY], w);
 		gBlendRotMat.mMatrix[VZ][VZ] = lerp(n1.mMatrix[VZ][VZ], n0.mMatrix[VZ][VZ], w);
 		
-		o_normals[bidx] = normals[index] * gBlendRotMat;
+		o_normals[index] = normals[index] * gBlendRotMat;
 	}
-
-	buffer->setBuffer(0);
 }
 
 const U32 UPDATE_GEOMETRY_CALL_MASK			= 0x1FFF; // 8K samples before overflow
@@ -910,7 +925,7 @@ static BOOL sVectorizePerfTest 				= FALSE;
 static U32 sVectorizeProcessor 				= 0;
 
 //static
-void (*LLViewerJointMesh::sUpdateGeometryFunc)(LLFace* face, LLPolyMesh* mesh);
+void (*LLViewerJointMesh::sUpdateGeometryFunc)(SkinJob& job);
 
 //static
 void LLViewerJointMesh::updateVectorize()
@@ -951,25 +966,175 @@ void LLViewerJointMesh::updateVectorize()
 	}
 }
 
+BOOL LLViewerJointMesh::needsCPUSkinning()
+{
+	return mValid
+		&& mMesh
+		&& mFace
+		&& mMesh->hasWeights()
+		&& mFace->mVertexBuffer.notNull()
+		&& LLViewerShaderMgr::instance()->getVertexShaderLevel(LLViewerShaderMgr::SHADER_AVATAR) == 0;
+}
+
+void LLViewerJointMesh::prepareSkinJob(SkinJob& job)
+{
+	LLVertexBuffer *buffer = mFace->mVertexBuffer;
+	mMesh->updateNormals();
+	job.mMesh = mMesh;
+	buffer->getVertexStrider(job.mVertices, mMesh->mFaceVertexOffset);
+	buffer->getNormalStrider(job.mNormals, mMesh->mFaceVertexOffset);
+}
+
+void LLViewerJointMesh::getSkinnedMeshes(std::vector<LLViewerJointMesh*>& meshes)
+{
+	if (needsCPUSkinning())
+	{
+		meshes.push_back(this);
+	}
+}
+
+// Skins one mesh per index.
+class LLSkinMeshTask : public LLWorkPool::Task
+{
+public:
+	LLSkinMeshTask(std::vector<LLViewerJointMesh::SkinJob>& jobs,
+				   void (*skin_func)(LLViewerJointMesh::SkinJob&))
+		: mJobs(jobs),
+		  mSkinFunc(skin_func)
+	{
+	}
+
+	/*virtual*/ void run(S32 index)
+	{
+		mSkinFunc(mJobs[index]);
+	}
+
+	std::vector<LLViewerJointMesh::SkinJob>& mJobs;
+	void (*mSkinFunc)(LLViewerJointMesh::SkinJob&);
+};
+
+//static
+void LLViewerJointMesh::skinMeshes(const std::vector<LLViewerJointMesh*>& meshes, LLWorkPool* pool)
+{
+	if (sVectorizePerfTest)
+	{
+		// the startup test times each mesh on its own
+		for (U32 i = 0; i < meshes.size(); i++)
+		{
+			meshes[i]->updateJointGeometry();
+		}
+		return;
+	}
+
+	// mapping touches GL, so do it all up front
+	std::vector<SkinJob> jobs(meshes.size());
+	for (U32 i = 0; i < meshes.size(); i++)
+	{
+		meshes[i]->prepareSkinJob(jobs[i]);
+	}
+
+	LLSkinMeshTask task(jobs, sUpdateGeometryFunc);
+	if (pool)
+	{
+		pool->parallelFor(task, (S32)jobs.size());
+	}
+	else
+	{
+		for (S32 i = 0; i < (S32)jobs.size(); i++)
+		{
+			task.run(i);
+		}
+	}
+}
+
+// Collects the weighted meshes of every LOD under joint.
+static void get_weighted_meshes(LLJoint* joint, std::vector<LLPolyMesh*>& meshes)
+{
+	LLViewerJointMesh* joint_mesh = dynamic_cast<LLViewerJointMesh*>(joint);
+	if (joint_mesh && joint_mesh->getMesh() && joint_mesh->getMesh()->hasWeights())
+	{
+		joint_mesh->getMesh()->updateNormals();
+		meshes.push_back(joint_mesh->getMesh());
+	}
+	for (LLJoint::child_list_t::iterator iter = joint->mChildren.begin();
+		 iter != joint->mChildren.end(); ++iter)
+	{
+		get_weighted_meshes(*iter, meshes);
+	}
+}
+
+//static
+void LLViewerJointMesh::benchmarkSkinning(LLViewerJoint* root, S32 avatars, LLWorkPool* pool)
+{
+	std::vector<LLPolyMesh*> meshes;
+	get_weighted_meshes(root, meshes);
+	if (meshes.empty())
+	{
+		return;
+	}
+
+	// Every copy skins into its own scratch memory, so nothing is shared
+	// between threads but the skeleton, as in a real frame.
+	std::vector<std::vector<LLVector3> > buffers(meshes.size() * avatars * 2);
+	std::vector<SkinJob> jobs(meshes.size() * avatars);
+	U32 vertices = 0;
+	for (U32 i = 0; i < jobs.size(); i++)
+	{
+		LLPolyMesh* mesh = meshes[i % meshes.size()];
+		std::vector<LLVector3>& coords = buffers[i * 2];
+		std::vector<LLVector3>& normals = buffers[i * 2 + 1];
+		coords.resize(mesh->getNumVertices());
+		normals.resize(mesh->getNumVertices());
+		vertices += mesh->getNumVertices();
+
+		jobs[i].mMesh = mesh;
+		jobs[i].mVertices = &coords[0];
+		jobs[i].mNormals = &normals[0];
+	}
+
+	const S32 ITERATIONS = 20;
+	LLSkinMeshTask task(jobs, sUpdateGeometryFunc);
+	LLTimer timer;
+	for (S32 iter = 0; iter < ITERATIONS; iter++)
+	{
+		for (S32 i = 0; i < (S32)jobs.size(); i++)
+		{
+			task.run(i);
+		}
+	}
+	F64 serial_time = timer.getElapsedTimeF64() / ITERATIONS;
+
+	F64 parallel_time = serial_time;
+	if (pool)
+	{
+		timer.reset();
+		for (S32 iter = 0; iter < ITERATIONS; iter++)
+		{
+			pool->parallelFor(task, (S32)jobs.size());
+		}
+		parallel_time = timer.getElapsedTimeF64() / ITERATIONS;
+	}
+
+	llinfos << "Skinning benchmark: " << avatars << " avatars, " << jobs.size() << " meshes, "
+			<< vertices << " vertices, " << serial_time * 1000.0 << " ms serial, "
+			<< parallel_time * 1000.0 << " ms on " << (pool ? pool->getNumThreads() : 0) << " threads" << llendl;
+}
+
 void LLViewerJointMesh::updateJointGeometry()
 {
-	if (!(mValid
-		  && mMesh
-		  && mFace
-		  && mMesh->hasWeights()
-		  && mFace->mVertexBuffer.notNull()
-		  && LLViewerShaderMgr::instance()->getVertexShaderLevel(LLViewerShaderMgr::SHADER_AVATAR) == 0))
+	if (!needsCPUSkinning())
 	{
 		return;
 	}
 
+	SkinJob job;
+	prepareSkinJob(job);
+
 	if (!sVectorizePerfTest)
 	{
 		// Once we've measured performance, just run the specified
 		// code version.
-		if(sUpdateGeometryFunc == updateGeometryOriginal)
-			uploadJointMatrices();
-		sUpdateGeometryFunc(mFace, mMesh);
+		sUpdateGeometryFunc(job);
 	}
 	else
 	{
@@ -979,15 +1144,12 @@ void LLViewerJointMesh::updateJointGeometry()
 		
 		if (sUpdateGeometryCallPointer)
 		{
-			if(sUpdateGeometryFunc == updateGeometryOriginal)
-				uploadJointMatrices();
 			// call accelerated version for this processor
-			sUpdateGeometryFunc(mFace, mMesh);
+			sUpdateGeometryFunc(job);
 		}
 		else
 		{
-			uploadJointMatrices();
-			updateGeometryOriginal(mFace, mMesh);
+			updateGeometryOriginal(job);
 		}
 	
 		sUpdateGeometryElapsedTime += ug_timer.getElapsedTimeF64();
@@ -30,12 +30,14 @@
 #include "llviewerjoint.h"
 #include "llviewertexture.h"
 #include "llpolymesh.h"
+#include "llstrider.h"
 #include "v4color.h"
 
 class LLDrawable;
 class LLFace;
 class LLCharacter;
 class LLTexLayerSet;
+class LLWorkPool;
 
 typedef enum e_avatar_render_pass
 {
@@ -139,6 +141,27 @@ public:
 	/*virtual*/ void updateJointGeometry();
 	/*virtual*/ void dump();
 
+	/*virtual*/ void getSkinnedMeshes(std::vector<LLViewerJointMesh*>& meshes);
+
+	// Skins meshes on the CPU, across pool if there is one.  Vertex buffers
+	// are mapped on the calling thread, which must be the main thread; the
+	// skinning itself only reads joint world matrices, so the skeletons
+	// must be up to date and left alone until this returns.
+	static void skinMeshes(const std::vector<LLViewerJointMesh*>& meshes, LLWorkPool* pool);
+
+	// Times skinning every LOD under root, as many times as there are
+	// avatars, into scratch memory.  Results go to the log.
+	static void benchmarkSkinning(LLViewerJoint* root, S32 avatars, LLWorkPool* pool);
+
+	// A mesh to skin on the CPU.  The striders point at the mesh's first
+	// vertex and normal in memory that stays mapped until the job is done.
+	struct SkinJob
+	{
+		LLPolyMesh*				mMesh;
+		LLStrider<LLVector3>	mVertices;
+		LLStrider<LLVector3>	mNormals;
+	};
+
 	void setIsTransparent(BOOL is_transparent) { mIsTransparent = is_transparent; }
 
 	/*virtual*/ BOOL isAnimatable() const { return FALSE; }
@@ -152,14 +175,23 @@ private:
 	//
 	// These functions require compiler options for SSE2, SSE, or neither, and
 	// hence are contained in separate individual .cpp files.  JC
-	static void updateGeometryOriginal(LLFace* face, LLPolyMesh* mesh);
+	//
+	// They only touch the job and their own locals, so several can run at
+	// once on different threads.
+	static void updateGeometryOriginal(SkinJob& job);
 	// generic vector code, used for Altivec
-	static void updateGeometryVectorized(LLFace* face, LLPolyMesh* mesh);
-	static void updateGeometrySSE(LLFace* face, LLPolyMesh* mesh);
-	static void updateGeometrySSE2(LLFace* face, LLPolyMesh* mesh);
+	static void updateGeometryVectorized(SkinJob& job);
+	static void updateGeometrySSE(SkinJob& job);
+	static void updateGeometrySSE2(SkinJob& job);
 
 	// Use a fuction pointer to indicate which version we are running.
-	static void (*sUpdateGeometryFunc)(LLFace* face, LLPolyMesh* mesh);
+	static void (*sUpdateGeometryFunc)(SkinJob& job);
+
+	// TRUE if this mesh is skinned on the CPU
+	BOOL needsCPUSkinning();
+
+	// Maps the vertex buffer and points job at this mesh's part of it.
+	void prepareSkinJob(SkinJob& job);
 
 private:
 	// Allocate skin data
@@ -61,17 +61,17 @@ inline void matrix_translate(LLV4Matrix4& m, const LLMatrix4* w, const LLVector3
 }
 
 // static
-void LLViewerJointMesh::updateGeometrySSE(LLFace *face, LLPolyMesh *mesh)
+void LLViewerJointMesh::updateGeometrySSE(SkinJob& job)
 {
-	// This cannot be a file-level static because it will be initialized
-	// before main() using SSE code, which will crash on non-SSE processors.
-	static LLV4Matrix4	sJointMat[32];
+	// Not a static, as meshes are skinned on several threads at once.
+	LLV4Matrix4			joint_mat[32];
+	LLPolyMesh*			mesh		= job.mMesh;
 	LLDynamicArray<LLJointRenderData*>& joint_data = mesh->getReferenceMesh()->mJointRenderData;
 
 	//upload joint pivots/matrices
 	for(S32 j = 0, jend = joint_data.count(); j < jend ; ++j )
 	{
-		matrix_translate(sJointMat[j], joint_data[j]->mWorldMatrix,
+		matrix_translate(joint_mat[j], joint_data[j]->mWorldMatrix,
 			joint_data[j]->mSkinJoint ?
 				joint_data[j]->mSkinJoint->mRootToJointSkinOffset
 				: joint_data[j+1]->mSkinJoint->mRootToParentJointSkinOffset);
@@ -80,12 +80,8 @@ void LLViewerJointMesh::updateGeometrySSE(LLFace *face, LLPolyMesh *mesh)
 	F32					weight		= F32_MAX;
 	LLV4Matrix4			blend_mat;
 
-	LLStrider<LLVector3> o_vertices;
-	LLStrider<LLVector3> o_normals;
-
-	LLVertexBuffer *buffer = face->mVertexBuffer;
-	buffer->getVertexStrider(o_vertices,  mesh->mFaceVertexOffset);
-	buffer->getNormalStrider(o_normals,   mesh->mFaceVertexOffset);
+	LLStrider<LLVector3>& o_vertices = job.mVertices;
+	LLStrider<LLVector3>& o_normals = job.mNormals;
 
 	const F32*			weights			= mesh->getWeights();
 	const LLVector3*	coords			= mesh->getCoords();
@@ -95,20 +91,18 @@ void LLViewerJointMesh::updateGeometrySSE(LLFace *face, LLPolyMesh *mesh)
 		if( weight != weights[index])
 		{
 			S32 joint = llfloor(weight = weights[index]);
-			blend_mat.lerp(sJointMat[joint], sJointMat[joint+1], weight - joint);
+			blend_mat.lerp(joint_mat[joint], joint_mat[joint+1], weight - joint);
 		}
 		blend_mat.multiply(coords[index], o_vertices[index]);
 		((LLV4Matrix3)blend_mat).multiply(normals[index], o_normals[index]);
 	}
-
-	buffer->setBuffer(0);
 }
 
 #else
 
-void LLViewerJointMesh::updateGeometrySSE(LLFace *face, LLPolyMesh *mesh)
+void LLViewerJointMesh::updateGeometrySSE(SkinJob& job)
 {
-	LLViewerJointMesh::updateGeometryVectorized(face, mesh);
+	LLViewerJointMesh::updateGeometryVectorized(job);
 }
 
 #endif
@@ -39,10 +39,12 @@
 #include "llagentcamera.h"
 #include "llagentwearables.h"
 #include "llagentpilot.h"
+#include "llappviewer.h"
 #include "llbottomtray.h"
 #include "llcompilequeue.h"
 #include "llconsole.h"
 #include "lldebugview.h"
+#include "llfacegeombatch.h"
 #include "llfilepicker.h"
 //#include "llfirstuse.h"
 #include "llfloaterbuy.h"
@@ -74,10 +76,13 @@
 #include "llmenucommands.h"
 #include "llmoveview.h"
 #include "llparcel.h"
+#include "llpolymorph.h"
+#include "llquantize.h"
 #include "llrootview.h"
 #include "llselectmgr.h"
 #include "llsidetray.h"
 #include "llstatusbar.h"
+#include "lltaskscheduler.h"
 #include "lltextureview.h"
 #include "lltoolcomp.h"
 #include "lltoolmgr.h"
@@ -92,7 +97,11 @@
 #include "llviewerobjectlist.h"
 #include "llviewerparcelmgr.h"
 #include "llviewerstats.h"
+#include "llviewertexturelist.h"
+#include "llvlmanager.h"
 #include "llvoavatarself.h"
+#include "llvovolume.h"
+#include "llworkpool.h"
 #include "llworldmap.h"
 #include "pipeline.h"
 #include "llviewerjoystick.h"
@@ -100,6 +109,10 @@
 #include "llwlparammanager.h"
 #include "llfloatercamera.h"
 #include "lluilistener.h"
+#include "llstringpool.h"
+#include "llevents.h"
+#include "llmempool.h"
+#include "lluuidflatmap.h"
 #include "llappearancemgr.h"
 #include "lltrans.h"
 #include "lleconomy.h"
@@ -591,6 +604,345 @@ class LLAdvancedDumpInfoToConsole : public view_listener_t
 };
 
 
+//////////////////////////////
+// BENCHMARK TERRAIN DECODE //
+//////////////////////////////
+
+
+class LLAdvancedBenchmarkTerrain : public view_listener_t
+{
+	bool handleEvent(const LLSD& userdata)
+	{
+		std::string filename = gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "layer_data.capture");
+		gVLManager.benchmarkCapture(filename, gAgent.getRegion());
+		return true;
+	}
+};
+
+
+/////////////////////////////////
+// BENCHMARK AVATAR ANIMATION //
+/////////////////////////////////
+
+
+class LLAdvancedBenchmarkAnimation : public view_listener_t
+{
+	bool handleEvent(const LLSD& userdata)
+	{
+		// Runs the motion controllers of every avatar without drawing
+		// anything, so keyframe sampling and blending can be compared
+		// between builds.
+		const S32 ITERATIONS = 100;
+		S32 avatars = 0;
+		LLTimer timer;
+		for (S32 i = 0; i < ITERATIONS; i++)
+		{
+			for (std::vector<LLCharacter*>::iterator iter = LLCharacter::sInstances.begin();
+				 iter != LLCharacter::sInstances.end(); ++iter)
+			{
+				LLVOAvatar* avatarp = (LLVOAvatar*)*iter;
+				if (avatarp->isDead())
+				{
+					continue;
+				}
+				avatarp->getMotionController().updateMotions();
+				avatars++;
+			}
+		}
+		F64 elapsed = timer.getElapsedTimeF64();
+		llinfos << "Animation benchmark: " << avatars / ITERATIONS << " avatars, "
+				<< (avatars > 0 ? elapsed * 1000000.0 / avatars : 0.0) << " us per avatar update" << llendl;
+		return true;
+	}
+};
+
+
+////////////////////////////////////
+// BENCHMARK AVATAR APPEARANCE //
+////////////////////////////////////
+
+
+class LLAdvancedBenchmarkAppearance : public view_listener_t
+{
+	bool handleEvent(const LLSD& userdata)
+	{
+		// Replays the shape of every avatar in view onto our own, quantized
+		// the way AvatarAppearance sends it, and times the morphing.  Only
+		// morph targets are replayed, so nothing gets rebaked, and our own
+		// weights are put back afterwards.
+		if (!isAgentAvatarValid())
+		{
+			return true;
+		}
+
+		std::vector<LLVisualParam*> params;
+		std::vector<F32> saved_weights;
+		for (LLVisualParam* param = gAgentAvatarp->getFirstVisualParam(); param; param = gAgentAvatarp->getNextVisualParam())
+		{
+			if (param->getGroup() == VISUAL_PARAM_GROUP_TWEAKABLE && dynamic_cast<LLPolyMorphTarget*>(param))
+			{
+				params.push_back(param);
+				saved_weights.push_back(param->getWeight());
+			}
+		}
+
+		typedef std::vector<U8> param_stream_t;
+		std::vector<param_stream_t> streams;
+		for (std::vector<LLCharacter*>::iterator iter = LLCharacter::sInstances.begin();
+			 iter != LLCharacter::sInstances.end(); ++iter)
+		{
+			LLVOAvatar* avatarp = (LLVOAvatar*)*iter;
+			if (avatarp->isDead())
+			{
+				continue;
+			}
+			param_stream_t stream;
+			for (U32 i = 0; i < params.size(); i++)
+			{
+				LLVisualParam* param = avatarp->getVisualParam(params[i]->getID());
+				F32 weight = param ? param->getWeight() : params[i]->getDefaultWeight();
+				stream.push_back(F32_to_U8(weight, params[i]->getMinWeight(), params[i]->getMaxWeight()));
+			}
+			streams.push_back(stream);
+		}
+
+		const S32 ITERATIONS = 10;
+		LLTimer timer;
+		for (S32 i = 0; i < ITERATIONS; i++)
+		{
+			for (U32 s = 0; s < streams.size(); s++)
+			{
+				for (U32 p = 0; p < params.size(); p++)
+				{
+					params[p]->setWeight(U8_to_F32(streams[s][p], params[p]->getMinWeight(), params[p]->getMaxWeight()), FALSE);
+				}
+				gAgentAvatarp->updateVisualParams();
+				gAgentAvatarp->updateMeshNormals();
+			}
+		}
+		F64 elapsed = timer.getElapsedTimeF64();
+
+		for (U32 p = 0; p < params.size(); p++)
+		{
+			params[p]->setWeight(saved_weights[p], FALSE);
+		}
+		gAgentAvatarp->updateVisualParams();
+
+		S32 replays = ITERATIONS * streams.size();
+		llinfos << "Appearance benchmark: " << params.size() << " morphs, " << streams.size() << " appearances, "
+				<< (replays > 0 ? elapsed * 1000.0 / replays : 0.0) << " ms per appearance" << llendl;
+		return true;
+	}
+};
+
+
+/////////////////////////////////
+// BENCHMARK AVATAR SKINNING //
+/////////////////////////////////
+
+
+class LLAdvancedBenchmarkSkinning : public view_listener_t
+{
+	bool handleEvent(const LLSD& userdata)
+	{
+		// Skins a crowd of copies of our own avatar on the CPU, once on
+		// this thread and once across the work pool, without touching GL.
+		if (!isAgentAvatarValid())
+		{
+			return true;
+		}
+		const S32 crowds[3] = { 1, 10, 50 };
+		for (S32 i = 0; i < 3; i++)
+		{
+			LLViewerJointMesh::benchmarkSkinning(&gAgentAvatarp->mRoot, crowds[i], LLAppViewer::getWorkPool());
+		}
+		return true;
+	}
+};
+
+
+//////////////////////////////
+// BENCHMARK FACE GEOMETRY //
+//////////////////////////////
+
+
+class LLAdvancedBenchmarkFaceGeometry : public view_listener_t
+{
+	bool handleEvent(const LLSD& userdata)
+	{
+		// Regenerates the vertices of every volume face into staging
+		// memory, once on this thread and once across the work pool.
+		LLFaceGeomBatch batch;
+		for (S32 i = 0; i < gObjectList.getNumObjects(); i++)
+		{
+			LLViewerObject* objectp = gObjectList.getObject(i);
+			if (!objectp || objectp->isDead() || objectp->getPCode() != LL_PCODE_VOLUME)
+			{
+				continue;
+			}
+			LLDrawable* drawablep = objectp->mDrawable;
+			LLVOVolume* vobj = (LLVOVolume*)objectp;
+			LLVolume* volume = vobj->getVolume();
+			if (!drawablep || drawablep->isDead() || !volume)
+			{
+				continue;
+			}
+
+			for (S32 f = 0; f < drawablep->getNumFaces(); f++)
+			{
+				LLFace* facep = drawablep->getFace(f);
+				if (facep && facep->mVertexBuffer.notNull() && facep->getTEOffset() < volume->getNumVolumeFaces())
+				{
+					batch.add(facep, volume, facep->getTEOffset(), vobj->getRelativeXform(),
+							  vobj->getRelativeXformInvTrans(), facep->getGeomIndex(), TRUE);
+				}
+			}
+		}
+		batch.benchmark(LLAppViewer::getWorkPool());
+		return true;
+	}
+};
+
+
+///////////////////////////////////
+// BENCHMARK TEXTURE COMPRESSION //
+///////////////////////////////////
+
+
+class LLAdvancedBenchmarkTextureCompression : public view_listener_t
+{
+	bool handleEvent(const LLSD& userdata)
+	{
+		// Times j2c decode against block compressing and decompressing
+		// the same textures, for the skin's own j2c files.
+		LLViewerTextureList::benchmarkCompression();
+		return true;
+	}
+};
+
+
+//////////////////////////////
+// BENCHMARK TASK SCHEDULER //
+//////////////////////////////
+
+
+class LLAdvancedBenchmarkTaskScheduler : public view_listener_t
+{
+	bool handleEvent(const LLSD& userdata)
+	{
+		// The same burst of small tasks on one thread, as each background
+		// subsystem used to have, and on a scheduler sized to the machine.
+		LLTaskScheduler::benchmark(1);
+		LLTaskScheduler::benchmark(-1);
+		return true;
+	}
+};
+
+
+//////////////////////////////////
+// BENCHMARK REFERENCE COUNTING //
+//////////////////////////////////
+
+
+class LLAdvancedBenchmarkRefCount : public view_listener_t
+{
+	bool handleEvent(const LLSD& userdata)
+	{
+		// Copies one shared LLPointer from more and more threads, with the
+		// atomic count and with the old global mutex.
+		LLThreadSafeRefCount::benchmark(LLWorkPool::getDefaultThreadCount() + 1);
+		return true;
+	}
+};
+
+
+/////////////////////////
+// BENCHMARK UUID MAPS //
+/////////////////////////
+
+
+class LLAdvancedBenchmarkUUIDMaps : public view_listener_t
+{
+	bool handleEvent(const LLSD& userdata)
+	{
+		// Small enough to stay in cache, then about as many IDs as a busy
+		// region and texture list hold between them.
+		LLUUIDFlatTableBase::benchmark(1000);
+		LLUUIDFlatTableBase::benchmark(100000);
+		return true;
+	}
+};
+
+
+///////////////////////////
+// BENCHMARK STRING POOL //
+///////////////////////////
+
+
+class LLAdvancedBenchmarkStringPool : public view_listener_t
+{
+	bool handleEvent(const LLSD& userdata)
+	{
+		// Interns and looks up message-style names from more and more
+		// threads, against a std::set behind one mutex.
+		LLStringPool::benchmark(LLWorkPool::getDefaultThreadCount() + 1);
+		return true;
+	}
+};
+
+
+///////////////////////////
+// BENCHMARK EVENT PUMPS //
+///////////////////////////
+
+
+class LLAdvancedBenchmarkEventPumps : public view_listener_t
+{
+	bool handleEvent(const LLSD& userdata)
+	{
+		// Listener counts from one "mainloop" client up to a busy pump,
+		// with batches about one frame's worth of samples.
+		LLEventBatchPump::benchmark(1, 64);
+		LLEventBatchPump::benchmark(4, 64);
+		LLEventBatchPump::benchmark(16, 64);
+		return true;
+	}
+};
+
+
+///////////////////////////
+// BENCHMARK MEMORY POOL //
+///////////////////////////
+
+
+class LLAdvancedBenchmarkMemoryPool : public view_listener_t
+{
+	bool handleEvent(const LLSD& userdata)
+	{
+		// Small block churn from more and more threads, against the heap
+		// everything used to come from.
+		LLMemPool::benchmark(LLWorkPool::getDefaultThreadCount() + 1);
+		return true;
+	}
+};
+
+
+//////////////////////////
+// LOG MUTEX CONTENTION //
+//////////////////////////
+
+
+class LLAdvancedLogMutexContention : public view_listener_t
+{
+	bool handleEvent(const LLSD& userdata)
+	{
+		// Per named mutex, since the last time this was logged
+		LLMutex::logContention(true);
+		return true;
+	}
+};
+
+
 //////////////
 // HUD INFO //
 //////////////
@@ -7016,6 +7368,16 @@ void handle_dump_timers()
 	LLFastTimer::dumpCurTimes();
 }
 
+void handle_save_timer_trace()
+{
+	// load the .json in chrome://tracing
+	std::string filename = gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "timer_trace.json");
+	if (LLFastTimer::writeTimeline(filename, gSavedSettings.getF32("FastTimerTraceSeconds"), LLFastTimer::TIMELINE_TRACE))
+	{
+		llinfos << "Saved timer trace to " << filename << llendl;
+	}
+}
+
 void handle_debug_avatar_textures(void*)
 {
 	LLViewerObject* objectp = LLSelectMgr::getInstance()->getSelection()->getPrimaryObject();
@@ -7981,6 +8343,19 @@ void initialize_menus()
 	view_listener_t::addMenu(new LLAdvancedToggleConsole(), "Advanced.ToggleConsole");
 	view_listener_t::addMenu(new LLAdvancedCheckConsole(), "Advanced.CheckConsole");
 	view_listener_t::addMenu(new LLAdvancedDumpInfoToConsole(), "Advanced.DumpInfoToConsole");
+	view_listener_t::addMenu(new LLAdvancedBenchmarkTerrain(), "Advanced.BenchmarkTerrain");
+	view_listener_t::addMenu(new LLAdvancedBenchmarkAnimation(), "Advanced.BenchmarkAnimation");
+	view_listener_t::addMenu(new LLAdvancedBenchmarkAppearance(), "Advanced.BenchmarkAppearance");
+	view_listener_t::addMenu(new LLAdvancedBenchmarkSkinning(), "Advanced.BenchmarkSkinning");
+	view_listener_t::addMenu(new LLAdvancedBenchmarkFaceGeometry(), "Advanced.BenchmarkFaceGeometry");
+	view_listener_t::addMenu(new LLAdvancedBenchmarkTextureCompression(), "Advanced.BenchmarkTextureCompression");
+	view_listener_t::addMenu(new LLAdvancedBenchmarkTaskScheduler(), "Advanced.BenchmarkTaskScheduler");
+	view_listener_t::addMenu(new LLAdvancedBenchmarkRefCount(), "Advanced.BenchmarkRefCount");
+	view_listener_t::addMenu(new LLAdvancedBenchmarkUUIDMaps(), "Advanced.BenchmarkUUIDMaps");
+	view_listener_t::addMenu(new LLAdvancedBenchmarkStringPool(), "Advanced.BenchmarkStringPool");
+	view_listener_t::addMenu(new LLAdvancedBenchmarkEventPumps(), "Advanced.BenchmarkEventPumps");
+	view_listener_t::addMenu(new LLAdvancedBenchmarkMemoryPool(), "Advanced.BenchmarkMemoryPool");
+	view_listener_t::addMenu(new LLAdvancedLogMutexContention(), "Advanced.LogMutexContention");
 	// Advanced > HUD Info
 	view_listener_t::addMenu(new LLAdvancedToggleHUDInfo(), "Advanced.ToggleHUDInfo");
 	view_listener_t::addMenu(new LLAdvancedCheckHUDInfo(), "Advanced.CheckHUDInfo");
@@ -8040,6 +8415,7 @@ void initialize_menus()
 	view_listener_t::addMenu(new LLAdvancedDumpSelectMgr(), "Advanced.DumpSelectMgr");
 	view_listener_t::addMenu(new LLAdvancedDumpInventory(), "Advanced.DumpInventory");
 	commit.add("Advanced.DumpTimers", boost::bind(&handle_dump_timers) );
+	commit.add("Advanced.SaveTimerTrace", boost::bind(&handle_save_timer_trace) );
 	commit.add("Advanced.DumpFocusHolder", boost::bind(&handle_dump_focus) );
 	view_listener_t::addMenu(new LLAdvancedPrintSelectedObjectInfo(), "Advanced.PrintSelectedObjectInfo");
 	view_listener_t::addMenu(new LLAdvancedPrintAgentInfo(), "Advanced.PrintAgentInfo");
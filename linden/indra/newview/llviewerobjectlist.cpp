@@ -679,6 +679,9 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 	//clear avatar LOD change counter
 	LLVOAvatar::sNumLODChangesThisFrame = 0;
 
+	static LLCachedControl<F32> animation_budget(gSavedSettings, "AvatarAnimationFrameBudget");
+	LLMotionController::startFrame(animation_budget * 0.001f);
+
 	const F64 frame_time = LLFrameTimer::getElapsedSeconds();
 	
 	std::vector<LLViewerObject*> kill_list;
@@ -810,6 +813,10 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 	LLViewerStats::getInstance()->mNumActiveObjectsStat.addValue(num_active_objects);
 	LLViewerStats::getInstance()->mNumSizeCulledStat.addValue(mNumSizeCulled);
 	LLViewerStats::getInstance()->mNumVisCulledStat.addValue(mNumVisCulled);
+	LLViewerStats::getInstance()->mAnimEvaluationsStat.addValue(LLMotionController::sNumEvaluations);
+	LLViewerStats::getInstance()->mAnimInterpolationsStat.addValue(LLMotionController::sNumInterpolations + LLMotionController::sNumDeferrals);
+	LLViewerStats::getInstance()->mAnimMsecStat.addValue(LLMotionController::sEvaluationTime * 1000.f);
+	LLViewerStats::getInstance()->mAnimSavedMsecStat.addValue(LLMotionController::getSavedTime() * 1000.f);
 }
 
 void LLViewerObjectList::clearDebugText()
@@ -33,6 +33,7 @@
 // common includes
 #include "llstat.h"
 #include "llstring.h"
+#include "lluuidflatmap.h"
 
 // project includes
 #include "llviewerobject.h"
@@ -184,7 +185,7 @@ protected:
 	typedef std::map<LLUUID, LLPointer<LLViewerObject> > vo_map;
 	vo_map mDeadObjects;	// Need to keep multiple entries per UUID
 
-	std::map<LLUUID, LLPointer<LLViewerObject> > mUUIDObjectMap;
+	LLUUIDFlatMap<LLPointer<LLViewerObject> > mUUIDObjectMap;
 
 	std::vector<LLDebugBeacon> mDebugBeacons;
 
@@ -232,7 +233,7 @@ extern LLViewerObjectList gObjectList;
  */
 inline LLViewerObject *LLViewerObjectList::findObject(const LLUUID &id)
 {
-	std::map<LLUUID, LLPointer<LLViewerObject> >::iterator iter = mUUIDObjectMap.find(id);
+	LLUUIDFlatMap<LLPointer<LLViewerObject> >::iterator iter = mUUIDObjectMap.find(id);
 	if(iter != mUUIDObjectMap.end())
 	{
 		return iter->second;
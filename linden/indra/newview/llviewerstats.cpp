@@ -263,6 +263,13 @@ LLViewerStats::LLViewerStats() :
 	mNumNewObjectsStat("numnewobjectsstat"),
 	mNumSizeCulledStat("numsizeculledstat"),
 	mNumVisCulledStat("numvisculledstat"),
+	mAnimEvaluationsStat("animevaluationsstat"),
+	mAnimInterpolationsStat("animinterpolationsstat"),
+	mAnimMsecStat("animmsecstat"),
+	mAnimSavedMsecStat("animsavedmsecstat"),
+	mVertexUploadKBStat("vertexuploadkbstat"),
+	mVertexBindsStat("vertexbindsstat"),
+	mTexturePrioritySettleStat("textureprioritysettlestat"),
 	mLastTimeDiff(0.0)
 {
 	for (S32 i = 0; i < ST_COUNT; i++)
@@ -110,6 +110,16 @@ public:
 	LLStat mNumSizeCulledStat;
 	LLStat mNumVisCulledStat;
 
+	LLStat mAnimEvaluationsStat;
+	LLStat mAnimInterpolationsStat;
+	LLStat mAnimMsecStat;
+	LLStat mAnimSavedMsecStat;
+
+	LLStat mVertexUploadKBStat;
+	LLStat mVertexBindsStat;
+
+	LLStat mTexturePrioritySettleStat;
+
 	void resetStats();
 public:
 	// If you change this, please also add a corresponding text label
@@ -527,6 +527,8 @@ void LLViewerTexture::init(bool firstinit)
 	mMaxVirtualSizeResetInterval = 1;
 	mMaxVirtualSizeResetCounter = mMaxVirtualSizeResetInterval ;
 	mAdditionalDecodePriority = 0.f ;	
+	mPriorityVirtualSize = 0.f;
+	mPriorityDirty = FALSE;
 	mParcelMedia = NULL ;
 	mNumFaces = 0 ;
 	mNumVolumes = 0;
@@ -640,6 +642,14 @@ void LLViewerTexture::addTextureStats(F32 virtual_size, BOOL needs_gltexture) co
 	{
 		mMaxVirtualSize = virtual_size;
 	}	
+
+	// big enough growth to move the decode priority, so don't wait for the
+	// texture list to come around to this texture
+	if (!mPriorityDirty && mMaxVirtualSize > mPriorityVirtualSize * 1.25f)
+	{
+		mPriorityDirty = TRUE;
+		dirtyDecodePriority();
+	}
 }
 
 void LLViewerTexture::resetTextureStats()
@@ -672,6 +682,12 @@ void LLViewerTexture::addFace(LLFace* facep)
 	facep->setIndexInTex(mNumFaces) ;
 	mNumFaces++ ;
 	mLastFaceListUpdateTimer.reset() ;
+
+	if (!mPriorityDirty)
+	{
+		mPriorityDirty = TRUE;
+		dirtyDecodePriority();
+	}
 }
 
 //virtual
@@ -1124,6 +1140,8 @@ void LLViewerFetchedTexture::init(bool firstinit)
 	{
 		mDecodePriority = 0.f;
 		mInImageList = 0;
+		mPriorityBucket = -1;
+		mPriorityBucketSlot = -1;
 	}
 
 	// Only set mIsMissingAsset true when we know for certain that the database
@@ -1451,7 +1469,7 @@ BOOL LLViewerFetchedTexture::createTexture(S32 usename/*= 0*/)
 		
 		if(!(res = insertToAtlas()))
 		{
-			res = mGLTexturep->createGLTexture(mRawDiscardLevel, mRawImage, usename, TRUE, mBoostLevel);
+			res = mGLTexturep->createGLTexture(mRawDiscardLevel, mRawImage, usename, TRUE, mBoostLevel, mPreparedImage);
 			resetFaceAtlas() ;
 		}
 		setActive() ;
@@ -1465,6 +1483,19 @@ BOOL LLViewerFetchedTexture::createTexture(S32 usename/*= 0*/)
 	return res;
 }
 
+S32 LLViewerFetchedTexture::getUploadBytes() const
+{
+	if (mRawImage.isNull())
+	{
+		return 0;
+	}
+	if (mPreparedImage.notNull() && mPreparedImage->isFor(mRawImage))
+	{
+		return mPreparedImage->getUploadBytes();
+	}
+	return mRawImage->getDataSize();
+}
+
 // Call with 0,0 to turn this feature off.
 //virtual
 void LLViewerFetchedTexture::setKnownDrawSize(S32 width, S32 height)
@@ -1729,6 +1760,20 @@ void LLViewerFetchedTexture::setDecodePriority(F32 priority)
 	}
 }
 
+//virtual
+void LLViewerFetchedTexture::dirtyDecodePriority() const
+{
+	if (mInImageList)
+	{
+		gTextureList.dirtyDecodePriority(const_cast<LLViewerFetchedTexture*>(this));
+	}
+	else
+	{
+		// priority gets worked out when it's added
+		mPriorityDirty = FALSE;
+	}
+}
+
 void LLViewerFetchedTexture::setAdditionalDecodePriority(F32 priority)
 {
 	priority = llclamp(priority, 0.f, 1.f);
@@ -1829,7 +1874,7 @@ bool LLViewerFetchedTexture::updateFetch()
 		
 		if (mRawImage.notNull()) sRawCount--;
 		if (mAuxRawImage.notNull()) sAuxCount--;
-		bool finished = LLAppViewer::getTextureFetch()->getRequestFinished(getID(), fetch_discard, mRawImage, mAuxRawImage);
+		bool finished = LLAppViewer::getTextureFetch()->getRequestFinished(getID(), fetch_discard, mRawImage, mAuxRawImage, mPreparedImage);
 		if (mRawImage.notNull()) sRawCount++;
 		if (mAuxRawImage.notNull()) sAuxCount++;
 		if (finished)
@@ -1990,10 +2035,17 @@ bool LLViewerFetchedTexture::updateFetch()
 			desired_discard = override_tex_discard_level;
 		}
 		
+		// only plain mipmapped textures nobody reads back can stay compressed
+		static LLCachedControl<bool> cache_compressed(gSavedSettings,"TextureCacheCompressed");
+		bool can_compress = cache_compressed && gGLManager.mHasCompressedTextures &&
+							!mForSculpt && !needsAux() && !hasCallbacks() && mUseMipMaps &&
+							!getTargetHost().isOk() && mUrl.compare(0, 7, "file://") != 0;
+
 		// bypass texturefetch directly by pulling from LLTextureCache
 		bool fetch_request_created = false;
 		fetch_request_created = LLAppViewer::getTextureFetch()->createRequest(mUrl, getID(),getTargetHost(), decode_priority,
-																			  w, h, c, desired_discard, needsAux(), mCanUseHTTP);
+																			  w, h, c, desired_discard, needsAux(), mCanUseHTTP,
+																			  can_compress);
 		
 		if (fetch_request_created)
 		{
@@ -2536,6 +2588,7 @@ void LLViewerFetchedTexture::destroyRawImage()
 
 	mRawImage = NULL;
 	mAuxRawImage = NULL;
+	mPreparedImage = NULL;
 	mIsRawImageValid = FALSE;
 	mRawDiscardLevel = INVALID_DISCARD_LEVEL;
 }
@@ -44,6 +44,7 @@
 class LLFace;
 class LLImageGL ;
 class LLImageRaw;
+class LLImageGLPrepared;
 class LLViewerObject;
 class LLViewerTexture;
 class LLViewerFetchedTexture ;
@@ -177,6 +178,11 @@ public:
 	void setMaxVirtualSizeResetInterval(S32 interval)const {mMaxVirtualSizeResetInterval = interval;}
 	void resetMaxVirtualSizeResetCounter()const {mMaxVirtualSizeResetCounter = mMaxVirtualSizeResetInterval;}
 
+protected:
+	// Called once when mPriorityDirty gets set
+	virtual void dirtyDecodePriority() const {}
+
+public:
 	virtual F32  getMaxVirtualSize() ;
 
 	LLFrameTimer* getLastReferencedTimer() {return &mLastReferencedTimer ;}
@@ -280,6 +286,8 @@ protected:
 	mutable S32  mMaxVirtualSizeResetCounter ;
 	mutable S32  mMaxVirtualSizeResetInterval;
 	mutable F32 mAdditionalDecodePriority;  // priority add to mDecodePriority.
+	mutable F32 mPriorityVirtualSize;	// mMaxVirtualSize when the decode priority was last worked out
+	mutable BOOL mPriorityDirty;		// if TRUE, mMaxVirtualSize has grown well past mPriorityVirtualSize
 	LLFrameTimer mLastReferencedTimer;	
 
 	//GL texture
@@ -342,9 +350,11 @@ class LLViewerFetchedTexture : public LLViewerTexture
 {
 	friend class LLTextureBar; // debug info only
 	friend class LLTextureView; // debug info only
+	friend class LLTexturePriorityBuckets;
 
 protected:
 	/*virtual*/ ~LLViewerFetchedTexture();
+	/*virtual*/ void dirtyDecodePriority() const;
 public:
 	LLViewerFetchedTexture(const LLUUID& id, const LLHost& host = LLHost::invalid, BOOL usemipmaps = TRUE);
 	LLViewerFetchedTexture(const LLImageRaw* raw, BOOL usemipmaps);
@@ -434,6 +444,10 @@ public:
 	BOOL isInImageList() const {return mInImageList ;}
 	void setInImageList(BOOL flag) {mInImageList = flag ;}
 
+	// Stats have been taken into account; dirty again once they grow past these
+	void clearPriorityDirty() { mPriorityDirty = FALSE; mPriorityVirtualSize = mMaxVirtualSize; }
+	BOOL isPriorityDirty() const { return mPriorityDirty; }
+
 	LLFrameTimer* getLastPacketTimer() {return &mLastPacketTimer;}
 
 	U32 getFetchPriority() const { return mFetchPriority ;}
@@ -460,6 +474,8 @@ public:
 	void        checkCachedRawSculptImage() ;
 	LLImageRaw* getRawImage()const { return mRawImage ;}
 	S32         getRawImageLevel() const {return mRawDiscardLevel;}
+	// About how much createTexture() will send to GL
+	S32         getUploadBytes() const;
 	LLImageRaw* getCachedRawImage() const { return mCachedRawImage ;}
 	S32         getCachedRawImageLevel() const {return mCachedRawDiscardLevel;}
 	BOOL        isCachedRawImageReady() const {return mCachedRawImageReady ;}
@@ -468,6 +484,7 @@ public:
 	/*virtual*/ void setCachedRawImage(S32 discard_level, LLImageRaw* imageraw) ;
 	void        destroySavedRawImage() ;
 	LLImageRaw* getSavedRawImage() ;
+	S32         getSavedRawImageLevel() const {return mSavedRawDiscardLevel;}
 	BOOL        hasSavedRawImage() const ;
 	F32         getElapsedLastReferencedSavedRawImageTime() const ;
 	BOOL		isFullyLoaded() const;
@@ -540,6 +557,9 @@ protected:
 	// doing if you use it for anything else! - djs
 	LLPointer<LLImageRaw> mAuxRawImage;
 
+	// mRawImage's mips and alpha scans, if the decoder got them ready
+	LLPointer<LLImageGLPrepared> mPreparedImage;
+
 	//keep a copy of mRawImage for some special purposes
 	//when mForceToSaveRawImage is set.
 	BOOL mForceToSaveRawImage ;
@@ -560,6 +580,8 @@ protected:
 	LLFrameTimer mStopFetchingTimer;	// Time since mDecodePriority == 0.f.
 
 	BOOL  mInImageList;				// TRUE if image is in list (in which case don't reset priority!)
+	S32   mPriorityBucket;			// where LLTexturePriorityBuckets keeps this image
+	S32   mPriorityBucketSlot;
 	BOOL  mNeedsCreateTexture;	
 
 	BOOL   mForSculpt ; //a flag if the texture is used as sculpt data.
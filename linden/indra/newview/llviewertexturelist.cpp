@@ -34,6 +34,7 @@
 #include "llgl.h" // fot gathering stats from GL
 #include "llimagegl.h"
 #include "llimagebmp.h"
+#include "llimagedxt.h"
 #include "llimagej2c.h"
 #include "llimagetga.h"
 #include "llimagejpeg.h"
@@ -78,11 +79,120 @@ static LLFastTimer::DeclareTimer FTM_PROCESS_IMAGES("Process Images");
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// Buckets are a quarter octave wide, about the same as the 20% change
+// updateImagesDecodePriorities() ignores, so order within one doesn't matter.
+//static
+S32 LLTexturePriorityBuckets::getBucket(F32 priority)
+{
+	if (priority <= 1.f)
+	{
+		return 0;
+	}
+	S32 bucket = 1 + (S32)(logf(priority) * (4.f / F_LN2));
+	return llclamp(bucket, 1, (S32)NUM_BUCKETS - 1);
+}
+
+bool LLTexturePriorityBuckets::insert(LLViewerFetchedTexture* image)
+{
+	if (image->mPriorityBucket >= 0)
+	{
+		return false;
+	}
+	add(image, getBucket(image->getDecodePriority()));
+	return true;
+}
+
+bool LLTexturePriorityBuckets::erase(LLViewerFetchedTexture* image)
+{
+	if (image->mPriorityBucket < 0)
+	{
+		return false;
+	}
+	remove(image);
+	return true;
+}
+
+void LLTexturePriorityBuckets::clear()
+{
+	for (S32 i = 0; i < NUM_BUCKETS; i++)
+	{
+		for (bucket_t::iterator iter = mBuckets[i].begin(); iter != mBuckets[i].end(); ++iter)
+		{
+			(*iter)->mPriorityBucket = -1;
+			(*iter)->mPriorityBucketSlot = -1;
+		}
+		mBuckets[i].clear();
+	}
+	mSize = 0;
+}
+
+LLTexturePriorityBuckets::iterator LLTexturePriorityBuckets::begin() const
+{
+	for (S32 i = NUM_BUCKETS - 1; i >= 0; i--)
+	{
+		if (!mBuckets[i].empty())
+		{
+			return iterator(this, i, 0);
+		}
+	}
+	return end();
+}
+
+void LLTexturePriorityBuckets::add(LLViewerFetchedTexture* image, S32 bucket)
+{
+	image->mPriorityBucket = bucket;
+	image->mPriorityBucketSlot = (S32)mBuckets[bucket].size();
+	mBuckets[bucket].push_back(image);
+	mSize++;
+}
+
+void LLTexturePriorityBuckets::remove(LLViewerFetchedTexture* image)
+{
+	// swap the last entry of the bucket into the hole
+	bucket_t& bucket = mBuckets[image->mPriorityBucket];
+	S32 slot = image->mPriorityBucketSlot;
+	llassert(bucket[slot] == image);
+	image->mPriorityBucket = -1;
+	image->mPriorityBucketSlot = -1;
+	if (slot != (S32)bucket.size() - 1)
+	{
+		bucket[slot] = bucket.back();
+		bucket[slot]->mPriorityBucketSlot = slot;
+	}
+	bucket.pop_back();
+	mSize--;
+}
+
+LLTexturePriorityBuckets::iterator& LLTexturePriorityBuckets::iterator::operator++()
+{
+	if (++mSlot < mBuckets->mBuckets[mBucket].size())
+	{
+		return *this;
+	}
+	mSlot = 0;
+	while (--mBucket >= 0)
+	{
+		if (!mBuckets->mBuckets[mBucket].empty())
+		{
+			return *this;
+		}
+	}
+	mBucket = -1;
+	return *this;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 LLViewerTextureList::LLViewerTextureList() 
 	: mForceResetTextureStats(FALSE),
 	mUpdateStats(FALSE),
 	mMaxResidentTexMemInMegaBytes(0),
-	mMaxTotalTextureMemInMegaBytes(0)
+	mMaxTotalTextureMemInMegaBytes(0),
+	mConverging(FALSE),
+	mSweepUpdates(0),
+	mSweepMoves(0),
+	mLastUpdateSlot(0),
+	mLastFetchSlot(0)
 {
 }
 
@@ -279,6 +389,7 @@ void LLViewerTextureList::shutdown()
 	mUUIDMap.clear();
 	
 	mImageList.clear();
+	mDirtyPriorityList.clear();
 }
 
 void LLViewerTextureList::dump()
@@ -496,7 +607,7 @@ void LLViewerTextureList::addImageToList(LLViewerFetchedTexture *image)
 	{
 		llerrs << "LLViewerTextureList::addImageToList - Image already in list" << llendl;
 	}
-	if((mImageList.insert(image)).second != true) 
+	if (!mImageList.insert(image))
 	{
 		llerrs << "Error happens when insert image to mImageList!" << llendl ;
 	}
@@ -517,7 +628,7 @@ void LLViewerTextureList::removeImageFromList(LLViewerFetchedTexture *image)
 		}
 		llerrs << "LLViewerTextureList::removeImageFromList - Image not in list" << llendl;
 	}
-	if(mImageList.erase(image) != 1) 
+	if (!mImageList.erase(image))
 	{
 		llerrs << "Error happens when remove image from mImageList!" << llendl ;
 	}
@@ -555,6 +666,10 @@ void LLViewerTextureList::deleteImage(LLViewerFetchedTexture *image)
 			mCallbackList.erase(image);
 		}
 
+		// the sweep may have cleared its dirty flag while it was still queued
+		mDirtyPriorityList.erase(std::remove(mDirtyPriorityList.begin(), mDirtyPriorityList.end(), image),
+								 mDirtyPriorityList.end());
+
 		llverify(mUUIDMap.erase(image->getID()) == 1);
 		sNumImages--;
 		removeImageFromList(image);
@@ -619,22 +734,81 @@ void LLViewerTextureList::updateImages(F32 max_time)
 	updateImagesUpdateStats();
 }
 
+void LLViewerTextureList::dirtyDecodePriority(LLViewerFetchedTexture* image)
+{
+	mDirtyPriorityList.push_back(image);
+}
+
+void LLViewerTextureList::startPriorityConvergenceTimer()
+{
+	mConvergenceTimer.reset();
+	mConverging = TRUE;
+	mSweepUpdates = 0;
+	mSweepMoves = 0;
+}
+
+// Returns TRUE if the image moved to a different priority bucket
+BOOL LLViewerTextureList::updateImageDecodePriority(LLViewerFetchedTexture* imagep)
+{
+	BOOL moved = FALSE;
+	imagep->processTextureStats();
+	F32 old_priority = imagep->getDecodePriority();
+	F32 old_priority_test = llmax(old_priority, 0.0f);
+	F32 decode_priority = imagep->calcDecodePriority();
+	F32 decode_priority_test = llmax(decode_priority, 0.0f);
+	// Ignore < 20% difference
+	if ((decode_priority_test < old_priority_test * .8f) ||
+		(decode_priority_test > old_priority_test * 1.25f))
+	{
+		moved = LLTexturePriorityBuckets::getBucket(old_priority) != LLTexturePriorityBuckets::getBucket(decode_priority);
+		removeImageFromList(imagep);
+		imagep->setDecodePriority(decode_priority);
+		addImageToList(imagep);
+	}
+	imagep->clearPriorityDirty();
+	return moved;
+}
+
 void LLViewerTextureList::updateImagesDecodePriorities()
 {
-	// Update the decode priority for N images each frame
+	// Images whose virtual size jumped since their last update go first,
+	// so newly visible textures don't wait for the cycle to come around.
+	{
+		const U32 MAX_DIRTY_UPDATES = 512;
+		U32 count = 0;
+		U32 i = 0;
+		for ( ; i < mDirtyPriorityList.size() && count < MAX_DIRTY_UPDATES; i++)
+		{
+			LLViewerFetchedTexture* imagep = mDirtyPriorityList[i];
+			if (!imagep->isPriorityDirty() || !imagep->isInImageList() || imagep->isDeleted())
+			{
+				continue;
+			}
+			if (updateImageDecodePriority(imagep))
+			{
+				mSweepMoves++;
+			}
+			count++;
+		}
+		mDirtyPriorityList.erase(mDirtyPriorityList.begin(), mDirtyPriorityList.begin() + i);
+	}
+
+	// Update the decode priority for N images each frame; this is what
+	// lets priorities decay once nothing is pushing them up any more.
 	{
 		const size_t max_update_count = llmin((S32) (1024*gFrameIntervalSeconds) + 1, 32); //target 1024 textures per second
 		S32 update_counter = llmin(max_update_count, mUUIDMap.size()/10);
-		uuid_map_t::iterator iter = mUUIDMap.upper_bound(mLastUpdateUUID);
+		uuid_map_t::iterator iter = mUUIDMap.fromSlot(mLastUpdateSlot + 1);
 		while(update_counter > 0 && !mUUIDMap.empty())
 		{
 			if (iter == mUUIDMap.end())
 			{
 				iter = mUUIDMap.begin();
 			}
-			mLastUpdateUUID = iter->first;
+			mLastUpdateSlot = mUUIDMap.slotOf(iter);
 			LLPointer<LLViewerFetchedTexture> imagep = iter->second;
 			++iter; // safe to incrament now
+			mSweepUpdates++;
 
 			//
 			// Flush formatted images using a lazy flush
@@ -692,23 +866,30 @@ void LLViewerTextureList::updateImagesDecodePriorities()
 					imagep->setInactive() ;										
 				}
 			}
-			
-			imagep->processTextureStats();
-			F32 old_priority = imagep->getDecodePriority();
-			F32 old_priority_test = llmax(old_priority, 0.0f);
-			F32 decode_priority = imagep->calcDecodePriority();
-			F32 decode_priority_test = llmax(decode_priority, 0.0f);
-			// Ignore < 20% difference
-			if ((decode_priority_test < old_priority_test * .8f) ||
-				(decode_priority_test > old_priority_test * 1.25f))
+
+			if (updateImageDecodePriority(imagep))
 			{
-				removeImageFromList(imagep);
-				imagep->setDecodePriority(decode_priority);
-				addImageToList(imagep);
+				mSweepMoves++;
 			}
 			update_counter--;
 		}
 	}
+
+	// Once a whole sweep of the map moves hardly anything, the list has
+	// settled; after a teleport that's the time worth reporting.
+	if (mSweepUpdates >= (S32)mUUIDMap.size())
+	{
+		if (mConverging && mDirtyPriorityList.empty() && mSweepMoves * 100 <= mSweepUpdates)
+		{
+			F32 settle_time = mConvergenceTimer.getElapsedTimeF32();
+			llinfos << "Texture priorities settled " << settle_time << " seconds after arrival ("
+					<< mUUIDMap.size() << " images)" << llendl;
+			LLViewerStats::getInstance()->mTexturePrioritySettleStat.addValue(settle_time);
+			mConverging = FALSE;
+		}
+		mSweepUpdates = 0;
+		mSweepMoves = 0;
+	}
 }
 
 /*
@@ -749,6 +930,13 @@ F32 LLViewerTextureList::updateImagesCreateTextures(F32 max_time)
 	//
 	LLFastTimer t(FTM_IMAGE_CREATE);
 	
+	// Decoding already did the CPU work, so what's left is mostly the
+	// driver copying texels; budget by bytes so a burst of large textures
+	// gets spread across frames, with max_time as a backstop.
+	static LLCachedControl<U32> upload_budget_kb(gSavedSettings, "TextureUploadKBPerFrame");
+	S32 upload_budget = (S32) upload_budget_kb * 1024;
+	S32 uploaded = 0;
+
 	LLTimer create_timer;
 	image_list_t::iterator enditer = mCreateTextureList.begin();
 	for (image_list_t::iterator iter = mCreateTextureList.begin();
@@ -757,8 +945,10 @@ F32 LLViewerTextureList::updateImagesCreateTextures(F32 max_time)
 		image_list_t::iterator curiter = iter++;
 		enditer = iter;
 		LLViewerFetchedTexture *imagep = *curiter;
+		uploaded += imagep->getUploadBytes();
 		imagep->createTexture();
-		if (create_timer.getElapsedTimeF32() > max_time)
+		if (create_timer.getElapsedTimeF32() > max_time ||
+			(upload_budget > 0 && uploaded >= upload_budget))
 		{
 			break;
 		}
@@ -813,7 +1003,7 @@ F32 LLViewerTextureList::updateImagesFetchTextures(F32 max_time)
 	update_counter = llmin(max_update_count, mUUIDMap.size());	
 	if(update_counter > 0)
 	{
-		uuid_map_t::iterator iter2 = mUUIDMap.upper_bound(mLastFetchUUID);
+		uuid_map_t::iterator iter2 = mUUIDMap.fromSlot(mLastFetchSlot + 1);
 		uuid_map_t::iterator iter2p = iter2;
 		while(update_counter > 0)
 		{
@@ -826,7 +1016,7 @@ F32 LLViewerTextureList::updateImagesFetchTextures(F32 max_time)
 			update_counter--;
 		}
 
-		mLastFetchUUID = iter2p->first;
+		mLastFetchSlot = mUUIDMap.slotOf(iter2p);
 	}
 	
 	S32 fetch_count = 0;
@@ -1052,6 +1242,59 @@ LLPointer<LLImageJ2C> LLViewerTextureList::convertToUploadFile(LLPointer<LLImage
 	return compressedImage;
 }
 
+//static
+void LLViewerTextureList::benchmarkCompression()
+{
+	// Runs the skin's j2c textures through what the fetcher does with them:
+	// decode, block compress for the GL and the cache, and decode that again.
+	std::string dir = gDirUtilp->getExpandedFilename(LL_PATH_SKINS, "default", "textures", "");
+	std::string name;
+	S32 count = 0;
+	S32 j2c_bytes = 0, raw_bytes = 0, dxt_bytes = 0;
+	F64 j2c_time = 0.0, encode_time = 0.0, decode_time = 0.0;
+	LLTimer timer;
+	while (gDirUtilp->getNextFileInDir(dir, "*.j2c", name, false))
+	{
+		LLPointer<LLImageJ2C> j2c = new LLImageJ2C();
+		if (!j2c->load(dir + name))
+		{
+			continue;
+		}
+		LLPointer<LLImageRaw> raw = new LLImageRaw();
+		timer.reset();
+		if (!j2c->decode(raw, 0.f))
+		{
+			continue;
+		}
+		F64 j2c_elapsed = timer.getElapsedTimeF64();
+
+		LLPointer<LLImageDXT> dxt = new LLImageDXT();
+		timer.reset();
+		if (!dxt->encodeCompressed(raw, raw->getWidth(), raw->getHeight(), 0))
+		{
+			continue; // not a size or format the fetcher would compress
+		}
+		F64 encode_elapsed = timer.getElapsedTimeF64();
+
+		LLPointer<LLImageRaw> decoded = new LLImageRaw();
+		timer.reset();
+		dxt->decode(decoded, 0.f);
+		decode_time += timer.getElapsedTimeF64();
+		j2c_time += j2c_elapsed;
+		encode_time += encode_elapsed;
+
+		j2c_bytes += j2c->getDataSize();
+		raw_bytes += raw->getDataSize();
+		dxt_bytes += dxt->getDataSize();
+		count++;
+	}
+
+	llinfos << "Texture compression benchmark: " << count << " textures, "
+			<< j2c_bytes / 1024 << " KB j2c, " << raw_bytes / 1024 << " KB raw, "
+			<< dxt_bytes / 1024 << " KB dxt, " << j2c_time * 1000.0 << " ms j2c decode, "
+			<< encode_time * 1000.0 << " ms dxt encode, " << decode_time * 1000.0 << " ms dxt decode" << llendl;
+}
+
 const S32 MIN_VIDEO_RAM = 32;
 const S32 MAX_VIDEO_RAM = 512; // 512MB max for performance reasons.
 
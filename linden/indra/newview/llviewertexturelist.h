@@ -28,6 +28,7 @@
 #define LL_LLVIEWERTEXTURELIST_H
 
 #include "lluuid.h"
+#include "lluuidflatmap.h"
 //#include "message.h"
 #include "llgl.h"
 #include "llstat.h"
@@ -35,6 +36,7 @@
 #include "llui.h"
 #include <list>
 #include <set>
+#include <vector>
 
 const U32 LL_IMAGE_REZ_LOSSLESS_CUTOFF = 128;
 
@@ -59,6 +61,58 @@ typedef	void (*LLImageCallback)(BOOL success,
 								BOOL final,
 								void* userdata);
 
+// Fetched textures kept roughly in decode priority order.  Positive
+// priorities go into quarter-octave buckets, everything else into the bottom
+// one, so adding, removing and moving a texture don't depend on how many
+// there are.  Iterating goes from the highest bucket down, in no particular
+// order within a bucket.
+class LLTexturePriorityBuckets
+{
+public:
+	enum { NUM_BUCKETS = 128 };
+
+	class iterator
+	{
+	public:
+		iterator() : mBuckets(NULL), mBucket(-1), mSlot(0) {}
+		iterator(const LLTexturePriorityBuckets* buckets, S32 bucket, U32 slot)
+		:	mBuckets(buckets), mBucket(bucket), mSlot(slot) {}
+
+		LLViewerFetchedTexture* operator*() const	{ return mBuckets->mBuckets[mBucket][mSlot]; }
+		iterator& operator++();
+		iterator operator++(int)					{ iterator tmp = *this; ++*this; return tmp; }
+		bool operator==(const iterator& rhs) const	{ return mBucket == rhs.mBucket && mSlot == rhs.mSlot; }
+		bool operator!=(const iterator& rhs) const	{ return !(*this == rhs); }
+
+	private:
+		const LLTexturePriorityBuckets* mBuckets;
+		S32 mBucket;
+		U32 mSlot;
+	};
+
+	LLTexturePriorityBuckets() : mSize(0) {}
+
+	// Return false if the image was already in / wasn't in
+	bool insert(LLViewerFetchedTexture* image);
+	bool erase(LLViewerFetchedTexture* image);
+	void clear();
+
+	size_t size() const						{ return mSize; }
+	bool empty() const						{ return mSize == 0; }
+	iterator begin() const;
+	iterator end() const					{ return iterator(this, -1, 0); }
+
+	static S32 getBucket(F32 priority);
+
+private:
+	void add(LLViewerFetchedTexture* image, S32 bucket);
+	void remove(LLViewerFetchedTexture* image);
+
+	typedef std::vector<LLPointer<LLViewerFetchedTexture> > bucket_t;
+	bucket_t mBuckets[NUM_BUCKETS];
+	size_t mSize;
+};
+
 class LLViewerTextureList
 {
     LOG_CLASS(LLViewerTextureList);
@@ -69,6 +123,7 @@ class LLViewerTextureList
 public:
 	static BOOL createUploadFile(const std::string& filename, const std::string& out_filename, const U8 codec);
 	static LLPointer<LLImageJ2C> convertToUploadFile(LLPointer<LLImageRaw> raw_image);
+	static void benchmarkCompression();
 	static void processImageNotInDatabase( LLMessageSystem *msg, void **user_data );
 	static S32 calcMaxTextureRAM();
 	static void receiveImageHeader(LLMessageSystem *msg, void **user_data);
@@ -108,6 +163,12 @@ public:
 	void doPreloadImages();
 	void doPrefetchImages();
 
+	// Called by images whose stats have grown enough to matter
+	void dirtyDecodePriority(LLViewerFetchedTexture* image);
+	// Times how long decode priorities take to stop moving from now on,
+	// e.g. after a teleport
+	void startPriorityConvergenceTimer();
+
 	static S32 getMinVideoRamSetting();
 	static S32 getMaxVideoRamSetting(bool get_recommended = false);
 	
@@ -116,6 +177,8 @@ private:
 	F32  updateImagesCreateTextures(F32 max_time);
 	F32  updateImagesFetchTextures(F32 max_time);
 	void updateImagesUpdateStats();
+	// Returns TRUE if the image changed bucket
+	BOOL updateImageDecodePriority(LLViewerFetchedTexture* imagep);
 
 	void addImage(LLViewerFetchedTexture *image);
 	void deleteImage(LLViewerFetchedTexture *image);
@@ -176,14 +239,28 @@ public:
 	BOOL mForceResetTextureStats;
     
 private:
-	typedef std::map< LLUUID, LLPointer<LLViewerFetchedTexture> > uuid_map_t;
+	typedef LLUUIDFlatMap<LLPointer<LLViewerFetchedTexture> > uuid_map_t;
 	uuid_map_t mUUIDMap;
-	LLUUID mLastUpdateUUID;
-	LLUUID mLastFetchUUID;
+	// Round-robin cursors into mUUIDMap; erasing doesn't move entries, so a
+	// slot stays a good place to resume from.
+	size_t mLastUpdateSlot;
+	size_t mLastFetchSlot;
 	
-	typedef std::set<LLPointer<LLViewerFetchedTexture>, LLViewerFetchedTexture::Compare> image_priority_list_t;	
+	typedef LLTexturePriorityBuckets image_priority_list_t;	
 	image_priority_list_t mImageList;
 
+	// Images whose priority needs working out ahead of their turn.  Not
+	// counted references, so queueing doesn't hold off the lazy delete;
+	// deleteImage() takes an image out.
+	std::vector<LLViewerFetchedTexture*> mDirtyPriorityList;
+
+	// Convergence tracking: decode priorities have settled once a full pass
+	// over the images moves hardly any of them and nothing is dirty
+	BOOL mConverging;
+	LLTimer mConvergenceTimer;
+	S32 mSweepUpdates;		// images updated so far in this pass
+	S32 mSweepMoves;		// of those, how many changed bucket
+
 	// simply holds on to LLViewerFetchedTexture references to stop them from being purged too soon
 	std::set<LLPointer<LLViewerFetchedTexture> > mImagePreloads;
 
@@ -39,7 +39,188 @@
 #include "noise.h"
 #include "llregionhandle.h" // for from_region_handle
 #include "llviewercontrol.h"
+#include "llappviewer.h"
+#include "llworkpool.h"
+#include "llv4math.h"
+#include "llvldetailblend.h"
+#include "v2math.h"
 
+#include <list>
+
+static const U32 BASE_SIZE = 128;
+
+// Below this many texels a single generateTexture() runs on the main thread.
+static const S32 MIN_PARALLEL_TEXELS = 64*64;
+// Rows per task when one generateTexture() is split across the pool.
+static const S32 ROWS_PER_TILE = 16;
+
+//============================================================================
+// LLVLCompositionCache
+//
+// Keeps the texels of recently composed patches after their region is gone,
+// keyed by region, position and detail textures, so that coming back to a
+// region doesn't have to fetch and blend the detail textures again.  An entry
+// is only used if the composition values it was made from still hash the
+// same.  Least recently used entries go first once the cache is over
+// TerrainCompositionCacheSize.
+
+class LLVLCompositionCache
+{
+public:
+	struct Key
+	{
+		U64 mRegionHandle;
+		S32 mX;
+		S32 mY;
+		LLUUID mDetailIDs[LLVLComposition::CORNER_COUNT];
+
+		bool operator<(const Key& rhs) const
+		{
+			if (mRegionHandle != rhs.mRegionHandle) return mRegionHandle < rhs.mRegionHandle;
+			if (mX != rhs.mX) return mX < rhs.mX;
+			if (mY != rhs.mY) return mY < rhs.mY;
+			for (S32 i = 0; i < LLVLComposition::CORNER_COUNT; i++)
+			{
+				if (mDetailIDs[i] != rhs.mDetailIDs[i]) return mDetailIDs[i] < rhs.mDetailIDs[i];
+			}
+			return false;
+		}
+	};
+
+	LLVLCompositionCache() : mBytes(0) {}
+
+	// Returns the cached texels, or NULL.
+	const std::vector<U8>* find(const Key& key, U32 checksum);
+	// Takes the contents of texels.
+	void insert(const Key& key, U32 checksum, std::vector<U8>& texels);
+	U32 getMaxBytes() const;
+
+private:
+	void erase(const Key& key);
+
+	struct Entry
+	{
+		U32 mChecksum;
+		std::vector<U8> mTexels;
+		std::list<Key>::iterator mLRU;
+	};
+	typedef std::map<Key, Entry> entry_map_t;
+	entry_map_t mEntries;
+	std::list<Key> mLRU;	// most recently used first
+	U32 mBytes;
+};
+
+static LLVLCompositionCache sCompositionCache;
+
+U32 LLVLCompositionCache::getMaxBytes() const
+{
+	static LLCachedControl<U32> cache_size(gSavedSettings, "TerrainCompositionCacheSize");
+	return (U32)cache_size * 1024;
+}
+
+const std::vector<U8>* LLVLCompositionCache::find(const Key& key, U32 checksum)
+{
+	entry_map_t::iterator iter = mEntries.find(key);
+	if (iter == mEntries.end())
+	{
+		return NULL;
+	}
+	if (iter->second.mChecksum != checksum)
+	{
+		// The terrain or its parameters changed since.
+		erase(key);
+		return NULL;
+	}
+	mLRU.splice(mLRU.begin(), mLRU, iter->second.mLRU);
+	return &iter->second.mTexels;
+}
+
+void LLVLCompositionCache::insert(const Key& key, U32 checksum, std::vector<U8>& texels)
+{
+	erase(key);
+
+	U32 max_bytes = getMaxBytes();
+	if (texels.size() > max_bytes)
+	{
+		return;
+	}
+
+	mLRU.push_front(key);
+	Entry& entry = mEntries[key];
+	entry.mChecksum = checksum;
+	entry.mTexels.swap(texels);
+	entry.mLRU = mLRU.begin();
+	mBytes += entry.mTexels.size();
+
+	while (mBytes > max_bytes)
+	{
+		erase(mLRU.back());
+	}
+}
+
+void LLVLCompositionCache::erase(const Key& key)
+{
+	entry_map_t::iterator iter = mEntries.find(key);
+	if (iter != mEntries.end())
+	{
+		mBytes -= iter->second.mTexels.size();
+		mLRU.erase(iter->second.mLRU);
+		mEntries.erase(iter);
+	}
+}
+
+//============================================================================
+
+// A rectangle of the surface texture, and how it maps onto the composition
+// values and detail textures.  Filled in on the main thread by getTexelArea().
+struct LLVLComposition::TexelArea
+{
+	S32 mXBegin;
+	S32 mYBegin;
+	S32 mXEnd;
+	S32 mYEnd;
+	F32 mRatioX;		// meters per texel
+	F32 mRatioY;
+	F32 mSTStrideX;		// detail texels per texel
+	F32 mSTStrideY;
+	U32 mChecksum;
+	LLVLCompositionCache::Key mKey;
+
+	S32 getWidth() const	{ return mXEnd - mXBegin; }
+	S32 getHeight() const	{ return mYEnd - mYBegin; }
+	S32 getDataSize() const	{ return getWidth() * getHeight() * 3; }
+};
+
+// Composes tiles of rows, each into its own buffer.
+class LLVLComposeTask : public LLWorkPool::Task
+{
+public:
+	LLVLComposeTask(const LLVLComposition& composition) : mComposition(composition) {}
+
+	void addTile(const LLVLComposition::TexelArea* area, S32 row_begin, S32 row_end, U8* texels)
+	{
+		Tile tile = { area, row_begin, row_end, texels };
+		mTiles.push_back(tile);
+	}
+	S32 getCount() const	{ return (S32)mTiles.size(); }
+
+	/*virtual*/ void run(S32 index)
+	{
+		const Tile& tile = mTiles[index];
+		mComposition.composeRows(*tile.mArea, tile.mRowBegin, tile.mRowEnd, tile.mTexels);
+	}
+
+private:
+	struct Tile
+	{
+		const LLVLComposition::TexelArea* mArea;
+		S32 mRowBegin;
+		S32 mRowEnd;
+		U8* mTexels;
+	};
+	const LLVLComposition& mComposition;
+	std::vector<Tile> mTiles;
+};
 
 
 F32 bilinear(const F32 v00, const F32 v01, const F32 v10, const F32 v11, const F32 x_frac, const F32 y_frac)
@@ -143,7 +324,6 @@ BOOL LLVLComposition::generateHeights(const F32 x, const F32 y,
 	// For perlin noise generation...
 	const F32 slope_squared = 1.5f*1.5f;
 	const F32 xyScale = 4.9215f; //0.93284f;
-	const F32 zScale = 4; //0.92165f;
 	const F32 z_offset = 0.f;
 	const F32 noise_magnitude = 2.f;		//  Degree to which noise modulates composition layer (versus
 											//  simple height)
@@ -153,63 +333,83 @@ BOOL LLVLComposition::generateHeights(const F32 x, const F32 y,
 	const S32 NUM_TEXTURES = 4;
 
 	const F32 xyScaleInv = (1.f / xyScale);
-	const F32 zScaleInv = (1.f / zScale);
 
 	const F32 inv_width = 1.f/mWidth;
 
+	// Noise lookups are done four texels at a time.  A short run at the end
+	// of a row repeats its last texel to fill the group.
+	F32 heights[4];
+	F32 low_x[4], low_y[4], low_noise[4];
+	F32 high_x[4], high_y[4], high_noise[4];
+	F32 base_x[4], base_y[4], base_noise[4];
+
 	// OK, for now, just have the composition value equal the height at the point.
 	for (S32 j = y_begin; j < y_end; j++)
 	{
-		for (S32 i = x_begin; i < x_end; i++)
+		for (S32 i = x_begin; i < x_end; i += 4)
 		{
+			S32 count = llmin(4, x_end - i);
+			for (S32 k = 0; k < 4; k++)
+			{
+				LLVector3 location((i + llmin(k, count - 1))*mScale, j*mScale, 0.f);
+
+				heights[k] = mSurfacep->resolveHeightRegion(location) + z_offset;
+
+				// Step 0: Measure the exact height at this texel
+				F32 vec_x = (F32)(origin_global.mdV[VX]+location.mV[VX])*xyScaleInv;	//  Adjust to non-integer lattice
+				F32 vec_y = (F32)(origin_global.mdV[VY]+location.mV[VY])*xyScaleInv;
+
+				// Low frequency noise2(vec * 0.22), and the two octaves of
+				// turbulence2(vec, 2).
+				low_x[k] = vec_x*(0.2222222222f);
+				low_y[k] = vec_y*(0.2222222222f);
+				high_x[k] = 2.f*vec_x;
+				high_y[k] = 2.f*vec_y;
+				base_x[k] = vec_x;
+				base_y[k] = vec_y;
+			}
+			noise2v(low_x, low_y, low_noise);
+			noise2v(high_x, high_y, high_noise);
+			noise2v(base_x, base_y, base_noise);
 
-			F32 vec[3];
-			F32 vec1[3];
-			F32 twiddle;
-
-			// Bilinearly interpolate the start height and height range of the textures
-			F32 start_height = bilinear(mStartHeight[SOUTHWEST],
-										mStartHeight[SOUTHEAST],
-										mStartHeight[NORTHWEST],
-										mStartHeight[NORTHEAST],
-										i*inv_width, j*inv_width); // These will be bilinearly interpolated
-			F32 height_range = bilinear(mHeightRange[SOUTHWEST],
-										mHeightRange[SOUTHEAST],
-										mHeightRange[NORTHWEST],
-										mHeightRange[NORTHEAST],
-										i*inv_width, j*inv_width); // These will be bilinearly interpolated
-
-			LLVector3 location(i*mScale, j*mScale, 0.f);
-
-			F32 height = mSurfacep->resolveHeightRegion(location) + z_offset;
-
-			// Step 0: Measure the exact height at this texel
-			vec[0] = (F32)(origin_global.mdV[VX]+location.mV[VX])*xyScaleInv;	//  Adjust to non-integer lattice
-			vec[1] = (F32)(origin_global.mdV[VY]+location.mV[VY])*xyScaleInv;
-			vec[2] = height*zScaleInv;
-			//
-			//  Choose material value by adding to the exact height a random value 
-			//
-			vec1[0] = vec[0]*(0.2222222222f);
-			vec1[1] = vec[1]*(0.2222222222f);
-			vec1[2] = vec[2]*(0.2222222222f);
-			twiddle = noise2(vec1)*6.5f;					//  Low freq component for large divisions
-
-			twiddle += turbulence2(vec, 2)*slope_squared;	//  High frequency component
-			twiddle *= noise_magnitude;
-
-			F32 scaled_noisy_height = (height + twiddle - start_height) * F32(NUM_TEXTURES) / height_range;
-
-			scaled_noisy_height = llmax(0.f, scaled_noisy_height);
-			scaled_noisy_height = llmin(3.f, scaled_noisy_height);
-			*(mDatap + i + j*mWidth) = scaled_noisy_height;
+			for (S32 k = 0; k < count; k++)
+			{
+				S32 ii = i + k;
+
+				// Bilinearly interpolate the start height and height range of the textures
+				F32 start_height = bilinear(mStartHeight[SOUTHWEST],
+											mStartHeight[SOUTHEAST],
+											mStartHeight[NORTHWEST],
+											mStartHeight[NORTHEAST],
+											ii*inv_width, j*inv_width); // These will be bilinearly interpolated
+				F32 height_range = bilinear(mHeightRange[SOUTHWEST],
+											mHeightRange[SOUTHEAST],
+											mHeightRange[NORTHWEST],
+											mHeightRange[NORTHEAST],
+											ii*inv_width, j*inv_width); // These will be bilinearly interpolated
+
+				//
+				//  Choose material value by adding to the exact height a random value 
+				//
+				F32 twiddle = low_noise[k]*6.5f;				//  Low freq component for large divisions
+
+				F32 turbulence = 0.f;
+				turbulence += high_noise[k]/2.f;
+				turbulence += base_noise[k]/1.f;
+				twiddle += turbulence*slope_squared;			//  High frequency component
+				twiddle *= noise_magnitude;
+
+				F32 scaled_noisy_height = (heights[k] + twiddle - start_height) * F32(NUM_TEXTURES) / height_range;
+
+				scaled_noisy_height = llmax(0.f, scaled_noisy_height);
+				scaled_noisy_height = llmin(3.f, scaled_noisy_height);
+				*(mDatap + ii + j*mWidth) = scaled_noisy_height;
+			}
 		}
 	}
 	return TRUE;
 }
 
-static const U32 BASE_SIZE = 128;
-
 BOOL LLVLComposition::generateComposition()
 {
 
@@ -249,25 +449,9 @@ BOOL LLVLComposition::generateComposition()
 	return TRUE;
 }
 
-BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
-									  const F32 width, const F32 height)
+// Reads back the detail textures at BASE_SIZE.  Main thread only.
+BOOL LLVLComposition::loadDetailImages()
 {
-	llassert(mSurfacep);
-	llassert(x >= 0.f);
-	llassert(y >= 0.f);
-
-	LLTimer gen_timer;
-
-	///////////////////////////
-	//
-	// Generate raw data arrays for surface textures
-	//
-	//
-
-	// These have already been validated by generateComposition.
-	U8* st_data[4];
-	S32 st_data_size[4]; // for debugging
-
 	for (S32 i = 0; i < 4; i++)
 	{
 		if (mRawImages[i].isNull())
@@ -306,10 +490,13 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 				mRawImages[i] = newraw; // deletes old
 			}
 		}
-		st_data[i] = mRawImages[i]->getData();
-		st_data_size[i] = mRawImages[i]->getDataSize();
 	}
+	return TRUE;
+}
 
+BOOL LLVLComposition::getTexelArea(LLViewerTexture* texturep, const F32 x, const F32 y,
+								   const F32 width, const F32 height, TexelArea& area) const
+{
 	///////////////////////////////////////
 	//
 	// Generate and clamp x/y bounding box.
@@ -333,25 +520,15 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 		y_end = mWidth;
 	}
 
-
 	///////////////////////////////////////////
 	//
 	// Generate target texture information, stride ratios.
 	//
 	//
 
-	LLViewerTexture *texturep;
-	U32 tex_width, tex_height, tex_comps;
-	U32 tex_stride;
-	F32 tex_x_scalef, tex_y_scalef;
-	S32 tex_x_begin, tex_y_begin, tex_x_end, tex_y_end;
-	F32 tex_x_ratiof, tex_y_ratiof;
-
-	texturep = mSurfacep->getSTexture();
-	tex_width = texturep->getWidth();
-	tex_height = texturep->getHeight();
-	tex_comps = texturep->getComponents();
-	tex_stride = tex_width * tex_comps;
+	U32 tex_width = texturep->getWidth();
+	U32 tex_height = texturep->getHeight();
+	U32 tex_comps = texturep->getComponents();
 
 	U32 st_comps = 3;
 	U32 st_width = BASE_SIZE;
@@ -363,28 +540,97 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 		return FALSE;
 	}
 
-	tex_x_scalef = (F32)tex_width / (F32)mWidth;
-	tex_y_scalef = (F32)tex_height / (F32)mWidth;
-	tex_x_begin = (S32)((F32)x_begin * tex_x_scalef);
-	tex_y_begin = (S32)((F32)y_begin * tex_y_scalef);
-	tex_x_end = (S32)((F32)x_end * tex_x_scalef);
-	tex_y_end = (S32)((F32)y_end * tex_y_scalef);
+	F32 tex_x_scalef = (F32)tex_width / (F32)mWidth;
+	F32 tex_y_scalef = (F32)tex_height / (F32)mWidth;
+	area.mXBegin = (S32)((F32)x_begin * tex_x_scalef);
+	area.mYBegin = (S32)((F32)y_begin * tex_y_scalef);
+	area.mXEnd = (S32)((F32)x_end * tex_x_scalef);
+	area.mYEnd = (S32)((F32)y_end * tex_y_scalef);
 
-	tex_x_ratiof = (F32)mWidth*mScale / (F32)tex_width;
-	tex_y_ratiof = (F32)mWidth*mScale / (F32)tex_height;
+	area.mRatioX = (F32)mWidth*mScale / (F32)tex_width;
+	area.mRatioY = (F32)mWidth*mScale / (F32)tex_height;
 
-	LLPointer<LLImageRaw> raw = new LLImageRaw(tex_width, tex_height, tex_comps);
-	U8 *rawp = raw->getData();
+	area.mSTStrideX = ((F32)st_width / (F32)mTexScaleX)*((F32)mWidth / (F32)tex_width);
+	area.mSTStrideY = ((F32)st_height / (F32)mTexScaleY)*((F32)mWidth / (F32)tex_height);
+
+	llassert(area.mSTStrideX > 0.f);
+	llassert(area.mSTStrideY > 0.f);
+
+	area.mKey.mRegionHandle = mSurfacep->getRegion()->getHandle();
+	area.mKey.mX = area.mXBegin;
+	area.mKey.mY = area.mYBegin;
+	for (S32 i = 0; i < CORNER_COUNT; i++)
+	{
+		area.mKey.mDetailIDs[i] = mDetailTextures[i]->getID();
+	}
+	area.mChecksum = getChecksum(area);
+	return TRUE;
+}
+
+// FNV-1a over the area and every composition value composeRows() reads for it.
+U32 LLVLComposition::getChecksum(const TexelArea& area) const
+{
+	U32 hash = 2166136261U;
+	U32 words[6] = { (U32)area.mXEnd, (U32)area.mYEnd, 0, 0, 0, 0 };
+	memcpy(&words[2], &area.mRatioX, sizeof(F32));
+	memcpy(&words[3], &area.mRatioY, sizeof(F32));
+	memcpy(&words[4], &area.mSTStrideX, sizeof(F32));
+	memcpy(&words[5], &area.mSTStrideY, sizeof(F32));
+	for (S32 i = 0; i < 6; i++)
+	{
+		hash = (hash ^ words[i]) * 16777619U;
+	}
+	if (area.getWidth() <= 0 || area.getHeight() <= 0)
+	{
+		return hash;
+	}
+
+	// The samples getValueScaled() interpolates between
+	S32 x_lo = llclamp(llfloor(area.mXBegin*area.mRatioX*mScaleInv), 0, mWidth - 1);
+	S32 x_hi = llclamp(llfloor((area.mXEnd - 1)*area.mRatioX*mScaleInv) + 1, 0, mWidth - 1);
+	S32 y_lo = llclamp(llfloor(area.mYBegin*area.mRatioY*mScaleInv), 0, mWidth - 1);
+	S32 y_hi = llclamp(llfloor((area.mYEnd - 1)*area.mRatioY*mScaleInv) + 1, 0, mWidth - 1);
+	for (S32 j = y_lo; j <= y_hi; j++)
+	{
+		for (S32 i = x_lo; i <= x_hi; i++)
+		{
+			U32 bits;
+			memcpy(&bits, mDatap + i + j*mWidth, sizeof(U32));
+			hash = (hash ^ bits) * 16777619U;
+		}
+	}
+	return hash;
+}
 
-	F32 tex_width_inv = 1.f/tex_width;
-	F32 tex_height_inv = 1.f/tex_height;
+// Composes rows [row_begin, row_end) of the area into texels, which holds
+// the whole area.  Each tile of rows gives the same result it would as part
+// of one pass over the area.
+void LLVLComposition::composeRows(const TexelArea& area, S32 row_begin, S32 row_end, U8* texels) const
+{
+	// These have already been validated by generateComposition.
+	const U8* st_data[4];
+	S32 st_data_size[4];
+	for (S32 i = 0; i < 4; i++)
+	{
+		st_data[i] = mRawImages[i]->getData();
+		st_data_size[i] = mRawImages[i]->getDataSize();
+	}
 
-	F32 st_x_stride, st_y_stride;
-	st_x_stride = ((F32)st_width / (F32)mTexScaleX)*((F32)mWidth / (F32)tex_width);
-	st_y_stride = ((F32)st_height / (F32)mTexScaleY)*((F32)mWidth / (F32)tex_height);
+	const U32 st_width = BASE_SIZE;
+	const U32 st_height = BASE_SIZE;
+	const U32 tex_comps = 3;
+	const U32 tex_stride = area.getWidth() * tex_comps;
+	const S32 tex_x_begin = area.mXBegin;
+	const S32 tex_x_end = area.mXEnd;
+	const S32 tex_y_begin = area.mYBegin;
+	const F32 tex_x_ratiof = area.mRatioX;
+	const F32 tex_y_ratiof = area.mRatioY;
+	const F32 st_x_stride = area.mSTStrideX;
+	const F32 st_y_stride = area.mSTStrideY;
+
+	const LLVLDetailBlend blend(st_data, st_data_size, st_width);
+	std::vector<F32> composition(llmax(area.getWidth(), 1));
 
-	llassert(st_x_stride > 0.f);
-	llassert(st_y_stride > 0.f);
 	////////////////////////////////
 	//
 	// Iterate through the target texture, striding through the
@@ -393,72 +639,214 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 	//
 
 	F32 sti, stj;
-	S32 st_offset;
-	sti = (tex_x_begin * st_x_stride) - st_width*(llfloor((tex_x_begin * st_x_stride)/st_width));
 	stj = (tex_y_begin * st_y_stride) - st_height*(llfloor((tex_y_begin * st_y_stride)/st_height));
+	for (S32 j = tex_y_begin; j < row_begin; j++)
+	{
+		// Step to the first row the same way the loop below would
+		stj += st_y_stride;
+		if (stj >= st_height)
+		{
+			stj -= st_height;
+		}
+	}
 
-	st_offset = (llfloor(stj * st_width) + llfloor(sti)) * st_comps;
-	for (S32 j = tex_y_begin; j < tex_y_end; j++)
+	for (S32 j = row_begin; j < row_end; j++)
 	{
-		U32 offset = j * tex_stride + tex_x_begin * tex_comps;
+		S32 i = tex_x_begin;
+
+#if LL_VECTORIZE
+		// Bilinear filter of the composition values four texels at a time,
+		// in the same order as getValueScaled().
+		F32 y_frac = j*tex_y_ratiof*mScaleInv;
+		S32 y1 = llfloor(y_frac);
+		S32 y2 = y1 + 1;
+		y_frac -= y1;
+		y1 = llclamp(y1, 0, mWidth - 1);
+		y2 = llclamp(y2, 0, mWidth - 1);
+		const F32* row1 = mDatap + y1 * mWidth;
+		const F32* row2 = mDatap + y2 * mWidth;
+		const __m128 v_y_frac = _mm_set1_ps(y_frac);
+
+		for (; i + 4 <= tex_x_end; i += 4)
+		{
+			F32 x_frac[4], row1_left[4], row1_right[4], row2_left[4], row2_right[4];
+			for (S32 k = 0; k < 4; k++)
+			{
+				F32 x_f = (i + k)*tex_x_ratiof*mScaleInv;
+				S32 x1 = llfloor(x_f);
+				S32 x2 = x1 + 1;
+				x_frac[k] = x_f - x1;
+				x1 = llclamp(x1, 0, mWidth - 1);
+				x2 = llclamp(x2, 0, mWidth - 1);
+				row1_left[k] = row1[x1];
+				row1_right[k] = row1[x2];
+				row2_left[k] = row2[x1];
+				row2_right[k] = row2[x2];
+			}
+			__m128 v_x_frac = _mm_loadu_ps(x_frac);
+			__m128 v_row1 = _mm_loadu_ps(row1_left);
+			__m128 v_row2 = _mm_loadu_ps(row2_left);
+			v_row1 = _mm_sub_ps(v_row1, _mm_mul_ps(v_x_frac, _mm_sub_ps(v_row1, _mm_loadu_ps(row1_right))));
+			v_row2 = _mm_sub_ps(v_row2, _mm_mul_ps(v_x_frac, _mm_sub_ps(v_row2, _mm_loadu_ps(row2_right))));
+			_mm_storeu_ps(&composition[i - tex_x_begin], _mm_sub_ps(v_row1, _mm_mul_ps(v_y_frac, _mm_sub_ps(v_row1, v_row2))));
+		}
+#endif
+
+		for (; i < tex_x_end; i++)
+		{
+			composition[i - tex_x_begin] = getValueScaled(i*tex_x_ratiof, j*tex_y_ratiof);
+		}
+
 		sti = (tex_x_begin * st_x_stride) - st_width*((U32)(tex_x_begin * st_x_stride)/st_width);
-		for (S32 i = tex_x_begin; i < tex_x_end; i++)
+		blend.blendRow(&composition[0], tex_x_end - tex_x_begin, sti, stj, st_x_stride,
+					   texels + (j - tex_y_begin) * tex_stride);
+
+		stj += st_y_stride;
+		if (stj >= st_height)
+		{
+			stj -= st_height;
+		}
+	}
+}
+
+BOOL LLVLComposition::hasCachedTexture(const F32 x, const F32 y,
+									   const F32 width, const F32 height)
+{
+	llassert(mSurfacep);
+
+	TexelArea area;
+	if (!getTexelArea(mSurfacep->getSTexture(), x, y, width, height, area))
+	{
+		return FALSE;
+	}
+	const std::vector<U8>* texels = sCompositionCache.find(area.mKey, area.mChecksum);
+	return texels && (S32)texels->size() == area.getDataSize();
+}
+
+void LLVLComposition::precomposeTextures(const std::vector<LLVector2>& origins, const F32 size, LLWorkPool* pool)
+{
+	llassert(mSurfacep);
+
+	LLViewerTexture *texturep = mSurfacep->getSTexture();
+	std::vector<TexelArea> areas;
+	areas.reserve(origins.size());
+	for (U32 k = 0; k < origins.size(); k++)
+	{
+		TexelArea area;
+		if (getTexelArea(texturep, origins[k].mV[VX], origins[k].mV[VY], size, size, area)
+			&& area.getDataSize() > 0
+			&& (U32)area.getDataSize() <= sCompositionCache.getMaxBytes()
+			&& !sCompositionCache.find(area.mKey, area.mChecksum))
 		{
-			S32 tex0, tex1;
-			F32 composition = getValueScaled(i*tex_x_ratiof, j*tex_y_ratiof);
+			areas.push_back(area);
+		}
+	}
+	if (areas.empty() || !loadDetailImages())
+	{
+		return;
+	}
 
-			tex0 = llfloor( composition );
-			tex0 = llclamp(tex0, 0, 3);
-			composition -= tex0;
-			tex1 = tex0 + 1;
-			tex1 = llclamp(tex1, 0, 3);
+	std::vector< std::vector<U8> > texels(areas.size());
+	LLVLComposeTask task(*this);
+	for (U32 k = 0; k < areas.size(); k++)
+	{
+		texels[k].resize(areas[k].getDataSize(), 0);
+		task.addTile(&areas[k], areas[k].mYBegin, areas[k].mYEnd, &texels[k][0]);
+	}
+	pool->parallelFor(task, task.getCount());
 
-			F32 xy_int_i, xy_int_j;
+	for (U32 k = 0; k < areas.size(); k++)
+	{
+		sCompositionCache.insert(areas[k].mKey, areas[k].mChecksum, texels[k]);
+	}
+}
 
-			xy_int_i = i * tex_width_inv;
-			xy_int_j = j * tex_height_inv;
+BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
+									  const F32 width, const F32 height)
+{
+	llassert(mSurfacep);
+	llassert(x >= 0.f);
+	llassert(y >= 0.f);
 
-			st_offset = (lltrunc(sti) + lltrunc(stj)*st_width) * st_comps;
-			for (U32 k = 0; k < tex_comps; k++)
+	LLTimer gen_timer;
+
+	LLViewerTexture *texturep = mSurfacep->getSTexture();
+	TexelArea area;
+	if (!getTexelArea(texturep, x, y, width, height, area))
+	{
+		return FALSE;
+	}
+
+	///////////////////////////
+	//
+	// Reuse the cached texels, or compose them from the detail textures.
+	//
+	//
+
+	std::vector<U8> composed;
+	const std::vector<U8>* texels = sCompositionCache.find(area.mKey, area.mChecksum);
+	if (!texels || (S32)texels->size() != area.getDataSize())
+	{
+		// The entry updateTexture() found may have been evicted since, so
+		// the detail textures are not known to be loaded.
+		if (!generateComposition() || !loadDetailImages())
+		{
+			return FALSE;
+		}
+
+		composed.resize(area.getDataSize(), 0);
+		if (!composed.empty())
+		{
+			LLWorkPool *pool = LLAppViewer::getWorkPool();
+			if (pool && pool->getNumThreads() > 0
+				&& area.getWidth() * area.getHeight() >= MIN_PARALLEL_TEXELS)
 			{
-				// Linearly interpolate based on composition.
-				if (st_offset >= st_data_size[tex0] || st_offset >= st_data_size[tex1])
-				{
-					// SJB: This shouldn't be happening, but does... Rounding error?
-					//llwarns << "offset 0 [" << tex0 << "] =" << st_offset << " >= size=" << st_data_size[tex0] << llendl;
-					//llwarns << "offset 1 [" << tex1 << "] =" << st_offset << " >= size=" << st_data_size[tex1] << llendl;
-				}
-				else
+				LLVLComposeTask task(*this);
+				for (S32 row = area.mYBegin; row < area.mYEnd; row += ROWS_PER_TILE)
 				{
-					F32 a = *(st_data[tex0] + st_offset);
-					F32 b = *(st_data[tex1] + st_offset);
-					rawp[ offset ] = (U8)lltrunc( a + composition * (b - a) );
+					task.addTile(&area, row, llmin(row + ROWS_PER_TILE, area.mYEnd), &composed[0]);
 				}
-				offset++;
-				st_offset++;
+				pool->parallelFor(task, task.getCount());
 			}
-
-			sti += st_x_stride;
-			if (sti >= st_width)
+			else
 			{
-				sti -= st_width;
+				composeRows(area, area.mYBegin, area.mYEnd, &composed[0]);
 			}
 		}
 
-		stj += st_y_stride;
-		if (stj >= st_height)
-		{
-			stj -= st_height;
-		}
+		// Keep a copy; composed is what gets uploaded below.
+		std::vector<U8> cached(composed);
+		sCompositionCache.insert(area.mKey, area.mChecksum, cached);
+		texels = &composed;
+	}
+
+	///////////////////////////
+	//
+	// Upload
+	//
+	//
+
+	U32 tex_width = texturep->getWidth();
+	U32 tex_height = texturep->getHeight();
+	U32 tex_comps = texturep->getComponents();
+	U32 tex_stride = tex_width * tex_comps;
+
+	LLPointer<LLImageRaw> raw = new LLImageRaw(tex_width, tex_height, tex_comps);
+	U8 *rawp = raw->getData();
+	U32 row_bytes = area.getWidth() * tex_comps;
+	for (S32 j = 0; j < area.getHeight() && row_bytes > 0; j++)
+	{
+		memcpy(rawp + (area.mYBegin + j) * tex_stride + area.mXBegin * tex_comps,
+			   &(*texels)[j * row_bytes], row_bytes);
 	}
 
 	if (!texturep->hasGLTexture())
 	{
 		texturep->createGLTexture(0, raw);
 	}
-	texturep->setSubImage(raw, tex_x_begin, tex_y_begin, tex_x_end - tex_x_begin, tex_y_end - tex_y_begin);
+	texturep->setSubImage(raw, area.mXBegin, area.mYBegin, area.getWidth(), area.getHeight());
 	LLSurface::sTextureUpdateTime += gen_timer.getElapsedTimeF32();
-	LLSurface::sTexelsUpdated += (tex_x_end - tex_x_begin) * (tex_y_end - tex_y_begin);
+	LLSurface::sTexelsUpdated += area.getWidth() * area.getHeight();
 
 	for (S32 i = 0; i < 4; i++)
 	{
@@ -31,6 +31,8 @@
 #include "llviewertexture.h"
 
 class LLSurface;
+class LLVector2;
+class LLWorkPool;
 
 class LLVLComposition : public LLViewerLayer
 {
@@ -45,6 +47,12 @@ public:
 	BOOL generateComposition();
 	// Generate texture from composition values.
 	BOOL generateTexture(const F32 x, const F32 y, const F32 width, const F32 height);		
+	// TRUE if generateTexture() can reuse texels composed earlier for this
+	// area, without needing the detail textures.
+	BOOL hasCachedTexture(const F32 x, const F32 y, const F32 width, const F32 height);
+	// Composes the textures for several square areas at once on the pool and
+	// caches them, so the generateTexture() calls that follow just upload.
+	void precomposeTextures(const std::vector<LLVector2>& origins, const F32 size, LLWorkPool* pool);
 
 	// Use these as indeces ito the get/setters below that use 'corner'
 	enum ECorner
@@ -69,6 +77,17 @@ public:
 	void setParamsReady()		{ mParamsReady = TRUE; }
 	BOOL getParamsReady() const	{ return mParamsReady; }
 protected:
+	struct TexelArea;
+	friend class LLVLComposeTask;
+
+	BOOL getTexelArea(LLViewerTexture* texturep, const F32 x, const F32 y,
+					  const F32 width, const F32 height, TexelArea& area) const;
+	U32 getChecksum(const TexelArea& area) const;
+	BOOL loadDetailImages();
+	// Only reads the composition and detail images, so it may run on a
+	// worker thread once loadDetailImages() has succeeded.
+	void composeRows(const TexelArea& area, S32 row_begin, S32 row_end, U8* texels) const;
+
 	BOOL mParamsReady;
 	LLSurface *mSurfacep;
 	BOOL mTexturesLoaded;
@@ -0,0 +1,135 @@
+/**
+ * @file llvldetailblend.cpp
+ * @brief Blends the terrain detail textures along a row of the surface texture.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llvldetailblend.h"
+
+#include "llmath.h"
+#include "llv4math.h"
+
+static const S32 DETAIL_COMPS = 3;
+
+LLVLDetailBlend::LLVLDetailBlend(const U8* const data[IMAGE_COUNT], const S32 data_size[IMAGE_COUNT], U32 width)
+	: mWidth(width)
+{
+	for (S32 i = 0; i < IMAGE_COUNT; i++)
+	{
+		mData[i] = data[i];
+		mDataSize[i] = data_size[i];
+	}
+}
+
+// Picks the two images for a composition value and where to sample them.
+// Returns FALSE if the sample doesn't lie wholly inside both images.
+// SJB: This shouldn't be happening, but does... Rounding error?
+static inline BOOL get_samples(F32 composition, F32 sti, S32 row_offset,
+							   const S32* data_size, S32& tex0, S32& tex1, F32& weight, S32& st_offset)
+{
+	tex0 = llclamp(llfloor(composition), 0, 3);
+	tex1 = llclamp(tex0 + 1, 0, 3);
+	weight = composition - tex0;
+	st_offset = (lltrunc(sti) + row_offset) * DETAIL_COMPS;
+	return st_offset + DETAIL_COMPS - 1 < data_size[tex0]
+		&& st_offset + DETAIL_COMPS - 1 < data_size[tex1];
+}
+
+void LLVLDetailBlend::blendRowScalar(const F32* composition, S32 count, F32& sti, F32 stj, F32 x_stride, U8* texels) const
+{
+	const S32 row_offset = lltrunc(stj) * mWidth;
+	for (S32 i = 0; i < count; i++)
+	{
+		S32 tex0, tex1, st_offset;
+		F32 weight;
+		if (get_samples(composition[i], sti, row_offset, mDataSize, tex0, tex1, weight, st_offset))
+		{
+			for (S32 c = 0; c < DETAIL_COMPS; c++)
+			{
+				// Linearly interpolate based on composition.
+				F32 a = mData[tex0][st_offset + c];
+				F32 b = mData[tex1][st_offset + c];
+				texels[c] = (U8)lltrunc(a + weight * (b - a));
+			}
+		}
+		texels += DETAIL_COMPS;
+
+		sti += x_stride;
+		if (sti >= mWidth)
+		{
+			sti -= mWidth;
+		}
+	}
+}
+
+void LLVLDetailBlend::blendRow(const F32* composition, S32 count, F32& sti, F32 stj, F32 x_stride, U8* texels) const
+{
+	S32 i = 0;
+
+#if LL_VECTORIZE
+	// Twelve components at a time: a + weight * (b - a)
+	const S32 row_offset = lltrunc(stj) * mWidth;
+	F32 a[12], b[12], weight[12], result[12];
+	BOOL valid[4];
+	for (; i + 4 <= count; i += 4)
+	{
+		for (S32 k = 0; k < 4; k++)
+		{
+			S32 tex0, tex1, st_offset;
+			F32 w;
+			valid[k] = get_samples(composition[i + k], sti, row_offset, mDataSize, tex0, tex1, w, st_offset);
+			for (S32 c = 0; c < DETAIL_COMPS; c++)
+			{
+				S32 n = k*DETAIL_COMPS + c;
+				a[n] = valid[k] ? mData[tex0][st_offset + c] : 0.f;
+				b[n] = valid[k] ? mData[tex1][st_offset + c] : 0.f;
+				weight[n] = w;
+			}
+
+			sti += x_stride;
+			if (sti >= mWidth)
+			{
+				sti -= mWidth;
+			}
+		}
+		for (S32 n = 0; n < 12; n += 4)
+		{
+			__m128 v_a = _mm_loadu_ps(a + n);
+			__m128 v_b = _mm_loadu_ps(b + n);
+			_mm_storeu_ps(result + n, _mm_add_ps(v_a, _mm_mul_ps(_mm_loadu_ps(weight + n), _mm_sub_ps(v_b, v_a))));
+		}
+		for (S32 n = 0; n < 12; n++)
+		{
+			if (valid[n / DETAIL_COMPS])
+			{
+				texels[n] = (U8)lltrunc(result[n]);
+			}
+		}
+		texels += 12;
+	}
+#endif
+
+	blendRowScalar(composition + i, count - i, sti, stj, x_stride, texels);
+}
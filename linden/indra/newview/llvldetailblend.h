@@ -0,0 +1,64 @@
+/**
+ * @file llvldetailblend.h
+ * @brief Blends the terrain detail textures along a row of the surface texture.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVLDETAILBLEND_H
+#define LL_LLVLDETAILBLEND_H
+
+//============================================================================
+// LLVLDetailBlend
+//
+// The inner loop of LLVLComposition::composeRows(): for each texel of a row,
+// the composition value picks two neighbouring detail images and how far to
+// blend from the first to the second, and the detail images are stepped
+// through with wrap around.  The detail images are square, 3 components.
+//
+// A texel whose detail sample would fall past the end of either image is
+// left as it was.
+
+class LLVLDetailBlend
+{
+public:
+	enum { IMAGE_COUNT = 4 };
+
+	// data and data_size are copied; the images themselves must outlive this.
+	LLVLDetailBlend(const U8* const data[IMAGE_COUNT], const S32 data_size[IMAGE_COUNT], U32 width);
+
+	// Writes count texels (3 bytes each) to texels from count composition
+	// values.  sti is the column in the detail images, advanced by x_stride
+	// per texel and left where the next texel of the row would start; stj is
+	// the row.  Four texels at a time under LL_VECTORIZE.
+	void blendRow(const F32* composition, S32 count, F32& sti, F32 stj, F32 x_stride, U8* texels) const;
+
+	// The same, one texel at a time whatever the build.
+	void blendRowScalar(const F32* composition, S32 count, F32& sti, F32 stj, F32 x_stride, U8* texels) const;
+
+private:
+	const U8* mData[IMAGE_COUNT];
+	S32 mDataSize[IMAGE_COUNT];
+	U32 mWidth;
+};
+
+#endif // LL_LLVLDETAILBLEND_H
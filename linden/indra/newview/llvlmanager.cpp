@@ -32,12 +32,47 @@
 #include "bitpack.h"
 #include "patch_code.h"
 #include "patch_dct.h"
+#include "llappviewer.h"
+#include "llviewercontrol.h"
 #include "llviewerregion.h"
 #include "llframetimer.h"
 #include "llsurface.h"
+#include "llsurfacepatch.h"
+#include "llworkpool.h"
 
 LLVLManager gVLManager;
 
+// Runs the inverse DCT of queued patches straight into their height fields.
+// Every patch owns a distinct block of the surface, so they can't collide.
+class LLVLPatchDecodeTask : public LLWorkPool::Task
+{
+public:
+	LLVLPatchDecodeTask(std::vector<LLVLPatchDecode> &decodes, S32 patch_size)
+		: mDecodes(decodes),
+		  mPatchSize(patch_size)
+	{
+	}
+
+	/*virtual*/ void run(S32 index)
+	{
+		LLVLPatchDecode &decode = mDecodes[index];
+		decompress_patch(decode.mPatchp->getDataZ(), decode.mCoefficients,
+						 &decode.mHeader, mPatchSize, decode.mStride);
+	}
+
+private:
+	std::vector<LLVLPatchDecode> &mDecodes;
+	S32 mPatchSize;
+};
+
+LLVLManager::LLVLManager()
+:	mNumPatchDecodes(0),
+	mPatchDecodeSize(0),
+	mPatchDecodePool(NULL),
+	mCaptureFile(NULL)
+{
+}
+
 LLVLManager::~LLVLManager()
 {
 	S32 i;
@@ -46,6 +81,9 @@ LLVLManager::~LLVLManager()
 		delete mPacketData[i];
 	}
 	mPacketData.reset();
+
+	delete mCaptureFile;
+	mCaptureFile = NULL;
 }
 
 void LLVLManager::addLayerData(LLVLData *vl_datap, const S32 mesg_size)
@@ -67,13 +105,29 @@ void LLVLManager::addLayerData(LLVLData *vl_datap, const S32 mesg_size)
 		llerrs << "Unknown layer type!" << (S32)vl_datap->mType << llendl;
 	}
 
+	static LLCachedControl<bool> capture_layer_data(gSavedSettings, "CaptureLayerData");
+	if (capture_layer_data)
+	{
+		captureLayerData(vl_datap);
+	}
+	else if (mCaptureFile)
+	{
+		delete mCaptureFile;
+		mCaptureFile = NULL;
+	}
+
 	mPacketData.put(vl_datap);
 }
 
 void LLVLManager::unpackData(const S32 num_packets)
 {
-	static LLFrameTimer decode_timer;
-	
+	unpackPackets(LLAppViewer::getWorkPool());
+}
+
+S32 LLVLManager::unpackPackets(LLWorkPool *pool)
+{
+	S32 num_patches = 0;
+	mPatchDecodePool = pool;
 	S32 i;
 	for (i = 0; i < mPacketData.count(); i++)
 	{
@@ -85,7 +139,8 @@ void LLVLManager::unpackData(const S32 num_packets)
 		decode_patch_group_header(bit_pack, &goph);
 		if (LAND_LAYER_CODE == datap->mType)
 		{
-			datap->mRegionp->getLand().decompressDCTPatch(bit_pack, &goph, FALSE);
+			num_patches += datap->mRegionp->getLand().decompressDCTPatch(bit_pack, &goph, FALSE,
+																		 pool ? this : NULL);
 		}
 		else if (WIND_LAYER_CODE == datap->mType)
 		{
@@ -98,12 +153,164 @@ void LLVLManager::unpackData(const S32 num_packets)
 		}
 	}
 
+	flushPatchDecodes(pool);
+	mPatchDecodePool = NULL;
+
 	for (i = 0; i < mPacketData.count(); i++)
 	{
 		delete mPacketData[i];
 	}
 	mPacketData.reset();
 
+	return num_patches;
+}
+
+LLVLPatchDecode *LLVLManager::queuePatchDecode(LLSurfacePatch *patchp, S32 patch_size, S32 stride)
+{
+	// The decompressor tables are built for one patch size at a time.
+	if (mNumPatchDecodes && patch_size != mPatchDecodeSize)
+	{
+		flushPatchDecodes(mPatchDecodePool);
+	}
+	mPatchDecodeSize = patch_size;
+
+	std::map<LLSurfacePatch *, S32>::iterator iter = mPatchDecodeIndex.find(patchp);
+	if (iter != mPatchDecodeIndex.end())
+	{
+		return &mPatchDecodes[iter->second];
+	}
+
+	if (mNumPatchDecodes == (S32)mPatchDecodes.size())
+	{
+		mPatchDecodes.resize(mNumPatchDecodes + 16);
+	}
+	LLVLPatchDecode *decodep = &mPatchDecodes[mNumPatchDecodes];
+	decodep->mPatchp = patchp;
+	decodep->mStride = stride;
+	mPatchDecodeIndex[patchp] = mNumPatchDecodes++;
+	return decodep;
+}
+
+void LLVLManager::flushPatchDecodes(LLWorkPool *pool)
+{
+	if (!mNumPatchDecodes)
+	{
+		return;
+	}
+
+	init_patch_decompressor(mPatchDecodeSize);
+	LLVLPatchDecodeTask task(mPatchDecodes, mPatchDecodeSize);
+	if (pool)
+	{
+		pool->parallelFor(task, mNumPatchDecodes);
+	}
+	else
+	{
+		for (S32 i = 0; i < mNumPatchDecodes; i++)
+		{
+			task.run(i);
+		}
+	}
+
+	// Edges and dirty flags reach into neighboring patches.
+	for (S32 i = 0; i < mNumPatchDecodes; i++)
+	{
+		LLSurfacePatch *patchp = mPatchDecodes[i].mPatchp;
+		patchp->getSurface()->finishDCTPatch(patchp);
+	}
+
+	mNumPatchDecodes = 0;
+	mPatchDecodeIndex.clear();
+}
+
+void LLVLManager::captureLayerData(const LLVLData *vl_datap)
+{
+	if (!mCaptureFile)
+	{
+		std::string filename = gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "layer_data.capture");
+		mCaptureFile = new llofstream(filename, std::ios::out | std::ios::binary | std::ios::app);
+		llinfos << "Capturing LayerData to " << filename << llendl;
+	}
+
+	// Record: layer type, payload size, payload.
+	mCaptureFile->write((const char *)&vl_datap->mType, sizeof(vl_datap->mType));
+	mCaptureFile->write((const char *)&vl_datap->mSize, sizeof(vl_datap->mSize));
+	mCaptureFile->write((const char *)vl_datap->mData, vl_datap->mSize);
+	mCaptureFile->flush();
+}
+
+void LLVLManager::benchmarkCapture(const std::string &filename, LLViewerRegion *regionp)
+{
+	if (!regionp)
+	{
+		return;
+	}
+
+	llifstream file(filename, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		llwarns << "Couldn't open " << filename << ", no LayerData to replay" << llendl;
+		return;
+	}
+
+	std::vector<S8> types;
+	std::vector<std::vector<U8> > payloads;
+	while (true)
+	{
+		S8 type;
+		S32 size;
+		file.read((char *)&type, sizeof(type));
+		file.read((char *)&size, sizeof(size));
+		if (!file.good() || size <= 0)
+		{
+			break;
+		}
+		std::vector<U8> payload(size);
+		file.read((char *)&payload[0], size);
+		if (!file.good())
+		{
+			break;
+		}
+		types.push_back(type);
+		payloads.push_back(payload);
+	}
+	file.close();
+
+	if (types.empty())
+	{
+		llwarns << filename << " holds no LayerData" << llendl;
+		return;
+	}
+
+	// Anything already queued belongs to live traffic, decode it first.
+	unpackData();
+
+	// Without a pool, patch normals go through the same code on this thread.
+	LLWorkPool no_threads("Terrain Benchmark", 0);
+
+	const S32 ITERATIONS = 20;
+	LLWorkPool *pools[2] = { NULL, LLAppViewer::getWorkPool() };
+	for (S32 mode = 0; mode < 2; mode++)
+	{
+		LLTimer timer;
+		S32 num_patches = 0;
+		for (S32 iter = 0; iter < ITERATIONS; iter++)
+		{
+			for (U32 i = 0; i < types.size(); i++)
+			{
+				U8 *datap = new U8[payloads[i].size()];
+				memcpy(datap, &payloads[i][0], payloads[i].size());		/* Flawfinder: ignore */
+				mPacketData.put(new LLVLData(regionp, types[i], datap, (S32)payloads[i].size()));
+			}
+			num_patches += unpackPackets(pools[mode]);
+			regionp->getLand().updateDirtyPatches(pools[mode] ? pools[mode] : &no_threads);
+		}
+		F32 elapsed = timer.getElapsedTimeF32();
+		llinfos << "Terrain replay " << (pools[mode] ? "with work pool" : "on main thread")
+				<< ": " << types.size() << " packets x " << ITERATIONS
+				<< ", " << num_patches << " patches in " << elapsed << " s, "
+				<< (elapsed > 0.f ? num_patches / elapsed : 0.f) << " patches/s" << llendl;
+	}
 }
 
 void LLVLManager::resetBitCounts()
@@ -29,21 +29,49 @@
 
 // This class manages the data coming in for viewer layers from the network.
 
+#include <map>
+#include <vector>
+
 #include "stdtypes.h"
 #include "lldarray.h"
+#include "patch_dct.h"
 
+class llofstream;
 class LLVLData;
 class LLViewerRegion;
+class LLSurfacePatch;
+class LLWorkPool;
+
+// A land patch that has been read off the wire but not yet run through the
+// inverse DCT.
+class LLVLPatchDecode
+{
+public:
+	LLSurfacePatch *mPatchp;
+	LLPatchHeader mHeader;
+	S32 mStride;
+	S32 mCoefficients[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+};
 
 class LLVLManager
 {
 public:
+	LLVLManager();
 	~LLVLManager();
 
 	void addLayerData(LLVLData *vl_datap, const S32 mesg_size);
 
 	void unpackData(const S32 num_packets = 10);
 
+	// Used by LLSurface::decompressDCTPatch() to queue a patch for the next
+	// batch.  A patch queued twice keeps only its latest data.
+	LLVLPatchDecode *queuePatchDecode(LLSurfacePatch *patchp, S32 patch_size, S32 stride);
+
+	// Feeds LayerData captured with CaptureLayerData into regionp, first on
+	// the main thread alone and then through the work pool, and logs the
+	// decode rate of each.
+	void benchmarkCapture(const std::string &filename, LLViewerRegion *regionp);
+
 	S32 getTotalBytes() const;
 
 	S32 getLandBits() const;
@@ -54,8 +82,20 @@ public:
 
 	void cleanupData(LLViewerRegion *regionp);
 protected:
+	// Decodes every queued packet; pool == NULL decodes patch by patch.
+	S32 unpackPackets(LLWorkPool *pool);
+	void flushPatchDecodes(LLWorkPool *pool);
+	void captureLayerData(const LLVLData *vl_datap);
 
 	LLDynamicArray<LLVLData *> mPacketData;
+
+	std::vector<LLVLPatchDecode> mPatchDecodes;
+	std::map<LLSurfacePatch *, S32> mPatchDecodeIndex;
+	S32 mNumPatchDecodes;
+	S32 mPatchDecodeSize;
+	LLWorkPool *mPatchDecodePool;	// the pool of the unpackPackets() call queuing patches
+
+	llofstream *mCaptureFile;
 	U32 mLandBits;
 	U32 mWindBits;
 	U32 mCloudBits;
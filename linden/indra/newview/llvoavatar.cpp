@@ -45,6 +45,7 @@
 #include "llagentcamera.h"
 #include "llagentwearables.h"
 #include "llanimationstates.h"
+#include "llappviewer.h"
 #include "llavatarpropertiesprocessor.h"
 #include "llviewercontrol.h"
 #include "lldrawpoolavatar.h"
@@ -78,6 +79,7 @@
 #include "llviewerstats.h"
 #include "llvoavatarself.h"
 #include "llvovolume.h"
+#include "llworkpool.h"
 #include "llworld.h"
 #include "pipeline.h"
 #include "llviewershadermgr.h"
@@ -1810,6 +1812,19 @@ void LLVOAvatar::buildCharacter()
 		return;
 	}
 
+	//-------------------------------------------------------------------------
+	// joints too small to notice on small or distant avatars
+	//-------------------------------------------------------------------------
+	const char* detail_joints[] = { "mSkull", "mEyeLeft", "mEyeRight", "mWristLeft", "mWristRight", "mToeLeft", "mToeRight" };
+	for (U32 i = 0; i < LL_ARRAY_SIZE(detail_joints); i++)
+	{
+		LLJoint* joint = mRoot.findJoint(detail_joints[i]);
+		if (joint)
+		{
+			joint->setDetailJoint(TRUE);
+		}
+	}
+
 	//-------------------------------------------------------------------------
 	// initialize the pelvis
 	//-------------------------------------------------------------------------
@@ -1930,6 +1945,17 @@ void LLVOAvatar::restoreMeshData()
 	gPipeline.markRebuild(mDrawable, LLDrawable::REBUILD_GEOMETRY, TRUE);
 }
 
+//-----------------------------------------------------------------------------
+// updateMeshNormals()
+//-----------------------------------------------------------------------------
+void LLVOAvatar::updateMeshNormals()
+{
+	for (polymesh_map_t::iterator iter = mMeshes.begin(); iter != mMeshes.end(); ++iter)
+	{
+		iter->second->updateNormals();
+	}
+}
+
 //-----------------------------------------------------------------------------
 // updateMeshData()
 //-----------------------------------------------------------------------------
@@ -3096,6 +3122,49 @@ void LLVOAvatar::slamPosition()
 	mRoot.updateWorldMatrixChildren();
 }
 
+//------------------------------------------------------------------------
+// updateAnimationLOD()
+// Picks how often this avatar's motions are evaluated, and whether its
+// detail joints are animated, from its size on screen and distance.
+// Frames between evaluations interpolate towards the next pose.
+//------------------------------------------------------------------------
+void LLVOAvatar::updateAnimationLOD()
+{
+	static LLCachedControl<bool> animation_lod(gSavedSettings, "AvatarAnimationLOD");
+
+	// crowds slow down everybody's small avatars
+	F32 time_quantum = clamp_rescale((F32)sInstances.size(), 10.f, 35.f, 0.f, 0.25f);
+	F32 pixel_area_scale = clamp_rescale(mPixelArea, 100, 5000, 1.f, 0.f);
+	F32 time_step = time_quantum * pixel_area_scale;
+	BOOL skip_detail_joints = FALSE;
+
+	if (animation_lod)
+	{
+		// Small or far away avatars update at 10 Hz or less.  Stepping
+		// stops the walk adjust servo and their feet slide, so an avatar
+		// that is neither small nor in a crowd is only stepped by the
+		// regular rule above; distance alone just drops detail joints.
+		F32 distance = dist_vec(getPositionAgent(), LLViewerCamera::getInstance()->getOrigin());
+		F32 distance_scale = clamp_rescale(distance, 16.f, 64.f, 0.f, 1.f);
+		F32 lod_scale = llmax(pixel_area_scale, distance_scale);
+		if (pixel_area_scale > 0.f || time_quantum > 0.f)
+		{
+			time_step = llmax(time_quantum, 0.1f) * lod_scale;
+		}
+		skip_detail_joints = lod_scale > 0.5f;
+	}
+
+	if (time_step != 0.f)
+	{
+		// disable walk motion servo controller as it doesn't work with motion timesteps
+		stopMotion(ANIM_AGENT_WALK_ADJUST);
+		removeAnimationData("Walk Speed");
+	}
+	mMotionController.setTimeStep(time_step);
+	mMotionController.setSkipDetailJoints(skip_detail_joints);
+//	llinfos << "Setting timestep to " << time_step << llendl;
+}
+
 //------------------------------------------------------------------------
 // updateCharacter()
 // called on both your avatar and other avatars
@@ -3210,17 +3279,7 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 	// change animation time quanta based on avatar render load
 	if (!isSelf() && !mIsDummy)
 	{
-		F32 time_quantum = clamp_rescale((F32)sInstances.size(), 10.f, 35.f, 0.f, 0.25f);
-		F32 pixel_area_scale = clamp_rescale(mPixelArea, 100, 5000, 1.f, 0.f);
-		F32 time_step = time_quantum * pixel_area_scale;
-		if (time_step != 0.f)
-		{
-			// disable walk motion servo controller as it doesn't work with motion timesteps
-			stopMotion(ANIM_AGENT_WALK_ADJUST);
-			removeAnimationData("Walk Speed");
-		}
-		mMotionController.setTimeStep(time_step);
-//		llinfos << "Setting timestep to " << time_quantum * pixel_area_scale << llendl;
+		updateAnimationLOD();
 	}
 
 	if (getParent() && !mIsSitting)
@@ -3756,6 +3815,115 @@ bool LLVOAvatar::shouldAlphaMask()
 
 }
 
+//-----------------------------------------------------------------------------
+// getSkinnedMeshLODs()
+// The mesh LODs that get skinned on the CPU when this avatar is drawn.
+//-----------------------------------------------------------------------------
+void LLVOAvatar::getSkinnedMeshLODs(std::vector<LLViewerJoint*>& mesh_lods)
+{
+	mesh_lods.push_back(mMeshLOD[MESH_ID_LOWER_BODY]);
+	mesh_lods.push_back(mMeshLOD[MESH_ID_UPPER_BODY]);
+
+	if( isWearingWearableType( LLWearableType::WT_SKIRT ) )
+	{
+		mesh_lods.push_back(mMeshLOD[MESH_ID_SKIRT]);
+	}
+
+	if (!isSelf() || gAgent.needsRenderHead() || LLPipeline::sShadowRender)
+	{
+		mesh_lods.push_back(mMeshLOD[MESH_ID_EYELASH]);
+		mesh_lods.push_back(mMeshLOD[MESH_ID_HEAD]);
+		mesh_lods.push_back(mMeshLOD[MESH_ID_HAIR]);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// canSkinAhead()
+// True if renderSkinned() would skin this avatar and do nothing else to its
+// vertex buffer first.  mNeedsSkin is only set once updateCharacter() has
+// finished the joint world matrices, so the skinning can read them safely.
+//-----------------------------------------------------------------------------
+BOOL LLVOAvatar::canSkinAhead()
+{
+	if (isDead() || !mIsBuilt || !mNeedsSkin || mDirtyMesh || isSelf())
+	{
+		return FALSE;
+	}
+	if (mDrawable.isNull() || mDrawable->isState(LLDrawable::REBUILD_GEOMETRY))
+	{
+		return FALSE;
+	}
+	LLFace* face = mDrawable->getFace(0);
+	if (!face || face->mVertexBuffer.isNull())
+	{
+		return FALSE;
+	}
+	return isVisible() && !isImpostor() && isFullyLoaded();
+}
+
+static LLFastTimer::DeclareTimer FTM_SKIN_AVATARS("Skin Avatars");
+
+//-----------------------------------------------------------------------------
+// skinAvatars()
+// Skins the meshes of every avatar that will be drawn this frame in one batch
+// spread over the work pool, instead of one avatar at a time in
+// renderSkinned().  Anything this skips is still skinned there.
+//-----------------------------------------------------------------------------
+// static
+void LLVOAvatar::skinAvatars()
+{
+	if (LLViewerShaderMgr::instance()->getVertexShaderLevel(LLViewerShaderMgr::SHADER_AVATAR) > 0)
+	{
+		return;
+	}
+
+	LLWorkPool* pool = LLAppViewer::getWorkPool();
+	if (!pool || pool->getNumThreads() == 0)
+	{
+		return;
+	}
+
+	std::vector<LLVOAvatar*> avatars;
+	std::vector<LLViewerJointMesh*> meshes;
+	for (std::vector<LLCharacter*>::iterator iter = LLCharacter::sInstances.begin();
+		 iter != LLCharacter::sInstances.end(); ++iter)
+	{
+		LLVOAvatar* avatarp = (LLVOAvatar*) *iter;
+		if (!avatarp->canSkinAhead())
+		{
+			continue;
+		}
+
+		std::vector<LLViewerJoint*> mesh_lods;
+		avatarp->getSkinnedMeshLODs(mesh_lods);
+		for (U32 i = 0; i < mesh_lods.size(); ++i)
+		{
+			mesh_lods[i]->getSkinnedMeshes(meshes);
+		}
+		avatars.push_back(avatarp);
+	}
+
+	if (avatars.size() < 2)
+	{
+		return;
+	}
+
+	LLFastTimer t(FTM_SKIN_AVATARS);
+	LLViewerJointMesh::skinMeshes(meshes, pool);
+
+	for (U32 i = 0; i < avatars.size(); ++i)
+	{
+		LLVOAvatar* avatarp = avatars[i];
+		avatarp->mNeedsSkin = FALSE;
+
+		LLVertexBuffer* vb = avatarp->mDrawable->getFace(0)->mVertexBuffer;
+		if (vb)
+		{
+			vb->setBuffer(0);
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 // renderSkinned()
 //-----------------------------------------------------------------------------
@@ -3788,19 +3956,11 @@ U32 LLVOAvatar::renderSkinned(EAvatarRenderPass pass)
 		if (mNeedsSkin)
 		{
 			//generate animated mesh
-			mMeshLOD[MESH_ID_LOWER_BODY]->updateJointGeometry();
-			mMeshLOD[MESH_ID_UPPER_BODY]->updateJointGeometry();
-
-			if( isWearingWearableType( LLWearableType::WT_SKIRT ) )
-			{
-				mMeshLOD[MESH_ID_SKIRT]->updateJointGeometry();
-			}
-
-			if (!isSelf() || gAgent.needsRenderHead() || LLPipeline::sShadowRender)
+			std::vector<LLViewerJoint*> mesh_lods;
+			getSkinnedMeshLODs(mesh_lods);
+			for (U32 i = 0; i < mesh_lods.size(); ++i)
 			{
-				mMeshLOD[MESH_ID_EYELASH]->updateJointGeometry();
-				mMeshLOD[MESH_ID_HEAD]->updateJointGeometry();
-				mMeshLOD[MESH_ID_HAIR]->updateJointGeometry();
+				mesh_lods[i]->updateJointGeometry();
 			}
 			mNeedsSkin = FALSE;
 			
@@ -200,6 +200,7 @@ private:
 	//--------------------------------------------------------------------
 public:
 	virtual BOOL 	updateCharacter(LLAgent &agent);
+	void			updateAnimationLOD();
 	void 			idleUpdateVoiceVisualizer(bool voice_enabled);
 	void 			idleUpdateMisc(bool detailed_update);
 	virtual void	idleUpdateAppearanceAnimation();
@@ -343,10 +344,13 @@ public:
 	static void	deleteCachedImages(bool clearAll=true);
 	static void	destroyGL();
 	static void	restoreGL();
+	static void	skinAvatars(); // skin every avatar waiting for it at once, on the work pool
 	BOOL 		mIsDummy; // for special views
 	S32			mSpecialRenderMode; // special lighting
 private:
 	bool		shouldAlphaMask();
+	void		getSkinnedMeshLODs(std::vector<LLViewerJoint*>& mesh_lods);
+	BOOL		canSkinAhead();
 
 	BOOL 		mNeedsSkin; // avatar has been animated and verts have not been updated
 	S32	 		mUpdatePeriod;
@@ -567,6 +571,7 @@ public:
 	void 			updateSexDependentLayerSets(BOOL upload_bake);
 	void 			dirtyMesh(); // Dirty the avatar mesh
 	void 			updateMeshData();
+	void 			updateMeshNormals(); // renormalize morphed normals now, rather than when next drawn
 protected:
 	void 			releaseMeshData();
 	virtual void restoreMeshData();
@@ -46,6 +46,7 @@
 #include "lldrawable.h"
 #include "lldrawpoolbump.h"
 #include "llface.h"
+#include "llfacegeombatch.h"
 #include "llspatialpartition.h"
 #include "llhudmanager.h"
 #include "llflexibleobject.h"
@@ -55,6 +56,7 @@
 #include "llviewertexturelist.h"
 #include "llviewerregion.h"
 #include "llviewertextureanim.h"
+#include "llworkpool.h"
 #include "llworld.h"
 #include "llselectmgr.h"
 #include "pipeline.h"
@@ -62,6 +64,7 @@
 #include "llmediaentry.h"
 #include "llmediadataclient.h"
 #include "llagent.h"
+#include "llappviewer.h"
 #include "llviewermediafocus.h"
 
 const S32 MIN_QUIET_FRAMES_COALESCE = 30;
@@ -3327,6 +3330,51 @@ void LLVolumeGeometryManager::getGeometry(LLSpatialGroup* group)
 
 }
 
+// Faces queued between beginGeomBatch() and endGeomBatch()
+static LLFaceGeomBatch sGeomBatch;
+static S32 sGeomBatchDepth = 0;
+
+static LLWorkPool* get_geom_batch_pool()
+{
+	LLWorkPool* pool = LLAppViewer::getWorkPool();
+	return (pool && pool->getNumThreads() > 0) ? pool : NULL;
+}
+
+//static
+void LLVolumeGeometryManager::beginGeomBatch()
+{
+	sGeomBatchDepth++;
+}
+
+//static
+void LLVolumeGeometryManager::endGeomBatch()
+{
+	llassert(sGeomBatchDepth > 0);
+	if (--sGeomBatchDepth == 0 && !sGeomBatch.isEmpty())
+	{
+		sGeomBatch.flush(get_geom_batch_pool());
+	}
+}
+
+//static
+void LLVolumeGeometryManager::rebuildFace(LLFace* facep, LLVOVolume* vobj)
+{
+	LLVolume* volume = vobj->getVolume();
+	U32 te_idx = facep->getTEOffset();
+
+	if (sGeomBatchDepth > 0 && get_geom_batch_pool())
+	{ //filled in with the rest of the batch
+		sGeomBatch.add(facep, volume, te_idx, 
+			vobj->getRelativeXform(), vobj->getRelativeXformInvTrans(), facep->getGeomIndex());
+	}
+	else if (facep->getGeometryVolume(*volume, te_idx, 
+		vobj->getRelativeXform(), vobj->getRelativeXformInvTrans(), facep->getGeomIndex()))
+	{
+		facep->mVertexBuffer->markDirty(facep->getGeomIndex(), facep->getGeomCount(), 
+			facep->getIndicesStart(), facep->getIndicesCount());
+	}
+}
+
 static LLFastTimer::DeclareTimer FTM_REBUILD_VOLUME_VB("Volume");
 static LLFastTimer::DeclareTimer FTM_REBUILD_VBO("VBO Rebuilt");
 
@@ -3530,10 +3578,12 @@ void LLVolumeGeometryManager::rebuildGeom(LLSpatialGroup* group)
 		bump_mask |= LLVertexBuffer::MAP_BINORMAL;
 	}
 
+	beginGeomBatch();
 	genDrawInfo(group, simple_mask, simple_faces);
 	genDrawInfo(group, bump_mask, bump_faces);
 	genDrawInfo(group, fullbright_mask, fullbright_faces);
 	genDrawInfo(group, alpha_mask, alpha_faces, TRUE);
+	endGeomBatch();
 
 	if (!LLPipeline::sDelayVBUpdate)
 	{
@@ -3570,6 +3620,7 @@ void LLVolumeGeometryManager::rebuildMesh(LLSpatialGroup* group)
 
 		group->mBuilt = 1.f;
 		
+		beginGeomBatch();
 		for (LLSpatialGroup::element_iter drawable_iter = group->getData().begin(); drawable_iter != group->getData().end(); ++drawable_iter)
 		{
 			LLFastTimer t(FTM_VOLUME_GEOM_PARTIAL);
@@ -3584,20 +3635,19 @@ void LLVolumeGeometryManager::rebuildMesh(LLSpatialGroup* group)
 			{
 				LLVOVolume* vobj = drawablep->getVOVolume();
 				vobj->preRebuild();
-				LLVolume* volume = vobj->getVolume();
 				for (S32 i = 0; i < drawablep->getNumFaces(); ++i)
 				{
 					LLFace* face = drawablep->getFace(i);
 					if (face && face->mVertexBuffer.notNull())
 					{
-						face->getGeometryVolume(*volume, face->getTEOffset(), 
-							vobj->getRelativeXform(), vobj->getRelativeXformInvTrans(), face->getGeomIndex());
+						rebuildFace(face, vobj);
 					}
 				}
 
 				drawablep->clearState(LLDrawable::REBUILD_ALL);
 			}
 		}
+		endGeomBatch();
 		
 		//unmap all the buffers
 		for (LLSpatialGroup::buffer_map_t::iterator i = group->mBufferMap.begin(); i != group->mBufferMap.end(); ++i)
@@ -3773,18 +3823,7 @@ void LLVolumeGeometryManager::genDrawInfo(LLSpatialGroup* group, U32 mask, std::
 				facep->updateRebuildFlags();
 				if (!LLPipeline::sDelayVBUpdate)
 				{
-					LLDrawable* drawablep = facep->getDrawable();
-					LLVOVolume* vobj = drawablep->getVOVolume();
-					LLVolume* volume = vobj->getVolume();
-
-					U32 te_idx = facep->getTEOffset();
-
-					if (facep->getGeometryVolume(*volume, te_idx, 
-						vobj->getRelativeXform(), vobj->getRelativeXformInvTrans(), index_offset))
-					{
-						buffer->markDirty(facep->getGeomIndex(), facep->getGeomCount(), 
-							facep->getIndicesStart(), facep->getIndicesCount());
-					}
+					rebuildFace(facep, facep->getDrawable()->getVOVolume());
 				}
 			}
 
@@ -29,6 +29,7 @@
 #include "noise.h"
 
 #include "llrand.h"
+#include "llv4math.h"
 
 
 // static
@@ -83,3 +84,78 @@ F32 noise2(F32 *vec)
 	return lerp_m(sy, a, b);
 }
 
+void init_noise()
+{
+	if (gNoiseStart) {
+		gNoiseStart = 0;
+		init();
+	}
+}
+
+// The table lookups are done a point at a time, the interpolation for all
+// four at once, in the same order as noise2() so every lane is bit for bit
+// identical to it.
+void noise2v(const F32 *x, const F32 *y, F32 *result)
+{
+#if LL_VECTORIZE
+	F32 rx0[4], ry0[4];
+	F32 q00[2][4], q10[2][4], q01[2][4], q11[2][4];
+	S32 k;
+
+	init_noise();
+
+	for (k = 0; k < 4; k++)
+	{
+		U8 bx0, bx1, by0, by1;
+		F32 rx1, ry1;
+		fast_setup(x[k], bx0, bx1, rx0[k], rx1);
+		fast_setup(y[k], by0, by1, ry0[k], ry1);
+
+		S32 i = *(p + bx0);
+		S32 j = *(p + bx1);
+
+		F32 *q = *(g2 + *(p + i + by0));
+		q00[0][k] = q[0];
+		q00[1][k] = q[1];
+		q = *(g2 + *(p + j + by0));
+		q10[0][k] = q[0];
+		q10[1][k] = q[1];
+		q = *(g2 + *(p + i + by1));
+		q01[0][k] = q[0];
+		q01[1][k] = q[1];
+		q = *(g2 + *(p + j + by1));
+		q11[0][k] = q[0];
+		q11[1][k] = q[1];
+	}
+
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 two = _mm_set1_ps(2.f);
+	const __m128 three = _mm_set1_ps(3.f);
+
+	__m128 vrx0 = _mm_loadu_ps(rx0);
+	__m128 vry0 = _mm_loadu_ps(ry0);
+	__m128 vrx1 = _mm_sub_ps(vrx0, one);
+	__m128 vry1 = _mm_sub_ps(vry0, one);
+
+	// s_curve(t) = t * t * (3 - 2 * t)
+	__m128 sx = _mm_mul_ps(_mm_mul_ps(vrx0, vrx0), _mm_sub_ps(three, _mm_mul_ps(two, vrx0)));
+	__m128 sy = _mm_mul_ps(_mm_mul_ps(vry0, vry0), _mm_sub_ps(three, _mm_mul_ps(two, vry0)));
+
+	// fast_at2(rx, ry, q) = rx * q[0] + ry * q[1]; lerp_m(t, a, b) = a + t * (b - a)
+	__m128 u = _mm_add_ps(_mm_mul_ps(vrx0, _mm_loadu_ps(q00[0])), _mm_mul_ps(vry0, _mm_loadu_ps(q00[1])));
+	__m128 v = _mm_add_ps(_mm_mul_ps(vrx1, _mm_loadu_ps(q10[0])), _mm_mul_ps(vry0, _mm_loadu_ps(q10[1])));
+	__m128 a = _mm_add_ps(u, _mm_mul_ps(sx, _mm_sub_ps(v, u)));
+
+	u = _mm_add_ps(_mm_mul_ps(vrx0, _mm_loadu_ps(q01[0])), _mm_mul_ps(vry1, _mm_loadu_ps(q01[1])));
+	v = _mm_add_ps(_mm_mul_ps(vrx1, _mm_loadu_ps(q11[0])), _mm_mul_ps(vry1, _mm_loadu_ps(q11[1])));
+	__m128 b = _mm_add_ps(u, _mm_mul_ps(sx, _mm_sub_ps(v, u)));
+
+	_mm_storeu_ps(result, _mm_add_ps(a, _mm_mul_ps(sy, _mm_sub_ps(b, a))));
+#else
+	for (S32 k = 0; k < 4; k++)
+	{
+		F32 vec[2] = { x[k], y[k] };
+		result[k] = noise2(vec);
+	}
+#endif
+}
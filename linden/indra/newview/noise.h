@@ -35,6 +35,13 @@ F32 clouds3(float *v, float freq);
 F32 noise2(float *vec);
 F32 noise3(float *vec);
 
+// noise2() at four points, x[i], y[i] -> result[i].  Matches noise2() exactly.
+void noise2v(const F32 *x, const F32 *y, F32 *result);
+
+// The tables are built by the first noise call.  Call this on the main thread
+// before using noise from worker threads.
+void init_noise();
+
 inline F32 bias(F32 a, F32 b)
 {
 	return (F32)pow(a, (F32)(log(b) / log(0.5f)));
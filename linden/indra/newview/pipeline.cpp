@@ -286,6 +286,7 @@ F32		LLPipeline::sMinRenderSize = 0.f;
 
 
 static LLCullResult* sCull = NULL;
+static LLSpatialCullPass sCullPass;
 
 static const U32 gl_cube_face[] = 
 {
@@ -358,6 +359,7 @@ void LLPipeline::init()
 	sRenderBump = gSavedSettings.getBOOL("RenderObjectBump");
 	sUseTriStrips = gSavedSettings.getBOOL("RenderUseTriStrips");
 	LLVertexBuffer::sUseStreamDraw = gSavedSettings.getBOOL("RenderUseStreamVBO");
+	LLVertexBuffer::sUseStreamRing = gSavedSettings.getBOOL("RenderStreamRing");
 	sRenderAttachedLights = gSavedSettings.getBOOL("RenderAttachedLights");
 	sRenderAttachedParticles = gSavedSettings.getBOOL("RenderAttachedParticles");
 
@@ -1307,6 +1309,10 @@ void LLPipeline::resetFrameStats()
 	assertInitialized();
 
 	LLViewerStats::getInstance()->mTrianglesDrawnStat.addValue(mTrianglesDrawn/1000.f);
+	LLViewerStats::getInstance()->mVertexUploadKBStat.addValue(LLVertexBuffer::sFrameUploadBytes/1024.f);
+	LLViewerStats::getInstance()->mVertexBindsStat.addValue((F32) LLVertexBuffer::sFrameBindCount);
+	LLVertexBuffer::sFrameUploadBytes = 0;
+	LLVertexBuffer::sFrameBindCount = 0;
 
 	if (mBatchCount > 0)
 	{
@@ -1624,12 +1630,14 @@ void LLPipeline::updateCull(LLCamera& camera, LLCullResult& result, S32 water_cl
 			{
 				if (hasRenderType(part->mDrawableType))
 				{
-					part->cull(camera);
+					sCullPass.addPartition(part, camera);
 				}
 			}
 		}
 	}
 
+	sCullPass.cullPartitions(LLAppViewer::getWorkPool());
+
 	camera.disableUserClipPlane();
 
 	if (gSky.mVOSkyp.notNull() && gSky.mVOSkyp->mDrawable.notNull())
@@ -1806,6 +1814,7 @@ void LLPipeline::rebuildPriorityGroups()
 	assertInitialized();
 
 	// Iterate through all drawables on the priority build queue,
+	LLVolumeGeometryManager::beginGeomBatch();
 	for (LLSpatialGroup::sg_vector_t::iterator iter = mGroupQ1.begin();
 		 iter != mGroupQ1.end(); ++iter)
 	{
@@ -1813,6 +1822,7 @@ void LLPipeline::rebuildPriorityGroups()
 		group->rebuildGeom();
 		group->clearState(LLSpatialGroup::IN_BUILD_Q1);
 	}
+	LLVolumeGeometryManager::endGeomBatch();
 
 	mGroupQ1.clear();
 }
@@ -1827,6 +1837,7 @@ void LLPipeline::rebuildGroups()
 	
 	std::sort(mGroupQ2.begin(), mGroupQ2.end(), LLSpatialGroup::CompareUpdateUrgency());
 
+	LLVolumeGeometryManager::beginGeomBatch();
 	LLSpatialGroup::sg_vector_t::iterator iter;
 	for (iter = mGroupQ2.begin();
 		 iter != mGroupQ2.end(); ++iter)
@@ -1853,6 +1864,7 @@ void LLPipeline::rebuildGroups()
 			break;
 		}
 	}	
+	LLVolumeGeometryManager::endGeomBatch();
 
 	mGroupQ2.erase(mGroupQ2.begin(), iter);
 
@@ -2562,6 +2574,7 @@ void LLPipeline::postSort(LLCamera& camera)
 
 	llpushcallstacks ;
 	//rebuild drawable geometry
+	LLVolumeGeometryManager::beginGeomBatch();
 	for (LLCullResult::sg_list_t::iterator i = sCull->beginDrawableGroups(); i != sCull->endDrawableGroups(); ++i)
 	{
 		LLSpatialGroup* group = *i;
@@ -2571,6 +2584,7 @@ void LLPipeline::postSort(LLCamera& camera)
 			group->rebuildGeom();
 		}
 	}
+	LLVolumeGeometryManager::endGeomBatch();
 	llpushcallstacks ;
 	//rebuild groups
 	sCull->assertDrawMapsEmpty();
@@ -3064,6 +3078,12 @@ void LLPipeline::renderGeom(LLCamera& camera, BOOL forceVBOUpdate)
 	
 	LLAppViewer::instance()->pingMainloopTimeout("Pipeline:RenderDrawPools");
 
+	if (hasRenderType(LLPipeline::RENDER_TYPE_AVATAR))
+	{
+		// skin the crowd together before the avatar pools draw it one by one
+		LLVOAvatar::skinAvatars();
+	}
+
 	for (pool_set_t::iterator iter = mPools.begin(); iter != mPools.end(); ++iter)
 	{
 		LLDrawPool *poolp = *iter;
@@ -5417,6 +5437,7 @@ void LLPipeline::resetVertexBuffers()
 	sRenderBump = gSavedSettings.getBOOL("RenderObjectBump");
 	sUseTriStrips = gSavedSettings.getBOOL("RenderUseTriStrips");
 	LLVertexBuffer::sUseStreamDraw = gSavedSettings.getBOOL("RenderUseStreamVBO");
+	LLVertexBuffer::sUseStreamRing = gSavedSettings.getBOOL("RenderStreamRing");
 
 	for (LLWorld::region_list_t::const_iterator iter = LLWorld::getInstance()->getRegionList().begin(); 
 			iter != LLWorld::getInstance()->getRegionList().end(); ++iter)
@@ -0,0 +1,324 @@
+/**
+ * @file llfacegeombatch_test.cpp
+ * @brief Tests for filling volume face geometry into staging memory.
+ *
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../llfacegeombatch.h"
+
+// Tut header
+#include "../test/lltut.h"
+
+#include "llfasttimer.h"
+#include "llvolume.h"
+
+#include <vector>
+
+// Link seams.  The batch is only ever given prepared jobs here, and never
+// uploads, so none of these run.
+
+BOOL LLFace::prepareGeometryVolume(const LLVolume& volume, const S32 &f,
+								   const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
+								   const U16 &index_offset, LLFaceGeomJob& job, BOOL force_rebuild)
+{
+	return FALSE;
+}
+
+bool LLVertexBuffer::getVertexStrider(LLStrider<LLVector3>& strider, S32 index) { return false; }
+bool LLVertexBuffer::getIndexStrider(LLStrider<U16>& strider, S32 index) { return false; }
+bool LLVertexBuffer::getTexCoord0Strider(LLStrider<LLVector2>& strider, S32 index) { return false; }
+bool LLVertexBuffer::getTexCoord1Strider(LLStrider<LLVector2>& strider, S32 index) { return false; }
+bool LLVertexBuffer::getNormalStrider(LLStrider<LLVector3>& strider, S32 index) { return false; }
+bool LLVertexBuffer::getBinormalStrider(LLStrider<LLVector3>& strider, S32 index) { return false; }
+bool LLVertexBuffer::getColorStrider(LLStrider<LLColor4U>& strider, S32 index) { return false; }
+void LLVertexBuffer::markDirty(U32 vert_index, U32 vert_count, U32 indices_index, U32 indices_count) {}
+
+// -------------------------------------------------------------------------------------------
+// TUT
+// -------------------------------------------------------------------------------------------
+
+namespace tut
+{
+	// Test wrapper declarations
+	struct facegeombatch_test
+	{
+		enum { FACE_COUNT = 40 };
+
+		// Faces of 1 to FACE_COUNT vertices, so the staging arrays come out
+		// all sorts of lengths.
+		std::vector<LLVolumeFace> mFaces;
+
+		facegeombatch_test()
+			: mFaces(FACE_COUNT)
+		{
+			// as the viewer does at startup, so every timer's frame state is in place
+			static bool timers_reset = false;
+			if (!timers_reset)
+			{
+				LLFastTimer::reset();
+				timers_reset = true;
+			}
+
+			for (S32 f = 0; f < FACE_COUNT; f++)
+			{
+				LLVolumeFace& face = mFaces[f];
+				S32 verts = f + 1;
+				face.mVertices.resize(verts);
+				for (S32 i = 0; i < verts; i++)
+				{
+					LLVolumeFace::VertexData& vd = face.mVertices[i];
+					vd.mPosition.setVec(0.1f * i, -0.2f * f, 0.05f * (i + f));
+					vd.mNormal.setVec(0.f, (F32)(i % 3), 1.f);
+					vd.mNormal.normVec();
+					vd.mBinormal.setVec(1.f, 0.f, (F32)(f % 2));
+					vd.mBinormal.normVec();
+					vd.mTexCoord.setVec(0.03f * i, 1.f - 0.02f * f);
+				}
+				for (S32 i = 0; i < verts * 3; i++)
+				{
+					face.mIndices.push_back((U16)((i * 7) % verts));
+				}
+				for (S32 i = 0; i < verts + 2; i++)
+				{
+					face.mTriStrip.push_back((U16)(i % verts));
+				}
+				face.mCenter.setVec(0.5f, 0.5f, 0.5f);
+			}
+		}
+
+		// A job for face f, rebuilding whatever f picks.
+		LLFaceGeomJob makeJob(S32 f)
+		{
+			LLFaceGeomJob job;
+			const LLVolumeFace& face = mFaces[f];
+			job.mVolumeFace = &face;
+			job.mNumVertices = (S32)face.mVertices.size();
+			job.mUseTriStrips = f % 5 == 0;
+			job.mNumIndices = job.mUseTriStrips ? (S32)face.mTriStrip.size() : (S32)face.mIndices.size();
+			job.mIndexOffset = (U16)(f * 10);
+
+			job.mRebuildPos = f % 2 == 0;
+			job.mRebuildNormal = f % 3 != 1;
+			job.mRebuildBinormal = f % 4 == 0;
+			job.mRebuildTCoord = f % 3 != 2;
+			job.mRebuildTCoord1 = job.mRebuildTCoord && f % 2 == 1;
+			job.mRebuildColor = f % 5 != 3;
+			job.mRebuildIndices = f % 7 != 6;
+
+			job.mMatVert.initAll(LLVector3(2.f, 2.f, 2.f), LLQuaternion(), LLVector3(1.f, 2.f, 3.f));
+			job.mMatNormal.setRows(LLVector3(3.f, 0.f, 0.f), LLVector3(0.f, 3.f, 0.f), LLVector3(0.f, 0.f, 3.f));
+			job.mColor.setVec(10, 20, (U8)f, 255);
+
+			job.mScale.setVec(1.f, 2.f, 1.f);
+			job.mTexGen = f % 4 == 1 ? LLTextureEntry::TEX_GEN_PLANAR : LLTextureEntry::TEX_GEN_DEFAULT;
+			job.mScaleS = 2.f;
+			job.mOffsetS = 0.25f;
+			job.mBinormalDir.setVec(1.f, 0.f, 0.f);
+			job.mBumpSLightRay.setVec(0.f, 0.01f, 0.f);
+			job.mBumpTLightRay.setVec(0.01f, 0.f, 0.f);
+			return job;
+		}
+
+		// The job filled straight into arrays of its own.
+		struct Result
+		{
+			std::vector<LLVector3> mVertices;
+			std::vector<LLVector3> mNormals;
+			std::vector<LLVector3> mBinormals;
+			std::vector<LLVector2> mTexCoords;
+			std::vector<LLVector2> mTexCoords2;
+			std::vector<LLColor4U> mColors;
+			std::vector<U16> mIndices;
+		};
+
+		static void fillDirect(LLFaceGeomJob job, Result& result)
+		{
+			result.mVertices.resize(job.mNumVertices);
+			result.mNormals.resize(job.mNumVertices);
+			result.mBinormals.resize(job.mNumVertices);
+			result.mTexCoords.resize(job.mNumVertices);
+			result.mTexCoords2.resize(job.mNumVertices);
+			result.mColors.resize(job.mNumVertices);
+			result.mIndices.resize(job.mNumIndices);
+			job.mVertices = &result.mVertices[0];
+			job.mNormals = &result.mNormals[0];
+			job.mBinormals = &result.mBinormals[0];
+			job.mTexCoords = &result.mTexCoords[0];
+			job.mTexCoords2 = &result.mTexCoords2[0];
+			job.mColors = &result.mColors[0];
+			job.mIndices = &result.mIndices[0];
+			job.fill();
+		}
+
+		template <class T>
+		void ensure_array(const std::string& msg, BOOL used, const T* staged, const std::vector<T>& expected)
+		{
+			if (!used)
+			{
+				return;
+			}
+			ensure(msg + " aligned", ((size_t)staged & 15) == 0);
+			for (U32 i = 0; i < expected.size(); i++)
+			{
+				ensure(msg + llformat(" %d", i), staged[i] == expected[i]);
+			}
+		}
+
+		// Everything the batch staged for job i matches filling it directly.
+		void ensure_staged(const std::string& msg, const LLFaceGeomBatch& batch, U32 i)
+		{
+			const LLFaceGeomJob& job = batch.getJob(i);
+			Result expected;
+			fillDirect(makeJob(i), expected);
+			std::string face = msg + llformat(" face %d", i);
+			ensure_array(face + " vertex", job.mRebuildPos, job.mVertices.get(), expected.mVertices);
+			ensure_array(face + " normal", job.mRebuildNormal, job.mNormals.get(), expected.mNormals);
+			ensure_array(face + " binormal", job.mRebuildBinormal, job.mBinormals.get(), expected.mBinormals);
+			ensure_array(face + " texcoord", job.mRebuildTCoord, job.mTexCoords.get(), expected.mTexCoords);
+			ensure_array(face + " bump texcoord", job.mRebuildTCoord1, job.mTexCoords2.get(), expected.mTexCoords2);
+			ensure_array(face + " color", job.mRebuildColor, job.mColors.get(), expected.mColors);
+			ensure_array(face + " index", job.mRebuildIndices, job.mIndices.get(), expected.mIndices);
+		}
+	};
+
+	// Tut templating thingamagic: test group, object and test instance
+	typedef test_group<facegeombatch_test> facegeombatch_t;
+	typedef facegeombatch_t::object facegeombatch_object_t;
+	tut::facegeombatch_t tut_facegeombatch("LLFaceGeomBatch");
+
+	// One face worked out by hand
+	template<> template<>
+	void facegeombatch_object_t::test<1>()
+	{
+		LLFaceGeomJob job = makeJob(6);
+		job.mRebuildPos = job.mRebuildNormal = job.mRebuildBinormal = TRUE;
+		job.mRebuildTCoord = job.mRebuildColor = job.mRebuildIndices = TRUE;
+		job.mRebuildTCoord1 = FALSE;
+		Result result;
+		fillDirect(job, result);
+
+		const LLVolumeFace& face = mFaces[6];
+		for (S32 i = 0; i < job.mNumVertices; i++)
+		{
+			std::string msg = llformat("vertex %d", i);
+			const LLVolumeFace::VertexData& vd = face.mVertices[i];
+			LLVector3 pos = vd.mPosition * 2.f + LLVector3(1.f, 2.f, 3.f);
+			for (S32 c = 0; c < 3; c++)
+			{
+				ensure_approximately_equals((msg + " position").c_str(), result.mVertices[i].mV[c], pos.mV[c], 16);
+				// the normal matrix scales, but they come out unit length again
+				ensure_approximately_equals((msg + " normal").c_str(), result.mNormals[i].mV[c], vd.mNormal.mV[c], 16);
+				ensure_approximately_equals((msg + " binormal").c_str(), result.mBinormals[i].mV[c], vd.mBinormal.mV[c], 16);
+			}
+			// scaled by 2 about the middle, then offset
+			ensure_approximately_equals((msg + " s").c_str(), result.mTexCoords[i].mV[0], (vd.mTexCoord.mV[0] - 0.5f) * 2.f + 0.75f, 16);
+			ensure_approximately_equals((msg + " t").c_str(), result.mTexCoords[i].mV[1], vd.mTexCoord.mV[1], 16);
+			ensure(msg + " color", result.mColors[i] == LLColor4U(10, 20, 6, 255));
+		}
+		for (S32 i = 0; i < job.mNumIndices; i++)
+		{
+			ensure_equals(llformat("index %d", i), result.mIndices[i], (U16)(face.mIndices[i] + 60));
+		}
+
+		// tri strips come from their own array
+		job = makeJob(5);
+		fillDirect(job, result);
+		for (S32 i = 0; i < job.mNumIndices; i++)
+		{
+			ensure_equals(llformat("strip index %d", i), result.mIndices[i], (U16)(mFaces[5].mTriStrip[i] + 50));
+		}
+	}
+
+	// The batch stages every face the same as filling it directly, inline
+	// or across a pool, aligned, and keeps count.
+	template<> template<>
+	void facegeombatch_object_t::test<2>()
+	{
+		LLFaceGeomBatch batch;
+		ensure("starts empty", batch.isEmpty());
+		U32 verts = 0;
+		for (S32 f = 0; f < FACE_COUNT; f++)
+		{
+			batch.addJob(makeJob(f), NULL);
+			verts += f + 1;
+		}
+		ensure_equals("faces", batch.getFaceCount(), (U32)FACE_COUNT);
+		ensure_equals("vertices", batch.getVertexCount(), verts);
+		ensure("staging", batch.getStagingSize() > 0 && (batch.getStagingSize() & 15) == 0);
+
+		batch.fill(NULL);
+		for (U32 i = 0; i < FACE_COUNT; i++)
+		{
+			ensure_staged("inline", batch, i);
+		}
+
+		LLWorkPool pool("test pool", 3);
+		batch.fill(&pool);
+		for (U32 i = 0; i < FACE_COUNT; i++)
+		{
+			ensure_staged("pool", batch, i);
+		}
+
+		batch.clear();
+		ensure("cleared", batch.isEmpty());
+		ensure_equals("cleared vertices", batch.getVertexCount(), (U32)0);
+		ensure_equals("cleared staging", batch.getStagingSize(), (U32)0);
+	}
+
+	// A batch reused after clear() stages only what was added since, into
+	// staging sized for the new jobs.
+	template<> template<>
+	void facegeombatch_object_t::test<3>()
+	{
+		LLFaceGeomBatch batch;
+		LLWorkPool pool("test pool", 2);
+		for (S32 f = 0; f < FACE_COUNT; f++)
+		{
+			batch.addJob(makeJob(f), NULL);
+		}
+		batch.fill(&pool);
+		U32 full_size = batch.getStagingSize();
+		batch.clear();
+
+		const U32 HALF = FACE_COUNT / 2;
+		U32 verts = 0;
+		for (U32 f = 0; f < HALF; f++)
+		{
+			batch.addJob(makeJob(f), NULL);
+			verts += f + 1;
+		}
+		ensure_equals("refilled faces", batch.getFaceCount(), HALF);
+		ensure_equals("refilled vertices", batch.getVertexCount(), verts);
+		ensure("refilled staging", batch.getStagingSize() > 0 && batch.getStagingSize() < full_size);
+
+		batch.fill(&pool);
+		for (U32 i = 0; i < HALF; i++)
+		{
+			ensure_staged("refilled", batch, i);
+		}
+	}
+}
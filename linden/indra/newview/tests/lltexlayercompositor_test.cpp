@@ -0,0 +1,201 @@
+/**
+ * @file lltexlayercompositor_test.cpp
+ * @brief Checks the CPU bake compositor against the GL blend equations.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../lltexlayercompositor.h"
+
+// Tut header
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// TUT
+// -------------------------------------------------------------------------------------------
+
+namespace tut
+{
+	// Test wrapper declarations
+	struct texlayercompositor_test
+	{
+		// The reference values below are worked out by hand from the GL blend
+		// functions on 8 bit channels; allow for rounding either way.
+		void ensure_pixel(const std::string& msg, const U8* pixel, S32 r, S32 g, S32 b, S32 a)
+		{
+			ensure(msg + " red", llabs((S32)pixel[0] - r) <= 1);
+			ensure(msg + " green", llabs((S32)pixel[1] - g) <= 1);
+			ensure(msg + " blue", llabs((S32)pixel[2] - b) <= 1);
+			ensure(msg + " alpha", llabs((S32)pixel[3] - a) <= 1);
+		}
+	};
+
+	// Tut templating thingamagic: test group, object and test instance
+	typedef test_group<texlayercompositor_test> texlayercompositor_t;
+	typedef texlayercompositor_t::object texlayercompositor_object_t;
+	tut::texlayercompositor_t tut_texlayercompositor("LLTexLayerCompositor");
+
+	// Replace
+	template<> template<>
+	void texlayercompositor_object_t::test<1>()
+	{
+		LLTexLayerCompositor compositor(2, 2);
+		compositor.fill(LLColor4(0.5f, 0.25f, 1.f, 1.f), LLTexLayerCompositor::BLEND_REPLACE, FALSE);
+		compositor.execute(NULL);
+		for (S32 i = 0; i < 4; i++)
+		{
+			ensure_pixel("replace", compositor.getImage() + i * 4, 128, 64, 255, 255);
+		}
+	}
+
+	// Alpha blend: src*sa + dst*(1-sa), alpha included
+	template<> template<>
+	void texlayercompositor_object_t::test<2>()
+	{
+		LLTexLayerCompositor compositor(1, 1);
+		compositor.fill(LLColor4(0.f, 0.f, 0.f, 1.f), LLTexLayerCompositor::BLEND_REPLACE, FALSE);
+		compositor.fill(LLColor4(1.f, 0.f, 0.f, 0.5f), LLTexLayerCompositor::BLEND_ALPHA, FALSE);
+		compositor.execute(NULL);
+		ensure_pixel("alpha", compositor.getImage(), 128, 0, 0, 191);
+	}
+
+	// Destination alpha: src*da + dst*(1-da)
+	template<> template<>
+	void texlayercompositor_object_t::test<3>()
+	{
+		LLTexLayerCompositor compositor(1, 1);
+		compositor.fill(LLColor4(0.2f, 0.4f, 0.6f, 0.5f), LLTexLayerCompositor::BLEND_REPLACE, FALSE);
+		compositor.fill(LLColor4(1.f, 1.f, 1.f, 1.f), LLTexLayerCompositor::BLEND_DEST_ALPHA, FALSE);
+		compositor.execute(NULL);
+		ensure_pixel("dest alpha", compositor.getImage(), 153, 179, 204, 192);
+	}
+
+	// Add, saturating
+	template<> template<>
+	void texlayercompositor_object_t::test<4>()
+	{
+		LLTexLayerCompositor compositor(1, 1);
+		compositor.fill(LLColor4(0.5f, 0.5f, 0.5f, 0.5f), LLTexLayerCompositor::BLEND_REPLACE, FALSE);
+		compositor.fill(LLColor4(0.75f, 0.25f, 0.f, 0.75f), LLTexLayerCompositor::BLEND_ADD, FALSE);
+		compositor.execute(NULL);
+		ensure_pixel("add", compositor.getImage(), 255, 192, 128, 255);
+	}
+
+	// Multiply by an alpha texture, writing alpha only
+	template<> template<>
+	void texlayercompositor_object_t::test<5>()
+	{
+		LLTexLayerCompositor compositor(1, 1);
+		compositor.fill(LLColor4(0.2f, 0.4f, 0.6f, 0.5f), LLTexLayerCompositor::BLEND_REPLACE, FALSE);
+		U8 mask = 64;
+		compositor.draw(&mask, 1, 1, 1, TRUE, LLColor4(1.f, 1.f, 1.f, 1.f),
+						LLTexLayerCompositor::BLEND_MULT_ALPHA, TRUE, FALSE);
+		compositor.execute(NULL);
+		ensure_pixel("mult alpha", compositor.getImage(), 51, 102, 153, 32);
+	}
+
+	// Alpha test drops transparent texels
+	template<> template<>
+	void texlayercompositor_object_t::test<6>()
+	{
+		U8 texels[8] = { 255, 0, 0, 255,   0, 255, 0, 0 };
+
+		LLTexLayerCompositor tested(2, 1);
+		tested.fill(LLColor4(0.f, 0.f, 0.f, 1.f), LLTexLayerCompositor::BLEND_REPLACE, FALSE);
+		tested.draw(texels, 2, 1, 4, FALSE, LLColor4(1.f, 1.f, 1.f, 1.f),
+					LLTexLayerCompositor::BLEND_REPLACE, FALSE, TRUE);
+		tested.execute(NULL);
+		ensure_pixel("alpha test, opaque", tested.getImage(), 255, 0, 0, 255);
+		ensure_pixel("alpha test, rejected", tested.getImage() + 4, 0, 0, 0, 255);
+
+		LLTexLayerCompositor untested(2, 1);
+		untested.fill(LLColor4(0.f, 0.f, 0.f, 1.f), LLTexLayerCompositor::BLEND_REPLACE, FALSE);
+		untested.draw(texels, 2, 1, 4, FALSE, LLColor4(1.f, 1.f, 1.f, 1.f),
+					  LLTexLayerCompositor::BLEND_REPLACE, FALSE, FALSE);
+		untested.execute(NULL);
+		ensure_pixel("no alpha test", untested.getImage() + 4, 0, 255, 0, 0);
+	}
+
+	// Luminance texture stretched over twice its width, modulated by the color
+	template<> template<>
+	void texlayercompositor_object_t::test<7>()
+	{
+		U8 texels[2] = { 0, 255 };
+		LLTexLayerCompositor compositor(4, 1);
+		compositor.draw(texels, 2, 1, 1, FALSE, LLColor4(1.f, 1.f, 1.f, 1.f),
+						LLTexLayerCompositor::BLEND_REPLACE, FALSE, FALSE);
+		compositor.execute(NULL);
+		ensure_pixel("stretch 0", compositor.getImage(), 0, 0, 0, 255);
+		ensure_pixel("stretch 1", compositor.getImage() + 4, 64, 64, 64, 255);
+		ensure_pixel("stretch 2", compositor.getImage() + 8, 191, 191, 191, 255);
+		ensure_pixel("stretch 3", compositor.getImage() + 12, 255, 255, 255, 255);
+
+		LLTexLayerCompositor tinted(1, 1);
+		U8 texel = 255;
+		tinted.draw(&texel, 1, 1, 1, FALSE, LLColor4(0.5f, 1.f, 0.f, 1.f),
+					LLTexLayerCompositor::BLEND_REPLACE, FALSE, FALSE);
+		tinted.execute(NULL);
+		ensure_pixel("tint", tinted.getImage(), 128, 255, 0, 255);
+	}
+
+	// Captures see the buffer as it was at their point in the draws, in every band
+	template<> template<>
+	void texlayercompositor_object_t::test<8>()
+	{
+		const S32 width = 3;
+		const S32 height = 40;
+		LLTexLayerCompositor compositor(width, height);
+		compositor.fill(LLColor4(1.f, 0.f, 0.f, 1.f), LLTexLayerCompositor::BLEND_REPLACE, FALSE);
+		S32 image = compositor.captureImage();
+		compositor.fill(LLColor4(0.f, 1.f, 0.f, 0.25f), LLTexLayerCompositor::BLEND_REPLACE, FALSE);
+		S32 alpha = compositor.captureAlpha();
+		compositor.fill(LLColor4(0.f, 0.f, 1.f, 1.f), LLTexLayerCompositor::BLEND_REPLACE, FALSE);
+		ensure_equals("draws recorded", compositor.getNumDraws(), 5);
+		compositor.execute(NULL);
+
+		for (S32 i = 0; i < width * height; i++)
+		{
+			ensure_pixel("image capture", compositor.getCapture(image) + i * 4, 255, 0, 0, 255);
+			ensure("alpha capture", llabs((S32)compositor.getCapture(alpha)[i] - 64) <= 1);
+			ensure_pixel("final image", compositor.getImage() + i * 4, 0, 0, 255, 255);
+		}
+	}
+
+	// Compare
+	template<> template<>
+	void texlayercompositor_object_t::test<9>()
+	{
+		U8 a[6] = { 10, 20, 30,   40, 50, 60 };
+		U8 b[6] = { 10, 25, 27,   40, 50, 62 };
+		S32 max_diff[3];
+		F32 mean_diff[3];
+		LLTexLayerCompositor::compare(a, b, 2, 3, max_diff, mean_diff);
+		ensure_equals("max red", max_diff[0], 0);
+		ensure_equals("max green", max_diff[1], 5);
+		ensure_equals("max blue", max_diff[2], 3);
+		ensure_equals("mean green", mean_diff[1], 2.5f);
+		ensure_equals("mean blue", mean_diff[2], 2.5f);
+	}
+}
@@ -0,0 +1,171 @@
+/**
+ * @file llvldetailblend_test.cpp
+ * @brief Tests for the terrain detail blend.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../llvldetailblend.h"
+
+// Tut header
+#include "../test/lltut.h"
+
+#include <vector>
+
+// -------------------------------------------------------------------------------------------
+// TUT
+// -------------------------------------------------------------------------------------------
+
+namespace tut
+{
+	// Test wrapper declarations
+	struct vldetailblend_test
+	{
+		enum { WIDTH = 16 };
+
+		// Four detail images of WIDTH x WIDTH, each a different gradient.
+		std::vector<U8> mImages[LLVLDetailBlend::IMAGE_COUNT];
+		const U8* mData[LLVLDetailBlend::IMAGE_COUNT];
+		S32 mDataSize[LLVLDetailBlend::IMAGE_COUNT];
+
+		vldetailblend_test()
+		{
+			for (S32 i = 0; i < LLVLDetailBlend::IMAGE_COUNT; i++)
+			{
+				mImages[i].resize(WIDTH * WIDTH * 3);
+				for (S32 n = 0; n < (S32)mImages[i].size(); n++)
+				{
+					mImages[i][n] = (U8)((n * (i + 3) + i * 61) & 0xff);
+				}
+				mData[i] = &mImages[i][0];
+				mDataSize[i] = (S32)mImages[i].size();
+			}
+		}
+
+		// Runs both paths over a row and checks they write the same bytes
+		// and leave sti in the same place.
+		void ensure_paths_agree(const std::string& msg, const LLVLDetailBlend& blend,
+								const std::vector<F32>& composition, F32 sti, F32 stj, F32 x_stride)
+		{
+			S32 count = (S32)composition.size();
+			std::vector<U8> row(count * 3, 0x5a);
+			std::vector<U8> scalar_row(count * 3, 0x5a);
+			F32 row_sti = sti;
+			F32 scalar_sti = sti;
+			blend.blendRow(&composition[0], count, row_sti, stj, x_stride, &row[0]);
+			blend.blendRowScalar(&composition[0], count, scalar_sti, stj, x_stride, &scalar_row[0]);
+			for (S32 n = 0; n < count * 3; n++)
+			{
+				ensure_equals(msg + llformat(" texel %d component %d", n / 3, n % 3), row[n], scalar_row[n]);
+			}
+			ensure_equals(msg + " sti", row_sti, scalar_sti);
+		}
+	};
+
+	// Tut templating thingamagic: test group, object and test instance
+	typedef test_group<vldetailblend_test> vldetailblend_t;
+	typedef vldetailblend_t::object vldetailblend_object_t;
+	tut::vldetailblend_t tut_vldetailblend("LLVLDetailBlend");
+
+	// Blend values at the sample points
+	template<> template<>
+	void vldetailblend_object_t::test<1>()
+	{
+		LLVLDetailBlend blend(mData, mDataSize, WIDTH);
+		// 0 is image 0, 1.5 is halfway from image 1 to 2, 3 and above is image 3.
+		F32 composition[3] = { 0.f, 1.5f, 3.7f };
+		U8 texels[9];
+		F32 sti = 2.f;
+		blend.blendRowScalar(composition, 3, sti, 1.f, 1.f, texels);
+
+		S32 offset = (2 + WIDTH) * 3;
+		ensure_equals("image 0", texels[0], mImages[0][offset]);
+		offset += 3;
+		F32 a = mImages[1][offset + 1];
+		F32 b = mImages[2][offset + 1];
+		ensure_equals("halfway", texels[4], (U8)lltrunc(a + 0.5f * (b - a)));
+		offset += 3;
+		ensure_equals("image 3", texels[8], mImages[3][offset + 2]);
+		ensure_equals("stepped", sti, 5.f);
+	}
+
+	// Both paths agree over whole rows, including wrap around and rows
+	// whose length isn't a multiple of four.
+	template<> template<>
+	void vldetailblend_object_t::test<2>()
+	{
+		LLVLDetailBlend blend(mData, mDataSize, WIDTH);
+		for (S32 count = 1; count <= 23; count++)
+		{
+			std::vector<F32> composition(count);
+			for (S32 i = 0; i < count; i++)
+			{
+				composition[i] = (F32)((i * 7) % 41) * 0.1f - 0.3f;
+			}
+			ensure_paths_agree(llformat("count %d", count), blend, composition, 3.25f, 5.f, 1.75f);
+			ensure_paths_agree(llformat("wrapping %d", count), blend, composition, 14.5f, 15.f, 0.6f);
+		}
+	}
+
+	// Samples running off the end of a short image are skipped the same way
+	// by both paths, texel by texel rather than component by component.
+	template<> template<>
+	void vldetailblend_object_t::test<3>()
+	{
+		// Image 2 is cut short in the middle of the last row's texel 9.
+		S32 short_size[LLVLDetailBlend::IMAGE_COUNT];
+		for (S32 i = 0; i < LLVLDetailBlend::IMAGE_COUNT; i++)
+		{
+			short_size[i] = mDataSize[i];
+		}
+		short_size[2] = ((WIDTH - 1) * WIDTH + 9) * 3 + 1;
+		LLVLDetailBlend blend(mData, short_size, WIDTH);
+
+		std::vector<F32> composition(WIDTH, 1.5f);
+		ensure_paths_agree("last row", blend, composition, 0.f, (F32)(WIDTH - 1), 1.f);
+
+		std::vector<U8> row(WIDTH * 3, 0x5a);
+		F32 sti = 0.f;
+		blend.blendRow(&composition[0], WIDTH, sti, (F32)(WIDTH - 1), 1.f, &row[0]);
+		ensure("inside is blended", row[8 * 3] != 0x5a || row[8 * 3 + 1] != 0x5a || row[8 * 3 + 2] != 0x5a);
+		for (S32 i = 9; i < WIDTH; i++)
+		{
+			for (S32 c = 0; c < 3; c++)
+			{
+				ensure_equals(llformat("texel %d left alone", i), row[i * 3 + c], (U8)0x5a);
+			}
+		}
+
+		// Image 0 isn't short, so rows drawing only on it are untouched by the cut.
+		std::vector<F32> first(WIDTH, 0.f);
+		std::vector<U8> first_row(WIDTH * 3, 0x5a);
+		sti = 0.f;
+		blend.blendRow(&first[0], WIDTH, sti, (F32)(WIDTH - 1), 1.f, &first_row[0]);
+		for (S32 n = 0; n < WIDTH * 3; n++)
+		{
+			ensure_equals("image 0 row", first_row[n], mImages[0][(WIDTH - 1) * WIDTH * 3 + n]);
+		}
+	}
+}
@@ -736,4 +736,206 @@ namespace tut
         heaptest.post(2);
 #endif // 0
     }
+
+    bool stopListening(LLEventPump& pump, const std::string& name, const LLSD&)
+    {
+        pump.stopListening(name);
+        return false;
+    }
+
+    template<> template<>
+    void events_object::test<17>()
+    {
+        set_test_name("LLEventBatchPump posting LLSD");
+        typedef LLEventPump::NameList NameList;
+        typedef Collect::StringList StringList;
+        ensure("mainloop is an LLEventBatchPump",
+               dynamic_cast<LLEventBatchPump*>(&pumps.obtain("mainloop")));
+        ensure("obtainBatch() finds the same one",
+               &pumps.obtainBatch("mainloop") == &pumps.obtain("mainloop"));
+        pumps.obtain("per-frame");
+        std::string threw;
+        try
+        {
+            pumps.obtainBatch("per-frame");
+        }
+        catch (const LLEventPumps::BadPumpType& e)
+        {
+            threw = e.what();
+        }
+        ensure_contains("obtainBatch(LLEventStream)", threw, "BadPumpType");
+
+        LLEventBatchPump& batch(pumps.obtainBatch("batch"));
+        Collect collector;
+        batch.listen("Mary",
+                     boost::bind(&Collect::add, boost::ref(collector), "Mary", _1),
+                     make<NameList>(list_of("checked")));
+        batch.listen("checked",
+                     boost::bind(&Collect::add, boost::ref(collector), "checked", _1),
+                     make<NameList>(list_of("spot")));
+        batch.listen("spot",
+                     boost::bind(&Collect::add, boost::ref(collector), "spot", _1));
+        ensure("not handled", ! batch.post(1));
+        ensure_equals(collector.result, make<StringList>(list_of("spot")("checked")("Mary")));
+        collector.clear();
+        // Batch and LLSD listeners share one order: a newcomer can go
+        // between existing listeners.
+        batch.listen("Fido",
+                     boost::bind(&Collect::add, boost::ref(collector), "Fido", _1),
+                     make<NameList>(list_of("spot")),
+                     make<NameList>(list_of("checked")));
+        batch.post(2);
+        ensure_equals(collector.result, make<StringList>(list_of("spot")("Fido")("checked")("Mary")));
+        collector.clear();
+        threw.clear();
+        try
+        {
+            batch.listen("Fido", boost::bind(&Collect::add, boost::ref(collector), "dup", _1));
+        }
+        catch (const LLEventPump::DupListenerName& e)
+        {
+            threw = e.what();
+        }
+        ensure_contains("duplicate name", threw, "DupListenerName");
+        {
+            LLEventPump::Blocker block(batch.getListener("checked"));
+            batch.post(3);
+            ensure_equals(collector.result, make<StringList>(list_of("spot")("Fido")("Mary")));
+            collector.clear();
+        }
+        batch.stopListening("Fido");
+        batch.getListener("Mary").disconnect();
+        batch.post(4);
+        ensure_equals(collector.result, make<StringList>(list_of("spot")("checked")));
+        collector.clear();
+
+        // A listener that handles the event stops it there.
+        listener0.listenTo(batch, &Listener::callstop,
+                           make<NameList>(list_of("spot")), make<NameList>(list_of("checked")));
+        ensure("handled", batch.post(5));
+        ensure_equals(collector.result, make<StringList>(list_of("spot")));
+        check_listener("callstop", listener0, 5);
+        collector.clear();
+        batch.stopListening(listener0.getName());
+
+        // A listener removed during post() still sees the current event, but
+        // not the next one.
+        batch.listen("quitter", boost::bind(stopListening, boost::ref(batch), "quitter", _1),
+                     make<NameList>(list_of("spot")));
+        listener1.listenTo(batch, &Listener::call, make<NameList>(list_of("quitter")));
+        batch.post(6);
+        check_listener("after quitter", listener1, 6);
+        ensure("quitter gone", ! batch.getListener("quitter").connected());
+        batch.post(7);
+        check_listener("still there", listener1, 7);
+
+        batch.enable(false);
+        batch.post(8);
+        check_listener("disabled", listener1, 7);
+        batch.enable(true);
+    }
+
+    struct BatchSample
+    {
+        S32 mValue;
+        F32 mWeight;
+    };
+
+    struct BatchCollect
+    {
+        BatchCollect(): mCalls(0), mStop(false) {}
+        bool add(const BatchSample* samples, size_t count)
+        {
+            ++mCalls;
+            for (size_t i = 0; i < count; ++i)
+            {
+                mValues.push_back(samples[i].mValue);
+            }
+            return mStop;
+        }
+        S32 mCalls;
+        bool mStop;
+        std::vector<S32> mValues;
+    };
+
+    struct TrackableBatchCollect: public BatchCollect, public LLEventTrackable
+    {
+    };
+
+    template<> template<>
+    void events_object::test<18>()
+    {
+        set_test_name("LLEventBatchPump batches");
+        typedef LLEventPump::NameList NameList;
+        LLEventBatchPump& batch(pumps.obtainBatch("batches"));
+        BatchCollect first, second;
+        batch.listenBatch<BatchSample>("late",
+                                       boost::bind(&BatchCollect::add, boost::ref(second), _1, _2),
+                                       make<NameList>(list_of("early")));
+        batch.listenBatch<BatchSample>("early",
+                                       boost::bind(&BatchCollect::add, boost::ref(first), _1, _2));
+        listener0.listenTo(batch);
+        listener0.reset(0);
+
+        BatchSample samples[3] = { { 1, 0.f }, { 2, 0.f }, { 3, 0.f } };
+        ensure("not handled", ! batch.postBatch(samples, 3));
+        ensure_equals("first called once", first.mCalls, 1);
+        ensure_equals("first got all", first.mValues.size(), size_t(3));
+        ensure_equals("first in order", first.mValues[2], 3);
+        ensure_equals("second got all", second.mValues.size(), size_t(3));
+        check_listener("LLSD listener skipped", listener0, 0);
+        batch.post(1);
+        check_listener("LLSD listener called", listener0, 1);
+        ensure_equals("batch listeners skipped", first.mCalls, 1);
+        S32 ints[] = { 5 };
+        batch.postBatch(ints, 1);
+        ensure_equals("other types skipped", first.mCalls, 1);
+
+        first.mStop = true;
+        ensure("handled", batch.postBatch(samples, 1));
+        ensure_equals("second not called", second.mCalls, 1);
+        first.mStop = false;
+
+        // Queued events wait for flush(), then arrive as one batch.
+        first.mValues.clear();
+        for (S32 i = 0; i < 5; ++i)
+        {
+            BatchSample sample = { i, 0.f };
+            batch.queue(sample);
+        }
+        ensure_equals("queued", first.mCalls, 2);
+        pumps.obtain("mainloop").post(LLSD());
+        ensure_equals("one batch", first.mCalls, 3);
+        ensure_equals("whole batch", first.mValues.size(), size_t(5));
+        ensure_equals("queued in order", first.mValues[4], 4);
+        pumps.obtain("mainloop").post(LLSD());
+        ensure_equals("nothing left", first.mCalls, 3);
+
+        LLBoundListener connection;
+        {
+            TrackableBatchCollect temp;
+            connection = batch.listenBatch<BatchSample>("temp",
+                                                        boost::bind(&BatchCollect::add,
+                                                                    boost::ref(temp), _1, _2));
+            batch.postBatch(samples, 3);
+            ensure_equals("trackable called", temp.mCalls, 1);
+        }
+        ensure("implicit disconnect", ! connection.connected());
+        // and don't touch the destroyed listener
+        batch.postBatch(samples, 3);
+        ensure_equals("others still called", first.mCalls, 5);
+    }
+
+    template<> template<>
+    void events_object::test<19>()
+    {
+        set_test_name("LLEventBatchPump benchmark");
+        // The benchmark behind Advanced > Benchmark Event Pumps runs without
+        // a viewer, and its pumps don't outlive it.
+        LLEventBatchPump::benchmark(1, 1);
+        LLEventBatchPump::benchmark(4, 64);
+        // would throw DupPumpName if either were still registered
+        LLEventStream stream("benchmarkStream");
+        LLEventBatchPump batch("benchmarkBatch");
+    }
 } // namespace tut